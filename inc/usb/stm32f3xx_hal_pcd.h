@@ -57,6 +57,96 @@
   * @{
   */ 
 
+/* Set to 1 to run the Stage, Reset, Suspend, Resume and SOF callbacks from
+   HAL_PCD_ProcessEvents instead of HAL_PCD_IRQHandler. The interrupt only
+   services the hardware and queues the events, then pends PendSV: call
+   HAL_PCD_ProcessEvents from PendSV_Handler, which HAL_PCD_Init sets to the
+   lowest priority. PendSV must not be used by anything else (e.g. an RTOS). */
+#ifndef PCD_DEFERRED_EVENTS
+#define PCD_DEFERRED_EVENTS                 0
+#endif
+
+/* Set to 1 to serve isochronous and double buffered bulk endpoints from
+   HAL_PCD_HP_IRQHandler, on the USB_HP vector the hardware raises for
+   their transfers, and leave control and the other endpoints to
+   HAL_PCD_IRQHandler on USB_LP. HAL_PCD_Init gives the vectors
+   PCD_HP_IRQ_PRIORITY and PCD_LP_IRQ_PRIORITY and enables USB_HP, the
+   remapped one with USE_USB_INTERRUPT_REMAPPED. The callbacks of those
+   endpoints then run at the HP priority, preempting the core. */
+#ifndef PCD_HP_ROUTING
+#define PCD_HP_ROUTING                      0
+#endif
+
+#ifndef PCD_HP_IRQ_PRIORITY
+#define PCD_HP_IRQ_PRIORITY                 1U
+#endif
+
+#ifndef PCD_LP_IRQ_PRIORITY
+#define PCD_LP_IRQ_PRIORITY                 2U
+#endif
+
+/* Events held between HAL_PCD_IRQHandler and HAL_PCD_ProcessEvents, power
+   of two */
+#ifndef PCD_EVENT_QUEUE_SIZE
+#define PCD_EVENT_QUEUE_SIZE                32U
+#endif
+
+/* HAL_PCD_StartRemoteWakeup timing, in ESOF periods of 1 ms: idle time
+   added to the 3 ms of suspend detection before resume is signalled (the
+   bus must be idle for 5 ms first), then the length of the resume
+   signalling, 1 to 15 ms. */
+#ifndef PCD_REMOTE_WAKEUP_HOLDOFF
+#define PCD_REMOTE_WAKEUP_HOLDOFF           2U
+#endif
+
+#ifndef PCD_REMOTE_WAKEUP_MS
+#define PCD_REMOTE_WAKEUP_MS                10U
+#endif
+
+/* Set to 1 to let a DMA channel move packets of PCD_PMA_DMA_THRESHOLD bytes
+   or more between user buffers and the PMA, on single buffered bulk and
+   interrupt endpoints other than EP0. The channel is given with
+   HAL_PCDEx_SetPMADma and its interrupt must call HAL_PCD_PMADma_IRQHandler
+   at the priority of the USB interrupt: that is where the IN endpoint is
+   validated and the OUT packet completed. Odd buffers, buffers in CCM and
+   packets arriving while the channel is busy are copied by the CPU. */
+#ifndef PCD_PMA_DMA
+#define PCD_PMA_DMA                         0
+#endif
+
+#ifndef PCD_PMA_DMA_THRESHOLD
+#define PCD_PMA_DMA_THRESHOLD               32U
+#endif
+
+/* Channel priority, DMA_CCR_PL bits */
+#ifndef PCD_PMA_DMA_PRIORITY
+#define PCD_PMA_DMA_PRIORITY                DMA_CCR_PL_1
+#endif
+
+/* Set to 1 to service the device from the application loop with
+   HAL_PCD_Poll instead of the USB interrupts, which HAL_PCD_Init leaves
+   disabled in the NVIC. HAL_PCD_Poll does the work of HAL_PCD_IRQHandler
+   within a budget of core cycles, measured with the DWT cycle counter:
+   the endpoint transfers are served one at a time, each with the
+   callbacks it makes, and the next is only started while more than
+   PCD_POLL_STEP_CYCLES of the budget is left. Transfers left over stay
+   pending in the hardware for the next call. Bus events (reset, suspend,
+   wakeup, SOF) cost a bounded few register accesses and are always
+   served. Set PCD_POLL_STEP_CYCLES to the longest endpoint service, the
+   maximum of the USB_PROF_EP_ISR slot, for a poll that never runs over;
+   at 0 it runs over by at most one service. */
+#ifndef PCD_POLLED
+#define PCD_POLLED                          0
+#endif
+
+#ifndef PCD_POLL_STEP_CYCLES
+#define PCD_POLL_STEP_CYCLES                0U
+#endif
+
+#if (PCD_POLLED == 1) && ((PCD_DEFERRED_EVENTS == 1) || (PCD_HP_ROUTING == 1) || (PCD_PMA_DMA == 1))
+#error "PCD_POLLED does not go with the interrupt driven PCD_DEFERRED_EVENTS, PCD_HP_ROUTING or PCD_PMA_DMA"
+#endif
+
 /* Exported types ------------------------------------------------------------*/ 
 /** @defgroup PCD_Exported_Types PCD Exported Types
   * @{
@@ -74,6 +164,28 @@ typedef enum
   HAL_PCD_STATE_TIMEOUT = 0x04U
 } PCD_StateTypeDef;
 
+#if defined(USB_LPMCSR_LMPEN)
+/** 
+  * @brief  Link power state, USB 2.0 LPM
+  */  
+typedef enum
+{
+  LPM_L0 = 0x00U, /*!< on                  */
+  LPM_L1 = 0x01U, /*!< LPM L1 sleep        */
+  LPM_L2 = 0x02U, /*!< suspend             */
+  LPM_L3 = 0x03U, /*!< off                 */
+} PCD_LPM_StateTypeDef;
+
+/** 
+  * @brief  Link power change reported to HAL_PCDEx_LPM_Callback
+  */  
+typedef enum
+{
+  PCD_LPM_L0_ACTIVE = 0x00U, /*!< resumed from L1 */
+  PCD_LPM_L1_ACTIVE = 0x01U, /*!< entered L1      */
+} PCD_LPM_MsgTypeDef;
+#endif /* USB_LPMCSR_LMPEN */
+
 /**
   * @brief  PCD double buffered endpoint direction
   */
@@ -126,7 +238,47 @@ typedef struct
                                 
 }PCD_InitTypeDef;
 
+struct __PCD_HandleTypeDef;
+struct __PCD_EPTypeDef;
+
+/** 
+  * @brief  Interrupt service of one endpoint direction, called with the
+  *         endpoint register value read when the CTR event was decoded
+  */
+typedef void (*PCD_EPHandlerTypeDef)(struct __PCD_HandleTypeDef *hpcd,
+                                     struct __PCD_EPTypeDef *ep,
+                                     uint16_t wEPVal);
+
+/** 
+  * @brief  Transfer completion handler of an endpoint, called with the pData
+  *         member of the PCD handle instead of the Data Stage callbacks
+  */
+typedef uint8_t (*PCD_EPCallbackTypeDef)(void *pData, uint8_t epnum);
+
+/** 
+  * @brief  Segment of a scatter-gather IN transfer, see
+  *         HAL_PCD_EP_TransmitVec. Same layout as USBD_IovTypeDef.
+  */
+typedef struct
+{
+  const uint8_t *buf;       /*!< Segment data                                                             */
+  uint32_t       len;       /*!< Segment length, may be 0                                                 */
+} PCD_IovTypeDef;
+
+/** 
+  * @brief  Packet buffer of an IN endpoint filled in place, see
+  *         HAL_PCDEx_EP_TxReserve. Same layout as USBD_PMAWriterTypeDef.
+  */
 typedef struct
+{
+  __IO uint16_t *ptr;       /*!< Next PMA halfword in the CPU map                                         */
+  uint16_t       stride;    /*!< Halfwords of the CPU map per PMA halfword, PMA_ACCESS_STRIDE             */
+  uint16_t       count;     /*!< Bytes written, more than size once overrun                               */
+  uint16_t       size;      /*!< Room in the buffer, the max packet size                                  */
+  uint16_t       pending;   /*!< Odd byte waiting for its pair, bit 8 set                                 */
+} PCD_PMAWriterTypeDef;
+
+typedef struct __PCD_EPTypeDef
 {
   uint8_t   num;            /*!< Endpoint number
                                 This parameter must be a number between Min_Data = 1 and Max_Data = 15    */ 
@@ -159,20 +311,72 @@ typedef struct
                                  This parameter must be a number between Min_Data = 0 and Max_Data = 64KB */
 
   uint8_t   *xfer_buff;     /*!< Pointer to transfer buffer                                               */
+
+  const PCD_IovTypeDef *xfer_iov; /*!< IN transfer from HAL_PCD_EP_TransmitVec: segment the next packet
+                                       starts in, NULL for a contiguous buffer                             */
+
+  uint32_t  xfer_iov_off;   /*!< Offset of the next packet in xfer_iov                                     */
                                 
   
   uint32_t  xfer_len;       /*!< Current transfer length                                                  */
   
   uint32_t  xfer_count;     /*!< Partial transfer length in case of multi packet transfer                 */
 
+  uint32_t  xfer_size;      /*!< OUT transfer: size of the buffer given to HAL_PCD_EP_Receive             */
+
+  uint8_t   xfer_armed;     /*!< OUT transfer armed by HAL_PCD_EP_Receive and not yet completed           */
+
+  uint8_t   xfer_gen;       /*!< Bumped by HAL_PCD_EP_Flush: a completion queued before is dropped       */
+
+  uint8_t   dbuf_held;      /*!< Double buffered OUT endpoint: a received packet is kept in PMA
+                                 until the endpoint is re-armed                                           */
+
+  uint16_t  rx_view;        /*!< PMA address of the packet left in place by a zero-copy OUT transfer
+                                 (HAL_PCD_EP_Receive called with a NULL buffer)                           */
+
+  uint8_t   rx_view_dbuf;   /*!< Double buffered OUT endpoint: the buffer holding rx_view has not been
+                                 released yet                                                             */
+
+  PCD_EPHandlerTypeDef isr; /*!< Interrupt service, selected by HAL_PCD_EP_Open                         */
+
+  PCD_EPCallbackTypeDef xfer_cb; /*!< Completion handler set by HAL_PCDEx_EP_SetCallback, NULL for the
+                                      Data Stage callbacks                                                */
+
 }PCD_EPTypeDef;
 
 typedef   USB_TypeDef PCD_TypeDef; 
 
+#if (PCD_DEFERRED_EVENTS == 1)
 /** 
-  * @brief  PCD Handle Structure definition  
+  * @brief  Deferred event record
+  */ 
+typedef struct
+{
+  __IO uint32_t           seq;        /*!< Ticket + 1 once the record is complete */
+  uint8_t                 type;       /*!< PCD_EVENT_xxx                          */
+  uint8_t                 epnum;      /*!< Endpoint number                        */
+  uint8_t                 gen;        /*!< xfer_gen of the endpoint when queued   */
+  uint32_t                setup[2];   /*!< SETUP packet of a PCD_EVENT_SETUP      */
+} PCD_EventTypeDef;
+
+/** 
+  * @brief  Deferred event queue. Records are claimed with LDREX/STREX on
+  *         head, so the interrupt, PendSV and thread level may all queue
+  *         events; only HAL_PCD_ProcessEvents consumes them.
   */ 
 typedef struct
+{
+  PCD_EventTypeDef        ev[PCD_EVENT_QUEUE_SIZE];
+  __IO uint32_t           head;       /*!< Next ticket to hand out                */
+  __IO uint32_t           tail;       /*!< Next ticket to process                 */
+  __IO uint32_t           overflows;  /*!< Events dropped on a full queue         */
+} PCD_EventQueueTypeDef;
+#endif /* PCD_DEFERRED_EVENTS */
+
+/** 
+  * @brief  PCD Handle Structure definition  
+  */ 
+typedef struct __PCD_HandleTypeDef
 {
   PCD_TypeDef             *Instance;   /*!< Register base address              */ 
   PCD_InitTypeDef         Init;       /*!< PCD required parameters            */
@@ -183,6 +387,34 @@ typedef struct
   __IO PCD_StateTypeDef   State;      /*!< PCD communication state            */
   uint32_t                Setup[12];  /*!< Setup packet buffer                */
   void                    *pData;      /*!< Pointer to upper stack Handler     */    
+  __IO uint8_t            RemoteWakeup; /*!< ESOF periods left of a remote wakeup, 0 if none */
+  uint8_t                 RemoteWakeupEsof; /*!< ESOF was enabled before the remote wakeup */
+  uint16_t                IsoActive;  /*!< Isochronous endpoints streaming, IN bit n, OUT bit n + 8 */
+  uint16_t                IsoDone;    /*!< Of those, the ones served since the last SOF             */
+#if (PCD_HP_ROUTING == 1)
+  __IO uint16_t           HPEndpoints; /*!< Endpoint numbers served by HAL_PCD_HP_IRQHandler, bit n */
+#endif /* PCD_HP_ROUTING */
+#if defined(USB_LPMCSR_LMPEN)
+  __IO PCD_LPM_StateTypeDef LPM_State; /*!< Link power state                     */
+  uint32_t                BESL;       /*!< BESL of the last L1 request, 0 to 15   */
+  uint32_t                lpm_active; /*!< L1 requests are acknowledged           */
+#endif /* USB_LPMCSR_LMPEN */
+#if (PCD_DEFERRED_EVENTS == 1)
+  PCD_EventQueueTypeDef   Events;     /*!< Events waiting for HAL_PCD_ProcessEvents */
+#endif /* PCD_DEFERRED_EVENTS */
+#if (PCD_PMA_DMA == 1)
+  DMA_TypeDef             *PmaDma;    /*!< Controller of the PMA channel           */
+  DMA_Channel_TypeDef     *PmaDmaCh;  /*!< PMA channel, NULL for CPU copies only    */
+  uint8_t                 PmaDmaChNum; /*!< Its number, 1 to 7                      */
+  PCD_EPTypeDef * volatile PmaDmaEp;  /*!< Endpoint of the packet moving, NULL if idle */
+  uint8_t                 *PmaDmaBuf; /*!< User side of that packet                */
+  uint16_t                PmaDmaAddr; /*!< PMA side of that packet                 */
+  uint16_t                PmaDmaLen;  /*!< Its length in bytes                     */
+#endif /* PCD_PMA_DMA */
+#if (PCD_POLLED == 1)
+  uint32_t                PollStart;  /*!< CYCCNT on entry to HAL_PCD_Poll         */
+  uint32_t                PollBudget; /*!< Its budget, less PCD_POLL_STEP_CYCLES   */
+#endif /* PCD_POLLED */
   
 } PCD_HandleTypeDef;
 
@@ -278,6 +510,18 @@ void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd);
 HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd);
 HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd);
 void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd);
+#if (PCD_HP_ROUTING == 1)
+void HAL_PCD_HP_IRQHandler(PCD_HandleTypeDef *hpcd);
+#endif /* PCD_HP_ROUTING */
+#if (PCD_PMA_DMA == 1)
+void HAL_PCD_PMADma_IRQHandler(PCD_HandleTypeDef *hpcd);
+#endif /* PCD_PMA_DMA */
+#if (PCD_DEFERRED_EVENTS == 1)
+void HAL_PCD_ProcessEvents(PCD_HandleTypeDef *hpcd);
+#endif /* PCD_DEFERRED_EVENTS */
+#if (PCD_POLLED == 1)
+HAL_StatusTypeDef HAL_PCD_Poll(PCD_HandleTypeDef *hpcd, uint32_t budget);
+#endif /* PCD_POLLED */
 
 void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
 void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
@@ -305,12 +549,14 @@ HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint
 HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
 HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len);
 HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const uint8_t *pBuf, uint32_t len);
+HAL_StatusTypeDef HAL_PCD_EP_TransmitVec(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const PCD_IovTypeDef *iov, uint32_t iovcnt);
 uint16_t          HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
 HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
 HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
 HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
 HAL_StatusTypeDef HAL_PCD_ActivateRemoteWakeup(PCD_HandleTypeDef *hpcd);
 HAL_StatusTypeDef HAL_PCD_DeActivateRemoteWakeup(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_StartRemoteWakeup(PCD_HandleTypeDef *hpcd);
 /**
   * @}
   */
@@ -618,6 +864,20 @@ PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd);
 #define PCD_CLEAR_TX_EP_CTR(USBx, bEpNum)   (PCD_SET_ENDPOINT((USBx), (bEpNum),\
                                    PCD_GET_ENDPOINT((USBx), (bEpNum)) & 0xFF7FU & USB_EPREG_MASK))
 
+/**
+  * @brief  Clears bit CTR_RX / CTR_TX from a register value already read.
+  *         The other CTR bit is written as 1, which leaves it untouched
+  *         even if it got set since wRegVal was read.
+  * @param  USBx USB peripheral instance register address.
+  * @param  bEpNum Endpoint Number.
+  * @param  wRegVal Endpoint register value.
+  * @retval None
+  */
+#define PCD_CLEAR_RX_EP_CTR_VAL(USBx, bEpNum, wRegVal)   (PCD_SET_ENDPOINT((USBx), (bEpNum),\
+                                   ((wRegVal) & 0x7FFFU & USB_EPREG_MASK) | USB_EP_CTR_TX))
+#define PCD_CLEAR_TX_EP_CTR_VAL(USBx, bEpNum, wRegVal)   (PCD_SET_ENDPOINT((USBx), (bEpNum),\
+                                   ((wRegVal) & 0xFF7FU & USB_EPREG_MASK) | USB_EP_CTR_RX))
+
 /**
   * @brief  Toggles DTOG_RX / DTOG_TX bit in the endpoint register.
   * @param  USBx USB peripheral instance register address.
@@ -807,7 +1067,7 @@ PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd);
 #define PCD_SET_EP_DBUF_CNT(USBx, bEpNum, bDir, wCount) {\
     PCD_SET_EP_DBUF0_CNT((USBx), (bEpNum), (bDir), (wCount)) \
     PCD_SET_EP_DBUF1_CNT((USBx), (bEpNum), (bDir), (wCount)) \
-  } /
+  } /* PCD_SET_EP_DBUF_CNT */
 
 /**
   * @brief  Gets buffer 0/1 rx/tx counter for double buffering.
@@ -863,7 +1123,14 @@ PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd);
   * @{
   */
 void PCD_WritePMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+void PCD_WritePMAVec(USB_TypeDef  *USBx, const PCD_IovTypeDef **ppIov, uint32_t *pOffset, uint16_t wPMABufAddr, uint16_t wNBytes);
+#if (PCD_PMA_DMA == 1)
+uint8_t PCD_PMADmaStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+PCD_EPTypeDef *PCD_PMADmaStop(PCD_HandleTypeDef *hpcd, uint8_t *error);
+#endif /* PCD_PMA_DMA */
 void PCD_ReadPMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+void PCD_ReadPMASamples(USB_TypeDef  *USBx, int16_t *pDst, uint16_t wPMABufAddr, uint16_t count, int32_t gain);
+void PCD_ReadPMASamplesF32(USB_TypeDef  *USBx, float *pDst, uint16_t wPMABufAddr, uint16_t count, float scale);
 /**
   * @}
   */
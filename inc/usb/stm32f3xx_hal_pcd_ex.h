@@ -59,6 +59,19 @@
 
 /* Exported types ------------------------------------------------------------*/ 
 /* Exported constants --------------------------------------------------------*/
+/** @defgroup PCDEx_Interrupts PCD Extended optional interrupts
+  * @brief    For HAL_PCDEx_EnableInterrupts and HAL_PCDEx_DisableInterrupts
+  * @{
+  */
+#define PCD_IT_SOF                      USB_CNTR_SOFM     /*!< Start of frame, HAL_PCD_SOFCallback */
+#define PCD_IT_ESOF                     USB_CNTR_ESOFM    /*!< Missed start of frame             */
+#define PCD_IT_ERR                      USB_CNTR_ERRM     /*!< Bus error, for USB_STATS_ENABLED  */
+#define PCD_IT_PMAOVR                   USB_CNTR_PMAOVRM  /*!< PMA overrun, for USB_STATS_ENABLED */
+#define PCD_IT_ALL                      (PCD_IT_SOF | PCD_IT_ESOF | PCD_IT_ERR | PCD_IT_PMAOVR)
+/**
+  * @}
+  */
+
 /* Exported macros -----------------------------------------------------------*/                                              
 /** @defgroup PCDEx_Exported_Macros PCD Extended Exported Macros
   * @{
@@ -119,8 +132,56 @@ HAL_StatusTypeDef HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
                                      uint16_t ep_kind,
                                      uint32_t pmaadress);
 
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxView(PCD_HandleTypeDef *hpcd,
+                                          uint8_t ep_addr,
+                                          uint16_t offset,
+                                          uint8_t *pBuf,
+                                          uint16_t len);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamples(PCD_HandleTypeDef *hpcd,
+                                             uint8_t ep_addr,
+                                             uint16_t offset,
+                                             int16_t *pDst,
+                                             uint16_t count,
+                                             int32_t gain);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamplesF32(PCD_HandleTypeDef *hpcd,
+                                                uint8_t ep_addr,
+                                                uint16_t offset,
+                                                float *pDst,
+                                                uint16_t count,
+                                                float scale);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_TxReserve(PCD_HandleTypeDef *hpcd,
+                                         uint8_t ep_addr,
+                                         PCD_PMAWriterTypeDef *w);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_TxCommit(PCD_HandleTypeDef *hpcd,
+                                        uint8_t ep_addr,
+                                        PCD_PMAWriterTypeDef *w);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_SetCallback(PCD_HandleTypeDef *hpcd,
+                                           uint8_t ep_addr,
+                                           PCD_EPCallbackTypeDef callback);
+
+HAL_StatusTypeDef HAL_PCDEx_EnableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it);
+HAL_StatusTypeDef HAL_PCDEx_DisableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it);
+
 void HAL_PCDEx_SetConnectionState(PCD_HandleTypeDef *hpcd, uint8_t state);
 
+#if (PCD_PMA_DMA == 1)
+HAL_StatusTypeDef HAL_PCDEx_SetPMADma(PCD_HandleTypeDef *hpcd,
+                                      DMA_TypeDef *dma,
+                                      DMA_Channel_TypeDef *channel,
+                                      uint8_t chnum);
+#endif /* PCD_PMA_DMA */
+
+#if defined(USB_LPMCSR_LMPEN)
+HAL_StatusTypeDef HAL_PCDEx_ActivateLPM(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCDEx_DeActivateLPM(PCD_HandleTypeDef *hpcd);
+void HAL_PCDEx_LPM_Callback(PCD_HandleTypeDef *hpcd, PCD_LPM_MsgTypeDef msg);
+#endif /* USB_LPMCSR_LMPEN */
+
 /**
   * @}
   */ 
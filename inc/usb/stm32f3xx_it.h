@@ -60,8 +60,10 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 #if defined (USE_USB_INTERRUPT_DEFAULT)
 void USB_LP_CAN_RX0_IRQHandler(void);
+void USB_HP_CAN_TX_IRQHandler(void);
 #elif defined (USE_USB_INTERRUPT_REMAPPED)
 void USB_LP_IRQHandler(void);
+void USB_HP_IRQHandler(void);
 #endif
 void USARTx_DMA_RX_IRQHandler(void);
 void USARTx_DMA_TX_IRQHandler(void);
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal.h
+  * @brief   The part of the STM32CubeF4 HAL driver (V1.7.x) interface that
+  *          the PCD driver and the USB stack use, the counterpart of
+  *          stm32f3xx_hal.h. The functions are not implemented here: link
+  *          stm32f4xx_hal.c and stm32f4xx_hal_rcc.c of the vendor HAL, or
+  *          provide HAL_Delay/HAL_GetTick from the application (usb_tick.c)
+  *          and HAL_RCC_GetHCLKFreq from the clock setup.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal_conf.h"
+#include "stm32f4xx_hal_def.h"
+
+/* Exported functions --------------------------------------------------------*/
+/* stm32f4xx_hal.c */
+void     HAL_IncTick(void);
+void     HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+
+/* stm32f4xx_hal_rcc.c, used for the turnaround time of the OTG core */
+uint32_t HAL_RCC_GetHCLKFreq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_H */
@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal_conf.h
+  * @brief   HAL configuration for the STM32F4 build of the USB stack, the
+  *          counterpart of stm32f3xx_hal_conf.h. Only the PCD module is
+  *          selected, it is the driver in src/usb/stm32f4xx_hal_pcd.c; the
+  *          other modules (RCC, GPIO, CORTEX...) come with the STM32CubeF4
+  *          HAL driver V1.7.x, the release of the CMSIS device headers in
+  *          inc/stm32f4xx, which is not part of this repository.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F4xx_HAL_CONF_H
+#define __STM32F4xx_HAL_CONF_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* ########################## Module Selection ############################## */
+#define HAL_MODULE_ENABLED
+#define HAL_PCD_MODULE_ENABLED
+
+/* ########################## HSE/HSI Values adaptation ##################### */
+#if !defined  (HSE_VALUE)
+  #define HSE_VALUE    (8000000U) /*!< Value of the External oscillator in Hz */
+#endif /* HSE_VALUE */
+
+#if !defined  (HSI_VALUE)
+  #define HSI_VALUE    (16000000U) /*!< Value of the Internal oscillator in Hz */
+#endif /* HSI_VALUE */
+
+/* ########################### System Configuration ######################### */
+#define  VDD_VALUE                    (3300U) /*!< Value of VDD in mv */
+#define  TICK_INT_PRIORITY            0x0FU
+#define  USE_RTOS                     0U
+
+/* Includes ------------------------------------------------------------------*/
+#ifdef HAL_PCD_MODULE_ENABLED
+ #include "stm32f4xx_hal_pcd.h"
+#endif /* HAL_PCD_MODULE_ENABLED */
+
+/* Exported macro ------------------------------------------------------------*/
+#define assert_param(expr) ((void)0U)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_CONF_H */
@@ -0,0 +1,386 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal_pcd.h
+  * @brief   Header file of the PCD driver for the STM32F4 OTG_FS and OTG_HS
+  *          cores, device mode. It keeps the interface of stm32f3xx_hal_pcd.h: the same handle,
+  *          endpoint and callback names, so the USBD_LL_* glue and the
+  *          classes above it build for either family. Replaces the PCD and
+  *          USB LL modules of the STM32F4 HAL, which must be left out.
+  *
+  *          Differences from the F3 driver:
+  *          - packets go through the FIFOs of the core instead of PMA: the
+  *            FIFO RAM is split with HAL_PCDEx_SetRxFiFo/HAL_PCDEx_SetTxFiFo
+  *            before HAL_PCD_Start, HAL_PCDEx_PMAConfig does nothing;
+  *          - OUT transfers always copy: HAL_PCD_EP_Receive rejects a NULL
+  *            buffer, so USBD_CDC_ZERO_COPY_RX cannot be used;
+  *          - PCD_DEFERRED_EVENTS is not supported.
+  *
+  *          OTG_HS runs at high speed through a ULPI PHY (phy_itface
+  *          PCD_PHY_ULPI, speed PCD_SPEED_HIGH) or at full speed on either
+  *          PHY. With dma_enable set the internal DMA of the core moves the
+  *          packets: buffers given to HAL_PCD_EP_Transmit/HAL_PCD_EP_Receive
+  *          on the other endpoints must then be word aligned, outside CCM
+  *          RAM, and OUT buffers must hold whole packets. Endpoint 0 goes
+  *          through a bounce buffer and takes any buffer.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F4xx_HAL_PCD_H
+#define __STM32F4xx_HAL_PCD_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal_def.h"
+
+#if defined(USB_OTG_FS)
+
+/** @addtogroup STM32F4xx_HAL_Driver
+  * @{
+  */
+
+/** @addtogroup PCD
+  * @{
+  */
+
+/* Length of the resume signalling of HAL_PCD_StartRemoteWakeup, 1 to 15 ms */
+#ifndef PCD_REMOTE_WAKEUP_MS
+#define PCD_REMOTE_WAKEUP_MS                10U
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+/** @defgroup PCD_Exported_Types PCD Exported Types
+  * @{
+  */
+
+/**
+  * @brief  PCD State structure definition
+  */
+typedef enum
+{
+  HAL_PCD_STATE_RESET   = 0x00U,
+  HAL_PCD_STATE_READY   = 0x01U,
+  HAL_PCD_STATE_ERROR   = 0x02U,
+  HAL_PCD_STATE_BUSY    = 0x03U,
+  HAL_PCD_STATE_TIMEOUT = 0x04U
+} PCD_StateTypeDef;
+
+/**
+  * @brief  PCD Initialization Structure definition
+  */
+typedef struct
+{
+  uint32_t dev_endpoints;        /*!< Device Endpoints number, including endpoint 0.
+                                      This parameter must be a number between Min_Data = 1 and Max_Data = 6 */
+
+  uint32_t speed;                /*!< USB Core speed. Overwritten with the speed the host picked,
+                                      PCD_SPEED_HIGH or PCD_SPEED_FULL, on each bus reset before
+                                      HAL_PCD_ResetCallback: set it again before a new HAL_PCD_Init.
+                                      This parameter can be any value of @ref PCD_Core_Speed                 */
+
+  uint32_t ep0_mps;              /*!< Set the Endpoint 0 Max Packet size.
+                                      This parameter can be any value of @ref PCD_EP0_MPS                    */
+
+  uint32_t phy_itface;           /*!< Select the used PHY interface.
+                                      This parameter can be any value of @ref PCD_Core_PHY                   */
+
+  uint32_t Sof_enable;           /*!< Enable or disable the output of the SOF signal.
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+  uint32_t low_power_enable;     /*!< Enable or disable Low Power mode
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+  uint32_t lpm_enable;           /*!< Enable or disable the Link Power Management .
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+  uint32_t battery_charging_enable; /*!< Enable or disable Battery charging.
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+  uint32_t vbus_sensing_enable;  /*!< Enable or disable the VBUS sensing on PA9, DISABLE when the pin is
+                                      used for something else.
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+  uint32_t dma_enable;           /*!< Enable or disable the internal DMA of the core, OTG_HS only.
+                                      This parameter can be set to ENABLE or DISABLE                      */
+
+}PCD_InitTypeDef;
+
+struct __PCD_HandleTypeDef;
+
+/**
+  * @brief  Transfer completion handler of an endpoint, called with the pData
+  *         member of the PCD handle instead of the Data Stage callbacks
+  */
+typedef uint8_t (*PCD_EPCallbackTypeDef)(void *pData, uint8_t epnum);
+
+typedef struct __PCD_EPTypeDef
+{
+  uint8_t   num;            /*!< Endpoint number
+                                This parameter must be a number between Min_Data = 1 and Max_Data = 15    */
+
+  uint8_t   is_in;          /*!< Endpoint direction
+                                This parameter must be a number between Min_Data = 0 and Max_Data = 1     */
+
+  uint8_t   is_stall;       /*!< Endpoint stall condition
+                                This parameter must be a number between Min_Data = 0 and Max_Data = 1     */
+
+  uint8_t   type;           /*!< Endpoint type
+                                 This parameter can be any value of @ref PCD_EP_Type                      */
+
+  uint32_t  maxpacket;      /*!< Endpoint Max packet size
+                                 This parameter must be a number between Min_Data = 0 and Max_Data = 64KB */
+
+  uint8_t   *xfer_buff;     /*!< Pointer to the next byte to push to or pop from the FIFO                 */
+
+  uint32_t  xfer_len;       /*!< Current transfer length                                                  */
+
+  uint32_t  xfer_count;     /*!< Bytes of the transfer pushed to or popped from the FIFO so far           */
+
+  uint32_t  xfer_size;      /*!< End of the part of the transfer programmed into the endpoint: one packet
+                                 on endpoint 0, up to PCD_EP_MAX_PKTCNT packets on the others             */
+
+  PCD_EPCallbackTypeDef xfer_cb; /*!< Completion handler set by HAL_PCDEx_EP_SetCallback, NULL for the
+                                      Data Stage callbacks                                                */
+
+}PCD_EPTypeDef;
+
+typedef   USB_OTG_GlobalTypeDef PCD_TypeDef;
+
+/**
+  * @brief  PCD Handle Structure definition
+  */
+typedef struct __PCD_HandleTypeDef
+{
+  PCD_TypeDef             *Instance;   /*!< Register base address              */
+  PCD_InitTypeDef         Init;       /*!< PCD required parameters            */
+  __IO uint8_t            USB_Address; /*!< USB Address            */
+  PCD_EPTypeDef           IN_ep[16];  /*!< IN endpoint parameters             */
+  PCD_EPTypeDef           OUT_ep[16]; /*!< OUT endpoint parameters            */
+  HAL_LockTypeDef         Lock;       /*!< PCD peripheral status              */
+  __IO PCD_StateTypeDef   State;      /*!< PCD communication state            */
+  uint32_t                Setup[12];  /*!< Setup packet buffer                */
+  uint32_t                EP0_Buf[16]; /*!< DMA mode: bounce buffer of the endpoint 0 packets */
+  void                    *pData;      /*!< Pointer to upper stack Handler     */
+
+} PCD_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/* Include PCD HAL Extension module */
+#include "stm32f4xx_hal_pcd_ex.h"
+
+/* Exported constants --------------------------------------------------------*/
+/** @defgroup PCD_Exported_Constants PCD Exported Constants
+  * @{
+  */
+
+/** @defgroup PCD_Core_Speed PCD Core Speed
+  * @{
+  */
+#define PCD_SPEED_HIGH               0U /* OTG_HS with a ULPI PHY */
+#define PCD_SPEED_HIGH_IN_FULL       1U /* OTG_HS with a ULPI PHY, held at full speed */
+#define PCD_SPEED_FULL               2U
+/**
+  * @}
+  */
+
+  /** @defgroup PCD_Core_PHY PCD Core PHY
+  * @{
+  */
+#define PCD_PHY_ULPI                 1U
+#define PCD_PHY_EMBEDDED             2U
+/**
+  * @}
+  */
+
+/** @defgroup PCD_EP0_MPS PCD EP0 MPS
+  * @{
+  */
+#define DEP0CTL_MPS_64                         0U
+#define DEP0CTL_MPS_32                         1U
+#define DEP0CTL_MPS_16                         2U
+#define DEP0CTL_MPS_8                          3U
+
+#define PCD_EP0MPS_64                          DEP0CTL_MPS_64
+#define PCD_EP0MPS_32                          DEP0CTL_MPS_32
+#define PCD_EP0MPS_16                          DEP0CTL_MPS_16
+#define PCD_EP0MPS_08                          DEP0CTL_MPS_8
+/**
+  * @}
+  */
+
+/** @defgroup PCD_EP_Type PCD EP Type
+  * @{
+  */
+#define PCD_EP_TYPE_CTRL                       0U
+#define PCD_EP_TYPE_ISOC                       1U
+#define PCD_EP_TYPE_BULK                       2U
+#define PCD_EP_TYPE_INTR                       3U
+/**
+  * @}
+  */
+
+/** @defgroup PCD_ENDP PCD ENDP
+  * @{
+  */
+#define PCD_ENDP0                              ((uint8_t)0U)
+#define PCD_ENDP1                              ((uint8_t)1U)
+#define PCD_ENDP2                              ((uint8_t)2U)
+#define PCD_ENDP3                              ((uint8_t)3U)
+#define PCD_ENDP4                              ((uint8_t)4U)
+#define PCD_ENDP5                              ((uint8_t)5U)
+/**
+  * @}
+  */
+
+/** @defgroup PCD_ENDP_Kind PCD Endpoint Kind
+  * @{
+  */
+#define PCD_SNG_BUF                            0U
+#define PCD_DBL_BUF                            1U
+/**
+  * @}
+  */
+
+/* Largest packet count of one programmed part of a transfer */
+#define PCD_EP_MAX_PKTCNT                      1023U
+/**
+  * @}
+  */
+
+/** @defgroup USB_EXTI_Line_Interrupt USB EXTI line interrupt
+  * @{
+  */
+#define USB_OTG_FS_WAKEUP_EXTI_LINE            ((uint32_t)EXTI_IMR_MR18)  /*!< External interrupt line 18 Connected to the USB OTG FS EXTI Line */
+#define USB_OTG_HS_WAKEUP_EXTI_LINE            ((uint32_t)EXTI_IMR_MR20)  /*!< External interrupt line 20 Connected to the USB OTG HS EXTI Line */
+/**
+  * @}
+  */
+
+/* Exported macros -----------------------------------------------------------*/
+/** @defgroup PCD_Exported_Macros PCD Exported Macros
+ *  @brief macros to handle interrupts and specific clock configurations
+  * @{
+  */
+#define __HAL_PCD_GET_FLAG(__HANDLE__, __INTERRUPT__)      ((((__HANDLE__)->Instance->GINTSTS) & (__INTERRUPT__)) == (__INTERRUPT__))
+#define __HAL_PCD_CLEAR_FLAG(__HANDLE__, __INTERRUPT__)    (((__HANDLE__)->Instance->GINTSTS) = (__INTERRUPT__))
+
+#define __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_IT()           EXTI->IMR |= USB_OTG_FS_WAKEUP_EXTI_LINE
+#define __HAL_USB_OTG_FS_WAKEUP_EXTI_DISABLE_IT()          EXTI->IMR &= ~(USB_OTG_FS_WAKEUP_EXTI_LINE)
+#define __HAL_USB_OTG_FS_WAKEUP_EXTI_GET_FLAG()            EXTI->PR & (USB_OTG_FS_WAKEUP_EXTI_LINE)
+#define __HAL_USB_OTG_FS_WAKEUP_EXTI_CLEAR_FLAG()          EXTI->PR = USB_OTG_FS_WAKEUP_EXTI_LINE
+#define __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_RISING_EDGE()  do {\
+                                                           EXTI->FTSR &= ~(USB_OTG_FS_WAKEUP_EXTI_LINE);\
+                                                           EXTI->RTSR |= USB_OTG_FS_WAKEUP_EXTI_LINE;\
+                                                         } while(0U)
+
+#define __HAL_USB_OTG_HS_WAKEUP_EXTI_ENABLE_IT()           EXTI->IMR |= USB_OTG_HS_WAKEUP_EXTI_LINE
+#define __HAL_USB_OTG_HS_WAKEUP_EXTI_DISABLE_IT()          EXTI->IMR &= ~(USB_OTG_HS_WAKEUP_EXTI_LINE)
+#define __HAL_USB_OTG_HS_WAKEUP_EXTI_GET_FLAG()            EXTI->PR & (USB_OTG_HS_WAKEUP_EXTI_LINE)
+#define __HAL_USB_OTG_HS_WAKEUP_EXTI_CLEAR_FLAG()          EXTI->PR = USB_OTG_HS_WAKEUP_EXTI_LINE
+#define __HAL_USB_OTG_HS_WAKEUP_EXTI_ENABLE_RISING_EDGE()  do {\
+                                                           EXTI->FTSR &= ~(USB_OTG_HS_WAKEUP_EXTI_LINE);\
+                                                           EXTI->RTSR |= USB_OTG_HS_WAKEUP_EXTI_LINE;\
+                                                         } while(0U)
+/**
+  * @}
+  */
+
+/* Exported functions --------------------------------------------------------*/
+/** @addtogroup PCD_Exported_Functions PCD Exported Functions
+  * @{
+  */
+
+/* Initialization/de-initialization functions  ********************************/
+/** @addtogroup PCD_Exported_Functions_Group1 Initialization and de-initialization functions
+  * @{
+  */
+HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_DeInit (PCD_HandleTypeDef *hpcd);
+void HAL_PCD_MspInit(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd);
+/**
+  * @}
+  */
+
+/* I/O operation functions  ***************************************************/
+/* Non-Blocking mode: Interrupt */
+/** @addtogroup PCD_Exported_Functions_Group2 IO operation functions
+  * @{
+  */
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd);
+
+void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_ResumeCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_ISOOUTIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_ISOINIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_ConnectCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd);
+/**
+  * @}
+  */
+
+/* Peripheral Control functions  **********************************************/
+/** @addtogroup PCD_Exported_Functions_Group3 Peripheral Control functions
+  * @{
+  */
+HAL_StatusTypeDef HAL_PCD_DevConnect(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_DevDisconnect(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd, uint8_t address);
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint16_t ep_mps, uint8_t ep_type);
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len);
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const uint8_t *pBuf, uint32_t len);
+uint16_t          HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_ActivateRemoteWakeup(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_DeActivateRemoteWakeup(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_StartRemoteWakeup(PCD_HandleTypeDef *hpcd);
+/**
+  * @}
+  */
+
+/* Peripheral State functions  ************************************************/
+/** @addtogroup PCD_Exported_Functions_Group4 Peripheral State functions
+  * @{
+  */
+PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_OTG_FS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_PCD_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
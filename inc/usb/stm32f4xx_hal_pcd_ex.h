@@ -0,0 +1,151 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal_pcd_ex.h
+  * @brief   Header file of the PCD Extension module for the STM32F4 OTG_FS
+  *          and OTG_HS cores.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F4xx_HAL_PCD_EX_H
+#define __STM32F4xx_HAL_PCD_EX_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal_def.h"
+
+#if defined(USB_OTG_FS)
+
+/** @addtogroup STM32F4xx_HAL_Driver
+  * @{
+  */
+
+/** @addtogroup PCDEx
+  * @{
+  */
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/** @defgroup PCDEx_Exported_Constants PCD Extended Exported Constants
+  * @{
+  */
+/* FIFO RAM of the OTG_FS and OTG_HS cores, in 32-bit words */
+#define PCDEx_FIFO_WORDS                       320U
+#define PCDEx_HS_FIFO_WORDS                    1024U
+
+/* Smallest transmit FIFO the core accepts, in words */
+#define PCDEx_TX_FIFO_MIN_WORDS                16U
+
+/* Optional interrupts, for HAL_PCDEx_EnableInterrupts and
+   HAL_PCDEx_DisableInterrupts. The OTG core has no ESOF or PMA overrun. */
+#define PCD_IT_SOF                             USB_OTG_GINTMSK_SOFM    /* Start of frame, HAL_PCD_SOFCallback */
+#define PCD_IT_ERR                             USB_OTG_GINTMSK_MMISM   /* Mode mismatch, for USB_STATS_ENABLED */
+#define PCD_IT_ALL                             (PCD_IT_SOF | PCD_IT_ERR)
+/**
+  * @}
+  */
+
+/* Exported macros -----------------------------------------------------------*/
+/** @defgroup PCDEx_Exported_Macros PCD Extended Exported Macros
+  * @{
+  */
+/**
+  * @brief  Receive FIFO size, in words, for HAL_PCDEx_SetRxFiFo.
+  * @note   Reference manual sizing: the SETUP packets of the control
+  *         endpoint, the largest packet with its status word, two words per
+  *         OUT endpoint and one for the global OUT NAK. pkts above 1 leaves
+  *         room for further packets, so the host can send the next one
+  *         while the interrupt is still popping the previous one.
+  * @param  mps largest OUT max packet size, bytes
+  * @param  out_eps number of OUT endpoints, endpoint 0 included
+  * @param  pkts number of largest packets the FIFO holds
+  * @retval FIFO size in words
+  */
+#define PCDEx_RX_FIFO_WORDS(mps, out_eps, pkts) \
+  (13U + ((pkts) * ((((mps) + 3U) / 4U) + 1U)) + (2U * (out_eps)) + 1U)
+
+/**
+  * @brief  Transmit FIFO size, in words, for HAL_PCDEx_SetTxFiFo.
+  * @note   With pkts at 2 the next packet is pushed while the previous one
+  *         is still on the bus.
+  * @param  mps max packet size of the IN endpoint, bytes
+  * @param  pkts number of packets the FIFO holds
+  * @retval FIFO size in words
+  */
+#define PCDEx_TX_FIFO_WORDS(mps, pkts) \
+  ((((pkts) * (((mps) + 3U) / 4U)) > PCDEx_TX_FIFO_MIN_WORDS) ? \
+   ((pkts) * (((mps) + 3U) / 4U)) : PCDEx_TX_FIFO_MIN_WORDS)
+/**
+  * @}
+  */
+
+/* Exported functions --------------------------------------------------------*/
+/** @addtogroup PCDEx_Exported_Functions PCDEx Exported Functions
+  * @{
+  */
+/** @addtogroup PCDEx_Exported_Functions_Group1 Peripheral Control functions
+  * @{
+  */
+HAL_StatusTypeDef HAL_PCDEx_SetRxFiFo(PCD_HandleTypeDef *hpcd, uint16_t size);
+
+HAL_StatusTypeDef HAL_PCDEx_SetTxFiFo(PCD_HandleTypeDef *hpcd, uint8_t fifo, uint16_t size);
+
+HAL_StatusTypeDef HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
+                                     uint16_t ep_addr,
+                                     uint16_t ep_kind,
+                                     uint32_t pmaadress);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxView(PCD_HandleTypeDef *hpcd,
+                                          uint8_t ep_addr,
+                                          uint16_t offset,
+                                          uint8_t *pBuf,
+                                          uint16_t len);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamples(PCD_HandleTypeDef *hpcd,
+                                             uint8_t ep_addr,
+                                             uint16_t offset,
+                                             int16_t *pDst,
+                                             uint16_t count,
+                                             int32_t gain);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamplesF32(PCD_HandleTypeDef *hpcd,
+                                                uint8_t ep_addr,
+                                                uint16_t offset,
+                                                float *pDst,
+                                                uint16_t count,
+                                                float scale);
+
+HAL_StatusTypeDef HAL_PCDEx_EP_SetCallback(PCD_HandleTypeDef *hpcd,
+                                           uint8_t ep_addr,
+                                           PCD_EPCallbackTypeDef callback);
+
+HAL_StatusTypeDef HAL_PCDEx_EnableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it);
+HAL_StatusTypeDef HAL_PCDEx_DisableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it);
+
+void HAL_PCDEx_SetConnectionState(PCD_HandleTypeDef *hpcd, uint8_t state);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_OTG_FS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_PCD_EX_H */
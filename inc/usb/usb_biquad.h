@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    usb_biquad.h
+  * @brief   Biquad cascades over interleaved multi-channel blocks.
+  *          The same filters as arm_biquad_cascade_df2T_f32 and
+  *          arm_biquad_cascade_df1_q15, run on every channel of an
+  *          interleaved USB sample payload without splitting it first:
+  *          each stage walks the frames of one channel at a time with that
+  *          channel's state held in registers for the whole block, and
+  *          reads the payload in place. In place operation (pSrc == pDst)
+  *          is supported, as in CMSIS.
+  *
+  *          Coefficients have the CMSIS layout, per stage:
+  *            f32  b0 b1 b2 a1 a2              (a1, a2 negated, df2T)
+  *            q15  b0 0 b1 b2 a1 a2            (word aligned, postShift)
+  *          coeffStride 0 runs all channels through one set; otherwise
+  *          channel c uses the set at pCoeffs + c * coeffStride.
+  *
+  *          The q15 kernel keeps x[n-1], x[n-2] and y[n-1], y[n-2] of the
+  *          channel packed in two words: on Cortex-M4 and M7 each output is
+  *          two __SMLALD dual MACs into a 64-bit accumulator and two
+  *          __PKHBT updates of the state. That path needs the coefficients
+  *          and state word aligned and falls back to one halfword at a time
+  *          otherwise, or on other cores.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_BIQUAD_H
+#define __USB_BIQUAD_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Biquad
+  * @brief Interleaved biquad cascades
+  * @{
+  */
+
+/** @defgroup USB_Biquad_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint8_t      numStages;
+  uint8_t      numChannels;
+  uint16_t     coeffStride;   /* 0, or 5 * numStages for a set per channel */
+  float       *pState;        /* d1, d2 per stage per channel: 2 * numStages * numChannels */
+  const float *pCoeffs;
+} USB_Biquad_F32TypeDef;
+
+typedef struct
+{
+  uint8_t        numStages;
+  uint8_t        numChannels;
+  uint16_t       coeffStride; /* 0, or 6 * numStages for a set per channel */
+  int8_t         postShift;
+  int16_t       *pState;      /* x1 x2 y1 y2 per stage per channel: 4 * numStages * numChannels */
+  const int16_t *pCoeffs;
+} USB_Biquad_Q15TypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Biquad_Exported_Functions
+  * @{
+  */
+void USB_Biquad_Init_f32(USB_Biquad_F32TypeDef *S, uint8_t numStages,
+                         uint8_t numChannels, uint16_t coeffStride,
+                         const float *pCoeffs, float *pState);
+void USB_Biquad_f32(const USB_Biquad_F32TypeDef *S, const float *pSrc,
+                    float *pDst, uint32_t frames);
+
+void USB_Biquad_Init_q15(USB_Biquad_Q15TypeDef *S, uint8_t numStages,
+                         uint8_t numChannels, uint16_t coeffStride,
+                         const int16_t *pCoeffs, int16_t *pState,
+                         int8_t postShift);
+void USB_Biquad_q15(const USB_Biquad_Q15TypeDef *S, const int16_t *pSrc,
+                    int16_t *pDst, uint32_t frames);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_BIQUAD_H */
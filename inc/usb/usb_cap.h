@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file    usb_cap.h
+  * @brief   Packet capture of the USB device into a RAM ring, with a pcap
+  *          export.
+  *          With USB_CAP_ENABLED set to 1 the F3 PCD driver records every
+  *          SETUP packet, every packet moved on an endpoint and every
+  *          STALL into a ring of USB_CAP_RECORDS records: DWT cycle
+  *          timestamp, endpoint address, endpoint type, length and the
+  *          first USB_CAP_DATA_SIZE bytes of the packet. Recording is a
+  *          copy of at most USB_CAP_DATA_SIZE bytes with interrupts masked;
+  *          the ring overwrites its oldest records. With it left at 0
+  *          every hook expands to nothing.
+  *
+  *          A trigger stops the ring USB_CAP_POST_TRIGGER records after the
+  *          event, keeping what led to it:
+  *            USB_CAP_TRIG_STALL  any STALL
+  *            USB_CAP_TRIG_SIZE   a packet on the trigger endpoint whose
+  *                                length is not the trigger size
+  *          USB_Cap_Stop stops it by hand.
+  *
+  *          A stopped ring reads out with USB_Cap_Read as a pcap file of
+  *          link type LINKTYPE_USB_LINUX_MMAPPED (usbmon), which Wireshark
+  *          opens: SETUP packets as control submissions, OUT data as
+  *          submissions, IN data as completions, a STALL as a completion
+  *          with -EPIPE. USB_Cap_PumpCdc streams it on a CDC instance,
+  *          usually the second one, from the main loop through the
+  *          transmit ring (USBD_CDC_TX_RING_SIZE); tools/usb_cap.py saves
+  *          it on the host.
+  *
+  *          The including file must already have the CMSIS core header of
+  *          the device in scope (DWT). Timestamps are unwrapped from one
+  *          record to the next, so gaps of more than a minute at 72 MHz
+  *          come out short.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CAP_H
+#define __USB_CAP_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+struct _USBD_HandleTypeDef;
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Cap
+  * @brief USB packet capture
+  * @{
+  */
+
+/** @defgroup USB_Cap_Exported_Defines
+  * @{
+  */
+#ifndef USB_CAP_ENABLED
+#define USB_CAP_ENABLED                             0
+#endif
+
+/* Records of the ring, a power of two */
+#ifndef USB_CAP_RECORDS
+#define USB_CAP_RECORDS                             64U
+#endif
+
+/* Bytes of each packet kept, a multiple of 4; 8 holds a SETUP packet */
+#ifndef USB_CAP_DATA_SIZE
+#define USB_CAP_DATA_SIZE                           16U
+#endif
+
+/* Records taken after the trigger */
+#ifndef USB_CAP_POST_TRIGGER
+#define USB_CAP_POST_TRIGGER                        8U
+#endif
+
+#if ((USB_CAP_RECORDS & (USB_CAP_RECORDS - 1U)) != 0U)
+#error "USB_CAP_RECORDS must be a power of two"
+#endif
+#if ((USB_CAP_DATA_SIZE < 8U) || ((USB_CAP_DATA_SIZE & 3U) != 0U))
+#error "USB_CAP_DATA_SIZE must be a multiple of 4, 8 at least"
+#endif
+
+/* Record kinds */
+#define USB_CAP_SETUP                               0U
+#define USB_CAP_DATA                                1U
+#define USB_CAP_STALL                               2U
+
+/* Triggers, for USB_Cap_SetTrigger */
+#define USB_CAP_TRIG_STALL                          0x01U
+#define USB_CAP_TRIG_SIZE                           0x02U
+/**
+  * @}
+  */
+
+/** @defgroup USB_Cap_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t cycles;              /* DWT->CYCCNT */
+  uint16_t length;              /* of the packet */
+  uint8_t  ep_addr;             /* direction in bit 7 */
+  uint8_t  kind;                /* USB_CAP_xxx | endpoint type << 4, bit 7
+                                   when the bytes were not at hand */
+  uint8_t  data[USB_CAP_DATA_SIZE];
+} USB_CapRecordTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_CAP_ENABLED == 1)
+
+/** @defgroup USB_Cap_Exported_Functions
+  * @{
+  */
+void     USB_Cap_Init(void);
+void     USB_Cap_SetTrigger(uint32_t triggers, uint8_t ep_addr, uint16_t size);
+void     USB_Cap_Stop(void);
+void     USB_Cap_Restart(void);
+uint8_t  USB_Cap_Stopped(void);
+uint32_t USB_Cap_Read(uint8_t *buf, uint32_t len);
+void     USB_Cap_Packet(uint8_t ep_addr, uint8_t kind, uint8_t type,
+                        const uint8_t *pbuf, uint16_t length);
+#if !defined(USB_OTG_FS)
+void     USB_Cap_PacketPMA(USB_TypeDef *USBx, uint8_t ep_addr, uint8_t type,
+                           uint16_t pma, uint16_t length);
+#endif
+void     USB_Cap_PumpCdc(struct _USBD_HandleTypeDef *pdev, int instance);
+/**
+  * @}
+  */
+
+#define USB_CAP_SETUP_PACKET(setup)                 USB_Cap_Packet((setup)[0] & 0x80U, USB_CAP_SETUP, 0U, (setup), 8U)
+#define USB_CAP_OUT(ep, pbuf, n)                    USB_Cap_Packet((ep)->num, USB_CAP_DATA, (ep)->type, (pbuf), (n))
+#define USB_CAP_OUT_PMA(USBx, ep, pma, n)           USB_Cap_PacketPMA((USBx), (ep)->num, (ep)->type, (pma), (n))
+#define USB_CAP_IN(ep, pbuf, n)                     USB_Cap_Packet((ep)->num | 0x80U, USB_CAP_DATA, (ep)->type, (pbuf), (n))
+#define USB_CAP_STALL_EP(ep)                        USB_Cap_Packet((ep)->num | ((ep)->is_in ? 0x80U : 0U), \
+                                                                   USB_CAP_STALL, (ep)->type, NULL, 0U)
+
+#else
+
+#define USB_CAP_SETUP_PACKET(setup)
+#define USB_CAP_OUT(ep, pbuf, n)
+#define USB_CAP_OUT_PMA(USBx, ep, pma, n)
+#define USB_CAP_IN(ep, pbuf, n)
+#define USB_CAP_STALL_EP(ep)
+
+#endif /* USB_CAP_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_CAP_H */
@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * @file    usb_ccm.h
+  * @brief   USB fast path in the CCM SRAM of the STM32F303.
+  *          With USB_CCM_ENABLED set to 1, the functions every packet goes
+  *          through are placed in section .ccmram.usb, run from the core
+  *          coupled memory without flash wait states:
+  *            - HAL_PCD_IRQHandler, HAL_PCD_HP_IRQHandler and the endpoint
+  *              service of the PCD, HAL_PCD_EP_Transmit/Receive,
+  *            - PCD_WritePMA and PCD_ReadPMA,
+  *            - the DataIn, DataOut and SOF callbacks of the CDC class and
+  *              USBD_CDC_TransmitPacket/TransmitBuffer.
+  *          With USB_CCM_RINGS set to 1 as well, the CDC class handle, which
+  *          holds the TX and RX rings, goes to section .ccmbss.usb. CCM is
+  *          not reachable by DMA: nothing in it may be a DMA buffer.
+  *
+  *          The linker script needs both sections in CCM, with the symbols
+  *          below, for example:
+  *
+  *            CCMRAM (xrw) : ORIGIN = 0x10000000, LENGTH = 8K
+  *
+  *            .ccmram :
+  *            {
+  *              . = ALIGN(4);
+  *              _sccmram = .;
+  *              *(.ccmram)
+  *              *(.ccmram*)
+  *              . = ALIGN(4);
+  *              _eccmram = .;
+  *            } >CCMRAM AT> FLASH
+  *            _siccmram = LOADADDR(.ccmram);
+  *
+  *            .ccmbss (NOLOAD) :
+  *            {
+  *              . = ALIGN(4);
+  *              _sccmbss = .;
+  *              *(.ccmbss)
+  *              *(.ccmbss*)
+  *              . = ALIGN(4);
+  *              _eccmbss = .;
+  *            } >CCMRAM
+  *
+  *          The .ccmram part is the one of the STM32CubeIDE scripts. Call
+  *          USB_CCM_Init before anything else of the USB stack, from the
+  *          reset handler or at the top of main; a startup file that
+  *          already copies .ccmram makes the copy redundant, not wrong.
+  *          Calls between CCM and flash are beyond the reach of BL and go
+  *          through veneers the linker adds.
+  *
+  *          tools/ccm_report.py lists what the build put in CCM and checks
+  *          it against the size of the part.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CCM_H
+#define __USB_CCM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_CCM
+  * @brief USB fast path placement in CCM SRAM
+  * @{
+  */
+
+/** @defgroup USB_CCM_Exported_Defines
+  * @{
+  */
+#ifndef USB_CCM_ENABLED
+#define USB_CCM_ENABLED                             0
+#endif
+
+#ifndef USB_CCM_RINGS
+#define USB_CCM_RINGS                               0
+#endif
+
+#if (USB_CCM_ENABLED == 1)
+
+#if !defined(STM32F303xC) && !defined(STM32F303xE)
+#error "USB_CCM_ENABLED needs a part with USB and executable CCM SRAM"
+#endif
+
+#define USB_CCM_FUNC                                __attribute__((section(".ccmram.usb")))
+#if (USB_CCM_RINGS == 1)
+#define USB_CCM_DATA                                __attribute__((section(".ccmbss.usb")))
+#else
+#define USB_CCM_DATA
+#endif
+
+#else
+
+#define USB_CCM_FUNC
+#define USB_CCM_DATA
+
+#endif /* USB_CCM_ENABLED */
+/**
+  * @}
+  */
+
+#if (USB_CCM_ENABLED == 1)
+
+/** @defgroup USB_CCM_Exported_Functions
+  * @{
+  */
+void USB_CCM_Init(void);
+/**
+  * @}
+  */
+
+#endif /* USB_CCM_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_CCM_H */
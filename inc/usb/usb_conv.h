@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file    usb_conv.h
+  * @brief   Streaming FIR convolution by overlap-save over the real FFT.
+  *          For filters of hundreds of taps, where arm_fir_f32 costs
+  *          numTaps multiply-accumulates per sample. Each block of
+  *          blockSize samples is one arm_rfft_fast_f32 of the last fftLen
+  *          input samples, a product with the spectrum of the filter,
+  *          computed once by USB_Conv_Init_f32, and the inverse transform;
+  *          the last blockSize samples of the result are the filter output.
+  *          With fftLen 1024, 512 taps and blocks of 512, that is under a
+  *          hundred cycles per sample on a Cortex-M4F instead of 512 MACs.
+  *
+  *          blockSize is free up to fftLen - numTaps + 1, so it can be a
+  *          whole number of CDC packets. USB_Conv_f32 takes any count of
+  *          samples, one packet at a time for example, and returns as many:
+  *          the output is that of arm_fir_f32 over the same coefficients,
+  *          delayed by blockSize samples, the first blockSize being zero.
+  *          The state holds USB_CONV_STATE_SIZE(fftLen) floats: the filter
+  *          spectrum, the input history, and two transform buffers.
+  *
+  *          The FFT is set up with USB_FFT_RfftInit_f32 when USB_FFT_ENABLED
+  *          is set, see usb_fft.h, with arm_rfft_fast_init_f32 otherwise.
+  *
+  *          Set USB_CONV_ENABLED to 1 to build the module; the build must
+  *          then define the ARM_MATH_CMx of the core for arm_math.h.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CONV_H
+#define __USB_CONV_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#ifndef USB_CONV_ENABLED
+#define USB_CONV_ENABLED                            0
+#endif
+
+#if (USB_CONV_ENABLED == 1)
+
+#include "arm_math.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Conv
+  * @brief Overlap-save FFT convolution
+  * @{
+  */
+
+/** @defgroup USB_Conv_Exported_Defines
+  * @{
+  */
+#define USB_CONV_STATE_SIZE(fftLen)                 (4U * (fftLen))
+/**
+  * @}
+  */
+
+/** @defgroup USB_Conv_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  arm_rfft_fast_instance_f32 rfft;
+  uint16_t   fftLen;
+  uint16_t   blockSize;
+  uint16_t   fill;            /* samples of the current block received */
+  float32_t *pH;              /* filter spectrum, fftLen values, packed as arm_rfft_fast_f32 */
+  float32_t *pFrame;          /* last fftLen input samples */
+  float32_t *pWork;           /* transform input, then output of the inverse */
+  float32_t *pSpec;           /* spectrum of the frame */
+} USB_Conv_F32TypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Conv_Exported_Functions
+  * @{
+  */
+arm_status USB_Conv_Init_f32(USB_Conv_F32TypeDef *S, uint16_t fftLen,
+                             uint16_t blockSize, const float32_t *pCoeffs,
+                             uint16_t numTaps, float32_t *pState);
+void USB_Conv_Reset_f32(USB_Conv_F32TypeDef *S);
+void USB_Conv_f32(USB_Conv_F32TypeDef *S, const float32_t *pSrc,
+                  float32_t *pDst, uint32_t n);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_CONV_ENABLED */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_CONV_H */
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    usb_crc.h
+  * @brief   CRC-32 of frames on the CRC unit of the STM32F3.
+  *          The unit is set up for the CRC-32 of Ethernet and zlib
+  *          (polynomial 0x04C11DB7, reflected, initial value and final
+  *          xor 0xFFFFFFFF), fed a word at a time with the input reversed
+  *          per word, and a byte at a time for the unaligned head and the
+  *          tail of a buffer. USB_CRC_Begin starts a computation; from
+  *          USB_CRC_DMA_MIN bytes on, given a DMA channel, the words go to
+  *          the unit by a memory to memory transfer while the caller does
+  *          something else with the same buffer, such as encoding it.
+  *          USB_CRC_End waits for the transfer and returns the CRC.
+  *
+  *          The application enables the clocks of the CRC unit and of the
+  *          DMA, and calls USB_CRC_Init once. One computation at a time:
+  *          the unit belongs to one thread context. The DMA channel must
+  *          not serve any peripheral request.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CRC_H
+#define __USB_CRC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_CRC
+  * @brief CRC-32 on the CRC unit
+  * @{
+  */
+
+/** @defgroup USB_CRC_Exported_Defines
+  * @{
+  */
+#ifndef USB_CRC_ENABLED
+#define USB_CRC_ENABLED                             0
+#endif
+
+/* Frames from this size on go to the unit by DMA, when there is a channel */
+#ifndef USB_CRC_DMA_MIN
+#define USB_CRC_DMA_MIN                             128U
+#endif
+/**
+  * @}
+  */
+
+#if (USB_CRC_ENABLED == 1)
+
+#if !defined(STM32F303xC) && !defined(STM32F303xE)
+#error "USB_CRC_ENABLED needs the programmable CRC unit of the STM32F3"
+#endif
+
+#include "stm32f3xx_hal.h"
+
+/** @defgroup USB_CRC_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  DMA_TypeDef         *Dma;         /* controller of the channel, NULL for no DMA */
+  DMA_Channel_TypeDef *DmaCh;       /* free channel, run memory to memory */
+  uint8_t              DmaChNum;    /* channel number, 1 to 7 */
+} USB_CRC_ConfigTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_CRC_Exported_Functions
+  * @{
+  */
+void     USB_CRC_Init(const USB_CRC_ConfigTypeDef *cfg);
+void     USB_CRC_Begin(const uint8_t *buf, uint32_t length);
+uint32_t USB_CRC_End(void);
+uint32_t USB_CRC_Compute(const uint8_t *buf, uint32_t length);
+/**
+  * @}
+  */
+
+#endif /* USB_CRC_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_CRC_H */
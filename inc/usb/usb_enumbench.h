@@ -0,0 +1,168 @@
+/**
+  ******************************************************************************
+  * @file    usb_enumbench.h
+  * @brief   Enumeration latency, from the pull-up to the first bulk byte.
+  *          With USB_ENUMBENCH_ENABLED set to 1 the PCD driver, the core and
+  *          the CDC class timestamp with the DWT cycle counter the steps of
+  *          an enumeration, relative to the pull-up being switched on
+  *          (HAL_PCD_Start or HAL_PCD_DevConnect):
+  *
+  *            reset       bus reset
+  *            device      GET_DESCRIPTOR device
+  *            address     SET_ADDRESS, non zero
+  *            config      GET_DESCRIPTOR configuration
+  *            string      GET_DESCRIPTOR string
+  *            qualifier   GET_DESCRIPTOR device qualifier
+  *            bos         GET_DESCRIPTOR BOS
+  *            setconfig   SET_CONFIGURATION, non zero
+  *            init        end of USBD_CDC_Init
+  *            out         USBD_CDC_DataOut
+  *            hse         HSE ready, USB_FASTBOOT
+  *            pll         PLL locked and the core switched to it,
+  *                        USB_FASTBOOT
+  *
+  *          With USB_FASTBOOT the first pull-up after the reset counts from
+  *          the reset instead, and the header line says so
+  *          ("enum clock 72000000 reset"): connect is then the time to the
+  *          pull-up and device the time to the first SETUP answered.
+  *
+  *          Each step keeps the time of its first and last occurrence and a
+  *          count, so the repeats of the host show, e.g. the 8 byte device
+  *          descriptor before SET_ADDRESS and the full one after it. With
+  *          it left at 0 every hook expands to nothing.
+  *
+  *          The CDC benchmark reports it as text through
+  *          USBD_CDC_BENCH_BAUD_ENUM, once the host has sent its first
+  *          byte on the port; tools/cdc_bench.py --enum does both:
+  *
+  *            enum clock 72000000
+  *            step count first_us last_us
+  *            connect 1 0 0
+  *            reset 2 21035 76110
+  *            ...
+  *            end
+  *
+  *          The including file must already have the CMSIS core header of
+  *          the device in scope (DWT). The cycle counter wraps after about a
+  *          minute at 72 MHz, far more than an enumeration takes.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_ENUMBENCH_H
+#define __USB_ENUMBENCH_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_EnumBench
+  * @brief Enumeration latency benchmark
+  * @{
+  */
+
+/** @defgroup USB_EnumBench_Exported_Defines
+  * @{
+  */
+#ifndef USB_ENUMBENCH_ENABLED
+#define USB_ENUMBENCH_ENABLED                       0
+#endif
+
+/* Steps */
+#define USB_ENUMBENCH_CONNECT                       0U
+#define USB_ENUMBENCH_RESET                         1U
+#define USB_ENUMBENCH_DEVICE                        2U
+#define USB_ENUMBENCH_ADDRESS                       3U
+#define USB_ENUMBENCH_CONFIG                        4U
+#define USB_ENUMBENCH_STRING                        5U
+#define USB_ENUMBENCH_QUALIFIER                     6U
+#define USB_ENUMBENCH_BOS                           7U
+#define USB_ENUMBENCH_SETCONFIG                     8U
+#define USB_ENUMBENCH_INIT                          9U
+#define USB_ENUMBENCH_OUT                           10U
+#define USB_ENUMBENCH_HSE                           11U
+#define USB_ENUMBENCH_PLL                           12U
+#define USB_ENUMBENCH_NUM_STEPS                     13U
+
+/* Lines of the text report: header, column names, one per step, end */
+#define USB_ENUMBENCH_NUM_LINES                     (USB_ENUMBENCH_NUM_STEPS + 3U)
+
+/* Longest line of the report, terminating NUL included */
+#define USB_ENUMBENCH_LINE_SIZE                     48U
+/**
+  * @}
+  */
+
+/** @defgroup USB_EnumBench_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t first;               /* cycles from the pull-up to the first one */
+  uint32_t last;                /* to the last one */
+  uint32_t count;
+} USB_EnumBenchStepTypeDef;
+
+typedef struct
+{
+  uint32_t start;               /* DWT->CYCCNT at the pull-up */
+  uint8_t  running;             /* pull-up seen */
+  uint8_t  from_reset;          /* steps count from the reset, USB_FASTBOOT */
+  USB_EnumBenchStepTypeDef step[USB_ENUMBENCH_NUM_STEPS];
+} USB_EnumBenchTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_ENUMBENCH_ENABLED == 1)
+
+/** @defgroup USB_EnumBench_Exported_Variables
+  * @{
+  */
+extern USB_EnumBenchTypeDef USB_EnumBench;
+/**
+  * @}
+  */
+
+/** @defgroup USB_EnumBench_Exported_Functions
+  * @{
+  */
+void     USB_EnumBench_Connect(void);
+void     USB_EnumBench_Mark(uint32_t step);
+void     USB_EnumBench_Descriptor(uint8_t type);
+uint32_t USB_EnumBench_Line(uint32_t line, char *buf);
+/**
+  * @}
+  */
+
+#define USB_ENUMBENCH_CONNECTED()                   USB_EnumBench_Connect()
+#define USB_ENUMBENCH_MARK(step)                    USB_EnumBench_Mark(step)
+#define USB_ENUMBENCH_DESCRIPTOR(type)              USB_EnumBench_Descriptor(type)
+
+#else
+
+#define USB_ENUMBENCH_CONNECTED()
+#define USB_ENUMBENCH_MARK(step)
+#define USB_ENUMBENCH_DESCRIPTOR(type)
+
+#endif /* USB_ENUMBENCH_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_ENUMBENCH_H */
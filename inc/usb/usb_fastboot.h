@@ -0,0 +1,146 @@
+/**
+  ******************************************************************************
+  * @file    usb_fastboot.h
+  * @brief   Fast boot of the F3 to a connected USB device.
+  *          With USB_FASTBOOT_ENABLED set to 1 the HSE and the PLL of the
+  *          USB clock lock while the C runtime and the stack are being set
+  *          up, instead of one after the other in SystemInit:
+  *
+  *            - USB_FastBoot_Start, called first thing from the reset
+  *              handler, before .data is copied and .bss cleared: turns the
+  *              HSE on and writes the PLL, bus and USB prescalers without
+  *              waiting for anything. It touches registers only.
+  *            - USB_FastBoot_Poll, from then on: turns the PLL on once the
+  *              HSE is ready, switches the system clock to it once it has
+  *              locked, and never blocks. USBD_Init, the class registration
+  *              and any other set up that needs no clock go in between.
+  *            - USB_FastBoot_Wait, then USBD_Start: the pull-up goes on as
+  *              soon as the 48 MHz USB clock is there; HAL_PCD_Init (from
+  *              USBD_Init through USBD_LL_Init) touches the peripheral,
+  *              so it must also wait for it.
+  *            - The rest of the board init, HAL_InitTick included, after
+  *              USBD_Start: the host takes 100 ms to debounce the attach.
+  *
+  *            Reset_Handler:
+  *              ldr   sp, =_estack
+  *              bl    USB_FastBoot_Start
+  *              ... copy .data, clear .bss ...
+  *              bl    main
+  *
+  *          SystemInit must leave the clocks alone. DWT->CYCCNT runs from
+  *          USB_FastBoot_Start on and is rescaled at the switch as if it had
+  *          run at USB_FASTBOOT_SYSCLK all along, so with USB_ENUMBENCH the
+  *          first enumeration counts from the reset, with the HSE and PLL
+  *          ready times as steps.
+  *
+  *          The including file must already have the CMSIS device header in
+  *          scope. For the F3 USB peripheral only: the OTG cores take their
+  *          48 MHz from the PLLQ divider of the F4 PLL.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_FASTBOOT_H
+#define __USB_FASTBOOT_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_FastBoot
+  * @brief Fast clock and USB bring-up
+  * @{
+  */
+
+/** @defgroup USB_FastBoot_Exported_Defines
+  * @{
+  */
+#ifndef USB_FASTBOOT_ENABLED
+#define USB_FASTBOOT_ENABLED                        0
+#endif
+
+/* 1 for an external clock on OSC_IN instead of a crystal */
+#ifndef USB_FASTBOOT_HSE_BYPASS
+#define USB_FASTBOOT_HSE_BYPASS                     0
+#endif
+
+/* PLL set up, the defaults take an 8 MHz HSE to 72 MHz and 48 MHz USB */
+#ifndef USB_FASTBOOT_PREDIV
+#define USB_FASTBOOT_PREDIV                         RCC_CFGR2_PREDIV_DIV1
+#endif
+#ifndef USB_FASTBOOT_PLLMUL
+#define USB_FASTBOOT_PLLMUL                         RCC_CFGR_PLLMUL9
+#endif
+#ifndef USB_FASTBOOT_USBPRE
+#define USB_FASTBOOT_USBPRE                         RCC_CFGR_USBPRE_DIV1_5
+#endif
+
+/* System clock the PLL set up gives, Hz */
+#ifndef USB_FASTBOOT_SYSCLK
+#define USB_FASTBOOT_SYSCLK                         72000000U
+#endif
+
+/* HSE start up time after which USB_FastBoot_Poll gives up, us */
+#ifndef USB_FASTBOOT_HSE_TIMEOUT_US
+#define USB_FASTBOOT_HSE_TIMEOUT_US                 100000U
+#endif
+
+/* Returns of USB_FastBoot_Poll */
+#define USB_FASTBOOT_HSE_WAIT                       0U
+#define USB_FASTBOOT_PLL_WAIT                       1U
+#define USB_FASTBOOT_READY                          2U
+#define USB_FASTBOOT_FAILED                         3U
+/**
+  * @}
+  */
+
+/** @defgroup USB_FastBoot_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t hse;                 /* cycles from the reset to the HSE ready, 0 until seen */
+  uint32_t pll;                 /* to the PLL locked and running the core */
+} USB_FastBootTimesTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_FASTBOOT_ENABLED == 1)
+
+#if defined(USB_OTG_FS)
+#error "USB_FASTBOOT is for the F3 USB peripheral"
+#endif
+
+/** @defgroup USB_FastBoot_Exported_Functions
+  * @{
+  */
+void     USB_FastBoot_Start(void);
+uint32_t USB_FastBoot_Poll(void);
+uint8_t  USB_FastBoot_Wait(void);
+const USB_FastBootTimesTypeDef *USB_FastBoot_GetTimes(void);
+/**
+  * @}
+  */
+
+#endif /* USB_FASTBOOT_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_FASTBOOT_H */
@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    usb_fft.h
+  * @brief   FFT set up over the tables of the configured lengths only.
+  *          arm_rfft_fast_init_f32 and the arm_cfft_sR_f32_len* instances of
+  *          arm_const_structs.h reference the twiddle and bit reversal
+  *          tables of every length, so the linker keeps all of them: close to
+  *          120 KB of flash for the float tables alone. USB_FFT_RfftInit_f32
+  *          and USB_FFT_CfftInit_f32 fill the same CMSIS instances, but only
+  *          know the lengths enabled below, and with --gc-sections the
+  *          others drop out of the image. The tables are placed one per
+  *          section in the CMSIS library builds for GCC; a library built
+  *          without -fdata-sections still links them as one object.
+  *
+  *          Enable a length with its flag, in usbd_conf.h or on the command
+  *          line, for example for a 512 point real FFT:
+  *
+  *            #define USB_FFT_ENABLED                 1
+  *            #define USB_FFT_RFFT_F32_LEN_512        1
+  *
+  *          A real FFT of N points runs a complex FFT of N / 2 points and
+  *          needs its tables as well. Init of a length that is not enabled
+  *          returns ARM_MATH_ARGUMENT_ERROR.
+  *
+  *          With USB_FFT_TABLES_IN_RAM set to 1, the tables of each enabled
+  *          length are copied to RAM by its first init, and the instance
+  *          points to the copy: the butterflies then read the twiddles
+  *          without flash wait states and without competing with the
+  *          instruction fetch. The copies go to section .ccmbss.usb when
+  *          USB_CCM_ENABLED is set, see usb_ccm.h, and to .bss otherwise.
+  *          A 512 point real FFT takes 4.9 KB of RAM this way, a 1024 point
+  *          one 8.9 KB, more than the 8 KB of CCM of the STM32F303xC.
+  *
+  *          Set USB_FFT_ENABLED to 1 to build the module; the build must
+  *          then define the ARM_MATH_CMx of the core for arm_math.h.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_FFT_H
+#define __USB_FFT_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_FFT
+  * @brief FFT set up over selected tables
+  * @{
+  */
+
+/** @defgroup USB_FFT_Exported_Defines
+  * @{
+  */
+#ifndef USB_FFT_ENABLED
+#define USB_FFT_ENABLED                             0
+#endif
+
+#ifndef USB_FFT_TABLES_IN_RAM
+#define USB_FFT_TABLES_IN_RAM                       0
+#endif
+
+/* Real FFT lengths */
+#ifndef USB_FFT_RFFT_F32_LEN_32
+#define USB_FFT_RFFT_F32_LEN_32                     0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_64
+#define USB_FFT_RFFT_F32_LEN_64                     0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_128
+#define USB_FFT_RFFT_F32_LEN_128                    0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_256
+#define USB_FFT_RFFT_F32_LEN_256                    0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_512
+#define USB_FFT_RFFT_F32_LEN_512                    0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_1024
+#define USB_FFT_RFFT_F32_LEN_1024                   0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_2048
+#define USB_FFT_RFFT_F32_LEN_2048                   0
+#endif
+#ifndef USB_FFT_RFFT_F32_LEN_4096
+#define USB_FFT_RFFT_F32_LEN_4096                   0
+#endif
+
+/* Complex FFT lengths, implied by the real ones */
+#ifndef USB_FFT_CFFT_F32_LEN_16
+#define USB_FFT_CFFT_F32_LEN_16                     USB_FFT_RFFT_F32_LEN_32
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_32
+#define USB_FFT_CFFT_F32_LEN_32                     USB_FFT_RFFT_F32_LEN_64
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_64
+#define USB_FFT_CFFT_F32_LEN_64                     USB_FFT_RFFT_F32_LEN_128
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_128
+#define USB_FFT_CFFT_F32_LEN_128                    USB_FFT_RFFT_F32_LEN_256
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_256
+#define USB_FFT_CFFT_F32_LEN_256                    USB_FFT_RFFT_F32_LEN_512
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_512
+#define USB_FFT_CFFT_F32_LEN_512                    USB_FFT_RFFT_F32_LEN_1024
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_1024
+#define USB_FFT_CFFT_F32_LEN_1024                   USB_FFT_RFFT_F32_LEN_2048
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_2048
+#define USB_FFT_CFFT_F32_LEN_2048                   USB_FFT_RFFT_F32_LEN_4096
+#endif
+#ifndef USB_FFT_CFFT_F32_LEN_4096
+#define USB_FFT_CFFT_F32_LEN_4096                   0
+#endif
+/**
+  * @}
+  */
+
+#if (USB_FFT_ENABLED == 1)
+
+#include "arm_math.h"
+
+/** @defgroup USB_FFT_Exported_Functions
+  * @{
+  */
+arm_status USB_FFT_CfftInit_f32(arm_cfft_instance_f32 *S, uint16_t fftLen);
+arm_status USB_FFT_RfftInit_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen);
+/**
+  * @}
+  */
+
+#endif /* USB_FFT_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_FFT_H */
@@ -0,0 +1,401 @@
+/**
+  ******************************************************************************
+  * @file    usb_mat.h
+  * @brief   Fixed size float matrix kernels, in the shape of arm_mat_*_f32.
+  *          Each kernel takes and returns what its CMSIS counterpart does,
+  *          arm_matrix_instance_f32 operands and an arm_status, so a call
+  *          site switches by name only:
+  *
+  *            arm_mat_mult_f32(&F, &P, &FP)  ->  USB_Mat_Mult_6x6x6_f32(&F, &P, &FP)
+  *
+  *          The sizes are part of the name instead of read from the
+  *          instances. The kernels are inlined with constant bounds, which
+  *          the compiler unrolls into straight line FPU code: no loop
+  *          counters, no size checks, operands kept in the FPU registers
+  *          as far as they go. Like CMSIS, the sizes of the instances are
+  *          only checked with ARM_MATH_MATRIX_CHECK defined, against the
+  *          size of the kernel.
+  *
+  *          The 3x3, 4x4 and 6x6 square kernels and the matrix times vector
+  *          products of those sizes are defined below; other shapes are
+  *          generated with the USB_MAT_*_DEFINE macros, once per
+  *          translation unit:
+  *
+  *            USB_MAT_MULT_DEFINE(6, 6, 3)   USB_Mat_Mult_6x6x3_f32
+  *            USB_MAT_TRANS_DEFINE(3, 6)     USB_Mat_Trans_3x6_f32
+  *
+  *          Unlike arm_mat_inverse_f32, USB_Mat_Inverse_NxN_f32 leaves its
+  *          source as it is. The destination of a product, a transpose or
+  *          an inverse must not overlap a source; add, sub and scale work
+  *          in place.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_MAT_H
+#define __USB_MAT_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <math.h>
+#include "arm_math.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Mat
+  * @brief Fixed size matrix kernels
+  * @{
+  */
+
+/** @defgroup USB_Mat_Private_Defines
+  * @{
+  */
+#if defined(__GNUC__) || defined(__clang__)
+#define USB_MAT_INLINE                              static inline __attribute__((always_inline))
+#else
+#define USB_MAT_INLINE                              __STATIC_INLINE
+#endif
+
+/* Full unrolling of the constant bound loops */
+#if defined(__clang__)
+#define USB_MAT_UNROLL                              _Pragma("unroll")
+#elif defined(__GNUC__) && (__GNUC__ >= 8)
+#define USB_MAT_UNROLL                              _Pragma("GCC unroll 64")
+#else
+#define USB_MAT_UNROLL
+#endif
+
+/* Largest inverse, for its work copy on the stack */
+#ifndef USB_MAT_INVERSE_MAX
+#define USB_MAT_INVERSE_MAX                         8
+#endif
+
+#ifdef ARM_MATH_MATRIX_CHECK
+#define USB_MAT_CHECK(m, rows, cols)                                          \
+  do                                                                          \
+  {                                                                           \
+    if (((m)->numRows != (rows)) || ((m)->numCols != (cols)))                 \
+    {                                                                         \
+      return ARM_MATH_SIZE_MISMATCH;                                          \
+    }                                                                         \
+  } while (0)
+#else
+#define USB_MAT_CHECK(m, rows, cols)
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USB_Mat_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  c = a * b, a m x k, b k x n, row major
+  */
+USB_MAT_INLINE void USB_Mat_MultRaw_f32(const float32_t *__restrict a,
+                                        const float32_t *__restrict b,
+                                        float32_t *__restrict c,
+                                        const uint32_t m, const uint32_t k,
+                                        const uint32_t n)
+{
+  uint32_t i, j, l;
+  float32_t sum;
+
+  USB_MAT_UNROLL
+  for (i = 0U; i < m; i++)
+  {
+    USB_MAT_UNROLL
+    for (j = 0U; j < n; j++)
+    {
+      sum = a[i * k] * b[j];
+      USB_MAT_UNROLL
+      for (l = 1U; l < k; l++)
+      {
+        sum += a[i * k + l] * b[l * n + j];
+      }
+      c[i * n + j] = sum;
+    }
+  }
+}
+
+/**
+  * @brief  c = a + b, or a - b with sub set, count elements
+  */
+USB_MAT_INLINE void USB_Mat_AddRaw_f32(const float32_t *a, const float32_t *b,
+                                       float32_t *c, const uint32_t count,
+                                       const uint32_t sub)
+{
+  uint32_t i;
+
+  USB_MAT_UNROLL
+  for (i = 0U; i < count; i++)
+  {
+    c[i] = sub ? (a[i] - b[i]) : (a[i] + b[i]);
+  }
+}
+
+/**
+  * @brief  c = a * s, count elements
+  */
+USB_MAT_INLINE void USB_Mat_ScaleRaw_f32(const float32_t *a, float32_t s,
+                                         float32_t *c, const uint32_t count)
+{
+  uint32_t i;
+
+  USB_MAT_UNROLL
+  for (i = 0U; i < count; i++)
+  {
+    c[i] = a[i] * s;
+  }
+}
+
+/**
+  * @brief  c = a', a m x n
+  */
+USB_MAT_INLINE void USB_Mat_TransRaw_f32(const float32_t *__restrict a,
+                                         float32_t *__restrict c,
+                                         const uint32_t m, const uint32_t n)
+{
+  uint32_t i, j;
+
+  USB_MAT_UNROLL
+  for (i = 0U; i < m; i++)
+  {
+    USB_MAT_UNROLL
+    for (j = 0U; j < n; j++)
+    {
+      c[j * m + i] = a[i * n + j];
+    }
+  }
+}
+
+/**
+  * @brief  c = inverse of a, 3 x 3, from the adjugate
+  * @retval ARM_MATH_SINGULAR for a zero determinant
+  */
+USB_MAT_INLINE arm_status USB_Mat_Inverse3Raw_f32(const float32_t *__restrict a,
+                                                  float32_t *__restrict c)
+{
+  float32_t c00 = a[4] * a[8] - a[5] * a[7];
+  float32_t c01 = a[5] * a[6] - a[3] * a[8];
+  float32_t c02 = a[3] * a[7] - a[4] * a[6];
+  float32_t det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+  float32_t inv;
+
+  if (det == 0.0f)
+  {
+    return ARM_MATH_SINGULAR;
+  }
+  inv = 1.0f / det;
+
+  c[0] = c00 * inv;
+  c[1] = (a[2] * a[7] - a[1] * a[8]) * inv;
+  c[2] = (a[1] * a[5] - a[2] * a[4]) * inv;
+  c[3] = c01 * inv;
+  c[4] = (a[0] * a[8] - a[2] * a[6]) * inv;
+  c[5] = (a[2] * a[3] - a[0] * a[5]) * inv;
+  c[6] = c02 * inv;
+  c[7] = (a[1] * a[6] - a[0] * a[7]) * inv;
+  c[8] = (a[0] * a[4] - a[1] * a[3]) * inv;
+  return ARM_MATH_SUCCESS;
+}
+
+/**
+  * @brief  c = inverse of a, n x n, Gauss-Jordan with partial pivoting on a
+  *         copy of a
+  * @note   n up to USB_MAT_INVERSE_MAX
+  * @retval ARM_MATH_SINGULAR if a column has no non-zero pivot, as
+  *         arm_mat_inverse_f32
+  */
+USB_MAT_INLINE arm_status USB_Mat_InverseRaw_f32(const float32_t *__restrict a,
+                                                 float32_t *__restrict c,
+                                                 const uint32_t n)
+{
+  float32_t w[USB_MAT_INVERSE_MAX * USB_MAT_INVERSE_MAX];
+  float32_t f, t;
+  uint32_t col, r, j, p;
+
+  USB_MAT_UNROLL
+  for (r = 0U; r < n; r++)
+  {
+    USB_MAT_UNROLL
+    for (j = 0U; j < n; j++)
+    {
+      w[r * n + j] = a[r * n + j];
+      c[r * n + j] = (r == j) ? 1.0f : 0.0f;
+    }
+  }
+
+  USB_MAT_UNROLL
+  for (col = 0U; col < n; col++)
+  {
+    p = col;
+    USB_MAT_UNROLL
+    for (r = col + 1U; r < n; r++)
+    {
+      if (fabsf(w[r * n + col]) > fabsf(w[p * n + col]))
+      {
+        p = r;
+      }
+    }
+    if (w[p * n + col] == 0.0f)
+    {
+      return ARM_MATH_SINGULAR;
+    }
+    if (p != col)
+    {
+      USB_MAT_UNROLL
+      for (j = 0U; j < n; j++)
+      {
+        t = w[p * n + j]; w[p * n + j] = w[col * n + j]; w[col * n + j] = t;
+        t = c[p * n + j]; c[p * n + j] = c[col * n + j]; c[col * n + j] = t;
+      }
+    }
+
+    f = 1.0f / w[col * n + col];
+    USB_MAT_UNROLL
+    for (j = 0U; j < n; j++)
+    {
+      w[col * n + j] *= f;
+      c[col * n + j] *= f;
+    }
+
+    USB_MAT_UNROLL
+    for (r = 0U; r < n; r++)
+    {
+      if (r == col)
+      {
+        continue;
+      }
+      f = w[r * n + col];
+      USB_MAT_UNROLL
+      for (j = 0U; j < n; j++)
+      {
+        w[r * n + j] -= f * w[col * n + j];
+        c[r * n + j] -= f * c[col * n + j];
+      }
+    }
+  }
+  return ARM_MATH_SUCCESS;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Mat_Exported_Macros
+  * @{
+  */
+
+/* pDst (m x n) = pSrcA (m x k) * pSrcB (k x n) */
+#define USB_MAT_MULT_DEFINE(m, k, n)                                          \
+USB_MAT_INLINE arm_status USB_Mat_Mult_##m##x##k##x##n##_f32(                 \
+    const arm_matrix_instance_f32 *pSrcA, const arm_matrix_instance_f32 *pSrcB, \
+    arm_matrix_instance_f32 *pDst)                                            \
+{                                                                             \
+  USB_MAT_CHECK(pSrcA, m, k);                                                 \
+  USB_MAT_CHECK(pSrcB, k, n);                                                 \
+  USB_MAT_CHECK(pDst, m, n);                                                  \
+  USB_Mat_MultRaw_f32(pSrcA->pData, pSrcB->pData, pDst->pData, m, k, n);      \
+  return ARM_MATH_SUCCESS;                                                    \
+}
+
+/* pDst = pSrcA + pSrcB and pDst = pSrcA - pSrcB, m x n */
+#define USB_MAT_ADD_DEFINE(m, n)                                              \
+USB_MAT_INLINE arm_status USB_Mat_Add_##m##x##n##_f32(                        \
+    const arm_matrix_instance_f32 *pSrcA, const arm_matrix_instance_f32 *pSrcB, \
+    arm_matrix_instance_f32 *pDst)                                            \
+{                                                                             \
+  USB_MAT_CHECK(pSrcA, m, n);                                                 \
+  USB_MAT_CHECK(pSrcB, m, n);                                                 \
+  USB_MAT_CHECK(pDst, m, n);                                                  \
+  USB_Mat_AddRaw_f32(pSrcA->pData, pSrcB->pData, pDst->pData, (m) * (n), 0U); \
+  return ARM_MATH_SUCCESS;                                                    \
+}                                                                             \
+USB_MAT_INLINE arm_status USB_Mat_Sub_##m##x##n##_f32(                        \
+    const arm_matrix_instance_f32 *pSrcA, const arm_matrix_instance_f32 *pSrcB, \
+    arm_matrix_instance_f32 *pDst)                                            \
+{                                                                             \
+  USB_MAT_CHECK(pSrcA, m, n);                                                 \
+  USB_MAT_CHECK(pSrcB, m, n);                                                 \
+  USB_MAT_CHECK(pDst, m, n);                                                  \
+  USB_Mat_AddRaw_f32(pSrcA->pData, pSrcB->pData, pDst->pData, (m) * (n), 1U); \
+  return ARM_MATH_SUCCESS;                                                    \
+}
+
+/* pDst = pSrc * scale, m x n */
+#define USB_MAT_SCALE_DEFINE(m, n)                                            \
+USB_MAT_INLINE arm_status USB_Mat_Scale_##m##x##n##_f32(                      \
+    const arm_matrix_instance_f32 *pSrc, float32_t scale,                     \
+    arm_matrix_instance_f32 *pDst)                                            \
+{                                                                             \
+  USB_MAT_CHECK(pSrc, m, n);                                                  \
+  USB_MAT_CHECK(pDst, m, n);                                                  \
+  USB_Mat_ScaleRaw_f32(pSrc->pData, scale, pDst->pData, (m) * (n));           \
+  return ARM_MATH_SUCCESS;                                                    \
+}
+
+/* pDst (n x m) = pSrc' (m x n) */
+#define USB_MAT_TRANS_DEFINE(m, n)                                            \
+USB_MAT_INLINE arm_status USB_Mat_Trans_##m##x##n##_f32(                      \
+    const arm_matrix_instance_f32 *pSrc, arm_matrix_instance_f32 *pDst)       \
+{                                                                             \
+  USB_MAT_CHECK(pSrc, m, n);                                                  \
+  USB_MAT_CHECK(pDst, n, m);                                                  \
+  USB_Mat_TransRaw_f32(pSrc->pData, pDst->pData, m, n);                       \
+  return ARM_MATH_SUCCESS;                                                    \
+}
+
+/* pDst = inverse of pSrc, n x n */
+#define USB_MAT_INVERSE_DEFINE(n)                                             \
+USB_MAT_INLINE arm_status USB_Mat_Inverse_##n##x##n##_f32(                    \
+    const arm_matrix_instance_f32 *pSrc, arm_matrix_instance_f32 *pDst)       \
+{                                                                             \
+  USB_MAT_CHECK(pSrc, n, n);                                                  \
+  USB_MAT_CHECK(pDst, n, n);                                                  \
+  if ((n) == 3)                                                               \
+  {                                                                           \
+    return USB_Mat_Inverse3Raw_f32(pSrc->pData, pDst->pData);                 \
+  }                                                                           \
+  return USB_Mat_InverseRaw_f32(pSrc->pData, pDst->pData, n);                 \
+}
+
+/* Square kernels of one size, with the matrix times vector product */
+#define USB_MAT_SQUARE_DEFINE(n)                                              \
+  USB_MAT_MULT_DEFINE(n, n, n)                                                \
+  USB_MAT_MULT_DEFINE(n, n, 1)                                                \
+  USB_MAT_ADD_DEFINE(n, n)                                                    \
+  USB_MAT_SCALE_DEFINE(n, n)                                                  \
+  USB_MAT_TRANS_DEFINE(n, n)                                                  \
+  USB_MAT_INVERSE_DEFINE(n)
+/**
+  * @}
+  */
+
+/** @defgroup USB_Mat_Exported_Functions
+  * @{
+  */
+USB_MAT_SQUARE_DEFINE(3)
+USB_MAT_SQUARE_DEFINE(4)
+USB_MAT_SQUARE_DEFINE(6)
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_MAT_H */
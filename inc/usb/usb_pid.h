@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * @file    usb_pid.h
+  * @brief   Batched PID controllers over structure of arrays state.
+  *          One call advances every axis of a bank by one control tick,
+  *          with the difference equation of arm_pid_f32/q31/q15:
+  *
+  *            y[n] = y[n-1] + A0 * x[n] + A1 * x[n-1] + A2 * x[n-2]
+  *            A0 = Kp + Ki + Kd,  A1 = -Kp - 2 Kd,  A2 = Kd
+  *
+  *          The coefficients and the state of all axes sit in contiguous
+  *          arrays instead of one arm_pid_instance per axis, so the loop
+  *          streams through them in order. The arithmetic, scaling and
+  *          saturation are those of the CMSIS function of each type.
+  *
+  *          q15 banks keep, per axis, A1 and A2 packed in one word and
+  *          x[n-1], x[n-2] packed in one word, as arm_pid_instance_q15
+  *          does: on Cortex-M4 and M7 the two taps are one __SMLALD dual
+  *          MAC into a 64-bit accumulator, and the state shifts with one
+  *          __PKHBT. That path needs the state word aligned and falls back
+  *          to one halfword at a time otherwise, or on other cores.
+  *
+  *          Set USB_PID_ENABLED to 1 to build the module; the build must
+  *          then define the ARM_MATH_CMx of the core for arm_math.h.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_PID_H
+#define __USB_PID_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#ifndef USB_PID_ENABLED
+#define USB_PID_ENABLED                             0
+#endif
+
+#if (USB_PID_ENABLED == 1)
+
+#include "arm_math.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_PID
+  * @brief Batched PID controllers
+  * @{
+  */
+
+/** @defgroup USB_PID_Exported_TypesDefinitions
+  * @{
+  */
+
+/* Float bank. state holds 3 * numAxes values: x[n-1] of every axis, then
+   x[n-2] of every axis, then y[n-1] of every axis */
+typedef struct
+{
+  uint32_t   numAxes;
+  float32_t *A0;
+  float32_t *A1;
+  float32_t *A2;
+  float32_t *state;
+} USB_PID_BankF32TypeDef;
+
+/* q31 bank, state laid out as for the float bank */
+typedef struct
+{
+  uint32_t   numAxes;
+  q31_t     *A0;
+  q31_t     *A1;
+  q31_t     *A2;
+  q31_t     *state;
+} USB_PID_BankQ31TypeDef;
+
+/* q15 bank. A12[i] is A1 in the low and A2 in the high halfword. state
+   holds 3 * numAxes values: x[n-1], x[n-2] of axis 0, of axis 1 and so on,
+   then y[n-1] of every axis */
+typedef struct
+{
+  uint32_t   numAxes;
+  q15_t     *A0;
+  q31_t     *A12;
+  q15_t     *state;
+} USB_PID_BankQ15TypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_PID_Exported_Functions
+  * @{
+  */
+void USB_PID_Init_f32(USB_PID_BankF32TypeDef *S, const float32_t *Kp,
+                      const float32_t *Ki, const float32_t *Kd,
+                      int32_t resetStateFlag);
+void USB_PID_Reset_f32(USB_PID_BankF32TypeDef *S);
+void USB_PID_f32(USB_PID_BankF32TypeDef *S, const float32_t *in, float32_t *out);
+
+void USB_PID_Init_q31(USB_PID_BankQ31TypeDef *S, const q31_t *Kp,
+                      const q31_t *Ki, const q31_t *Kd,
+                      int32_t resetStateFlag);
+void USB_PID_Reset_q31(USB_PID_BankQ31TypeDef *S);
+void USB_PID_q31(USB_PID_BankQ31TypeDef *S, const q31_t *in, q31_t *out);
+
+void USB_PID_Init_q15(USB_PID_BankQ15TypeDef *S, const q15_t *Kp,
+                      const q15_t *Ki, const q15_t *Kd,
+                      int32_t resetStateFlag);
+void USB_PID_Reset_q15(USB_PID_BankQ15TypeDef *S);
+void USB_PID_q15(USB_PID_BankQ15TypeDef *S, const q15_t *in, q15_t *out);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_PID_ENABLED */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_PID_H */
@@ -0,0 +1,129 @@
+/**
+  ******************************************************************************
+  * @file    usb_pmabench.h
+  * @brief   Cycle counts of the F3 packet memory copies.
+  *          With USB_PMABENCH_ENABLED set to 1, USB_PMABench_Run times
+  *          PCD_WritePMA and PCD_ReadPMA with the DWT cycle counter for
+  *          every size from 1 to USB_PMABENCH_MAX_SIZE bytes and user
+  *          buffer alignments 0 to 3, keeping the fewest cycles of
+  *          USB_PMABENCH_REPS runs with interrupts off, less the cost of
+  *          the measurement itself.
+  *
+  *          The copies run on the access scheme of the part the firmware is
+  *          built for, 2x16 or 1x16 (see stm32f3xx_hal_pcd_ex.c): figures
+  *          for both come from one build for a part of each kind. The CDC
+  *          benchmark reports the table as text through
+  *          USBD_CDC_BENCH_BAUD_PMA, which tools/cdc_bench.py --pma reads
+  *          and compares with a baseline:
+  *
+  *            pma 2x16 clock 72000000 reps 16
+  *            size w0 w1 w2 w3 r0 r1 r2 r3
+  *            1 21.00 21.00 21.00 21.00 19.00 19.00 19.00 19.00
+  *            ...
+  *            end
+  *
+  *          Figures are cycles per byte, wN and rN for a user buffer at
+  *          offset N from a word boundary.
+  *
+  *          USB_PMABENCH_PMA_ADDR must be USB_PMABENCH_MAX_SIZE bytes of
+  *          packet memory no endpoint uses. The including file must already
+  *          have the CMSIS core header of the device in scope.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_PMABENCH_H
+#define __USB_PMABENCH_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_PMABench
+  * @brief Packet memory copy benchmark
+  * @{
+  */
+
+/** @defgroup USB_PMABench_Exported_Defines
+  * @{
+  */
+#ifndef USB_PMABENCH_ENABLED
+#define USB_PMABENCH_ENABLED                        0
+#endif
+
+#define USB_PMABENCH_MAX_SIZE                       64U
+#define USB_PMABENCH_NUM_ALIGN                      4U
+
+#ifndef USB_PMABENCH_REPS
+#define USB_PMABENCH_REPS                           16U
+#endif
+
+/* Scratch packet memory, the top of it by default */
+#ifndef USB_PMABENCH_PMA_ADDR
+#define USB_PMABENCH_PMA_ADDR                       (USBD_PMA_SIZE - USB_PMABENCH_MAX_SIZE)
+#endif
+
+/* Lines of the text report: header, column names, one per size, end */
+#define USB_PMABENCH_NUM_LINES                      (USB_PMABENCH_MAX_SIZE + 3U)
+
+/* Longest line of the report, terminating NUL included */
+#define USB_PMABENCH_LINE_SIZE                      80U
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  /* fewest cycles of a copy, [alignment][size - 1] */
+  uint16_t write[USB_PMABENCH_NUM_ALIGN][USB_PMABENCH_MAX_SIZE];
+  uint16_t read[USB_PMABENCH_NUM_ALIGN][USB_PMABENCH_MAX_SIZE];
+  uint16_t overhead;            /* cycles of an empty measurement, taken off */
+  uint8_t  done;                /* a run completed */
+} USB_PMABenchTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_PMABENCH_ENABLED == 1)
+
+/** @defgroup USB_PMABench_Exported_Variables
+  * @{
+  */
+extern USB_PMABenchTypeDef USB_PMABench;
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Exported_Functions
+  * @{
+  */
+void     USB_PMABench_Run(USB_TypeDef *USBx);
+uint32_t USB_PMABench_Line(uint32_t line, char *buf);
+/**
+  * @}
+  */
+
+#endif /* USB_PMABENCH_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_PMABENCH_H */
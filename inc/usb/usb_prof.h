@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file    usb_prof.h
+  * @brief   Cycle count profiling of the USB device hot paths.
+  *          With USB_PROF_ENABLED set to 1, the PCD interrupt handler, each
+  *          endpoint service, the PMA copies and the CDC class callbacks
+  *          record min/max/total cycles per endpoint number, measured with
+  *          the DWT cycle counter. With it left at 0 every hook expands to
+  *          nothing.
+  *
+  *          Measurements are inclusive: the interrupt handler figure
+  *          contains the endpoint service, which contains the PMA copies
+  *          and the class callbacks.
+  *
+  *          The including file must already have the CMSIS core header of
+  *          the device in scope (DWT, CoreDebug).
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_PROF_H
+#define __USB_PROF_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Prof
+  * @brief USB hot path profiling
+  * @{
+  */
+
+/** @defgroup USB_Prof_Exported_Defines
+  * @{
+  */
+#ifndef USB_PROF_ENABLED
+#define USB_PROF_ENABLED                            0
+#endif
+
+#define USB_PROF_NUM_EP                             8
+
+/* Profiled code paths */
+#define USB_PROF_IRQ                                0   /* HAL_PCD_IRQHandler, endpoint 0 slot only */
+#define USB_PROF_EP_ISR                             1   /* one PCD_EP_ISR_Handler iteration */
+#define USB_PROF_READ_PMA                           2   /* PCD_ReadPMA, PCD_ReadFifo on OTG_FS */
+#define USB_PROF_WRITE_PMA                          3   /* PCD_WritePMA, PCD_WriteFifo on OTG_FS */
+#define USB_PROF_CDC_SETUP                          4   /* USBD_CDC_Setup */
+#define USB_PROF_CDC_DATA_IN                        5   /* USBD_CDC_DataIn */
+#define USB_PROF_CDC_DATA_OUT                       6   /* USBD_CDC_DataOut */
+#define USB_PROF_CDC_SOF                            7   /* USBD_CDC_SOF */
+#define USB_PROF_APP_RECEIVE                        8   /* application Receive callback */
+#define USB_PROF_APP_TX_COMPLETE                    9   /* application TxComplete callback */
+#define USB_PROF_NUM_PATHS                          10
+/**
+  * @}
+  */
+
+/** @defgroup USB_Prof_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t min;                 /* fewest cycles seen, 0xFFFFFFFF before the first sample */
+  uint32_t max;                 /* most cycles seen */
+  uint32_t count;               /* number of samples */
+  uint64_t total;               /* sum of all samples, avg = total / count */
+} USB_ProfStatTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_PROF_ENABLED == 1)
+
+/** @defgroup USB_Prof_Exported_Variables
+  * @{
+  */
+extern USB_ProfStatTypeDef USB_ProfStats[USB_PROF_NUM_PATHS][USB_PROF_NUM_EP];
+/**
+  * @}
+  */
+
+/** @defgroup USB_Prof_Exported_Functions
+  * @{
+  */
+void USB_Prof_Init(void);
+void USB_Prof_Reset(void);
+const USB_ProfStatTypeDef *USB_Prof_Get(uint32_t path, uint32_t epnum);
+
+/**
+  * @brief  Account one sample of a path
+  * @param  path: profiled code path, USB_PROF_xxx
+  * @param  epnum: endpoint number
+  * @param  start: CYCCNT value taken when the path was entered
+  * @retval None
+  */
+static inline void USB_Prof_Record(uint32_t path, uint32_t epnum, uint32_t start)
+{
+  uint32_t cycles = DWT->CYCCNT - start;
+  USB_ProfStatTypeDef *stat = &USB_ProfStats[path][epnum & (USB_PROF_NUM_EP - 1)];
+
+  if (cycles < stat->min)
+  {
+    stat->min = cycles;
+  }
+  if (cycles > stat->max)
+  {
+    stat->max = cycles;
+  }
+  stat->count++;
+  stat->total += cycles;
+}
+/**
+  * @}
+  */
+
+#define USB_PROF_BEGIN(t)                           uint32_t t = DWT->CYCCNT
+#define USB_PROF_END(path, epnum, t)                USB_Prof_Record((path), (epnum), (t))
+
+#else
+
+#define USB_PROF_BEGIN(t)
+#define USB_PROF_END(path, epnum, t)
+
+#endif /* USB_PROF_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_PROF_H */
@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file    usb_samples.h
+  * @brief   Conversions between interleaved 16-bit USB sample payloads and
+  *          per channel q15 blocks.
+  *          On Cortex-M4 and M7 the kernels work on two samples per 32-bit
+  *          word with the DSP extension (__PKHBT/__PKHTB to split and join
+  *          channel pairs, __SMLAD for gain, offset and mixdown, __QADD16
+  *          for saturating sums, __SXTB16 to widen 8-bit samples). They
+  *          take that path when every buffer is word aligned and fall back
+  *          to one sample at a time otherwise, or on other cores. All
+  *          arithmetic saturates to the int16 range.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_SAMPLES_H
+#define __USB_SAMPLES_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Samples
+  * @brief Sample payload packing
+  * @{
+  */
+
+/** @defgroup USB_Samples_Exported_Defines
+  * @{
+  */
+/* Unity gain of USB_Samples_Gain and USB_Samples_Downmix2, q15 saturates
+   just below it */
+#define USB_SAMPLES_GAIN_ONE                        0x7FFF
+/**
+  * @}
+  */
+
+/** @defgroup USB_Samples_Exported_Functions
+  * @{
+  */
+void USB_Samples_Deinterleave(const int16_t *src, int16_t *const *dst,
+                              uint32_t channels, uint32_t frames);
+void USB_Samples_Interleave(const int16_t *const *src, int16_t *dst,
+                            uint32_t channels, uint32_t frames);
+void USB_Samples_Gain(int16_t *buf, uint32_t count, int16_t gain, int16_t offset);
+void USB_Samples_Downmix2(const int16_t *src, int16_t *dst, uint32_t frames,
+                          int16_t gain_l, int16_t gain_r);
+void USB_Samples_Add(int16_t *dst, const int16_t *src, uint32_t count);
+void USB_Samples_Widen8(const int8_t *src, int16_t *dst, uint32_t count);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_SAMPLES_H */
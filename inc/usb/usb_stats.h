@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    usb_stats.h
+  * @brief   Link statistics of the USB device.
+  *          With USB_STATS_ENABLED set to 1 the PCD driver and the CDC class
+  *          count, per endpoint number, the bytes and packets moved in each
+  *          direction, the USBD_CDC_TransmitPacket calls rejected because
+  *          the endpoint was busy, and the frames an OUT endpoint spent
+  *          NAKing between the end of a transfer and the next
+  *          HAL_PCD_EP_Receive. Bus resets, suspends and the ERR/PMAOVR
+  *          events are counted device wide. With it left at 0 every hook
+  *          expands to nothing.
+  *
+  *          The host reads the counters with a vendor request to the device
+  *          (bmRequestType 0xC0, bRequest USB_STATS_REQ_GET, wLength up to
+  *          sizeof(USB_StatsTypeDef)) and clears them with bmRequestType
+  *          0x40, bRequest USB_STATS_REQ_RESET. All fields are little endian
+  *          32 bit words.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_STATS_H
+#define __USB_STATS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Stats
+  * @brief USB link statistics
+  * @{
+  */
+
+/** @defgroup USB_Stats_Exported_Defines
+  * @{
+  */
+#ifndef USB_STATS_ENABLED
+#define USB_STATS_ENABLED                           0
+#endif
+
+#define USB_STATS_NUM_EP                            8
+
+/* Vendor requests, device recipient */
+#define USB_STATS_REQ_GET                           0x01
+#define USB_STATS_REQ_RESET                         0x02
+/**
+  * @}
+  */
+
+/** @defgroup USB_Stats_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t rx_bytes;            /* OUT/SETUP payload bytes received */
+  uint32_t rx_packets;          /* OUT/SETUP packets received */
+  uint32_t tx_bytes;            /* IN payload bytes sent */
+  uint32_t tx_packets;          /* IN packets sent, ZLPs included */
+  uint32_t tx_busy;             /* USBD_CDC_TransmitPacket calls refused */
+  uint32_t nak_frames;          /* frames spent NAKed waiting for a re-arm */
+} USB_StatsEpTypeDef;
+
+typedef struct
+{
+  uint32_t resets;              /* bus resets */
+  uint32_t suspends;            /* suspend events */
+  uint32_t errors;              /* USB_ISTR_ERR events */
+  uint32_t pma_overruns;        /* USB_ISTR_PMAOVR events */
+  USB_StatsEpTypeDef ep[USB_STATS_NUM_EP];
+} USB_StatsTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_STATS_ENABLED == 1)
+
+/** @defgroup USB_Stats_Exported_Variables
+  * @{
+  */
+extern USB_StatsTypeDef USB_Stats;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Stats_Exported_Functions
+  * @{
+  */
+void USB_Stats_Reset(void);
+const USB_StatsTypeDef *USB_Stats_Snapshot(void);
+void USB_Stats_OutIdle(uint32_t epnum, uint16_t frame);
+void USB_Stats_OutArmed(uint32_t epnum, uint16_t frame);
+/**
+  * @}
+  */
+
+#define USB_STATS_EP(epnum)                         (&USB_Stats.ep[(epnum) & (USB_STATS_NUM_EP - 1U)])
+
+#define USB_STATS_EVENT(field)                      (USB_Stats.field++)
+#define USB_STATS_RX(epnum, n)                      do { USB_StatsEpTypeDef *st_ = USB_STATS_EP(epnum); \
+                                                         st_->rx_bytes += (n); st_->rx_packets++; } while (0)
+#define USB_STATS_TX(epnum, n)                      do { USB_StatsEpTypeDef *st_ = USB_STATS_EP(epnum); \
+                                                         st_->tx_bytes += (n); st_->tx_packets++; } while (0)
+#define USB_STATS_TX_BUSY(epnum)                    (USB_STATS_EP(epnum)->tx_busy++)
+#define USB_STATS_OUT_IDLE(epnum, frame)            USB_Stats_OutIdle((epnum), (frame))
+#define USB_STATS_OUT_ARMED(epnum, frame)           USB_Stats_OutArmed((epnum), (frame))
+
+#else
+
+#define USB_STATS_EVENT(field)
+#define USB_STATS_RX(epnum, n)
+#define USB_STATS_TX(epnum, n)
+#define USB_STATS_TX_BUSY(epnum)
+#define USB_STATS_OUT_IDLE(epnum, frame)
+#define USB_STATS_OUT_ARMED(epnum, frame)
+
+#endif /* USB_STATS_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_STATS_H */
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    usb_suspend.h
+  * @brief   STOP mode while the bus is suspended.
+  *          With USB_SUSPEND_ENABLED set to 1, USB_Suspend_Process, called
+  *          from the main loop, puts the MCU in STOP mode once the core has
+  *          seen the suspend interrupt. The USB wakeup EXTI line brings it
+  *          back; the system clock is then rebuilt from the saved RCC state
+  *          (HSE and PLL relocked, source switched back) before any
+  *          interrupt runs, so the PCD handles the resume signalling at its
+  *          normal speed. Everything stays in SRAM and in the peripheral
+  *          registers: no endpoint is closed and the class state of CDC is
+  *          left as it was.
+  *
+  *          The application:
+  *            - calls USB_Suspend_Init after USBD_Start,
+  *            - calls USB_Suspend_WakeupIRQHandler from the USB wakeup
+  *              vector (USBWakeUp_IRQHandler, OTG_FS_WKUP_IRQHandler or
+  *              OTG_HS_WKUP_IRQHandler),
+  *            - on the OTG cores, sets Init.low_power_enable so the PHY
+  *              clock is gated on suspend,
+  *            - gates whatever else draws current in the Enter hook and
+  *              restores it in Exit.
+  *          Any enabled interrupt also ends STOP; the next call of
+  *          USB_Suspend_Process goes back to sleep if the bus is still
+  *          suspended.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_SUSPEND_H
+#define __USB_SUSPEND_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Suspend
+  * @brief STOP mode on bus suspend
+  * @{
+  */
+
+/** @defgroup USB_Suspend_Exported_Defines
+  * @{
+  */
+#ifndef USB_SUSPEND_ENABLED
+#define USB_SUSPEND_ENABLED                         0
+#endif
+
+/* 1 runs the regulator in low-power mode during STOP: less current, a few
+   microseconds more to wake up */
+#ifndef USB_SUSPEND_LP_REGULATOR
+#define USB_SUSPEND_LP_REGULATOR                    1
+#endif
+
+/* Polls of a ready flag before the clock restore gives up and stays on HSI */
+#ifndef USB_SUSPEND_CLOCK_TIMEOUT
+#define USB_SUSPEND_CLOCK_TIMEOUT                   100000U
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USB_Suspend_Exported_Types
+  * @{
+  */
+typedef struct
+{
+  void (*Enter)(void);   /* before STOP, interrupts enabled */
+  void (*Exit)(void);    /* after the clock restore, interrupts still masked */
+} USB_Suspend_HooksTypeDef;
+
+typedef struct
+{
+  uint32_t sleeps;       /* STOP mode entries */
+  uint32_t aborts;       /* resumed between Enter and STOP */
+  uint32_t clock_errors; /* HSE or PLL not ready again, left on HSI */
+} USB_Suspend_StatsTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_SUSPEND_ENABLED == 1)
+
+/** @defgroup USB_Suspend_Exported_Functions
+  * @{
+  */
+void     USB_Suspend_Init(USBD_HandleTypeDef *pdev, const USB_Suspend_HooksTypeDef *hooks);
+uint8_t  USB_Suspend_Process(void);
+void     USB_Suspend_WakeupIRQHandler(void);
+const USB_Suspend_StatsTypeDef *USB_Suspend_GetStats(void);
+/**
+  * @}
+  */
+
+#endif /* USB_SUSPEND_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_SUSPEND_H */
@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    usb_tick.h
+  * @brief   Tickless HAL timebase.
+  *          With USB_TICK_ENABLED set to 1, the HAL timebase is a 32-bit
+  *          timer (TIM2 by default, TIM5 on the F4 also works) counting
+  *          freely at 1 kHz times a power of two, instead of the 1 kHz
+  *          SysTick interrupt: this module replaces HAL_InitTick,
+  *          HAL_GetTick, HAL_Delay, HAL_SuspendTick and HAL_ResumeTick, and
+  *          SysTick is left off. HAL_GetTick is computed from the counter,
+  *          so the HAL timeouts work as before with no interrupt at all.
+  *
+  *          The timer only interrupts for a deadline: a compare channel is
+  *          programmed for the earliest of the USB_TICK_TIMERS one-shot
+  *          timers started with USB_Tick_Start, a second one for the end of
+  *          HAL_Delay, which sleeps in WFI meanwhile when called from
+  *          thread mode. The counter wrap costs one interrupt every few
+  *          days at the most. An idle device then only wakes for its own
+  *          deadlines and for USB.
+  *
+  *          The application calls USB_Tick_IRQHandler from the vector of
+  *          the timer; HAL_Init and HAL_RCC_ClockConfig set the timer up
+  *          through HAL_InitTick. The timer stops in STOP mode, as SysTick
+  *          does: the time spent suspended by USB_Suspend_Process is not
+  *          counted, and a deadline falling in it is served on resume.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_TICK_H
+#define __USB_TICK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Tick
+  * @brief Tickless HAL timebase
+  * @{
+  */
+
+/** @defgroup USB_Tick_Exported_Defines
+  * @{
+  */
+#ifndef USB_TICK_ENABLED
+#define USB_TICK_ENABLED                            0
+#endif
+
+/* 32-bit timer on APB1, its vector and its clock enable bit */
+#ifndef USB_TICK_TIM
+#define USB_TICK_TIM                                TIM2
+#define USB_TICK_IRQn                               TIM2_IRQn
+#define USB_TICK_TIM_EN                             RCC_APB1ENR_TIM2EN
+#endif
+
+/* One-shot timers of USB_Tick_Start */
+#ifndef USB_TICK_TIMERS
+#define USB_TICK_TIMERS                             4U
+#endif
+/**
+  * @}
+  */
+
+#if (USB_TICK_ENABLED == 1)
+
+/** @defgroup USB_Tick_Exported_Types
+  * @{
+  */
+typedef void (*USB_Tick_CallbackTypeDef)(uint8_t id);
+/**
+  * @}
+  */
+
+/** @defgroup USB_Tick_Exported_Functions
+  * @{
+  */
+void     USB_Tick_Start(uint8_t id, uint32_t delay, USB_Tick_CallbackTypeDef callback);
+void     USB_Tick_Stop(uint8_t id);
+void     USB_Tick_IRQHandler(void);
+uint32_t USB_Tick_GetWakeups(void);
+/**
+  * @}
+  */
+
+#endif /* USB_TICK_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_TICK_H */
@@ -0,0 +1,165 @@
+/**
+  ******************************************************************************
+  * @file    usb_timesync.h
+  * @brief   Device time on the host frame clock.
+  *          With USB_TIMESYNC_ENABLED set to 1 the PCD driver hands each SOF
+  *          to the service: the frame number and the DWT cycle count taken
+  *          on entry to the USB interrupt. A phase locked loop on them
+  *          tracks the moment of the last SOF and the length of a frame in
+  *          cycles, which is the drift of the core clock against the host.
+  *          Any cycle count then converts to a frame number and a
+  *          microsecond within that frame, so records carry host time
+  *          without a round trip: the host matches the low 11 bits of the
+  *          frame with the frame counter of its controller
+  *          (WinUsb_GetCurrentFrameNumber on Windows). With it left at 0
+  *          every hook expands to nothing.
+  *
+  *          The SOF interrupt is turned on by the PCD for the service. The
+  *          loop locks after USB_TIMESYNC_ACQ_FRAMES frames and loses lock
+  *          on a bus reset, a suspend or a run of late SOFs; stamps taken
+  *          while unlocked have USB_TIMESYNC_STAMP_VALID clear. At high
+  *          speed only the first microframe of each frame is used.
+  *
+  *          Stamp layout:
+  *            [31]    USB_TIMESYNC_STAMP_VALID
+  *            [30:10] frame number, extended past the 11 bits of the bus
+  *            [9:0]   microsecond in the frame, 0 to 999
+  *
+  *          The including file must already have the CMSIS core header of
+  *          the device in scope (DWT, CoreDebug).
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_TIMESYNC_H
+#define __USB_TIMESYNC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_TimeSync
+  * @brief Host frame clock time base
+  * @{
+  */
+
+/** @defgroup USB_TimeSync_Exported_Defines
+  * @{
+  */
+#ifndef USB_TIMESYNC_ENABLED
+#define USB_TIMESYNC_ENABLED                        0
+#endif
+
+/* Frames the frame length is first measured over, before the loop runs */
+#ifndef USB_TIMESYNC_ACQ_FRAMES
+#define USB_TIMESYNC_ACQ_FRAMES                     64U
+#endif
+
+/* Largest phase error of a locked SOF in microseconds; later ones are
+   skipped as interrupt latency, and USB_TIMESYNC_MAX_LATE in a row drop
+   the lock */
+#ifndef USB_TIMESYNC_MAX_ERR_US
+#define USB_TIMESYNC_MAX_ERR_US                     4U
+#endif
+#define USB_TIMESYNC_MAX_LATE                       8U
+
+/* Fraction bits of the frame length */
+#define USB_TIMESYNC_PERIOD_SHIFT                   12U
+
+/* States of the loop */
+#define USB_TIMESYNC_IDLE                           0U   /* waiting for a SOF */
+#define USB_TIMESYNC_ACQ                            1U   /* measuring the frame length */
+#define USB_TIMESYNC_LOCKED                         2U
+
+#define USB_TIMESYNC_STAMP_VALID                    0x80000000U
+#define USB_TIMESYNC_STAMP_FRAME(s)                 (((s) >> 10) & 0x1FFFFFU)
+#define USB_TIMESYNC_STAMP_USEC(s)                  ((s) & 0x3FFU)
+/**
+  * @}
+  */
+
+/** @defgroup USB_TimeSync_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t frame;               /* frame of the last SOF, extended */
+  uint32_t cycles;              /* CYCCNT at the last SOF, as the loop sees it */
+  uint32_t period;              /* cycles per frame, USB_TIMESYNC_PERIOD_SHIFT fraction bits */
+  uint32_t nominal;             /* period at the nominal core clock */
+  uint16_t frac;                /* fraction of a cycle of cycles */
+  uint16_t bus_frame;           /* 11 bit frame number of the last SOF */
+  uint8_t  state;               /* USB_TIMESYNC_xxx */
+  uint8_t  late;                /* SOFs skipped in a row */
+  uint16_t acq;                 /* frames into the acquisition */
+  uint32_t acq_cycles;          /* CYCCNT at the start of the acquisition */
+  uint32_t sofs;                /* SOFs seen */
+  uint32_t skipped;             /* SOFs skipped as late */
+  uint32_t relocks;             /* locks lost */
+} USB_TimeSyncTypeDef;
+/**
+  * @}
+  */
+
+#if (USB_TIMESYNC_ENABLED == 1)
+
+/** @defgroup USB_TimeSync_Exported_Variables
+  * @{
+  */
+extern USB_TimeSyncTypeDef USB_TimeSync;
+/**
+  * @}
+  */
+
+/** @defgroup USB_TimeSync_Exported_Functions
+  * @{
+  */
+void     USB_TimeSync_Init(void);
+void     USB_TimeSync_Reset(void);
+void     USB_TimeSync_SOF(uint16_t bus_frame, uint32_t cycles);
+uint32_t USB_TimeSync_Stamp(uint32_t cycles);
+int32_t  USB_TimeSync_GetDrift(void);
+
+/**
+  * @brief  Stamp of the present moment
+  * @retval stamp, see the layout above
+  */
+static inline uint32_t USB_TimeSync_Now(void)
+{
+  return USB_TimeSync_Stamp(DWT->CYCCNT);
+}
+/**
+  * @}
+  */
+
+#define USB_TIMESYNC_BEGIN(t)                       uint32_t t = DWT->CYCCNT
+#define USB_TIMESYNC_SOF(frame, t)                  USB_TimeSync_SOF((frame), (t))
+#define USB_TIMESYNC_RESET()                        USB_TimeSync_Reset()
+
+#else
+
+#define USB_TIMESYNC_BEGIN(t)
+#define USB_TIMESYNC_SOF(frame, t)
+#define USB_TIMESYNC_RESET()
+
+#endif /* USB_TIMESYNC_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_TIMESYNC_H */
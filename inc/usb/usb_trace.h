@@ -0,0 +1,171 @@
+/**
+  ******************************************************************************
+  * @file    usb_trace.h
+  * @brief   Binary trace of the USB device events over ITM/SWO.
+  *          With USB_TRACE_ENABLED set to 1 the PCD driver and the CDC class
+  *          write one 32-bit record per event to ITM stimulus port
+  *          USB_TRACE_PORT: SETUP packets, every packet moved on an
+  *          endpoint, USBD_CDC_TransmitPacket calls refused with USBD_BUSY,
+  *          bus reset, suspend, LPM L1 entry and resume. With it left at 0
+  *          every hook expands to nothing.
+  *
+  *          A record is never waited for: when the stimulus FIFO is full it
+  *          is dropped and counted, and the next one that fits is preceded
+  *          by a USB_TRACE_EVT_DROP record with the count. Timing comes
+  *          from the ITM local timestamp packets, which USB_Trace_Init
+  *          enables, so records carry no time field. tools/usb_trace.py
+  *          turns the SWO capture into a timeline.
+  *
+  *          Record layout, little endian:
+  *            [31:24] event, USB_TRACE_EVT_xxx
+  *            [23:16] endpoint address, or bmRequestType for SETUP
+  *            [15:0]  byte count, bRequest << 8 | low byte of wValue for
+  *                    SETUP, records lost for DROP
+  *
+  *          The including file must already have the CMSIS core header of
+  *          the device in scope (ITM).
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_TRACE_H
+#define __USB_TRACE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Trace
+  * @brief USB event trace
+  * @{
+  */
+
+/** @defgroup USB_Trace_Exported_Defines
+  * @{
+  */
+#ifndef USB_TRACE_ENABLED
+#define USB_TRACE_ENABLED                           0
+#endif
+
+/* ITM stimulus port of the records, 0 is usually taken by printf */
+#ifndef USB_TRACE_PORT
+#define USB_TRACE_PORT                              8U
+#endif
+
+#if (USB_TRACE_PORT > 31U)
+#error "USB_TRACE_PORT must be an ITM stimulus port, 0 to 31"
+#endif
+
+/* Events */
+#define USB_TRACE_EVT_DROP                          0x01U
+#define USB_TRACE_EVT_SETUP                         0x02U
+#define USB_TRACE_EVT_OUT                           0x03U   /* OUT packet received */
+#define USB_TRACE_EVT_IN                            0x04U   /* IN packet sent */
+#define USB_TRACE_EVT_BUSY                          0x05U   /* USBD_BUSY returned */
+#define USB_TRACE_EVT_RESET                         0x06U
+#define USB_TRACE_EVT_SUSPEND                       0x07U
+#define USB_TRACE_EVT_RESUME                        0x08U
+#define USB_TRACE_EVT_L1                            0x09U   /* LPM L1 entered, left with RESUME */
+
+#define USB_TRACE_WORD(evt, ep, arg)                (((uint32_t)(evt) << 24) | \
+                                                     (((uint32_t)(ep) & 0xFFU) << 16) | \
+                                                     ((uint32_t)(arg) & 0xFFFFU))
+/**
+  * @}
+  */
+
+#if (USB_TRACE_ENABLED == 1)
+
+/** @defgroup USB_Trace_Exported_Variables
+  * @{
+  */
+extern volatile uint32_t USB_Trace_Drops;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Trace_Exported_Functions
+  * @{
+  */
+void USB_Trace_Init(uint32_t swo_prescaler);
+
+/**
+  * @brief  Write one record if the stimulus port can take it right now
+  * @note   A record that arrives between the ready check and the write of
+  *         a lower priority context is lost without being counted.
+  * @param  word: record, USB_TRACE_WORD
+  * @retval None
+  */
+static inline void USB_Trace_Put(uint32_t word)
+{
+  uint32_t drops;
+
+  if (((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0U) ||
+      ((ITM->TER & (1UL << USB_TRACE_PORT)) == 0U))
+  {
+    /* nobody listening */
+    return;
+  }
+
+  if (ITM->PORT[USB_TRACE_PORT].u32 == 0U)
+  {
+    USB_Trace_Drops++;
+    return;
+  }
+
+  drops = USB_Trace_Drops;
+  if (drops != 0U)
+  {
+    ITM->PORT[USB_TRACE_PORT].u32 = USB_TRACE_WORD(USB_TRACE_EVT_DROP, 0U,
+                                                   (drops > 0xFFFFU) ? 0xFFFFU : drops);
+    USB_Trace_Drops = 0U;
+
+    if (ITM->PORT[USB_TRACE_PORT].u32 == 0U)
+    {
+      USB_Trace_Drops = 1U;
+      return;
+    }
+  }
+
+  ITM->PORT[USB_TRACE_PORT].u32 = word;
+}
+/**
+  * @}
+  */
+
+#define USB_TRACE_SETUP(setup)                      USB_Trace_Put(USB_TRACE_WORD(USB_TRACE_EVT_SETUP, (setup)[0], \
+                                                                                 ((uint32_t)(setup)[1] << 8) | (setup)[2]))
+#define USB_TRACE_OUT(epnum, n)                     USB_Trace_Put(USB_TRACE_WORD(USB_TRACE_EVT_OUT, (epnum), (n)))
+#define USB_TRACE_IN(epnum, n)                      USB_Trace_Put(USB_TRACE_WORD(USB_TRACE_EVT_IN, (epnum) | 0x80U, (n)))
+#define USB_TRACE_BUSY(ep_addr)                     USB_Trace_Put(USB_TRACE_WORD(USB_TRACE_EVT_BUSY, (ep_addr), 0U))
+#define USB_TRACE_EVENT(evt)                        USB_Trace_Put(USB_TRACE_WORD((evt), 0U, 0U))
+
+#else
+
+#define USB_TRACE_SETUP(setup)
+#define USB_TRACE_OUT(epnum, n)
+#define USB_TRACE_IN(epnum, n)
+#define USB_TRACE_BUSY(ep_addr)
+#define USB_TRACE_EVENT(evt)
+
+#endif /* USB_TRACE_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_TRACE_H */
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    usb_vbus.h
+  * @brief   VBUS sensing on a GPIO, for a prompt detach and re-attach.
+  *          With USB_VBUS_ENABLED set to 1, a GPIO wired to VBUS (through
+  *          the divider the board needs for a 5 V signal) raises its EXTI
+  *          line on both edges. When VBUS goes away the device is
+  *          detached at once, from the interrupt: pull-up off through
+  *          HAL_PCD_DevDisconnect, then USBD_LL_DevDisconnected, which
+  *          deconfigures the class. For CDC that hands queued buffers back
+  *          and makes USBD_CDC_Write and friends return 0, so producers
+  *          stop right away instead of on the suspend 3 ms later, or never
+  *          when the device is self powered. When VBUS comes back the
+  *          pull-up goes on again after USB_VBUS_DEBOUNCE_MS of stable
+  *          VBUS, or at once from the interrupt with 0: the host starts
+  *          the enumeration as soon as it sees the pull-up.
+  *
+  *          The application:
+  *            - configures the pin as an input,
+  *            - calls USB_VBUS_Init after USBD_Start, which applies the
+  *              current level,
+  *            - calls USB_VBUS_IRQHandler from the EXTI vector of the pin,
+  *              at the priority of the USB interrupt,
+  *            - with a debounce time, calls USB_VBUS_Process from the main
+  *              loop.
+  *          This is for the F3 USB peripheral, which has no VBUS input,
+  *          and for OTG cores run with vbus_sensing_enable off.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_VBUS_H
+#define __USB_VBUS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_VBUS
+  * @brief VBUS sensing
+  * @{
+  */
+
+/** @defgroup USB_VBUS_Exported_Defines
+  * @{
+  */
+#ifndef USB_VBUS_ENABLED
+#define USB_VBUS_ENABLED                            0
+#endif
+
+/* Stable VBUS before the pull-up goes on again, ms; 0 connects from the
+   interrupt on the rising edge */
+#ifndef USB_VBUS_DEBOUNCE_MS
+#define USB_VBUS_DEBOUNCE_MS                        0U
+#endif
+/**
+  * @}
+  */
+
+#if (USB_VBUS_ENABLED == 1)
+
+/** @defgroup USB_VBUS_Exported_Types
+  * @{
+  */
+typedef struct
+{
+  GPIO_TypeDef *Port;            /* port of the VBUS pin */
+  uint16_t      Pin;             /* pin number, 0 to 15 */
+  IRQn_Type     IRQn;            /* EXTI vector of the pin */
+  void (*Detach)(void);          /* after the detach, from the interrupt; may be NULL */
+  void (*Attach)(void);          /* after the pull-up went on; may be NULL */
+} USB_VBUS_ConfigTypeDef;
+
+typedef struct
+{
+  uint32_t detaches;      /* VBUS lost while attached */
+  uint32_t attaches;      /* pull-up switched on */
+  uint32_t bounces;       /* VBUS lost again within the debounce time */
+} USB_VBUS_StatsTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_VBUS_Exported_Functions
+  * @{
+  */
+void     USB_VBUS_Init(USBD_HandleTypeDef *pdev, const USB_VBUS_ConfigTypeDef *cfg);
+void     USB_VBUS_IRQHandler(void);
+void     USB_VBUS_Process(void);
+uint8_t  USB_VBUS_IsPresent(void);
+const USB_VBUS_StatsTypeDef *USB_VBUS_GetStats(void);
+/**
+  * @}
+  */
+
+#endif /* USB_VBUS_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_VBUS_H */
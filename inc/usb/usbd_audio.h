@@ -0,0 +1,195 @@
+/**
+  ******************************************************************************
+  * @file    usbd_audio.h
+  * @brief   USB Audio Class 1.0 input stream, asynchronous.
+  *          With USBD_AUDIO_ENABLED set to 1, USBD_AUDIO is an audio
+  *          function of a control and a streaming interface. It sends 16
+  *          bit PCM at USBD_AUDIO_FREQ on one isochronous IN endpoint, one
+  *          packet each frame, bandwidth reserved by the host from the
+  *          moment it selects alternate setting 1.
+  *
+  *          The samples come from a clock of their own (ADC timer, sensor
+  *          ODR), so the endpoint is asynchronous: the class counts the
+  *          samples USBD_AUDIO_Write queued between SOFs over
+  *          USBD_AUDIO_RATE_FRAMES frames, which gives the rate of the
+  *          source in samples per frame, and sizes each packet from it
+  *          (Q10.14 accumulator, the format of UAC rate feedback). A servo
+  *          on the FIFO level adds or drops a sample while the level is off
+  *          its midpoint, so drift never under- or overruns it.
+  *
+  *          The application:
+  *            - calls USBD_AUDIO_Write from the acquisition interrupt or
+  *              DMA callback, single producer,
+  *            - gives the endpoint two packet buffers of
+  *              USBD_AUDIO_MAX_PACKET bytes: USBD_AUDIO_Init does it from
+  *              USBD_AUDIO_PMA_ADDR on the FS device,
+  *            - maps HAL_PCD_ISOINIncompleteCallback to
+  *              USBD_LL_IsoINIncomplete in its low level glue.
+  *          Standalone, USBD_AUDIO is registered like USBD_CDC and the
+  *          device descriptor announces the IAD class; under USBD_COMPOSITE
+  *          it is added with its interfaces and endpoint moved clear of the
+  *          other functions.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_AUDIO_H
+#define __USBD_AUDIO_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_ioreq.h"
+#include "usbd_composite.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_audio
+  * @brief Audio streaming class
+  * @{
+  */
+
+/** @defgroup usbd_audio_Exported_Defines
+  * @{
+  */
+#ifndef USBD_AUDIO_ENABLED
+#define USBD_AUDIO_ENABLED                          0
+#endif
+
+/* Audio control interface, the streaming interface follows it */
+#ifndef USBD_AUDIO_AC_ITF_NUM
+#define USBD_AUDIO_AC_ITF_NUM                       0
+#endif
+#define USBD_AUDIO_AS_ITF_NUM                       (USBD_AUDIO_AC_ITF_NUM + 1)
+
+#ifndef USBD_AUDIO_IN_EP
+#define USBD_AUDIO_IN_EP                            0x81
+#endif
+
+/* Sample rate in Hz and channels of 16 bit samples */
+#ifndef USBD_AUDIO_FREQ
+#define USBD_AUDIO_FREQ                             48000U
+#endif
+#ifndef USBD_AUDIO_CHANNELS
+#define USBD_AUDIO_CHANNELS                         1U
+#endif
+
+/* Sample frames the FIFO holds, a power of two. It runs half full, which
+   is also the latency it adds. */
+#ifndef USBD_AUDIO_FIFO_FRAMES
+#define USBD_AUDIO_FIFO_FRAMES                      512U
+#endif
+#if ((USBD_AUDIO_FIFO_FRAMES & (USBD_AUDIO_FIFO_FRAMES - 1U)) != 0U)
+#error "USBD_AUDIO_FIFO_FRAMES must be a power of two"
+#endif
+
+/* USB frames the rate of the source is measured over, a power of two */
+#ifndef USBD_AUDIO_RATE_FRAMES
+#define USBD_AUDIO_RATE_FRAMES                      128U
+#endif
+#if ((USBD_AUDIO_RATE_FRAMES & (USBD_AUDIO_RATE_FRAMES - 1U)) != 0U)
+#error "USBD_AUDIO_RATE_FRAMES must be a power of two"
+#endif
+
+#ifndef USBD_AUDIO_PMA_ALLOC
+#if defined(USB_OTG_FS)
+#define USBD_AUDIO_PMA_ALLOC                        0
+#else
+#define USBD_AUDIO_PMA_ALLOC                        1
+#endif
+#endif
+
+#define USBD_AUDIO_FRAME_BYTES                      (2U * USBD_AUDIO_CHANNELS)
+/* Nominal sample frames per USB frame, rounded up, and one more for drift */
+#define USBD_AUDIO_NOMINAL_FRAMES                   ((USBD_AUDIO_FREQ + 999U) / 1000U)
+#define USBD_AUDIO_MAX_FRAMES                       (USBD_AUDIO_NOMINAL_FRAMES + 1U)
+#define USBD_AUDIO_MAX_PACKET                       (USBD_AUDIO_MAX_FRAMES * USBD_AUDIO_FRAME_BYTES)
+
+#if (USBD_AUDIO_MAX_PACKET > 1023U)
+#error "USBD_AUDIO_FREQ and USBD_AUDIO_CHANNELS exceed a full speed isochronous packet"
+#endif
+#if (USBD_AUDIO_FIFO_FRAMES < 4U * USBD_AUDIO_MAX_FRAMES)
+#error "USBD_AUDIO_FIFO_FRAMES too small for the packet size"
+#endif
+
+/* Audio function: IAD, control interface, streaming interface with two
+   alternate settings */
+#define USBD_AUDIO_FUNC_DESC_SIZ                    99
+#define USBD_AUDIO_CFG_DESC_SIZ                     (9 + USBD_AUDIO_FUNC_DESC_SIZ)
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct _USBD_AUDIO_Itf
+{
+  void (* Init)          (void);
+  void (* DeInit)        (void);
+  /* The host opened (1) or closed (0) the stream */
+  void (* Streaming)     (uint8_t on);
+} USBD_AUDIO_ItfTypeDef;
+
+typedef struct
+{
+  int16_t           Fifo[USBD_AUDIO_FIFO_FRAMES * USBD_AUDIO_CHANNELS];
+  __IO uint32_t     Wr;         /* sample frames queued, producer */
+  __IO uint32_t     Rd;         /* sample frames sent, USB */
+  uint32_t          RateStart;  /* Wr when the measuring window opened */
+  uint32_t          Rate;       /* sample frames per USB frame, Q10.14 */
+  uint32_t          Acc;        /* Q10.14 fraction carried to the next packet */
+  uint32_t          Missed;     /* frames the host polled no packet in */
+  __IO uint32_t     Dropped;    /* sample frames lost to a full FIFO */
+  uint16_t          RateFrames; /* SOFs in the measuring window */
+  uint8_t           AltSetting;
+  __ALIGN_BEGIN int16_t Packet[USBD_AUDIO_MAX_FRAMES * USBD_AUDIO_CHANNELS] __ALIGN_END;
+} USBD_AUDIO_HandleTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_AUDIO_ENABLED == 1)
+
+/** @defgroup usbd_audio_Exported_Variables
+  * @{
+  */
+extern USBD_ClassTypeDef  USBD_AUDIO;
+#define USBD_AUDIO_CLASS    &USBD_AUDIO
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_AUDIO_RegisterInterface  (USBD_HandleTypeDef *pdev,
+                                        USBD_AUDIO_ItfTypeDef *fops);
+
+uint32_t USBD_AUDIO_Write              (USBD_HandleTypeDef *pdev,
+                                        const int16_t *samples,
+                                        uint32_t frames);
+
+uint32_t USBD_AUDIO_GetRate            (USBD_HandleTypeDef *pdev);
+/**
+  * @}
+  */
+
+#endif /* USBD_AUDIO_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_AUDIO_H */
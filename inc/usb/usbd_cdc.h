@@ -35,6 +35,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include  "usbd_ioreq.h"
+#include  "usb_timesync.h"
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
   * @{
@@ -45,7 +46,16 @@
   * @{
   */ 
 
+/* Number of virtual serial ports. Each one takes two endpoint numbers (bulk
+   data, interrupt notification), so the 8 endpoints of the FS device leave
+   room for 3. */
+#ifndef NUM_CDC_INSTANCES
 #define NUM_CDC_INSTANCES 2
+#endif
+
+#if (NUM_CDC_INSTANCES < 1) || (NUM_CDC_INSTANCES > 3)
+#error "NUM_CDC_INSTANCES must be between 1 and 3"
+#endif
 
 /** @defgroup usbd_cdc_Exported_Defines
   * @{
@@ -53,23 +63,299 @@
 #define CDC_IN_EP                                   0x81  /* EP1 for data IN */
 #define CDC_OUT_EP                                  0x01  /* EP1 for data OUT */
 #define CDC_CMD_EP                                  0x82  /* EP2 for CDC commands */
-#define CDC2_IN_EP                                  0x84  /* EP3 for data IN */
-#define CDC2_OUT_EP                                 0x04  /* EP3 for data OUT */
-#define CDC2_CMD_EP                                 0x85  /* EP4 for CDC commands */
+#define CDC2_IN_EP                                  0x84  /* EP4 for data IN */
+#define CDC2_OUT_EP                                 0x04  /* EP4 for data OUT */
+#define CDC2_CMD_EP                                 0x85  /* EP5 for CDC commands */
+#define CDC3_IN_EP                                  0x83  /* EP3 for data IN */
+#define CDC3_OUT_EP                                 0x03  /* EP3 for data OUT */
+#define CDC3_CMD_EP                                 0x86  /* EP6 for CDC commands */
 #define CDC2_EP_MASK 0x04
 
+/* Interface numbers of an instance in the generated configuration descriptor */
+#define USBD_CDC_CIF_NUM(inst)                      (2 * (inst))
+#define USBD_CDC_DIF_NUM(inst)                      (2 * (inst) + 1)
+
+/* Build the configuration descriptor in usbd_cdc.c rather than using the
+   board provided IADCDCTwoDescriptor, which only describes two ports */
+#ifndef USBD_CDC_GENERATED_DESC
+#if (NUM_CDC_INSTANCES == 2)
+#define USBD_CDC_GENERATED_DESC                     0
+#else
+#define USBD_CDC_GENERATED_DESC                     1
+#endif
+#endif
+
 /* CDC Endpoints parameters: you can fine tune these values depending on the needed baudrates and performance. */
+#if (USBD_FS_ONLY == 1)
+#define CDC_DATA_HS_MAX_PACKET_SIZE                 CDC_DATA_FS_MAX_PACKET_SIZE
+#else
 #define CDC_DATA_HS_MAX_PACKET_SIZE                 512  /* Endpoint IN & OUT Packet size */
+#endif
 #define CDC_DATA_FS_MAX_PACKET_SIZE                 64  /* Endpoint IN & OUT Packet size */
+/* Notification endpoint packet size. The urgent channel needs room for its
+   messages, a single packet each; the board must give the endpoint that
+   much packet memory unless USBD_CDC_PMA_ALLOC is set. */
+#ifndef CDC_CMD_PACKET_SIZE
+#if (USBD_CDC_URGENT == 1)
+#define CDC_CMD_PACKET_SIZE                         32
+#else
 #define CDC_CMD_PACKET_SIZE                         8  /* Control Endpoint Packet size */ 
+#endif
+#endif
 
 #define USB_CDC_CONFIG_DESC_SIZ                     67
+#define USBD_CDC_FUNC_DESC_SIZ                      66    /* IAD + one ACM function */
+#define USBD_CDC_CFG_DESC_SIZ                       (9 + USBD_CDC_FUNC_DESC_SIZ * NUM_CDC_INSTANCES)
 #define CDC_DATA_HS_IN_PACKET_SIZE                  CDC_DATA_HS_MAX_PACKET_SIZE
 #define CDC_DATA_HS_OUT_PACKET_SIZE                 CDC_DATA_HS_MAX_PACKET_SIZE
 
 #define CDC_DATA_FS_IN_PACKET_SIZE                  CDC_DATA_FS_MAX_PACKET_SIZE
 #define CDC_DATA_FS_OUT_PACKET_SIZE                 CDC_DATA_FS_MAX_PACKET_SIZE
 
+/* Full speed bulk data endpoints to run double buffered, bit n selects CDC
+   instance n. Each of them takes two packet buffers of packet memory. */
+#ifndef USBD_CDC_DBL_BUF_OUT_MASK
+#define USBD_CDC_DBL_BUF_OUT_MASK                   0x00
+#endif
+#ifndef USBD_CDC_DBL_BUF_IN_MASK
+#define USBD_CDC_DBL_BUF_IN_MASK                    0x00
+#endif
+
+/* Set to 1 to have USBD_CDC_Init assign the packet memory of all CDC
+   endpoints from the layout in usbd_cdc_pma.h. Required for double
+   buffering. */
+#ifndef USBD_CDC_PMA_ALLOC
+#if ((USBD_CDC_DBL_BUF_OUT_MASK | USBD_CDC_DBL_BUF_IN_MASK) != 0)
+#define USBD_CDC_PMA_ALLOC                          1
+#else
+#define USBD_CDC_PMA_ALLOC                          0
+#endif
+#endif
+
+/* Set to 1 to leave received packets in packet memory: the Receive callback
+   gets a NULL buffer and fetches the data with USBD_CDC_ReadRxData, or
+   converts 16-bit samples straight out of packet memory with
+   USBD_CDC_ReadRxSamples/F32 (USBD_LL_ReadRxSamples/F32 then needed). The
+   endpoint stays NAKed until USBD_CDC_ReceivePacket releases the packet. */
+#ifndef USBD_CDC_ZERO_COPY_RX
+#define USBD_CDC_ZERO_COPY_RX                       0
+#endif
+
+#if (USBD_CDC_ZERO_COPY_RX == 1) && defined(USB_OTG_FS)
+#error "USBD_CDC_ZERO_COPY_RX needs packet memory, the OTG_FS core has none"
+#endif
+
+/* Set to 1 for producers to build IN packets straight in packet memory:
+   USBD_CDC_TxReservePMA claims the IN endpoint and hands back a writer on
+   its free packet buffer, filled with USBD_PMA_PutByte/PutHalf/Write;
+   USBD_CDC_TxCommitPMA sends it. One packet per reservation, no RAM copy
+   (USBD_LL_TxReserve/TxCommit then needed). */
+#ifndef USBD_CDC_ZERO_COPY_TX
+#define USBD_CDC_ZERO_COPY_TX                       0
+#endif
+
+#if (USBD_CDC_ZERO_COPY_TX == 1) && defined(USB_OTG_FS)
+#error "USBD_CDC_ZERO_COPY_TX needs packet memory, the OTG_FS core has none"
+#endif
+
+/* Set to 1 to keep the class handle in a static variable instead of taking
+   it from USBD_malloc on every SET_CONFIGURATION; needed by USB_CCM_RINGS */
+#ifndef USBD_CDC_STATIC_HANDLE
+#define USBD_CDC_STATIC_HANDLE                      0
+#endif
+
+/* Devices running the class at the same time, each with its own handle,
+   e.g. 2 for OTG_FS and OTG_HS of an F4. The device of USBD_Init id n
+   takes static handle n: with more than one device, id must be below
+   USBD_CDC_MAX_DEVICES. */
+#ifndef USBD_CDC_MAX_DEVICES
+#define USBD_CDC_MAX_DEVICES                        1U
+#endif
+
+/* Data stage buffer of the class requests, bytes. Longer data stages are
+   cut to it. Line coding only needs 7 bytes. */
+#ifndef USBD_CDC_CTRL_DATA_SIZE
+#define USBD_CDC_CTRL_DATA_SIZE                     USB_MAX_EP0_SIZE
+#endif
+
+#if (USBD_CDC_CTRL_DATA_SIZE < 7)
+#error "USBD_CDC_CTRL_DATA_SIZE must hold the 7 bytes of the line coding"
+#endif
+
+/* Set to 1 for the class to keep the line coding and the DTR/RTS state of
+   each instance: GET_LINE_CODING is answered from it, and the Control
+   callback only sees SET_LINE_CODING and SET_CONTROL_LINE_STATE when they
+   change something. Seed it with USBD_CDC_SetLineCoding. */
+#ifndef USBD_CDC_LINE_CACHE
+#define USBD_CDC_LINE_CACHE                         0
+#endif
+
+/* Line cache only: set to 1 to abort the transmission of an instance, as
+   USBD_CDC_TxAbort does, when the host drops DTR, which is how a host
+   application closing the port shows. The next write starts right away
+   instead of waiting for a bus reset. */
+#ifndef USBD_CDC_DTR_ABORT
+#define USBD_CDC_DTR_ABORT                          0
+#endif
+
+#if (USBD_CDC_DTR_ABORT == 1) && (USBD_CDC_LINE_CACHE == 0)
+#error "USBD_CDC_DTR_ABORT needs USBD_CDC_LINE_CACHE"
+#endif
+
+/* Line coding an instance reports until the host or the application sets
+   one, 8 data bits, 1 stop bit, no parity */
+#ifndef USBD_CDC_LINE_CODING_DEFAULT_BAUD
+#define USBD_CDC_LINE_CODING_DEFAULT_BAUD           115200U
+#endif
+
+/* Initial zero length packet policy of the instances, see USBD_CDC_SetTxZlp */
+#ifndef USBD_CDC_TX_ZLP_DEFAULT
+#define USBD_CDC_TX_ZLP_DEFAULT                     1
+#endif
+
+/* Size in bytes of the per instance transmit ring fed by USBD_CDC_Write,
+   or written in place with USBD_CDC_TxReserve/USBD_CDC_TxCommit, 0 leaves
+   it out. Must be a power of two. */
+#ifndef USBD_CDC_TX_RING_SIZE
+#define USBD_CDC_TX_RING_SIZE                       0
+#endif
+
+/* Transmit ring only: hold back less than a full packet for up to this many
+   SOF frames, so that small writes get merged. 0 sends them right away.
+   The PCD must be initialized with Sof_enable set. */
+#ifndef USBD_CDC_TX_FLUSH_FRAMES
+#define USBD_CDC_TX_FLUSH_FRAMES                    0
+#endif
+
+#if (USBD_CDC_TX_FLUSH_FRAMES > 255)
+#error "USBD_CDC_TX_FLUSH_FRAMES must be 255 or less, TxAge is 8 bits wide"
+#endif
+
+/* Descriptors in the per instance transmit queue fed by USBD_CDC_TxEnqueue,
+   0 leaves it out. Must be a power of two. Queued buffers are sent in
+   place, back to back, and handed back through the callback given with
+   each of them. */
+#ifndef USBD_CDC_TX_QUEUE_SIZE
+#define USBD_CDC_TX_QUEUE_SIZE                      0
+#endif
+
+/* Set to 1 to schedule the IN endpoints of the instances against each
+   other, see USBD_CDC_SetTxSched: a byte budget per frame and a strict
+   priority, so that a flooding data port cannot crowd out a console.
+   Applies to what the class starts on its own, the transmit ring and the
+   transmit queue; USBD_CDC_TransmitPacket/Buffer/Vec are never held back
+   but are charged to the budget. The PCD must be initialized with
+   Sof_enable set. */
+#ifndef USBD_CDC_TX_SCHED
+#define USBD_CDC_TX_SCHED                           0
+#endif
+
+/* Scheduler only: frames an instance with data waiting may hold back the
+   ones of lower priority without completing a transfer, so that a port
+   the host has stopped reading does not block the others for good */
+#ifndef USBD_CDC_TX_SCHED_HOLD_FRAMES
+#define USBD_CDC_TX_SCHED_HOLD_FRAMES               8
+#endif
+
+/* Set to 1 to advertise remote wakeup in the configuration descriptor and
+   use it: data queued with USBD_CDC_Write or USBD_CDC_TransmitPacket, or a
+   SERIAL_STATE change, on a suspended bus the host enabled remote wakeup
+   on, asks the host to resume. One request per suspend: a host that
+   ignores it is not asked again until it has resumed the bus. Needs
+   USBD_LL_RemoteWakeup from the low level driver. */
+#ifndef USBD_CDC_REMOTE_WAKEUP
+#define USBD_CDC_REMOTE_WAKEUP                      0
+#endif
+
+/* Remote wakeup only: bytes an instance must have queued before it wakes
+   the host. Smaller amounts wait for the host to resume on its own;
+   SERIAL_STATE changes always wake. */
+#ifndef USBD_CDC_WAKEUP_MIN_BYTES
+#define USBD_CDC_WAKEUP_MIN_BYTES                   1
+#endif
+
+/* Set to 1 to have the PCD interrupt call the class straight from the bulk
+   endpoints, skipping the Data Stage callbacks and USBD_LL_DataIn/OutStage.
+   Needs USBD_LL_SetEPCallback from the low level driver. */
+#ifndef USBD_CDC_FAST_DISPATCH
+#define USBD_CDC_FAST_DISPATCH                      0
+#endif
+
+/* Set to 1 for USBD_CDC_TransmitVec, which sends a frame held in separate
+   buffers (header, payload, CRC) as one transfer with no assembly copy.
+   Needs USBD_LL_TransmitVec from the low level driver. */
+#ifndef USBD_CDC_TX_VEC
+#define USBD_CDC_TX_VEC                             0
+#endif
+
+/* Size in bytes of the per instance receive ring drained with
+   USBD_CDC_RxPeek/USBD_CDC_RxRelease or USBD_CDC_Read, 0 leaves it out.
+   Must be a power of two. The OUT endpoint is re-armed straight into the
+   ring while a packet still fits and NAKs the host when it is full, until
+   the consumer releases enough data. The Receive callback then only
+   notifies: it gets a NULL buffer and the number of bytes added.
+   The ring is armed at any byte offset, so it cannot be used with the
+   OTG_HS internal DMA, which needs word aligned buffers; same for the
+   transmit ring. */
+#ifndef USBD_CDC_RX_RING_SIZE
+#define USBD_CDC_RX_RING_SIZE                       0
+#endif
+
+/* Receive ring only: room past the end of the ring that a packet armed
+   near the wrap point may spill into. Must hold an OUT packet at the
+   current speed, raise to CDC_DATA_HS_MAX_PACKET_SIZE for high speed. */
+#ifndef USBD_CDC_RX_RING_SLACK
+#define USBD_CDC_RX_RING_SLACK                      CDC_DATA_FS_MAX_PACKET_SIZE
+#endif
+
+/* Set to 1 for the blocking USBD_CDC_BlockingRead/Write calls. An instance
+   with an OS layer registered by USBD_CDC_RegisterOs hands its received
+   packets to USBD_CDC_BlockingRead instead of the Receive callback. */
+#ifndef USBD_CDC_OS
+#define USBD_CDC_OS                                 0
+#endif
+
+/* Set to 1 for latency histograms per instance, in DWT cycles: transmit
+   from USBD_CDC_Write, USBD_CDC_SetTxBuffer or USBD_CDC_TransmitBuffer to
+   the IN completion of the last byte, receive from the OUT completion to
+   the application taking the data (re-arming the endpoint, or
+   USBD_CDC_RxRelease with the receive ring). Bucket n counts latencies
+   from 2^(n-1) to 2^n - 1 cycles, the last one everything longer. Read
+   with USBD_CDC_GetLatency or the USBD_CDC_LAT_REQ_GET vendor request.
+   The transfers of USBD_CDC_TxEnqueue are not timed. */
+#ifndef USBD_CDC_LAT_HIST
+#define USBD_CDC_LAT_HIST                           0
+#endif
+
+/* Latency histograms only: buckets of each histogram */
+#ifndef USBD_CDC_LAT_BUCKETS
+#define USBD_CDC_LAT_BUCKETS                        32
+#endif
+
+/* Latency histograms with a ring only: writes or packets in flight that
+   are timed, a power of two. The ones past it go untimed. */
+#ifndef USBD_CDC_LAT_MARKS
+#define USBD_CDC_LAT_MARKS                          8
+#endif
+
+/* Set to 1 for an urgent message channel per instance on its notification
+   endpoint, see USBD_CDC_SendUrgent: short application messages go out as
+   vendor notifications, ahead of any SERIAL_STATE, and never wait behind
+   the bulk data. The generated configuration descriptor has the host poll
+   the endpoint every frame; a board descriptor must do the same. */
+#ifndef USBD_CDC_URGENT
+#define USBD_CDC_URGENT                             0
+#endif
+
+/* Urgent channel only: messages waiting per instance, a power of two */
+#ifndef USBD_CDC_URGENT_DEPTH
+#define USBD_CDC_URGENT_DEPTH                       4
+#endif
+
+#if (USBD_CDC_URGENT == 1) && ((CDC_CMD_PACKET_SIZE < 16) || (CDC_CMD_PACKET_SIZE > 64))
+#error "USBD_CDC_URGENT needs a CDC_CMD_PACKET_SIZE of 16 to 64"
+#endif
+
 /*---------------------------------------------------------------------*/
 /*  CDC definitions                                                    */
 /*---------------------------------------------------------------------*/
@@ -83,6 +369,40 @@
 #define CDC_SET_CONTROL_LINE_STATE                  0x22
 #define CDC_SEND_BREAK                              0x23
 
+/* Line coding data of SET/GET_LINE_CODING, bytes on the wire */
+#define CDC_LINE_CODING_SIZE                        7
+
+/* SET_CONTROL_LINE_STATE bits of wValue */
+#define CDC_LINE_STATE_DTR                          0x0001
+#define CDC_LINE_STATE_RTS                          0x0002
+
+/* Notifications on the interrupt endpoint */
+#define CDC_NOTIFY_SERIAL_STATE                     0x20
+#define CDC_NOTIFY_SERIAL_STATE_SIZE                10
+
+/* SERIAL_STATE bits. DCD and DSR are levels; the others are events, sent
+   once and then cleared */
+#define CDC_SERIAL_STATE_DCD                        0x0001
+#define CDC_SERIAL_STATE_DSR                        0x0002
+#define CDC_SERIAL_STATE_BREAK                      0x0004
+#define CDC_SERIAL_STATE_RING                       0x0008
+#define CDC_SERIAL_STATE_FRAMING                    0x0010
+#define CDC_SERIAL_STATE_PARITY                     0x0020
+#define CDC_SERIAL_STATE_OVERRUN                    0x0040
+#define CDC_SERIAL_STATE_LEVELS                     (CDC_SERIAL_STATE_DCD | CDC_SERIAL_STATE_DSR)
+
+/* Vendor requests of the latency histograms, wValue is the instance */
+#define USBD_CDC_LAT_REQ_GET                        0x03
+#define USBD_CDC_LAT_REQ_RESET                      0x04
+
+/* Urgent message: a notification header with a vendor bmRequestType,
+   wValue the message number, wIndex the interface and wLength the length
+   of the payload that follows it in the same packet */
+#define USBD_CDC_URGENT_REQ_TYPE                    0xC1
+#define USBD_CDC_NOTIFY_URGENT                      0x80
+#define USBD_CDC_URGENT_HDR_SIZE                    8
+#define USBD_CDC_URGENT_MAX_SIZE                    (CDC_CMD_PACKET_SIZE - USBD_CDC_URGENT_HDR_SIZE)
+
 /**
   * @}
   */ 
@@ -103,6 +423,15 @@ typedef struct
   uint8_t  datatype;
 }USBD_CDC_LineCodingTypeDef;
 
+/* Return of the Control callback that leaves a class request unanswered,
+   with USBD_CTL_DEFERRED set. Take USBD_CtlRequestId in the callback and
+   complete the request later from thread context with
+   USBD_CtlDeferredSendData for a device to host request, with
+   USBD_CtlDeferredSendStatus otherwise, or refuse it with
+   USBD_CtlDeferredError. The data of a host to device request is only
+   valid during the callback. */
+#define USBD_CDC_CTRL_DEFERRED                      ((int8_t)USBD_BUSY)
+
 typedef struct _USBD_CDC_Itf
 {
   int8_t (* Init)          (int, void **);
@@ -112,20 +441,167 @@ typedef struct _USBD_CDC_Itf
   int8_t (* TxComplete)    (void *);
 }USBD_CDC_ItfTypeDef;
 
+#if (USBD_CDC_OS == 1)
+/* Events passed to the OS layer */
+#define USBD_CDC_OS_EVT_RX                          0x01U   /* a packet is ready to be read */
+#define USBD_CDC_OS_EVT_TX                          0x02U   /* the IN endpoint made progress */
+#define USBD_CDC_OS_EVT_LINE                        0x04U   /* line coding or DTR/RTS changed, USBD_CDC_LINE_CACHE */
+
+#define USBD_CDC_OS_WAIT_FOREVER                    0xFFFFFFFFU
+
+/* OS layer of an instance. With more than one device each device needs
+   its own, the instance number is the same on both. Signal is called from the USB interrupt and must
+   latch the events (event flags, binary semaphore) so that a signal sent
+   just before Wait is not lost. Wait blocks the calling task until one of
+   the events is signalled or timeout ticks have elapsed, and returns 0 on
+   timeout. GetTick may be NULL, in which case every wake up restarts the
+   timeout. */
+typedef struct
+{
+  void     (* Signal)        (int instance, uint32_t events);
+  uint32_t (* Wait)          (int instance, uint32_t events, uint32_t timeout);
+  uint32_t (* GetTick)       (void);
+}USBD_CDC_OsTypeDef;
+#endif /* USBD_CDC_OS */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+/* Called from the USB interrupt once the buffer of a queued transfer is no
+   longer used: status USBD_OK when it has been sent, USBD_FAIL when it was
+   dropped because the device was deconfigured. */
+typedef void (* USBD_CDC_TxDoneTypeDef)(void *token, uint8_t status);
+
+/* Queued transfer */
+typedef struct
+{
+  __IO uint32_t seq;                         /* ticket + 1 once complete */
+  const uint8_t *pbuff;
+  uint16_t length;
+  USBD_CDC_TxDoneTypeDef done;
+  void *token;
+}USBD_CDC_TxDescTypeDef;
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_LAT_HIST == 1)
+/* Latency histograms of an instance, as sent by USBD_CDC_LAT_REQ_GET */
+typedef struct
+{
+  uint32_t tx[USBD_CDC_LAT_BUCKETS];
+  uint32_t rx[USBD_CDC_LAT_BUCKETS];
+}USBD_CDC_LatHistTypeDef;
+
+/* Data in flight on a ring */
+typedef struct
+{
+  uint32_t end;                              /* ring index past its last byte */
+  uint32_t stamp;                            /* DWT->CYCCNT when it was queued */
+}USBD_CDC_LatMarkTypeDef;
+#endif /* USBD_CDC_LAT_HIST */
 
+#if (USBD_CDC_URGENT == 1)
+/* Urgent message, as sent on the notification endpoint */
 typedef struct
 {
-  uint32_t data[CDC_DATA_HS_MAX_PACKET_SIZE/4];      /* Force 32bits alignment */
+  __IO uint32_t seq;                         /* ticket + 1 once complete */
+  uint8_t  data[CDC_CMD_PACKET_SIZE];
+  uint16_t length;
+}USBD_CDC_UrgentTypeDef;
+#endif /* USBD_CDC_URGENT */
+
+
+typedef struct
+{
+  uint32_t data[(USBD_CDC_CTRL_DATA_SIZE + 3) / 4];  /* Force 32bits alignment */
   uint8_t  CmdOpCode;
-  uint8_t  CmdLength;
+  uint16_t CmdLength;
   uint8_t  ctrlInst;
+  void     *Ctx[NUM_CDC_INSTANCES];          /* application context, from the Init callback */
   uint8_t  *RxBuffer[NUM_CDC_INSTANCES];
+  uint8_t  *RxXfer[NUM_CDC_INSTANCES];       /* buffer of the armed OUT transfer, NULL for zero-copy */
   const uint8_t  *TxBuffer[NUM_CDC_INSTANCES];   
   uint32_t RxLength[NUM_CDC_INSTANCES];
   uint32_t TxLength[NUM_CDC_INSTANCES];    
   
   __IO uint32_t TxState[NUM_CDC_INSTANCES];
   __IO uint32_t RxState[NUM_CDC_INSTANCES];    
+  uint8_t  TxZlp[NUM_CDC_INSTANCES];         /* end max packet multiples with a ZLP */
+  uint8_t  TxMore[NUM_CDC_INSTANCES];        /* the next transfer continues this one: no ZLP */
+
+  uint8_t  Notify[NUM_CDC_INSTANCES][CDC_NOTIFY_SERIAL_STATE_SIZE];
+  __IO uint32_t NotifyState[NUM_CDC_INSTANCES];  /* notification in flight */
+  __IO uint32_t SerialState[NUM_CDC_INSTANCES];  /* SERIAL_STATE to report, bit 16: changed */
+
+#if (USBD_CDC_URGENT == 1)
+  USBD_CDC_UrgentTypeDef Urgent[NUM_CDC_INSTANCES][USBD_CDC_URGENT_DEPTH];
+  __IO uint32_t UrgentHead[NUM_CDC_INSTANCES];   /* next ticket, claimed with LDREX/STREX */
+  __IO uint32_t UrgentTail[NUM_CDC_INSTANCES];   /* oldest ticket, advanced by the owner of the notification endpoint */
+  uint8_t  UrgentSent[NUM_CDC_INSTANCES];    /* the notification in flight is the oldest message */
+#endif /* USBD_CDC_URGENT */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+  uint8_t  TxRing[NUM_CDC_INSTANCES][USBD_CDC_TX_RING_SIZE];
+  __IO uint32_t TxHead[NUM_CDC_INSTANCES];   /* advanced by USBD_CDC_Write only */
+  __IO uint32_t TxTail[NUM_CDC_INSTANCES];   /* advanced by the IN completion only */
+  uint8_t  TxFromRing[NUM_CDC_INSTANCES];
+#if (USBD_CDC_TX_FLUSH_FRAMES > 0)
+  uint8_t  TxAge[NUM_CDC_INSTANCES];         /* frames a partial packet has been held */
+#endif /* USBD_CDC_TX_FLUSH_FRAMES */
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+  USBD_CDC_TxDescTypeDef TxQueue[NUM_CDC_INSTANCES][USBD_CDC_TX_QUEUE_SIZE];
+  __IO uint32_t TxQHead[NUM_CDC_INSTANCES];  /* next ticket, claimed with LDREX/STREX */
+  __IO uint32_t TxQTail[NUM_CDC_INSTANCES];  /* oldest ticket, advanced by the owner of the IN endpoint */
+  uint8_t  TxFromQueue[NUM_CDC_INSTANCES];
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_LINE_CACHE == 1)
+  USBD_CDC_LineCodingTypeDef LineCoding[NUM_CDC_INSTANCES];
+  uint16_t LineState[NUM_CDC_INSTANCES];     /* CDC_LINE_STATE_xxx */
+#endif /* USBD_CDC_LINE_CACHE */
+
+#if (USBD_CDC_TX_SCHED == 1)
+  uint8_t  TxPrio[NUM_CDC_INSTANCES];        /* 0 is the highest */
+  uint8_t  TxHold[NUM_CDC_INSTANCES];        /* frames waiting without a completion */
+  uint16_t TxBudget[NUM_CDC_INSTANCES];      /* bytes per frame, 0 for no limit */
+  uint32_t TxSpent[NUM_CDC_INSTANCES];       /* bytes started in this frame */
+  __IO uint32_t TxDeferred;                  /* instances to restart on the next SOF, bit mask */
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  __IO uint32_t WakeLatch;                   /* wakeup asked for in this suspend */
+  __IO uint32_t TxWake;                      /* instances to flush on the first SOF, bit mask */
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+  uint8_t  RxRing[NUM_CDC_INSTANCES][USBD_CDC_RX_RING_SIZE + USBD_CDC_RX_RING_SLACK];
+  __IO uint32_t RxHead[NUM_CDC_INSTANCES];   /* advanced by the OUT completion only */
+  __IO uint32_t RxTail[NUM_CDC_INSTANCES];   /* advanced by USBD_CDC_RxRelease only */
+  __IO uint8_t  RxStalled[NUM_CDC_INSTANCES]; /* endpoint left unarmed, ring full */
+  uint32_t RxHighWater[NUM_CDC_INSTANCES];   /* most bytes ever held in the ring */
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_OS == 1)
+  __IO uint32_t RxAvail[NUM_CDC_INSTANCES];  /* bytes of the last packet not read yet */
+  uint32_t RxOffset[NUM_CDC_INSTANCES];      /* read position in the last packet */
+#endif /* USBD_CDC_OS */
+
+#if (USBD_CDC_LAT_HIST == 1)
+  USBD_CDC_LatHistTypeDef LatHist[NUM_CDC_INSTANCES];
+  uint32_t TxStamp[NUM_CDC_INSTANCES];       /* start of the transfer in flight */
+  uint32_t RxStamp[NUM_CDC_INSTANCES];       /* completion of the packet held */
+  uint8_t  TxStamped[NUM_CDC_INSTANCES];
+  uint8_t  RxStamped[NUM_CDC_INSTANCES];
+#if (USBD_CDC_TX_RING_SIZE > 0)
+  USBD_CDC_LatMarkTypeDef TxMark[NUM_CDC_INSTANCES][USBD_CDC_LAT_MARKS];
+  __IO uint32_t TxMarkHead[NUM_CDC_INSTANCES];  /* advanced by the writer only */
+  __IO uint32_t TxMarkTail[NUM_CDC_INSTANCES];  /* advanced by the IN completion only */
+#endif /* USBD_CDC_TX_RING_SIZE */
+#if (USBD_CDC_RX_RING_SIZE > 0)
+  USBD_CDC_LatMarkTypeDef RxMark[NUM_CDC_INSTANCES][USBD_CDC_LAT_MARKS];
+  __IO uint32_t RxMarkHead[NUM_CDC_INSTANCES];  /* advanced by the OUT completion only */
+  __IO uint32_t RxMarkTail[NUM_CDC_INSTANCES];  /* advanced by USBD_CDC_RxRelease only */
+#endif /* USBD_CDC_RX_RING_SIZE */
+#endif /* USBD_CDC_LAT_HIST */
 }
 USBD_CDC_HandleTypeDef; 
 
@@ -164,11 +640,180 @@ uint8_t  USBD_CDC_SetRxBuffer        (USBD_HandleTypeDef   *pdev,
                                       int instance,
                                       uint8_t  *pbuff);
   
+uint8_t  USBD_CDC_SetTxZlp           (USBD_HandleTypeDef   *pdev,
+                                      int instance,
+                                      uint8_t enable);
+
+#if (USBD_CDC_LINE_CACHE == 1)
+uint8_t  USBD_CDC_GetLineCoding      (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      USBD_CDC_LineCodingTypeDef *coding);
+
+uint8_t  USBD_CDC_SetLineCoding      (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const USBD_CDC_LineCodingTypeDef *coding);
+
+uint16_t USBD_CDC_GetLineState       (USBD_HandleTypeDef *pdev,
+                                      int instance);
+#endif /* USBD_CDC_LINE_CACHE */
+
 uint8_t  USBD_CDC_ReceivePacket      (USBD_HandleTypeDef *pdev,
                                       int instance);
 
+uint8_t  USBD_CDC_ReceiveBuffer      (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint8_t  *pbuff,
+                                      uint16_t length);
+
+uint16_t USBD_CDC_ReadRxData         (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint16_t offset,
+                                      uint8_t  *pbuff,
+                                      uint16_t length);
+
+#if (USBD_CDC_ZERO_COPY_RX == 1)
+uint16_t USBD_CDC_ReadRxSamples      (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint16_t offset,
+                                      int16_t  *pbuff,
+                                      uint16_t count,
+                                      int32_t  gain);
+
+uint16_t USBD_CDC_ReadRxSamplesF32   (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint16_t offset,
+                                      float    *pbuff,
+                                      uint16_t count,
+                                      float    scale);
+#endif /* USBD_CDC_ZERO_COPY_RX */
+
 uint8_t  USBD_CDC_TransmitPacket     (USBD_HandleTypeDef *pdev,
                                       int instance);
+
+uint8_t  USBD_CDC_TransmitBuffer     (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t *pbuff,
+                                      uint16_t length);
+
+#if (USBD_CDC_TX_VEC == 1)
+uint8_t  USBD_CDC_TransmitVec        (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const USBD_IovTypeDef *iov,
+                                      uint32_t iovcnt);
+#endif /* USBD_CDC_TX_VEC */
+
+uint8_t  USBD_CDC_TxAbort            (USBD_HandleTypeDef *pdev,
+                                      int instance);
+
+#if (USBD_CDC_ZERO_COPY_TX == 1)
+uint16_t USBD_CDC_TxReservePMA       (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      USBD_PMAWriterTypeDef *w);
+
+uint8_t  USBD_CDC_TxCommitPMA        (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      USBD_PMAWriterTypeDef *w);
+#endif /* USBD_CDC_ZERO_COPY_TX */
+
+uint8_t  USBD_CDC_SetSerialState     (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint16_t state);
+
+#if (USBD_CDC_URGENT == 1)
+uint8_t  USBD_CDC_SendUrgent         (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t *msg,
+                                      uint16_t length);
+#endif /* USBD_CDC_URGENT */
+
+#if (USBD_CDC_TX_SCHED == 1)
+uint8_t  USBD_CDC_SetTxSched         (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint8_t priority,
+                                      uint16_t budget);
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+uint32_t USBD_CDC_Write              (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t *pbuff,
+                                      uint32_t length);
+
+#if (USB_TIMESYNC_ENABLED == 1)
+uint32_t USBD_CDC_WriteStamped       (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint32_t cycles,
+                                      const uint8_t *pbuff,
+                                      uint32_t length);
+#endif /* USB_TIMESYNC_ENABLED */
+
+uint32_t USBD_CDC_TxReserve          (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint8_t **pbuff);
+
+uint8_t  USBD_CDC_TxCommit           (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint32_t length);
+
+uint32_t USBD_CDC_GetTxFree          (USBD_HandleTypeDef *pdev,
+                                      int instance);
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+uint8_t  USBD_CDC_TxEnqueue          (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t *pbuff,
+                                      uint16_t length,
+                                      USBD_CDC_TxDoneTypeDef done,
+                                      void *token);
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+uint32_t USBD_CDC_RxPeek             (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t **pbuff);
+
+uint8_t  USBD_CDC_RxRelease          (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint32_t length);
+
+uint32_t USBD_CDC_Read               (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint8_t *pbuff,
+                                      uint32_t length);
+
+uint32_t USBD_CDC_GetRxCount         (USBD_HandleTypeDef *pdev,
+                                      int instance);
+
+uint32_t USBD_CDC_GetRxHighWater     (USBD_HandleTypeDef *pdev,
+                                      int instance);
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_LAT_HIST == 1)
+const USBD_CDC_LatHistTypeDef *USBD_CDC_GetLatency(USBD_HandleTypeDef *pdev,
+                                                   int instance);
+
+uint8_t  USBD_CDC_ResetLatency       (USBD_HandleTypeDef *pdev,
+                                      int instance);
+#endif /* USBD_CDC_LAT_HIST */
+
+#if (USBD_CDC_OS == 1)
+uint8_t  USBD_CDC_RegisterOs         (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const USBD_CDC_OsTypeDef *os);
+
+uint32_t USBD_CDC_BlockingRead       (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      uint8_t *pbuff,
+                                      uint32_t length,
+                                      uint32_t timeout);
+
+uint8_t  USBD_CDC_BlockingWrite      (USBD_HandleTypeDef *pdev,
+                                      int instance,
+                                      const uint8_t *pbuff,
+                                      uint32_t length,
+                                      uint32_t timeout);
+#endif /* USBD_CDC_OS */
 /**
   * @}
   */ 
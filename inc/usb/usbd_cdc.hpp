@@ -0,0 +1,423 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc.hpp
+  * @brief   C++ layer over usbd_cdc.h with explicit buffer ownership.
+  *          Header only, C++20, no dynamic allocation and no virtual calls.
+  *
+  *          A TxPool holds Count buffers of Size bytes. acquire() hands one
+  *          out as a move-only TxBuffer; Port<I>::send() moves it into the
+  *          transmit queue of instance I (USBD_CDC_TX_QUEUE_SIZE) and the
+  *          buffer goes back to its pool from the IN completion, or when it
+  *          is dropped on a deconfiguration. A TxBuffer that is never sent
+  *          goes back when it is destroyed. The stack holds no pointer to a
+  *          buffer the application still owns, so nothing needs copying.
+  *
+  *          Port<I>::receive() leases the received data of instance I
+  *          straight from its receive ring (USBD_CDC_RX_RING_SIZE) as a
+  *          move-only RxLease; the ring space is handed back to the OUT
+  *          endpoint as the lease consumes it, all of it when the lease is
+  *          destroyed. One lease per instance at a time: the ring has a
+  *          single consumer.
+  *
+  *            static usbd::cdc::TxPool<64, 8> pool;
+  *            usbd::cdc::Port<0> port(hUsbDeviceFS);
+  *
+  *            auto buf = pool.acquire();
+  *            if (buf) {
+  *              buf.set_size(encode(buf.data()));
+  *              port.send(std::move(buf));
+  *            }
+  *
+  *            if (auto rx = port.receive()) {
+  *              rx.consume(parse(rx.data()));
+  *            }
+  *
+  *          Pools and ports must outlive the transfers they started; a
+  *          pool is released to from the USB interrupt, with a lock free
+  *          bit mask.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_HPP
+#define __USBD_CDC_HPP
+
+#if (__cplusplus < 202002L)
+#error "usbd_cdc.hpp needs C++20 (std::span)"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "usbd_cdc.h"
+
+namespace usbd::cdc {
+
+class TxPoolBase;
+
+/* Buffer of a pool, what a queued transfer carries as its token */
+struct TxSlot
+{
+  TxPoolBase *pool;
+  uint8_t    *data;
+  uint16_t    capacity;
+  uint8_t     index;
+};
+
+/**
+  * @brief  Buffers of some size, without the storage. The storage is laid
+  *         out by TxPool, which is the one to declare.
+  */
+class TxPoolBase
+{
+public:
+  TxPoolBase(const TxPoolBase &) = delete;
+  TxPoolBase &operator=(const TxPoolBase &) = delete;
+
+  /* buffers not handed out */
+  uint32_t available() const
+  {
+    return static_cast<uint32_t>(__builtin_popcount(free_.load(std::memory_order_relaxed)));
+  }
+
+  /* transfer completion callback of the queue, see USBD_CDC_TxDoneTypeDef */
+  static void done(void *token, uint8_t status)
+  {
+    TxSlot *slot = static_cast<TxSlot *>(token);
+
+    (void)status;
+    slot->pool->release(slot->index);
+  }
+
+protected:
+  explicit TxPoolBase(uint32_t count)
+    : free_(count == 32U ? 0xFFFFFFFFU : ((1U << count) - 1U))
+  {
+  }
+
+  TxSlot *take(TxSlot *slots)
+  {
+    uint32_t mask = free_.load(std::memory_order_relaxed);
+
+    while (mask != 0U)
+    {
+      uint32_t index = static_cast<uint32_t>(__builtin_ctz(mask));
+
+      if (free_.compare_exchange_weak(mask, mask & ~(1U << index),
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+      {
+        return &slots[index];
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  friend class TxBuffer;
+
+  void release(uint8_t index)
+  {
+    free_.fetch_or(1U << index, std::memory_order_release);
+  }
+
+  std::atomic<uint32_t> free_;           /* bit n: buffer n is free */
+};
+
+/**
+  * @brief  Move-only ownership of a pool buffer. Empty once moved from or
+  *         sent; an owned buffer goes back to its pool when destroyed.
+  */
+class TxBuffer
+{
+public:
+  TxBuffer() = default;
+
+  TxBuffer(TxBuffer &&other) noexcept
+    : slot_(std::exchange(other.slot_, nullptr)), size_(other.size_)
+  {
+  }
+
+  TxBuffer &operator=(TxBuffer &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      slot_ = std::exchange(other.slot_, nullptr);
+      size_ = other.size_;
+    }
+    return *this;
+  }
+
+  TxBuffer(const TxBuffer &) = delete;
+  TxBuffer &operator=(const TxBuffer &) = delete;
+
+  ~TxBuffer()
+  {
+    reset();
+  }
+
+  explicit operator bool() const
+  {
+    return slot_ != nullptr;
+  }
+
+  /* whole buffer, to be filled in */
+  std::span<uint8_t> data() const
+  {
+    return slot_ ? std::span<uint8_t>(slot_->data, slot_->capacity) : std::span<uint8_t>();
+  }
+
+  std::size_t capacity() const
+  {
+    return slot_ ? slot_->capacity : 0U;
+  }
+
+  /* bytes to send, capped to the capacity */
+  void set_size(std::size_t size)
+  {
+    size_ = static_cast<uint16_t>(size < capacity() ? size : capacity());
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+  /* bytes to send */
+  std::span<const uint8_t> bytes() const
+  {
+    return data().first(size_);
+  }
+
+  /* hand the buffer back to its pool now */
+  void reset()
+  {
+    if (slot_ != nullptr)
+    {
+      slot_->pool->release(slot_->index);
+      slot_ = nullptr;
+    }
+    size_ = 0U;
+  }
+
+private:
+  template <std::size_t, std::size_t> friend class TxPool;
+  template <int> friend class Port;
+
+  explicit TxBuffer(TxSlot *slot) : slot_(slot)
+  {
+  }
+
+  /* give up ownership to a queued transfer */
+  TxSlot *release()
+  {
+    size_ = 0U;
+    return std::exchange(slot_, nullptr);
+  }
+
+  TxSlot  *slot_ = nullptr;
+  uint16_t size_ = 0U;
+};
+
+/**
+  * @brief  Count buffers of Size bytes, word aligned for the OTG DMA. Must
+  *         not move once buffers are handed out: declare it static.
+  */
+template <std::size_t Size, std::size_t Count>
+class TxPool : public TxPoolBase
+{
+  static_assert((Count >= 1U) && (Count <= 32U), "a pool holds 1 to 32 buffers");
+  static_assert((Size >= 1U) && (Size <= 0xFFFFU), "a queued transfer is at most 65535 bytes");
+
+public:
+  TxPool() : TxPoolBase(Count)
+  {
+    for (std::size_t i = 0; i < Count; i++)
+    {
+      slots_[i] = TxSlot{this, storage_[i], static_cast<uint16_t>(Size), static_cast<uint8_t>(i)};
+    }
+  }
+
+  /* a free buffer, or an empty handle when all are in use */
+  TxBuffer acquire()
+  {
+    return TxBuffer(take(slots_));
+  }
+
+private:
+  TxSlot slots_[Count];
+  alignas(4) uint8_t storage_[Count][Size];
+};
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+/**
+  * @brief  Lease of the received bytes at the front of a receive ring.
+  *         Move-only; empty when nothing had been received. Released bytes
+  *         go back to the OUT endpoint, the rest when the lease ends.
+  */
+class RxLease
+{
+public:
+  RxLease() = default;
+
+  RxLease(RxLease &&other) noexcept
+    : pdev_(std::exchange(other.pdev_, nullptr)), instance_(other.instance_),
+      data_(std::exchange(other.data_, std::span<const uint8_t>()))
+  {
+  }
+
+  RxLease &operator=(RxLease &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      pdev_ = std::exchange(other.pdev_, nullptr);
+      instance_ = other.instance_;
+      data_ = std::exchange(other.data_, std::span<const uint8_t>());
+    }
+    return *this;
+  }
+
+  RxLease(const RxLease &) = delete;
+  RxLease &operator=(const RxLease &) = delete;
+
+  ~RxLease()
+  {
+    reset();
+  }
+
+  explicit operator bool() const
+  {
+    return !data_.empty();
+  }
+
+  /* leased bytes not consumed yet, valid until consumed */
+  std::span<const uint8_t> data() const
+  {
+    return data_;
+  }
+
+  /* hand the first n bytes back to the ring */
+  void consume(std::size_t n)
+  {
+    if (n > data_.size())
+    {
+      n = data_.size();
+    }
+    if ((pdev_ != nullptr) && (n != 0U))
+    {
+      USBD_CDC_RxRelease(pdev_, instance_, static_cast<uint32_t>(n));
+      data_ = data_.subspan(n);
+    }
+  }
+
+  /* end the lease, handing everything back */
+  void reset()
+  {
+    consume(data_.size());
+    pdev_ = nullptr;
+  }
+
+private:
+  template <int> friend class Port;
+
+  RxLease(USBD_HandleTypeDef *pdev, int instance, std::span<const uint8_t> data)
+    : pdev_(pdev), instance_(instance), data_(data)
+  {
+  }
+
+  USBD_HandleTypeDef      *pdev_ = nullptr;
+  int                      instance_ = 0;
+  std::span<const uint8_t> data_;
+};
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+/**
+  * @brief  CDC instance I of a device
+  */
+template <int I>
+class Port
+{
+  static_assert((I >= 0) && (I < NUM_CDC_INSTANCES), "no such CDC instance");
+
+public:
+  static constexpr int instance = I;
+
+  explicit Port(USBD_HandleTypeDef &dev) : dev_(dev)
+  {
+  }
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+  /**
+    * @brief  Queue a pool buffer for sending. It is moved from on success
+    *         and goes back to its pool once sent; on failure it is left to
+    *         the caller, e.g. to try again.
+    * @retval USBD_OK, USBD_BUSY if the queue is full, USBD_FAIL if the buffer
+    *         is empty or the device is not configured
+    */
+  uint8_t send(TxBuffer &&buf)
+  {
+    uint8_t ret;
+
+    if (!buf)
+    {
+      return USBD_FAIL;
+    }
+    ret = USBD_CDC_TxEnqueue(&dev_, I, buf.slot_->data, buf.size_,
+                             &TxPoolBase::done, buf.slot_);
+    if (ret == USBD_OK)
+    {
+      buf.release();
+    }
+    return ret;
+  }
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+  /* Copy into the transmit ring, see USBD_CDC_Write. Returns the bytes taken. */
+  std::size_t write(std::span<const uint8_t> data)
+  {
+    return USBD_CDC_Write(&dev_, I, data.data(), static_cast<uint32_t>(data.size()));
+  }
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_URGENT == 1)
+  /* See USBD_CDC_SendUrgent, the message is copied */
+  uint8_t send_urgent(std::span<const uint8_t> msg)
+  {
+    return USBD_CDC_SendUrgent(&dev_, I, msg.data(), static_cast<uint16_t>(msg.size()));
+  }
+#endif /* USBD_CDC_URGENT */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+  /* Lease the contiguous received bytes at the front of the receive ring,
+     see USBD_CDC_RxPeek. Bytes that wrapped come with the next lease. */
+  RxLease receive()
+  {
+    const uint8_t *p = nullptr;
+    uint32_t n = USBD_CDC_RxPeek(&dev_, I, &p);
+
+    if (n == 0U)
+    {
+      return RxLease();
+    }
+    return RxLease(&dev_, I, std::span<const uint8_t>(p, n));
+  }
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+  USBD_HandleTypeDef &device() const
+  {
+    return dev_;
+  }
+
+private:
+  USBD_HandleTypeDef &dev_;
+};
+
+} /* namespace usbd::cdc */
+
+#endif  /* __USBD_CDC_HPP */
@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_adc.h
+  * @brief   Multi-channel ADC streaming on top of the CDC class.
+  *          With USBD_CDC_ADC_ENABLED set to 1 this module runs an ADC of
+  *          the F3 from a timer trigger, through a circular DMA, straight
+  *          onto the IN endpoint of a CDC instance:
+  *
+  *          - the timer update event (TRGO) starts one scan of the regular
+  *            sequence, one conversion per channel of the configuration,
+  *            so the timer rate is the frame rate;
+  *          - the DMA writes the 12-bit results, one halfword each, into a
+  *            circular buffer of whole frames, interleaved in sequence
+  *            order. Its half and full transfer interrupts are the only
+  *            interrupts of the engine;
+  *          - each half, once written, is queued in place on the transmit
+  *            queue of the CDC instance with USBD_CDC_TxEnqueue, and is
+  *            written again by the DMA only after it has gone out.
+  *
+  *          The host reads the raw little endian stream, frames back to
+  *          back from the first one after USBD_CDC_Adc_Start. A full speed
+  *          bulk endpoint carries some 500 k samples per second across all
+  *          channels; the buffer must cover the time the host leaves the
+  *          endpoint unserviced. A half that is complete while its previous
+  *          turn is still queued is not sent and counts as an overrun: the
+  *          stream then has a gap of that many frames.
+  *
+  *          The application enables the clocks of the ADC, the DMA and the
+  *          timer, the analog pins and the DMA channel interrupt, routes
+  *          that interrupt to USBD_CDC_Adc_DmaIRQHandler, and calls
+  *          USBD_CDC_Adc_Init once from thread context. USBD_CDC_Adc_Start
+  *          and USBD_CDC_Adc_Stop may then be called from anywhere, for
+  *          example from the CDC Control callback on a change of DTR.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_ADC_H
+#define __USBD_CDC_ADC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "stm32f3xx_hal.h"
+#include  "usbd_cdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_adc
+  * @brief ADC streaming to a CDC instance
+  * @{
+  */
+
+/** @defgroup usbd_cdc_adc_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_ADC_ENABLED
+#define USBD_CDC_ADC_ENABLED                        0
+#endif
+
+/* Samples of the circular DMA buffer, both halves; each half is cut down
+   to whole frames */
+#ifndef USBD_CDC_ADC_BUF_SAMPLES
+#define USBD_CDC_ADC_BUF_SAMPLES                    2048
+#endif
+
+#define USBD_CDC_ADC_MAX_CHANNELS                   16
+
+#if (USBD_CDC_ADC_ENABLED == 1) && (USBD_CDC_TX_QUEUE_SIZE < 2)
+#error "USBD_CDC_ADC_ENABLED needs a transmit queue of two descriptors or more"
+#endif
+
+#if (USBD_CDC_ADC_ENABLED == 1) && \
+    (((USBD_CDC_ADC_BUF_SAMPLES & 1) != 0) || (USBD_CDC_ADC_BUF_SAMPLES > 65534))
+#error "USBD_CDC_ADC_BUF_SAMPLES must be even and fit the DMA counter"
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_adc_Exported_TypesDefinitions
+  * @{
+  */
+
+/* Hardware of one engine */
+typedef struct
+{
+  ADC_TypeDef         *Instance;
+  DMA_TypeDef         *Dma;         /* controller of the channel */
+  DMA_Channel_TypeDef *DmaCh;       /* channel serving the ADC request */
+  uint8_t              DmaChNum;    /* channel number, 1 to 7 */
+  TIM_TypeDef         *Tim;         /* trigger, TRGO on update */
+  uint32_t             TimClockHz;  /* timer kernel clock */
+  uint8_t              ExtSel;      /* EXTSEL code of that TRGO for this ADC */
+  uint8_t              SampleTime;  /* SMP code, 0 (1.5 cycles) to 7 (601.5) */
+  uint8_t              NumChannels; /* 1 to USBD_CDC_ADC_MAX_CHANNELS */
+  uint8_t              Channels[USBD_CDC_ADC_MAX_CHANNELS]; /* scan order */
+} USBD_CDC_AdcConfigTypeDef;
+
+typedef struct
+{
+  uint32_t blocks;              /* halves queued */
+  uint32_t bytes;               /* bytes sent */
+  uint32_t overruns;            /* halves complete while still queued */
+  uint32_t dropped;             /* halves the transmit queue refused */
+  uint32_t dma_errors;
+} USBD_CDC_AdcStatsTypeDef;
+
+typedef struct
+{
+  const USBD_CDC_AdcConfigTypeDef *cfg;
+  USBD_HandleTypeDef *pdev;
+  int      instance;
+  USBD_CDC_AdcStatsTypeDef stats;
+  uint32_t rate_hz;             /* frame rate the timer runs at */
+  uint16_t half_len;            /* samples per half, whole frames */
+  __IO uint8_t busy[2];         /* half queued on the CDC instance */
+  __IO uint8_t running;
+
+  uint16_t buf[USBD_CDC_ADC_BUF_SAMPLES];
+} USBD_CDC_AdcTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_CDC_ADC_ENABLED == 1)
+
+/** @defgroup usbd_cdc_adc_Exported_Functions
+  * @{
+  */
+uint8_t USBD_CDC_Adc_Init(USBD_CDC_AdcTypeDef *adc, USBD_HandleTypeDef *pdev,
+                          int instance, const USBD_CDC_AdcConfigTypeDef *cfg);
+uint8_t USBD_CDC_Adc_Start(USBD_CDC_AdcTypeDef *adc, uint32_t rate_hz);
+void    USBD_CDC_Adc_Stop(USBD_CDC_AdcTypeDef *adc);
+void    USBD_CDC_Adc_DmaIRQHandler(USBD_CDC_AdcTypeDef *adc);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_ADC_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_ADC_H */
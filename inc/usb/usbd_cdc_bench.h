@@ -0,0 +1,179 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_bench.h
+  * @brief   Throughput and latency test modes of the CDC class.
+  *          With USBD_CDC_BENCH_ENABLED set to 1 this module provides a CDC
+  *          interface, USBD_CDC_Bench_fops, to register in place of the
+  *          application one. Each instance runs its own test mode, chosen
+  *          by the host through the baud rate of SET_LINE_CODING:
+  *
+  *            USBD_CDC_BENCH_BAUD_LOOPBACK  every packet is sent back, the
+  *                                          next one is received while the
+  *                                          previous one goes out
+  *            USBD_CDC_BENCH_BAUD_SINK      received data is dropped
+  *            USBD_CDC_BENCH_BAUD_SOURCE    the IN endpoint is kept busy
+  *                                          with a byte counter pattern,
+  *                                          byte n of the stream is n & 0xFF
+  *            USBD_CDC_BENCH_BAUD_PINGPONG  loopback with a ZLP after full
+  *                                          packets, so that each echo
+  *                                          completes a host read at once
+  *            USBD_CDC_BENCH_BAUD_PMA       the packet memory copies are
+  *                                          timed and the table of
+  *                                          usb_pmabench.h is sent, with
+  *                                          USB_PMABENCH_ENABLED on the F3
+  *            USBD_CDC_BENCH_BAUD_ENUM      the enumeration timings of
+  *                                          usb_enumbench.h are sent, with
+  *                                          USB_ENUMBENCH_ENABLED
+  *            USBD_CDC_BENCH_BAUD_SOAK      both directions at once: the IN
+  *                                          endpoint is kept busy with
+  *                                          transfers of pseudo random
+  *                                          sizes (0, 63, 64, 65, multiples
+  *                                          of 64 and anything up to
+  *                                          USBD_CDC_BENCH_SOURCE_SIZE) and
+  *                                          received data is checked; both
+  *                                          streams carry the soak pattern
+  *            USBD_CDC_BENCH_BAUD_SOAK_REPORT  the soak counters are sent
+  *                                          as a text line, then cleared
+  *
+  *          Any other baud rate stops the test and drops received data.
+  *          Counters restart on every mode change, except that a line
+  *          coding change that keeps the soak baud rate (data bits, parity,
+  *          stop bits) leaves the soak running. The soak counters also
+  *          outlive bus resets and reconfigurations, until reported.
+  *          tools/cdc_bench.py is the host side.
+  *
+  *          Byte n of a soak stream, counted from the soak start, is
+  *          (n + (n >> 8) + (n >> 16)) & 0xFF: a lost or repeated packet
+  *          shows, whatever its size.
+  *
+  *          The module needs the packet receive path: it cannot be used
+  *          with USBD_CDC_RX_RING_SIZE, and no USBD_CDC_OS layer may be
+  *          registered on its instances.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_BENCH_H
+#define __USBD_CDC_BENCH_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_cdc.h"
+#include  "usb_pmabench.h"
+#include  "usb_enumbench.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_bench
+  * @brief CDC test modes for the benchmark tool
+  * @{
+  */
+
+/** @defgroup usbd_cdc_bench_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_BENCH_ENABLED
+#define USBD_CDC_BENCH_ENABLED                      0
+#endif
+
+/* Bytes per transfer in source mode */
+#ifndef USBD_CDC_BENCH_SOURCE_SIZE
+#define USBD_CDC_BENCH_SOURCE_SIZE                  1024
+#endif
+
+/* Baud rates selecting the test modes */
+#define USBD_CDC_BENCH_BAUD_LOOPBACK                10001U
+#define USBD_CDC_BENCH_BAUD_SINK                    10002U
+#define USBD_CDC_BENCH_BAUD_SOURCE                  10003U
+#define USBD_CDC_BENCH_BAUD_PINGPONG                10004U
+#define USBD_CDC_BENCH_BAUD_PMA                     10005U
+#define USBD_CDC_BENCH_BAUD_ENUM                    10006U
+#define USBD_CDC_BENCH_BAUD_SOAK                    10007U
+#define USBD_CDC_BENCH_BAUD_SOAK_REPORT             10008U
+
+#define USBD_CDC_BENCH_OFF                          0
+#define USBD_CDC_BENCH_LOOPBACK                     1
+#define USBD_CDC_BENCH_SINK                         2
+#define USBD_CDC_BENCH_SOURCE                       3
+#define USBD_CDC_BENCH_PINGPONG                     4
+#define USBD_CDC_BENCH_PMA                          5
+#define USBD_CDC_BENCH_ENUM                         6
+#define USBD_CDC_BENCH_SOAK                         7
+#define USBD_CDC_BENCH_SOAK_REPORT                  8
+
+/* Longest soak report line, terminating NUL included */
+#define USBD_CDC_BENCH_SOAK_LINE_SIZE               192U
+
+#if (USBD_CDC_BENCH_ENABLED == 1) && (USBD_CDC_RX_RING_SIZE > 0)
+#error "USBD_CDC_BENCH_ENABLED needs the packet receive path"
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t mode;                /* USBD_CDC_BENCH_xxx */
+  uint32_t rx_bytes;            /* bytes received since the mode was set */
+  uint32_t tx_bytes;            /* bytes sent since the mode was set */
+  uint32_t rx_held;             /* packets that waited for the IN endpoint */
+} USBD_CDC_BenchStatsTypeDef;
+
+typedef struct
+{
+  uint32_t rx_bytes;            /* soak bytes received */
+  uint32_t rx_errors;           /* packets not matching the soak pattern */
+  uint32_t tx_bytes;            /* soak bytes sent */
+  uint32_t tx_xfers;            /* soak IN transfers completed */
+  uint32_t tx_zlps;             /* of which zero length */
+  uint32_t tx_busy;             /* soak IN transfers refused by the class */
+  uint32_t lines;               /* line coding changes during the soak */
+  uint32_t inits;               /* interface inits: bus resets, reconfigurations */
+} USBD_CDC_BenchSoakTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_CDC_BENCH_ENABLED == 1)
+
+/** @defgroup usbd_cdc_bench_Exported_Variables
+  * @{
+  */
+extern USBD_CDC_ItfTypeDef USBD_CDC_Bench_fops;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Exported_Functions
+  * @{
+  */
+void USBD_CDC_Bench_Init(USBD_HandleTypeDef *pdev);
+const USBD_CDC_BenchStatsTypeDef *USBD_CDC_Bench_GetStats(int instance);
+const USBD_CDC_BenchSoakTypeDef *USBD_CDC_Bench_GetSoak(int instance);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_BENCH_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_BENCH_H */
@@ -0,0 +1,154 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_cobs.h
+  * @brief   COBS framing over the receive and transmit rings of a CDC
+  *          instance. With USBD_CDC_COBS_ENABLED set to 1, messages are
+  *          COBS encoded and delimited by a zero byte on the byte stream.
+  *
+  *          - Receive: USBD_CDC_Cobs_GetFrame, called from the main loop,
+  *            looks for the delimiter in the receive ring 32 bits at a
+  *            time, decodes the frame in place in the ring and hands back
+  *            a pointer into it. The frame stays on the ring until the
+  *            next call, which releases it. A frame that runs across the
+  *            end of the ring is put together in a buffer of
+  *            USBD_CDC_COBS_MAX_FRAME bytes instead, the only copy. Longer
+  *            frames, and frames that do not decode, are dropped and
+  *            counted. Empty frames, two delimiters in a row, and empty
+  *            messages are skipped.
+  *          - Transmit: USBD_CDC_Cobs_Send encodes a message straight into
+  *            the transmit ring, all of it or nothing, each run of non
+  *            zero bytes found a word at a time and copied as a block.
+  *
+  *          With USBD_CDC_COBS_CRC set to 1 as well, the encoded frame is
+  *          the message followed by its CRC-32, little endian, from the
+  *          CRC unit, see usb_crc.h. On transmit the unit reads the message
+  *          while it is encoded, by DMA from USB_CRC_DMA_MIN bytes on, and
+  *          the last run of the message is encoded together with the CRC
+  *          once that is known. On receive, the CRC of the decoded message
+  *          is checked before it is handed out; frames that fail are
+  *          dropped and counted. USB_CRC_Init must have been called.
+  *
+  *          The Receive callback of the instance only gets notifications
+  *          with the ring, it can stay empty. Needs USBD_CDC_RX_RING_SIZE
+  *          and USBD_CDC_TX_RING_SIZE; one context per instance may call
+  *          the functions of this module, which is the single consumer of
+  *          its receive ring and single producer of its transmit ring.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_COBS_H
+#define __USBD_CDC_COBS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_cdc.h"
+#include  "usb_crc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_cobs
+  * @brief COBS framing over the CDC rings
+  * @{
+  */
+
+/** @defgroup usbd_cdc_cobs_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_COBS_ENABLED
+#define USBD_CDC_COBS_ENABLED                       0
+#endif
+
+/* Longest frame taken, in encoded bytes without the delimiter */
+#ifndef USBD_CDC_COBS_MAX_FRAME
+#define USBD_CDC_COBS_MAX_FRAME                     (USBD_CDC_RX_RING_SIZE / 2U)
+#endif
+
+/* Set to 1 to carry a CRC-32 at the end of every frame */
+#ifndef USBD_CDC_COBS_CRC
+#define USBD_CDC_COBS_CRC                           0
+#endif
+
+#if (USBD_CDC_COBS_CRC == 1)
+#define USBD_CDC_COBS_CRC_SIZE                      4U
+#else
+#define USBD_CDC_COBS_CRC_SIZE                      0U
+#endif
+
+/* Encoded size of a message of n bytes, with the CRC and the delimiter */
+#define USBD_CDC_COBS_ENC_SIZE(n)                   ((n) + USBD_CDC_COBS_CRC_SIZE + \
+                                                     ((n) + USBD_CDC_COBS_CRC_SIZE) / 254U + 2U)
+
+#if (USBD_CDC_COBS_ENABLED == 1)
+#if (USBD_CDC_RX_RING_SIZE == 0) || (USBD_CDC_TX_RING_SIZE == 0)
+#error "USBD_CDC_COBS_ENABLED needs USBD_CDC_RX_RING_SIZE and USBD_CDC_TX_RING_SIZE"
+#endif
+#if (USBD_CDC_COBS_MAX_FRAME + 1U > USBD_CDC_RX_RING_SIZE - USBD_CDC_RX_RING_SLACK)
+#error "USBD_CDC_COBS_MAX_FRAME must leave a packet of the receive ring free"
+#endif
+#if (USBD_CDC_COBS_CRC == 1) && (USB_CRC_ENABLED != 1)
+#error "USBD_CDC_COBS_CRC needs USB_CRC_ENABLED"
+#endif
+#endif /* USBD_CDC_COBS_ENABLED */
+/**
+  * @}
+  */
+
+#if (USBD_CDC_COBS_ENABLED == 1)
+
+/** @defgroup usbd_cdc_cobs_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  USBD_HandleTypeDef *pdev;
+  int          instance;
+  uint32_t     scanned;         /* bytes at the ring tail known to hold no delimiter */
+  uint32_t     held;            /* bytes of the frame handed out, released by the next call */
+  uint32_t     asm_len;         /* bytes put together in asm_buf */
+  uint8_t      discard;         /* dropping up to the next delimiter */
+  uint32_t     frames;          /* frames handed out */
+  uint32_t     dropped;         /* frames too long or badly encoded */
+  uint32_t     crc_errors;      /* frames dropped on their CRC */
+  uint8_t      asm_buf[USBD_CDC_COBS_MAX_FRAME];
+} USBD_CDC_CobsTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_cobs_Exported_Functions
+  * @{
+  */
+void     USBD_CDC_Cobs_Init(USBD_CDC_CobsTypeDef *c, USBD_HandleTypeDef *pdev,
+                            int instance);
+uint32_t USBD_CDC_Cobs_GetFrame(USBD_CDC_CobsTypeDef *c, const uint8_t **frame);
+uint8_t  USBD_CDC_Cobs_Send(USBD_CDC_CobsTypeDef *c, const uint8_t *msg,
+                            uint32_t length);
+
+/* Plain COBS of one buffer, without the CRC of USBD_CDC_COBS_CRC */
+uint32_t USBD_CDC_Cobs_Encode(uint8_t *dst, const uint8_t *src, uint32_t length);
+int32_t  USBD_CDC_Cobs_Decode(uint8_t *buf, uint32_t length);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_COBS_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_COBS_H */
@@ -0,0 +1,165 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_dsp.h
+  * @brief   Spectrum stage over a CDC instance.
+  *          With USBD_CDC_DSP_ENABLED set to 1 this module provides a CDC
+  *          interface, USBD_CDC_Dsp_fops, to register in place of the
+  *          application one. The host streams little endian q15 samples to
+  *          instance USBD_CDC_DSP_INSTANCE; every USBD_CDC_DSP_BLOCK_SAMPLES
+  *          of them are, in one pass each:
+  *
+  *            converted to float          arm_q15_to_float
+  *            filtered and decimated      arm_fir_decimate_f32, by
+  *                                        USBD_CDC_DSP_DECIMATION
+  *            transformed                 arm_rfft_fast_f32 over
+  *                                        USBD_CDC_DSP_FFT_LEN points
+  *            reduced to magnitudes       arm_cmplx_mag_f32
+  *
+  *          and the USBD_CDC_DSP_BINS float32 magnitudes go back on the IN
+  *          endpoint as one transfer. Bin 0 is the DC magnitude, the
+  *          Nyquist bin is not sent. The decimator state carries over from
+  *          block to block, so the stream is filtered without seams.
+  *
+  *          Samples are received with USBD_CDC_ReceiveBuffer straight into
+  *          one of two block buffers, there is no per sample or per packet
+  *          copy. The DSP runs from USBD_CDC_Dsp_Process, called from the
+  *          main loop. While both block buffers wait for it, or both result
+  *          buffers wait for the IN endpoint, the OUT endpoint is left NAKing,
+  *          so no samples are ever dropped.
+  *
+  *          Other instances the interface is registered on drop what they
+  *          receive. The build must define ARM_MATH_CM4 and link the CMSIS
+  *          DSP library. With USB_FFT_ENABLED and the flag of
+  *          USBD_CDC_DSP_FFT_LEN set, see usb_fft.h, the FFT is set up
+  *          without linking the tables of the other lengths. The module
+  *          needs the packet receive path: it cannot be used with
+  *          USBD_CDC_RX_RING_SIZE or USBD_CDC_ZERO_COPY_RX, and no
+  *          USBD_CDC_OS layer may be registered on its instances.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_DSP_H
+#define __USBD_CDC_DSP_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_cdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_dsp
+  * @brief CDC fed spectrum stage
+  * @{
+  */
+
+/** @defgroup usbd_cdc_dsp_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_DSP_ENABLED
+#define USBD_CDC_DSP_ENABLED                        0
+#endif
+
+/* CDC instance carrying the sample stream */
+#ifndef USBD_CDC_DSP_INSTANCE
+#define USBD_CDC_DSP_INSTANCE                       0
+#endif
+
+/* q15 samples per block, the bytes must be a whole number of packets */
+#ifndef USBD_CDC_DSP_BLOCK_SAMPLES
+#define USBD_CDC_DSP_BLOCK_SAMPLES                  1024
+#endif
+
+/* Decimation factor of the FIR stage, must divide the block */
+#ifndef USBD_CDC_DSP_DECIMATION
+#define USBD_CDC_DSP_DECIMATION                     4
+#endif
+
+/* Largest number of FIR taps USBD_CDC_Dsp_Init accepts */
+#ifndef USBD_CDC_DSP_MAX_TAPS
+#define USBD_CDC_DSP_MAX_TAPS                       64
+#endif
+
+#define USBD_CDC_DSP_BLOCK_BYTES                    (USBD_CDC_DSP_BLOCK_SAMPLES * 2)
+#define USBD_CDC_DSP_FFT_LEN                        (USBD_CDC_DSP_BLOCK_SAMPLES / USBD_CDC_DSP_DECIMATION)
+#define USBD_CDC_DSP_BINS                           (USBD_CDC_DSP_FFT_LEN / 2)
+
+#if (USBD_CDC_DSP_ENABLED == 1)
+#if (USBD_CDC_RX_RING_SIZE > 0) || (USBD_CDC_ZERO_COPY_RX == 1)
+#error "USBD_CDC_DSP_ENABLED needs the packet receive path"
+#endif
+#if ((USBD_CDC_DSP_BLOCK_BYTES % CDC_DATA_HS_MAX_PACKET_SIZE) != 0) || \
+    ((USBD_CDC_DSP_BLOCK_BYTES + CDC_DATA_HS_MAX_PACKET_SIZE) > 0xFFFF)
+#error "USBD_CDC_DSP_BLOCK_SAMPLES must fill whole packets and one transfer"
+#endif
+#if ((USBD_CDC_DSP_BLOCK_SAMPLES % USBD_CDC_DSP_DECIMATION) != 0)
+#error "USBD_CDC_DSP_DECIMATION must divide USBD_CDC_DSP_BLOCK_SAMPLES"
+#endif
+#if (USBD_CDC_DSP_FFT_LEN != 32) && (USBD_CDC_DSP_FFT_LEN != 64) && \
+    (USBD_CDC_DSP_FFT_LEN != 128) && (USBD_CDC_DSP_FFT_LEN != 256) && \
+    (USBD_CDC_DSP_FFT_LEN != 512) && (USBD_CDC_DSP_FFT_LEN != 1024) && \
+    (USBD_CDC_DSP_FFT_LEN != 2048) && (USBD_CDC_DSP_FFT_LEN != 4096)
+#error "USBD_CDC_DSP_FFT_LEN must be a power of two from 32 to 4096"
+#endif
+#endif /* USBD_CDC_DSP_ENABLED */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t blocks;              /* blocks transformed */
+  uint32_t rx_held;             /* times the OUT endpoint waited for a block buffer */
+  uint32_t tx_held;             /* times a block waited for a result buffer */
+} USBD_CDC_DspStatsTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_CDC_DSP_ENABLED == 1)
+
+#include "arm_math.h"
+
+/** @defgroup usbd_cdc_dsp_Exported_Variables
+  * @{
+  */
+extern USBD_CDC_ItfTypeDef USBD_CDC_Dsp_fops;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_CDC_Dsp_Init(USBD_HandleTypeDef *pdev,
+                           const float32_t *coeffs,
+                           uint16_t num_taps);
+uint32_t USBD_CDC_Dsp_Process(void);
+const USBD_CDC_DspStatsTypeDef *USBD_CDC_Dsp_GetStats(void);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_DSP_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_DSP_H */
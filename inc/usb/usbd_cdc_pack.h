@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_pack.h
+  * @brief   Delta packing of telemetry on the transmit ring of a CDC
+  *          instance. With USBD_CDC_PACK_ENABLED set to 1, a packer bound
+  *          to an instance takes the raw little endian samples the
+  *          application would give USBD_CDC_Write, frames of numChannels
+  *          samples of 2 or 4 bytes, and sends each sample as
+  *
+  *            d = sample - previous sample of its channel, modulo 2^16 or
+  *                2^32 as the width
+  *            z = zig-zag of d: 0, -1, 1, -2 ... as 0, 1, 2, 3 ...
+  *            z as a varint: 7 bits a byte, least significant first, bit 7
+  *                set on all bytes but the last
+  *
+  *          A channel that moves by less than 64 counts a sample costs one
+  *          byte, against 2 or 4; the worst case is 3 bytes for a 16-bit
+  *          sample and 5 for a 32-bit one. The previous samples start at
+  *          zero, and again after USBD_CDC_Pack_Reset: the host decoder,
+  *          tools/cdc_pack.py, must read the stream from its first byte,
+  *          for example from the DTR change the application resets the
+  *          packer on.
+  *
+  *          USBD_CDC_Pack_Write takes any number of bytes, split anywhere;
+  *          an incomplete sample waits in the packer for the rest. It takes
+  *          only the samples the ring has room for at their worst case, so
+  *          a sample is never cut, and returns how many bytes it took, like
+  *          USBD_CDC_Write. Instances without a packer are sent raw. Needs
+  *          USBD_CDC_TX_RING_SIZE; single producer per instance.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_PACK_H
+#define __USBD_CDC_PACK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_cdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pack
+  * @brief Delta packing of CDC telemetry
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pack_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_PACK_ENABLED
+#define USBD_CDC_PACK_ENABLED                       0
+#endif
+
+#define USBD_CDC_PACK_MAX_CHANNELS                  16U
+
+#if (USBD_CDC_PACK_ENABLED == 1) && (USBD_CDC_TX_RING_SIZE == 0)
+#error "USBD_CDC_PACK_ENABLED needs USBD_CDC_TX_RING_SIZE"
+#endif
+/**
+  * @}
+  */
+
+#if (USBD_CDC_PACK_ENABLED == 1)
+
+/** @defgroup usbd_cdc_pack_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  USBD_HandleTypeDef *pdev;
+  int          instance;
+  uint8_t      width;           /* bytes per sample, 2 or 4 */
+  uint8_t      numChannels;     /* samples per frame */
+  uint8_t      channel;         /* channel of the next sample */
+  uint8_t      partial;         /* bytes of an incomplete sample in part */
+  uint8_t      part[4];
+  uint32_t     prev[USBD_CDC_PACK_MAX_CHANNELS];
+  uint32_t     bytes_in;        /* raw bytes taken */
+  uint32_t     bytes_out;       /* packed bytes queued */
+} USBD_CDC_PackTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_pack_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_CDC_Pack_Init(USBD_CDC_PackTypeDef *p, USBD_HandleTypeDef *pdev,
+                            int instance, uint8_t width, uint8_t numChannels);
+void     USBD_CDC_Pack_Reset(USBD_CDC_PackTypeDef *p);
+uint32_t USBD_CDC_Pack_Write(USBD_CDC_PackTypeDef *p, const uint8_t *pbuff,
+                             uint32_t length);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_PACK_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_PACK_H */
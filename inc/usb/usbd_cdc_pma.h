@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_pma.h
+  * @brief   Packet memory layout of the CDC class on the FS device.
+  *          Every offset is a compile time constant: the BTABLE comes first,
+  *          then the two EP0 buffers, then the bulk OUT, bulk IN and
+  *          notification buffers of each instance, double buffered
+  *          endpoints taking two packets. The build fails if the layout
+  *          does not fit in USBD_PMA_SIZE bytes.
+  *
+  *          The low level driver must place EP0 at USBD_PMA_EP0_OUT_ADDR and
+  *          USBD_PMA_EP0_IN_ADDR; the class configures its own endpoints
+  *          from USBD_CDC_Init when USBD_CDC_PMA_ALLOC is set.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_PMA_H
+#define __USBD_CDC_PMA_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_cdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pma
+  * @brief Compile time packet memory allocation of the CDC class
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pma_Exported_Defines
+  * @{
+  */
+
+/* Packet memory available to the USB device: 1 KiB of USB SRAM on the
+   xE parts, 512 bytes on the others */
+#ifndef USBD_PMA_SIZE
+#if defined(STM32F302xE) || defined(STM32F303xE) || defined(STM32F398xx)
+#define USBD_PMA_SIZE                               1024
+#else
+#define USBD_PMA_SIZE                               512
+#endif
+#endif
+
+/* Endpoint numbers in use: EP0 up to the highest CDC endpoint, or more
+   for the endpoints of another function */
+#ifndef USBD_PMA_NUM_EP
+#if (NUM_CDC_INSTANCES == 1)
+#define USBD_PMA_NUM_EP                             3
+#elif (NUM_CDC_INSTANCES == 2)
+#define USBD_PMA_NUM_EP                             6
+#else
+#define USBD_PMA_NUM_EP                             7
+#endif
+#endif
+
+/* Buffer descriptor table: 4 halfwords per endpoint number */
+#define USBD_PMA_BTABLE_SIZE                        (8 * USBD_PMA_NUM_EP)
+
+#define USBD_PMA_EP0_OUT_ADDR                       (USBD_PMA_BTABLE_SIZE)
+#define USBD_PMA_EP0_IN_ADDR                        (USBD_PMA_EP0_OUT_ADDR + USB_MAX_EP0_SIZE)
+
+#define USBD_CDC_PMA_BASE                           (USBD_PMA_EP0_IN_ADDR + USB_MAX_EP0_SIZE)
+
+/* Double buffering of the data endpoints of instance i, 0 or 1 */
+#define USBD_CDC_PMA_DBL_OUT(i)                     ((USBD_CDC_DBL_BUF_OUT_MASK >> (i)) & 1)
+#define USBD_CDC_PMA_DBL_IN(i)                      ((USBD_CDC_DBL_BUF_IN_MASK >> (i)) & 1)
+
+#define USBD_CDC_PMA_OUT_SIZE(i)                    (CDC_DATA_FS_MAX_PACKET_SIZE << USBD_CDC_PMA_DBL_OUT(i))
+#define USBD_CDC_PMA_IN_SIZE(i)                     (CDC_DATA_FS_MAX_PACKET_SIZE << USBD_CDC_PMA_DBL_IN(i))
+#define USBD_CDC_PMA_CMD_SIZE                       ((CDC_CMD_PACKET_SIZE + 1) & ~1)
+
+#define USBD_CDC_PMA_INST_SIZE(i)                   (USBD_CDC_PMA_OUT_SIZE(i) + USBD_CDC_PMA_IN_SIZE(i) + \
+                                                     USBD_CDC_PMA_CMD_SIZE)
+
+/* Start of the buffers of instance i, instances are packed in order */
+#define USBD_CDC_PMA_INST_ADDR(i)                   (USBD_CDC_PMA_BASE + \
+                                                     ((i) > 0 ? USBD_CDC_PMA_INST_SIZE(0) : 0) + \
+                                                     ((i) > 1 ? USBD_CDC_PMA_INST_SIZE(1) : 0) + \
+                                                     ((i) > 2 ? USBD_CDC_PMA_INST_SIZE(2) : 0))
+
+#define USBD_CDC_PMA_OUT_ADDR(i)                    (USBD_CDC_PMA_INST_ADDR(i))
+#define USBD_CDC_PMA_IN_ADDR(i)                     (USBD_CDC_PMA_OUT_ADDR(i) + USBD_CDC_PMA_OUT_SIZE(i))
+#define USBD_CDC_PMA_CMD_ADDR(i)                    (USBD_CDC_PMA_IN_ADDR(i) + USBD_CDC_PMA_IN_SIZE(i))
+
+/* First free byte and leftover packet memory */
+#define USBD_CDC_PMA_END                            (USBD_CDC_PMA_INST_ADDR(NUM_CDC_INSTANCES))
+#define USBD_CDC_PMA_FREE                           (USBD_PMA_SIZE - USBD_CDC_PMA_END)
+
+#if (USBD_CDC_PMA_END > USBD_PMA_SIZE)
+#error "CDC endpoint buffers do not fit in packet memory"
+#endif
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_PMA_H */
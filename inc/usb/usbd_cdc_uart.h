@@ -0,0 +1,173 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_uart.h
+  * @brief   USB to UART bridge on top of the CDC class.
+  *          With USBD_CDC_UART_ENABLED set to 1 this module provides a CDC
+  *          interface, USBD_CDC_Uart_fops, that joins CDC instances to
+  *          USARTs without an interrupt per byte:
+  *
+  *          - UART to USB: the receiver runs a circular DMA into rx_buf.
+  *            Whatever it has written is sent on the CDC IN endpoint
+  *            straight out of that buffer, on the idle line interrupt, on
+  *            the half and full transfer interrupts of the DMA, and when
+  *            the previous IN transfer completes. rx_buf must hold what
+  *            the line brings in during one IN transfer.
+  *          - USB to UART: the OUT endpoint receives straight into a pool
+  *            of packet sized slots, re-pointed at the next free slot after
+  *            each packet. Filled slots go to the transmit DMA as they are,
+  *            a run of full slots in one transfer. The OUT endpoint is left
+  *            NAKing while no slot is free.
+  *          - SET_LINE_CODING reprograms the USART on the fly, once the
+  *            bytes already queued for it are out.
+  *
+  *          The application enables the clocks, the pins and the
+  *          interrupts, routes the USART and DMA channel interrupts to
+  *          USBD_CDC_Uart_IRQHandler and USBD_CDC_Uart_DmaIRQHandler, and
+  *          registers each bridge before the device is started. Those
+  *          interrupts must have the same preemption priority as the USB
+  *          interrupt: both sides call into the CDC class.
+  *
+  *          Instances without a bridge drop what they receive.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_UART_H
+#define __USBD_CDC_UART_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "stm32f3xx_hal.h"
+#include  "usbd_cdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_uart
+  * @brief USB to UART bridge
+  * @{
+  */
+
+/** @defgroup usbd_cdc_uart_Exported_Defines
+  * @{
+  */
+#ifndef USBD_CDC_UART_ENABLED
+#define USBD_CDC_UART_ENABLED                       0
+#endif
+
+/* Circular receive DMA buffer, bytes */
+#ifndef USBD_CDC_UART_RX_SIZE
+#define USBD_CDC_UART_RX_SIZE                       512
+#endif
+
+/* OUT packet slots shared with the transmit DMA, power of 2 */
+#ifndef USBD_CDC_UART_TX_SLOTS
+#define USBD_CDC_UART_TX_SLOTS                      8
+#endif
+
+#if (USBD_CDC_UART_ENABLED == 1) && \
+    ((USBD_CDC_UART_TX_SLOTS & (USBD_CDC_UART_TX_SLOTS - 1)) != 0)
+#error "USBD_CDC_UART_TX_SLOTS must be a power of 2"
+#endif
+
+#if (USBD_CDC_UART_ENABLED == 1) && (USBD_CDC_RX_RING_SIZE > 0)
+#error "USBD_CDC_UART_ENABLED needs the packet receive path"
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Exported_TypesDefinitions
+  * @{
+  */
+
+/* Hardware of one bridge */
+typedef struct
+{
+  USART_TypeDef       *Instance;
+  DMA_TypeDef         *Dma;         /* controller of both channels */
+  DMA_Channel_TypeDef *RxDma;       /* channel serving the USART RX request */
+  DMA_Channel_TypeDef *TxDma;       /* channel serving the USART TX request */
+  uint8_t              RxDmaCh;     /* channel numbers, 1 to 7 */
+  uint8_t              TxDmaCh;
+  uint32_t             ClockHz;     /* USART kernel clock */
+} USBD_CDC_UartConfigTypeDef;
+
+typedef struct
+{
+  uint32_t rx_bytes;            /* UART to USB */
+  uint32_t tx_bytes;            /* USB to UART */
+  uint32_t overruns;            /* USART overrun errors */
+  uint32_t line_errors;         /* framing, noise and parity errors */
+  uint32_t out_stalls;          /* OUT packets left NAKing for lack of a slot */
+} USBD_CDC_UartStatsTypeDef;
+
+typedef struct
+{
+  const USBD_CDC_UartConfigTypeDef *cfg;
+  int      instance;
+  USBD_CDC_UartStatsTypeDef stats;
+  uint8_t  line_coding[7];
+  uint8_t  coding_pending;      /* line coding waits for the transmitter */
+  uint8_t  running;
+
+  /* UART to USB */
+  uint32_t rx_tail;             /* first byte not yet given to the IN endpoint */
+  uint32_t in_len;              /* bytes the IN transfer in flight takes, 0 if idle */
+
+  /* USB to UART, slot indexes are free running */
+  uint32_t tx_head;             /* slots filled, the OUT endpoint owns the next one */
+  uint32_t tx_tail;             /* slots given back by the transmit DMA */
+  uint32_t tx_dma_slots;        /* slots the transmit DMA in flight takes, 0 if idle */
+  uint32_t tx_dma_len;          /* bytes in those slots */
+  uint8_t  out_stalled;         /* OUT endpoint not re-armed, every slot is full */
+
+  uint8_t  rx_buf[USBD_CDC_UART_RX_SIZE];
+  uint16_t tx_slot_len[USBD_CDC_UART_TX_SLOTS];
+  uint8_t  tx_slot[USBD_CDC_UART_TX_SLOTS][CDC_DATA_FS_MAX_PACKET_SIZE];
+} USBD_CDC_UartTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_CDC_UART_ENABLED == 1)
+
+/** @defgroup usbd_cdc_uart_Exported_Variables
+  * @{
+  */
+extern USBD_CDC_ItfTypeDef USBD_CDC_Uart_fops;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Exported_Functions
+  * @{
+  */
+uint8_t USBD_CDC_Uart_Register(USBD_HandleTypeDef *pdev, int instance,
+                               USBD_CDC_UartTypeDef *bridge,
+                               const USBD_CDC_UartConfigTypeDef *cfg);
+void    USBD_CDC_Uart_IRQHandler(USBD_CDC_UartTypeDef *bridge);
+void    USBD_CDC_Uart_DmaIRQHandler(USBD_CDC_UartTypeDef *bridge);
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_UART_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_CDC_UART_H */
@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    usbd_composite.h
+  * @brief   Several class drivers behind one USBD core.
+  *          With USBD_COMPOSITE_ENABLED set to 1, USBD_COMPOSITE is the class
+  *          registered with the core and the real class drivers are added to
+  *          it with USBD_Composite_Add. The composite:
+  *            - joins their configuration descriptors under one header,
+  *              attributes and power taken from the first function,
+  *            - routes interface requests by wIndex, and endpoint requests
+  *              and transfers by endpoint, through tables filled from those
+  *              descriptors: one index per event, no search,
+  *            - sends the data stages of a control transfer to the function
+  *              that took its SETUP,
+  *            - runs Init, DeInit, SOF and LPM of every function, and offers
+  *              class and vendor requests to the device to each function in
+  *              turn until one accepts.
+  *          The functions must use disjoint interface numbers and endpoints;
+  *          USBD_Composite_Add refuses one that collides with those already
+  *          added. The device descriptor should announce the IAD class
+  *          (0xEF, subclass 0x02, protocol 0x01).
+  *
+  *          A class driver keeps using pdev->pClassData and pdev->pUserData:
+  *          the composite points them at the function it calls for the time
+  *          of the call. Outside of the callbacks they belong to the first
+  *          function added, so its thread level API (USBD_CDC_Write...) and
+  *          RegisterInterface call work unchanged, as long as they are not
+  *          used from an interrupt that preempts the USB interrupt. The other
+  *          functions get their user data from USBD_Composite_Add and reach
+  *          their state with USBD_Composite_GetClassData.
+  *
+  *          The descriptor getters of the class API take no device, so
+  *          there is one composite per firmware: the last handle given to
+  *          USBD_Composite_Init.
+  *
+  *          Typical use, CDC console first:
+  *            USBD_Init(&hUsbDevice, &VCP_Desc, 0);
+  *            USBD_Composite_Init(&hUsbDevice, &hComposite);
+  *            USBD_Composite_Add(&hUsbDevice, &USBD_CDC, NULL);
+  *            USBD_CDC_RegisterInterface(&hUsbDevice, &USBD_CDC_fops);
+  *            USBD_Composite_Add(&hUsbDevice, &OtherClass, &other_fops);
+  *            USBD_Start(&hUsbDevice);
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_COMPOSITE_H
+#define __USBD_COMPOSITE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_Composite
+  * @brief Composite device
+  * @{
+  */
+
+/** @defgroup USBD_Composite_Exported_Defines
+  * @{
+  */
+#ifndef USBD_COMPOSITE_ENABLED
+#define USBD_COMPOSITE_ENABLED                      0
+#endif
+
+/* Functions behind one device */
+#ifndef USBD_COMPOSITE_MAX_CLASSES
+#define USBD_COMPOSITE_MAX_CLASSES                  4U
+#endif
+
+/* Room for the joined configuration descriptor */
+#ifndef USBD_COMPOSITE_CFG_DESC_SIZE
+#define USBD_COMPOSITE_CFG_DESC_SIZE                256U
+#endif
+
+/* Routing table entry of an interface or endpoint no function owns */
+#define USBD_COMPOSITE_NONE                         0xFFU
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Exported_Types
+  * @{
+  */
+typedef struct
+{
+  USBD_ClassTypeDef       *pClass;
+  void                    *pClassData;  /* while not the active function */
+  void                    *pUserData;   /* while not the active function */
+} USBD_Composite_FunctionTypeDef;
+
+typedef struct
+{
+  __ALIGN_BEGIN uint8_t   cfg_desc[USBD_COMPOSITE_CFG_DESC_SIZE] __ALIGN_END;
+  USBD_Composite_FunctionTypeDef func[USBD_COMPOSITE_MAX_CLASSES];
+  USBD_HandleTypeDef      *pdev;        /* device the functions run on */
+  uint8_t                 num;          /* functions added */
+  uint8_t                 active;       /* function whose data pdev points at */
+  uint8_t                 ctl_owner;    /* function of the control transfer */
+  uint8_t                 itf_owner[USBD_MAX_NUM_INTERFACES];
+  uint8_t                 in_owner[16];
+  uint8_t                 out_owner[16];
+} USBD_Composite_HandleTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_COMPOSITE_ENABLED == 1)
+
+/** @defgroup USBD_Composite_Exported_Variables
+  * @{
+  */
+extern USBD_ClassTypeDef USBD_COMPOSITE;
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Exported_Functions
+  * @{
+  */
+USBD_StatusTypeDef USBD_Composite_Init(USBD_HandleTypeDef *pdev,
+                                       USBD_Composite_HandleTypeDef *hcomp);
+USBD_StatusTypeDef USBD_Composite_Add(USBD_HandleTypeDef *pdev,
+                                      USBD_ClassTypeDef *pclass,
+                                      void *pUserData);
+void              *USBD_Composite_GetClassData(USBD_HandleTypeDef *pdev,
+                                               const USBD_ClassTypeDef *pclass);
+/**
+  * @}
+  */
+
+#endif /* USBD_COMPOSITE_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_COMPOSITE_H */
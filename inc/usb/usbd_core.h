@@ -92,9 +92,16 @@ USBD_StatusTypeDef USBD_Init(USBD_HandleTypeDef *pdev, USBD_DescriptorsTypeDef *
 USBD_StatusTypeDef USBD_DeInit(USBD_HandleTypeDef *pdev);
 USBD_StatusTypeDef USBD_Start  (USBD_HandleTypeDef *pdev);
 USBD_StatusTypeDef USBD_Stop   (USBD_HandleTypeDef *pdev);
+#if (USBD_POLLED == 1)
+USBD_StatusTypeDef USBD_Poll   (USBD_HandleTypeDef *pdev, uint32_t budget);
+#endif
 USBD_StatusTypeDef USBD_RegisterClass(USBD_HandleTypeDef *pdev, USBD_ClassTypeDef *pclass);
+#if (USBD_VENDOR_FAST_PATH == 1)
+USBD_StatusTypeDef USBD_RegisterVendorHandler(USBD_HandleTypeDef *pdev, const USBD_VendorReqTypeDef *pvendor);
+#endif
 
 USBD_StatusTypeDef USBD_RunTestMode (USBD_HandleTypeDef  *pdev); 
+USBD_StatusTypeDef USBD_RemoteWakeup (USBD_HandleTypeDef  *pdev);
 USBD_StatusTypeDef USBD_SetClassConfig(USBD_HandleTypeDef  *pdev, uint8_t cfgidx);
 USBD_StatusTypeDef USBD_ClrClassConfig(USBD_HandleTypeDef  *pdev, uint8_t cfgidx);
 
@@ -106,6 +113,9 @@ USBD_StatusTypeDef USBD_LL_Reset(USBD_HandleTypeDef  *pdev);
 USBD_StatusTypeDef USBD_LL_SetSpeed(USBD_HandleTypeDef  *pdev, USBD_SpeedTypeDef speed);
 USBD_StatusTypeDef USBD_LL_Suspend(USBD_HandleTypeDef  *pdev);
 USBD_StatusTypeDef USBD_LL_Resume(USBD_HandleTypeDef  *pdev);
+#if (USBD_LPM_ENABLED == 1)
+USBD_StatusTypeDef USBD_LL_LPM(USBD_HandleTypeDef  *pdev, uint8_t state);
+#endif
 
 USBD_StatusTypeDef USBD_LL_SOF(USBD_HandleTypeDef  *pdev);
 USBD_StatusTypeDef USBD_LL_IsoINIncomplete(USBD_HandleTypeDef  *pdev, uint8_t epnum);
@@ -119,6 +129,9 @@ USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev);
 USBD_StatusTypeDef  USBD_LL_DeInit (USBD_HandleTypeDef *pdev);
 USBD_StatusTypeDef  USBD_LL_Start(USBD_HandleTypeDef *pdev);
 USBD_StatusTypeDef  USBD_LL_Stop (USBD_HandleTypeDef *pdev);
+#if (USBD_POLLED == 1)
+USBD_StatusTypeDef  USBD_LL_Poll (USBD_HandleTypeDef *pdev, uint32_t budget);
+#endif
 USBD_StatusTypeDef  USBD_LL_OpenEP  (USBD_HandleTypeDef *pdev, 
                                       uint8_t  ep_addr,                                      
                                       uint8_t  ep_type,
@@ -130,10 +143,15 @@ USBD_StatusTypeDef  USBD_LL_StallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr);
 USBD_StatusTypeDef  USBD_LL_ClearStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr);   
 uint8_t             USBD_LL_IsStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr);   
 USBD_StatusTypeDef  USBD_LL_SetUSBAddress (USBD_HandleTypeDef *pdev, uint8_t dev_addr);   
+#if (USBD_LL_INLINE == 0)
 USBD_StatusTypeDef  USBD_LL_Transmit (USBD_HandleTypeDef *pdev, 
                                       uint8_t  ep_addr,                                      
                                       const uint8_t  *pbuf,
                                       uint16_t  size);
+USBD_StatusTypeDef  USBD_LL_TransmitVec (USBD_HandleTypeDef *pdev, 
+                                         uint8_t  ep_addr,
+                                         const USBD_IovTypeDef *iov,
+                                         uint32_t  iovcnt);
 
 USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, 
                                            uint8_t  ep_addr,                                      
@@ -141,8 +159,112 @@ USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev,
                                            uint16_t  size);
 
 uint32_t USBD_LL_GetRxDataSize  (USBD_HandleTypeDef *pdev, uint8_t  ep_addr);  
+#endif /* USBD_LL_INLINE */
+USBD_StatusTypeDef  USBD_LL_PMAConfig (USBD_HandleTypeDef *pdev, 
+                                       uint8_t  ep_addr,
+                                       uint16_t ep_kind,
+                                       uint32_t pmaadress);
+#if (USBD_LL_INLINE == 0)
+USBD_StatusTypeDef  USBD_LL_ReadRxData (USBD_HandleTypeDef *pdev, 
+                                        uint8_t  ep_addr,
+                                        uint16_t offset,
+                                        uint8_t  *pbuf,
+                                        uint16_t size);
+USBD_StatusTypeDef  USBD_LL_TxReserve (USBD_HandleTypeDef *pdev, 
+                                       uint8_t  ep_addr,
+                                       USBD_PMAWriterTypeDef *w);
+USBD_StatusTypeDef  USBD_LL_TxCommit (USBD_HandleTypeDef *pdev, 
+                                      uint8_t  ep_addr,
+                                      USBD_PMAWriterTypeDef *w);
+#endif /* USBD_LL_INLINE */
+USBD_StatusTypeDef  USBD_LL_ReadRxSamples (USBD_HandleTypeDef *pdev, 
+                                           uint8_t  ep_addr,
+                                           uint16_t offset,
+                                           int16_t  *pbuf,
+                                           uint16_t count,
+                                           int32_t  gain);
+USBD_StatusTypeDef  USBD_LL_ReadRxSamplesF32 (USBD_HandleTypeDef *pdev, 
+                                              uint8_t  ep_addr,
+                                              uint16_t offset,
+                                              float    *pbuf,
+                                              uint16_t count,
+                                              float    scale);
+USBD_StatusTypeDef  USBD_LL_SetEPCallback (USBD_HandleTypeDef *pdev, 
+                                           uint8_t  ep_addr,
+                                           uint8_t  (*callback)(void *pdev, uint8_t epnum));
+USBD_StatusTypeDef  USBD_LL_RemoteWakeup (USBD_HandleTypeDef *pdev);
 void  USBD_LL_Delay (uint32_t Delay);
 
+#if (USBD_LL_INLINE == 1)
+#include "usbd_ll_inline.h"
+#endif /* USBD_LL_INLINE */
+
+/**
+  * @brief  Append a byte to a packet reserved with USBD_LL_TxReserve
+  * @param  w: writer
+  * @param  value: byte
+  * @retval None
+  */
+__STATIC_INLINE void USBD_PMA_PutByte (USBD_PMAWriterTypeDef *w, uint8_t value)
+{
+  if (w->count++ >= w->size)
+  {
+    /* overrun: USBD_LL_TxCommit refuses the packet */
+    return;
+  }
+  if (w->pending == 0U)
+  {
+    w->pending = 0x100U | value;
+    return;
+  }
+  *w->ptr = (uint16_t)((w->pending & 0xFFU) | ((uint16_t)value << 8));
+  w->ptr += w->stride;
+  w->pending = 0U;
+}
+
+/**
+  * @brief  Append a 16-bit value, little endian
+  * @param  w: writer
+  * @param  value: value
+  * @retval None
+  */
+__STATIC_INLINE void USBD_PMA_PutHalf (USBD_PMAWriterTypeDef *w, uint16_t value)
+{
+  if ((w->pending != 0U) || ((uint32_t)w->count + 2U > w->size))
+  {
+    USBD_PMA_PutByte(w, (uint8_t)value);
+    USBD_PMA_PutByte(w, (uint8_t)(value >> 8));
+    return;
+  }
+  *w->ptr = value;
+  w->ptr += w->stride;
+  w->count += 2U;
+}
+
+/**
+  * @brief  Append bytes
+  * @param  w: writer
+  * @param  pbuf: data
+  * @param  len: number of bytes
+  * @retval None
+  */
+__STATIC_INLINE void USBD_PMA_Write (USBD_PMAWriterTypeDef *w, const uint8_t *pbuf, uint16_t len)
+{
+  if ((w->pending != 0U) && (len != 0U))
+  {
+    USBD_PMA_PutByte(w, *pbuf++);
+    len--;
+  }
+  for (; len >= 2U; len -= 2U, pbuf += 2)
+  {
+    USBD_PMA_PutHalf(w, (uint16_t)(pbuf[0] | ((uint16_t)pbuf[1] << 8)));
+  }
+  if (len != 0U)
+  {
+    USBD_PMA_PutByte(w, pbuf[0]);
+  }
+}
+
 /**
   * @}
   */ 
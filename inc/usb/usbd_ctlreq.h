@@ -66,6 +66,29 @@
 /** @defgroup USBD_REQ_Exported_Macros
   * @{
   */ 
+
+/* String descriptors converted by the compiler rather than by USBD_GetString
+ * on every GET_DESCRIPTOR: str must be an ASCII string literal, name becomes
+ * a const descriptor of 2 + 2 * strlen(str) bytes that the descriptor
+ * callbacks return as is, e.g.
+ *   USBD_STRING_DESC_DEFINE(USBD_ProductDesc, "STM32 Virtual ComPort");
+ *   *length = sizeof(USBD_ProductDesc); return (uint8_t *)&USBD_ProductDesc;
+ */
+#define USBD_STRING_DESC_DEFINE(name, str)                                     \
+  __ALIGN_BEGIN static const struct                                            \
+  {                                                                            \
+    uint8_t  bLength;                                                          \
+    uint8_t  bDescriptorType;                                                  \
+    uint16_t bString[sizeof(u"" str) / 2U - 1U];                               \
+  } name __ALIGN_END = { sizeof(u"" str), USB_DESC_TYPE_STRING, u"" str }
+
+#define USBD_LANGID_DESC_DEFINE(name, langid)                                  \
+  __ALIGN_BEGIN static const uint8_t name[4] __ALIGN_END =                     \
+  { 4U, USB_DESC_TYPE_STRING, LOBYTE(langid), HIBYTE(langid) }
+
+/* Serial number string descriptor built by USBD_GetSerialString: 12 hex digits */
+#define USBD_SERIAL_STRING_DIGITS                   12U
+#define USBD_SIZ_SERIAL_DESC                        (2U + 2U * USBD_SERIAL_STRING_DIGITS)
 /**
   * @}
   */ 
@@ -91,6 +114,7 @@ void USBD_CtlError  (USBD_HandleTypeDef  *pdev, USBD_SetupReqTypedef *req);
 void USBD_ParseSetupRequest (USBD_SetupReqTypedef *req, uint8_t *pdata);
 
 void USBD_GetString         (uint8_t *desc, uint8_t *unicode, uint16_t *len);
+void USBD_GetSerialString   (uint8_t *desc, const uint32_t *uid);
 /**
   * @}
   */ 
@@ -110,9 +110,85 @@
 
 #define USB_DEVICE_CAPABITY_TYPE                           0x10
 
+/* BOS descriptor with the USB 2.0 extension capability, for LPM */
+#define USB_LEN_BOS_DESC                                   0x05
+#define USB_LEN_USB2_EXT_DESC                              0x07
+#define USB_SIZ_BOS_DESC                                   (USB_LEN_BOS_DESC + USB_LEN_USB2_EXT_DESC)
+#define USB_DEV_CAP_TYPE_USB2_EXT                          0x02
+#define USB_DEV_CAP_TYPE_PLATFORM                          0x05
+#define USB_USB2_EXT_LPM                                   0x02  /* bmAttributes: L1 supported */
+#define USB_USB2_EXT_BESL                                  0x04  /* bmAttributes: BESL encoding */
+
 #define USB_HS_MAX_PACKET_SIZE                            512
 #define USB_FS_MAX_PACKET_SIZE                            64
+/* Control endpoint packet size, also bMaxPacketSize0 of the device
+   descriptor: 8, 16, 32 or 64 on a full speed device */
+#ifndef USB_MAX_EP0_SIZE
 #define USB_MAX_EP0_SIZE                                  8
+#endif
+#if (USB_MAX_EP0_SIZE != 8) && (USB_MAX_EP0_SIZE != 16) && \
+    (USB_MAX_EP0_SIZE != 32) && (USB_MAX_EP0_SIZE != 64)
+#error "USB_MAX_EP0_SIZE must be 8, 16, 32 or 64"
+#endif
+
+/* Set to 1 to build for a full speed only device controller: the high speed
+   branches, descriptors and buffer sizes of the core and classes drop out */
+#ifndef USBD_FS_ONLY
+#define USBD_FS_ONLY                                      0
+#endif
+
+/* Set to 1 to answer GET_DESCRIPTOR(BOS), from GetBOSDescriptor of the
+   device descriptors. On with LPM, which the host learns from the BOS. */
+#ifndef USBD_BOS_ENABLED
+#define USBD_BOS_ENABLED                                  USBD_LPM_ENABLED
+#endif
+
+/* Set to 1 for USBD_RegisterVendorHandler: vendor requests go straight
+   from the setup stage to a handler of the application, ahead of the
+   standard request chain and the class */
+#ifndef USBD_VENDOR_FAST_PATH
+#define USBD_VENDOR_FAST_PATH                             0
+#endif
+
+/* Set to 1 for USBD_CtlDefer: a class or vendor request handler may leave
+   a control request unanswered when its Setup or EP0_RxReady returns, and
+   complete it later from thread context. EP0 NAKs the host meanwhile,
+   within the control transfer timeout of the host, 5 s for most. */
+#ifndef USBD_CTL_DEFERRED
+#define USBD_CTL_DEFERRED                                 0
+#endif
+
+/* Set to 1 for USBD_Poll: the USB interrupts stay off and the application
+   services the device from its own loop, within a budget of core cycles.
+   The low level driver provides USBD_LL_Poll, HAL_PCD_Poll of a PCD built
+   with PCD_POLLED. */
+#ifndef USBD_POLLED
+#define USBD_POLLED                                       0
+#endif
+
+/* Set to 1 to take the per packet USBD_LL calls inline onto the F3 PCD,
+   see usbd_ll_inline.h; the low level driver leaves them out */
+#ifndef USBD_LL_INLINE
+#define USBD_LL_INLINE                                    0
+#endif
+
+/* Low level core index passed to USBD_Init: DEVICE_HS is the high speed
+   capable controller, which also answers the device qualifier and other
+   speed configuration requests while it runs at full speed */
+#ifndef DEVICE_FS
+#define DEVICE_FS                                         0
+#endif
+#ifndef DEVICE_HS
+#define DEVICE_HS                                         1
+#endif
+
+#if (USBD_FS_ONLY == 1)
+#define USBD_IS_HIGH_SPEED(pdev)                          0
+#define USBD_IS_HS_CAPABLE(pdev)                          0
+#else
+#define USBD_IS_HIGH_SPEED(pdev)                          ((pdev)->dev_speed == USBD_SPEED_HIGH)
+#define USBD_IS_HS_CAPABLE(pdev)                          ((pdev)->id == DEVICE_HS)
+#endif
 
 /*  Device Status */
 #define USBD_STATE_DEFAULT                                1
@@ -120,6 +196,17 @@
 #define USBD_STATE_CONFIGURED                             3
 #define USBD_STATE_SUSPENDED                              4
 
+/*  Link power state, USB 2.0 LPM. L1 is entered and left without a change
+    of the device state above. */
+#define USBD_LPM_L0                                       0
+#define USBD_LPM_L1                                       1
+
+#if (USBD_LPM_ENABLED == 1)
+#define USBD_IS_L1(pdev)                                  ((pdev)->dev_lpm_state == USBD_LPM_L1)
+#else
+#define USBD_IS_L1(pdev)                                  0
+#endif
+
 
 /*  EP0 State */    
 #define USBD_EP0_IDLE                                     0
@@ -129,12 +216,16 @@
 #define USBD_EP0_STATUS_IN                                4
 #define USBD_EP0_STATUS_OUT                               5
 #define USBD_EP0_STALL                                    6    
+#define USBD_EP0_DEFERRED                                 7
 
 #define USBD_EP_TYPE_CTRL                                 0
 #define USBD_EP_TYPE_ISOC                                 1
 #define USBD_EP_TYPE_BULK                                 2
 #define USBD_EP_TYPE_INTR                                 3
 
+#define USBD_EP_SNG_BUF                                   0
+#define USBD_EP_DBL_BUF                                   1
+
 
 /**
   * @}
@@ -179,6 +270,10 @@ typedef struct _Device_cb
 #if (USBD_SUPPORT_USER_STRING == 1)
   uint8_t  *(*GetUsrStrDescriptor)(struct _USBD_HandleTypeDef *pdev ,uint8_t index,  uint16_t *length);   
 #endif  
+#if (USBD_LPM_ENABLED == 1)
+  /* Link entered (USBD_LPM_L1) or left (USBD_LPM_L0) L1, configured only */
+  uint8_t  (*LPM)              (struct _USBD_HandleTypeDef *pdev , uint8_t state);
+#endif
   
 } USBD_ClassTypeDef;
 
@@ -207,11 +302,42 @@ typedef struct
   uint8_t  *(*GetSerialStrDescriptor)( USBD_SpeedTypeDef speed , uint16_t *length);  
   uint8_t  *(*GetConfigurationStrDescriptor)( USBD_SpeedTypeDef speed , uint16_t *length);  
   uint8_t  *(*GetInterfaceStrDescriptor)( USBD_SpeedTypeDef speed , uint16_t *length); 
-#if (USBD_LPM_ENABLED == 1)
+#if (USBD_BOS_ENABLED == 1)
   uint8_t  *(*GetBOSDescriptor)( USBD_SpeedTypeDef speed , uint16_t *length); 
 #endif  
 } USBD_DescriptorsTypeDef;
 
+#if (USBD_VENDOR_FAST_PATH == 1)
+/* Vendor request handler, see USBD_RegisterVendorHandler */
+typedef struct
+{
+  /* USBD_OK: taken, with the data stage started if there is one;
+     USBD_FAIL: stall it; USBD_BUSY: not ours, on to the class */
+  uint8_t  (*Setup)            (struct _USBD_HandleTypeDef *pdev , USBD_SetupReqTypedef  *req);
+  /* data stage of a taken OUT request received, may be NULL */
+  uint8_t  (*EP0_RxReady)      (struct _USBD_HandleTypeDef *pdev );
+} USBD_VendorReqTypeDef;
+#endif
+
+/* Segment of a scatter-gather IN transfer, see USBD_LL_TransmitVec */
+typedef struct
+{
+  const uint8_t           *buf;
+  uint32_t                len;
+} USBD_IovTypeDef;
+
+/* Packet buffer of an IN endpoint filled in place, see USBD_LL_TxReserve.
+   Written with USBD_PMA_PutByte/PutHalf/Write, which hide the halfword
+   layout of the packet memory. */
+typedef struct
+{
+  volatile uint16_t       *ptr;         /* next halfword */
+  uint16_t                stride;       /* halfwords of the CPU map per packet memory halfword */
+  uint16_t                count;        /* bytes written, more than size once overrun */
+  uint16_t                size;         /* room in the buffer */
+  uint16_t                pending;      /* odd byte waiting for its pair, bit 8 set */
+} USBD_PMAWriterTypeDef;
+
 /* USB Device handle structure */
 typedef struct
 { 
@@ -239,6 +365,9 @@ typedef struct _USBD_HandleTypeDef
   uint8_t                 dev_connection_status;  
   uint8_t                 dev_test_mode;
   uint32_t                dev_remote_wakeup;
+#if (USBD_LPM_ENABLED == 1)
+  uint8_t                 dev_lpm_state;
+#endif
 
   USBD_SetupReqTypedef    request;
   USBD_DescriptorsTypeDef *pDesc;
@@ -246,6 +375,13 @@ typedef struct _USBD_HandleTypeDef
   void                    *pClassData;  
   void                    *pUserData;    
   void                    *pData;    
+#if (USBD_VENDOR_FAST_PATH == 1)
+  const USBD_VendorReqTypeDef *pVendor;
+  uint8_t                 vendor_req;     /* request in progress taken by pVendor */
+#endif
+#if (USBD_CTL_DEFERRED == 1)
+  __IO uint32_t           ep0_setup_seq;  /* SETUPs and resets seen, see USBD_CtlRequestId */
+#endif
 } USBD_HandleTypeDef;
 
 /**
@@ -260,6 +396,12 @@ typedef struct _USBD_HandleTypeDef
 #define  SWAPBYTE(addr)        (((uint16_t)(*((uint8_t *)(addr)))) + \
                                (((uint16_t)(*(((uint8_t *)(addr)) + 1))) << 8))
 
+#if (USBD_CTL_DEFERRED == 1)
+#define USBD_CTL_IS_DEFERRED(pdev) ((pdev)->ep0_state == USBD_EP0_DEFERRED)
+#else
+#define USBD_CTL_IS_DEFERRED(pdev) 0
+#endif
+
 #define LOBYTE(x)  ((uint8_t)(x & 0x00FF))
 #define HIBYTE(x)  ((uint8_t)((x & 0xFF00) >>8))
 #define MIN(a, b)  (((a) < (b)) ? (a) : (b))
@@ -56,8 +56,10 @@
 #define         DEVICE_ID2          (0x1FFFF7B0)
 #define         DEVICE_ID3          (0x1FFFF7B4)
 
-#define  USB_SIZ_STRING_SERIAL               0x1A
+#define  USB_SIZ_STRING_SERIAL               0x1A  /* USBD_SIZ_SERIAL_DESC */
 /* Exported macro ------------------------------------------------------------*/
+/* Unique ID words in the order USBD_GetSerialString takes them */
+#define         DEVICE_UID          ((const uint32_t *)DEVICE_ID1)
 /* Exported functions ------------------------------------------------------- */
 extern USBD_DescriptorsTypeDef VCP_Desc;
 
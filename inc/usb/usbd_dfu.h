@@ -0,0 +1,239 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dfu.h
+  * @brief   DFU 1.1 class, download pipelined with flash programming.
+  *          With USBD_DFU_ENABLED set to 1, USBD_DFU is one DFU mode
+  *          interface (class 0xFE, subclass 0x01, protocol 0x02) over EP0
+  *          that dfu-util and the other DFU 1.1 hosts drive as is:
+  *            dfu-util -d vid:pid -D firmware.bin
+  *          Blocks of USBD_DFU_XFER_SIZE bytes land one after the other
+  *          from USBD_DFU_APP_ADDR on, block numbers counting up from the
+  *          first DNLOAD.
+  *
+  *          The class holds two block buffers. A DNLOAD is received into
+  *          the free one while the thread programs the other, and
+  *          GETSTATUS reports dfuDNLOAD-IDLE with a zero poll timeout as
+  *          long as a buffer is free, so the host sends the next block at
+  *          once instead of waiting out the programming of the last one.
+  *          Only with both buffers taken is it dfuDNBUSY, with the time
+  *          left on the block being programmed: a moving average of the
+  *          measured block times, seeded from the figures of the media.
+  *          Whenever no block is waiting, the page the next block goes
+  *          to is erased ahead of it, so that erase overlaps the transfer
+  *          as well. A programming error shows at the next GETSTATUS as
+  *          dfuERROR with the status of the first failure.
+  *
+  *          The application:
+  *            - calls USBD_DFU_Process from its main loop or a task: the
+  *              flash is only erased and written there, never from the
+  *              USB interrupt,
+  *            - gives the media callbacks with USBD_DFU_RegisterMedia,
+  *              Erase and Write on the flash HAL for example.
+  *          The F3 stalls any fetch from flash while its flash controller
+  *          erases a page; EP0 then NAKs, which the poll timeout covers.
+  *          The interface is manifestation tolerant: after the zero length
+  *          DNLOAD and the Manifest callback it is back in dfuIDLE, and the
+  *          application decides when to start the new image.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_DFU_H
+#define __USBD_DFU_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_ioreq.h"
+#include "usbd_composite.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_dfu
+  * @brief DFU class
+  * @{
+  */
+
+/** @defgroup usbd_dfu_Exported_Defines
+  * @{
+  */
+#ifndef USBD_DFU_ENABLED
+#define USBD_DFU_ENABLED                            0
+#endif
+
+#ifndef USBD_DFU_ITF_NUM
+#define USBD_DFU_ITF_NUM                            0
+#endif
+
+/* Flash the image goes to, after a 16 KiB loader by default */
+#ifndef USBD_DFU_APP_ADDR
+#define USBD_DFU_APP_ADDR                           0x08004000U
+#endif
+#ifndef USBD_DFU_APP_SIZE
+#define USBD_DFU_APP_SIZE                           (0x40000U - 0x4000U)
+#endif
+
+/* Erase unit of the flash, 2 KiB on the F303 */
+#ifndef USBD_DFU_PAGE_SIZE
+#define USBD_DFU_PAGE_SIZE                          0x800U
+#endif
+
+/* wTransferSize: bytes of one DNLOAD or UPLOAD block, and of each of the
+   two buffers */
+#ifndef USBD_DFU_XFER_SIZE
+#define USBD_DFU_XFER_SIZE                          1024U
+#endif
+
+/* Pages erased past the end of the block received last, from 1 */
+#ifndef USBD_DFU_ERASE_AHEAD
+#define USBD_DFU_ERASE_AHEAD                        1U
+#endif
+
+/* wDetachTimeOut in ms, for the host only: there is no run-time mode */
+#ifndef USBD_DFU_DETACH_TIMEOUT
+#define USBD_DFU_DETACH_TIMEOUT                     1000U
+#endif
+
+#define USBD_DFU_CFG_DESC_SIZ                       27
+#define USBD_DFU_FUNC_DESC_SIZ                      9
+#define USBD_DFU_DESC_TYPE_FUNCTIONAL               0x21
+#define USBD_DFU_STATUS_SIZ                         6
+
+/* Requests */
+#define USBD_DFU_REQ_DETACH                         0x00
+#define USBD_DFU_REQ_DNLOAD                         0x01
+#define USBD_DFU_REQ_UPLOAD                         0x02
+#define USBD_DFU_REQ_GETSTATUS                      0x03
+#define USBD_DFU_REQ_CLRSTATUS                      0x04
+#define USBD_DFU_REQ_GETSTATE                       0x05
+#define USBD_DFU_REQ_ABORT                          0x06
+
+/* bState */
+#define USBD_DFU_STATE_APP_IDLE                     0x00
+#define USBD_DFU_STATE_APP_DETACH                   0x01
+#define USBD_DFU_STATE_IDLE                         0x02
+#define USBD_DFU_STATE_DNLOAD_SYNC                  0x03
+#define USBD_DFU_STATE_DNBUSY                       0x04
+#define USBD_DFU_STATE_DNLOAD_IDLE                  0x05
+#define USBD_DFU_STATE_MANIFEST_SYNC                0x06
+#define USBD_DFU_STATE_MANIFEST                     0x07
+#define USBD_DFU_STATE_MANIFEST_WAIT_RESET          0x08
+#define USBD_DFU_STATE_UPLOAD_IDLE                  0x09
+#define USBD_DFU_STATE_ERROR                        0x0A
+
+/* bStatus */
+#define USBD_DFU_STATUS_OK                          0x00
+#define USBD_DFU_STATUS_ERR_TARGET                  0x01
+#define USBD_DFU_STATUS_ERR_FILE                    0x02
+#define USBD_DFU_STATUS_ERR_WRITE                   0x03
+#define USBD_DFU_STATUS_ERR_ERASE                   0x04
+#define USBD_DFU_STATUS_ERR_CHECK_ERASED            0x05
+#define USBD_DFU_STATUS_ERR_PROG                    0x06
+#define USBD_DFU_STATUS_ERR_VERIFY                  0x07
+#define USBD_DFU_STATUS_ERR_ADDRESS                 0x08
+#define USBD_DFU_STATUS_ERR_NOTDONE                 0x09
+#define USBD_DFU_STATUS_ERR_FIRMWARE                0x0A
+#define USBD_DFU_STATUS_ERR_VENDOR                  0x0B
+#define USBD_DFU_STATUS_ERR_USBR                    0x0C
+#define USBD_DFU_STATUS_ERR_POR                     0x0D
+#define USBD_DFU_STATUS_ERR_UNKNOWN                 0x0E
+#define USBD_DFU_STATUS_ERR_STALLEDPKT              0x0F
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct _USBD_DFU_Media
+{
+  void     (* Init)      (void);
+  void     (* DeInit)    (void);
+  /* The four below return USBD_OK, anything else on failure, which
+     GETSTATUS reports as errERASE, errPROG, errUNKNOWN and errFIRMWARE */
+  /* Erase the page at addr */
+  uint8_t  (* Erase)     (uint32_t addr);
+  /* Program len bytes, len even */
+  uint8_t  (* Write)     (const uint8_t *src, uint32_t addr, uint32_t len);
+  /* Read back for UPLOAD, from the USB interrupt */
+  uint8_t  (* Read)      (uint32_t addr, uint8_t *dest, uint32_t len);
+  /* Download complete, len bytes from USBD_DFU_APP_ADDR; may be NULL */
+  uint8_t  (* Manifest)  (uint32_t len);
+  /* Millisecond clock to measure the block times; NULL keeps the
+     figures below */
+  uint32_t (* GetTick)   (void);
+  uint16_t EraseTime;   /* ms per page */
+  uint16_t WriteTime;   /* ms per block of USBD_DFU_XFER_SIZE */
+} USBD_DFU_MediaTypeDef;
+
+typedef struct
+{
+  uint32_t          Data[USBD_DFU_XFER_SIZE / 4U];
+  uint32_t          Addr;
+  uint32_t          Len;
+} USBD_DFU_BlockTypeDef;
+
+typedef struct
+{
+  USBD_DFU_BlockTypeDef Block[2];
+  /* blocks received and blocks programmed: Block[Filled & 1] is the one
+     to receive into, Block[Done & 1] the next to program */
+  __IO uint32_t     Filled;
+  __IO uint32_t     Done;
+  __IO uint8_t      State;
+  __IO uint8_t      Status;
+  __IO uint8_t      Error;      /* first failure of the thread */
+  __IO uint8_t      AbortReq;   /* blocks to drop, from the interrupt */
+  __IO uint8_t      Manifested;
+  __IO uint8_t      Busy;       /* Block[Done & 1] being programmed */
+  uint16_t          NextBlock;  /* wValue of the next DNLOAD */
+  __IO uint32_t     NextAddr;   /* where the next DNLOAD goes */
+  uint32_t          ErasedEnd;  /* pages erased up to here, thread only */
+  __IO uint32_t     BusyStart;  /* tick the block in progress started */
+  __IO uint32_t     BlockTime;  /* estimated ms per block, x16 */
+  uint8_t           StatusBuf[USBD_DFU_STATUS_SIZ];
+} USBD_DFU_HandleTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_DFU_ENABLED == 1)
+
+/** @defgroup usbd_dfu_Exported_Variables
+  * @{
+  */
+extern USBD_ClassTypeDef  USBD_DFU;
+#define USBD_DFU_CLASS    &USBD_DFU
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_DFU_RegisterMedia      (USBD_HandleTypeDef *pdev,
+                                      USBD_DFU_MediaTypeDef *fops);
+
+void     USBD_DFU_Process            (USBD_HandleTypeDef *pdev);
+/**
+  * @}
+  */
+
+#endif /* USBD_DFU_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_DFU_H */
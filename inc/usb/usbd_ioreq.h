@@ -105,6 +105,23 @@ USBD_StatusTypeDef  USBD_CtlSendStatus (USBD_HandleTypeDef  *pdev);
 
 USBD_StatusTypeDef  USBD_CtlReceiveStatus (USBD_HandleTypeDef  *pdev);
 
+#if (USBD_CTL_DEFERRED == 1)
+void                USBD_CtlDefer (USBD_HandleTypeDef  *pdev);
+
+uint32_t            USBD_CtlRequestId (USBD_HandleTypeDef  *pdev);
+
+USBD_StatusTypeDef  USBD_CtlDeferredSendData (USBD_HandleTypeDef  *pdev, 
+                               uint32_t id,
+                               uint8_t *pbuf,
+                               uint16_t len);
+
+USBD_StatusTypeDef  USBD_CtlDeferredSendStatus (USBD_HandleTypeDef  *pdev,
+                               uint32_t id);
+
+USBD_StatusTypeDef  USBD_CtlDeferredError (USBD_HandleTypeDef  *pdev,
+                               uint32_t id);
+#endif /* USBD_CTL_DEFERRED */
+
 uint16_t  USBD_GetRxCount (USBD_HandleTypeDef  *pdev , 
                            uint8_t epnum);
 
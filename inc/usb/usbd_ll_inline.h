@@ -0,0 +1,199 @@
+/**
+  ******************************************************************************
+  * @file    usbd_ll_inline.h
+  * @brief   Per packet USBD_LL calls inlined onto the F3 PCD.
+  *          With USBD_LL_INLINE set to 1, usbd_core.h takes the calls a
+  *          class makes for every packet from here, as static inline
+  *          functions straight onto the HAL_PCD functions of the F3 PCD,
+  *          instead of prototypes of the low level driver:
+  *
+  *            USBD_LL_Transmit        HAL_PCD_EP_Transmit
+  *            USBD_LL_TransmitVec     HAL_PCD_EP_TransmitVec
+  *            USBD_LL_PrepareReceive  HAL_PCD_EP_Receive
+  *            USBD_LL_GetRxDataSize   HAL_PCD_EP_GetRxCount
+  *            USBD_LL_ReadRxData      HAL_PCDEx_EP_ReadRxView
+  *            USBD_LL_TxReserve       HAL_PCDEx_EP_TxReserve
+  *            USBD_LL_TxCommit        HAL_PCDEx_EP_TxCommit
+  *
+  *          so a class sends a packet with one call into the PCD. The low
+  *          level driver (usbd_conf.c) must then leave these seven out and
+  *          keep pData pointing at the PCD handle. With
+  *          USBD_CDC_FAST_DISPATCH as well, the completion goes from the
+  *          PCD interrupt to the class without the Data Stage callbacks
+  *          and the core, which makes the packet path of CDC
+  *            USBD_CDC_TransmitPacket -> HAL_PCD_EP_Transmit -> PMA copy
+  *            PCD_EP_ISR_Handler -> USBD_CDC_DataIn -> TxComplete
+  *          Compare the USB_PROF_CDC_DATA_IN and USB_PROF_EP_ISR slots, or
+  *          a tools/cdc_bench.py run, with and without it.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_LL_INLINE_H
+#define __USBD_LL_INLINE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+
+#if (USBD_LL_INLINE == 1)
+
+#if defined(USB_OTG_FS) || (defined(USBD_SIM_ENABLED) && (USBD_SIM_ENABLED == 1))
+#error "USBD_LL_INLINE is for the F3 PCD"
+#endif
+
+#include "stm32f3xx_hal.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_LL_Inline
+  * @brief Per packet low level calls inlined onto the PCD
+  * @{
+  */
+
+/** @defgroup USBD_LL_Inline_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD status of a HAL status
+  * @param  status: HAL status
+  * @retval USBD status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_Status (HAL_StatusTypeDef status)
+{
+  return (status == HAL_OK) ? USBD_OK : ((status == HAL_BUSY) ? USBD_BUSY : USBD_FAIL);
+}
+
+/**
+  * @brief  Start an IN transfer
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pbuf: data
+  * @param  size: number of bytes
+  * @retval status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_Transmit (USBD_HandleTypeDef *pdev,
+                                                     uint8_t  ep_addr,
+                                                     const uint8_t  *pbuf,
+                                                     uint16_t  size)
+{
+  return USBD_LL_Status(HAL_PCD_EP_Transmit((PCD_HandleTypeDef *)pdev->pData, ep_addr, pbuf, size));
+}
+
+/**
+  * @brief  Start an IN transfer from segments
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  iov: segments, same layout as PCD_IovTypeDef
+  * @param  iovcnt: number of segments
+  * @retval status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_TransmitVec (USBD_HandleTypeDef *pdev,
+                                                        uint8_t  ep_addr,
+                                                        const USBD_IovTypeDef *iov,
+                                                        uint32_t  iovcnt)
+{
+  return USBD_LL_Status(HAL_PCD_EP_TransmitVec((PCD_HandleTypeDef *)pdev->pData, ep_addr,
+                                               (const PCD_IovTypeDef *)(const void *)iov, iovcnt));
+}
+
+/**
+  * @brief  Arm an OUT endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pbuf: destination, NULL to leave the packet in packet memory
+  * @param  size: number of bytes
+  * @retval status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_PrepareReceive (USBD_HandleTypeDef *pdev,
+                                                           uint8_t  ep_addr,
+                                                           uint8_t  *pbuf,
+                                                           uint16_t  size)
+{
+  return USBD_LL_Status(HAL_PCD_EP_Receive((PCD_HandleTypeDef *)pdev->pData, ep_addr, pbuf, size));
+}
+
+/**
+  * @brief  Bytes of the last OUT transfer
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval number of bytes
+  */
+__STATIC_INLINE uint32_t USBD_LL_GetRxDataSize (USBD_HandleTypeDef *pdev, uint8_t  ep_addr)
+{
+  return HAL_PCD_EP_GetRxCount((PCD_HandleTypeDef *)pdev->pData, ep_addr);
+}
+
+/**
+  * @brief  Copy part of a packet left in packet memory
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  offset: first byte in the packet
+  * @param  pbuf: destination
+  * @param  size: number of bytes
+  * @retval status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_ReadRxData (USBD_HandleTypeDef *pdev,
+                                                       uint8_t  ep_addr,
+                                                       uint16_t offset,
+                                                       uint8_t  *pbuf,
+                                                       uint16_t size)
+{
+  return USBD_LL_Status(HAL_PCDEx_EP_ReadRxView((PCD_HandleTypeDef *)pdev->pData, ep_addr,
+                                                offset, pbuf, size));
+}
+
+/**
+  * @brief  Reserve the packet buffer of an idle IN endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  w: writer to set up
+  * @retval status, USBD_BUSY while a packet is waiting for the host
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_TxReserve (USBD_HandleTypeDef *pdev,
+                                                      uint8_t  ep_addr,
+                                                      USBD_PMAWriterTypeDef *w)
+{
+  return USBD_LL_Status(HAL_PCDEx_EP_TxReserve((PCD_HandleTypeDef *)pdev->pData, ep_addr,
+                                               (PCD_PMAWriterTypeDef *)w));
+}
+
+/**
+  * @brief  Send the packet of a reservation
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  w: writer of the reservation
+  * @retval status
+  */
+__STATIC_INLINE USBD_StatusTypeDef USBD_LL_TxCommit (USBD_HandleTypeDef *pdev,
+                                                     uint8_t  ep_addr,
+                                                     USBD_PMAWriterTypeDef *w)
+{
+  return USBD_LL_Status(HAL_PCDEx_EP_TxCommit((PCD_HandleTypeDef *)pdev->pData, ep_addr,
+                                              (PCD_PMAWriterTypeDef *)w));
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_LL_INLINE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_LL_INLINE_H */
@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc.h
+  * @brief   Mass storage class, Bulk-Only Transport and SCSI, pipelined.
+  *          With USBD_MSC_ENABLED set to 1, USBD_MSC is one interface of
+  *          class 0x08 (SCSI transparent, Bulk-Only) with a bulk IN and a
+  *          bulk OUT endpoint, which every host mounts without a driver.
+  *
+  *          The data phases of READ(10) and WRITE(10) run through two
+  *          buffers of USBD_MSC_BUF_SIZE bytes, a whole number of blocks
+  *          each. On a read, the storage fills one buffer while the other
+  *          goes out in one multi-packet transfer; on a write, the storage
+  *          takes one buffer while the next chunk is received into the
+  *          other. The bus only idles where the storage is slower than it.
+  *
+  *          The storage may complete a Read or Write at once or later, from
+  *          a DMA interrupt for example (SPI flash, SD card): either way it
+  *          calls USBD_MSC_StorageDone, from the USB interrupt or one of the
+  *          same priority, which does not preempt it.
+  *
+  *          Standalone, USBD_MSC is registered with the core like USBD_CDC.
+  *          Under USBD_COMPOSITE it is added with its interface and
+  *          endpoints moved clear of the other functions, for example after
+  *          two CDC ports:
+  *            -DUSBD_MSC_ITF_NUM=4 -DUSBD_MSC_IN_EP=0x83
+  *            -DUSBD_MSC_OUT_EP=0x03
+  *            USBD_Composite_Add(&hUsbDevice, &USBD_MSC, &msc_storage);
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_H
+#define __USBD_MSC_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_ioreq.h"
+#include "usbd_composite.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_msc
+  * @brief Mass storage class
+  * @{
+  */
+
+/** @defgroup usbd_msc_Exported_Defines
+  * @{
+  */
+#ifndef USBD_MSC_ENABLED
+#define USBD_MSC_ENABLED                            0
+#endif
+
+#ifndef USBD_MSC_ITF_NUM
+#define USBD_MSC_ITF_NUM                            0
+#endif
+#ifndef USBD_MSC_IN_EP
+#define USBD_MSC_IN_EP                              0x81
+#endif
+#ifndef USBD_MSC_OUT_EP
+#define USBD_MSC_OUT_EP                             0x01
+#endif
+
+#define USBD_MSC_FS_MAX_PACKET_SIZE                 64
+#define USBD_MSC_HS_MAX_PACKET_SIZE                 512
+
+/* Logical units, LUN 0 to USBD_MSC_MAX_LUN - 1 */
+#ifndef USBD_MSC_MAX_LUN
+#define USBD_MSC_MAX_LUN                            1U
+#endif
+
+/* Bytes of each of the two data buffers: a multiple of the block size of
+   every LUN and of the max packet size */
+#ifndef USBD_MSC_BUF_SIZE
+#define USBD_MSC_BUF_SIZE                           2048U
+#endif
+
+/* Full speed endpoints to run double buffered, each then takes two packet
+   buffers of packet memory */
+#ifndef USBD_MSC_DBL_BUF_OUT
+#define USBD_MSC_DBL_BUF_OUT                        0
+#endif
+#ifndef USBD_MSC_DBL_BUF_IN
+#define USBD_MSC_DBL_BUF_IN                         0
+#endif
+
+/* Set to 1 to have USBD_MSC_Init assign the packet memory of its
+   endpoints, from USBD_MSC_PMA_ADDR on. Required for double buffering. */
+#ifndef USBD_MSC_PMA_ALLOC
+#if ((USBD_MSC_DBL_BUF_OUT | USBD_MSC_DBL_BUF_IN) != 0)
+#define USBD_MSC_PMA_ALLOC                          1
+#else
+#define USBD_MSC_PMA_ALLOC                          0
+#endif
+#endif
+
+#define USBD_MSC_CFG_DESC_SIZ                       32
+
+/* Bulk-Only Transport */
+#define USBD_MSC_REQ_GET_MAX_LUN                    0xFE
+#define USBD_MSC_REQ_RESET                          0xFF
+#define USBD_MSC_CBW_SIGNATURE                      0x43425355U
+#define USBD_MSC_CSW_SIGNATURE                      0x53425355U
+#define USBD_MSC_CBW_LENGTH                         31U
+#define USBD_MSC_CSW_LENGTH                         13U
+
+#define USBD_MSC_CSW_PASSED                         0x00
+#define USBD_MSC_CSW_FAILED                         0x01
+#define USBD_MSC_CSW_PHASE_ERROR                    0x02
+
+#define USBD_MSC_INQUIRY_LENGTH                     36U
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct _USBD_MSC_Storage
+{
+  /* 0 on success, -1 otherwise, as in the ST storage template */
+  int8_t (* Init)             (uint8_t lun);
+  int8_t (* GetCapacity)      (uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+  int8_t (* IsReady)          (uint8_t lun);
+  int8_t (* IsWriteProtected) (uint8_t lun);
+  /* Start reading or writing blk_len blocks from blk_addr on. 0 means
+     started, and USBD_MSC_StorageDone follows, possibly before the call
+     returns; -1 means refused, with no USBD_MSC_StorageDone */
+  int8_t (* Read)             (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+  int8_t (* Write)            (uint8_t lun, const uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+  /* Highest LUN, below USBD_MSC_MAX_LUN */
+  int8_t (* GetMaxLun)        (void);
+  /* USBD_MSC_INQUIRY_LENGTH bytes of standard INQUIRY data per LUN */
+  const uint8_t *pInquiry;
+} USBD_MSC_StorageTypeDef;
+
+typedef struct
+{
+  uint32_t          Signature;
+  uint32_t          Tag;
+  uint32_t          DataLength;
+  uint8_t           Flags;
+  uint8_t           Lun;
+  uint8_t           CBLength;
+  uint8_t           CB[16];
+} USBD_MSC_CBWTypeDef;
+
+typedef struct
+{
+  uint32_t          Buf[2][USBD_MSC_BUF_SIZE / 4U];
+  /* CBW lands here, room for a whole packet of a misbehaving host */
+#if (USBD_FS_ONLY == 1)
+  uint32_t          CbwBuf[USBD_MSC_FS_MAX_PACKET_SIZE / 4U];
+#else
+  uint32_t          CbwBuf[USBD_MSC_HS_MAX_PACKET_SIZE / 4U];
+#endif
+  uint32_t          CswBuf[4];
+  USBD_MSC_CBWTypeDef Cbw;
+  uint8_t           BotState;
+  uint8_t           BotStatus;
+  uint8_t           MaxLun;
+  uint8_t           SenseKey;
+  uint8_t           SenseAsc;
+  uint8_t           CswStatus;  /* of the CSW sent once IN is cleared */
+  uint32_t          BlockNum[USBD_MSC_MAX_LUN];
+  uint16_t          BlockSize[USBD_MSC_MAX_LUN];
+  /* data phase of READ(10) and WRITE(10): chunks of up to one buffer,
+     chunk n in Buf[n & 1]. The producer (storage on a read, OUT on a
+     write) runs at most two chunks ahead of the consumer */
+  uint32_t          BlkAddr;
+  uint32_t          BlkLen;
+  uint32_t          ChunkBlocks;
+  uint32_t          NumChunks;
+  uint32_t          Xferred;    /* bytes of the data phase moved so far */
+  uint32_t          ProdIssued;
+  uint32_t          ProdDone;
+  uint32_t          ConsIssued;
+  uint32_t          ConsDone;
+  uint8_t           ProdBusy;
+  uint8_t           ConsBusy;
+  uint8_t           MediaBusy;  /* Read or Write started, not done */
+  uint8_t           Discard;    /* ... and of a command reset since */
+  uint8_t           Failed;
+  uint8_t           InKick;
+  uint8_t           KickAgain;
+} USBD_MSC_HandleTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_MSC_ENABLED == 1)
+
+/** @defgroup usbd_msc_Exported_Variables
+  * @{
+  */
+extern USBD_ClassTypeDef  USBD_MSC;
+#define USBD_MSC_CLASS    &USBD_MSC
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_MSC_RegisterStorage    (USBD_HandleTypeDef *pdev,
+                                      USBD_MSC_StorageTypeDef *fops);
+
+void     USBD_MSC_StorageDone        (USBD_HandleTypeDef *pdev,
+                                      int8_t status);
+/**
+  * @}
+  */
+
+#endif /* USBD_MSC_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_MSC_H */
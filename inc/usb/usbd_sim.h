@@ -0,0 +1,197 @@
+/**
+  ******************************************************************************
+  * @file    usbd_sim.h
+  * @brief   Simulated low level driver, for running the device stack on a
+  *          desktop.
+  *          With USBD_SIM_ENABLED set to 1, usbd_sim.c provides the USBD_LL
+  *          functions of usbd_core.h in place of the usbd_conf.c glue and
+  *          the PCD. It models what the class code depends on:
+  *            - a packet memory of USBD_SIM_PMA_SIZE bytes that every packet
+  *              goes through, with the buffers given by USBD_LL_PMAConfig
+  *              and overlapping buffers of open endpoints counted as faults,
+  *            - transfers split into packets of the max packet size, ended
+  *              by a short packet or a full buffer, zero-copy OUT and
+  *              scatter-gather IN included,
+  *            - endpoint state: open, armed (VALID) or NAKing, stalled,
+  *            - SOF with the frame number, and isochronous endpoints left
+  *              unpolled for a frame reported as incomplete.
+  *          The host side is a set of calls, each one a bus transaction
+  *          run to completion with the device callbacks it causes:
+  *          USBD_Sim_Setup/In/Out for one packet, USBD_Sim_Write/Read for
+  *          a bulk transfer, USBD_Sim_Control for a whole control
+  *          transfer, USBD_Sim_Enumerate for what a host does on attach,
+  *          and USBD_Sim_Run to replay a script of steps from memory.
+  *          Double buffered endpoints get both buffers checked but move
+  *          their packets through the first.
+  *
+  *          A host build compiles the core, the classes under test and
+  *          usbd_sim.c with a usbd_conf.h of its own that includes
+  *          usbd_sim_cmsis.h instead of the device header, for example:
+  *            cc -DUSBD_SIM_ENABLED=1 -Isim -Iinc/usb src/usb/usbd_core.c
+  *               src/usb/usbd_ctlreq.c src/usb/usbd_ioreq.c
+  *               src/usb/usbd_cdc.c src/usb/usbd_sim.c app_desc.c test.c
+  *          It runs single threaded, so every interrupt of the real device
+  *          is a nested call here, and runs as fast as the host can: class
+  *          logic can be benchmarked and profiled with the host tools.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_SIM_H
+#define __USBD_SIM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_core.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_Sim
+  * @brief Simulated low level driver
+  * @{
+  */
+
+/** @defgroup USBD_Sim_Exported_Defines
+  * @{
+  */
+#ifndef USBD_SIM_ENABLED
+#define USBD_SIM_ENABLED                            0
+#endif
+
+#ifndef USBD_SIM_NUM_EP
+#define USBD_SIM_NUM_EP                             8U
+#endif
+
+#ifndef USBD_SIM_PMA_SIZE
+#define USBD_SIM_PMA_SIZE                           512U
+#endif
+
+/* Core clock of the simulated device, CYCCNT runs at it */
+#ifndef USBD_SIM_CORE_CLOCK
+#define USBD_SIM_CORE_CLOCK                         72000000U
+#endif
+
+#define USBD_SIM_PMA_NONE                           0xFFFFU
+
+/* Results of a transaction, besides a byte count */
+#define USBD_SIM_NAK                                (-1)
+#define USBD_SIM_STALL                              (-2)
+#define USBD_SIM_ERROR                              (-3)  /* not open, packet too long, bad step */
+
+/* Script steps */
+#define USBD_SIM_OP_RESET                           0x01U /* bus reset */
+#define USBD_SIM_OP_SOF                             0x02U /* len frames */
+#define USBD_SIM_OP_CONTROL                         0x03U /* data: SETUP, then the OUT data stage */
+#define USBD_SIM_OP_OUT                             0x04U /* len bytes of data, as packets */
+#define USBD_SIM_OP_IN                              0x05U /* up to len bytes, compared to data if given */
+#define USBD_SIM_OP_SUSPEND                         0x06U
+#define USBD_SIM_OP_RESUME                          0x07U
+#define USBD_SIM_OP_ENUMERATE                       0x08U
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Exported_TypesDefinitions
+  * @{
+  */
+typedef uint8_t (*USBD_SimEpCallback)(void *pdev, uint8_t epnum);
+
+typedef struct
+{
+  uint8_t           open;
+  uint8_t           type;       /* USBD_EP_TYPE_xxx */
+  uint8_t           stall;
+  uint8_t           armed;      /* transfer under way, packets ACKed */
+  uint8_t           zero_copy;  /* OUT left in packet memory */
+  uint8_t           polled;     /* a packet moved this frame, isochronous */
+  uint16_t          mps;
+  uint16_t          pma_addr;   /* USBD_SIM_PMA_NONE while not given */
+  uint16_t          pma_addr1;  /* second buffer, double buffered */
+  uint16_t          staged;     /* IN bytes waiting in packet memory */
+  uint8_t           *buf;
+  const USBD_IovTypeDef *iov;   /* USBD_LL_TransmitVec segments, NULL for buf */
+  uint32_t          iovcnt;
+  uint32_t          xfer_len;
+  uint32_t          xfer_count;
+  USBD_SimEpCallback cb;        /* USBD_LL_SetEPCallback */
+  uint32_t          packets;
+  uint32_t          bytes;
+  uint32_t          naks;
+} USBD_SimEpTypeDef;
+
+typedef struct
+{
+  USBD_HandleTypeDef *pdev;
+  USBD_SimEpTypeDef in[USBD_SIM_NUM_EP];
+  USBD_SimEpTypeDef out[USBD_SIM_NUM_EP];
+  uint8_t           pma[USBD_SIM_PMA_SIZE];
+  uint16_t          pma_next;   /* allocations for endpoints given no buffer, top down */
+  uint16_t          frame;      /* 11 bit frame number */
+  uint8_t           address;
+  uint8_t           connected;
+  uint8_t           remote_wakeup;
+  uint32_t          pma_copied; /* bytes moved in or out of packet memory */
+  uint32_t          pma_faults; /* overlapping or out of range buffers */
+  uint32_t          failed_step;/* step of the last USBD_Sim_Run that failed */
+} USBD_SimTypeDef;
+
+typedef struct
+{
+  uint8_t           op;         /* USBD_SIM_OP_xxx */
+  uint8_t           ep;         /* endpoint address, OUT and IN */
+  uint16_t          len;
+  const uint8_t     *data;
+  int32_t           expect;     /* byte count or USBD_SIM_xxx the step must give */
+} USBD_SimStepTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_SIM_ENABLED == 1)
+
+/** @defgroup USBD_Sim_Exported_Variables
+  * @{
+  */
+extern USBD_SimTypeDef USBD_Sim;
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Exported_Functions
+  * @{
+  */
+void     USBD_Sim_Reset      (void);
+void     USBD_Sim_Suspend    (void);
+void     USBD_Sim_Resume     (void);
+void     USBD_Sim_SOF        (uint32_t frames);
+void     USBD_Sim_Setup      (const uint8_t *setup);
+int32_t  USBD_Sim_Out        (uint8_t ep_addr, const uint8_t *data, uint16_t len);
+int32_t  USBD_Sim_In         (uint8_t ep_addr, uint8_t *data, uint16_t size);
+int32_t  USBD_Sim_Control    (const uint8_t *setup, uint8_t *data);
+int32_t  USBD_Sim_Write      (uint8_t ep_addr, const uint8_t *data, uint32_t len);
+int32_t  USBD_Sim_Read       (uint8_t ep_addr, uint8_t *data, uint32_t size);
+int32_t  USBD_Sim_Enumerate  (void);
+uint32_t USBD_Sim_Run        (const USBD_SimStepTypeDef *steps, uint32_t count);
+/**
+  * @}
+  */
+
+#endif /* USBD_SIM_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_SIM_H */
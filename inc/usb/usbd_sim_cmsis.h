@@ -0,0 +1,129 @@
+/**
+  ******************************************************************************
+  * @file    usbd_sim_cmsis.h
+  * @brief   Host stand-ins for the Cortex-M parts the USB device stack uses,
+  *          for a desktop build against usbd_sim.c. The usbd_conf.h of the
+  *          host build includes this instead of the device header:
+  *            - the exclusive access and barrier intrinsics, plain loads and
+  *              stores: the simulation runs in one thread and the
+  *              "interrupts" of usbd_sim.c are calls,
+  *            - PRIMASK as a variable,
+  *            - DWT and CoreDebug as structures, DWT->CYCCNT advanced by
+  *              usbd_sim.c at each simulated frame,
+  *            - SystemCoreClock, defined by usbd_sim.c.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_SIM_CMSIS_H
+#define __USBD_SIM_CMSIS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_Sim_CMSIS
+  * @brief Host stand-ins for the CMSIS core
+  * @{
+  */
+
+/* Marks the host build for usbd_sim.c */
+#define USBD_SIM_CMSIS                              1
+
+#ifndef __IO
+#define __IO                                        volatile
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE                             static inline
+#endif
+
+typedef struct
+{
+  __IO uint32_t CTRL;
+  __IO uint32_t CYCCNT;
+} USBD_SimDWT_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t DEMCR;
+} USBD_SimCoreDebug_TypeDef;
+
+extern USBD_SimDWT_TypeDef        USBD_SimDWT;
+extern USBD_SimCoreDebug_TypeDef  USBD_SimCoreDebug;
+extern uint32_t                   USBD_SimPrimask;
+extern uint32_t                   SystemCoreClock;
+
+#define DWT                                         (&USBD_SimDWT)
+#define CoreDebug                                   (&USBD_SimCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk                      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk                  (1UL << 24)
+
+__STATIC_INLINE uint32_t __LDREXW(volatile uint32_t *addr)
+{
+  return *addr;
+}
+
+__STATIC_INLINE uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+  *addr = value;
+  return 0U;
+}
+
+__STATIC_INLINE void __CLREX(void)
+{
+}
+
+__STATIC_INLINE void __DMB(void)
+{
+  __sync_synchronize();
+}
+
+__STATIC_INLINE void __DSB(void)
+{
+  __sync_synchronize();
+}
+
+__STATIC_INLINE uint32_t __CLZ(uint32_t value)
+{
+  return (value == 0U) ? 32U : (uint32_t)__builtin_clz(value);
+}
+
+__STATIC_INLINE uint32_t __get_PRIMASK(void)
+{
+  return USBD_SimPrimask;
+}
+
+__STATIC_INLINE void __set_PRIMASK(uint32_t primask)
+{
+  USBD_SimPrimask = primask;
+}
+
+__STATIC_INLINE void __disable_irq(void)
+{
+  USBD_SimPrimask = 1U;
+}
+
+__STATIC_INLINE void __enable_irq(void)
+{
+  USBD_SimPrimask = 0U;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_SIM_CMSIS_H */
@@ -0,0 +1,215 @@
+/**
+  ******************************************************************************
+  * @file    usbd_vendor.h
+  * @brief   Vendor specific bulk class, bound to WinUSB without a driver.
+  *          With USBD_VENDOR_ENABLED set to 1, USBD_VENDOR is one interface
+  *          of class 0xFF with a bulk IN and a bulk OUT endpoint and nothing
+  *          else: no line coding, no notifications, no tty on the host.
+  *          Transfers are as long as the buffers given to it, up to 64 KiB,
+  *          and split into packets by the PCD, so a transfer costs one
+  *          callback and not one per packet.
+  *
+  *          Windows binds WinUSB from the MS OS 2.0 descriptors:
+  *            - the device descriptors return USBD_VENDOR_GetBOSDesc from
+  *              GetBOSDescriptor, with USBD_BOS_ENABLED set to 1 and bcdUSB
+  *              of the device descriptor at 0x0201 or above,
+  *            - the class answers the vendor request USBD_VENDOR_MS_CODE
+  *              with the descriptor set: WINUSB compatible ID and the
+  *              DeviceInterfaceGUIDs property USBD_VENDOR_GUID. Under
+  *              USBD_COMPOSITE the set holds a function subset for
+  *              USBD_VENDOR_ITF_NUM only.
+  *          Other hosts reach the interface with libusb, as on Windows.
+  *
+  *          Standalone, USBD_VENDOR is registered with the core like
+  *          USBD_CDC. Under USBD_COMPOSITE it is added with its interface
+  *          and endpoints moved clear of the other functions, for example
+  *          after two CDC ports:
+  *            -DUSBD_VENDOR_ITF_NUM=4 -DUSBD_VENDOR_IN_EP=0x83
+  *            -DUSBD_VENDOR_OUT_EP=0x03
+  *            USBD_Composite_Add(&hUsbDevice, &USBD_VENDOR, &vendor_fops);
+  *
+  *          The application rearms OUT with USBD_VENDOR_ReceivePacket once
+  *          it is done with the buffer, from the Receive callback or later:
+  *          until then the host is NAKed.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_VENDOR_H
+#define __USBD_VENDOR_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_ioreq.h"
+#include "usbd_composite.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_vendor
+  * @brief Vendor bulk class
+  * @{
+  */
+
+/** @defgroup usbd_vendor_Exported_Defines
+  * @{
+  */
+#ifndef USBD_VENDOR_ENABLED
+#define USBD_VENDOR_ENABLED                         0
+#endif
+
+#ifndef USBD_VENDOR_ITF_NUM
+#define USBD_VENDOR_ITF_NUM                         0
+#endif
+#ifndef USBD_VENDOR_IN_EP
+#define USBD_VENDOR_IN_EP                           0x81
+#endif
+#ifndef USBD_VENDOR_OUT_EP
+#define USBD_VENDOR_OUT_EP                          0x01
+#endif
+
+#define USBD_VENDOR_FS_MAX_PACKET_SIZE              64
+#define USBD_VENDOR_HS_MAX_PACKET_SIZE              512
+
+/* Full speed endpoints to run double buffered, each then takes two packet
+   buffers of packet memory */
+#ifndef USBD_VENDOR_DBL_BUF_OUT
+#define USBD_VENDOR_DBL_BUF_OUT                     0
+#endif
+#ifndef USBD_VENDOR_DBL_BUF_IN
+#define USBD_VENDOR_DBL_BUF_IN                      0
+#endif
+
+/* Set to 1 to have USBD_VENDOR_Init assign the packet memory of its
+   endpoints, from USBD_VENDOR_PMA_ADDR on. Required for double
+   buffering. */
+#ifndef USBD_VENDOR_PMA_ALLOC
+#if ((USBD_VENDOR_DBL_BUF_OUT | USBD_VENDOR_DBL_BUF_IN) != 0)
+#define USBD_VENDOR_PMA_ALLOC                       1
+#else
+#define USBD_VENDOR_PMA_ALLOC                       0
+#endif
+#endif
+
+/* bMS_VendorCode: bRequest of the descriptor set request, clear of the
+   link statistics requests of usb_stats.h */
+#ifndef USBD_VENDOR_MS_CODE
+#define USBD_VENDOR_MS_CODE                         0x20
+#endif
+
+/* Device interface GUID WinUSB registers, 38 characters with the braces */
+#ifndef USBD_VENDOR_GUID
+#define USBD_VENDOR_GUID                            "{6E3B1D4C-8F2A-4B7E-9C15-3A0D2F7E5B91}"
+#endif
+
+/* Describe a function subset in the descriptor set, for a composite */
+#ifndef USBD_VENDOR_FUNCTION_SUBSET
+#define USBD_VENDOR_FUNCTION_SUBSET                 USBD_COMPOSITE_ENABLED
+#endif
+
+#define USBD_VENDOR_CFG_DESC_SIZ                    32
+
+/* MS OS 2.0 descriptors */
+#define USBD_VENDOR_MS_OS_20_INDEX                  0x07  /* wIndex of the set request */
+#define USBD_VENDOR_MS_WINDOWS_VERSION              0x06030000U  /* Windows 8.1 */
+#define USBD_VENDOR_MS_LEN_PLATFORM_DESC            28
+#define USBD_VENDOR_MS_LEN_SET_HEADER               10
+#define USBD_VENDOR_MS_LEN_SUBSET_HEADER            8
+#define USBD_VENDOR_MS_LEN_COMPAT_ID                20
+#define USBD_VENDOR_MS_LEN_PROPERTY                 (10 + 42 + 80)
+
+#if (USBD_VENDOR_FUNCTION_SUBSET == 1)
+#define USBD_VENDOR_MS_SET_SIZ                      (USBD_VENDOR_MS_LEN_SET_HEADER + \
+                                                     2 * USBD_VENDOR_MS_LEN_SUBSET_HEADER + \
+                                                     USBD_VENDOR_MS_LEN_COMPAT_ID + \
+                                                     USBD_VENDOR_MS_LEN_PROPERTY)
+#else
+#define USBD_VENDOR_MS_SET_SIZ                      (USBD_VENDOR_MS_LEN_SET_HEADER + \
+                                                     USBD_VENDOR_MS_LEN_COMPAT_ID + \
+                                                     USBD_VENDOR_MS_LEN_PROPERTY)
+#endif
+
+#define USBD_VENDOR_BOS_DESC_SIZ                    (USB_SIZ_BOS_DESC + USBD_VENDOR_MS_LEN_PLATFORM_DESC)
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct _USBD_VENDOR_Itf
+{
+  void (* Init)          (void);
+  void (* DeInit)        (void);
+  /* OUT transfer ended, short packet or buffer full; the endpoint NAKs
+     until USBD_VENDOR_ReceivePacket */
+  void (* Receive)       (uint8_t *pbuf, uint32_t length);
+  /* IN transfer given to USBD_VENDOR_Transmit sent, ZLP included */
+  void (* TxComplete)    (const uint8_t *pbuf, uint32_t length);
+} USBD_VENDOR_ItfTypeDef;
+
+typedef struct
+{
+  uint8_t           *RxBuffer;
+  uint32_t          RxSize;
+  const uint8_t     *TxBuffer;
+  uint32_t          TxLength;
+  __IO uint32_t     TxState;    /* IN transfer under way */
+  __IO uint32_t     RxState;    /* OUT transfer armed */
+  uint8_t           TxZlp;      /* ZLP still to send after TxBuffer */
+} USBD_VENDOR_HandleTypeDef;
+/**
+  * @}
+  */
+
+#if (USBD_VENDOR_ENABLED == 1)
+
+/** @defgroup usbd_vendor_Exported_Variables
+  * @{
+  */
+extern USBD_ClassTypeDef  USBD_VENDOR;
+#define USBD_VENDOR_CLASS    &USBD_VENDOR
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_VENDOR_RegisterInterface  (USBD_HandleTypeDef *pdev,
+                                         USBD_VENDOR_ItfTypeDef *fops);
+
+uint8_t  USBD_VENDOR_SetRxBuffer        (USBD_HandleTypeDef *pdev,
+                                         uint8_t *pbuff,
+                                         uint16_t size);
+
+uint8_t  USBD_VENDOR_ReceivePacket      (USBD_HandleTypeDef *pdev);
+
+uint8_t  USBD_VENDOR_Transmit           (USBD_HandleTypeDef *pdev,
+                                         const uint8_t *pbuff,
+                                         uint16_t length);
+
+uint8_t  *USBD_VENDOR_GetBOSDesc        (USBD_SpeedTypeDef speed,
+                                         uint16_t *length);
+/**
+  * @}
+  */
+
+#endif /* USBD_VENDOR_ENABLED */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_VENDOR_H */
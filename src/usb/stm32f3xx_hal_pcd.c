@@ -71,6 +71,13 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f3xx_hal.h"
+#include "usb_prof.h"
+#include "usb_stats.h"
+#include "usb_trace.h"
+#include "usb_timesync.h"
+#include "usb_enumbench.h"
+#include "usb_cap.h"
+#include "usb_ccm.h"
 
 #ifdef HAL_PCD_MODULE_ENABLED
 
@@ -95,17 +102,136 @@
   * @{
   */
 #define BTABLE_ADDRESS                  (0x000U)  
+
+/* Interrupt flags of ISTR, at the same positions as their CNTR masks */
+#if defined(USB_LPMCSR_LMPEN)
+#define PCD_ISTR_IT_MASK                (USB_ISTR_CTR | USB_ISTR_PMAOVR | USB_ISTR_ERR | \
+                                         USB_ISTR_WKUP | USB_ISTR_SUSP | USB_ISTR_RESET | \
+                                         USB_ISTR_SOF | USB_ISTR_ESOF | USB_ISTR_L1REQ)
+#else
+#define PCD_ISTR_IT_MASK                (USB_ISTR_CTR | USB_ISTR_PMAOVR | USB_ISTR_ERR | \
+                                         USB_ISTR_WKUP | USB_ISTR_SUSP | USB_ISTR_RESET | \
+                                         USB_ISTR_SOF | USB_ISTR_ESOF)
+#endif /* USB_LPMCSR_LMPEN */
+
+/* Deferred event types */
+#define PCD_EVENT_SETUP                 0U
+#define PCD_EVENT_DATA_OUT              1U
+#define PCD_EVENT_DATA_IN               2U
+#define PCD_EVENT_RESET                 3U
+#define PCD_EVENT_SUSPEND               4U
+#define PCD_EVENT_RESUME                5U
+#define PCD_EVENT_SOF                   6U
+#define PCD_EVENT_L1                    7U
+#define PCD_EVENT_L0                    8U
+#define PCD_EVENT_ISO_IN_INCOMPLETE     9U
+#define PCD_EVENT_ISO_OUT_INCOMPLETE    10U
 /**
   * @}
   */ 
   
 /* Private macro -------------------------------------------------------------*/
+
+/** @defgroup PCD_Private_Macros PCD Private Macros
+  * @{
+  */
+/* PMA copies, timed per endpoint when USB_PROF_ENABLED is set */
+#define PCD_PROF_READ_PMA(hpcd, epnum, pbUsrBuf, wPMABufAddr, wNBytes)   \
+  do {                                                                  \
+    USB_PROF_BEGIN(prof_pma);                                           \
+    PCD_ReadPMA((hpcd)->Instance, (pbUsrBuf), (wPMABufAddr), (wNBytes)); \
+    USB_PROF_END(USB_PROF_READ_PMA, (epnum), prof_pma);                 \
+  } while (0)
+
+#define PCD_PROF_WRITE_PMA(hpcd, epnum, pbUsrBuf, wPMABufAddr, wNBytes)  \
+  do {                                                                  \
+    USB_PROF_BEGIN(prof_pma);                                           \
+    PCD_WritePMA((hpcd)->Instance, (pbUsrBuf), (wPMABufAddr), (wNBytes)); \
+    USB_PROF_END(USB_PROF_WRITE_PMA, (epnum), prof_pma);                \
+  } while (0)
+
+/* Next packet of an IN transfer, from its buffer or its segments */
+#define PCD_PROF_WRITE_EP(hpcd, ep, wPMABufAddr, wNBytes)                \
+  do {                                                                  \
+    if ((ep)->xfer_iov != NULL)                                         \
+    {                                                                   \
+      USB_PROF_BEGIN(prof_pma);                                         \
+      PCD_WritePMAVec((hpcd)->Instance, &(ep)->xfer_iov, &(ep)->xfer_iov_off, \
+                      (wPMABufAddr), (wNBytes));                        \
+      USB_PROF_END(USB_PROF_WRITE_PMA, (ep)->num, prof_pma);            \
+    }                                                                   \
+    else                                                                \
+    {                                                                   \
+      PCD_PROF_WRITE_PMA((hpcd), (ep)->num, (ep)->xfer_buff, (wPMABufAddr), (wNBytes)); \
+    }                                                                   \
+  } while (0)
+
+/* Callback run from the interrupt, or queued for HAL_PCD_ProcessEvents */
+#if (PCD_DEFERRED_EVENTS == 1)
+#define PCD_EVENT(hpcd, type, epnum, call)    PCD_QueueEvent((hpcd), (type), (epnum))
+#else
+#define PCD_EVENT(hpcd, type, epnum, call)    call
+#endif /* PCD_DEFERRED_EVENTS */
+
+/* Bit of an isochronous endpoint in IsoActive and IsoDone */
+#define PCD_ISO_BIT(ep)                 ((uint16_t)(1U << ((ep)->num + (((ep)->is_in != 0U) ? 0U : 8U))))
+
+#if (PCD_HP_ROUTING == 1) || (PCD_POLLED == 1)
+/* Vectors of the two USB interrupts */
+#if defined(USE_USB_INTERRUPT_REMAPPED) || defined(STM32F373xC)
+#define PCD_HP_IRQn                     USB_HP_IRQn
+#define PCD_LP_IRQn                     USB_LP_IRQn
+#else
+#define PCD_HP_IRQn                     USB_HP_CAN_TX_IRQn
+#define PCD_LP_IRQn                     USB_LP_CAN_RX0_IRQn
+#endif
+#endif /* PCD_HP_ROUTING || PCD_POLLED */
+
+#if (PCD_POLLED == 1)
+/* Too little of the HAL_PCD_Poll budget left for another endpoint service */
+#define PCD_POLL_EXPIRED(hpcd)          ((DWT->CYCCNT - (hpcd)->PollStart) >= (hpcd)->PollBudget)
+#endif /* PCD_POLLED */
+
+#if (PCD_HP_ROUTING == 1)
+/* The hardware raises USB_HP for the transfers of these endpoints */
+#define PCD_EP_IS_HP(ep)                (((ep)->type == PCD_EP_TYPE_ISOC) || ((ep)->doublebuffer != 0U))
+#endif /* PCD_HP_ROUTING */
+
+/* Current frame number, for the OUT NAK statistics */
+#define PCD_FRAME_NUMBER(hpcd)          ((uint16_t)((hpcd)->Instance->FNR & USB_FNR_FN))
+/**
+  * @}
+  */
+
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 /** @defgroup PCD_Private_Functions PCD Private Functions
   * @{
   */
 static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd);
+static void PCD_RemoteWakeupTick(PCD_HandleTypeDef *hpcd);
+static void PCD_EP_OUT_Idle(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_IN_Idle(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_OUT_Sng(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_OUT_Dbl(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_IN_Sng(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_IN_Dbl(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_OUT_Iso(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_IN_Iso(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_IsoStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_IsoFrame(PCD_HandleTypeDef *hpcd);
+static void PCD_EP_RxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count);
+static void PCD_EP_TxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_TxStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static uint16_t PCD_EP_DBUF_Read(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal);
+static void PCD_EP_RxArm(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_DataOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_DataInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+#if (PCD_DEFERRED_EVENTS == 1)
+static PCD_EventTypeDef *PCD_EventClaim(PCD_HandleTypeDef *hpcd, uint8_t type, uint8_t epnum, uint32_t *ticket);
+static void PCD_EventPublish(PCD_EventTypeDef *ev, uint32_t ticket);
+static void PCD_QueueEvent(PCD_HandleTypeDef *hpcd, uint8_t type, uint8_t epnum);
+#endif /* PCD_DEFERRED_EVENTS */
 /**
   * @}
   */ 
@@ -160,6 +286,41 @@ HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd)
   }
 
   hpcd->State = HAL_PCD_STATE_BUSY;
+
+#if (PCD_DEFERRED_EVENTS == 1)
+  /* Empty event queue, processed at the lowest exception priority */
+  for (i = 0U; i < PCD_EVENT_QUEUE_SIZE; i++)
+  {
+    hpcd->Events.ev[i].seq = 0U;
+  }
+  hpcd->Events.head = 0U;
+  hpcd->Events.tail = 0U;
+  hpcd->Events.overflows = 0U;
+  NVIC_SetPriority(PendSV_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL);
+#endif /* PCD_DEFERRED_EVENTS */
+
+#if (PCD_HP_ROUTING == 1)
+  /* Streaming endpoints on their own vector, above control traffic */
+  hpcd->HPEndpoints = 0U;
+  NVIC_SetPriority(PCD_HP_IRQn, PCD_HP_IRQ_PRIORITY);
+  NVIC_SetPriority(PCD_LP_IRQn, PCD_LP_IRQ_PRIORITY);
+  NVIC_EnableIRQ(PCD_HP_IRQn);
+#endif /* PCD_HP_ROUTING */
+
+#if (PCD_POLLED == 1)
+  /* Serviced by HAL_PCD_Poll only, whatever HAL_PCD_MspInit enabled; the
+     budget is counted in core cycles */
+  NVIC_DisableIRQ(PCD_HP_IRQn);
+  NVIC_DisableIRQ(PCD_LP_IRQn);
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif /* PCD_POLLED */
+
+#if (PCD_PMA_DMA == 1)
+  /* CPU copies until HAL_PCDEx_SetPMADma */
+  hpcd->PmaDmaCh = NULL;
+  hpcd->PmaDmaEp = NULL;
+#endif /* PCD_PMA_DMA */
  
  /* Init endpoints structures */
  for (i = 0U; i < hpcd->Init.dev_endpoints ; i++)
@@ -171,7 +332,10 @@ HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd)
    hpcd->IN_ep[i].type = PCD_EP_TYPE_CTRL;
    hpcd->IN_ep[i].maxpacket =  0U;
    hpcd->IN_ep[i].xfer_buff = 0U;
+   hpcd->IN_ep[i].xfer_iov = NULL;
    hpcd->IN_ep[i].xfer_len = 0U;
+   hpcd->IN_ep[i].isr = PCD_EP_IN_Idle;
+   hpcd->IN_ep[i].xfer_cb = NULL;
  }
  
  for (i = 0U; i < hpcd->Init.dev_endpoints ; i++)
@@ -183,6 +347,8 @@ HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd)
    hpcd->OUT_ep[i].maxpacket = 0U;
    hpcd->OUT_ep[i].xfer_buff = 0U;
    hpcd->OUT_ep[i].xfer_len = 0U;
+   hpcd->OUT_ep[i].isr = PCD_EP_OUT_Idle;
+   hpcd->OUT_ep[i].xfer_cb = NULL;
  }
   
  /* Init Device */
@@ -199,13 +365,33 @@ HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd)
  hpcd->Instance->BTABLE = BTABLE_ADDRESS;
   
   /*set wInterrupt_Mask global variable*/
-  wInterrupt_Mask = USB_CNTR_CTRM  | USB_CNTR_WKUPM | USB_CNTR_SUSPM | USB_CNTR_ERRM \
-  | USB_CNTR_SOFM | USB_CNTR_ESOFM | USB_CNTR_RESETM;
+  wInterrupt_Mask = USB_CNTR_CTRM  | USB_CNTR_WKUPM | USB_CNTR_SUSPM | USB_CNTR_RESETM;
+  /* SOF only when asked for, ESOF never by default: nothing here uses it.
+     HAL_PCDEx_EnableInterrupts turns them on later. */
+  if (hpcd->Init.Sof_enable == ENABLE)
+  {
+    wInterrupt_Mask |= USB_CNTR_SOFM;
+  }
+#if (USB_STATS_ENABLED == 1)
+  wInterrupt_Mask |= USB_CNTR_ERRM | USB_CNTR_PMAOVRM;
+#endif /* USB_STATS_ENABLED */
+#if (USB_TIMESYNC_ENABLED == 1)
+  wInterrupt_Mask |= USB_CNTR_SOFM;
+#endif /* USB_TIMESYNC_ENABLED */
   
   /*Set interrupt mask*/
   hpcd->Instance->CNTR = wInterrupt_Mask;
   
   hpcd->USB_Address = 0U;
+  hpcd->RemoteWakeup = 0U;
+#if defined(USB_LPMCSR_LMPEN)
+  hpcd->LPM_State = LPM_L0;
+  hpcd->lpm_active = 0U;
+  if (hpcd->Init.lpm_enable == ENABLE)
+  {
+    HAL_PCDEx_ActivateLPM(hpcd);
+  }
+#endif /* USB_LPMCSR_LMPEN */
   hpcd->State= HAL_PCD_STATE_READY;
 
  return HAL_OK;
@@ -295,6 +481,7 @@ HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd)
 { 
   /*  DP Pull-Down is external */
   HAL_PCDEx_SetConnectionState (hpcd, 1U);
+  USB_ENUMBENCH_CONNECTED();
   
   return HAL_OK;
 }
@@ -331,22 +518,56 @@ HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd)
 /** @addtogroup PCD_Private_Functions PCD Private Functions
   * @{
   */
+/**
+  * @brief  One ESOF period of a remote wakeup started by
+  *         HAL_PCD_StartRemoteWakeup
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+static void PCD_RemoteWakeupTick(PCD_HandleTypeDef *hpcd)
+{
+  hpcd->RemoteWakeup--;
+
+  if (hpcd->RemoteWakeup == PCD_REMOTE_WAKEUP_MS)
+  {
+    /* holdoff over */
+    hpcd->Instance->CNTR |= USB_CNTR_RESUME;
+  }
+  else if (hpcd->RemoteWakeup == 0U)
+  {
+    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_RESUME);
+    if (hpcd->RemoteWakeupEsof == 0U)
+    {
+      hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_ESOFM);
+    }
+    PCD_EVENT(hpcd, PCD_EVENT_RESUME, 0U, HAL_PCD_ResumeCallback(hpcd));
+  }
+}
+
 /**
   * @brief  This function handles PCD Endpoint interrupt request.
   * @param  hpcd PCD handle
   * @retval HAL status
   */
-static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
+static USB_CCM_FUNC HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
 {
   PCD_EPTypeDef *ep;
-  uint16_t count=0U;
   uint8_t EPindex;
-  __IO uint16_t wIstr;  
-  __IO uint16_t wEPVal = 0U;
+  uint16_t wIstr;  
+  uint16_t wEPVal = 0U;
   
   /* stay in loop while pending interrupts */
   while (((wIstr = hpcd->Instance->ISTR) & USB_ISTR_CTR) != 0U)
   {
+#if (PCD_POLLED == 1)
+    if (PCD_POLL_EXPIRED(hpcd))
+    {
+      /* left pending for the next poll */
+      break;
+    }
+#endif /* PCD_POLLED */
+    USB_PROF_BEGIN(prof_start);
+
     /* extract highest priority endpoint number */
     EPindex = (uint8_t)(wIstr & USB_ISTR_EP_ID);
     
@@ -366,10 +587,21 @@ static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
         
         ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
         ep->xfer_buff += ep->xfer_count;
+        USB_STATS_TX(0U, ep->xfer_count);
+        USB_TRACE_IN(0U, ep->xfer_count);
+        USB_CAP_IN(ep, ep->xfer_buff - ep->xfer_count, ep->xfer_count);
  
-        /* TX COMPLETE */
-        HAL_PCD_DataInStageCallback(hpcd, 0U);
-        
+        if (ep->xfer_len != 0U)
+        {
+          /* Load the next packet of the data stage right away, the core
+             only hears about the transfer once it is complete */
+          HAL_PCD_EP_Transmit(hpcd, 0U, ep->xfer_buff, ep->xfer_len);
+        }
+        else
+        {
+          /* TX COMPLETE */
+          PCD_EVENT(hpcd, PCD_EVENT_DATA_IN, 0U, HAL_PCD_DataInStageCallback(hpcd, 0U));
+        }
         
         if((hpcd->USB_Address > 0U)&& ( ep->xfer_len == 0U))
         {
@@ -391,231 +623,1033 @@ static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
         {
           /* Get SETUP Packet*/
           ep->xfer_count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
-          PCD_ReadPMA(hpcd->Instance, (uint8_t*)(void*)hpcd->Setup ,ep->pmaadress , ep->xfer_count);
+#if (PCD_DEFERRED_EVENTS == 1)
+          {
+            /* Straight into the event record: hpcd->Setup belongs to the
+               setup being processed */
+            uint32_t ticket;
+            PCD_EventTypeDef *ev = PCD_EventClaim(hpcd, PCD_EVENT_SETUP, 0U, &ticket);
+
+            if (ev != NULL)
+            {
+              PCD_PROF_READ_PMA(hpcd, ep->num, (uint8_t*)(void*)ev->setup, ep->pmaadress,
+                                (ep->xfer_count > 8U) ? 8U : ep->xfer_count);
+              USB_TRACE_SETUP((uint8_t*)(void*)ev->setup);
+              USB_CAP_SETUP_PACKET((uint8_t*)(void*)ev->setup);
+            }
+            PCD_CLEAR_RX_EP_CTR(hpcd->Instance, PCD_ENDP0); 
+            if (ev != NULL)
+            {
+              PCD_EventPublish(ev, ticket);
+            }
+          }
+#else
+          PCD_PROF_READ_PMA(hpcd, ep->num, (uint8_t*)(void*)hpcd->Setup ,ep->pmaadress , ep->xfer_count);
+          USB_TRACE_SETUP((uint8_t*)(void*)hpcd->Setup);
+          USB_CAP_SETUP_PACKET((uint8_t*)(void*)hpcd->Setup);
           /* SETUP bit kept frozen while CTR_RX = 1U*/ 
           PCD_CLEAR_RX_EP_CTR(hpcd->Instance, PCD_ENDP0); 
           
           /* Process SETUP Packet*/
           HAL_PCD_SetupStageCallback(hpcd);
+#endif /* PCD_DEFERRED_EVENTS */
+          USB_STATS_RX(0U, ep->xfer_count);
         }
         
         else if ((wEPVal & USB_EP_CTR_RX) != 0U)
         {
+          uint16_t count;
+
           PCD_CLEAR_RX_EP_CTR(hpcd->Instance, PCD_ENDP0);
           /* Get Control Data OUT Packet*/
-          ep->xfer_count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
+          count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
+          USB_STATS_RX(0U, count);
+          USB_TRACE_OUT(0U, count);
           
-          if (ep->xfer_count != 0U)
+          if (count != 0U)
           {
-            PCD_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, ep->xfer_count);
-            ep->xfer_buff+=ep->xfer_count;
+            PCD_PROF_READ_PMA(hpcd, ep->num, ep->xfer_buff, ep->pmaadress, count);
+            ep->xfer_buff += count;
+            ep->xfer_count += count;
           }
+          USB_CAP_OUT(ep, ep->xfer_buff - count, count);
           
-          /* Process Control Data OUT Packet*/
-           HAL_PCD_DataOutStageCallback(hpcd, 0U);
-          
-          PCD_SET_EP_RX_CNT(hpcd->Instance, PCD_ENDP0, ep->maxpacket)
-          PCD_SET_EP_RX_STATUS(hpcd->Instance, PCD_ENDP0, USB_EP_RX_VALID)
+          if ((count == ep->maxpacket) && (ep->xfer_len != 0U))
+          {
+            /* Full packet and more to come: arm for the next one without
+               going through the core */
+            PCD_EP_RxArm(hpcd, ep);
+          }
+          else
+          {
+            /* Process Control Data OUT Packet*/
+            PCD_EVENT(hpcd, PCD_EVENT_DATA_OUT, 0U, HAL_PCD_DataOutStageCallback(hpcd, 0U));
+            
+            PCD_SET_EP_RX_CNT(hpcd->Instance, PCD_ENDP0, ep->maxpacket)
+            PCD_SET_EP_RX_STATUS(hpcd->Instance, PCD_ENDP0, USB_EP_RX_VALID)
+          }
         }
       }
     }
     else
     {
-      
-      /* Decode and service non control endpoints interrupt  */
-      
-      /* process related endpoint register */
+#if (PCD_HP_ROUTING == 1)
+      if ((hpcd->HPEndpoints & (1U << EPindex)) != 0U)
+      {
+        /* Served by HAL_PCD_HP_IRQHandler, which is pending as well and
+           runs first: the endpoints after it wait for the next round */
+        break;
+      }
+#endif /* PCD_HP_ROUTING */
+      /* Decode and service non control endpoints interrupt: one register
+         read serves both directions, the handlers were picked by
+         HAL_PCD_EP_Open */
       wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, EPindex);
       if ((wEPVal & USB_EP_CTR_RX) != 0U)
-      {  
-        /* clear int flag */
-        PCD_CLEAR_RX_EP_CTR(hpcd->Instance, EPindex);
+      {
         ep = &hpcd->OUT_ep[EPindex];
-        
-        /* OUT double Buffering*/
-        if (ep->doublebuffer == 0U)
-        {
-          count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
-          if (count != 0U)
-          {
-            PCD_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, count);
-          }
-        }
-        else
-        {
-          if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num)& USB_EP_DTOG_RX) == USB_EP_DTOG_RX)
-          {
-            /*read from endpoint BUF0Addr buffer*/
-            count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
-            if (count != 0U)
-            {
-              PCD_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr0, count);
-            }
-          }
-          else
-          {
-            /*read from endpoint BUF1Addr buffer*/
-            count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
-            if (count != 0U)
-            {
-              PCD_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr1, count);
-            }
-          }
-          PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT)  
-        }
-        /*multi-packet on the NON control OUT endpoint*/
-        ep->xfer_count+=count;
-        ep->xfer_buff+=count;
-       
-        if ((ep->xfer_len == 0U) || (count < ep->maxpacket))
-        {
-          /* RX COMPLETE */
-          HAL_PCD_DataOutStageCallback(hpcd, ep->num);
-        }
-        else
-        {
-          HAL_PCD_EP_Receive(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
-        }
-        
-      } /* if((wEPVal & EP_CTR_RX) */
-      
+        ep->isr(hpcd, ep, wEPVal);
+      }
       if ((wEPVal & USB_EP_CTR_TX) != 0U)
       {
         ep = &hpcd->IN_ep[EPindex];
-        
-        /* clear int flag */
-        PCD_CLEAR_TX_EP_CTR(hpcd->Instance, EPindex);
-        
-        /* IN double Buffering*/
-        if (ep->doublebuffer == 0U)
-        {
-          ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
-          if (ep->xfer_count != 0U)
-          {
-            PCD_WritePMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, ep->xfer_count);
-          }
-        }
-        else
-        {
-          if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num)& USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
-          {
-            /*read from endpoint BUF0Addr buffer*/
-            ep->xfer_count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
-            if (ep->xfer_count != 0U)
-            {
-              PCD_WritePMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr0, ep->xfer_count);
-            }
-          }
-          else
-          {
-            /*read from endpoint BUF1Addr buffer*/
-            ep->xfer_count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
-            if (ep->xfer_count != 0U)
-            {
-              PCD_WritePMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr1, ep->xfer_count);
-            }
-          }
-          PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_IN)  
-        }
-        /*multi-packet on the NON control IN endpoint*/
-        ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
-        ep->xfer_buff+=ep->xfer_count;
-       
-        /* Zero Length Packet? */
-        if (ep->xfer_len == 0U)
+        ep->isr(hpcd, ep, wEPVal);
+      }
+    }
+
+    USB_PROF_END(USB_PROF_EP_ISR, EPindex, prof_start);
+  }
+  return HAL_OK;
+}
+
+/**
+  * @brief  Service of an endpoint direction that is not open: only
+  *         acknowledge the event.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static void PCD_EP_OUT_Idle(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_RX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+}
+
+static void PCD_EP_IN_Idle(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_TX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+}
+
+/**
+  * @brief  Packet received on a single buffered OUT endpoint.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_OUT_Sng(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  uint16_t count;
+
+  PCD_CLEAR_RX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+
+  count = PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
+  if (count > (ep->xfer_size - ep->xfer_count))
+  {
+    /* never write past the end of the transfer buffer */
+    count = (uint16_t)(ep->xfer_size - ep->xfer_count);
+  }
+  if (ep->xfer_buff == NULL)
+  {
+    /* Zero-copy transfer: the endpoint stays NAKed until re-armed */
+    ep->rx_view = ep->pmaadress;
+  }
+  else if (count != 0U)
+  {
+#if (PCD_PMA_DMA == 1)
+    if (PCD_PMADmaStart(hpcd, ep, ep->xfer_buff, ep->pmaadress, count))
+    {
+      /* completed by HAL_PCD_PMADma_IRQHandler, the endpoint NAKs meanwhile */
+      return;
+    }
+#endif /* PCD_PMA_DMA */
+    PCD_PROF_READ_PMA(hpcd, ep->num, ep->xfer_buff, ep->pmaadress, count);
+  }
+
+  PCD_EP_RxDone(hpcd, ep, count);
+}
+
+/**
+  * @brief  Packet received on a double buffered OUT endpoint.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_OUT_Dbl(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_RX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+
+  if (ep->xfer_armed == 0U)
+  {
+    /* Nobody is waiting for data: keep the packet in PMA. The buffer is
+       not released, so the next packet is NAKed until the endpoint is
+       re-armed by HAL_PCD_EP_Receive */
+    ep->dbuf_held = 1U;
+    return;
+  }
+
+  PCD_EP_RxDone(hpcd, ep, PCD_EP_DBUF_Read(hpcd, ep, wEPVal));
+}
+
+/**
+  * @brief  Packet sent on a single buffered IN endpoint.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_IN_Sng(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_TX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+
+  ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
+  PCD_EP_TxDone(hpcd, ep);
+}
+
+/**
+  * @brief  Packet sent on a double buffered IN endpoint.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_IN_Dbl(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_TX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+
+  if ((wEPVal & USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
+  {
+    /* DTOG_TX moved on: buffer 0 was just sent */
+    ep->xfer_count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+  }
+  else
+  {
+    /* buffer 1 was just sent */
+    ep->xfer_count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+  }
+  PCD_EP_TxDone(hpcd, ep);
+}
+
+/**
+  * @brief  Packet received on an isochronous OUT endpoint.
+  * @note   The hardware swaps the buffers on every transaction, armed or
+  *         not: DTOG_RX has already moved on to the buffer of the next
+  *         frame, the packet is in the other one. A packet that comes while
+  *         no transfer is armed is lost.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_OUT_Iso(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  uint16_t count;
+  uint16_t pmabuffer;
+
+  PCD_CLEAR_RX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+  hpcd->IsoDone |= PCD_ISO_BIT(ep);
+
+  if ((wEPVal & USB_EP_DTOG_RX) == USB_EP_DTOG_RX)
+  {
+    count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr0;
+  }
+  else
+  {
+    count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr1;
+  }
+
+  if (ep->xfer_armed == 0U)
+  {
+    return;
+  }
+
+  if (count > ep->xfer_size)
+  {
+    count = (uint16_t)ep->xfer_size;
+  }
+  if (ep->xfer_buff == NULL)
+  {
+    /* Zero-copy transfer: valid until the USB fills this buffer again,
+       one frame from now */
+    ep->rx_view = pmabuffer;
+  }
+  else if (count != 0U)
+  {
+    PCD_PROF_READ_PMA(hpcd, ep->num, ep->xfer_buff, pmabuffer, count);
+  }
+
+  PCD_EP_RxDone(hpcd, ep, count);
+}
+
+/**
+  * @brief  Packet sent on an isochronous IN endpoint.
+  * @note   DTOG_TX has already moved on to the buffer written during the
+  *         last frame. The buffer just sent is cleared so that, unless it
+  *         is written again before its turn comes, the host gets a zero
+  *         length packet and not stale data.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_IN_Iso(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  PCD_CLEAR_TX_EP_CTR_VAL(hpcd->Instance, ep->num, wEPVal);
+  hpcd->IsoDone |= PCD_ISO_BIT(ep);
+
+  if ((wEPVal & USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
+  {
+    ep->xfer_count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+    PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, 0U)
+  }
+  else
+  {
+    ep->xfer_count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+    PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, 0U)
+  }
+  PCD_EP_TxDone(hpcd, ep);
+}
+
+/**
+  * @brief  Start watching an isochronous endpoint from the SOF interrupt.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_IsoStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint16_t bit = PCD_ISO_BIT(ep);
+  uint32_t primask;
+
+  if ((hpcd->IsoActive & bit) != 0U)
+  {
+    return;
+  }
+  primask = __get_PRIMASK();
+  __disable_irq();
+  /* counted as served in the frame it starts in */
+  hpcd->IsoDone |= bit;
+  hpcd->IsoActive |= bit;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Frame check of the isochronous endpoints, from the SOF
+  *         interrupt: an endpoint that saw no transaction during the frame
+  *         that just ended gets the incomplete callback.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+static void PCD_IsoFrame(PCD_HandleTypeDef *hpcd)
+{
+  uint16_t missed;
+  uint32_t primask;
+  uint8_t n;
+
+  /* the endpoints may be served from USB_HP meanwhile */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  missed = hpcd->IsoActive & (uint16_t)~hpcd->IsoDone;
+  hpcd->IsoDone = 0U;
+  __set_PRIMASK(primask);
+
+  for (n = 0U; missed != 0U; n++, missed >>= 1)
+  {
+    if ((missed & 1U) == 0U)
+    {
+      continue;
+    }
+    if (n < 8U)
+    {
+      PCD_EVENT(hpcd, PCD_EVENT_ISO_IN_INCOMPLETE, n, HAL_PCD_ISOINIncompleteCallback(hpcd, n));
+    }
+    else
+    {
+      PCD_EVENT(hpcd, PCD_EVENT_ISO_OUT_INCOMPLETE, n - 8U,
+                HAL_PCD_ISOOUTIncompleteCallback(hpcd, n - 8U));
+    }
+  }
+}
+
+/**
+  * @brief  Account a received packet, then complete the transfer or arm
+  *         the endpoint for the next packet.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  count bytes taken from the packet
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_RxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count)
+{
+  /*multi-packet on the NON control OUT endpoint*/
+  ep->xfer_count += count;
+  USB_STATS_RX(ep->num, count);
+  USB_TRACE_OUT(ep->num, count);
+#if (USB_CAP_ENABLED == 1)
+  if (ep->xfer_buff == NULL)
+  {
+    USB_CAP_OUT_PMA(hpcd->Instance, ep, ep->rx_view, count);
+  }
+  else
+  {
+    USB_CAP_OUT(ep, ep->xfer_buff, count);
+  }
+#endif /* USB_CAP_ENABLED */
+  if (ep->xfer_buff != NULL)
+  {
+    ep->xfer_buff += count;
+  }
+
+  if ((ep->xfer_len == 0U) || (count < ep->maxpacket))
+  {
+    /* RX COMPLETE */
+    ep->xfer_armed = 0U;
+    USB_STATS_OUT_IDLE(ep->num, PCD_FRAME_NUMBER(hpcd));
+    PCD_EVENT(hpcd, PCD_EVENT_DATA_OUT, ep->num, PCD_DataOutDone(hpcd, ep));
+  }
+  else
+  {
+    /* next packet of the transfer: keep xfer_count running */
+    PCD_EP_RxArm(hpcd, ep);
+  }
+}
+
+/**
+  * @brief  Account a sent packet, then complete the transfer or send the
+  *         next packet.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_TxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  /*multi-packet on the NON control IN endpoint*/
+  USB_CAP_IN(ep, (ep->xfer_iov == NULL) ? ep->xfer_buff : NULL, ep->xfer_count);
+  if (ep->xfer_iov == NULL)
+  {
+    ep->xfer_buff += ep->xfer_count;
+  }
+  USB_STATS_TX(ep->num, ep->xfer_count);
+  USB_TRACE_IN(ep->num, ep->xfer_count);
+
+  /* Zero Length Packet? */
+  if (ep->xfer_len == 0U)
+  {
+    /* TX COMPLETE */
+    PCD_EVENT(hpcd, PCD_EVENT_DATA_IN, ep->num, PCD_DataInDone(hpcd, ep));
+  }
+  else
+  {
+    PCD_EP_TxStart(hpcd, ep);
+  }
+}
+
+/**
+  * @brief  Drain the packet just received on a double buffered OUT endpoint.
+  * @note   The reception is NAKed while DTOG_RX equals SW_BUF, so the filled
+  *         buffer is the one SW_BUF does not point at. SW_BUF is toggled
+  *         before the PMA copy: the host can fill the other buffer while
+  *         this one is being read out.
+  *         For a zero-copy transfer the buffer is only recorded in rx_view
+  *         and released on the next HAL_PCD_EP_Receive.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  wEPVal endpoint register value, only SW_BUF is used
+  * @retval Number of bytes copied to ep->xfer_buff
+  */
+static USB_CCM_FUNC uint16_t PCD_EP_DBUF_Read(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t wEPVal)
+{
+  uint16_t count;
+  uint16_t pmabuffer;
+
+  /* SW_BUF of an OUT endpoint is the DTOG_TX bit */
+  if ((wEPVal & USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
+  {
+    /*read from endpoint BUF0Addr buffer*/
+    count = PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr0;
+  }
+  else
+  {
+    /*read from endpoint BUF1Addr buffer*/
+    count = PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr1;
+  }
+
+  if (count > (ep->xfer_size - ep->xfer_count))
+  {
+    /* the buffer may have been sized for an earlier, larger chunk */
+    count = (uint16_t)(ep->xfer_size - ep->xfer_count);
+  }
+
+  ep->dbuf_held = 0U;
+
+  if (ep->xfer_buff == NULL)
+  {
+    ep->rx_view = pmabuffer;
+    ep->rx_view_dbuf = 1U;
+    return count;
+  }
+
+  PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT)
+
+  if (count != 0U)
+  {
+    PCD_PROF_READ_PMA(hpcd, ep->num, ep->xfer_buff, pmabuffer, count);
+  }
+
+  return count;
+}
+
+/**
+  * @brief  Arm an OUT endpoint for the next packet of the current transfer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_RxArm(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint32_t len;
+
+  /* Multi packet transfer*/
+  if (ep->xfer_len > ep->maxpacket)
+  {
+    len=ep->maxpacket;
+    ep->xfer_len-=len; 
+  }
+  else
+  {
+    len=ep->xfer_len;
+    ep->xfer_len =0U;
+  }
+  
+  /* configure and validate Rx endpoint */
+  if (ep->doublebuffer == 0U) 
+  {
+    /*Set RX buffer count*/
+    PCD_SET_EP_RX_CNT(hpcd->Instance, ep->num, len)
+    PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_VALID)
+    return;
+  }
+
+  /*Set the Double buffer counters: either buffer may take the next packet*/
+  PCD_SET_EP_DBUF_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT, len)
+  ep->xfer_armed = 1U;
+
+  /* Release the buffer still held by a previous zero-copy transfer */
+  if (ep->rx_view_dbuf != 0U)
+  {
+    ep->rx_view_dbuf = 0U;
+    PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT)
+  }
+
+  /* A packet that arrived while the endpoint was not armed is handed over
+     right away: its CTR interrupt has already been serviced, so it is
+     completed from here, and the next packet armed if the transfer goes on */
+  if (ep->dbuf_held != 0U)
+  {
+    PCD_EP_RxDone(hpcd, ep, PCD_EP_DBUF_Read(hpcd, ep, PCD_GET_ENDPOINT(hpcd->Instance, ep->num)));
+  }
+}
+
+/**
+  * @brief  Completion of an OUT transfer: endpoint handler or Data OUT stage
+  *         callback
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_DataOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if (ep->xfer_cb != NULL)
+  {
+    ep->xfer_cb(hpcd->pData, ep->num);
+  }
+  else
+  {
+    HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+  }
+}
+
+/**
+  * @brief  Completion of an IN transfer: endpoint handler or Data IN stage
+  *         callback
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_DataInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if (ep->xfer_cb != NULL)
+  {
+    ep->xfer_cb(hpcd->pData, ep->num);
+  }
+  else
+  {
+    HAL_PCD_DataInStageCallback(hpcd, ep->num);
+  }
+}
+
+#if (PCD_DEFERRED_EVENTS == 1)
+/**
+  * @brief  Take the next record of the event queue.
+  * @note   The record is invisible to HAL_PCD_ProcessEvents until it is
+  *         published, so the caller may fill it in first. A context that
+  *         preempts the caller can claim and publish the following records
+  *         meanwhile; they are processed once this one is published.
+  * @param  hpcd PCD handle
+  * @param  type event type, PCD_EVENT_xxx
+  * @param  epnum endpoint number
+  * @param  ticket filled in with the ticket to publish the record with
+  * @retval record, NULL if the queue is full
+  */
+static PCD_EventTypeDef *PCD_EventClaim(PCD_HandleTypeDef *hpcd, uint8_t type, uint8_t epnum, uint32_t *ticket)
+{
+  PCD_EventQueueTypeDef *q = &hpcd->Events;
+  PCD_EventTypeDef *ev;
+  uint32_t t;
+
+  do
+  {
+    t = __LDREXW((uint32_t *)&q->head);
+    if ((t - q->tail) >= PCD_EVENT_QUEUE_SIZE)
+    {
+      __CLREX();
+      q->overflows++;
+      return NULL;
+    }
+  } while (__STREXW(t + 1U, (uint32_t *)&q->head) != 0U);
+
+  ev = &q->ev[t & (PCD_EVENT_QUEUE_SIZE - 1U)];
+  ev->type = type;
+  ev->epnum = epnum;
+  ev->gen = (type == PCD_EVENT_DATA_IN) ? hpcd->IN_ep[epnum].xfer_gen :
+            (type == PCD_EVENT_DATA_OUT) ? hpcd->OUT_ep[epnum].xfer_gen : 0U;
+  *ticket = t;
+
+  return ev;
+}
+
+/**
+  * @brief  Hand a claimed record over to HAL_PCD_ProcessEvents and pend
+  *         PendSV.
+  * @param  ev record from PCD_EventClaim
+  * @param  ticket ticket from PCD_EventClaim
+  * @retval None
+  */
+static void PCD_EventPublish(PCD_EventTypeDef *ev, uint32_t ticket)
+{
+  /* the record contents must be visible before its sequence number */
+  __DMB();
+  ev->seq = ticket + 1U;
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/**
+  * @brief  Queue an event without payload.
+  * @param  hpcd PCD handle
+  * @param  type event type, PCD_EVENT_xxx
+  * @param  epnum endpoint number
+  * @retval None
+  */
+static void PCD_QueueEvent(PCD_HandleTypeDef *hpcd, uint8_t type, uint8_t epnum)
+{
+  uint32_t ticket;
+  PCD_EventTypeDef *ev = PCD_EventClaim(hpcd, type, epnum, &ticket);
+
+  if (ev != NULL)
+  {
+    PCD_EventPublish(ev, ticket);
+  }
+}
+#endif /* PCD_DEFERRED_EVENTS */
+/**
+  * @}
+  */
+
+/** @addtogroup PCD_Exported_Functions
+  * @{
+  */
+
+/** @defgroup PCD_Exported_Functions_Group2 IO operation functions 
+ * @{
+ */    
+ 
+/**
+  * @brief  This function handles PCD interrupt request.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+USB_CCM_FUNC void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
+{
+  uint16_t istr;
+  USB_PROF_BEGIN(prof_start);
+  /* as close to the SOF as it gets, before any servicing */
+  USB_TIMESYNC_BEGIN(sof_cycles);
+
+  /* ISTR is read once: the flag bits line up with their CNTR mask bits, so
+     flags of masked interrupts are left alone */
+  istr = hpcd->Instance->ISTR & hpcd->Instance->CNTR & PCD_ISTR_IT_MASK;
+  
+  if ((istr & USB_ISTR_CTR) != 0U)
+  {
+    /* servicing of the endpoint correct transfer interrupt */
+    /* clear of the CTR flag into the sub */
+    PCD_EP_ISR_Handler(hpcd);
+  }
+
+  if ((istr & (USB_ISTR_RESET | USB_ISTR_PMAOVR | USB_ISTR_ERR | USB_ISTR_SOF | USB_ISTR_ESOF)) != 0U)
+  {
+    /* flags with nothing to order against, cleared in one write */
+    __HAL_PCD_CLEAR_FLAG(hpcd, istr & (USB_ISTR_RESET | USB_ISTR_PMAOVR | USB_ISTR_ERR |
+                                       USB_ISTR_SOF | USB_ISTR_ESOF));
+  }
+
+  if ((istr & USB_ISTR_RESET) != 0U)
+  {
+    if (hpcd->RemoteWakeup != 0U)
+    {
+      /* the host reset instead: drop the wakeup */
+      hpcd->RemoteWakeup = 0U;
+      hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_RESUME);
+      if (hpcd->RemoteWakeupEsof == 0U)
+      {
+        hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_ESOFM);
+      }
+    }
+    hpcd->IsoActive = 0U;
+    USB_TIMESYNC_RESET();
+    USB_STATS_EVENT(resets);
+    USB_TRACE_EVENT(USB_TRACE_EVT_RESET);
+    USB_ENUMBENCH_MARK(USB_ENUMBENCH_RESET);
+    PCD_EVENT(hpcd, PCD_EVENT_RESET, 0U, HAL_PCD_ResetCallback(hpcd));
+    HAL_PCD_SetAddress(hpcd, 0U);
+  }
+
+  if ((istr & USB_ISTR_PMAOVR) != 0U)
+  {
+    USB_STATS_EVENT(pma_overruns);
+  }
+  if ((istr & USB_ISTR_ERR) != 0U)
+  {
+    USB_STATS_EVENT(errors);
+  }
+
+#if defined(USB_LPMCSR_LMPEN)
+  if ((istr & USB_ISTR_L1REQ) != 0U)
+  {
+    /* the LPM token was already ACKed by the macrocell: sleep like on a
+       suspend, the resume that ends L1 raises WKUP */
+    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_L1REQ);
+    hpcd->BESL = ((uint32_t)hpcd->Instance->LPMCSR & USB_LPMCSR_BESL) >> 4;
+    hpcd->LPM_State = LPM_L1;
+    hpcd->Instance->CNTR |= USB_CNTR_FSUSP;
+    hpcd->Instance->CNTR |= USB_CNTR_LPMODE;
+
+    USB_TRACE_EVENT(USB_TRACE_EVT_L1);
+    PCD_EVENT(hpcd, PCD_EVENT_L1, 0U, HAL_PCDEx_LPM_Callback(hpcd, PCD_LPM_L1_ACTIVE));
+  }
+#endif /* USB_LPMCSR_LMPEN */
+
+  if ((istr & USB_ISTR_WKUP) != 0U)
+  {
+    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_LPMODE);
+    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_FSUSP);
+
+    USB_TRACE_EVENT(USB_TRACE_EVT_RESUME);
+#if defined(USB_LPMCSR_LMPEN)
+    if (hpcd->LPM_State == LPM_L1)
+    {
+      /* out of L1, also through a bus reset: the device was never
+         suspended, so no resume callback */
+      hpcd->LPM_State = LPM_L0;
+      PCD_EVENT(hpcd, PCD_EVENT_L0, 0U, HAL_PCDEx_LPM_Callback(hpcd, PCD_LPM_L0_ACTIVE));
+    }
+    else
+#endif /* USB_LPMCSR_LMPEN */
+    {
+      PCD_EVENT(hpcd, PCD_EVENT_RESUME, 0U, HAL_PCD_ResumeCallback(hpcd));
+    }
+
+    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_WKUP);     
+  }
+
+  if ((istr & USB_ISTR_SUSP) != 0U)
+  {
+    /* Force low-power mode in the macrocell */
+    hpcd->Instance->CNTR |= USB_CNTR_FSUSP;
+
+    /* clear of the ISTR bit must be done after setting of CNTR_FSUSP */
+    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_SUSP);
+    USB_TIMESYNC_RESET();
+    USB_STATS_EVENT(suspends);
+    USB_TRACE_EVENT(USB_TRACE_EVT_SUSPEND);
+
+    hpcd->Instance->CNTR |= USB_CNTR_LPMODE;
+    /* fresh read: a wakeup may have come in since */
+    if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_WKUP) == 0U)
+    {
+#if defined(USB_LPMCSR_LMPEN)
+      if (hpcd->LPM_State == LPM_L1)
+      {
+        /* L1 ran into a full suspend: the next WKUP is a plain resume */
+        hpcd->LPM_State = LPM_L0;
+        PCD_EVENT(hpcd, PCD_EVENT_L0, 0U, HAL_PCDEx_LPM_Callback(hpcd, PCD_LPM_L0_ACTIVE));
+      }
+#endif /* USB_LPMCSR_LMPEN */
+      PCD_EVENT(hpcd, PCD_EVENT_SUSPEND, 0U, HAL_PCD_SuspendCallback(hpcd));
+    }
+  }
+
+  if ((istr & USB_ISTR_SOF) != 0U)
+  {
+    USB_TIMESYNC_SOF(hpcd->Instance->FNR & USB_FNR_FN, sof_cycles);
+    if (hpcd->IsoActive != 0U)
+    {
+      PCD_IsoFrame(hpcd);
+    }
+    PCD_EVENT(hpcd, PCD_EVENT_SOF, 0U, HAL_PCD_SOFCallback(hpcd));
+  }
+
+  if (((istr & USB_ISTR_ESOF) != 0U) && (hpcd->RemoteWakeup != 0U))
+  {
+    PCD_RemoteWakeupTick(hpcd);
+  }
+
+  USB_PROF_END(USB_PROF_IRQ, 0U, prof_start);
+}
+
+#if (PCD_POLLED == 1)
+/**
+  * @brief  Service the device from the application loop, in place of the
+  *         USB interrupts.
+  * @note   Same context as all other calls into the PCD and the core: the
+  *         class callbacks run from here.
+  * @param  hpcd PCD handle
+  * @param  budget core cycles the call may take, see PCD_POLL_STEP_CYCLES
+  * @retval HAL_OK when all pending work was done, HAL_BUSY when endpoint
+  *         transfers were left for the next call
+  */
+HAL_StatusTypeDef HAL_PCD_Poll(PCD_HandleTypeDef *hpcd, uint32_t budget)
+{
+  hpcd->PollStart = DWT->CYCCNT;
+  hpcd->PollBudget = (budget > PCD_POLL_STEP_CYCLES) ? (budget - PCD_POLL_STEP_CYCLES) : 0U;
+
+  HAL_PCD_IRQHandler(hpcd);
+
+  return ((hpcd->Instance->ISTR & USB_ISTR_CTR) != 0U) ? HAL_BUSY : HAL_OK;
+}
+#endif /* PCD_POLLED */
+
+#if (PCD_HP_ROUTING == 1)
+/**
+  * @brief  This function handles the PCD high priority interrupt request:
+  *         the transfers of isochronous and double buffered bulk endpoints.
+  * @note   The endpoint registers are scanned directly rather than through
+  *         ISTR, whose EP_ID would name a pending control transfer first.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+USB_CCM_FUNC void HAL_PCD_HP_IRQHandler(PCD_HandleTypeDef *hpcd)
+{
+  uint16_t mask;
+  uint16_t wEPVal;
+  uint8_t pending;
+  uint8_t n;
+
+  do
+  {
+    pending = 0U;
+    for (n = 1U, mask = hpcd->HPEndpoints >> 1; mask != 0U; n++, mask >>= 1)
+    {
+      if ((mask & 1U) == 0U)
+      {
+        continue;
+      }
+      wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, n);
+      if ((wEPVal & (USB_EP_CTR_RX | USB_EP_CTR_TX)) == 0U)
+      {
+        continue;
+      }
+
+      {
+        USB_PROF_BEGIN(prof_start);
+
+        if ((wEPVal & USB_EP_CTR_RX) != 0U)
         {
-          /* TX COMPLETE */
-          HAL_PCD_DataInStageCallback(hpcd, ep->num);
+          hpcd->OUT_ep[n].isr(hpcd, &hpcd->OUT_ep[n], wEPVal);
         }
-        else
+        if ((wEPVal & USB_EP_CTR_TX) != 0U)
         {
-          HAL_PCD_EP_Transmit(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
+          hpcd->IN_ep[n].isr(hpcd, &hpcd->IN_ep[n], wEPVal);
         }
-      } 
+
+        USB_PROF_END(USB_PROF_EP_ISR, n, prof_start);
+      }
+      pending = 1U;
     }
-  }
-  return HAL_OK;
+  } while (pending != 0U);
 }
-/**
-  * @}
-  */
-
-/** @addtogroup PCD_Exported_Functions
-  * @{
-  */
+#endif /* PCD_HP_ROUTING */
 
-/** @defgroup PCD_Exported_Functions_Group2 IO operation functions 
- * @{
- */    
- 
+#if (PCD_PMA_DMA == 1)
 /**
-  * @brief  This function handles PCD interrupt request.
+  * @brief  Finish the packet copy of the PMA DMA channel: validate the IN
+  *         endpoint with the packet length, or complete the OUT packet.
+  * @note   To be called from the interrupt of the channel, at the priority
+  *         of the USB interrupt. A copy that hit a transfer error is redone
+  *         with the CPU.
   * @param  hpcd PCD handle
-  * @retval HAL status
+  * @retval None
   */
-void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
+USB_CCM_FUNC void HAL_PCD_PMADma_IRQHandler(PCD_HandleTypeDef *hpcd)
 {
-  
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_CTR))
-  {
-    /* servicing of the endpoint correct transfer interrupt */
-    /* clear of the CTR flag into the sub */
-    PCD_EP_ISR_Handler(hpcd);
-  }
+  PCD_EPTypeDef *ep;
+  uint8_t *buf = hpcd->PmaDmaBuf;
+  uint16_t addr = hpcd->PmaDmaAddr;
+  uint16_t len = hpcd->PmaDmaLen;
+  uint8_t error;
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_RESET))
+  ep = PCD_PMADmaStop(hpcd, &error);
+  if (ep == NULL)
   {
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_RESET);
-    HAL_PCD_ResetCallback(hpcd);
-    HAL_PCD_SetAddress(hpcd, 0U);
+    return;
   }
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_PMAOVR))
+  if (ep->is_in != 0U)
   {
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_PMAOVR);    
+    if (error != 0U)
+    {
+      PCD_PROF_WRITE_PMA(hpcd, ep->num, buf, addr, len);
+    }
+    PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, len);
+    PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_VALID)
   }
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_ERR))
+  else
   {
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_ERR); 
+    if (error != 0U)
+    {
+      PCD_PROF_READ_PMA(hpcd, ep->num, buf, addr, len);
+    }
+    PCD_EP_RxDone(hpcd, ep, len);
   }
+}
+#endif /* PCD_PMA_DMA */
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_WKUP))
+#if (PCD_DEFERRED_EVENTS == 1)
+/**
+  * @brief  Run the callbacks of the events queued by HAL_PCD_IRQHandler.
+  * @note   To be called from PendSV_Handler only: the queue has a single
+  *         consumer.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+void HAL_PCD_ProcessEvents(PCD_HandleTypeDef *hpcd)
+{
+  PCD_EventQueueTypeDef *q = &hpcd->Events;
+  PCD_EventTypeDef *ev;
+  uint32_t t;
+  uint8_t type;
+  uint8_t epnum;
+  uint8_t gen;
+
+  for (;;)
   {
-    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_LPMODE);
-    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_FSUSP);
+    t = q->tail;
+    ev = &q->ev[t & (PCD_EVENT_QUEUE_SIZE - 1U)];
+    if (ev->seq != (t + 1U))
+    {
+      /* empty, or the next record is still being filled in */
+      break;
+    }
+    __DMB();
 
-    HAL_PCD_ResumeCallback(hpcd);
+    type = ev->type;
+    epnum = ev->epnum;
+    gen = ev->gen;
+    if (type == PCD_EVENT_SETUP)
+    {
+      hpcd->Setup[0] = ev->setup[0];
+      hpcd->Setup[1] = ev->setup[1];
+    }
 
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_WKUP);     
-  }
+    /* release the record before the callback, which may queue more */
+    q->tail = t + 1U;
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_SUSP))
-  {
-    /* Force low-power mode in the macrocell */
-    hpcd->Instance->CNTR |= USB_CNTR_FSUSP;
+    switch (type)
+    {
+    case PCD_EVENT_SETUP:
+      HAL_PCD_SetupStageCallback(hpcd);
+      break;
 
-    /* clear of the ISTR bit must be done after setting of CNTR_FSUSP */
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_SUSP);
+    /* a completion of a transfer flushed since belongs to nobody */
+    case PCD_EVENT_DATA_OUT:
+      if (gen == hpcd->OUT_ep[epnum].xfer_gen)
+      {
+        PCD_DataOutDone(hpcd, &hpcd->OUT_ep[epnum]);
+      }
+      break;
 
-    hpcd->Instance->CNTR |= USB_CNTR_LPMODE;
-    if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_WKUP) == 0U)
-    {
+    case PCD_EVENT_DATA_IN:
+      if (gen == hpcd->IN_ep[epnum].xfer_gen)
+      {
+        PCD_DataInDone(hpcd, &hpcd->IN_ep[epnum]);
+      }
+      break;
+
+    case PCD_EVENT_RESET:
+      HAL_PCD_ResetCallback(hpcd);
+      break;
+
+    case PCD_EVENT_SUSPEND:
       HAL_PCD_SuspendCallback(hpcd);
-    }
-  }
+      break;
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_SOF))
-  {
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_SOF); 
-    HAL_PCD_SOFCallback(hpcd);
-  }
+    case PCD_EVENT_RESUME:
+      HAL_PCD_ResumeCallback(hpcd);
+      break;
 
-  if (__HAL_PCD_GET_FLAG (hpcd, USB_ISTR_ESOF))
-  {
-    /* clear ESOF flag in ISTR */
-    __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_ESOF); 
+    case PCD_EVENT_SOF:
+      HAL_PCD_SOFCallback(hpcd);
+      break;
+
+    case PCD_EVENT_ISO_IN_INCOMPLETE:
+      HAL_PCD_ISOINIncompleteCallback(hpcd, epnum);
+      break;
+
+    case PCD_EVENT_ISO_OUT_INCOMPLETE:
+      HAL_PCD_ISOOUTIncompleteCallback(hpcd, epnum);
+      break;
+
+#if defined(USB_LPMCSR_LMPEN)
+    case PCD_EVENT_L1:
+      HAL_PCDEx_LPM_Callback(hpcd, PCD_LPM_L1_ACTIVE);
+      break;
+
+    case PCD_EVENT_L0:
+      HAL_PCDEx_LPM_Callback(hpcd, PCD_LPM_L0_ACTIVE);
+      break;
+#endif /* USB_LPMCSR_LMPEN */
+
+    default:
+      break;
+    }
   }
 }
+#endif /* PCD_DEFERRED_EVENTS */
 
 /**
   * @brief  Data out stage callbacks
@@ -818,6 +1852,7 @@ HAL_StatusTypeDef HAL_PCD_DevConnect(PCD_HandleTypeDef *hpcd)
   
   /* Enabling DP Pull-Down bit to Connect internal pull-up on USB DP line */
    HAL_PCDEx_SetConnectionState(hpcd, 1U);
+  USB_ENUMBENCH_CONNECTED();
   
   __HAL_UNLOCK(hpcd); 
   return HAL_OK;
@@ -888,6 +1923,40 @@ HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint
   ep->is_in = (0x80U & ep_addr) != 0U;
   ep->maxpacket = ep_mps;
   ep->type = ep_type;
+  ep->xfer_armed = 0U;
+  ep->dbuf_held = 0U;
+  ep->rx_view_dbuf = 0U;
+  ep->xfer_cb = NULL;
+  
+  /* Interrupt service without per packet direction or buffering tests */
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    /* the hardware always runs isochronous endpoints on two buffers */
+    if (ep->doublebuffer == 0U)
+    {
+      return HAL_ERROR;
+    }
+    ep->isr = ep->is_in ? PCD_EP_IN_Iso : PCD_EP_OUT_Iso;
+  }
+  else if (ep->is_in)
+  {
+    ep->isr = (ep->doublebuffer == 0U) ? PCD_EP_IN_Sng : PCD_EP_IN_Dbl;
+  }
+  else
+  {
+    ep->isr = (ep->doublebuffer == 0U) ? PCD_EP_OUT_Sng : PCD_EP_OUT_Dbl;
+  }
+
+#if (PCD_HP_ROUTING == 1)
+  if (PCD_EP_IS_HP(ep))
+  {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    hpcd->HPEndpoints |= (uint16_t)(1U << ep->num);
+    __set_PRIMASK(primask);
+  }
+#endif /* PCD_HP_ROUTING */
   
   __HAL_LOCK(hpcd); 
 
@@ -912,7 +1981,39 @@ HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint
   
   PCD_SET_EP_ADDRESS(hpcd->Instance, ep->num, ep->num);
   
-  if (ep->doublebuffer == 0U) 
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    /* Isochronous: EP_KIND is unused, DTOG picks the buffer of the next
+       transaction and toggles on every one */
+    PCD_SET_EP_DBUF_ADDR(hpcd->Instance, ep->num, ep->pmaaddr0, ep->pmaaddr1)
+    PCD_CLEAR_RX_DTOG(hpcd->Instance, ep->num)
+    PCD_CLEAR_TX_DTOG(hpcd->Instance, ep->num)
+
+    if (ep->is_in)
+    {
+      /* both buffers empty, VALID once the first packet is given */
+      PCD_SET_EP_DBUF_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, 0U)
+      PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_DIS)
+      PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_DIS)
+    }
+    else
+    {
+      PCD_SET_EP_DBUF_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_OUT, ep->maxpacket)
+      PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_VALID)
+      PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_DIS)
+    }
+
+    {
+      /* the frame interrupt watches the endpoint, and time based classes
+         need it anyway */
+      uint32_t primask = __get_PRIMASK();
+
+      __disable_irq();
+      hpcd->Instance->CNTR |= USB_CNTR_SOFM;
+      __set_PRIMASK(primask);
+    }
+  }
+  else if (ep->doublebuffer == 0U) 
   {
     if (ep->is_in)
     {
@@ -991,9 +2092,51 @@ HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
   ep->num   = ep_addr & 0x7FU;
   
   ep->is_in = (0x80U & ep_addr) != 0U;
+  ep->isr = ep->is_in ? PCD_EP_IN_Idle : PCD_EP_OUT_Idle;
+  ep->xfer_cb = NULL;
+  ep->xfer_armed = 0U;
   
   __HAL_LOCK(hpcd); 
 
+#if (PCD_PMA_DMA == 1)
+  if (hpcd->PmaDmaEp == ep)
+  {
+    uint32_t primask = __get_PRIMASK();
+
+    /* drop the copy under way, its completion would revive the endpoint */
+    __disable_irq();
+    hpcd->PmaDmaCh->CCR = 0U;
+    hpcd->PmaDma->IFCR = DMA_IFCR_CGIF1 << (4U * (hpcd->PmaDmaChNum - 1U));
+    hpcd->PmaDmaEp = NULL;
+    __set_PRIMASK(primask);
+  }
+#endif /* PCD_PMA_DMA */
+
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    hpcd->IsoActive &= (uint16_t)~PCD_ISO_BIT(ep);
+    __set_PRIMASK(primask);
+  }
+
+#if (PCD_HP_ROUTING == 1)
+  if (PCD_EP_IS_HP(ep))
+  {
+    PCD_EPTypeDef *other = ep->is_in ? &hpcd->OUT_ep[ep->num] : &hpcd->IN_ep[ep->num];
+    uint32_t primask = __get_PRIMASK();
+
+    /* the other direction of the number may still be open on HP */
+    __disable_irq();
+    if ((other->isr == PCD_EP_IN_Idle) || (other->isr == PCD_EP_OUT_Idle) || !PCD_EP_IS_HP(other))
+    {
+      hpcd->HPEndpoints &= (uint16_t)~(1U << ep->num);
+    }
+    __set_PRIMASK(primask);
+  }
+#endif /* PCD_HP_ROUTING */
+
   if (ep->doublebuffer == 0U) 
   {
     if (ep->is_in)
@@ -1043,13 +2186,16 @@ HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
 
 /**
   * @brief  Receive an amount of data  
+  * @note   With a NULL pBuf the transfer is limited to one packet, which is
+  *         left in packet memory: read it with HAL_PCDEx_EP_ReadRxView and
+  *         call HAL_PCD_EP_Receive again to release it.
   * @param  hpcd PCD handle
   * @param  ep_addr endpoint address
-  * @param  pBuf pointer to the reception buffer   
+  * @param  pBuf pointer to the reception buffer, or NULL for a zero-copy transfer
   * @param  len amount of data to be received
   * @retval HAL status
   */
-HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len)
+USB_CCM_FUNC HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len)
 {
   
  PCD_EPTypeDef *ep;
@@ -1063,31 +2209,24 @@ HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, u
   ep->is_in = 0U;
   ep->num = ep_addr & 0x7FU;
 
-  /* Multi packet transfer*/
-  if (ep->xfer_len > ep->maxpacket)
-  {
-    len=ep->maxpacket;
-    ep->xfer_len-=len; 
-  }
-  else
+  if (((pBuf == NULL) || (ep->type == PCD_EP_TYPE_ISOC)) && (ep->xfer_len > ep->maxpacket))
   {
-    len=ep->xfer_len;
-    ep->xfer_len =0U;
+    ep->xfer_len = ep->maxpacket;
   }
-  
-  /* configure and validate Rx endpoint */
-  if (ep->doublebuffer == 0U) 
+  ep->xfer_size = ep->xfer_len;
+
+  if (ep->type == PCD_EP_TYPE_ISOC)
   {
-    /*Set RX buffer count*/
-    PCD_SET_EP_RX_CNT(hpcd->Instance, ep->num, len)
+    /* One packet per transfer. The endpoint stays VALID: the next packet
+       lands in whichever buffer is due, there is nothing to arm */
+    ep->xfer_len = 0U;
+    ep->xfer_armed = 1U;
+    PCD_IsoStart(hpcd, ep);
+    return HAL_OK;
   }
-  else
-  {
-    /*Set the Double buffer counter*/
-    PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, ep->is_in, len)
-  } 
-  
-  PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_VALID)
+
+  USB_STATS_OUT_ARMED(ep->num, PCD_FRAME_NUMBER(hpcd));
+  PCD_EP_RxArm(hpcd, ep);
 
   return HAL_OK;
 }
@@ -1110,20 +2249,75 @@ uint16_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
   * @param  len amount of data to be sent
   * @retval HAL status
   */
-HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const uint8_t *pBuf, uint32_t len)
+USB_CCM_FUNC HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const uint8_t *pBuf, uint32_t len)
 {
   PCD_EPTypeDef *ep;
-  uint16_t pmabuffer = 0U;
     
   ep = &hpcd->IN_ep[ep_addr & 0x7F];
   
   /*setup and start the Xfer */
   ep->xfer_buff = (uint8_t *) pBuf;  
+  ep->xfer_iov = NULL;
+  ep->xfer_len = len;
+  ep->is_in = 1U;
+  ep->num = ep_addr & 0x7FU;
+
+  PCD_EP_TxStart(hpcd, ep);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Send consecutive segments as one transfer, each packet filled
+  *         straight from them with no assembly copy
+  * @note   The segment array and the data must stay untouched until the
+  *         Data IN callback. Isochronous endpoints send the first packet
+  *         only, as with HAL_PCD_EP_Transmit.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  iov segments
+  * @param  iovcnt number of segments
+  * @retval HAL status
+  */
+USB_CCM_FUNC HAL_StatusTypeDef HAL_PCD_EP_TransmitVec(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const PCD_IovTypeDef *iov, uint32_t iovcnt)
+{
+  PCD_EPTypeDef *ep;
+  uint32_t len = 0U;
+  uint32_t i;
+
+  ep = &hpcd->IN_ep[ep_addr & 0x7F];
+
+  for (i = 0U; i < iovcnt; i++)
+  {
+    len += iov[i].len;
+  }
+
+  /*setup and start the Xfer */
+  ep->xfer_buff = NULL;
+  ep->xfer_iov = (len != 0U) ? iov : NULL;
+  ep->xfer_iov_off = 0U;
   ep->xfer_len = len;
-  ep->xfer_count = 0U;
   ep->is_in = 1U;
   ep->num = ep_addr & 0x7FU;
 
+  PCD_EP_TxStart(hpcd, ep);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Load the next packet of an IN transfer and validate the endpoint
+  * @param  hpcd PCD handle
+  * @param  ep endpoint, xfer_len bytes left to send
+  * @retval None
+  */
+static USB_CCM_FUNC void PCD_EP_TxStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint16_t pmabuffer = 0U;
+  uint32_t len;
+
+  ep->xfer_count = 0U;
+
   /*Multi packet transfer*/
   if (ep->xfer_len > ep->maxpacket)
   {
@@ -1136,10 +2330,37 @@ HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
     ep->xfer_len =0U;
   }
   
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    /* One packet per transfer, into the buffer the USB does not send next:
+       it goes out one frame later, and a write that runs late cannot tear
+       the packet on the bus */
+    ep->xfer_len = 0U;
+    if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
+    {
+      pmabuffer = ep->pmaaddr0;
+      PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, len)
+    }
+    else
+    {
+      pmabuffer = ep->pmaaddr1;
+      PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, len)
+    }
+    PCD_PROF_WRITE_EP(hpcd, ep, pmabuffer, len);
+    PCD_IsoStart(hpcd, ep);
+  }
   /* configure and validate Tx endpoint */
-  if (ep->doublebuffer == 0U) 
+  else if (ep->doublebuffer == 0U) 
   {
-    PCD_WritePMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, len);
+#if (PCD_PMA_DMA == 1)
+    if ((ep->xfer_iov == NULL) &&
+        PCD_PMADmaStart(hpcd, ep, ep->xfer_buff, ep->pmaadress, (uint16_t)len))
+    {
+      /* HAL_PCD_PMADma_IRQHandler sets the count and validates */
+      return;
+    }
+#endif /* PCD_PMA_DMA */
+    PCD_PROF_WRITE_EP(hpcd, ep, ep->pmaadress, len);
     PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, len);
   }
   else
@@ -1148,18 +2369,18 @@ HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
     if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num)& USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
     {
       pmabuffer = ep->pmaaddr1;
+      PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, ep->is_in, len)
     }
     else
     {
       pmabuffer = ep->pmaaddr0;
+      PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, ep->is_in, len)
     }
-    PCD_WritePMA(hpcd->Instance, ep->xfer_buff, pmabuffer, len);
+    PCD_PROF_WRITE_EP(hpcd, ep, pmabuffer, len);
     PCD_FreeUserBuffer(hpcd->Instance, ep->num, ep->is_in)
   }
 
   PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_VALID)
-
-  return HAL_OK;
 }
 
 /**
@@ -1186,6 +2407,7 @@ HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
   ep->is_stall = 1U;
   ep->num   = ep_addr & 0x7FU;
   ep->is_in = ((ep_addr & 0x80U) == 0x80U);
+  USB_CAP_STALL_EP(ep);
   
   if (ep->num == 0U)
   {
@@ -1249,13 +2471,83 @@ HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
 }
 
 /**
-  * @brief  Flush an endpoint
+  * @brief  Flush an endpoint: drop the transfer under way and NAK the host
+  *         until the next HAL_PCD_EP_Transmit or HAL_PCD_EP_Receive. The
+  *         data toggle is kept, the host sees no gap in the sequence.
+  * @note   A packet the host already took is not called back, nor is the
+  *         completion of the transfer if it is still queued for
+  *         HAL_PCD_ProcessEvents. An OUT packet held in packet memory
+  *         (zero-copy or double buffered) is released by the next
+  *         HAL_PCD_EP_Receive, as usual.
   * @param  hpcd PCD handle
   * @param  ep_addr endpoint address
   * @retval HAL status
   */
 HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
-{ 
+{
+  PCD_EPTypeDef *ep;
+  uint32_t primask = __get_PRIMASK();
+  uint16_t wEPVal;
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7F];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr & 0x7F];
+  }
+
+  /* the completion of the transfer must not run half way through */
+  __disable_irq();
+
+#if (PCD_PMA_DMA == 1)
+  if (hpcd->PmaDmaEp == ep)
+  {
+    /* the copy would validate the endpoint on completion */
+    hpcd->PmaDmaCh->CCR = 0U;
+    hpcd->PmaDma->IFCR = DMA_IFCR_CGIF1 << (4U * (hpcd->PmaDmaChNum - 1U));
+    hpcd->PmaDmaEp = NULL;
+  }
+#endif /* PCD_PMA_DMA */
+
+  if (ep->type != PCD_EP_TYPE_ISOC)
+  {
+    if ((ep_addr & 0x80U) == 0x80U)
+    {
+      PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_NAK)
+      if (ep->doublebuffer == 0U)
+      {
+        PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, 0U);
+      }
+      else
+      {
+        wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, ep->num);
+        if (((wEPVal & USB_EP_DTOG_TX) != 0U) != ((wEPVal & USB_EP_DTOG_RX) != 0U))
+        {
+          /* take back the buffer handed to the USB and not sent */
+          PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_IN)
+        }
+        PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, 0U)
+        PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, 0U)
+      }
+      PCD_CLEAR_TX_EP_CTR(hpcd->Instance, ep->num);
+      ep->xfer_iov = NULL;
+    }
+    else
+    {
+      PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_NAK)
+      PCD_CLEAR_RX_EP_CTR(hpcd->Instance, ep->num);
+      ep->xfer_armed = 0U;
+    }
+  }
+
+  ep->xfer_len = 0U;
+  ep->xfer_count = 0U;
+  ep->xfer_gen++;
+
+  __set_PRIMASK(primask);
+
   return HAL_OK;
 }
 
@@ -1281,6 +2573,60 @@ HAL_StatusTypeDef HAL_PCD_DeActivateRemoteWakeup(PCD_HandleTypeDef *hpcd)
   return HAL_OK;
 }
 
+/**
+  * @brief  Signal remote wakeup without blocking: the macrocell leaves
+  *         suspend, waits PCD_REMOTE_WAKEUP_HOLDOFF ms, then drives resume
+  *         for PCD_REMOTE_WAKEUP_MS ms.
+  * @note   Timed with the ESOF interrupt, which keeps coming every 1 ms
+  *         while no SOF is received. HAL_PCD_ResumeCallback is called at
+  *         the end of the signalling.
+  *         Out of L1 the macrocell drives the 50 us L1 resume itself,
+  *         if the host allowed it in the LPM token.
+  * @param  hpcd PCD handle
+  * @retval HAL_BUSY if a remote wakeup is already under way, HAL_ERROR if
+  *         the host did not allow one from L1
+  */
+HAL_StatusTypeDef HAL_PCD_StartRemoteWakeup(PCD_HandleTypeDef *hpcd)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+#if defined(USB_LPMCSR_LMPEN)
+  if (hpcd->LPM_State == LPM_L1)
+  {
+    if ((hpcd->Instance->LPMCSR & USB_LPMCSR_REMWAKE) == 0U)
+    {
+      __set_PRIMASK(primask);
+      return HAL_ERROR;
+    }
+    hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_LPMODE);
+    hpcd->Instance->CNTR |= USB_CNTR_L1RESUME;
+    __set_PRIMASK(primask);
+    return HAL_OK;
+  }
+#endif /* USB_LPMCSR_LMPEN */
+  if (hpcd->RemoteWakeup != 0U)
+  {
+    __set_PRIMASK(primask);
+    return HAL_BUSY;
+  }
+
+  hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_LPMODE);
+  hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_FSUSP);
+
+  hpcd->RemoteWakeupEsof = ((hpcd->Instance->CNTR & USB_CNTR_ESOFM) != 0U) ? 1U : 0U;
+  /* stale ESOF from before the suspend would cut the holdoff short */
+  __HAL_PCD_CLEAR_FLAG(hpcd, USB_ISTR_ESOF);
+  hpcd->Instance->CNTR |= USB_CNTR_ESOFM;
+  hpcd->RemoteWakeup = PCD_REMOTE_WAKEUP_HOLDOFF + PCD_REMOTE_WAKEUP_MS;
+#if (PCD_REMOTE_WAKEUP_HOLDOFF == 0U)
+  hpcd->Instance->CNTR |= USB_CNTR_RESUME;
+#endif
+  __set_PRIMASK(primask);
+
+  return HAL_OK;
+}
+
 /**
   * @}
   */
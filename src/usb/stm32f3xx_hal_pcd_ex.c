@@ -39,6 +39,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f3xx_hal.h"
+#include "usb_ccm.h"
 
 #ifdef HAL_PCD_MODULE_ENABLED
 
@@ -58,9 +59,32 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#if defined(STM32F303xC)                         || \
+    defined(STM32F303x8) || defined(STM32F334x8) || \
+    defined(STM32F301x8)                         || \
+    defined(STM32F373xC) || defined(STM32F378xx) || \
+    defined(STM32F302xC)
+/* 2x16 access scheme: every PMA halfword occupies the low half of a 32-bit
+   APB slot, so consecutive halfwords are two uint16_t locations apart */
+#define PMA_ACCESS_STRIDE               2U
+#endif /* STM32F303xC                || */
+       /* STM32F303x8 || STM32F334x8 || */
+       /* STM32F301x8                || */
+       /* STM32F373xC || STM32F378xx    */
+
+#if defined(STM32F302xE) || defined(STM32F303xE) || \
+    defined(STM32F302x8)
+/* 1x16 access scheme: PMA halfwords are contiguous */
+#define PMA_ACCESS_STRIDE               1U
+#endif /* STM32F302xE || STM32F303xE || */
+       /* STM32F302x8                   */
+
+#define PCD_PMA_PTR(USBx, wPMABufAddr)  ((__IO uint16_t *)((uint32_t)((uint32_t)(wPMABufAddr) * PMA_ACCESS_STRIDE + \
+                                                                     (uint32_t)(USBx) + 0x400U)))
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
+static HAL_StatusTypeDef PCDEx_UpdateInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it, uint32_t value);
 /* Exported functions ---------------------------------------------------------*/
 
 /** @defgroup PCDEx_Exported_Functions PCDEx Exported Functions
@@ -76,6 +100,9 @@
  ===============================================================================
     [..]  This section provides functions allowing to:
       (+) Update PMA configuration
+      (+) Read a packet left in PMA by a zero-copy OUT transfer
+      (+) Fill an IN packet in PMA in place and send it
+      (+) Enable or disable the optional interrupts
 
 @endverbatim
   * @{
@@ -135,6 +162,380 @@ HAL_StatusTypeDef  HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
   
   return HAL_OK; 
 }
+
+/**
+  * @brief  Copy part of the packet left in PMA by a zero-copy OUT transfer
+  * @note   Valid from the data OUT stage callback of a HAL_PCD_EP_Receive
+  *         call made with a NULL buffer, until the endpoint is re-armed.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to copy
+  * @param  pBuf pointer to user memory area
+  * @param  len number of bytes to copy
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxView(PCD_HandleTypeDef *hpcd,
+                                          uint8_t ep_addr,
+                                          uint16_t offset,
+                                          uint8_t *pBuf,
+                                          uint16_t len)
+{
+  PCD_EPTypeDef *ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+  uint16_t pmabuffer;
+  uint8_t pair[2];
+
+  if (((uint32_t)offset + len) > ep->xfer_count)
+  {
+    return HAL_ERROR;
+  }
+
+  pmabuffer = ep->rx_view + offset;
+
+  /* PMA is only halfword addressable: fetch an odd leading byte on its own */
+  if (((pmabuffer & 0x1U) != 0U) && (len != 0U))
+  {
+    PCD_ReadPMA(hpcd->Instance, pair, pmabuffer - 1U, 2U);
+    *pBuf++ = pair[1];
+    pmabuffer++;
+    len--;
+  }
+
+  if (len != 0U)
+  {
+    PCD_ReadPMA(hpcd->Instance, pBuf, pmabuffer, len);
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Convert little endian 16-bit samples of the packet left in PMA by
+  *         a zero-copy OUT transfer straight into a q15 block
+  * @note   Same validity as HAL_PCDEx_EP_ReadRxView. Each PMA halfword is
+  *         one sample, so the copy and the scaling are a single pass.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to convert, must be even
+  * @param  pDst q15 destination block
+  * @param  count number of samples
+  * @param  gain q15 gain, 32768 is unity, from -65535 to 65535. The
+  *         result is rounded and saturated.
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamples(PCD_HandleTypeDef *hpcd,
+                                             uint8_t ep_addr,
+                                             uint16_t offset,
+                                             int16_t *pDst,
+                                             uint16_t count,
+                                             int32_t gain)
+{
+  PCD_EPTypeDef *ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+
+  if (((offset & 0x1U) != 0U) ||
+      (((uint32_t)offset + 2U * (uint32_t)count) > ep->xfer_count))
+  {
+    return HAL_ERROR;
+  }
+
+  PCD_ReadPMASamples(hpcd->Instance, pDst, ep->rx_view + offset, count, gain);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Convert little endian 16-bit samples of the packet left in PMA by
+  *         a zero-copy OUT transfer straight into a float block
+  * @note   Same validity as HAL_PCDEx_EP_ReadRxView.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to convert, must be even
+  * @param  pDst float destination block
+  * @param  count number of samples
+  * @param  scale factor applied to every sample, 1.0f / 32768 gives the
+  *         q15 value
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamplesF32(PCD_HandleTypeDef *hpcd,
+                                                uint8_t ep_addr,
+                                                uint16_t offset,
+                                                float *pDst,
+                                                uint16_t count,
+                                                float scale)
+{
+  PCD_EPTypeDef *ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+
+  if (((offset & 0x1U) != 0U) ||
+      (((uint32_t)offset + 2U * (uint32_t)count) > ep->xfer_count))
+  {
+    return HAL_ERROR;
+  }
+
+  PCD_ReadPMASamplesF32(hpcd->Instance, pDst, ep->rx_view + offset, count, scale);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Reserve the packet buffer of an idle IN endpoint, to be filled in
+  *         place through a writer instead of from a RAM buffer
+  * @note   Bulk and interrupt endpoints. On a double buffered endpoint this
+  *         is the buffer HAL_PCD_EP_Transmit would load next. Nothing is
+  *         sent until HAL_PCDEx_EP_TxCommit; the caller must keep other
+  *         transfers off the endpoint meanwhile.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  w writer, set up for one packet of the endpoint
+  * @retval HAL_BUSY while a packet is waiting for the host
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_TxReserve(PCD_HandleTypeDef *hpcd,
+                                         uint8_t ep_addr,
+                                         PCD_PMAWriterTypeDef *w)
+{
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  uint16_t wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, ep->num);
+  uint16_t pmabuffer;
+
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    return HAL_ERROR;
+  }
+
+  if (ep->doublebuffer == 0U)
+  {
+    if ((wEPVal & USB_EPTX_STAT) == USB_EP_TX_VALID)
+    {
+      return HAL_BUSY;
+    }
+    pmabuffer = ep->pmaadress;
+  }
+  else
+  {
+    /* SW_BUF (DTOG_RX) ahead of DTOG_TX: a buffer is still handed over */
+    if (((wEPVal & USB_EP_DTOG_TX) != 0U) != ((wEPVal & USB_EP_DTOG_RX) != 0U))
+    {
+      return HAL_BUSY;
+    }
+    pmabuffer = ((wEPVal & USB_EP_DTOG_TX) != 0U) ? ep->pmaaddr1 : ep->pmaaddr0;
+  }
+
+#if (PCD_PMA_DMA == 1)
+  if (hpcd->PmaDmaEp == ep)
+  {
+    return HAL_BUSY;
+  }
+#endif /* PCD_PMA_DMA */
+
+  w->ptr = PCD_PMA_PTR(hpcd->Instance, pmabuffer);
+  w->stride = PMA_ACCESS_STRIDE;
+  w->count = 0U;
+  w->size = (uint16_t)ep->maxpacket;
+  w->pending = 0U;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Send the packet filled through the writer of
+  *         HAL_PCDEx_EP_TxReserve, as a one packet transfer: set its count
+  *         and validate the endpoint. The Data IN callback follows as for
+  *         HAL_PCD_EP_Transmit.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  w writer of the reservation
+  * @retval HAL_ERROR if more than the packet was written, nothing sent
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_TxCommit(PCD_HandleTypeDef *hpcd,
+                                        uint8_t ep_addr,
+                                        PCD_PMAWriterTypeDef *w)
+{
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  uint16_t len = w->count;
+
+  if (len > w->size)
+  {
+    return HAL_ERROR;
+  }
+
+  if (w->pending != 0U)
+  {
+    *w->ptr = (uint16_t)(w->pending & 0xFFU);
+    w->pending = 0U;
+  }
+
+  ep->xfer_buff = NULL;
+  ep->xfer_iov = NULL;
+  ep->xfer_len = 0U;
+  ep->xfer_count = 0U;
+
+  if (ep->doublebuffer == 0U)
+  {
+    PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, len);
+  }
+  else
+  {
+    if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_TX) == USB_EP_DTOG_TX)
+    {
+      PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, len)
+    }
+    else
+    {
+      PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, PCD_EP_DBUF_IN, len)
+    }
+    PCD_FreeUserBuffer(hpcd->Instance, ep->num, PCD_EP_DBUF_IN)
+  }
+
+  PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_VALID)
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Route the transfer completions of an endpoint straight to a
+  *         handler instead of HAL_PCD_DataOutStageCallback and
+  *         HAL_PCD_DataInStageCallback.
+  * @note   Must be called after HAL_PCD_EP_Open, which clears the handler.
+  *         The handler gets the pData member of the PCD handle and the
+  *         endpoint number, from interrupt context.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  callback completion handler, NULL to restore the callbacks
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_SetCallback(PCD_HandleTypeDef *hpcd,
+                                           uint8_t ep_addr,
+                                           PCD_EPCallbackTypeDef callback)
+{
+  PCD_EPTypeDef *ep;
+
+  if ((ep_addr & 0x7FU) == 0U)
+  {
+    /* the control endpoint always goes through the stack */
+    return HAL_ERROR;
+  }
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr];
+  }
+
+  ep->xfer_cb = callback;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Enable optional PCD interrupts at run time
+  * @note   Without PCD_IT_SOF HAL_PCD_SOFCallback is never called: classes
+  *         that count frames (USBD_CDC_TX_FLUSH_FRAMES, USBD_CDC_TX_SCHED) need it.
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to enable
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EnableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it)
+{
+  return PCDEx_UpdateInterrupts(hpcd, it, it);
+}
+
+/**
+  * @brief  Disable optional PCD interrupts at run time
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to disable
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_DisableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it)
+{
+  return PCDEx_UpdateInterrupts(hpcd, it, 0U);
+}
+
+#if (PCD_PMA_DMA == 1)
+/**
+  * @brief  Give the PCD a DMA channel for its packet copies, see
+  *         PCD_PMA_DMA
+  * @note   The DMA clock must be on. Enable the channel interrupt at the
+  *         priority of the USB interrupt and call HAL_PCD_PMADma_IRQHandler
+  *         from it.
+  * @param  hpcd PCD handle
+  * @param  dma DMA controller, DMA1 or DMA2
+  * @param  channel channel of that controller, NULL to go back to CPU copies
+  * @param  chnum number of the channel, 1 to 7
+  * @retval HAL status, HAL_BUSY while a copy is under way
+  */
+HAL_StatusTypeDef HAL_PCDEx_SetPMADma(PCD_HandleTypeDef *hpcd,
+                                      DMA_TypeDef *dma,
+                                      DMA_Channel_TypeDef *channel,
+                                      uint8_t chnum)
+{
+  if ((channel != NULL) && ((dma == NULL) || (chnum < 1U) || (chnum > 7U)))
+  {
+    return HAL_ERROR;
+  }
+  if (hpcd->PmaDmaEp != NULL)
+  {
+    return HAL_BUSY;
+  }
+
+  hpcd->PmaDmaCh = NULL;
+  if (channel != NULL)
+  {
+    channel->CCR = 0U;
+    hpcd->PmaDma = dma;
+    hpcd->PmaDmaChNum = chnum;
+  }
+  hpcd->PmaDmaCh = channel;
+
+  return HAL_OK;
+}
+#endif /* PCD_PMA_DMA */
+
+#if defined(USB_LPMCSR_LMPEN)
+/**
+  * @brief  Acknowledge LPM tokens, so the host may put the link in L1
+  * @note   The device descriptor must report bcdUSB 0x0201 and the BOS
+  *         descriptor the LPM capability, or the host never asks.
+  *         HAL_PCD_Init calls it when Init.lpm_enable is ENABLE.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_ActivateLPM(PCD_HandleTypeDef *hpcd)
+{
+  uint32_t primask;
+
+  hpcd->lpm_active = 1U;
+  hpcd->LPM_State = LPM_L0;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hpcd->Instance->LPMCSR |= USB_LPMCSR_LMPEN | USB_LPMCSR_LPMACK;
+  hpcd->Instance->CNTR |= USB_CNTR_L1REQM;
+  __set_PRIMASK(primask);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  NYET the LPM tokens again: the link stays in L0
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_DeActivateLPM(PCD_HandleTypeDef *hpcd)
+{
+  uint32_t primask;
+
+  hpcd->lpm_active = 0U;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hpcd->Instance->LPMCSR &= (uint16_t) ~(USB_LPMCSR_LMPEN | USB_LPMCSR_LPMACK);
+  hpcd->Instance->CNTR &= (uint16_t) ~(USB_CNTR_L1REQM);
+  __set_PRIMASK(primask);
+
+  return HAL_OK;
+}
+#endif /* USB_LPMCSR_LMPEN */
 /**
   * @}
   */ 
@@ -146,133 +547,430 @@ HAL_StatusTypeDef  HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
 /** @defgroup PCDEx_Private_Functions PCD Extended Private Functions
   * @{
   */
-#if defined(STM32F303xC)                         || \
-    defined(STM32F303x8) || defined(STM32F334x8) || \
-    defined(STM32F301x8)                         || \
-    defined(STM32F373xC) || defined(STM32F378xx) || \
-    defined(STM32F302xC)
-     
+/**
+  * @brief  Set the CNTR bits of it to the matching bits of value
+  * @note   The interrupt handler writes CNTR too, hence the critical section.
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to change
+  * @param  value new state of those flags
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef PCDEx_UpdateInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it, uint32_t value)
+{
+  uint32_t primask;
+
+  if ((it & ~PCD_IT_ALL) != 0U)
+  {
+    return HAL_ERROR;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hpcd->Instance->CNTR = (uint16_t)((hpcd->Instance->CNTR & ~it) | (value & it));
+  __set_PRIMASK(primask);
+
+  return HAL_OK;
+}
+
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @note  Word and halfword aligned user buffers are fetched with 32-bit and
+  *        16-bit loads, four PMA halfwords per loop iteration. Unaligned
+  *        buffers fall back to byte loads. The PMA itself is always written
+  *        with 16-bit stores, as required by both access schemes.
   * @param   USBx: USB peripheral instance register address.
   * @param   pbUsrBuf: pointer to user memory area.
   * @param   wPMABufAddr: address into PMA.
   * @param   wNBytes: no. of bytes to be copied.
   * @retval None
   */
-void PCD_WritePMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+USB_CCM_FUNC void PCD_WritePMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n =  ((uint32_t)((uint32_t)wNBytes + 1U)) >> 1U;
-  
-  uint32_t i, temp1, temp2;
-  uint16_t *pdwVal;
-  pdwVal = (uint16_t *)((uint32_t)(wPMABufAddr * 2 + (uint32_t)USBx + 0x400U));
-  
-  for (i = n; i != 0; i--)
+  uint32_t n = (uint32_t)wNBytes >> 1U;
+  uint32_t temp;
+  __IO uint16_t *pdwVal = PCD_PMA_PTR(USBx, wPMABufAddr);
+
+  if (((uint32_t)pbUsrBuf & 0x3U) == 0U)
+  {
+    uint32_t *pwUsrBuf = (uint32_t *)(void *)pbUsrBuf;
+
+    for (; n >= 4U; n -= 4U)
+    {
+      temp = pwUsrBuf[0];
+      pdwVal[0U * PMA_ACCESS_STRIDE] = (uint16_t)temp;
+      pdwVal[1U * PMA_ACCESS_STRIDE] = (uint16_t)(temp >> 16U);
+      temp = pwUsrBuf[1];
+      pdwVal[2U * PMA_ACCESS_STRIDE] = (uint16_t)temp;
+      pdwVal[3U * PMA_ACCESS_STRIDE] = (uint16_t)(temp >> 16U);
+      pwUsrBuf += 2U;
+      pdwVal += 4U * PMA_ACCESS_STRIDE;
+    }
+    pbUsrBuf = (uint8_t *)pwUsrBuf;
+  }
+  else if (((uint32_t)pbUsrBuf & 0x1U) == 0U)
   {
-    temp1 = (uint16_t) * pbUsrBuf;
-    pbUsrBuf++;
-    temp2 = temp1 | ((uint16_t)((uint16_t)  * pbUsrBuf << 8U)) ;
-    *pdwVal++ = temp2;
-    pdwVal++;
-    pbUsrBuf++;
+    uint16_t *phUsrBuf = (uint16_t *)(void *)pbUsrBuf;
+
+    for (; n >= 4U; n -= 4U)
+    {
+      pdwVal[0U * PMA_ACCESS_STRIDE] = phUsrBuf[0];
+      pdwVal[1U * PMA_ACCESS_STRIDE] = phUsrBuf[1];
+      pdwVal[2U * PMA_ACCESS_STRIDE] = phUsrBuf[2];
+      pdwVal[3U * PMA_ACCESS_STRIDE] = phUsrBuf[3];
+      phUsrBuf += 4U;
+      pdwVal += 4U * PMA_ACCESS_STRIDE;
+    }
+    pbUsrBuf = (uint8_t *)phUsrBuf;
+  }
+  else
+  {
+    for (; n >= 4U; n -= 4U)
+    {
+      pdwVal[0U * PMA_ACCESS_STRIDE] = (uint16_t)(pbUsrBuf[0] | ((uint16_t)pbUsrBuf[1] << 8U));
+      pdwVal[1U * PMA_ACCESS_STRIDE] = (uint16_t)(pbUsrBuf[2] | ((uint16_t)pbUsrBuf[3] << 8U));
+      pdwVal[2U * PMA_ACCESS_STRIDE] = (uint16_t)(pbUsrBuf[4] | ((uint16_t)pbUsrBuf[5] << 8U));
+      pdwVal[3U * PMA_ACCESS_STRIDE] = (uint16_t)(pbUsrBuf[6] | ((uint16_t)pbUsrBuf[7] << 8U));
+      pbUsrBuf += 8U;
+      pdwVal += 4U * PMA_ACCESS_STRIDE;
+    }
+  }
+
+  /* Remaining halfwords */
+  for (; n != 0U; n--)
+  {
+    *pdwVal = (uint16_t)(pbUsrBuf[0] | ((uint16_t)pbUsrBuf[1] << 8U));
+    pbUsrBuf += 2U;
+    pdwVal += PMA_ACCESS_STRIDE;
+  }
+
+  /* Odd trailing byte: do not read past the end of the user buffer */
+  if ((wNBytes & 0x1U) != 0U)
+  {
+    *pdwVal = (uint16_t)pbUsrBuf[0];
   }
 }
 
 /**
-  * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @brief Copy consecutive segments from user memory area to packet memory
+  *        area (PMA)
+  * @note  Each run inside a segment goes through PCD_WritePMA. A segment
+  *        ending on an odd byte shares its last PMA halfword with the first
+  *        byte of the next segment, which is written here. Empty segments
+  *        are skipped.
+  * @param   USBx: USB peripheral instance register address.
+  * @param   ppIov: segment to start in, updated to the one to continue in
+  * @param   pOffset: offset in *ppIov, updated
+  * @param   wPMABufAddr: address into PMA, even.
+  * @param   wNBytes: no. of bytes to be copied, at most what the segments
+  *          hold from the start position.
+  * @retval None
+  */
+USB_CCM_FUNC void PCD_WritePMAVec(USB_TypeDef  *USBx, const PCD_IovTypeDef **ppIov, uint32_t *pOffset, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+  const PCD_IovTypeDef *iov = *ppIov;
+  uint32_t off = *pOffset;
+  uint32_t n;
+  uint16_t last;
+
+  while (wNBytes != 0U)
+  {
+    if (off == iov->len)
+    {
+      iov++;
+      off = 0U;
+      continue;
+    }
+
+    n = iov->len - off;
+    if (n > wNBytes)
+    {
+      n = wNBytes;
+    }
+    if (((n & 0x1U) == 0U) || (n == wNBytes))
+    {
+      PCD_WritePMA(USBx, (uint8_t *)iov->buf + off, wPMABufAddr, (uint16_t)n);
+      off += n;
+      wPMABufAddr += (uint16_t)n;
+      wNBytes -= (uint16_t)n;
+    }
+    else
+    {
+      /* Even part first, then the halfword across the boundary */
+      n--;
+      PCD_WritePMA(USBx, (uint8_t *)iov->buf + off, wPMABufAddr, (uint16_t)n);
+      wPMABufAddr += (uint16_t)n;
+      wNBytes -= (uint16_t)n;
+      last = iov->buf[off + n];
+
+      do
+      {
+        iov++;
+      } while (iov->len == 0U);
+
+      *PCD_PMA_PTR(USBx, wPMABufAddr) = (uint16_t)(last | ((uint16_t)iov->buf[0] << 8U));
+      off = 1U;
+      wPMABufAddr += 2U;
+      wNBytes -= 2U;
+    }
+  }
+
+  *ppIov = iov;
+  *pOffset = off;
+}
+
+/**
+  * @brief Copy a buffer from packet memory area (PMA) to user memory area
+  * @note  Word and halfword aligned user buffers are filled with 32-bit and
+  *        16-bit stores, four PMA halfwords per loop iteration. Unaligned
+  *        buffers fall back to byte stores.
   * @param   USBx: USB peripheral instance register address.
   * @param   pbUsrBuf: pointer to user memory area.
   * @param   wPMABufAddr: address into PMA.
   * @param   wNBytes: no. of bytes to be copied.
   * @retval None
   */
-void PCD_ReadPMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+USB_CCM_FUNC void PCD_ReadPMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
   uint32_t n = (uint32_t)wNBytes >> 1U;
-  uint32_t i;
-  uint16_t *pdwVal;
   uint32_t temp;
-  pdwVal = (uint16_t *)((uint32_t)(wPMABufAddr * 2 + (uint32_t)USBx + 0x400U));
-  
-  for (i = n; i != 0U; i--)
+  __IO uint16_t *pdwVal = PCD_PMA_PTR(USBx, wPMABufAddr);
+
+  if (((uint32_t)pbUsrBuf & 0x3U) == 0U)
+  {
+    uint32_t *pwUsrBuf = (uint32_t *)(void *)pbUsrBuf;
+
+    for (; n >= 4U; n -= 4U)
+    {
+      temp  = pdwVal[0U * PMA_ACCESS_STRIDE];
+      temp |= (uint32_t)pdwVal[1U * PMA_ACCESS_STRIDE] << 16U;
+      pwUsrBuf[0] = temp;
+      temp  = pdwVal[2U * PMA_ACCESS_STRIDE];
+      temp |= (uint32_t)pdwVal[3U * PMA_ACCESS_STRIDE] << 16U;
+      pwUsrBuf[1] = temp;
+      pwUsrBuf += 2U;
+      pdwVal += 4U * PMA_ACCESS_STRIDE;
+    }
+    pbUsrBuf = (uint8_t *)pwUsrBuf;
+  }
+  else if (((uint32_t)pbUsrBuf & 0x1U) == 0U)
+  {
+    uint16_t *phUsrBuf = (uint16_t *)(void *)pbUsrBuf;
+
+    for (; n >= 4U; n -= 4U)
+    {
+      phUsrBuf[0] = pdwVal[0U * PMA_ACCESS_STRIDE];
+      phUsrBuf[1] = pdwVal[1U * PMA_ACCESS_STRIDE];
+      phUsrBuf[2] = pdwVal[2U * PMA_ACCESS_STRIDE];
+      phUsrBuf[3] = pdwVal[3U * PMA_ACCESS_STRIDE];
+      phUsrBuf += 4U;
+      pdwVal += 4U * PMA_ACCESS_STRIDE;
+    }
+    pbUsrBuf = (uint8_t *)phUsrBuf;
+  }
+  else
+  {
+    for (; n >= 2U; n -= 2U)
+    {
+      temp = pdwVal[0U * PMA_ACCESS_STRIDE];
+      pbUsrBuf[0] = (uint8_t)temp;
+      pbUsrBuf[1] = (uint8_t)(temp >> 8U);
+      temp = pdwVal[1U * PMA_ACCESS_STRIDE];
+      pbUsrBuf[2] = (uint8_t)temp;
+      pbUsrBuf[3] = (uint8_t)(temp >> 8U);
+      pbUsrBuf += 4U;
+      pdwVal += 2U * PMA_ACCESS_STRIDE;
+    }
+  }
+
+  /* Remaining halfwords */
+  for (; n != 0U; n--)
   {
-    temp = *pdwVal++;
-    *pbUsrBuf++ = ((temp >> 0) & 0xFF);
-    *pbUsrBuf++ = ((temp >> 8) & 0xFF);
-    pdwVal++;
+    temp = *pdwVal;
+    pbUsrBuf[0] = (uint8_t)temp;
+    pbUsrBuf[1] = (uint8_t)(temp >> 8U);
+    pbUsrBuf += 2U;
+    pdwVal += PMA_ACCESS_STRIDE;
   }
 
-  if (wNBytes % 2)
+  /* Odd trailing byte */
+  if ((wNBytes & 0x1U) != 0U)
   {
-    temp = *pdwVal++;
-    *pbUsrBuf++ = ((temp >> 0) & 0xFF);
+    pbUsrBuf[0] = (uint8_t)*pdwVal;
   }
 }
-#endif /* STM32F303xC                || */
-       /* STM32F303x8 || STM32F334x8 || */
-       /* STM32F301x8                || */
-       /* STM32F373xC || STM32F378xx    */
 
-#if defined(STM32F302xE) || defined(STM32F303xE) || \
-    defined(STM32F302x8) 
 /**
-  * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @brief Convert 16-bit samples from packet memory area (PMA) to q15
+  * @note  y = x * gain / 32768, rounded and saturated. Four PMA halfwords
+  *        per loop iteration, as in PCD_ReadPMA.
   * @param   USBx: USB peripheral instance register address.
-  * @param   pbUsrBuf: pointer to user memory area.
-  * @param   wPMABufAddr: address into PMA.
-  * @param   wNBytes: no. of bytes to be copied.
+  * @param   pDst: q15 destination block.
+  * @param   wPMABufAddr: address into PMA, even.
+  * @param   count: no. of samples to convert.
+  * @param   gain: q15 gain, 32768 is unity.
   * @retval None
   */
-void PCD_WritePMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+void PCD_ReadPMASamples(USB_TypeDef  *USBx, int16_t *pDst, uint16_t wPMABufAddr, uint16_t count, int32_t gain)
 {
-  uint32_t n =  ((uint32_t)((uint32_t)wNBytes + 1U)) >> 1U;
-  uint32_t i;
-  uint16_t temp1, temp2;
-  uint16_t *pdwVal;
-  pdwVal = (uint16_t *)((uint32_t)(wPMABufAddr + (uint32_t)USBx + 0x400U));  
-  for (i = n; i != 0U; i--)
-  {
-    temp1 = (uint16_t) * pbUsrBuf;
-    pbUsrBuf++;
-    temp2 = temp1 | ((uint16_t)((uint16_t)  * pbUsrBuf << 8U)) ;
-    *pdwVal++ = temp2;
-    pbUsrBuf++;
+  uint32_t n = count;
+  int32_t v;
+  __IO uint16_t *pdwVal = PCD_PMA_PTR(USBx, wPMABufAddr);
+
+  for (; n >= 4U; n -= 4U)
+  {
+    v = ((int32_t)(int16_t)pdwVal[0U * PMA_ACCESS_STRIDE] * gain + 0x4000) >> 15;
+    pDst[0] = (int16_t)__SSAT(v, 16);
+    v = ((int32_t)(int16_t)pdwVal[1U * PMA_ACCESS_STRIDE] * gain + 0x4000) >> 15;
+    pDst[1] = (int16_t)__SSAT(v, 16);
+    v = ((int32_t)(int16_t)pdwVal[2U * PMA_ACCESS_STRIDE] * gain + 0x4000) >> 15;
+    pDst[2] = (int16_t)__SSAT(v, 16);
+    v = ((int32_t)(int16_t)pdwVal[3U * PMA_ACCESS_STRIDE] * gain + 0x4000) >> 15;
+    pDst[3] = (int16_t)__SSAT(v, 16);
+    pDst += 4U;
+    pdwVal += 4U * PMA_ACCESS_STRIDE;
+  }
+
+  for (; n != 0U; n--)
+  {
+    v = ((int32_t)(int16_t)*pdwVal * gain + 0x4000) >> 15;
+    *pDst++ = (int16_t)__SSAT(v, 16);
+    pdwVal += PMA_ACCESS_STRIDE;
   }
 }
 
 /**
-  * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @brief Convert 16-bit samples from packet memory area (PMA) to float
   * @param   USBx: USB peripheral instance register address.
+  * @param   pDst: float destination block.
+  * @param   wPMABufAddr: address into PMA, even.
+  * @param   count: no. of samples to convert.
+  * @param   scale: factor applied to every sample.
+  * @retval None
+  */
+void PCD_ReadPMASamplesF32(USB_TypeDef  *USBx, float *pDst, uint16_t wPMABufAddr, uint16_t count, float scale)
+{
+  uint32_t n = count;
+  __IO uint16_t *pdwVal = PCD_PMA_PTR(USBx, wPMABufAddr);
+
+  for (; n >= 4U; n -= 4U)
+  {
+    pDst[0] = (float)(int16_t)pdwVal[0U * PMA_ACCESS_STRIDE] * scale;
+    pDst[1] = (float)(int16_t)pdwVal[1U * PMA_ACCESS_STRIDE] * scale;
+    pDst[2] = (float)(int16_t)pdwVal[2U * PMA_ACCESS_STRIDE] * scale;
+    pDst[3] = (float)(int16_t)pdwVal[3U * PMA_ACCESS_STRIDE] * scale;
+    pDst += 4U;
+    pdwVal += 4U * PMA_ACCESS_STRIDE;
+  }
+
+  for (; n != 0U; n--)
+  {
+    *pDst++ = (float)(int16_t)*pdwVal * scale;
+    pdwVal += PMA_ACCESS_STRIDE;
+  }
+}
+
+#if (PCD_PMA_DMA == 1)
+/* Halfword moves, the PMA side one APB slot per halfword: on 2x16 parts a
+   32-bit PMA access, of which the DMA writes or reads the low half */
+#if (PMA_ACCESS_STRIDE == 2U)
+#define PCD_PMA_DMA_SIZES               (DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_1)
+#else
+#define PCD_PMA_DMA_SIZES               (DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0)
+#endif
+
+/* CCM SRAM is not on the DMA bus matrix */
+#define PCD_PMA_DMA_REACHABLE(p)        (((uint32_t)(p) & 0xFFFF0000U) != 0x10000000U)
+
+/**
+  * @brief Hand a packet copy to the PMA DMA channel, if it suits it
+  * @note  The direction follows ep->is_in. The channel is claimed with
+  *        LDREX/STREX, so thread level and the interrupt may both start
+  *        copies; the loser does its copy with the CPU. An odd trailing
+  *        byte is copied by the CPU first: the DMA moves halfwords and must
+  *        not read or write past the user buffer. HAL_PCD_PMADma_IRQHandler
+  *        finishes the packet.
+  * @param   hpcd PCD handle
+  * @param   ep endpoint
   * @param   pbUsrBuf: pointer to user memory area.
   * @param   wPMABufAddr: address into PMA.
   * @param   wNBytes: no. of bytes to be copied.
-  * @retval None
+  * @retval 1 if the DMA took the copy, 0 if the caller must do it
   */
-void PCD_ReadPMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+USB_CCM_FUNC uint8_t PCD_PMADmaStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n = (uint32_t)wNBytes >> 1U;
-  uint32_t i;
-  uint16_t *pdwVal;
-  uint32_t temp;
-  pdwVal = (uint16_t *)((uint32_t)(wPMABufAddr + (uint32_t)USBx + 0x400U));
+  DMA_Channel_TypeDef *ch = hpcd->PmaDmaCh;
+  uint16_t last = wPMABufAddr + (wNBytes & 0xFFFEU);
 
-  for (i = n; i != 0U; i--)
+  if ((ch == NULL) || (ep->num == 0U) || (wNBytes < PCD_PMA_DMA_THRESHOLD) ||
+      (((uint32_t)pbUsrBuf & 0x1U) != 0U) || !PCD_PMA_DMA_REACHABLE(pbUsrBuf))
   {
-    temp = *pdwVal++;
-    *pbUsrBuf++ = ((temp >> 0) & 0xFF);
-    *pbUsrBuf++ = ((temp >> 8) & 0xFF);
+    return 0U;
   }
 
-  if (wNBytes % 2)
+  do
+  {
+    if (__LDREXW((uint32_t *)(void *)&hpcd->PmaDmaEp) != 0U)
+    {
+      __CLREX();
+      return 0U;
+    }
+  } while (__STREXW((uint32_t)ep, (uint32_t *)(void *)&hpcd->PmaDmaEp) != 0U);
+
+  hpcd->PmaDmaBuf = pbUsrBuf;
+  hpcd->PmaDmaAddr = wPMABufAddr;
+  hpcd->PmaDmaLen = wNBytes;
+
+  if ((wNBytes & 0x1U) != 0U)
   {
-    temp = *pdwVal++;
-    *pbUsrBuf++ = ((temp >> 0) & 0xFF);
+    if (ep->is_in != 0U)
+    {
+      *PCD_PMA_PTR(hpcd->Instance, last) = (uint16_t)pbUsrBuf[wNBytes - 1U];
+    }
+    else
+    {
+      pbUsrBuf[wNBytes - 1U] = (uint8_t)*PCD_PMA_PTR(hpcd->Instance, last);
+    }
   }
+
+  ch->CCR = 0U;
+  hpcd->PmaDma->IFCR = DMA_IFCR_CGIF1 << (4U * (hpcd->PmaDmaChNum - 1U));
+  ch->CNDTR = (uint32_t)wNBytes >> 1U;
+  ch->CPAR = (uint32_t)PCD_PMA_PTR(hpcd->Instance, wPMABufAddr);
+  ch->CMAR = (uint32_t)pbUsrBuf;
+  /* memory to memory: DIR picks CMAR as the source */
+  ch->CCR = DMA_CCR_MEM2MEM | PCD_PMA_DMA_PRIORITY | PCD_PMA_DMA_SIZES |
+            DMA_CCR_MINC | DMA_CCR_PINC | DMA_CCR_TCIE | DMA_CCR_TEIE |
+            ((ep->is_in != 0U) ? DMA_CCR_DIR : 0U) | DMA_CCR_EN;
+
+  return 1U;
 }
-#endif /* STM32F302xE || STM32F303xE || */
-       /* STM32F302xC                || */
-       /* STM32F302x8                   */
+
+/**
+  * @brief Stop the PMA DMA channel after its interrupt and release it
+  * @param   hpcd PCD handle
+  * @param   error set to 1 if the copy hit a transfer error and must be
+  *          redone with the CPU
+  * @retval endpoint of the packet, NULL if no copy was under way
+  */
+USB_CCM_FUNC PCD_EPTypeDef *PCD_PMADmaStop(PCD_HandleTypeDef *hpcd, uint8_t *error)
+{
+  uint32_t shift = 4U * (hpcd->PmaDmaChNum - 1U);
+  uint32_t isr = hpcd->PmaDma->ISR >> shift;
+  PCD_EPTypeDef *ep = hpcd->PmaDmaEp;
+
+  *error = ((isr & DMA_ISR_TEIF1) != 0U) ? 1U : 0U;
+  if ((ep == NULL) || ((isr & (DMA_ISR_TCIF1 | DMA_ISR_TEIF1)) == 0U))
+  {
+    return NULL;
+  }
+
+  hpcd->PmaDmaCh->CCR = 0U;
+  hpcd->PmaDma->IFCR = DMA_IFCR_CGIF1 << shift;
+  hpcd->PmaDmaEp = NULL;
+
+  return ep;
+}
+#endif /* PCD_PMA_DMA */
 
 /**
   * @}
@@ -301,6 +999,30 @@ void PCD_ReadPMA(USB_TypeDef  *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, ui
             the HAL_PCDEx_SetConnectionState could be implenetd in the user file
    */ 
 }
+
+#if defined(USB_LPMCSR_LMPEN)
+/**
+  * @brief  Link entered or left L1
+  * @note   Entry is reported once the macrocell is in low-power mode, exit
+  *         as soon as the resume (host or remote wakeup) is seen. hpcd->BESL
+  *         is how long the host lets the device take to wake up; a device
+  *         that cannot restore its clocks in that time must not gate them.
+  * @param  hpcd PCD handle
+  * @param  msg PCD_LPM_L1_ACTIVE or PCD_LPM_L0_ACTIVE
+  * @retval None
+  */
+__weak void HAL_PCDEx_LPM_Callback(PCD_HandleTypeDef *hpcd, PCD_LPM_MsgTypeDef msg)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(msg);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCDEx_LPM_Callback could be implemented in the user file,
+            usually calling USBD_LL_LPM
+   */ 
+}
+#endif /* USB_LPMCSR_LMPEN */
 /**
   * @}
   */ 
@@ -0,0 +1,2127 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal_pcd.c
+  * @brief   PCD driver for the STM32F4 OTG_FS and OTG_HS cores, device
+  *          mode. Same interface as stm32f3xx_hal_pcd.c, see
+  *          stm32f4xx_hal_pcd.h.
+  *
+  *          Builds against the HAL headers in inc/usb (stm32f4xx_hal.h,
+  *          _conf.h, _def.h) and the CMSIS device headers in inc/stm32f4xx.
+  *          HAL_Delay and HAL_RCC_GetHCLKFreq are linked from the STM32CubeF4
+  *          HAL driver V1.7.x, which is not part of this repository;
+  *          usb_tick.c can provide HAL_Delay instead.
+  *
+  @verbatim
+  ==============================================================================
+                    ##### How to use this driver #####
+  ==============================================================================
+    [..]
+     (#) Declare a PCD_HandleTypeDef handle structure, set Instance to
+         USB_OTG_FS or USB_OTG_HS and fill in the Init structure.
+
+     (#) Call HAL_PCD_Init(). HAL_PCD_MspInit() enables the OTG_FS clock,
+         configures PA11/PA12 (and PA9 for VBUS sensing) and the OTG_FS_IRQn
+         interrupt; for OTG_HS on a ULPI PHY, the OTG_HS and OTG_HS_ULPI
+         clocks, the ULPI pins and OTG_HS_IRQn.
+
+     (#) Split the FIFO RAM: HAL_PCDEx_SetRxFiFo() first, then
+         HAL_PCDEx_SetTxFiFo() for FIFO 0 and each IN endpoint in turn,
+         sized with PCDEx_RX_FIFO_WORDS and PCDEx_TX_FIFO_WORDS.
+
+     (#) Associate the upper USB device stack: hpcd.pData = pdev, then
+         HAL_PCD_Start().
+
+    [..]
+     IN transfers are pushed into the transmit FIFO of the endpoint as far
+     as it has room, straight from HAL_PCD_EP_Transmit; the TXFE interrupt
+     of the endpoint is only enabled while part of a transfer is left to
+     push. OUT packets are popped from the receive FIFO into the transfer
+     buffer by the RXFLVL interrupt. FIFO accesses are 32-bit wide, the
+     buffers need no particular alignment.
+
+    [..]
+     With dma_enable set, OTG_HS only, the core fetches and stores the
+     packets itself: a transfer part is programmed with its buffer address
+     and completes with a single XFRC interrupt, no FIFO interrupt is used.
+
+    [..]
+     As with the F3 driver, a control transfer data stage is completed with
+     a single Data Stage callback: the packets in between are loaded, or the
+     endpoint re-armed, by the driver.
+
+  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "usb_prof.h"
+#include "usb_stats.h"
+#include "usb_trace.h"
+#include "usb_timesync.h"
+#include "usb_enumbench.h"
+
+#ifdef HAL_PCD_MODULE_ENABLED
+
+#if defined(USB_OTG_FS)
+
+/** @addtogroup STM32F4xx_HAL_Driver
+  * @{
+  */
+
+/** @defgroup PCD PCD
+  * @brief PCD HAL module driver
+  * @{
+  */
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/** @defgroup PCD_Private_Define PCD Private Define
+  * @{
+  */
+/* GRXSTSP packet status */
+#define PCD_STS_GOUT_NAK                1U
+#define PCD_STS_DATA_UPDT               2U
+#define PCD_STS_XFER_COMP               3U
+#define PCD_STS_SETUP_COMP              4U
+#define PCD_STS_SETUP_UPDT              6U
+
+/* GRSTCTL TXFNUM selecting all transmit FIFOs */
+#define PCD_ALL_TX_FIFOS                0x10U
+
+/* Loops waited for the core to go idle or finish a reset or flush */
+#define PCD_CORE_TIMEOUT                200000U
+
+/* DCFG DSPD values */
+#define PCD_DSPD_HIGH                   0U
+#define PCD_DSPD_HIGH_IN_FULL           1U
+#define PCD_DSPD_FULL                   3U
+
+/* Turnaround time in PHY clocks at high speed */
+#define PCD_TRDT_HIGH                   9U
+/**
+  * @}
+  */
+
+/* Private macro -------------------------------------------------------------*/
+
+/** @defgroup PCD_Private_Macros PCD Private Macros
+  * @{
+  */
+#define PCD_DEV(hpcd)                   ((USB_OTG_DeviceTypeDef *)((uint32_t)(hpcd)->Instance + USB_OTG_DEVICE_BASE))
+#define PCD_INEP(hpcd, i)               ((USB_OTG_INEndpointTypeDef *)((uint32_t)(hpcd)->Instance + \
+                                          USB_OTG_IN_ENDPOINT_BASE + ((i) * USB_OTG_EP_REG_SIZE)))
+#define PCD_OUTEP(hpcd, i)              ((USB_OTG_OUTEndpointTypeDef *)((uint32_t)(hpcd)->Instance + \
+                                          USB_OTG_OUT_ENDPOINT_BASE + ((i) * USB_OTG_EP_REG_SIZE)))
+#define PCD_DFIFO(hpcd, i)              (*(__IO uint32_t *)((uint32_t)(hpcd)->Instance + \
+                                          USB_OTG_FIFO_BASE + ((i) * USB_OTG_FIFO_SIZE)))
+#define PCD_PCGCCTL(hpcd)               (*(__IO uint32_t *)((uint32_t)(hpcd)->Instance + USB_OTG_PCGCCTL_BASE))
+
+/* MPSIZ encoding of endpoint 0 */
+#define PCD_EP0_MPSIZ(mps)              (((mps) >= 64U) ? DEP0CTL_MPS_64 : ((mps) >= 32U) ? DEP0CTL_MPS_32 : \
+                                         ((mps) >= 16U) ? DEP0CTL_MPS_16 : DEP0CTL_MPS_8)
+
+/* Current frame number, for the OUT NAK statistics and isochronous parity */
+#define PCD_FRAME_NUMBER(hpcd)          ((uint16_t)((PCD_DEV(hpcd)->DSTS & USB_OTG_DSTS_FNSOF) >> USB_OTG_DSTS_FNSOF_Pos))
+
+/* Packets moved by the internal DMA of the core */
+#define PCD_DMA(hpcd)                   ((hpcd)->Init.dma_enable == ENABLE)
+
+/* Endpoint 0 packets go through EP0_Buf in DMA mode: its buffers have any
+   alignment and may be shorter than the packet the host sends */
+#define PCD_EP0_BOUNCE(hpcd, ep)        (PCD_DMA(hpcd) && ((ep)->num == 0U))
+
+#if defined(USB_OTG_HS)
+#define PCD_IS_HS_CORE(hpcd)            ((hpcd)->Instance == USB_OTG_HS)
+#else
+#define PCD_IS_HS_CORE(hpcd)            0
+#endif /* USB_OTG_HS */
+/**
+  * @}
+  */
+
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/** @defgroup PCD_Private_Functions PCD Private Functions
+  * @{
+  */
+static HAL_StatusTypeDef PCD_CoreReset(PCD_HandleTypeDef *hpcd);
+static void PCD_FlushTxFifo(PCD_HandleTypeDef *hpcd, uint32_t num);
+static void PCD_FlushRxFifo(PCD_HandleTypeDef *hpcd);
+static void PCD_SetTurnaround(PCD_HandleTypeDef *hpcd, uint8_t high_speed);
+static void PCD_EP0_OutStart(PCD_HandleTypeDef *hpcd);
+static void PCD_EP_StartIn(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_StartOut(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_TxFill(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_TxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_RxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_DmaInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_DmaOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_SetEmptyIrq(PCD_HandleTypeDef *hpcd, uint8_t epnum, uint8_t enable);
+static void PCD_WriteFifo(PCD_HandleTypeDef *hpcd, uint8_t epnum, const uint8_t *pSrc, uint32_t len);
+static void PCD_ReadFifo(PCD_HandleTypeDef *hpcd, uint8_t *pDest, uint32_t len, uint32_t keep);
+static void PCD_RxFifo_ISR_Handler(PCD_HandleTypeDef *hpcd);
+static void PCD_IN_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+static void PCD_OUT_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+static void PCD_DataOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_DataInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+/**
+  * @}
+  */
+
+/* Exported functions ---------------------------------------------------------*/
+
+/** @defgroup PCD_Exported_Functions PCD Exported Functions
+  * @{
+  */
+
+/** @defgroup PCD_Exported_Functions_Group1 Initialization and de-initialization functions
+ *  @brief    Initialization and Configuration functions
+ *
+@verbatim
+ ===============================================================================
+            ##### Initialization and de-initialization functions #####
+ ===============================================================================
+    [..]  This section provides functions allowing to:
+
+@endverbatim
+  * @{
+  */
+
+/**
+  * @brief  Initializes the PCD according to the specified
+  *         parameters in the PCD_InitTypeDef and create the associated handle.
+  * @note   The device is left soft disconnected until HAL_PCD_Start.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_Init(PCD_HandleTypeDef *hpcd)
+{
+  USB_OTG_GlobalTypeDef *USBx;
+  uint32_t i = 0U;
+  uint32_t wInterrupt_Mask = 0U;
+  uint32_t dspd;
+
+  /* Check the PCD handle allocation */
+  if(hpcd == NULL)
+  {
+    return HAL_ERROR;
+  }
+  USBx = hpcd->Instance;
+
+  if(hpcd->State == HAL_PCD_STATE_RESET)
+  {
+    /* Allocate lock resource and initialize it */
+    hpcd->Lock = HAL_UNLOCKED;
+
+    /* Init the low level hardware : GPIO, CLOCK, NVIC... */
+    HAL_PCD_MspInit(hpcd);
+  }
+
+  hpcd->State = HAL_PCD_STATE_BUSY;
+
+  /* Only OTG_HS has the DMA and the ULPI interface */
+  if (!PCD_IS_HS_CORE(hpcd) &&
+      ((hpcd->Init.dma_enable == ENABLE) || (hpcd->Init.phy_itface == PCD_PHY_ULPI)))
+  {
+    hpcd->State = HAL_PCD_STATE_ERROR;
+    return HAL_ERROR;
+  }
+
+  /* Core init: PHY selection, soft reset, embedded transceiver on or off */
+  USBx->GAHBCFG &= ~USB_OTG_GAHBCFG_GINT;
+  if (hpcd->Init.phy_itface == PCD_PHY_ULPI)
+  {
+    USBx->GCCFG &= ~USB_OTG_GCCFG_PWRDWN;
+    USBx->GUSBCFG &= ~(USB_OTG_GUSBCFG_TSDPS | USB_OTG_GUSBCFG_ULPIFSLS | USB_OTG_GUSBCFG_PHYSEL |
+                       USB_OTG_GUSBCFG_ULPIEVBUSD | USB_OTG_GUSBCFG_ULPIEVBUSI);
+  }
+  else
+  {
+    USBx->GUSBCFG |= USB_OTG_GUSBCFG_PHYSEL;
+  }
+  if (PCD_CoreReset(hpcd) != HAL_OK)
+  {
+    hpcd->State = HAL_PCD_STATE_ERROR;
+    return HAL_ERROR;
+  }
+  if (hpcd->Init.phy_itface != PCD_PHY_ULPI)
+  {
+    USBx->GCCFG = USB_OTG_GCCFG_PWRDWN;
+  }
+
+  if (hpcd->Init.dma_enable == ENABLE)
+  {
+    /* INCR4 bursts */
+    USBx->GAHBCFG = (USBx->GAHBCFG & ~USB_OTG_GAHBCFG_HBSTLEN) |
+                    USB_OTG_GAHBCFG_HBSTLEN_2 | USB_OTG_GAHBCFG_DMAEN;
+  }
+
+  /* Force device mode, the core takes up to 25 ms to switch */
+  USBx->GUSBCFG &= ~(USB_OTG_GUSBCFG_FHMOD | USB_OTG_GUSBCFG_FDMOD);
+  USBx->GUSBCFG |= USB_OTG_GUSBCFG_FDMOD;
+  HAL_Delay(50U);
+
+  /* Init endpoints structures */
+  for (i = 0U; i < hpcd->Init.dev_endpoints ; i++)
+  {
+    /* Init ep structure */
+    hpcd->IN_ep[i].is_in = 1U;
+    hpcd->IN_ep[i].num = i;
+    /* Control until ep is actvated */
+    hpcd->IN_ep[i].type = PCD_EP_TYPE_CTRL;
+    hpcd->IN_ep[i].maxpacket =  0U;
+    hpcd->IN_ep[i].xfer_buff = 0U;
+    hpcd->IN_ep[i].xfer_len = 0U;
+    hpcd->IN_ep[i].xfer_cb = NULL;
+
+    hpcd->OUT_ep[i].is_in = 0U;
+    hpcd->OUT_ep[i].num = i;
+    /* Control until ep is activated */
+    hpcd->OUT_ep[i].type = PCD_EP_TYPE_CTRL;
+    hpcd->OUT_ep[i].maxpacket = 0U;
+    hpcd->OUT_ep[i].xfer_buff = 0U;
+    hpcd->OUT_ep[i].xfer_len = 0U;
+    hpcd->OUT_ep[i].xfer_cb = NULL;
+  }
+
+  /* Device init */
+  for (i = 0U; i < 15U; i++)
+  {
+    USBx->DIEPTXF[i] = 0U;
+  }
+
+#if defined(USB_OTG_GCCFG_VBDEN)
+  if (hpcd->Init.vbus_sensing_enable == ENABLE)
+  {
+    USBx->GCCFG |= USB_OTG_GCCFG_VBDEN;
+  }
+  else
+  {
+    /* B-session valid forced, PA9 is free */
+    USBx->GCCFG &= ~USB_OTG_GCCFG_VBDEN;
+    USBx->GOTGCTL |= USB_OTG_GOTGCTL_BVALOEN | USB_OTG_GOTGCTL_BVALOVAL;
+  }
+#else
+  if (hpcd->Init.vbus_sensing_enable == ENABLE)
+  {
+    USBx->GCCFG &= ~USB_OTG_GCCFG_NOVBUSSENS;
+    USBx->GCCFG |= USB_OTG_GCCFG_VBUSBSEN;
+  }
+  else
+  {
+    USBx->GCCFG |= USB_OTG_GCCFG_NOVBUSSENS;
+    USBx->GCCFG &= ~(USB_OTG_GCCFG_VBUSBSEN | USB_OTG_GCCFG_VBUSASEN);
+  }
+#endif /* USB_OTG_GCCFG_VBDEN */
+
+  /* Restart the PHY clock, then the device speed */
+  PCD_PCGCCTL(hpcd) = 0U;
+  if (hpcd->Init.phy_itface != PCD_PHY_ULPI)
+  {
+    dspd = PCD_DSPD_FULL;
+  }
+  else if (hpcd->Init.speed == PCD_SPEED_HIGH)
+  {
+    dspd = PCD_DSPD_HIGH;
+  }
+  else
+  {
+    dspd = PCD_DSPD_HIGH_IN_FULL;
+  }
+  PCD_DEV(hpcd)->DCFG = (PCD_DEV(hpcd)->DCFG & ~USB_OTG_DCFG_DSPD) | (dspd << USB_OTG_DCFG_DSPD_Pos);
+
+  PCD_FlushTxFifo(hpcd, PCD_ALL_TX_FIFOS);
+  PCD_FlushRxFifo(hpcd);
+
+  /* Clear all pending device interrupts */
+  PCD_DEV(hpcd)->DIEPMSK = 0U;
+  PCD_DEV(hpcd)->DOEPMSK = 0U;
+  PCD_DEV(hpcd)->DAINT = 0xFFFFFFFFU;
+  PCD_DEV(hpcd)->DAINTMSK = 0U;
+  PCD_DEV(hpcd)->DIEPEMPMSK = 0U;
+
+  for (i = 0U; i < hpcd->Init.dev_endpoints; i++)
+  {
+    if ((PCD_INEP(hpcd, i)->DIEPCTL & USB_OTG_DIEPCTL_EPENA) != 0U)
+    {
+      PCD_INEP(hpcd, i)->DIEPCTL = (i == 0U) ? USB_OTG_DIEPCTL_SNAK :
+                                   (USB_OTG_DIEPCTL_EPDIS | USB_OTG_DIEPCTL_SNAK);
+    }
+    else
+    {
+      PCD_INEP(hpcd, i)->DIEPCTL = 0U;
+    }
+    PCD_INEP(hpcd, i)->DIEPTSIZ = 0U;
+    PCD_INEP(hpcd, i)->DIEPINT = 0xFB7FU;
+
+    if ((PCD_OUTEP(hpcd, i)->DOEPCTL & USB_OTG_DOEPCTL_EPENA) != 0U)
+    {
+      PCD_OUTEP(hpcd, i)->DOEPCTL = (i == 0U) ? USB_OTG_DOEPCTL_SNAK :
+                                    (USB_OTG_DOEPCTL_EPDIS | USB_OTG_DOEPCTL_SNAK);
+    }
+    else
+    {
+      PCD_OUTEP(hpcd, i)->DOEPCTL = 0U;
+    }
+    PCD_OUTEP(hpcd, i)->DOEPTSIZ = 0U;
+    PCD_OUTEP(hpcd, i)->DOEPINT = 0xFB7FU;
+  }
+
+  /* Clear all pending core interrupts, then set the interrupt mask */
+  USBx->GINTMSK = 0U;
+  USBx->GINTSTS = 0xBFFFFFFFU;
+
+  wInterrupt_Mask = USB_OTG_GINTMSK_USBSUSPM | USB_OTG_GINTMSK_USBRST |
+                    USB_OTG_GINTMSK_ENUMDNEM | USB_OTG_GINTMSK_IEPINT | USB_OTG_GINTMSK_OEPINT |
+                    USB_OTG_GINTMSK_IISOIXFRM | USB_OTG_GINTMSK_PXFRM_IISOOXFRM | USB_OTG_GINTMSK_WUIM;
+  if (hpcd->Init.dma_enable != ENABLE)
+  {
+    wInterrupt_Mask |= USB_OTG_GINTMSK_RXFLVLM;
+  }
+  if (hpcd->Init.Sof_enable == ENABLE)
+  {
+    wInterrupt_Mask |= USB_OTG_GINTMSK_SOFM;
+  }
+#if (USB_TIMESYNC_ENABLED == 1)
+  wInterrupt_Mask |= USB_OTG_GINTMSK_SOFM;
+#endif /* USB_TIMESYNC_ENABLED */
+  if (hpcd->Init.vbus_sensing_enable == ENABLE)
+  {
+    wInterrupt_Mask |= USB_OTG_GINTMSK_SRQIM | USB_OTG_GINTMSK_OTGINT;
+  }
+  USBx->GINTMSK = wInterrupt_Mask;
+
+  PCD_DEV(hpcd)->DCTL |= USB_OTG_DCTL_SDIS;
+
+  hpcd->USB_Address = 0U;
+  hpcd->State= HAL_PCD_STATE_READY;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  DeInitializes the PCD peripheral
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_DeInit(PCD_HandleTypeDef *hpcd)
+{
+  /* Check the PCD handle allocation */
+  if(hpcd == NULL)
+  {
+    return HAL_ERROR;
+  }
+
+  hpcd->State = HAL_PCD_STATE_BUSY;
+
+  /* Stop Device */
+  HAL_PCD_Stop(hpcd);
+
+  /* DeInit the low level hardware */
+  HAL_PCD_MspDeInit(hpcd);
+
+  hpcd->State = HAL_PCD_STATE_RESET;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Initializes the PCD MSP.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+__weak void HAL_PCD_MspInit(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_MspInit could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  DeInitializes PCD MSP.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+__weak void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_MspDeInit could be implemented in the user file
+   */
+}
+
+/**
+  * @}
+  */
+
+/** @defgroup PCD_Exported_Functions_Group2 IO operation functions
+ *  @brief   Data transfers functions
+ *
+@verbatim
+ ===============================================================================
+                      ##### IO operation functions #####
+ ===============================================================================
+    [..]
+    This subsection provides a set of functions allowing to manage the PCD data
+    transfers.
+
+@endverbatim
+  * @{
+  */
+
+/**
+  * @brief  Start the USB device.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd)
+{
+  __HAL_LOCK(hpcd);
+
+  /* Internal pull-up on DP */
+  PCD_DEV(hpcd)->DCTL &= ~USB_OTG_DCTL_SDIS;
+  HAL_PCDEx_SetConnectionState(hpcd, 1U);
+  hpcd->Instance->GAHBCFG |= USB_OTG_GAHBCFG_GINT;
+  USB_ENUMBENCH_CONNECTED();
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Stop the USB device.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_Stop(PCD_HandleTypeDef *hpcd)
+{
+  __HAL_LOCK(hpcd);
+
+  /* disable all interrupts and disconnect */
+  hpcd->Instance->GAHBCFG &= ~USB_OTG_GAHBCFG_GINT;
+  PCD_DEV(hpcd)->DCTL |= USB_OTG_DCTL_SDIS;
+  HAL_PCDEx_SetConnectionState(hpcd, 0U);
+
+  /* clear interrupt status register */
+  hpcd->Instance->GINTSTS = 0xBFFFFFFFU;
+  PCD_DEV(hpcd)->DAINTMSK = 0U;
+  PCD_DEV(hpcd)->DIEPEMPMSK = 0U;
+
+  PCD_FlushTxFifo(hpcd, PCD_ALL_TX_FIFOS);
+  PCD_FlushRxFifo(hpcd);
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @addtogroup PCD_Private_Functions PCD Private Functions
+  * @{
+  */
+
+/**
+  * @brief  Soft reset of the core, once the AHB master is idle.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef PCD_CoreReset(PCD_HandleTypeDef *hpcd)
+{
+  uint32_t count = 0U;
+
+  while ((hpcd->Instance->GRSTCTL & USB_OTG_GRSTCTL_AHBIDL) == 0U)
+  {
+    if (++count > PCD_CORE_TIMEOUT)
+    {
+      return HAL_TIMEOUT;
+    }
+  }
+
+  count = 0U;
+  hpcd->Instance->GRSTCTL |= USB_OTG_GRSTCTL_CSRST;
+  while ((hpcd->Instance->GRSTCTL & USB_OTG_GRSTCTL_CSRST) != 0U)
+  {
+    if (++count > PCD_CORE_TIMEOUT)
+    {
+      return HAL_TIMEOUT;
+    }
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Flush a transmit FIFO.
+  * @param  hpcd PCD handle
+  * @param  num FIFO number, PCD_ALL_TX_FIFOS for all of them
+  * @retval None
+  */
+static void PCD_FlushTxFifo(PCD_HandleTypeDef *hpcd, uint32_t num)
+{
+  uint32_t count = 0U;
+
+  hpcd->Instance->GRSTCTL = USB_OTG_GRSTCTL_TXFFLSH | (num << USB_OTG_GRSTCTL_TXFNUM_Pos);
+  while (((hpcd->Instance->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH) != 0U) && (++count < PCD_CORE_TIMEOUT))
+  {
+  }
+}
+
+/**
+  * @brief  Flush the receive FIFO.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+static void PCD_FlushRxFifo(PCD_HandleTypeDef *hpcd)
+{
+  uint32_t count = 0U;
+
+  hpcd->Instance->GRSTCTL = USB_OTG_GRSTCTL_RXFFLSH;
+  while (((hpcd->Instance->GRSTCTL & USB_OTG_GRSTCTL_RXFFLSH) != 0U) && (++count < PCD_CORE_TIMEOUT))
+  {
+  }
+}
+
+/**
+  * @brief  Program the USB turnaround time for the enumerated speed and, at
+  *         full speed, the AHB clock.
+  * @param  hpcd PCD handle
+  * @param  high_speed 1 when the host enumerated the device at high speed
+  * @retval None
+  */
+static void PCD_SetTurnaround(PCD_HandleTypeDef *hpcd, uint8_t high_speed)
+{
+  uint32_t hclk = HAL_RCC_GetHCLKFreq();
+  uint32_t trdt;
+
+  if (high_speed != 0U)
+  {
+    trdt = PCD_TRDT_HIGH;
+  }
+  else if (hclk >= 32000000U)
+  {
+    trdt = 0x6U;
+  }
+  else if (hclk >= 27700000U)
+  {
+    trdt = 0x7U;
+  }
+  else if (hclk >= 24000000U)
+  {
+    trdt = 0x8U;
+  }
+  else if (hclk >= 21800000U)
+  {
+    trdt = 0x9U;
+  }
+  else if (hclk >= 20000000U)
+  {
+    trdt = 0xAU;
+  }
+  else if (hclk >= 18500000U)
+  {
+    trdt = 0xBU;
+  }
+  else if (hclk >= 17200000U)
+  {
+    trdt = 0xCU;
+  }
+  else if (hclk >= 16000000U)
+  {
+    trdt = 0xDU;
+  }
+  else if (hclk >= 15000000U)
+  {
+    trdt = 0xEU;
+  }
+  else
+  {
+    trdt = 0xFU;
+  }
+
+  hpcd->Instance->GUSBCFG = (hpcd->Instance->GUSBCFG & ~USB_OTG_GUSBCFG_TRDT) |
+                            (trdt << USB_OTG_GUSBCFG_TRDT_Pos);
+}
+
+/**
+  * @brief  Let endpoint 0 take up to three back to back SETUP packets.
+  * @note   In DMA mode they are stored one after the other from Setup.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+static void PCD_EP0_OutStart(PCD_HandleTypeDef *hpcd)
+{
+  PCD_OUTEP(hpcd, 0U)->DOEPTSIZ = (3U << USB_OTG_DOEPTSIZ_STUPCNT_Pos) |
+                                  (1U << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | (3U * 8U);
+
+  if (PCD_DMA(hpcd))
+  {
+    PCD_OUTEP(hpcd, 0U)->DOEPDMA = (uint32_t)hpcd->Setup;
+    PCD_OUTEP(hpcd, 0U)->DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_USBAEP;
+  }
+}
+
+/**
+  * @brief  Program the next part of an IN transfer and push what fits of
+  *         it into the transmit FIFO.
+  * @note   A part is one packet on endpoint 0, as its transfer size register
+  *         is narrow, and up to PCD_EP_MAX_PKTCNT packets on the others.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_StartIn(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  USB_OTG_INEndpointTypeDef *inep = PCD_INEP(hpcd, ep->num);
+  uint32_t len = ep->xfer_len - ep->xfer_count;
+  uint32_t max = (ep->num == 0U) ? ep->maxpacket : (PCD_EP_MAX_PKTCNT * ep->maxpacket);
+  uint32_t pktcnt;
+  uint32_t tsiz;
+
+  if (len > max)
+  {
+    len = max;
+  }
+  pktcnt = (len == 0U) ? 1U : ((len + ep->maxpacket - 1U) / ep->maxpacket);
+  ep->xfer_size = ep->xfer_count + len;
+
+  tsiz = (pktcnt << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | len;
+  if (ep->type == PCD_EP_TYPE_ISOC)
+  {
+    tsiz |= (1U << USB_OTG_DIEPTSIZ_MULCNT_Pos);
+    inep->DIEPCTL |= ((PCD_FRAME_NUMBER(hpcd) & 1U) == 0U) ? USB_OTG_DIEPCTL_SODDFRM :
+                                                             USB_OTG_DIEPCTL_SD0PID_SEVNFRM;
+  }
+  inep->DIEPTSIZ = tsiz;
+
+  if (PCD_DMA(hpcd))
+  {
+    if (PCD_EP0_BOUNCE(hpcd, ep))
+    {
+      if (len != 0U)
+      {
+        memcpy(hpcd->EP0_Buf, ep->xfer_buff, len);
+      }
+      inep->DIEPDMA = (uint32_t)hpcd->EP0_Buf;
+    }
+    else
+    {
+      inep->DIEPDMA = (uint32_t)ep->xfer_buff;
+    }
+    inep->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+    return;
+  }
+
+  inep->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+
+  if (len == 0U)
+  {
+    USB_STATS_TX(ep->num, 0U);
+    USB_TRACE_IN(ep->num, 0U);
+  }
+  else
+  {
+    PCD_EP_TxFill(hpcd, ep);
+  }
+}
+
+/**
+  * @brief  Program the next part of an OUT transfer.
+  * @note   The transfer size is rounded up to whole packets: PCD_ReadFifo
+  *         drops what the host sends past the end of the buffer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_StartOut(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  USB_OTG_OUTEndpointTypeDef *outep = PCD_OUTEP(hpcd, ep->num);
+  uint32_t len = ep->xfer_len - ep->xfer_count;
+  uint32_t pktcnt;
+
+  if (ep->num == 0U)
+  {
+    /* One packet at a time, keeping the SETUP packet count */
+    if (len > ep->maxpacket)
+    {
+      len = ep->maxpacket;
+    }
+    ep->xfer_size = ep->xfer_count + len;
+    outep->DOEPTSIZ = (outep->DOEPTSIZ & USB_OTG_DOEPTSIZ_STUPCNT) |
+                      (1U << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | ep->maxpacket;
+  }
+  else
+  {
+    if (len > (PCD_EP_MAX_PKTCNT * ep->maxpacket))
+    {
+      len = PCD_EP_MAX_PKTCNT * ep->maxpacket;
+    }
+    pktcnt = (len == 0U) ? 1U : ((len + ep->maxpacket - 1U) / ep->maxpacket);
+    ep->xfer_size = ep->xfer_count + len;
+    outep->DOEPTSIZ = (pktcnt << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | (pktcnt * ep->maxpacket);
+
+    if (ep->type == PCD_EP_TYPE_ISOC)
+    {
+      outep->DOEPCTL |= ((PCD_FRAME_NUMBER(hpcd) & 1U) == 0U) ? USB_OTG_DOEPCTL_SODDFRM :
+                                                                USB_OTG_DOEPCTL_SD0PID_SEVNFRM;
+    }
+  }
+
+  if (PCD_DMA(hpcd))
+  {
+    /* a zero length transfer stores nothing, any address will do */
+    outep->DOEPDMA = (PCD_EP0_BOUNCE(hpcd, ep) || (ep->xfer_buff == NULL)) ?
+                     (uint32_t)hpcd->EP0_Buf : (uint32_t)ep->xfer_buff;
+  }
+
+  outep->DOEPCTL |= USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA;
+}
+
+/**
+  * @brief  Push the packets of the programmed part of an IN transfer that
+  *         fit into the transmit FIFO; the TXFE interrupt of the endpoint
+  *         stays enabled while some are left.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_TxFill(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  USB_OTG_INEndpointTypeDef *inep = PCD_INEP(hpcd, ep->num);
+  uint32_t len;
+
+  while (ep->xfer_count < ep->xfer_size)
+  {
+    len = ep->xfer_size - ep->xfer_count;
+    if (len > ep->maxpacket)
+    {
+      len = ep->maxpacket;
+    }
+    if ((inep->DTXFSTS & USB_OTG_DTXFSTS_INEPTFSAV) < ((len + 3U) / 4U))
+    {
+      break;
+    }
+
+    PCD_WriteFifo(hpcd, ep->num, ep->xfer_buff, len);
+    ep->xfer_buff += len;
+    ep->xfer_count += len;
+    USB_STATS_TX(ep->num, len);
+    USB_TRACE_IN(ep->num, len);
+  }
+
+  PCD_SetEmptyIrq(hpcd, ep->num, (ep->xfer_count < ep->xfer_size) ? 1U : 0U);
+}
+
+/**
+  * @brief  Programmed part of an IN transfer sent: start the next part or
+  *         complete the transfer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_TxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if (ep->xfer_count < ep->xfer_len)
+  {
+    PCD_EP_StartIn(hpcd, ep);
+  }
+  else if (ep->num == 0U)
+  {
+    /* TX COMPLETE */
+    HAL_PCD_DataInStageCallback(hpcd, 0U);
+  }
+  else
+  {
+    PCD_DataInDone(hpcd, ep);
+  }
+}
+
+/**
+  * @brief  Programmed part of an OUT transfer received: arm the next part
+  *         if it was filled without a short packet, else complete the
+  *         transfer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_RxDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if ((ep->xfer_count < ep->xfer_len) && (ep->xfer_count == ep->xfer_size))
+  {
+    PCD_EP_StartOut(hpcd, ep);
+  }
+  else if (ep->num == 0U)
+  {
+    /* Process Control Data OUT Packet*/
+    HAL_PCD_DataOutStageCallback(hpcd, 0U);
+  }
+  else
+  {
+    /* RX COMPLETE */
+    USB_STATS_OUT_IDLE(ep->num, PCD_FRAME_NUMBER(hpcd));
+    PCD_DataOutDone(hpcd, ep);
+  }
+}
+
+/**
+  * @brief  DMA mode: account for the programmed part of an IN transfer,
+  *         sent as a whole.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_DmaInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint32_t len = ep->xfer_size - ep->xfer_count;
+
+  UNUSED(hpcd);
+
+  ep->xfer_buff += len;
+  ep->xfer_count = ep->xfer_size;
+
+#if (USB_STATS_ENABLED == 1) || (USB_TRACE_ENABLED == 1)
+  do
+  {
+    USB_STATS_TX(ep->num, (len > ep->maxpacket) ? ep->maxpacket : len);
+    USB_TRACE_IN(ep->num, (len > ep->maxpacket) ? ep->maxpacket : len);
+    len -= (len > ep->maxpacket) ? ep->maxpacket : len;
+  } while (len != 0U);
+#endif /* USB_STATS_ENABLED || USB_TRACE_ENABLED */
+}
+
+/**
+  * @brief  DMA mode: account for what the core stored of the programmed
+  *         part of an OUT transfer, from the transfer size left over.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_DmaOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint32_t len = ep->xfer_size - ep->xfer_count;
+  uint32_t prog;
+  uint32_t got;
+
+  if (ep->num == 0U)
+  {
+    prog = ep->maxpacket;
+  }
+  else
+  {
+    prog = ((len == 0U) ? 1U : ((len + ep->maxpacket - 1U) / ep->maxpacket)) * ep->maxpacket;
+  }
+  got = prog - (PCD_OUTEP(hpcd, ep->num)->DOEPTSIZ & USB_OTG_DOEPTSIZ_XFRSIZ);
+  if (got > len)
+  {
+    got = len;
+  }
+
+  if (PCD_EP0_BOUNCE(hpcd, ep) && (got != 0U))
+  {
+    memcpy(ep->xfer_buff, hpcd->EP0_Buf, got);
+  }
+  if (ep->xfer_buff != NULL)
+  {
+    ep->xfer_buff += got;
+  }
+  ep->xfer_count += got;
+
+#if (USB_STATS_ENABLED == 1) || (USB_TRACE_ENABLED == 1)
+  len = got;
+  do
+  {
+    USB_STATS_RX(ep->num, (len > ep->maxpacket) ? ep->maxpacket : len);
+    USB_TRACE_OUT(ep->num, (len > ep->maxpacket) ? ep->maxpacket : len);
+    len -= (len > ep->maxpacket) ? ep->maxpacket : len;
+  } while (len != 0U);
+#endif /* USB_STATS_ENABLED || USB_TRACE_ENABLED */
+}
+
+/**
+  * @brief  Enable or disable the TXFE interrupt of an IN endpoint.
+  * @note   DIEPEMPMSK is shared by all endpoints and this runs from thread
+  *         level as well, hence the critical section.
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @param  enable 1 to enable, 0 to disable
+  * @retval None
+  */
+static void PCD_SetEmptyIrq(PCD_HandleTypeDef *hpcd, uint8_t epnum, uint8_t enable)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (enable != 0U)
+  {
+    PCD_DEV(hpcd)->DIEPEMPMSK |= (1UL << epnum);
+  }
+  else
+  {
+    PCD_DEV(hpcd)->DIEPEMPMSK &= ~(1UL << epnum);
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Push one packet into the transmit FIFO of an endpoint, a word at
+  *         a time.
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @param  pSrc packet, any alignment
+  * @param  len packet length
+  * @retval None
+  */
+static void PCD_WriteFifo(PCD_HandleTypeDef *hpcd, uint8_t epnum, const uint8_t *pSrc, uint32_t len)
+{
+  __IO uint32_t *fifo = &PCD_DFIFO(hpcd, epnum);
+  uint32_t words = len >> 2;
+  uint32_t w;
+
+  USB_PROF_BEGIN(prof_fifo);
+
+  while (words-- != 0U)
+  {
+    memcpy(&w, pSrc, 4U);
+    *fifo = w;
+    pSrc += 4;
+  }
+
+  len &= 3U;
+  if (len != 0U)
+  {
+    w = 0U;
+    memcpy(&w, pSrc, len);
+    *fifo = w;
+  }
+
+  USB_PROF_END(USB_PROF_WRITE_PMA, epnum, prof_fifo);
+}
+
+/**
+  * @brief  Pop one packet from the receive FIFO, a word at a time.
+  * @param  hpcd PCD handle
+  * @param  pDest buffer, any alignment
+  * @param  len packet length, the whole of it leaves the FIFO
+  * @param  keep bytes to store, at most len
+  * @retval None
+  */
+static void PCD_ReadFifo(PCD_HandleTypeDef *hpcd, uint8_t *pDest, uint32_t len, uint32_t keep)
+{
+  __IO uint32_t *fifo = &PCD_DFIFO(hpcd, 0U);
+  uint32_t words = (len + 3U) >> 2;
+  uint32_t w;
+
+  USB_PROF_BEGIN(prof_fifo);
+
+  while (words-- != 0U)
+  {
+    w = *fifo;
+    if (keep >= 4U)
+    {
+      memcpy(pDest, &w, 4U);
+      pDest += 4;
+      keep -= 4U;
+    }
+    else if (keep != 0U)
+    {
+      memcpy(pDest, &w, keep);
+      keep = 0U;
+    }
+  }
+
+  USB_PROF_END(USB_PROF_READ_PMA, 0U, prof_fifo);
+}
+
+/**
+  * @brief  Drain the receive FIFO status queue.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+static void PCD_RxFifo_ISR_Handler(PCD_HandleTypeDef *hpcd)
+{
+  PCD_EPTypeDef *ep;
+  uint32_t sts;
+  uint32_t bcnt;
+  uint32_t keep;
+
+  while ((hpcd->Instance->GINTSTS & USB_OTG_GINTSTS_RXFLVL) != 0U)
+  {
+    sts = hpcd->Instance->GRXSTSP;
+    ep = &hpcd->OUT_ep[sts & USB_OTG_GRXSTSP_EPNUM];
+    bcnt = (sts & USB_OTG_GRXSTSP_BCNT) >> USB_OTG_GRXSTSP_BCNT_Pos;
+
+    switch ((sts & USB_OTG_GRXSTSP_PKTSTS) >> USB_OTG_GRXSTSP_PKTSTS_Pos)
+    {
+    case PCD_STS_DATA_UPDT:
+      /* never write past the end of the transfer buffer */
+      keep = ep->xfer_len - ep->xfer_count;
+      if ((keep > bcnt) || (ep->xfer_buff == NULL))
+      {
+        keep = (ep->xfer_buff == NULL) ? 0U : bcnt;
+      }
+      if (bcnt != 0U)
+      {
+        PCD_ReadFifo(hpcd, ep->xfer_buff, bcnt, keep);
+      }
+      if (ep->xfer_buff != NULL)
+      {
+        ep->xfer_buff += keep;
+      }
+      ep->xfer_count += keep;
+      USB_STATS_RX(ep->num, bcnt);
+      USB_TRACE_OUT(ep->num, bcnt);
+      break;
+
+    case PCD_STS_SETUP_UPDT:
+      /* Get SETUP Packet, processed on the STUP interrupt */
+      PCD_ReadFifo(hpcd, (uint8_t *)(void *)hpcd->Setup, bcnt, (bcnt > 8U) ? 8U : bcnt);
+      USB_STATS_RX(0U, bcnt);
+      break;
+
+    default:
+      /* global OUT NAK, transfer and setup complete: nothing to pop */
+      break;
+    }
+  }
+}
+
+/**
+  * @brief  Service of an IN endpoint interrupt.
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+static void PCD_IN_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USB_OTG_INEndpointTypeDef *inep = PCD_INEP(hpcd, epnum);
+  PCD_EPTypeDef *ep = &hpcd->IN_ep[epnum];
+  uint32_t msk;
+  uint32_t epint;
+
+  USB_PROF_BEGIN(prof_start);
+
+  msk = PCD_DEV(hpcd)->DIEPMSK | (((PCD_DEV(hpcd)->DIEPEMPMSK >> epnum) & 1U) << 7);
+  epint = inep->DIEPINT & msk;
+
+  if ((epint & USB_OTG_DIEPINT_XFRC) != 0U)
+  {
+    PCD_SetEmptyIrq(hpcd, epnum, 0U);
+    inep->DIEPINT = USB_OTG_DIEPINT_XFRC;
+    if (PCD_DMA(hpcd))
+    {
+      PCD_EP_DmaInDone(hpcd, ep);
+    }
+    PCD_EP_TxDone(hpcd, ep);
+  }
+
+  /* TOC, ITTXFE, INEPNE, EPDISD: acknowledge only */
+  inep->DIEPINT = epint & (USB_OTG_DIEPINT_TOC | USB_OTG_DIEPINT_ITTXFE |
+                           USB_OTG_DIEPINT_INEPNE | USB_OTG_DIEPINT_EPDISD);
+
+  if ((epint & USB_OTG_DIEPINT_TXFE) != 0U)
+  {
+    PCD_EP_TxFill(hpcd, ep);
+  }
+
+  USB_PROF_END(USB_PROF_EP_ISR, epnum, prof_start);
+}
+
+/**
+  * @brief  Service of an OUT endpoint interrupt.
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+static void PCD_OUT_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USB_OTG_OUTEndpointTypeDef *outep = PCD_OUTEP(hpcd, epnum);
+  uint32_t epint;
+  uint32_t stup;
+
+  USB_PROF_BEGIN(prof_start);
+
+  epint = outep->DOEPINT & PCD_DEV(hpcd)->DOEPMSK;
+
+  /* A status stage completing and the next SETUP may show up together:
+     the transfer goes first */
+  if ((epint & USB_OTG_DOEPINT_XFRC) != 0U)
+  {
+    outep->DOEPINT = USB_OTG_DOEPINT_XFRC;
+    if (PCD_DMA(hpcd))
+    {
+      PCD_EP_DmaOutDone(hpcd, &hpcd->OUT_ep[epnum]);
+    }
+    PCD_EP_RxDone(hpcd, &hpcd->OUT_ep[epnum]);
+  }
+
+  if ((epint & USB_OTG_DOEPINT_STUP) != 0U)
+  {
+    outep->DOEPINT = USB_OTG_DOEPINT_STUP;
+    if (PCD_DMA(hpcd))
+    {
+      /* back to back SETUP packets: the last one counts */
+      stup = 3U - ((outep->DOEPTSIZ & USB_OTG_DOEPTSIZ_STUPCNT) >> USB_OTG_DOEPTSIZ_STUPCNT_Pos);
+      if ((stup > 1U) && (stup <= 3U))
+      {
+        memmove(hpcd->Setup, &hpcd->Setup[2U * (stup - 1U)], 8U);
+      }
+      USB_STATS_RX(0U, 8U);
+    }
+    /* SETUP packet count back to 3 before the stage arms the endpoint */
+    PCD_EP0_OutStart(hpcd);
+    USB_TRACE_SETUP((uint8_t *)(void *)hpcd->Setup);
+    /* Process SETUP Packet*/
+    HAL_PCD_SetupStageCallback(hpcd);
+  }
+
+  outep->DOEPINT = epint & (USB_OTG_DOEPINT_OTEPDIS | USB_OTG_DOEPINT_EPDISD);
+
+  USB_PROF_END(USB_PROF_EP_ISR, epnum, prof_start);
+}
+
+/**
+  * @brief  Completion of an OUT transfer: endpoint handler or Data OUT stage
+  *         callback
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_DataOutDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if (ep->xfer_cb != NULL)
+  {
+    ep->xfer_cb(hpcd->pData, ep->num);
+  }
+  else
+  {
+    HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+  }
+}
+
+/**
+  * @brief  Completion of an IN transfer: endpoint handler or Data IN stage
+  *         callback
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_DataInDone(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  if (ep->xfer_cb != NULL)
+  {
+    ep->xfer_cb(hpcd->pData, ep->num);
+  }
+  else
+  {
+    HAL_PCD_DataInStageCallback(hpcd, ep->num);
+  }
+}
+/**
+  * @}
+  */
+
+/** @addtogroup PCD_Exported_Functions
+  * @{
+  */
+
+/** @defgroup PCD_Exported_Functions_Group2 IO operation functions
+ * @{
+ */
+
+/**
+  * @brief  This function handles PCD interrupt request.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
+{
+  USB_OTG_GlobalTypeDef *USBx = hpcd->Instance;
+  uint32_t gintsts;
+  uint32_t daint;
+  uint32_t t;
+  uint8_t epnum;
+
+  /* Host mode belongs to somebody else */
+  if ((USBx->GINTSTS & USB_OTG_GINTSTS_CMOD) != 0U)
+  {
+    return;
+  }
+
+  USB_PROF_BEGIN(prof_start);
+  /* as close to the SOF as it gets, before any servicing */
+  USB_TIMESYNC_BEGIN(sof_cycles);
+
+  gintsts = USBx->GINTSTS & USBx->GINTMSK;
+
+  if ((gintsts & USB_OTG_GINTSTS_MMIS) != 0U)
+  {
+    USBx->GINTSTS = USB_OTG_GINTSTS_MMIS;
+    USB_STATS_EVENT(errors);
+  }
+
+  /* OUT data and SETUP packets, before the transfer complete interrupts
+     they lead to */
+  if ((gintsts & USB_OTG_GINTSTS_RXFLVL) != 0U)
+  {
+    PCD_RxFifo_ISR_Handler(hpcd);
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_OEPINT) != 0U)
+  {
+    daint = (PCD_DEV(hpcd)->DAINT & PCD_DEV(hpcd)->DAINTMSK) >> 16;
+    for (epnum = 0U; daint != 0U; epnum++, daint >>= 1)
+    {
+      if ((daint & 1U) != 0U)
+      {
+        PCD_OUT_EP_ISR_Handler(hpcd, epnum);
+      }
+    }
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_IEPINT) != 0U)
+  {
+    daint = PCD_DEV(hpcd)->DAINT & PCD_DEV(hpcd)->DAINTMSK & 0xFFFFU;
+    for (epnum = 0U; daint != 0U; epnum++, daint >>= 1)
+    {
+      if ((daint & 1U) != 0U)
+      {
+        PCD_IN_EP_ISR_Handler(hpcd, epnum);
+      }
+    }
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_WKUINT) != 0U)
+  {
+    PCD_DEV(hpcd)->DCTL &= ~USB_OTG_DCTL_RWUSIG;
+    PCD_PCGCCTL(hpcd) &= ~USB_OTG_PCGCCTL_STOPCLK;
+    USB_TRACE_EVENT(USB_TRACE_EVT_RESUME);
+    HAL_PCD_ResumeCallback(hpcd);
+    USBx->GINTSTS = USB_OTG_GINTSTS_WKUINT;
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_USBSUSP) != 0U)
+  {
+    if ((PCD_DEV(hpcd)->DSTS & USB_OTG_DSTS_SUSPSTS) != 0U)
+    {
+      USB_TIMESYNC_RESET();
+      USB_STATS_EVENT(suspends);
+      USB_TRACE_EVENT(USB_TRACE_EVT_SUSPEND);
+      HAL_PCD_SuspendCallback(hpcd);
+      if (hpcd->Init.low_power_enable == ENABLE)
+      {
+        PCD_PCGCCTL(hpcd) |= USB_OTG_PCGCCTL_STOPCLK;
+      }
+    }
+    USBx->GINTSTS = USB_OTG_GINTSTS_USBSUSP;
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_USBRST) != 0U)
+  {
+    PCD_DEV(hpcd)->DCTL &= ~USB_OTG_DCTL_RWUSIG;
+    PCD_FlushTxFifo(hpcd, PCD_ALL_TX_FIFOS);
+    PCD_DEV(hpcd)->DIEPEMPMSK = 0U;
+
+    for (epnum = 0U; epnum < hpcd->Init.dev_endpoints; epnum++)
+    {
+      PCD_INEP(hpcd, epnum)->DIEPINT = 0xFB7FU;
+      PCD_INEP(hpcd, epnum)->DIEPCTL &= ~USB_OTG_DIEPCTL_STALL;
+      PCD_OUTEP(hpcd, epnum)->DOEPINT = 0xFB7FU;
+      PCD_OUTEP(hpcd, epnum)->DOEPCTL &= ~USB_OTG_DOEPCTL_STALL;
+      PCD_OUTEP(hpcd, epnum)->DOEPCTL |= USB_OTG_DOEPCTL_SNAK;
+    }
+    PCD_DEV(hpcd)->DAINTMSK |= 0x10001U;
+    PCD_DEV(hpcd)->DOEPMSK = USB_OTG_DOEPMSK_STUPM | USB_OTG_DOEPMSK_XFRCM |
+                             USB_OTG_DOEPMSK_EPDM | USB_OTG_DOEPMSK_OTEPDM;
+    PCD_DEV(hpcd)->DIEPMSK = USB_OTG_DIEPMSK_TOM | USB_OTG_DIEPMSK_XFRCM |
+                             USB_OTG_DIEPMSK_EPDM;
+
+    /* Address 0 until the host sets one */
+    PCD_DEV(hpcd)->DCFG &= ~USB_OTG_DCFG_DAD;
+    PCD_EP0_OutStart(hpcd);
+
+    USB_TIMESYNC_RESET();
+    USB_STATS_EVENT(resets);
+    USB_TRACE_EVENT(USB_TRACE_EVT_RESET);
+    USB_ENUMBENCH_MARK(USB_ENUMBENCH_RESET);
+    USBx->GINTSTS = USB_OTG_GINTSTS_USBRST;
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_ENUMDNE) != 0U)
+  {
+    /* The stack opens endpoint 0 from the reset callback */
+    PCD_DEV(hpcd)->DCTL |= USB_OTG_DCTL_CGINAK;
+    if ((PCD_DEV(hpcd)->DSTS & USB_OTG_DSTS_ENUMSPD) == 0U)
+    {
+      hpcd->Init.speed = PCD_SPEED_HIGH;
+      PCD_SetTurnaround(hpcd, 1U);
+    }
+    else
+    {
+      hpcd->Init.speed = PCD_SPEED_FULL;
+      PCD_SetTurnaround(hpcd, 0U);
+    }
+    HAL_PCD_ResetCallback(hpcd);
+    USBx->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_SOF) != 0U)
+  {
+    USBx->GINTSTS = USB_OTG_GINTSTS_SOF;
+#if (USB_TIMESYNC_ENABLED == 1)
+    /* at high speed FNSOF counts microframes: one SOF per frame */
+    if (hpcd->Init.speed != PCD_SPEED_HIGH)
+    {
+      USB_TIMESYNC_SOF(PCD_FRAME_NUMBER(hpcd), sof_cycles);
+    }
+    else if ((PCD_FRAME_NUMBER(hpcd) & 7U) == 0U)
+    {
+      USB_TIMESYNC_SOF(PCD_FRAME_NUMBER(hpcd) >> 3, sof_cycles);
+    }
+#endif /* USB_TIMESYNC_ENABLED */
+    HAL_PCD_SOFCallback(hpcd);
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_IISOIXFR) != 0U)
+  {
+    USBx->GINTSTS = USB_OTG_GINTSTS_IISOIXFR;
+    HAL_PCD_ISOINIncompleteCallback(hpcd, 0U);
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_PXFR_INCOMPISOOUT) != 0U)
+  {
+    USBx->GINTSTS = USB_OTG_GINTSTS_PXFR_INCOMPISOOUT;
+    HAL_PCD_ISOOUTIncompleteCallback(hpcd, 0U);
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_SRQINT) != 0U)
+  {
+    USBx->GINTSTS = USB_OTG_GINTSTS_SRQINT;
+    HAL_PCD_ConnectCallback(hpcd);
+  }
+
+  if ((gintsts & USB_OTG_GINTSTS_OTGINT) != 0U)
+  {
+    t = USBx->GOTGINT;
+    if ((t & USB_OTG_GOTGINT_SEDET) != 0U)
+    {
+      HAL_PCD_DisconnectCallback(hpcd);
+    }
+    USBx->GOTGINT = t;
+  }
+
+  USB_PROF_END(USB_PROF_IRQ, 0U, prof_start);
+}
+
+/**
+  * @brief  Data out stage callbacks
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+ __weak void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(epnum);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_DataOutStageCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Data IN stage callbacks
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+ __weak void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(epnum);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_DataInStageCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Setup stage callback
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_SetupStageCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  USB Start Of Frame callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_SOFCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  USB Reset callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_ResetCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Suspend event callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_SuspendCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Resume event callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_ResumeCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_ResumeCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Incomplete ISO OUT callbacks
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+ __weak void HAL_PCD_ISOOUTIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(epnum);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_ISOOUTIncompleteCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Incomplete ISO IN  callbacks
+  * @param  hpcd PCD handle
+  * @param  epnum endpoint number
+  * @retval None
+  */
+ __weak void HAL_PCD_ISOINIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(epnum);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_ISOINIncompleteCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Connection event callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_ConnectCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_ConnectCallback could be implemented in the user file
+   */
+}
+
+/**
+  * @brief  Disconnection event callbacks
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+ __weak void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+
+  /* NOTE : This function should not be modified, when the callback is needed,
+            the HAL_PCD_DisconnectCallback could be implemented in the user file
+   */
+}
+/**
+  * @}
+  */
+
+/** @defgroup PCD_Exported_Functions_Group3 Peripheral Control functions
+ *  @brief   management functions
+ *
+@verbatim
+ ===============================================================================
+                      ##### Peripheral Control functions #####
+ ===============================================================================
+    [..]
+    This subsection provides a set of functions allowing to control the PCD data
+    transfers.
+
+@endverbatim
+  * @{
+  */
+
+/**
+  * @brief  Connect the USB device
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_DevConnect(PCD_HandleTypeDef *hpcd)
+{
+  __HAL_LOCK(hpcd);
+
+  PCD_DEV(hpcd)->DCTL &= ~USB_OTG_DCTL_SDIS;
+  HAL_PCDEx_SetConnectionState(hpcd, 1U);
+  USB_ENUMBENCH_CONNECTED();
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Disconnect the USB device
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_DevDisconnect(PCD_HandleTypeDef *hpcd)
+{
+  __HAL_LOCK(hpcd);
+
+  PCD_DEV(hpcd)->DCTL |= USB_OTG_DCTL_SDIS;
+  HAL_PCDEx_SetConnectionState(hpcd, 0U);
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Set the USB Device address
+  * @note   The core keeps answering on the old address until the status
+  *         stage of SET_ADDRESS is over, so the new one is set right away.
+  * @param  hpcd PCD handle
+  * @param  address new device address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd, uint8_t address)
+{
+  __HAL_LOCK(hpcd);
+
+  hpcd->USB_Address = address;
+  PCD_DEV(hpcd)->DCFG = (PCD_DEV(hpcd)->DCFG & ~USB_OTG_DCFG_DAD) |
+                        (((uint32_t)address << USB_OTG_DCFG_DAD_Pos) & USB_OTG_DCFG_DAD);
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Open and configure an endpoint
+  * @note   IN endpoint n transmits from FIFO n, sized beforehand with
+  *         HAL_PCDEx_SetTxFiFo.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  ep_mps endpoint max packet size
+  * @param  ep_type endpoint type
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint16_t ep_mps, uint8_t ep_type)
+{
+  PCD_EPTypeDef *ep;
+  uint32_t ctl;
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+  }
+  ep->num   = ep_addr & 0x7FU;
+
+  ep->is_in = (0x80U & ep_addr) != 0U;
+  ep->maxpacket = ep_mps;
+  ep->type = ep_type;
+  ep->xfer_cb = NULL;
+
+  __HAL_LOCK(hpcd);
+
+  if (ep->is_in)
+  {
+    PCD_DEV(hpcd)->DAINTMSK |= (1UL << ep->num);
+    ctl = PCD_INEP(hpcd, ep->num)->DIEPCTL;
+
+    if (ep->num == 0U)
+    {
+      /* Encoded size, shared with the OUT direction */
+      PCD_INEP(hpcd, 0U)->DIEPCTL = (ctl & ~USB_OTG_DIEPCTL_MPSIZ) | PCD_EP0_MPSIZ(ep_mps);
+    }
+    else if ((ctl & USB_OTG_DIEPCTL_USBAEP) == 0U)
+    {
+      PCD_INEP(hpcd, ep->num)->DIEPCTL = ctl | (ep_mps & USB_OTG_DIEPCTL_MPSIZ) |
+                                         ((uint32_t)ep_type << USB_OTG_DIEPCTL_EPTYP_Pos) |
+                                         ((uint32_t)ep->num << USB_OTG_DIEPCTL_TXFNUM_Pos) |
+                                         USB_OTG_DIEPCTL_SD0PID_SEVNFRM | USB_OTG_DIEPCTL_USBAEP;
+    }
+  }
+  else
+  {
+    PCD_DEV(hpcd)->DAINTMSK |= (1UL << (16U + ep->num));
+    ctl = PCD_OUTEP(hpcd, ep->num)->DOEPCTL;
+
+    if ((ep->num != 0U) && ((ctl & USB_OTG_DOEPCTL_USBAEP) == 0U))
+    {
+      PCD_OUTEP(hpcd, ep->num)->DOEPCTL = ctl | (ep_mps & USB_OTG_DOEPCTL_MPSIZ) |
+                                          ((uint32_t)ep_type << USB_OTG_DOEPCTL_EPTYP_Pos) |
+                                          USB_OTG_DOEPCTL_SD0PID_SEVNFRM | USB_OTG_DOEPCTL_USBAEP;
+    }
+  }
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Deactivate an endpoint
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  PCD_EPTypeDef *ep;
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+  }
+  ep->num   = ep_addr & 0x7FU;
+
+  ep->is_in = (0x80U & ep_addr) != 0U;
+  ep->xfer_cb = NULL;
+
+  __HAL_LOCK(hpcd);
+
+  if (ep->is_in)
+  {
+    if ((PCD_INEP(hpcd, ep->num)->DIEPCTL & USB_OTG_DIEPCTL_EPENA) != 0U)
+    {
+      PCD_INEP(hpcd, ep->num)->DIEPCTL |= USB_OTG_DIEPCTL_SNAK | USB_OTG_DIEPCTL_EPDIS;
+    }
+    PCD_SetEmptyIrq(hpcd, ep->num, 0U);
+    PCD_DEV(hpcd)->DAINTMSK &= ~(1UL << ep->num);
+    PCD_INEP(hpcd, ep->num)->DIEPCTL &= ~(USB_OTG_DIEPCTL_USBAEP | USB_OTG_DIEPCTL_MPSIZ |
+                                          USB_OTG_DIEPCTL_TXFNUM | USB_OTG_DIEPCTL_SD0PID_SEVNFRM |
+                                          USB_OTG_DIEPCTL_EPTYP);
+  }
+  else
+  {
+    if ((PCD_OUTEP(hpcd, ep->num)->DOEPCTL & USB_OTG_DOEPCTL_EPENA) != 0U)
+    {
+      PCD_OUTEP(hpcd, ep->num)->DOEPCTL |= USB_OTG_DOEPCTL_SNAK | USB_OTG_DOEPCTL_EPDIS;
+    }
+    PCD_DEV(hpcd)->DAINTMSK &= ~(1UL << (16U + ep->num));
+    PCD_OUTEP(hpcd, ep->num)->DOEPCTL &= ~(USB_OTG_DOEPCTL_USBAEP | USB_OTG_DOEPCTL_MPSIZ |
+                                           USB_OTG_DOEPCTL_SD0PID_SEVNFRM | USB_OTG_DOEPCTL_EPTYP);
+  }
+
+  __HAL_UNLOCK(hpcd);
+  return HAL_OK;
+}
+
+/**
+  * @brief  Receive an amount of data
+  * @note   Packets are always copied out of the receive FIFO: a NULL pBuf is
+  *         only accepted for a zero length transfer. In DMA mode pBuf must
+  *         be word aligned, endpoint 0 aside.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  pBuf pointer to the reception buffer
+  * @param  len amount of data to be received
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, uint8_t *pBuf, uint32_t len)
+{
+  PCD_EPTypeDef *ep;
+
+  if ((pBuf == NULL) && (len != 0U))
+  {
+    return HAL_ERROR;
+  }
+  if (PCD_DMA(hpcd) && ((ep_addr & 0x7FU) != 0U) && ((((uint32_t)pBuf) & 3U) != 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+
+  /*setup and start the Xfer */
+  ep->xfer_buff = pBuf;
+  ep->xfer_len = len;
+  ep->xfer_count = 0U;
+  ep->is_in = 0U;
+  ep->num = ep_addr & 0x7FU;
+
+  USB_STATS_OUT_ARMED(ep->num, PCD_FRAME_NUMBER(hpcd));
+  PCD_EP_StartOut(hpcd, ep);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Get Received Data Size
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval Data Size
+  */
+uint16_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  return hpcd->OUT_ep[ep_addr & 0x7FU].xfer_count;
+}
+
+/**
+  * @brief  Send an amount of data
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  pBuf pointer to the transmission buffer, left untouched until the
+  *         transfer completes. In DMA mode it must be word aligned,
+  *         endpoint 0 aside.
+  * @param  len amount of data to be sent
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, const uint8_t *pBuf, uint32_t len)
+{
+  PCD_EPTypeDef *ep;
+
+  if (PCD_DMA(hpcd) && ((ep_addr & 0x7FU) != 0U) && ((((uint32_t)pBuf) & 3U) != 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+
+  /*setup and start the Xfer */
+  ep->xfer_buff = (uint8_t *) pBuf;
+  ep->xfer_len = len;
+  ep->xfer_count = 0U;
+  ep->is_in = 1U;
+  ep->num = ep_addr & 0x7FU;
+
+  PCD_EP_StartIn(hpcd, ep);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Set a STALL condition over an endpoint
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  PCD_EPTypeDef *ep;
+  uint32_t ctl;
+
+  __HAL_LOCK(hpcd);
+
+  if ((0x80U & ep_addr) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+  }
+
+  ep->is_stall = 1U;
+  ep->num   = ep_addr & 0x7FU;
+  ep->is_in = ((ep_addr & 0x80U) == 0x80U);
+
+  if (ep->is_in)
+  {
+    ctl = PCD_INEP(hpcd, ep->num)->DIEPCTL;
+    if (((ctl & USB_OTG_DIEPCTL_EPENA) == 0U) && (ep->num != 0U))
+    {
+      ctl &= ~USB_OTG_DIEPCTL_EPDIS;
+    }
+    PCD_INEP(hpcd, ep->num)->DIEPCTL = ctl | USB_OTG_DIEPCTL_STALL;
+  }
+  else
+  {
+    ctl = PCD_OUTEP(hpcd, ep->num)->DOEPCTL;
+    if (((ctl & USB_OTG_DOEPCTL_EPENA) == 0U) && (ep->num != 0U))
+    {
+      ctl &= ~USB_OTG_DOEPCTL_EPDIS;
+    }
+    PCD_OUTEP(hpcd, ep->num)->DOEPCTL = ctl | USB_OTG_DOEPCTL_STALL;
+  }
+
+  if (ep->num == 0U)
+  {
+    /* the next SETUP clears the stall */
+    PCD_EP0_OutStart(hpcd);
+  }
+
+  __HAL_UNLOCK(hpcd);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Clear a STALL condition over in an endpoint
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  PCD_EPTypeDef *ep;
+
+  if ((0x80U & ep_addr) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr & 0x7FU];
+  }
+
+  ep->is_stall = 0U;
+  ep->num   = ep_addr & 0x7FU;
+  ep->is_in = ((ep_addr & 0x80U) == 0x80U);
+
+  __HAL_LOCK(hpcd);
+
+  /* Data toggle back to DATA0 */
+  if (ep->is_in)
+  {
+    PCD_INEP(hpcd, ep->num)->DIEPCTL &= ~USB_OTG_DIEPCTL_STALL;
+    if ((ep->type == PCD_EP_TYPE_INTR) || (ep->type == PCD_EP_TYPE_BULK))
+    {
+      PCD_INEP(hpcd, ep->num)->DIEPCTL |= USB_OTG_DIEPCTL_SD0PID_SEVNFRM;
+    }
+  }
+  else
+  {
+    PCD_OUTEP(hpcd, ep->num)->DOEPCTL &= ~USB_OTG_DOEPCTL_STALL;
+    if ((ep->type == PCD_EP_TYPE_INTR) || (ep->type == PCD_EP_TYPE_BULK))
+    {
+      PCD_OUTEP(hpcd, ep->num)->DOEPCTL |= USB_OTG_DOEPCTL_SD0PID_SEVNFRM;
+    }
+  }
+
+  __HAL_UNLOCK(hpcd);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Flush an endpoint
+  * @note   The receive FIFO is shared: flushing an OUT endpoint drops what
+  *         is queued for all of them.
+  * @note   An IN transfer under way is disabled before its FIFO is
+  *         flushed, and its pending XFRC cleared: it is not called back.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_EP_Flush(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  USB_OTG_INEndpointTypeDef *inep;
+  PCD_EPTypeDef *ep;
+  uint32_t primask;
+  uint32_t count = 0U;
+
+  __HAL_LOCK(hpcd);
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+    inep = PCD_INEP(hpcd, ep->num);
+
+    /* the completion of the transfer must not run half way through */
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((inep->DIEPCTL & USB_OTG_DIEPCTL_EPENA) != 0U)
+    {
+      inep->DIEPCTL |= USB_OTG_DIEPCTL_SNAK;
+      while (((inep->DIEPINT & USB_OTG_DIEPINT_INEPNE) == 0U) && (++count < PCD_CORE_TIMEOUT))
+      {
+      }
+      inep->DIEPCTL |= USB_OTG_DIEPCTL_SNAK | USB_OTG_DIEPCTL_EPDIS;
+      count = 0U;
+      while (((inep->DIEPINT & USB_OTG_DIEPINT_EPDISD) == 0U) && (++count < PCD_CORE_TIMEOUT))
+      {
+      }
+    }
+    PCD_FlushTxFifo(hpcd, ep->num);
+    PCD_SetEmptyIrq(hpcd, ep->num, 0U);
+    inep->DIEPINT = USB_OTG_DIEPINT_XFRC | USB_OTG_DIEPINT_INEPNE | USB_OTG_DIEPINT_EPDISD;
+    ep->xfer_len = 0U;
+    ep->xfer_count = 0U;
+
+    __set_PRIMASK(primask);
+  }
+  else
+  {
+    PCD_FlushRxFifo(hpcd);
+  }
+
+  __HAL_UNLOCK(hpcd);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  HAL_PCD_ActivateRemoteWakeup : active remote wakeup signalling
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_ActivateRemoteWakeup(PCD_HandleTypeDef *hpcd)
+{
+  PCD_PCGCCTL(hpcd) &= ~USB_OTG_PCGCCTL_STOPCLK;
+  PCD_DEV(hpcd)->DCTL |= USB_OTG_DCTL_RWUSIG;
+  return HAL_OK;
+}
+
+/**
+  * @brief  HAL_PCD_DeActivateRemoteWakeup : de-active remote wakeup signalling
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_DeActivateRemoteWakeup(PCD_HandleTypeDef *hpcd)
+{
+  PCD_DEV(hpcd)->DCTL &= ~USB_OTG_DCTL_RWUSIG;
+  return HAL_OK;
+}
+
+/**
+  * @brief  Signal remote wakeup for PCD_REMOTE_WAKEUP_MS ms
+  * @note   The OTG core has no frame timer running while suspended, so
+  *         unlike the FS device driver this one waits with HAL_Delay: call
+  *         it from thread level. HAL_PCD_ResumeCallback follows.
+  * @param  hpcd PCD handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCD_StartRemoteWakeup(PCD_HandleTypeDef *hpcd)
+{
+  if ((PCD_DEV(hpcd)->DSTS & USB_OTG_DSTS_SUSPSTS) == 0U)
+  {
+    return HAL_ERROR;
+  }
+
+  HAL_PCD_ActivateRemoteWakeup(hpcd);
+  HAL_Delay(PCD_REMOTE_WAKEUP_MS);
+  HAL_PCD_DeActivateRemoteWakeup(hpcd);
+  HAL_PCD_ResumeCallback(hpcd);
+
+  return HAL_OK;
+}
+
+/**
+  * @}
+  */
+
+/** @defgroup PCD_Exported_Functions_Group4 Peripheral State functions
+ *  @brief   Peripheral State functions
+ *
+@verbatim
+ ===============================================================================
+                      ##### Peripheral State functions #####
+ ===============================================================================
+    [..]
+    This subsection permits to get in run-time the status of the peripheral
+    and the data flow.
+
+@endverbatim
+  * @{
+  */
+
+/**
+  * @brief  Return the PCD state
+  * @param  hpcd PCD handle
+  * @retval HAL state
+  */
+PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd)
+{
+  return hpcd->State;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_OTG_FS */
+
+#endif /* HAL_PCD_MODULE_ENABLED */
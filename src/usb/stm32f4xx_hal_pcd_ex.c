@@ -0,0 +1,372 @@
+/**
+  ******************************************************************************
+  * @file    stm32f4xx_hal_pcd_ex.c
+  * @brief   Extended PCD driver for the STM32F4 OTG_FS and OTG_HS cores.
+  *          This file provides firmware functions to manage the following
+  *          functionalities of the USB Peripheral Controller:
+  *           + Split of the FIFO RAM between the receive FIFO and the
+  *             transmit FIFOs
+  *           + Endpoint completion handlers
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+#ifdef HAL_PCD_MODULE_ENABLED
+
+#if defined(USB_OTG_FS)
+
+/** @addtogroup STM32F4xx_HAL_Driver
+  * @{
+  */
+
+/** @defgroup PCDEx PCDEx
+  * @brief PCD Extended HAL module driver
+  * @{
+  */
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* FIFO RAM of the core behind a handle, in words */
+#if defined(USB_OTG_HS)
+#define PCDEx_FIFO_TOTAL(hpcd)          (((hpcd)->Instance == USB_OTG_HS) ? \
+                                         PCDEx_HS_FIFO_WORDS : PCDEx_FIFO_WORDS)
+#else
+#define PCDEx_FIFO_TOTAL(hpcd)          PCDEx_FIFO_WORDS
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static HAL_StatusTypeDef PCDEx_UpdateInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it, uint32_t value);
+/* Exported functions ---------------------------------------------------------*/
+
+/** @defgroup PCDEx_Exported_Functions PCDEx Exported Functions
+  * @{
+  */
+
+/** @defgroup PCDEx_Exported_Functions_Group1 Peripheral Control functions
+  * @brief    PCDEx control functions
+  *
+@verbatim
+ ===============================================================================
+              ##### Extended Peripheral Control functions #####
+ ===============================================================================
+    [..]  This section provides functions allowing to:
+      (+) Split the FIFO RAM
+      (+) Route endpoint completions to a handler
+      (+) Enable or disable the optional interrupts
+
+@endverbatim
+  * @{
+  */
+
+/**
+  * @brief  Set the receive FIFO size
+  * @note   Call after HAL_PCD_Init and before HAL_PCDEx_SetTxFiFo: the
+  *         transmit FIFOs are placed after it.
+  * @param  hpcd PCD handle
+  * @param  size receive FIFO size in words, see PCDEx_RX_FIFO_WORDS
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_SetRxFiFo(PCD_HandleTypeDef *hpcd, uint16_t size)
+{
+  if ((size < PCDEx_TX_FIFO_MIN_WORDS) || (size > PCDEx_FIFO_TOTAL(hpcd)))
+  {
+    return HAL_ERROR;
+  }
+
+  hpcd->Instance->GRXFSIZ = size;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Set the size of a transmit FIFO
+  * @note   FIFO n serves IN endpoint n. Sizes are set in FIFO order, from
+  *         FIFO 0: each one starts where the previous one ends.
+  * @param  hpcd PCD handle
+  * @param  fifo FIFO number
+  * @param  size FIFO size in words, see PCDEx_TX_FIFO_WORDS
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_SetTxFiFo(PCD_HandleTypeDef *hpcd, uint8_t fifo, uint16_t size)
+{
+  USB_OTG_GlobalTypeDef *USBx = hpcd->Instance;
+  uint32_t offset;
+  uint8_t i;
+
+  if ((size < PCDEx_TX_FIFO_MIN_WORDS) || (fifo >= hpcd->Init.dev_endpoints))
+  {
+    return HAL_ERROR;
+  }
+
+  /* FIFO 0 follows the receive FIFO, FIFO n follows FIFO n - 1 */
+  offset = USBx->GRXFSIZ;
+  if (fifo != 0U)
+  {
+    offset += USBx->DIEPTXF0_HNPTXFSIZ >> 16;
+    for (i = 0U; i < (fifo - 1U); i++)
+    {
+      offset += USBx->DIEPTXF[i] >> 16;
+    }
+  }
+
+  if ((offset + size) > PCDEx_FIFO_TOTAL(hpcd))
+  {
+    return HAL_ERROR;
+  }
+
+  if (fifo == 0U)
+  {
+    USBx->DIEPTXF0_HNPTXFSIZ = ((uint32_t)size << 16) | offset;
+  }
+  else
+  {
+    USBx->DIEPTXF[fifo - 1U] = ((uint32_t)size << 16) | offset;
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Configure PMA for EP
+  * @note   No packet memory to allocate on this core, the FIFOs are split
+  *         with HAL_PCDEx_SetRxFiFo and HAL_PCDEx_SetTxFiFo. Kept so that
+  *         the same usbd_conf.c builds for both cores.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  ep_kind endpoint Kind
+  * @param  pmaadress unused
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
+                                     uint16_t ep_addr,
+                                     uint16_t ep_kind,
+                                     uint32_t pmaadress)
+{
+  UNUSED(hpcd);
+  UNUSED(ep_addr);
+  UNUSED(ep_kind);
+  UNUSED(pmaadress);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Copy part of the packet left in PMA by a zero-copy OUT transfer
+  * @note   OUT packets are always popped into the transfer buffer on this
+  *         core, there is never a packet to view.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to copy
+  * @param  pBuf pointer to user memory area
+  * @param  len number of bytes to copy
+  * @retval HAL_ERROR
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxView(PCD_HandleTypeDef *hpcd,
+                                          uint8_t ep_addr,
+                                          uint16_t offset,
+                                          uint8_t *pBuf,
+                                          uint16_t len)
+{
+  UNUSED(hpcd);
+  UNUSED(ep_addr);
+  UNUSED(offset);
+  UNUSED(pBuf);
+  UNUSED(len);
+
+  return HAL_ERROR;
+}
+
+/**
+  * @brief  Convert samples of the packet left in PMA by a zero-copy OUT
+  *         transfer
+  * @note   No packet memory on this core, see HAL_PCDEx_EP_ReadRxView.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to convert
+  * @param  pDst q15 destination block
+  * @param  count number of samples
+  * @param  gain q15 gain
+  * @retval HAL_ERROR
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamples(PCD_HandleTypeDef *hpcd,
+                                             uint8_t ep_addr,
+                                             uint16_t offset,
+                                             int16_t *pDst,
+                                             uint16_t count,
+                                             int32_t gain)
+{
+  UNUSED(hpcd);
+  UNUSED(ep_addr);
+  UNUSED(offset);
+  UNUSED(pDst);
+  UNUSED(count);
+  UNUSED(gain);
+
+  return HAL_ERROR;
+}
+
+/**
+  * @brief  Convert samples of the packet left in PMA by a zero-copy OUT
+  *         transfer to float
+  * @note   No packet memory on this core, see HAL_PCDEx_EP_ReadRxView.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  offset first byte of the packet to convert
+  * @param  pDst float destination block
+  * @param  count number of samples
+  * @param  scale factor applied to every sample
+  * @retval HAL_ERROR
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_ReadRxSamplesF32(PCD_HandleTypeDef *hpcd,
+                                                uint8_t ep_addr,
+                                                uint16_t offset,
+                                                float *pDst,
+                                                uint16_t count,
+                                                float scale)
+{
+  UNUSED(hpcd);
+  UNUSED(ep_addr);
+  UNUSED(offset);
+  UNUSED(pDst);
+  UNUSED(count);
+  UNUSED(scale);
+
+  return HAL_ERROR;
+}
+
+/**
+  * @brief  Route the transfer completions of an endpoint straight to a
+  *         handler instead of HAL_PCD_DataOutStageCallback and
+  *         HAL_PCD_DataInStageCallback.
+  * @note   Must be called after HAL_PCD_EP_Open, which clears the handler.
+  *         The handler gets the pData member of the PCD handle and the
+  *         endpoint number, from interrupt context.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @param  callback completion handler, NULL to restore the callbacks
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EP_SetCallback(PCD_HandleTypeDef *hpcd,
+                                           uint8_t ep_addr,
+                                           PCD_EPCallbackTypeDef callback)
+{
+  PCD_EPTypeDef *ep;
+
+  if ((ep_addr & 0x7FU) == 0U)
+  {
+    /* the control endpoint always goes through the stack */
+    return HAL_ERROR;
+  }
+
+  if ((ep_addr & 0x80U) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & 0x7FU];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr];
+  }
+
+  ep->xfer_cb = callback;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Enable optional PCD interrupts at run time
+  * @note   Without PCD_IT_SOF HAL_PCD_SOFCallback is never called: classes
+  *         that count frames (USBD_CDC_TX_FLUSH_FRAMES, USBD_CDC_TX_SCHED) need it.
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to enable
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_EnableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it)
+{
+  return PCDEx_UpdateInterrupts(hpcd, it, it);
+}
+
+/**
+  * @brief  Disable optional PCD interrupts at run time
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to disable
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_PCDEx_DisableInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it)
+{
+  return PCDEx_UpdateInterrupts(hpcd, it, 0U);
+}
+
+/**
+  * @brief  Software Device Connection
+  * @note   The core drives the DP pull-up itself: only boards with an
+  *         extra external pull-up need this one.
+  * @param  hpcd PCD handle
+  * @param  state Device state
+  * @retval None
+  */
+ __weak void HAL_PCDEx_SetConnectionState(PCD_HandleTypeDef *hpcd, uint8_t state)
+{
+  /* Prevent unused argument(s) compilation warning */
+  UNUSED(hpcd);
+  UNUSED(state);
+
+  /* NOTE : This function Should not be modified, when the callback is needed,
+            the HAL_PCDEx_SetConnectionState could be implemented in the user file
+   */
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup PCDEx_Private_Functions PCD Extended Private Functions
+  * @{
+  */
+/**
+  * @brief  Set the GINTMSK bits of it to the matching bits of value
+  * @note   Callable from thread level and from interrupts alike, hence the
+  *         critical section around the read-modify-write.
+  * @param  hpcd PCD handle
+  * @param  it PCD_IT_xxx flags to change
+  * @param  value new state of those flags
+  * @retval HAL status
+  */
+static HAL_StatusTypeDef PCDEx_UpdateInterrupts(PCD_HandleTypeDef *hpcd, uint32_t it, uint32_t value)
+{
+  uint32_t primask;
+
+  if ((it & ~PCD_IT_ALL) != 0U)
+  {
+    return HAL_ERROR;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hpcd->Instance->GINTMSK = (hpcd->Instance->GINTMSK & ~it) | (value & it);
+  __set_PRIMASK(primask);
+
+  return HAL_OK;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_OTG_FS */
+
+#endif /* HAL_PCD_MODULE_ENABLED */
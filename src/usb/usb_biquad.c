@@ -0,0 +1,263 @@
+/**
+  ******************************************************************************
+  * @file    usb_biquad.c
+  * @brief   Biquad cascades over interleaved blocks, see usb_biquad.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_conf.h"
+#include "usb_biquad.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Biquad
+  * @{
+  */
+
+/** @defgroup USB_Biquad_Private_Defines
+  * @{
+  */
+/* Packed kernel needs the DSP extension */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 0x04U)
+#define USB_BIQUAD_SIMD                             1
+#else
+#define USB_BIQUAD_SIMD                             0
+#endif
+
+#define USB_BIQUAD_ALIGNED(p)                       ((((uint32_t)(p)) & 0x3U) == 0U)
+/**
+  * @}
+  */
+
+/** @defgroup USB_Biquad_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Saturate to the int16 range
+  * @param  v: value
+  * @retval saturated value
+  */
+static inline int16_t USB_Biquad_Sat(int64_t v)
+{
+  if (v > 32767)
+  {
+    return 32767;
+  }
+  if (v < -32768)
+  {
+    return -32768;
+  }
+  return (int16_t)v;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Biquad_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up a float cascade and clear its state
+  * @param  S: cascade
+  * @param  numStages: second order stages
+  * @param  numChannels: samples per frame
+  * @param  coeffStride: 0 for one coefficient set, 5 * numStages for one
+  *         per channel
+  * @param  pCoeffs: b0 b1 b2 a1 a2 per stage
+  * @param  pState: 2 * numStages * numChannels values
+  * @retval None
+  */
+void USB_Biquad_Init_f32(USB_Biquad_F32TypeDef *S, uint8_t numStages,
+                         uint8_t numChannels, uint16_t coeffStride,
+                         const float *pCoeffs, float *pState)
+{
+  S->numStages = numStages;
+  S->numChannels = numChannels;
+  S->coeffStride = coeffStride;
+  S->pCoeffs = pCoeffs;
+  S->pState = pState;
+  memset(pState, 0, 2U * numStages * numChannels * sizeof(float));
+}
+
+/**
+  * @brief  Filter a block of interleaved frames, transposed direct form II
+  * @param  S: cascade
+  * @param  pSrc: frames of numChannels samples
+  * @param  pDst: filtered frames, may be pSrc
+  * @param  frames: number of frames
+  * @retval None
+  */
+void USB_Biquad_f32(const USB_Biquad_F32TypeDef *S, const float *pSrc,
+                    float *pDst, uint32_t frames)
+{
+  uint32_t nch = S->numChannels;
+  const float *in = pSrc;
+  const float *c;
+  float *st = S->pState;
+  float b0, b1, b2, a1, a2, d1, d2, x, y;
+  uint32_t stage, ch, f;
+
+  for (stage = 0U; stage < S->numStages; stage++)
+  {
+    for (ch = 0U; ch < nch; ch++)
+    {
+      c = S->pCoeffs + ch * S->coeffStride + 5U * stage;
+      b0 = c[0];
+      b1 = c[1];
+      b2 = c[2];
+      a1 = c[3];
+      a2 = c[4];
+      d1 = st[0];
+      d2 = st[1];
+
+      for (f = 0U; f < frames; f++)
+      {
+        x = in[f * nch + ch];
+        y = b0 * x + d1;
+        d1 = b1 * x + a1 * y + d2;
+        d2 = b2 * x + a2 * y;
+        pDst[f * nch + ch] = y;
+      }
+
+      st[0] = d1;
+      st[1] = d2;
+      st += 2U;
+    }
+    /* the following stages run on the output of this one */
+    in = pDst;
+  }
+}
+
+/**
+  * @brief  Set up a q15 cascade and clear its state
+  * @param  S: cascade
+  * @param  numStages: second order stages
+  * @param  numChannels: samples per frame
+  * @param  coeffStride: 0 for one coefficient set, 6 * numStages for one
+  *         per channel
+  * @param  pCoeffs: b0 0 b1 b2 a1 a2 per stage
+  * @param  pState: 4 * numStages * numChannels values
+  * @param  postShift: shift of the accumulator, for coefficients scaled
+  *         down by 2^postShift
+  * @retval None
+  */
+void USB_Biquad_Init_q15(USB_Biquad_Q15TypeDef *S, uint8_t numStages,
+                         uint8_t numChannels, uint16_t coeffStride,
+                         const int16_t *pCoeffs, int16_t *pState,
+                         int8_t postShift)
+{
+  S->numStages = numStages;
+  S->numChannels = numChannels;
+  S->coeffStride = coeffStride;
+  S->postShift = postShift;
+  S->pCoeffs = pCoeffs;
+  S->pState = pState;
+  memset(pState, 0, 4U * numStages * numChannels * sizeof(int16_t));
+}
+
+/**
+  * @brief  Filter a block of interleaved frames, direct form I, 64-bit
+  *         accumulator shifted by 15 - postShift and saturated
+  * @note   Packed when pCoeffs and pState are word aligned.
+  * @param  S: cascade
+  * @param  pSrc: frames of numChannels samples
+  * @param  pDst: filtered frames, may be pSrc
+  * @param  frames: number of frames
+  * @retval None
+  */
+void USB_Biquad_q15(const USB_Biquad_Q15TypeDef *S, const int16_t *pSrc,
+                    int16_t *pDst, uint32_t frames)
+{
+  uint32_t nch = S->numChannels;
+  int32_t shift = 15 - S->postShift;
+  const int16_t *in = pSrc;
+  const int16_t *c;
+  int16_t *st = S->pState;
+  int64_t acc;
+  int16_t x, y;
+  uint32_t stage, ch, f;
+#if (USB_BIQUAD_SIMD == 1)
+  uint32_t packed = USB_BIQUAD_ALIGNED(S->pCoeffs) && USB_BIQUAD_ALIGNED(st) &&
+                    ((S->coeffStride & 1U) == 0U);
+#endif /* USB_BIQUAD_SIMD */
+
+  for (stage = 0U; stage < S->numStages; stage++)
+  {
+    for (ch = 0U; ch < nch; ch++)
+    {
+      c = S->pCoeffs + ch * S->coeffStride + 6U * stage;
+
+#if (USB_BIQUAD_SIMD == 1)
+      if (packed)
+      {
+        const uint32_t *cw = (const uint32_t *)(const void *)c;
+        uint32_t *sw = (uint32_t *)(void *)st;
+        int32_t b0 = c[0];
+        uint32_t b12 = cw[1];
+        uint32_t a12 = cw[2];
+        uint32_t xs = sw[0];            /* x[n-1] low, x[n-2] high */
+        uint32_t ys = sw[1];            /* y[n-1] low, y[n-2] high */
+
+        for (f = 0U; f < frames; f++)
+        {
+          x = in[f * nch + ch];
+          acc = (int64_t)(b0 * x);
+          acc = (int64_t)__SMLALD(b12, xs, (uint64_t)acc);
+          acc = (int64_t)__SMLALD(a12, ys, (uint64_t)acc);
+          y = USB_Biquad_Sat(acc >> shift);
+          xs = __PKHBT((uint32_t)(uint16_t)x, xs, 16);
+          ys = __PKHBT((uint32_t)(uint16_t)y, ys, 16);
+          pDst[f * nch + ch] = y;
+        }
+
+        sw[0] = xs;
+        sw[1] = ys;
+        st += 4U;
+        continue;
+      }
+#endif /* USB_BIQUAD_SIMD */
+
+      {
+        int32_t b0 = c[0], b1 = c[2], b2 = c[3], a1 = c[4], a2 = c[5];
+        int16_t x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+
+        for (f = 0U; f < frames; f++)
+        {
+          x = in[f * nch + ch];
+          acc = (int64_t)(b0 * x) + (int64_t)(b1 * x1) + (int64_t)(b2 * x2) +
+                (int64_t)(a1 * y1) + (int64_t)(a2 * y2);
+          y = USB_Biquad_Sat(acc >> shift);
+          x2 = x1;
+          x1 = x;
+          y2 = y1;
+          y1 = y;
+          pDst[f * nch + ch] = y;
+        }
+
+        st[0] = x1;
+        st[1] = x2;
+        st[2] = y1;
+        st[3] = y2;
+        st += 4U;
+      }
+    }
+    in = pDst;
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,432 @@
+/**
+  ******************************************************************************
+  * @file    usb_cap.c
+  * @brief   Packet capture of the USB device, see usb_cap.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_conf.h"
+#include "usbd_cdc.h"
+#include "usb_cap.h"
+
+#if (USB_CAP_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Cap
+  * @{
+  */
+
+/** @defgroup USB_Cap_Private_Defines
+  * @{
+  */
+#define USB_CAP_KIND(r)                             ((r)->kind & 0x0FU)
+#define USB_CAP_TYPE(r)                             (((r)->kind >> 4) & 0x03U)
+#define USB_CAP_NODATA                              0x80U
+
+#define USB_CAP_NO_STOP                             0xFFFFFFFFU
+
+/* pcap file and record headers, usbmon header of LINKTYPE_USB_LINUX_MMAPPED */
+#define USB_CAP_PCAP_FILE_SIZE                      24U
+#define USB_CAP_PCAP_REC_SIZE                       16U
+#define USB_CAP_USBMON_SIZE                         64U
+#define USB_CAP_LINKTYPE                            220U
+
+#define USB_CAP_EPIPE                               (-32)
+#define USB_CAP_EINPROGRESS                         (-115)
+
+/* Bytes of a pumped CDC write */
+#define USB_CAP_PUMP_CHUNK                          64U
+/**
+  * @}
+  */
+
+/** @defgroup USB_Cap_Private_Variables
+  * @{
+  */
+static USB_CapRecordTypeDef USB_Cap_Ring[USB_CAP_RECORDS];
+static uint32_t USB_Cap_Head;           /* records written, ever */
+static uint32_t USB_Cap_StopAt;         /* head at which the ring stops */
+static __IO uint8_t USB_Cap_Halted;
+
+static uint32_t USB_Cap_Triggers;
+static uint8_t  USB_Cap_TrigEp;
+static uint16_t USB_Cap_TrigSize;
+
+/* Read out of a stopped ring */
+static uint32_t USB_Cap_RdNext;         /* next record, 0xFFFFFFFF for the file header */
+static uint32_t USB_Cap_RdLast;         /* cycles of the record before */
+static uint64_t USB_Cap_RdTime;         /* cycles from the first record */
+static uint8_t  USB_Cap_Out[USB_CAP_PCAP_REC_SIZE + USB_CAP_USBMON_SIZE + USB_CAP_DATA_SIZE];
+static uint32_t USB_Cap_OutLen;
+static uint32_t USB_Cap_OutPos;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Cap_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Store a little endian word
+  * @param  p: where to write
+  * @param  value: word
+  * @retval None
+  */
+static void USB_Cap_Put32(uint8_t *p, uint32_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+/**
+  * @brief  First record still in the ring
+  * @retval record number
+  */
+static uint32_t USB_Cap_First(void)
+{
+  return (USB_Cap_Head > USB_CAP_RECORDS) ? (USB_Cap_Head - USB_CAP_RECORDS) : 0U;
+}
+
+/**
+  * @brief  Start reading out from the file header
+  * @retval None
+  */
+static void USB_Cap_Rewind(void)
+{
+  USB_Cap_RdNext = 0xFFFFFFFFU;
+  USB_Cap_RdTime = 0U;
+  USB_Cap_OutLen = 0U;
+  USB_Cap_OutPos = 0U;
+}
+
+/**
+  * @brief  Fill the output buffer with the pcap file header
+  * @retval None
+  */
+static void USB_Cap_FileHeader(void)
+{
+  uint8_t *p = USB_Cap_Out;
+
+  USB_Cap_Put32(p, 0xA1B2C3D4U);
+  USB_Cap_Put32(p + 4, 2U | (4U << 16));               /* version 2.4 */
+  USB_Cap_Put32(p + 8, 0U);                            /* GMT */
+  USB_Cap_Put32(p + 12, 0U);
+  USB_Cap_Put32(p + 16, USB_CAP_USBMON_SIZE + USB_CAP_DATA_SIZE);
+  USB_Cap_Put32(p + 20, USB_CAP_LINKTYPE);
+  USB_Cap_OutLen = USB_CAP_PCAP_FILE_SIZE;
+}
+
+/**
+  * @brief  Fill the output buffer with one record as pcap and usbmon
+  * @param  seq: record number
+  * @retval None
+  */
+static void USB_Cap_Record(uint32_t seq)
+{
+  /* usbmon transfer types of the PCD endpoint types */
+  static const uint8_t xfer_type[4] = { 2U, 0U, 3U, 1U };
+  const USB_CapRecordTypeDef *r = &USB_Cap_Ring[seq & (USB_CAP_RECORDS - 1U)];
+  uint8_t *p = USB_Cap_Out;
+  uint8_t *mon = p + USB_CAP_PCAP_REC_SIZE;
+  uint32_t us;
+  uint32_t length = r->length;
+  uint32_t cap = 0U;
+  int32_t status = 0;
+  uint8_t type;
+
+  if (seq != USB_Cap_First())
+  {
+    USB_Cap_RdTime += (uint32_t)(r->cycles - USB_Cap_RdLast);
+  }
+  USB_Cap_RdLast = r->cycles;
+  us = (uint32_t)((USB_Cap_RdTime * 1000000U) / SystemCoreClock);
+
+  memset(mon, 0, USB_CAP_USBMON_SIZE);
+
+  switch (USB_CAP_KIND(r))
+  {
+  case USB_CAP_SETUP:
+    type = 'S';
+    status = USB_CAP_EINPROGRESS;
+    length = r->data[6] | ((uint32_t)r->data[7] << 8);
+    memcpy(mon + 40, r->data, 8U);
+    break;
+
+  case USB_CAP_STALL:
+    type = 'C';
+    status = USB_CAP_EPIPE;
+    break;
+
+  default:
+    /* the host submits OUT data and gets IN data back on completion */
+    type = ((r->ep_addr & 0x80U) != 0U) ? 'C' : 'S';
+    status = (type == 'S') ? USB_CAP_EINPROGRESS : 0;
+    if ((r->kind & USB_CAP_NODATA) == 0U)
+    {
+      cap = MIN(length, USB_CAP_DATA_SIZE);
+    }
+    break;
+  }
+
+  USB_Cap_Put32(p, us / 1000000U);
+  USB_Cap_Put32(p + 4, us % 1000000U);
+  USB_Cap_Put32(p + 8, USB_CAP_USBMON_SIZE + cap);
+  USB_Cap_Put32(p + 12, USB_CAP_USBMON_SIZE + cap);
+
+  USB_Cap_Put32(mon, seq);                             /* id */
+  mon[8] = type;
+  mon[9] = xfer_type[USB_CAP_TYPE(r)];
+  mon[10] = r->ep_addr;
+  mon[11] = 1U;                                        /* devnum */
+  mon[12] = 1U;                                        /* busnum */
+  mon[14] = (USB_CAP_KIND(r) == USB_CAP_SETUP) ? 0U : (uint8_t)'-';
+  mon[15] = (cap != 0U) ? 0U : (uint8_t)'<';
+  USB_Cap_Put32(mon + 16, us / 1000000U);              /* ts_sec, 64 bit */
+  USB_Cap_Put32(mon + 24, us % 1000000U);
+  USB_Cap_Put32(mon + 28, (uint32_t)status);
+  USB_Cap_Put32(mon + 32, length);
+  USB_Cap_Put32(mon + 36, cap);
+
+  memcpy(mon + USB_CAP_USBMON_SIZE, r->data, cap);
+  USB_Cap_OutLen = USB_CAP_PCAP_REC_SIZE + USB_CAP_USBMON_SIZE + cap;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Cap_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Start the cycle counter and an empty ring, no trigger
+  * @retval None
+  */
+void USB_Cap_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  USB_Cap_Triggers = 0U;
+  USB_Cap_Restart();
+}
+
+/**
+  * @brief  Choose what stops the ring
+  * @param  triggers: USB_CAP_TRIG_xxx, or'ed; 0 for none
+  * @param  ep_addr: endpoint of USB_CAP_TRIG_SIZE
+  * @param  size: packet length USB_CAP_TRIG_SIZE expects on it
+  * @retval None
+  */
+void USB_Cap_SetTrigger(uint32_t triggers, uint8_t ep_addr, uint16_t size)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  USB_Cap_TrigEp = ep_addr;
+  USB_Cap_TrigSize = size;
+  USB_Cap_Triggers = triggers;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Stop the ring now
+  * @retval None
+  */
+void USB_Cap_Stop(void)
+{
+  USB_Cap_Halted = 1U;
+}
+
+/**
+  * @brief  Empty the ring and record again
+  * @retval None
+  */
+void USB_Cap_Restart(void)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  USB_Cap_Head = 0U;
+  USB_Cap_StopAt = USB_CAP_NO_STOP;
+  USB_Cap_Rewind();
+  USB_Cap_Halted = 0U;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Whether the ring stopped, on a trigger or by hand
+  * @retval 1 if stopped
+  */
+uint8_t USB_Cap_Stopped(void)
+{
+  return USB_Cap_Halted;
+}
+
+/**
+  * @brief  Next bytes of the pcap file of a stopped ring
+  * @param  buf: destination
+  * @param  len: room in it
+  * @retval bytes written, 0 at the end of the file or while recording
+  */
+uint32_t USB_Cap_Read(uint8_t *buf, uint32_t len)
+{
+  uint32_t done = 0U;
+  uint32_t n;
+
+  if (USB_Cap_Halted == 0U)
+  {
+    return 0U;
+  }
+
+  while (done < len)
+  {
+    if (USB_Cap_OutPos == USB_Cap_OutLen)
+    {
+      USB_Cap_OutPos = 0U;
+      if (USB_Cap_RdNext == 0xFFFFFFFFU)
+      {
+        USB_Cap_FileHeader();
+        USB_Cap_RdNext = USB_Cap_First();
+      }
+      else if (USB_Cap_RdNext < USB_Cap_Head)
+      {
+        USB_Cap_Record(USB_Cap_RdNext++);
+      }
+      else
+      {
+        USB_Cap_OutLen = 0U;
+        break;
+      }
+    }
+
+    n = MIN(len - done, USB_Cap_OutLen - USB_Cap_OutPos);
+    memcpy(buf + done, &USB_Cap_Out[USB_Cap_OutPos], n);
+    USB_Cap_OutPos += n;
+    done += n;
+  }
+
+  return done;
+}
+
+/**
+  * @brief  Record a packet
+  * @param  ep_addr: endpoint address
+  * @param  kind: USB_CAP_xxx
+  * @param  type: endpoint type, PCD_EP_TYPE_xxx
+  * @param  pbuf: packet bytes, NULL when not at hand
+  * @param  length: packet length
+  * @retval None
+  */
+void USB_Cap_Packet(uint8_t ep_addr, uint8_t kind, uint8_t type,
+                    const uint8_t *pbuf, uint16_t length)
+{
+  USB_CapRecordTypeDef *r;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (USB_Cap_Halted != 0U)
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  r = &USB_Cap_Ring[USB_Cap_Head & (USB_CAP_RECORDS - 1U)];
+  r->cycles = DWT->CYCCNT;
+  r->length = length;
+  r->ep_addr = ep_addr;
+  r->kind = (uint8_t)(kind | ((type & 0x03U) << 4));
+  if (pbuf != NULL)
+  {
+    memcpy(r->data, pbuf, MIN(length, USB_CAP_DATA_SIZE));
+  }
+  else
+  {
+    r->kind |= USB_CAP_NODATA;
+  }
+  USB_Cap_Head++;
+
+  if ((USB_Cap_StopAt == USB_CAP_NO_STOP) &&
+      ((((USB_Cap_Triggers & USB_CAP_TRIG_STALL) != 0U) && (kind == USB_CAP_STALL)) ||
+       (((USB_Cap_Triggers & USB_CAP_TRIG_SIZE) != 0U) && (kind == USB_CAP_DATA) &&
+        (ep_addr == USB_Cap_TrigEp) && (length != USB_Cap_TrigSize))))
+  {
+    USB_Cap_StopAt = USB_Cap_Head + USB_CAP_POST_TRIGGER;
+  }
+  if (USB_Cap_Head == USB_Cap_StopAt)
+  {
+    USB_Cap_Halted = 1U;
+  }
+  __set_PRIMASK(primask);
+}
+
+#if !defined(USB_OTG_FS)
+/**
+  * @brief  Record an OUT packet left in packet memory
+  * @param  USBx: USB peripheral instance
+  * @param  ep_addr: endpoint address
+  * @param  type: endpoint type, PCD_EP_TYPE_xxx
+  * @param  pma: packet memory address of the packet
+  * @param  length: packet length
+  * @retval None
+  */
+void USB_Cap_PacketPMA(USB_TypeDef *USBx, uint8_t ep_addr, uint8_t type,
+                       uint16_t pma, uint16_t length)
+{
+  uint8_t head[USB_CAP_DATA_SIZE];
+
+  if (USB_Cap_Halted != 0U)
+  {
+    return;
+  }
+  PCD_ReadPMA(USBx, head, pma, MIN(length, USB_CAP_DATA_SIZE));
+  USB_Cap_Packet(ep_addr, USB_CAP_DATA, type, head, length);
+}
+#endif /* USB_OTG_FS */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+/**
+  * @brief  Write the pcap file of a stopped ring on a CDC instance as room
+  *         frees up on its transmit ring. Call from the main loop; the
+  *         file goes out once per stop, USB_Cap_Restart records again.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance, not one being debugged
+  * @retval None
+  */
+void USB_Cap_PumpCdc(struct _USBD_HandleTypeDef *pdev, int instance)
+{
+  uint8_t chunk[USB_CAP_PUMP_CHUNK];
+  uint32_t len;
+
+  while (USB_CAP_PUMP_CHUNK <= USBD_CDC_GetTxFree(pdev, instance))
+  {
+    len = USB_Cap_Read(chunk, USB_CAP_PUMP_CHUNK);
+    if (len == 0U)
+    {
+      break;
+    }
+    USBD_CDC_Write(pdev, instance, chunk, len);
+  }
+}
+#endif /* USBD_CDC_TX_RING_SIZE */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_CAP_ENABLED */
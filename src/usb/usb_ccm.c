@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file    usb_ccm.c
+  * @brief   USB fast path in the CCM SRAM of the STM32F303, see usb_ccm.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_ccm.h"
+
+#if (USB_CCM_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_CCM
+  * @{
+  */
+
+/** @defgroup USB_CCM_Private_Variables
+  * @{
+  */
+/* From the linker script */
+extern uint32_t _siccmram;
+extern uint32_t _sccmram;
+extern uint32_t _eccmram;
+extern uint32_t _sccmbss;
+extern uint32_t _eccmbss;
+/**
+  * @}
+  */
+
+/** @defgroup USB_CCM_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Load the CCM code and data from flash and clear the CCM bss
+  * @note   Runs from flash, before any function placed in CCM.
+  * @retval None
+  */
+void USB_CCM_Init(void)
+{
+  const uint32_t *src = &_siccmram;
+  uint32_t *dst;
+
+  for (dst = &_sccmram; dst < &_eccmram; dst++, src++)
+  {
+    *dst = *src;
+  }
+  for (dst = &_sccmbss; dst < &_eccmbss; dst++)
+  {
+    *dst = 0U;
+  }
+
+  /* the copy is data until it has reached the I-bus */
+  __DSB();
+  __ISB();
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_CCM_ENABLED */
@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * @file    usb_conv.c
+  * @brief   Overlap-save FFT convolution, see usb_conv.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usb_conv.h"
+
+#if (USB_CONV_ENABLED == 1)
+
+#include "usb_fft.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Conv
+  * @{
+  */
+
+/** @defgroup USB_Conv_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Filter the frame: one block of output into the tail of pWork
+  * @param  S: engine
+  * @retval None
+  */
+static void USB_Conv_Block(USB_Conv_F32TypeDef *S)
+{
+  uint32_t n = S->fftLen;
+  float32_t *X = S->pSpec;
+
+  /* arm_rfft_fast_f32 uses up its input */
+  memcpy(S->pWork, S->pFrame, n * sizeof(float32_t));
+  arm_rfft_fast_f32(&S->rfft, S->pWork, X, 0U);
+
+  /* X[0] and X[1] are the real DC and Nyquist bins, the rest complex */
+  X[0] *= S->pH[0];
+  X[1] *= S->pH[1];
+  arm_cmplx_mult_cmplx_f32(X + 2, S->pH + 2, X + 2, n / 2U - 1U);
+
+  arm_rfft_fast_f32(&S->rfft, X, S->pWork, 1U);
+
+  /* keep the history the next frame needs */
+  memmove(S->pFrame, S->pFrame + S->blockSize,
+          (n - S->blockSize) * sizeof(float32_t));
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Conv_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up an engine and transform its filter
+  * @param  S: engine
+  * @param  fftLen: real FFT length, a power of two from 32 to 4096
+  * @param  blockSize: samples per transform, 1 to fftLen - numTaps + 1
+  * @param  pCoeffs: taps, in the order of arm_fir_f32
+  * @param  numTaps: number of taps, 1 to fftLen
+  * @param  pState: USB_CONV_STATE_SIZE(fftLen) floats, word aligned
+  * @retval ARM_MATH_SUCCESS, ARM_MATH_ARGUMENT_ERROR on a bad size
+  */
+arm_status USB_Conv_Init_f32(USB_Conv_F32TypeDef *S, uint16_t fftLen,
+                             uint16_t blockSize, const float32_t *pCoeffs,
+                             uint16_t numTaps, float32_t *pState)
+{
+  arm_status status;
+
+  if ((numTaps == 0U) || (numTaps > fftLen) || (blockSize == 0U) ||
+      (blockSize > fftLen - numTaps + 1U))
+  {
+    return ARM_MATH_ARGUMENT_ERROR;
+  }
+
+#if (USB_FFT_ENABLED == 1)
+  status = USB_FFT_RfftInit_f32(&S->rfft, fftLen);
+#else
+  status = arm_rfft_fast_init_f32(&S->rfft, fftLen);
+#endif
+  if (status != ARM_MATH_SUCCESS)
+  {
+    return status;
+  }
+
+  S->fftLen = fftLen;
+  S->blockSize = blockSize;
+  S->pH = pState;
+  S->pFrame = pState + fftLen;
+  S->pWork = pState + 2U * fftLen;
+  S->pSpec = pState + 3U * fftLen;
+
+  /* spectrum of the zero padded taps, with the 1 / fftLen of the inverse
+     left to arm_rfft_fast_f32 */
+  memset(S->pWork, 0, fftLen * sizeof(float32_t));
+  memcpy(S->pWork, pCoeffs, numTaps * sizeof(float32_t));
+  arm_rfft_fast_f32(&S->rfft, S->pWork, S->pH, 0U);
+
+  USB_Conv_Reset_f32(S);
+
+  return ARM_MATH_SUCCESS;
+}
+
+/**
+  * @brief  Clear the input history and the pending output
+  * @param  S: engine
+  * @retval None
+  */
+void USB_Conv_Reset_f32(USB_Conv_F32TypeDef *S)
+{
+  memset(S->pFrame, 0, S->fftLen * sizeof(float32_t));
+  memset(S->pWork, 0, S->fftLen * sizeof(float32_t));
+  S->fill = 0U;
+}
+
+/**
+  * @brief  Filter a run of samples
+  * @note   The output is delayed by blockSize samples. A transform runs
+  *         each time a block is complete, inside the call that completes it.
+  * @param  S: engine
+  * @param  pSrc: input samples
+  * @param  pDst: output samples, may be pSrc
+  * @param  n: number of samples
+  * @retval None
+  */
+void USB_Conv_f32(USB_Conv_F32TypeDef *S, const float32_t *pSrc,
+                  float32_t *pDst, uint32_t n)
+{
+  uint32_t head = S->fftLen - S->blockSize;
+  uint32_t chunk;
+
+  while (n > 0U)
+  {
+    chunk = S->blockSize - S->fill;
+    if (chunk > n)
+    {
+      chunk = n;
+    }
+
+    /* take the input before the output of the last block, from the tail
+       of pWork, goes over it, so pDst may be pSrc */
+    memcpy(S->pFrame + head + S->fill, pSrc, chunk * sizeof(float32_t));
+    memcpy(pDst, S->pWork + head + S->fill, chunk * sizeof(float32_t));
+    S->fill += chunk;
+    pSrc += chunk;
+    pDst += chunk;
+    n -= chunk;
+
+    if (S->fill == S->blockSize)
+    {
+      USB_Conv_Block(S);
+      S->fill = 0U;
+    }
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_CONV_ENABLED */
@@ -0,0 +1,190 @@
+/**
+  ******************************************************************************
+  * @file    usb_crc.c
+  * @brief   CRC-32 on the CRC unit, see usb_crc.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_crc.h"
+
+#if (USB_CRC_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_CRC
+  * @{
+  */
+
+/** @defgroup USB_CRC_Private_Defines
+  * @{
+  */
+#define USB_CRC_POLY                                0x04C11DB7U
+#define USB_CRC_INIT                                0xFFFFFFFFU
+#define USB_CRC_XOROUT                              0xFFFFFFFFU
+
+/* Input reversed per byte for byte writes, per word for word writes, so
+   that either way the bytes go in in memory order, least significant bit
+   first */
+#define USB_CRC_CR_BYTES                            (CRC_CR_REV_OUT | CRC_CR_REV_IN_0)
+#define USB_CRC_CR_WORDS                            (CRC_CR_REV_OUT | CRC_CR_REV_IN)
+
+/* Flags of a channel in the DMA ISR / IFCR registers */
+#define USB_CRC_DMA_FLAGS(ch, f)                    ((uint32_t)(f) << (4U * ((ch) - 1U)))
+/**
+  * @}
+  */
+
+/** @defgroup USB_CRC_Private_Variables
+  * @{
+  */
+static const USB_CRC_ConfigTypeDef *USB_CRC_Cfg;
+static const uint8_t *USB_CRC_Tail;     /* bytes left for USB_CRC_End */
+static uint32_t USB_CRC_TailLen;
+static uint8_t  USB_CRC_DmaBusy;
+/**
+  * @}
+  */
+
+/** @defgroup USB_CRC_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Feed bytes one at a time
+  * @param  p: bytes
+  * @param  n: number of bytes
+  * @retval None
+  */
+static void USB_CRC_FeedBytes(const uint8_t *p, uint32_t n)
+{
+  CRC->CR = USB_CRC_CR_BYTES;
+  while (n-- > 0U)
+  {
+    *(__IO uint8_t *)&CRC->DR = *p++;
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_CRC_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up the CRC unit
+  * @param  cfg: DMA channel for large frames, NULL to feed the unit from
+  *         the CPU only. Must stay valid.
+  * @retval None
+  */
+void USB_CRC_Init(const USB_CRC_ConfigTypeDef *cfg)
+{
+  USB_CRC_Cfg = ((cfg != NULL) && (cfg->Dma != NULL)) ? cfg : NULL;
+  USB_CRC_DmaBusy = 0U;
+
+  CRC->POL = USB_CRC_POLY;
+  CRC->INIT = USB_CRC_INIT;
+  CRC->CR = USB_CRC_CR_BYTES | CRC_CR_RESET;
+}
+
+/**
+  * @brief  Start the CRC of a buffer
+  * @note   With DMA the buffer is read while this returns; it must not be
+  *         written until USB_CRC_End.
+  * @param  buf: data
+  * @param  length: number of bytes
+  * @retval None
+  */
+void USB_CRC_Begin(const uint8_t *buf, uint32_t length)
+{
+  uint32_t head = (4U - ((uint32_t)buf & 0x3U)) & 0x3U;
+  uint32_t words;
+  const uint32_t *w;
+
+  CRC->CR = USB_CRC_CR_BYTES | CRC_CR_RESET;
+
+  head = (head < length) ? head : length;
+  USB_CRC_FeedBytes(buf, head);
+  buf += head;
+  length -= head;
+
+  words = length / 4U;
+  USB_CRC_Tail = buf + 4U * words;
+  USB_CRC_TailLen = length & 0x3U;
+
+  CRC->CR = USB_CRC_CR_WORDS;
+
+  if ((USB_CRC_Cfg != NULL) && (4U * words >= USB_CRC_DMA_MIN) && (words <= 0xFFFFU))
+  {
+    DMA_Channel_TypeDef *ch = USB_CRC_Cfg->DmaCh;
+
+    ch->CCR = 0U;
+    USB_CRC_Cfg->Dma->IFCR = USB_CRC_DMA_FLAGS(USB_CRC_Cfg->DmaChNum, DMA_IFCR_CGIF1);
+    ch->CPAR = (uint32_t)&CRC->DR;
+    ch->CMAR = (uint32_t)buf;
+    ch->CNDTR = words;
+    /* read memory, incrementing, into the fixed data register */
+    ch->CCR = DMA_CCR_MEM2MEM | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 |
+              DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+    USB_CRC_DmaBusy = 1U;
+    return;
+  }
+
+  w = (const uint32_t *)(const void *)buf;
+  while (words-- > 0U)
+  {
+    CRC->DR = *w++;
+  }
+}
+
+/**
+  * @brief  Finish the CRC started by USB_CRC_Begin
+  * @retval CRC-32 of the buffer
+  */
+uint32_t USB_CRC_End(void)
+{
+  if (USB_CRC_DmaBusy != 0U)
+  {
+    uint32_t done = USB_CRC_DMA_FLAGS(USB_CRC_Cfg->DmaChNum,
+                                      DMA_ISR_TCIF1 | DMA_ISR_TEIF1);
+
+    while ((USB_CRC_Cfg->Dma->ISR & done) == 0U)
+    {
+    }
+    USB_CRC_Cfg->Dma->IFCR = USB_CRC_DMA_FLAGS(USB_CRC_Cfg->DmaChNum, DMA_IFCR_CGIF1);
+    USB_CRC_Cfg->DmaCh->CCR = 0U;
+    USB_CRC_DmaBusy = 0U;
+  }
+
+  USB_CRC_FeedBytes(USB_CRC_Tail, USB_CRC_TailLen);
+
+  return CRC->DR ^ USB_CRC_XOROUT;
+}
+
+/**
+  * @brief  CRC of a buffer, in one call
+  * @param  buf: data
+  * @param  length: number of bytes
+  * @retval CRC-32 of the buffer
+  */
+uint32_t USB_CRC_Compute(const uint8_t *buf, uint32_t length)
+{
+  USB_CRC_Begin(buf, length);
+  return USB_CRC_End();
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_CRC_ENABLED */
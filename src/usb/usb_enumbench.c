@@ -0,0 +1,266 @@
+/**
+  ******************************************************************************
+  * @file    usb_enumbench.c
+  * @brief   Enumeration latency, see usb_enumbench.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usbd_def.h"
+#include "usb_enumbench.h"
+#include "usb_fastboot.h"
+
+#if (USB_ENUMBENCH_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_EnumBench
+  * @{
+  */
+
+/** @defgroup USB_EnumBench_Exported_Variables
+  * @{
+  */
+USB_EnumBenchTypeDef USB_EnumBench;
+/**
+  * @}
+  */
+
+/** @defgroup USB_EnumBench_Private_Variables
+  * @{
+  */
+static const char * const USB_EnumBench_Names[USB_ENUMBENCH_NUM_STEPS] =
+{
+  "connect", "reset", "device", "address", "config", "string",
+  "qualifier", "bos", "setconfig", "init", "out", "hse", "pll",
+};
+/**
+  * @}
+  */
+
+/** @defgroup USB_EnumBench_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Append a decimal number
+  * @param  p: where to write
+  * @param  value: number
+  * @retval end of the text
+  */
+static char *USB_EnumBench_PutU(char *p, uint32_t value)
+{
+  char tmp[10];
+  uint32_t n = 0U;
+
+  do
+  {
+    tmp[n++] = (char)('0' + (value % 10U));
+    value /= 10U;
+  } while (value != 0U);
+
+  while (n != 0U)
+  {
+    *p++ = tmp[--n];
+  }
+  return p;
+}
+
+/**
+  * @brief  Append a string
+  * @param  p: where to write
+  * @param  s: NUL terminated string
+  * @retval end of the text
+  */
+static char *USB_EnumBench_PutS(char *p, const char *s)
+{
+  while (*s != '\0')
+  {
+    *p++ = *s++;
+  }
+  return p;
+}
+
+/**
+  * @brief  Microseconds of a cycle count
+  * @param  cycles: cycles
+  * @retval microseconds, rounded down
+  */
+static uint32_t USB_EnumBench_Us(uint32_t cycles)
+{
+  return (uint32_t)(((uint64_t)cycles * 1000000U) / SystemCoreClock);
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_EnumBench_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  The pull-up went on: start the cycle counter and a new run
+  * @retval None
+  */
+void USB_EnumBench_Connect(void)
+{
+  uint32_t i;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  for (i = 0U; i < USB_ENUMBENCH_NUM_STEPS; i++)
+  {
+    USB_EnumBench.step[i].first = 0U;
+    USB_EnumBench.step[i].last = 0U;
+    USB_EnumBench.step[i].count = 0U;
+  }
+  USB_EnumBench.start = DWT->CYCCNT;
+  USB_EnumBench.from_reset = 0U;
+
+#if (USB_FASTBOOT_ENABLED == 1)
+  /* CYCCNT has counted from the reset, see USB_FastBoot_Poll; later
+     pull-ups start over from their own */
+  if (USB_EnumBench.running == 0U)
+  {
+    const USB_FastBootTimesTypeDef *boot = USB_FastBoot_GetTimes();
+
+    USB_EnumBench.from_reset = 1U;
+    USB_EnumBench.step[USB_ENUMBENCH_HSE].first = boot->hse;
+    USB_EnumBench.step[USB_ENUMBENCH_HSE].last = boot->hse;
+    USB_EnumBench.step[USB_ENUMBENCH_HSE].count = 1U;
+    USB_EnumBench.step[USB_ENUMBENCH_PLL].first = boot->pll;
+    USB_EnumBench.step[USB_ENUMBENCH_PLL].last = boot->pll;
+    USB_EnumBench.step[USB_ENUMBENCH_PLL].count = 1U;
+    USB_EnumBench.step[USB_ENUMBENCH_CONNECT].first = USB_EnumBench.start;
+    USB_EnumBench.step[USB_ENUMBENCH_CONNECT].last = USB_EnumBench.start;
+    USB_EnumBench.start = 0U;
+  }
+#endif /* USB_FASTBOOT_ENABLED */
+
+  USB_EnumBench.running = 1U;
+  USB_EnumBench.step[USB_ENUMBENCH_CONNECT].count = 1U;
+}
+
+/**
+  * @brief  Timestamp a step
+  * @param  step: USB_ENUMBENCH_xxx
+  * @retval None
+  */
+void USB_EnumBench_Mark(uint32_t step)
+{
+  USB_EnumBenchStepTypeDef *s = &USB_EnumBench.step[step];
+  uint32_t t = DWT->CYCCNT - USB_EnumBench.start;
+
+  if (USB_EnumBench.running == 0U)
+  {
+    return;
+  }
+  if (s->count == 0U)
+  {
+    s->first = t;
+  }
+  s->last = t;
+  s->count++;
+}
+
+/**
+  * @brief  Timestamp a GET_DESCRIPTOR by descriptor type
+  * @param  type: high byte of wValue
+  * @retval None
+  */
+void USB_EnumBench_Descriptor(uint8_t type)
+{
+  switch (type)
+  {
+  case USB_DESC_TYPE_DEVICE:
+    USB_EnumBench_Mark(USB_ENUMBENCH_DEVICE);
+    break;
+
+  case USB_DESC_TYPE_CONFIGURATION:
+    USB_EnumBench_Mark(USB_ENUMBENCH_CONFIG);
+    break;
+
+  case USB_DESC_TYPE_STRING:
+    USB_EnumBench_Mark(USB_ENUMBENCH_STRING);
+    break;
+
+  case USB_DESC_TYPE_DEVICE_QUALIFIER:
+    USB_EnumBench_Mark(USB_ENUMBENCH_QUALIFIER);
+    break;
+
+  case USB_DESC_TYPE_BOS:
+    USB_EnumBench_Mark(USB_ENUMBENCH_BOS);
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+  * @brief  One line of the text report
+  * @param  line: 0 to USB_ENUMBENCH_NUM_LINES - 1
+  * @param  buf: USB_ENUMBENCH_LINE_SIZE bytes
+  * @retval length of the line, newline included; 0 past the last one or
+  *         before the pull-up
+  */
+uint32_t USB_EnumBench_Line(uint32_t line, char *buf)
+{
+  char *p = buf;
+
+  if ((USB_EnumBench.running == 0U) || (line >= USB_ENUMBENCH_NUM_LINES))
+  {
+    return 0U;
+  }
+
+  if (line == 0U)
+  {
+    p = USB_EnumBench_PutS(p, "enum clock ");
+    p = USB_EnumBench_PutU(p, SystemCoreClock);
+    if (USB_EnumBench.from_reset != 0U)
+    {
+      p = USB_EnumBench_PutS(p, " reset");
+    }
+  }
+  else if (line == 1U)
+  {
+    p = USB_EnumBench_PutS(p, "step count first_us last_us");
+  }
+  else if (line == USB_ENUMBENCH_NUM_LINES - 1U)
+  {
+    p = USB_EnumBench_PutS(p, "end");
+  }
+  else
+  {
+    const USB_EnumBenchStepTypeDef *s = &USB_EnumBench.step[line - 2U];
+
+    p = USB_EnumBench_PutS(p, USB_EnumBench_Names[line - 2U]);
+    *p++ = ' ';
+    p = USB_EnumBench_PutU(p, s->count);
+    *p++ = ' ';
+    p = USB_EnumBench_PutU(p, USB_EnumBench_Us(s->first));
+    *p++ = ' ';
+    p = USB_EnumBench_PutU(p, USB_EnumBench_Us(s->last));
+  }
+
+  *p++ = '\n';
+  *p = '\0';
+  return (uint32_t)(p - buf);
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_ENUMBENCH_ENABLED */
@@ -0,0 +1,192 @@
+/**
+  ******************************************************************************
+  * @file    usb_fastboot.c
+  * @brief   Fast clock and USB bring-up, see usb_fastboot.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_fastboot.h"
+
+#if (USB_FASTBOOT_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_FastBoot
+  * @{
+  */
+
+/** @defgroup USB_FastBoot_Private_Defines
+  * @{
+  */
+#if (USB_FASTBOOT_HSE_BYPASS == 1)
+#define USB_FASTBOOT_CR_HSE                         (RCC_CR_HSEON | RCC_CR_HSEBYP)
+#else
+#define USB_FASTBOOT_CR_HSE                         RCC_CR_HSEON
+#endif
+
+/* AHB at SYSCLK, APB1 at most 36 MHz, APB2 at SYSCLK */
+#if (USB_FASTBOOT_SYSCLK > 36000000U)
+#define USB_FASTBOOT_PPRE1                          RCC_CFGR_PPRE1_DIV2
+#else
+#define USB_FASTBOOT_PPRE1                          RCC_CFGR_PPRE1_DIV1
+#endif
+
+/* Flash wait states of SYSCLK */
+#if (USB_FASTBOOT_SYSCLK > 48000000U)
+#define USB_FASTBOOT_LATENCY                        FLASH_ACR_LATENCY_1
+#elif (USB_FASTBOOT_SYSCLK > 24000000U)
+#define USB_FASTBOOT_LATENCY                        FLASH_ACR_LATENCY_0
+#else
+#define USB_FASTBOOT_LATENCY                        0U
+#endif
+
+/* CYCCNT at HSI_VALUE until the switch */
+#define USB_FASTBOOT_HSE_TIMEOUT                    (USB_FASTBOOT_HSE_TIMEOUT_US * (HSI_VALUE / 1000000U))
+/**
+  * @}
+  */
+
+/** @defgroup USB_FastBoot_Private_Variables
+  * @{
+  */
+static USB_FastBootTimesTypeDef USB_FastBoot_Times;
+/**
+  * @}
+  */
+
+/** @defgroup USB_FastBoot_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Cycles counted at HSI_VALUE, in cycles at USB_FASTBOOT_SYSCLK
+  * @param  cycles: cycles
+  * @retval cycles
+  */
+static uint32_t USB_FastBoot_Scale(uint32_t cycles)
+{
+  return (uint32_t)(((uint64_t)cycles * USB_FASTBOOT_SYSCLK) / HSI_VALUE);
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_FastBoot_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Start the HSE and set up the PLL and prescalers, without waiting
+  * @note   Runs before the C runtime is set up: no global may be read or
+  *         written here.
+  * @retval None
+  */
+void USB_FastBoot_Start(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0U;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  RCC->CR |= USB_FASTBOOT_CR_HSE;
+
+  /* The PLL is off out of reset: its source, factor and the USB prescaler
+     may be written now, USBPRE before the USB clock is enabled */
+  RCC->CFGR2 = (RCC->CFGR2 & ~RCC_CFGR2_PREDIV) | USB_FASTBOOT_PREDIV;
+  RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2 |
+                             RCC_CFGR_PLLSRC | RCC_CFGR_PLLMUL | RCC_CFGR_USBPRE)) |
+              RCC_CFGR_HPRE_DIV1 | USB_FASTBOOT_PPRE1 | RCC_CFGR_PPRE2_DIV1 |
+              RCC_CFGR_PLLSRC_HSE_PREDIV | USB_FASTBOOT_PLLMUL | USB_FASTBOOT_USBPRE;
+}
+
+/**
+  * @brief  Take the clock start up one step further, without blocking
+  * @note   Call after the C runtime set up, as often as convenient until it
+  *         returns USB_FASTBOOT_READY: the stamps of USB_FastBoot_GetTimes
+  *         are taken here. SystemCoreClock is updated on the switch; a
+  *         SysTick set up before it runs slow.
+  * @retval USB_FASTBOOT_xxx
+  */
+uint32_t USB_FastBoot_Poll(void)
+{
+  uint32_t cr = RCC->CR;
+
+  if ((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL)
+  {
+    return USB_FASTBOOT_READY;
+  }
+
+  if ((cr & RCC_CR_HSERDY) == 0U)
+  {
+    return (DWT->CYCCNT < USB_FASTBOOT_HSE_TIMEOUT) ? USB_FASTBOOT_HSE_WAIT : USB_FASTBOOT_FAILED;
+  }
+  if ((cr & RCC_CR_PLLON) == 0U)
+  {
+    USB_FastBoot_Times.hse = DWT->CYCCNT;
+    RCC->CR |= RCC_CR_PLLON;
+    return USB_FASTBOOT_PLL_WAIT;
+  }
+  if ((cr & RCC_CR_PLLRDY) == 0U)
+  {
+    return USB_FASTBOOT_PLL_WAIT;
+  }
+
+  /* Wait states first, then the faster clock */
+  FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | USB_FASTBOOT_LATENCY | FLASH_ACR_PRFTBE;
+  RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+  while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL)
+  {
+  }
+
+  /* From here on CYCCNT counts at SYSCLK: count what went before as if it
+     had too, so that it reads as cycles since the reset */
+  DWT->CYCCNT = USB_FastBoot_Scale(DWT->CYCCNT);
+  USB_FastBoot_Times.hse = USB_FastBoot_Scale(USB_FastBoot_Times.hse);
+  USB_FastBoot_Times.pll = DWT->CYCCNT;
+  SystemCoreClock = USB_FASTBOOT_SYSCLK;
+
+  return USB_FASTBOOT_READY;
+}
+
+/**
+  * @brief  Poll until the USB clock is running
+  * @retval 1 if it is, 0 if the HSE did not start: the core then still runs
+  *         from the HSI and USB cannot be used
+  */
+uint8_t USB_FastBoot_Wait(void)
+{
+  uint32_t state;
+
+  do
+  {
+    state = USB_FastBoot_Poll();
+  } while ((state == USB_FASTBOOT_HSE_WAIT) || (state == USB_FASTBOOT_PLL_WAIT));
+
+  return (state == USB_FASTBOOT_READY) ? 1U : 0U;
+}
+
+/**
+  * @brief  Start up times, in cycles at USB_FASTBOOT_SYSCLK from
+  *         USB_FastBoot_Start
+  * @retval times, 0 for the steps not seen yet
+  */
+const USB_FastBootTimesTypeDef *USB_FastBoot_GetTimes(void)
+{
+  return &USB_FastBoot_Times;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_FASTBOOT_ENABLED */
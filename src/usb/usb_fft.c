@@ -0,0 +1,314 @@
+/**
+  ******************************************************************************
+  * @file    usb_fft.c
+  * @brief   FFT set up over selected tables, see usb_fft.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_conf.h"
+#include "usb_ccm.h"
+#include "usb_fft.h"
+
+#if (USB_FFT_ENABLED == 1)
+
+#include "arm_common_tables.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_FFT
+  * @{
+  */
+
+/** @defgroup USB_FFT_Private_Defines
+  * @{
+  */
+#if (USB_CCM_ENABLED == 1)
+#define USB_FFT_RAM                                 __attribute__((section(".ccmbss.usb"), aligned(4)))
+#else
+#define USB_FFT_RAM                                 __attribute__((aligned(4)))
+#endif
+
+#if (USB_FFT_TABLES_IN_RAM == 1)
+
+/* Copies of the tables of one complex length, and of one real length */
+#define USB_FFT_CFFT_RAM(n, brlen) \
+  static float32_t USB_FFT_Twiddle##n[2U * (n)] USB_FFT_RAM; \
+  static uint16_t USB_FFT_BitRev##n[brlen] USB_FFT_RAM; \
+  static uint8_t USB_FFT_CfftLoaded##n;
+#define USB_FFT_RFFT_RAM(n) \
+  static float32_t USB_FFT_TwiddleRfft##n[n] USB_FFT_RAM; \
+  static uint8_t USB_FFT_RfftLoaded##n;
+
+#define USB_FFT_CFFT_CASE(n, brlen) \
+  case (n): \
+    return USB_FFT_SetCfft(S, (n), twiddleCoef_##n, armBitRevIndexTable##n, \
+                           (brlen), USB_FFT_Twiddle##n, USB_FFT_BitRev##n, \
+                           &USB_FFT_CfftLoaded##n);
+#define USB_FFT_RFFT_CASE(n) \
+  case (n): \
+    tw = USB_FFT_Load(USB_FFT_TwiddleRfft##n, twiddleCoef_rfft_##n, \
+                      (n) * sizeof(float32_t), &USB_FFT_RfftLoaded##n); \
+    break;
+
+#else
+
+#define USB_FFT_CFFT_CASE(n, brlen) \
+  case (n): \
+    return USB_FFT_SetCfft(S, (n), twiddleCoef_##n, armBitRevIndexTable##n, \
+                           (brlen), NULL, NULL, NULL);
+#define USB_FFT_RFFT_CASE(n) \
+  case (n): \
+    tw = twiddleCoef_rfft_##n; \
+    break;
+
+#endif /* USB_FFT_TABLES_IN_RAM */
+/**
+  * @}
+  */
+
+/** @defgroup USB_FFT_Private_Variables
+  * @{
+  */
+#if (USB_FFT_TABLES_IN_RAM == 1)
+#if (USB_FFT_CFFT_F32_LEN_16 == 1)
+USB_FFT_CFFT_RAM(16, ARMBITREVINDEXTABLE__16_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_32 == 1)
+USB_FFT_CFFT_RAM(32, ARMBITREVINDEXTABLE__32_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_64 == 1)
+USB_FFT_CFFT_RAM(64, ARMBITREVINDEXTABLE__64_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_128 == 1)
+USB_FFT_CFFT_RAM(128, ARMBITREVINDEXTABLE_128_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_256 == 1)
+USB_FFT_CFFT_RAM(256, ARMBITREVINDEXTABLE_256_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_512 == 1)
+USB_FFT_CFFT_RAM(512, ARMBITREVINDEXTABLE_512_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_1024 == 1)
+USB_FFT_CFFT_RAM(1024, ARMBITREVINDEXTABLE1024_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_2048 == 1)
+USB_FFT_CFFT_RAM(2048, ARMBITREVINDEXTABLE2048_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_4096 == 1)
+USB_FFT_CFFT_RAM(4096, ARMBITREVINDEXTABLE4096_TABLE_LENGTH)
+#endif
+
+#if (USB_FFT_RFFT_F32_LEN_32 == 1)
+USB_FFT_RFFT_RAM(32)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_64 == 1)
+USB_FFT_RFFT_RAM(64)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_128 == 1)
+USB_FFT_RFFT_RAM(128)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_256 == 1)
+USB_FFT_RFFT_RAM(256)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_512 == 1)
+USB_FFT_RFFT_RAM(512)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_1024 == 1)
+USB_FFT_RFFT_RAM(1024)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_2048 == 1)
+USB_FFT_RFFT_RAM(2048)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_4096 == 1)
+USB_FFT_RFFT_RAM(4096)
+#endif
+#endif /* USB_FFT_TABLES_IN_RAM */
+/**
+  * @}
+  */
+
+/** @defgroup USB_FFT_Private_Functions
+  * @{
+  */
+
+#if (USB_FFT_TABLES_IN_RAM == 1)
+/**
+  * @brief  Copy a table to RAM the first time it is asked for
+  * @param  ram: copy
+  * @param  flash: table
+  * @param  size: bytes
+  * @param  loaded: set once the copy is made
+  * @retval the copy
+  */
+static void *USB_FFT_Load(void *ram, const void *flash, uint32_t size,
+                          uint8_t *loaded)
+{
+  if (*loaded == 0U)
+  {
+    memcpy(ram, flash, size);
+    *loaded = 1U;
+  }
+  return ram;
+}
+#endif /* USB_FFT_TABLES_IN_RAM */
+
+/**
+  * @brief  Fill a complex FFT instance
+  * @param  S: instance
+  * @param  fftLen: length
+  * @param  tw: twiddle table in flash
+  * @param  br: bit reversal table in flash
+  * @param  brlen: entries of br
+  * @param  tw_ram: copy of tw, or NULL to use the flash table
+  * @param  br_ram: copy of br, or NULL
+  * @param  loaded: set once the copies are made
+  * @retval ARM_MATH_SUCCESS
+  */
+static arm_status USB_FFT_SetCfft(arm_cfft_instance_f32 *S, uint16_t fftLen,
+                                  const float32_t *tw, const uint16_t *br,
+                                  uint16_t brlen, float32_t *tw_ram,
+                                  uint16_t *br_ram, uint8_t *loaded)
+{
+  S->fftLen = fftLen;
+  S->pTwiddle = tw;
+  S->pBitRevTable = br;
+  S->bitRevLength = brlen;
+
+#if (USB_FFT_TABLES_IN_RAM == 1)
+  if (*loaded == 0U)
+  {
+    memcpy(tw_ram, tw, 2U * fftLen * sizeof(float32_t));
+    memcpy(br_ram, br, brlen * sizeof(uint16_t));
+    *loaded = 1U;
+  }
+  S->pTwiddle = tw_ram;
+  S->pBitRevTable = br_ram;
+#else
+  (void)tw_ram;
+  (void)br_ram;
+  (void)loaded;
+#endif /* USB_FFT_TABLES_IN_RAM */
+
+  return ARM_MATH_SUCCESS;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_FFT_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up a complex FFT, as arm_cfft_sR_f32_len<fftLen> would
+  * @note   With USB_FFT_TABLES_IN_RAM, the first call for a length copies
+  *         its tables; do not call it while an FFT of that length runs.
+  * @param  S: instance for arm_cfft_f32
+  * @param  fftLen: length, one of the enabled ones
+  * @retval ARM_MATH_SUCCESS, ARM_MATH_ARGUMENT_ERROR if fftLen is not enabled
+  */
+arm_status USB_FFT_CfftInit_f32(arm_cfft_instance_f32 *S, uint16_t fftLen)
+{
+  switch (fftLen)
+  {
+#if (USB_FFT_CFFT_F32_LEN_16 == 1)
+    USB_FFT_CFFT_CASE(16, ARMBITREVINDEXTABLE__16_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_32 == 1)
+    USB_FFT_CFFT_CASE(32, ARMBITREVINDEXTABLE__32_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_64 == 1)
+    USB_FFT_CFFT_CASE(64, ARMBITREVINDEXTABLE__64_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_128 == 1)
+    USB_FFT_CFFT_CASE(128, ARMBITREVINDEXTABLE_128_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_256 == 1)
+    USB_FFT_CFFT_CASE(256, ARMBITREVINDEXTABLE_256_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_512 == 1)
+    USB_FFT_CFFT_CASE(512, ARMBITREVINDEXTABLE_512_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_1024 == 1)
+    USB_FFT_CFFT_CASE(1024, ARMBITREVINDEXTABLE1024_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_2048 == 1)
+    USB_FFT_CFFT_CASE(2048, ARMBITREVINDEXTABLE2048_TABLE_LENGTH)
+#endif
+#if (USB_FFT_CFFT_F32_LEN_4096 == 1)
+    USB_FFT_CFFT_CASE(4096, ARMBITREVINDEXTABLE4096_TABLE_LENGTH)
+#endif
+    default:
+      break;
+  }
+
+  return ARM_MATH_ARGUMENT_ERROR;
+}
+
+/**
+  * @brief  Set up a real FFT, as arm_rfft_fast_init_f32 does
+  * @note   As USB_FFT_CfftInit_f32 for the tables in RAM.
+  * @param  S: instance for arm_rfft_fast_f32
+  * @param  fftLen: length, one of the enabled ones
+  * @retval ARM_MATH_SUCCESS, ARM_MATH_ARGUMENT_ERROR if fftLen is not enabled
+  */
+arm_status USB_FFT_RfftInit_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen)
+{
+  const float32_t *tw = NULL;
+
+  switch (fftLen)
+  {
+#if (USB_FFT_RFFT_F32_LEN_32 == 1)
+    USB_FFT_RFFT_CASE(32)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_64 == 1)
+    USB_FFT_RFFT_CASE(64)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_128 == 1)
+    USB_FFT_RFFT_CASE(128)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_256 == 1)
+    USB_FFT_RFFT_CASE(256)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_512 == 1)
+    USB_FFT_RFFT_CASE(512)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_1024 == 1)
+    USB_FFT_RFFT_CASE(1024)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_2048 == 1)
+    USB_FFT_RFFT_CASE(2048)
+#endif
+#if (USB_FFT_RFFT_F32_LEN_4096 == 1)
+    USB_FFT_RFFT_CASE(4096)
+#endif
+    default:
+      return ARM_MATH_ARGUMENT_ERROR;
+  }
+
+  if (USB_FFT_CfftInit_f32(&S->Sint, fftLen / 2U) != ARM_MATH_SUCCESS)
+  {
+    return ARM_MATH_ARGUMENT_ERROR;
+  }
+  S->fftLenRFFT = fftLen;
+  S->pTwiddleRFFT = (float32_t *)tw;
+
+  return ARM_MATH_SUCCESS;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_FFT_ENABLED */
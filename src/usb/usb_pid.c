@@ -0,0 +1,346 @@
+/**
+  ******************************************************************************
+  * @file    usb_pid.c
+  * @brief   Batched PID controllers, see usb_pid.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_pid.h"
+
+#if (USB_PID_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_PID
+  * @{
+  */
+
+/** @defgroup USB_PID_Private_Defines
+  * @{
+  */
+/* Dual MAC kernels need the DSP extension */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 0x04U)
+#define USB_PID_SIMD                                1
+#else
+#define USB_PID_SIMD                                0
+#endif
+
+#define USB_PID_ALIGNED(p)                          ((((uint32_t)(p)) & 0x3U) == 0U)
+/**
+  * @}
+  */
+
+/** @defgroup USB_PID_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Saturate to the q15 range
+  * @param  v: value
+  * @retval saturated value
+  */
+static inline q15_t USB_PID_Sat15(int64_t v)
+{
+  if (v > 32767)
+  {
+    return 32767;
+  }
+  if (v < -32768)
+  {
+    return -32768;
+  }
+  return (q15_t)v;
+}
+
+/**
+  * @brief  Saturate to the q31 range
+  * @param  v: value
+  * @retval saturated value
+  */
+static inline q31_t USB_PID_Sat31(int64_t v)
+{
+  if (v > 0x7FFFFFFF)
+  {
+    return 0x7FFFFFFF;
+  }
+  if (v < -0x7FFFFFFF - 1)
+  {
+    return -0x7FFFFFFF - 1;
+  }
+  return (q31_t)v;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_PID_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Derive the coefficients of a float bank from its gains
+  * @param  S: bank, numAxes and the arrays set
+  * @param  Kp: proportional gain of each axis
+  * @param  Ki: integral gain of each axis
+  * @param  Kd: derivative gain of each axis
+  * @param  resetStateFlag: 1 to clear the state as well
+  * @retval None
+  */
+void USB_PID_Init_f32(USB_PID_BankF32TypeDef *S, const float32_t *Kp,
+                      const float32_t *Ki, const float32_t *Kd,
+                      int32_t resetStateFlag)
+{
+  uint32_t i;
+
+  for (i = 0U; i < S->numAxes; i++)
+  {
+    S->A0[i] = Kp[i] + Ki[i] + Kd[i];
+    S->A1[i] = -Kp[i] - 2.0f * Kd[i];
+    S->A2[i] = Kd[i];
+  }
+  if (resetStateFlag)
+  {
+    USB_PID_Reset_f32(S);
+  }
+}
+
+/**
+  * @brief  Clear the state of every axis of a float bank
+  * @param  S: bank
+  * @retval None
+  */
+void USB_PID_Reset_f32(USB_PID_BankF32TypeDef *S)
+{
+  uint32_t i;
+
+  for (i = 0U; i < 3U * S->numAxes; i++)
+  {
+    S->state[i] = 0.0f;
+  }
+}
+
+/**
+  * @brief  One tick of every axis of a float bank
+  * @param  S: bank
+  * @param  in: error input of each axis
+  * @param  out: output of each axis, may be in
+  * @retval None
+  */
+void USB_PID_f32(USB_PID_BankF32TypeDef *S, const float32_t *in, float32_t *out)
+{
+  uint32_t n = S->numAxes;
+  const float32_t *a0 = S->A0;
+  const float32_t *a1 = S->A1;
+  const float32_t *a2 = S->A2;
+  float32_t *x1 = S->state;
+  float32_t *x2 = x1 + n;
+  float32_t *y1 = x2 + n;
+  float32_t x, y;
+  uint32_t i;
+
+  for (i = 0U; i < n; i++)
+  {
+    x = in[i];
+    /* in the order of arm_pid_f32, for the same rounding */
+    y = (a0[i] * x) + (a1[i] * x1[i]) + (a2[i] * x2[i]) + y1[i];
+    x2[i] = x1[i];
+    x1[i] = x;
+    y1[i] = y;
+    out[i] = y;
+  }
+}
+
+/**
+  * @brief  Derive the coefficients of a q31 bank from its gains, with
+  *         saturation
+  * @param  S: bank, numAxes and the arrays set
+  * @param  Kp: proportional gain of each axis
+  * @param  Ki: integral gain of each axis
+  * @param  Kd: derivative gain of each axis
+  * @param  resetStateFlag: 1 to clear the state as well
+  * @retval None
+  */
+void USB_PID_Init_q31(USB_PID_BankQ31TypeDef *S, const q31_t *Kp,
+                      const q31_t *Ki, const q31_t *Kd,
+                      int32_t resetStateFlag)
+{
+  uint32_t i;
+
+  for (i = 0U; i < S->numAxes; i++)
+  {
+    S->A0[i] = USB_PID_Sat31((int64_t)USB_PID_Sat31((int64_t)Kp[i] + Ki[i]) + Kd[i]);
+    S->A1[i] = -USB_PID_Sat31((int64_t)USB_PID_Sat31((int64_t)Kd[i] + Kd[i]) + Kp[i]);
+    S->A2[i] = Kd[i];
+  }
+  if (resetStateFlag)
+  {
+    USB_PID_Reset_q31(S);
+  }
+}
+
+/**
+  * @brief  Clear the state of every axis of a q31 bank
+  * @param  S: bank
+  * @retval None
+  */
+void USB_PID_Reset_q31(USB_PID_BankQ31TypeDef *S)
+{
+  uint32_t i;
+
+  for (i = 0U; i < 3U * S->numAxes; i++)
+  {
+    S->state[i] = 0;
+  }
+}
+
+/**
+  * @brief  One tick of every axis of a q31 bank
+  * @note   As arm_pid_q31: 64-bit accumulator truncated to 1.31, y[n-1]
+  *         added without saturation.
+  * @param  S: bank
+  * @param  in: error input of each axis
+  * @param  out: output of each axis, may be in
+  * @retval None
+  */
+void USB_PID_q31(USB_PID_BankQ31TypeDef *S, const q31_t *in, q31_t *out)
+{
+  uint32_t n = S->numAxes;
+  const q31_t *a0 = S->A0;
+  const q31_t *a1 = S->A1;
+  const q31_t *a2 = S->A2;
+  q31_t *x1 = S->state;
+  q31_t *x2 = x1 + n;
+  q31_t *y1 = x2 + n;
+  q63_t acc;
+  q31_t x, y;
+  uint32_t i;
+
+  for (i = 0U; i < n; i++)
+  {
+    x = in[i];
+    acc = (q63_t)a0[i] * x;
+    acc += (q63_t)a1[i] * x1[i];
+    acc += (q63_t)a2[i] * x2[i];
+    y = (q31_t)((uint32_t)(q31_t)(acc >> 31) + (uint32_t)y1[i]);
+    x2[i] = x1[i];
+    x1[i] = x;
+    y1[i] = y;
+    out[i] = y;
+  }
+}
+
+/**
+  * @brief  Derive the coefficients of a q15 bank from its gains, with
+  *         saturation
+  * @param  S: bank, numAxes and the arrays set
+  * @param  Kp: proportional gain of each axis
+  * @param  Ki: integral gain of each axis
+  * @param  Kd: derivative gain of each axis
+  * @param  resetStateFlag: 1 to clear the state as well
+  * @retval None
+  */
+void USB_PID_Init_q15(USB_PID_BankQ15TypeDef *S, const q15_t *Kp,
+                      const q15_t *Ki, const q15_t *Kd,
+                      int32_t resetStateFlag)
+{
+  q15_t a1;
+  uint32_t i;
+
+  for (i = 0U; i < S->numAxes; i++)
+  {
+    S->A0[i] = USB_PID_Sat15((int32_t)USB_PID_Sat15((int32_t)Kp[i] + Ki[i]) + Kd[i]);
+    a1 = USB_PID_Sat15(-(int32_t)USB_PID_Sat15((int32_t)Kd[i] + Kd[i]) - Kp[i]);
+    S->A12[i] = (q31_t)(((uint32_t)(uint16_t)Kd[i] << 16) | (uint16_t)a1);
+  }
+  if (resetStateFlag)
+  {
+    USB_PID_Reset_q15(S);
+  }
+}
+
+/**
+  * @brief  Clear the state of every axis of a q15 bank
+  * @param  S: bank
+  * @retval None
+  */
+void USB_PID_Reset_q15(USB_PID_BankQ15TypeDef *S)
+{
+  uint32_t i;
+
+  for (i = 0U; i < 3U * S->numAxes; i++)
+  {
+    S->state[i] = 0;
+  }
+}
+
+/**
+  * @brief  One tick of every axis of a q15 bank
+  * @note   As arm_pid_q15: 64-bit accumulator in 34.30, truncated to 1.15
+  *         and saturated. Packed when state is word aligned: the x[n-1],
+  *         x[n-2] word of an axis is one __SMLALD against its A12 word.
+  * @param  S: bank
+  * @param  in: error input of each axis
+  * @param  out: output of each axis, may be in
+  * @retval None
+  */
+void USB_PID_q15(USB_PID_BankQ15TypeDef *S, const q15_t *in, q15_t *out)
+{
+  uint32_t n = S->numAxes;
+  const q15_t *a0 = S->A0;
+  q15_t *x12 = S->state;
+  q15_t *y1 = x12 + 2U * n;
+  q63_t acc;
+  q15_t x, y;
+  uint32_t i = 0U;
+
+#if (USB_PID_SIMD == 1)
+  if (USB_PID_ALIGNED(x12))
+  {
+    const uint32_t *a12 = (const uint32_t *)S->A12;
+    uint32_t *s = (uint32_t *)(void *)x12;
+
+    for (; i < n; i++)
+    {
+      x = in[i];
+      acc = (q63_t)((q31_t)a0[i] * x);
+      acc = (q63_t)__SMLALD(a12[i], s[i], (uint64_t)acc);
+      acc += (q31_t)y1[i] << 15;
+      y = (q15_t)__SSAT((q31_t)(acc >> 15), 16);
+      /* x[n] in the low half, x[n-1] moves up */
+      s[i] = __PKHBT((uint32_t)(uint16_t)x, s[i], 16);
+      y1[i] = y;
+      out[i] = y;
+    }
+  }
+#endif /* USB_PID_SIMD */
+
+  for (; i < n; i++)
+  {
+    x = in[i];
+    acc = (q31_t)a0[i] * x;
+    acc += (q31_t)(q15_t)S->A12[i] * x12[2U * i];
+    acc += (q31_t)(q15_t)(S->A12[i] >> 16) * x12[2U * i + 1U];
+    acc += (q31_t)y1[i] << 15;
+    y = USB_PID_Sat15(acc >> 15);
+    x12[2U * i + 1U] = x12[2U * i];
+    x12[2U * i] = x;
+    y1[i] = y;
+    out[i] = y;
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_PID_ENABLED */
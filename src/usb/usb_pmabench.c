@@ -0,0 +1,266 @@
+/**
+  ******************************************************************************
+  * @file    usb_pmabench.c
+  * @brief   Cycle counts of the F3 packet memory copies, see usb_pmabench.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usbd_cdc_pma.h"
+#include "usb_pmabench.h"
+
+#if (USB_PMABENCH_ENABLED == 1)
+
+#if (USB_PMABENCH_PMA_ADDR + USB_PMABENCH_MAX_SIZE > USBD_PMA_SIZE) || \
+    (USB_PMABENCH_PMA_ADDR < USBD_CDC_PMA_END)
+#error "USB_PMABENCH_PMA_ADDR is not free packet memory"
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_PMABench
+  * @{
+  */
+
+/** @defgroup USB_PMABench_Private_Defines
+  * @{
+  */
+/* Access scheme of the part, as chosen in stm32f3xx_hal_pcd_ex.c */
+#if defined(STM32F302xE) || defined(STM32F303xE) || \
+    defined(STM32F302x8)
+#define USB_PMABENCH_LAYOUT                         "1x16"
+#else
+#define USB_PMABENCH_LAYOUT                         "2x16"
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Exported_Variables
+  * @{
+  */
+USB_PMABenchTypeDef USB_PMABench;
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Private_Variables
+  * @{
+  */
+/* User side of the copies, word aligned so that +N is alignment N */
+static uint32_t USB_PMABench_Buf[(USB_PMABENCH_MAX_SIZE + USB_PMABENCH_NUM_ALIGN) / 4U];
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Append a decimal number
+  * @param  p: where to write
+  * @param  value: number
+  * @retval end of the text
+  */
+static char *USB_PMABench_PutU(char *p, uint32_t value)
+{
+  char tmp[10];
+  uint32_t n = 0U;
+
+  do
+  {
+    tmp[n++] = (char)('0' + (value % 10U));
+    value /= 10U;
+  } while (value != 0U);
+
+  while (n != 0U)
+  {
+    *p++ = tmp[--n];
+  }
+  return p;
+}
+
+/**
+  * @brief  Append a string
+  * @param  p: where to write
+  * @param  s: NUL terminated string
+  * @retval end of the text
+  */
+static char *USB_PMABench_PutS(char *p, const char *s)
+{
+  while (*s != '\0')
+  {
+    *p++ = *s++;
+  }
+  return p;
+}
+
+/**
+  * @brief  Append cycles per byte with two decimals, rounded
+  * @param  p: where to write
+  * @param  cycles: cycles of the copy
+  * @param  size: bytes of the copy
+  * @retval end of the text
+  */
+static char *USB_PMABench_PutCpb(char *p, uint32_t cycles, uint32_t size)
+{
+  uint32_t cpb = (cycles * 100U + size / 2U) / size;
+
+  *p++ = ' ';
+  p = USB_PMABench_PutU(p, cpb / 100U);
+  *p++ = '.';
+  *p++ = (char)('0' + (cpb / 10U) % 10U);
+  *p++ = (char)('0' + cpb % 10U);
+  return p;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_PMABench_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Time every size and alignment of both copies
+  * @note   Takes a few tens of milliseconds, with interrupts off for one
+  *         copy at a time. The scratch packet memory is overwritten.
+  * @param  USBx: USB peripheral instance
+  * @retval None
+  */
+void USB_PMABench_Run(USB_TypeDef *USBx)
+{
+  USB_PMABenchTypeDef *b = &USB_PMABench;
+  uint8_t *buf = (uint8_t *)USB_PMABench_Buf;
+  uint32_t primask;
+  uint32_t t0;
+  uint32_t t;
+  uint32_t best;
+  uint32_t align;
+  uint32_t size;
+  uint32_t i;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  for (i = 0U; i < sizeof(USB_PMABench_Buf); i++)
+  {
+    buf[i] = (uint8_t)(i * 7U);
+  }
+
+  best = 0xFFFFFFFFU;
+  for (i = 0U; i < USB_PMABENCH_REPS; i++)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    t0 = DWT->CYCCNT;
+    t = DWT->CYCCNT - t0;
+    __set_PRIMASK(primask);
+    best = MIN(best, t);
+  }
+  b->overhead = (uint16_t)best;
+
+  for (align = 0U; align < USB_PMABENCH_NUM_ALIGN; align++)
+  {
+    for (size = 1U; size <= USB_PMABENCH_MAX_SIZE; size++)
+    {
+      best = 0xFFFFFFFFU;
+      for (i = 0U; i < USB_PMABENCH_REPS; i++)
+      {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        t0 = DWT->CYCCNT;
+        PCD_WritePMA(USBx, buf + align, USB_PMABENCH_PMA_ADDR, (uint16_t)size);
+        t = DWT->CYCCNT - t0;
+        __set_PRIMASK(primask);
+        best = MIN(best, t);
+      }
+      b->write[align][size - 1U] = (uint16_t)(best - b->overhead);
+
+      best = 0xFFFFFFFFU;
+      for (i = 0U; i < USB_PMABENCH_REPS; i++)
+      {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        t0 = DWT->CYCCNT;
+        PCD_ReadPMA(USBx, buf + align, USB_PMABENCH_PMA_ADDR, (uint16_t)size);
+        t = DWT->CYCCNT - t0;
+        __set_PRIMASK(primask);
+        best = MIN(best, t);
+      }
+      b->read[align][size - 1U] = (uint16_t)(best - b->overhead);
+    }
+  }
+
+  b->done = 1U;
+}
+
+/**
+  * @brief  One line of the text report, see usb_pmabench.h
+  * @param  line: 0 to USB_PMABENCH_NUM_LINES - 1
+  * @param  buf: USB_PMABENCH_LINE_SIZE bytes
+  * @retval length of the line, newline included; 0 past the last one or
+  *         before a run
+  */
+uint32_t USB_PMABench_Line(uint32_t line, char *buf)
+{
+  USB_PMABenchTypeDef *b = &USB_PMABench;
+  char *p = buf;
+  uint32_t align;
+
+  if ((b->done == 0U) || (line >= USB_PMABENCH_NUM_LINES))
+  {
+    return 0U;
+  }
+
+  if (line == 0U)
+  {
+    p = USB_PMABench_PutS(p, "pma " USB_PMABENCH_LAYOUT " clock ");
+    p = USB_PMABench_PutU(p, SystemCoreClock);
+    p = USB_PMABench_PutS(p, " reps ");
+    p = USB_PMABench_PutU(p, USB_PMABENCH_REPS);
+  }
+  else if (line == 1U)
+  {
+    p = USB_PMABench_PutS(p, "size w0 w1 w2 w3 r0 r1 r2 r3");
+  }
+  else if (line == USB_PMABENCH_NUM_LINES - 1U)
+  {
+    p = USB_PMABench_PutS(p, "end");
+  }
+  else
+  {
+    uint32_t size = line - 1U;
+
+    p = USB_PMABench_PutU(p, size);
+    for (align = 0U; align < USB_PMABENCH_NUM_ALIGN; align++)
+    {
+      p = USB_PMABench_PutCpb(p, b->write[align][size - 1U], size);
+    }
+    for (align = 0U; align < USB_PMABENCH_NUM_ALIGN; align++)
+    {
+      p = USB_PMABench_PutCpb(p, b->read[align][size - 1U], size);
+    }
+  }
+
+  *p++ = '\n';
+  *p = '\0';
+  return (uint32_t)(p - buf);
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_PMABENCH_ENABLED */
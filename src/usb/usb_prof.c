@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file    usb_prof.c
+  * @brief   Cycle count profiling of the USB device hot paths, see usb_prof.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_prof.h"
+
+#if (USB_PROF_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Prof
+  * @{
+  */
+
+/** @defgroup USB_Prof_Exported_Variables
+  * @{
+  */
+USB_ProfStatTypeDef USB_ProfStats[USB_PROF_NUM_PATHS][USB_PROF_NUM_EP];
+/**
+  * @}
+  */
+
+/** @defgroup USB_Prof_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Start the DWT cycle counter and clear all statistics
+  * @retval None
+  */
+void USB_Prof_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0U;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  USB_Prof_Reset();
+}
+
+/**
+  * @brief  Clear all statistics
+  * @retval None
+  */
+void USB_Prof_Reset(void)
+{
+  uint32_t path;
+  uint32_t ep;
+
+  for (path = 0U; path < USB_PROF_NUM_PATHS; path++)
+  {
+    for (ep = 0U; ep < USB_PROF_NUM_EP; ep++)
+    {
+      USB_ProfStats[path][ep].min = 0xFFFFFFFFU;
+      USB_ProfStats[path][ep].max = 0U;
+      USB_ProfStats[path][ep].count = 0U;
+      USB_ProfStats[path][ep].total = 0U;
+    }
+  }
+}
+
+/**
+  * @brief  Statistics of one path on one endpoint
+  * @param  path: profiled code path, USB_PROF_xxx
+  * @param  epnum: endpoint number
+  * @retval pointer to the statistics, NULL if path is out of range
+  */
+const USB_ProfStatTypeDef *USB_Prof_Get(uint32_t path, uint32_t epnum)
+{
+  if (path >= USB_PROF_NUM_PATHS)
+  {
+    return NULL;
+  }
+
+  return &USB_ProfStats[path][epnum & (USB_PROF_NUM_EP - 1U)];
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_PROF_ENABLED */
@@ -0,0 +1,341 @@
+/**
+  ******************************************************************************
+  * @file    usb_samples.c
+  * @brief   Sample payload packing, see usb_samples.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_samples.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Samples
+  * @{
+  */
+
+/** @defgroup USB_Samples_Private_Defines
+  * @{
+  */
+/* Packed kernels need the DSP extension */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 0x04U)
+#define USB_SAMPLES_SIMD                            1
+#else
+#define USB_SAMPLES_SIMD                            0
+#endif
+
+#define USB_SAMPLES_ALIGNED(p)                      ((((uint32_t)(p)) & 0x3U) == 0U)
+
+/* Rounding of a q15 product back to q15 */
+#define USB_SAMPLES_ROUND                           0x4000
+/**
+  * @}
+  */
+
+/** @defgroup USB_Samples_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Saturate to the int16 range
+  * @param  v: value
+  * @retval saturated value
+  */
+static inline int16_t USB_Samples_Sat(int32_t v)
+{
+  if (v > 32767)
+  {
+    return 32767;
+  }
+  if (v < -32768)
+  {
+    return -32768;
+  }
+  return (int16_t)v;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Samples_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Split an interleaved payload into one block per channel
+  * @note   Packed when channels is even and src and every dst are word
+  *         aligned: each pair of channels is split two frames at a time.
+  * @param  src: frames of channels samples each
+  * @param  dst: one block of frames samples per channel
+  * @param  channels: samples per frame
+  * @param  frames: number of frames
+  * @retval None
+  */
+void USB_Samples_Deinterleave(const int16_t *src, int16_t *const *dst,
+                              uint32_t channels, uint32_t frames)
+{
+  uint32_t c;
+  uint32_t f = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  uint32_t packed = ((channels & 1U) == 0U) && USB_SAMPLES_ALIGNED(src);
+
+  for (c = 0U; packed && (c < channels); c++)
+  {
+    packed = USB_SAMPLES_ALIGNED(dst[c]);
+  }
+
+  if (packed)
+  {
+    uint32_t stride = channels >> 1;
+
+    for (c = 0U; c < channels; c += 2U)
+    {
+      const uint32_t *s = (const uint32_t *)(const void *)(src + c);
+      uint32_t *l = (uint32_t *)(void *)dst[c];
+      uint32_t *r = (uint32_t *)(void *)dst[c + 1U];
+      uint32_t w0, w1;
+
+      for (f = 0U; (f + 2U) <= frames; f += 2U)
+      {
+        w0 = s[0];
+        w1 = s[stride];
+        s += 2U * stride;
+        *l++ = __PKHBT(w0, w1, 16);
+        *r++ = __PKHTB(w1, w0, 16);
+      }
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  /* odd frame, or everything without the packed path */
+  for (; f < frames; f++)
+  {
+    for (c = 0U; c < channels; c++)
+    {
+      dst[c][f] = src[f * channels + c];
+    }
+  }
+}
+
+/**
+  * @brief  Join one block per channel into an interleaved payload
+  * @note   Packed under the same conditions as USB_Samples_Deinterleave.
+  * @param  src: one block of frames samples per channel
+  * @param  dst: frames of channels samples each
+  * @param  channels: samples per frame
+  * @param  frames: number of frames
+  * @retval None
+  */
+void USB_Samples_Interleave(const int16_t *const *src, int16_t *dst,
+                            uint32_t channels, uint32_t frames)
+{
+  uint32_t c;
+  uint32_t f = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  uint32_t packed = ((channels & 1U) == 0U) && USB_SAMPLES_ALIGNED(dst);
+
+  for (c = 0U; packed && (c < channels); c++)
+  {
+    packed = USB_SAMPLES_ALIGNED(src[c]);
+  }
+
+  if (packed)
+  {
+    uint32_t stride = channels >> 1;
+
+    for (c = 0U; c < channels; c += 2U)
+    {
+      const uint32_t *l = (const uint32_t *)(const void *)src[c];
+      const uint32_t *r = (const uint32_t *)(const void *)src[c + 1U];
+      uint32_t *d = (uint32_t *)(void *)(dst + c);
+      uint32_t wl, wr;
+
+      for (f = 0U; (f + 2U) <= frames; f += 2U)
+      {
+        wl = *l++;
+        wr = *r++;
+        d[0] = __PKHBT(wl, wr, 16);
+        d[stride] = __PKHTB(wr, wl, 16);
+        d += 2U * stride;
+      }
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  for (; f < frames; f++)
+  {
+    for (c = 0U; c < channels; c++)
+    {
+      dst[f * channels + c] = src[c][f];
+    }
+  }
+}
+
+/**
+  * @brief  Scale and shift a block in place: x * gain / 32768 + offset,
+  *         rounded and saturated
+  * @note   Packed when buf is word aligned: the offset rides in the
+  *         accumulator of one __SMLAD per sample.
+  * @param  buf: samples
+  * @param  count: number of samples
+  * @param  gain: q15 gain, USB_SAMPLES_GAIN_ONE for unity
+  * @param  offset: added after the gain
+  * @retval None
+  */
+void USB_Samples_Gain(int16_t *buf, uint32_t count, int16_t gain, int16_t offset)
+{
+  int32_t acc = (int32_t)offset * 32768 + USB_SAMPLES_ROUND;
+  uint32_t i = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  if (USB_SAMPLES_ALIGNED(buf))
+  {
+    uint32_t *p = (uint32_t *)(void *)buf;
+    uint32_t g = (uint16_t)gain;
+    int32_t lo, hi;
+
+    for (; (i + 2U) <= count; i += 2U)
+    {
+      /* low sample times the gain, then the high one with the halves swapped */
+      lo = (int32_t)__SMLAD(*p, g, (uint32_t)acc) >> 15;
+      hi = (int32_t)__SMLADX(*p, g, (uint32_t)acc) >> 15;
+      *p++ = __PKHBT((uint32_t)__SSAT(lo, 16), (uint32_t)__SSAT(hi, 16), 16);
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  for (; i < count; i++)
+  {
+    buf[i] = USB_Samples_Sat(((int32_t)buf[i] * gain + acc) >> 15);
+  }
+}
+
+/**
+  * @brief  Mix a stereo payload down to mono: (L * gain_l + R * gain_r) / 32768,
+  *         rounded and saturated
+  * @note   Packed when src and dst are word aligned: one __SMLAD per frame.
+  * @param  src: interleaved left/right frames
+  * @param  dst: frames mono samples
+  * @param  frames: number of frames
+  * @param  gain_l: q15 gain of the left channel, -32767 to 32767
+  * @param  gain_r: q15 gain of the right channel, -32767 to 32767
+  * @retval None
+  */
+void USB_Samples_Downmix2(const int16_t *src, int16_t *dst, uint32_t frames,
+                          int16_t gain_l, int16_t gain_r)
+{
+  uint32_t f = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  if (USB_SAMPLES_ALIGNED(src) && USB_SAMPLES_ALIGNED(dst))
+  {
+    const uint32_t *s = (const uint32_t *)(const void *)src;
+    uint32_t *d = (uint32_t *)(void *)dst;
+    uint32_t g = ((uint32_t)(uint16_t)gain_r << 16) | (uint16_t)gain_l;
+    int32_t m0, m1;
+
+    for (; (f + 2U) <= frames; f += 2U)
+    {
+      m0 = (int32_t)__SMLAD(s[0], g, USB_SAMPLES_ROUND) >> 15;
+      m1 = (int32_t)__SMLAD(s[1], g, USB_SAMPLES_ROUND) >> 15;
+      s += 2U;
+      *d++ = __PKHBT((uint32_t)__SSAT(m0, 16), (uint32_t)__SSAT(m1, 16), 16);
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  for (; f < frames; f++)
+  {
+    dst[f] = USB_Samples_Sat(((int32_t)src[2U * f] * gain_l +
+                              (int32_t)src[2U * f + 1U] * gain_r +
+                              USB_SAMPLES_ROUND) >> 15);
+  }
+}
+
+/**
+  * @brief  Saturating sum of two blocks, into dst
+  * @note   Packed with __QADD16 when both are word aligned.
+  * @param  dst: first operand and result
+  * @param  src: second operand
+  * @param  count: number of samples
+  * @retval None
+  */
+void USB_Samples_Add(int16_t *dst, const int16_t *src, uint32_t count)
+{
+  uint32_t i = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  if (USB_SAMPLES_ALIGNED(src) && USB_SAMPLES_ALIGNED(dst))
+  {
+    const uint32_t *s = (const uint32_t *)(const void *)src;
+    uint32_t *d = (uint32_t *)(void *)dst;
+
+    for (; (i + 4U) <= count; i += 4U)
+    {
+      d[0] = __QADD16(d[0], s[0]);
+      d[1] = __QADD16(d[1], s[1]);
+      d += 2U;
+      s += 2U;
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  for (; i < count; i++)
+  {
+    dst[i] = USB_Samples_Sat((int32_t)dst[i] + src[i]);
+  }
+}
+
+/**
+  * @brief  Sign extend 8-bit samples to 16 bits, without scaling
+  * @note   Packed when src and dst are word aligned: __SXTB16 extends
+  *         bytes 0 and 2 of a word, and bytes 1 and 3 after a rotate.
+  * @param  src: 8-bit samples
+  * @param  dst: 16-bit samples
+  * @param  count: number of samples
+  * @retval None
+  */
+void USB_Samples_Widen8(const int8_t *src, int16_t *dst, uint32_t count)
+{
+  uint32_t i = 0U;
+
+#if (USB_SAMPLES_SIMD == 1)
+  if (USB_SAMPLES_ALIGNED(src) && USB_SAMPLES_ALIGNED(dst))
+  {
+    const uint32_t *s = (const uint32_t *)(const void *)src;
+    uint32_t *d = (uint32_t *)(void *)dst;
+    uint32_t even, odd;
+
+    for (; (i + 4U) <= count; i += 4U)
+    {
+      even = __SXTB16(*s);
+      odd = __SXTB16(__ROR(*s, 8));
+      s++;
+      d[0] = __PKHBT(even, odd, 16);
+      d[1] = __PKHTB(odd, even, 16);
+      d += 2U;
+    }
+  }
+#endif /* USB_SAMPLES_SIMD */
+
+  for (; i < count; i++)
+  {
+    dst[i] = src[i];
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    usb_stats.c
+  * @brief   Link statistics of the USB device, see usb_stats.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usb_stats.h"
+
+#if (USB_STATS_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Stats
+  * @{
+  */
+
+/** @defgroup USB_Stats_Private_Defines
+  * @{
+  */
+/* The frame number register counts modulo 2048 */
+#define USB_STATS_FRAME_MASK                        0x07FFU
+/**
+  * @}
+  */
+
+/** @defgroup USB_Stats_Exported_Variables
+  * @{
+  */
+USB_StatsTypeDef USB_Stats;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Stats_Private_Variables
+  * @{
+  */
+/* Copy handed to the control pipe, which sends it over several packets */
+static USB_StatsTypeDef USB_StatsShadow;
+
+/* Frame at which each OUT endpoint went idle; bit n of the mask is set
+   while endpoint n waits for a re-arm */
+static uint16_t USB_StatsIdleFrame[USB_STATS_NUM_EP];
+static uint32_t USB_StatsIdleMask;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Stats_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Clear all counters
+  * @retval None
+  */
+void USB_Stats_Reset(void)
+{
+  memset(&USB_Stats, 0, sizeof(USB_Stats));
+}
+
+/**
+  * @brief  Take a copy of the counters that stays stable while it is sent
+  * @retval pointer to the copy
+  */
+const USB_StatsTypeDef *USB_Stats_Snapshot(void)
+{
+  USB_StatsShadow = USB_Stats;
+  return &USB_StatsShadow;
+}
+
+/**
+  * @brief  Note the end of an OUT transfer: the endpoint NAKs from now on
+  * @param  epnum: endpoint number
+  * @param  frame: current frame number
+  * @retval None
+  */
+void USB_Stats_OutIdle(uint32_t epnum, uint16_t frame)
+{
+  epnum &= USB_STATS_NUM_EP - 1U;
+
+  USB_StatsIdleFrame[epnum] = frame;
+  USB_StatsIdleMask |= 1U << epnum;
+}
+
+/**
+  * @brief  Note the re-arm of an OUT endpoint and account the frames it
+  *         spent idle since USB_Stats_OutIdle
+  * @param  epnum: endpoint number
+  * @param  frame: current frame number
+  * @retval None
+  */
+void USB_Stats_OutArmed(uint32_t epnum, uint16_t frame)
+{
+  epnum &= USB_STATS_NUM_EP - 1U;
+
+  if ((USB_StatsIdleMask & (1U << epnum)) != 0U)
+  {
+    USB_StatsIdleMask &= ~(1U << epnum);
+    USB_Stats.ep[epnum].nak_frames +=
+      (uint16_t)(frame - USB_StatsIdleFrame[epnum]) & USB_STATS_FRAME_MASK;
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_STATS_ENABLED */
@@ -0,0 +1,310 @@
+/**
+  ******************************************************************************
+  * @file    usb_suspend.c
+  * @brief   STOP mode while the bus is suspended, see usb_suspend.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usbd_core.h"
+#include "usb_suspend.h"
+#include "usb_tick.h"
+
+#if (USB_SUSPEND_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Suspend
+  * @{
+  */
+
+/** @defgroup USB_Suspend_Private_Defines
+  * @{
+  */
+#if defined(RCC_CR_PLLI2SON)
+#define USB_SUSPEND_CR_OSC                          (RCC_CR_HSEON | RCC_CR_PLLON | RCC_CR_PLLI2SON)
+#else
+#define USB_SUSPEND_CR_OSC                          (RCC_CR_HSEON | RCC_CR_PLLON)
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USB_Suspend_Private_Variables
+  * @{
+  */
+static USBD_HandleTypeDef *USB_Suspend_Dev;
+static const USB_Suspend_HooksTypeDef *USB_Suspend_Hooks;
+static USB_Suspend_StatsTypeDef USB_Suspend_Stats;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Suspend_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Whether the device may go to STOP mode now
+  * @retval 1 if the bus is suspended and no remote wakeup is under way
+  */
+static uint8_t USB_Suspend_Idle(void)
+{
+  if ((USB_Suspend_Dev == NULL) || (USB_Suspend_Dev->dev_state != USBD_STATE_SUSPENDED))
+  {
+    return 0U;
+  }
+#if !defined(USB_OTG_FS)
+  /* HAL_PCD_StartRemoteWakeup is timed with ESOF, which STOP would halt */
+  if (((PCD_HandleTypeDef *)USB_Suspend_Dev->pData)->RemoteWakeup != 0U)
+  {
+    return 0U;
+  }
+#endif
+  return 1U;
+}
+
+/**
+  * @brief  Wait for a ready flag of RCC
+  * @param  reg: register holding the flag
+  * @param  mask: flag bits
+  * @param  value: expected value of those bits
+  * @retval 1 if they got there in time, 0 otherwise
+  */
+static uint8_t USB_Suspend_WaitClock(__IO uint32_t *reg, uint32_t mask, uint32_t value)
+{
+  uint32_t n = USB_SUSPEND_CLOCK_TIMEOUT;
+
+  while ((*reg & mask) != value)
+  {
+    if (--n == 0U)
+    {
+      return 0U;
+    }
+  }
+  return 1U;
+}
+
+/**
+  * @brief  Bring back the oscillators and clock source STOP mode switched
+  *         off
+  * @note   Runs with interrupts masked and SysTick stopped, so nothing
+  *         here may wait on a tick. Prescalers and flash wait states are
+  *         kept through STOP and need no restore.
+  * @param  cr: RCC->CR before STOP
+  * @param  sw: RCC_CFGR_SW field before STOP
+  * @retval None
+  */
+static void USB_Suspend_RestoreClock(uint32_t cr, uint32_t sw)
+{
+  uint8_t ok = 1U;
+
+  if ((cr & RCC_CR_HSEON) != 0U)
+  {
+    RCC->CR |= RCC_CR_HSEON;
+    ok = USB_Suspend_WaitClock(&RCC->CR, RCC_CR_HSERDY, RCC_CR_HSERDY);
+  }
+  if (ok && ((cr & RCC_CR_PLLON) != 0U))
+  {
+    RCC->CR |= RCC_CR_PLLON;
+    ok = USB_Suspend_WaitClock(&RCC->CR, RCC_CR_PLLRDY, RCC_CR_PLLRDY);
+  }
+#if defined(RCC_CR_PLLI2SON)
+  if (ok && ((cr & RCC_CR_PLLI2SON) != 0U))
+  {
+    RCC->CR |= RCC_CR_PLLI2SON;
+    ok = USB_Suspend_WaitClock(&RCC->CR, RCC_CR_PLLI2SRDY, RCC_CR_PLLI2SRDY);
+  }
+#endif
+  if (ok)
+  {
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | sw;
+    ok = USB_Suspend_WaitClock(&RCC->CFGR, RCC_CFGR_SWS,
+                               sw << (RCC_CFGR_SWS_Pos - RCC_CFGR_SW_Pos));
+  }
+
+  if (!ok)
+  {
+    USB_Suspend_Stats.clock_errors++;
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Suspend_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Arm the USB wakeup EXTI line and take over the suspend policy
+  * @param  pdev: device instance
+  * @param  hooks: board specific gating, NULL for none
+  * @retval None
+  */
+void USB_Suspend_Init(USBD_HandleTypeDef *pdev, const USB_Suspend_HooksTypeDef *hooks)
+{
+  USB_Suspend_Dev = pdev;
+  USB_Suspend_Hooks = hooks;
+  USB_Suspend_Stats.sleeps = 0U;
+  USB_Suspend_Stats.aborts = 0U;
+  USB_Suspend_Stats.clock_errors = 0U;
+
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+
+#if defined(USB_OTG_FS)
+#if defined(USB_OTG_HS)
+  if (USBD_IS_HS_CAPABLE(pdev))
+  {
+    __HAL_USB_OTG_HS_WAKEUP_EXTI_CLEAR_FLAG();
+    __HAL_USB_OTG_HS_WAKEUP_EXTI_ENABLE_RISING_EDGE();
+    __HAL_USB_OTG_HS_WAKEUP_EXTI_ENABLE_IT();
+    NVIC_EnableIRQ(OTG_HS_WKUP_IRQn);
+    return;
+  }
+#endif /* USB_OTG_HS */
+  __HAL_USB_OTG_FS_WAKEUP_EXTI_CLEAR_FLAG();
+  __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_RISING_EDGE();
+  __HAL_USB_OTG_FS_WAKEUP_EXTI_ENABLE_IT();
+  NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+#else
+  __HAL_USB_WAKEUP_EXTI_CLEAR_FLAG();
+  __HAL_USB_WAKEUP_EXTI_ENABLE_RISING_EDGE();
+  __HAL_USB_WAKEUP_EXTI_ENABLE_IT();
+  NVIC_EnableIRQ(USBWakeUp_IRQn);
+#endif
+}
+
+/**
+  * @brief  Sleep in STOP mode as long as the bus is suspended
+  * @note   Call from the main loop. The wakeup is caught with interrupts
+  *         masked: WFI still returns on a pending interrupt, the clock is
+  *         rebuilt, and only then do the USB wakeup and the other pending
+  *         handlers run. A resume that comes in before WFI makes it return
+  *         at once.
+  * @retval 1 if it slept, 0 if the bus is not suspended
+  */
+uint8_t USB_Suspend_Process(void)
+{
+  uint32_t primask;
+  uint32_t cr;
+  uint32_t sw;
+  uint32_t systick;
+
+  if (!USB_Suspend_Idle())
+  {
+    return 0U;
+  }
+
+  if ((USB_Suspend_Hooks != NULL) && (USB_Suspend_Hooks->Enter != NULL))
+  {
+    USB_Suspend_Hooks->Enter();
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (!USB_Suspend_Idle())
+  {
+    /* resumed while the board was being gated */
+    USB_Suspend_Stats.aborts++;
+    if ((USB_Suspend_Hooks != NULL) && (USB_Suspend_Hooks->Exit != NULL))
+    {
+      USB_Suspend_Hooks->Exit();
+    }
+    __set_PRIMASK(primask);
+    return 0U;
+  }
+
+  cr = RCC->CR & USB_SUSPEND_CR_OSC;
+  sw = RCC->CFGR & RCC_CFGR_SW;
+
+  /* a pending tick would end STOP at once */
+  systick = SysTick->CTRL & SysTick_CTRL_TICKINT_Msk;
+  SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+#if (USB_TICK_ENABLED == 1)
+  /* or a deadline of the tickless timebase; served on resume */
+  HAL_SuspendTick();
+#endif
+
+#if (USB_SUSPEND_LP_REGULATOR == 1)
+  PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS;
+#else
+  PWR->CR &= ~(PWR_CR_PDDS | PWR_CR_LPDS);
+#endif
+  SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+  USB_Suspend_Stats.sleeps++;
+  __DSB();
+  __WFI();
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+  USB_Suspend_RestoreClock(cr, sw);
+  SysTick->CTRL |= systick;
+#if (USB_TICK_ENABLED == 1)
+  HAL_ResumeTick();
+#endif
+
+#if defined(USB_OTG_FS)
+  {
+    /* PHY clock gated by the PCD on suspend */
+    PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)USB_Suspend_Dev->pData;
+    __IO uint32_t *pcgcctl = (__IO uint32_t *)((uint32_t)hpcd->Instance + USB_OTG_PCGCCTL_BASE);
+
+    *pcgcctl &= ~USB_OTG_PCGCCTL_STOPCLK;
+  }
+#endif
+
+  if ((USB_Suspend_Hooks != NULL) && (USB_Suspend_Hooks->Exit != NULL))
+  {
+    USB_Suspend_Hooks->Exit();
+  }
+
+  __set_PRIMASK(primask);
+  return 1U;
+}
+
+/**
+  * @brief  Acknowledge the wakeup EXTI line, from its interrupt vector
+  * @note   The resume itself is handled by the PCD interrupt.
+  * @retval None
+  */
+void USB_Suspend_WakeupIRQHandler(void)
+{
+#if defined(USB_OTG_FS)
+#if defined(USB_OTG_HS)
+  if ((USB_Suspend_Dev != NULL) && USBD_IS_HS_CAPABLE(USB_Suspend_Dev))
+  {
+    __HAL_USB_OTG_HS_WAKEUP_EXTI_CLEAR_FLAG();
+    return;
+  }
+#endif /* USB_OTG_HS */
+  __HAL_USB_OTG_FS_WAKEUP_EXTI_CLEAR_FLAG();
+#else
+  __HAL_USB_WAKEUP_EXTI_CLEAR_FLAG();
+#endif
+}
+
+/**
+  * @brief  Suspend counters
+  * @retval counters, updated in place
+  */
+const USB_Suspend_StatsTypeDef *USB_Suspend_GetStats(void)
+{
+  return &USB_Suspend_Stats;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_SUSPEND_ENABLED */
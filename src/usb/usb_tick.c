@@ -0,0 +1,404 @@
+/**
+  ******************************************************************************
+  * @file    usb_tick.c
+  * @brief   Tickless HAL timebase, see usb_tick.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_tick.h"
+
+#if (USB_TICK_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Tick
+  * @{
+  */
+
+/** @defgroup USB_Tick_Private_Defines
+  * @{
+  */
+/* Longest prescaler of the timer */
+#define USB_TICK_PSC_MAX                            65536U
+/**
+  * @}
+  */
+
+/** @defgroup USB_Tick_Private_Types
+  * @{
+  */
+typedef struct
+{
+  uint32_t                 deadline;    /* tick it expires at */
+  USB_Tick_CallbackTypeDef callback;    /* NULL when stopped */
+} USB_Tick_TimerTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Tick_Private_Variables
+  * @{
+  */
+static USB_Tick_TimerTypeDef USB_Tick_Timers[USB_TICK_TIMERS];
+static uint32_t USB_Tick_Base;          /* tick at counter 0 */
+static uint32_t USB_Tick_Span;          /* ticks of a full counter period */
+static uint8_t  USB_Tick_Shift;         /* counts a tick, log2 */
+static uint32_t USB_Tick_Wakeups;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Tick_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Counter value of a tick
+  * @param  tick: tick
+  * @retval counter value, modulo the counter period
+  */
+static uint32_t USB_Tick_Raw(uint32_t tick)
+{
+  return (tick - USB_Tick_Base) << USB_Tick_Shift;
+}
+
+/**
+  * @brief  Program the timer compare for the earliest running timer
+  * @note   Interrupts masked.
+  * @retval None
+  */
+static void USB_Tick_Program(void)
+{
+  uint32_t now = HAL_GetTick();
+  uint32_t i;
+  int32_t left;
+  int32_t first = 0;
+  uint32_t deadline = 0U;
+  uint8_t any = 0U;
+
+  for (i = 0U; i < USB_TICK_TIMERS; i++)
+  {
+    if (USB_Tick_Timers[i].callback == NULL)
+    {
+      continue;
+    }
+    left = (int32_t)(USB_Tick_Timers[i].deadline - now);
+    if ((any == 0U) || (left < first))
+    {
+      first = left;
+      deadline = USB_Tick_Timers[i].deadline;
+      any = 1U;
+    }
+  }
+
+  if (any == 0U)
+  {
+    USB_TICK_TIM->DIER &= ~TIM_DIER_CC1IE;
+    return;
+  }
+
+  USB_TICK_TIM->CCR1 = USB_Tick_Raw(deadline);
+  USB_TICK_TIM->SR = ~TIM_SR_CC1IF;
+  USB_TICK_TIM->DIER |= TIM_DIER_CC1IE;
+
+  /* the counter may have gone past the compare value already */
+  if ((int32_t)(deadline - HAL_GetTick()) <= 0)
+  {
+    USB_TICK_TIM->EGR = TIM_EGR_CC1G;
+  }
+}
+
+/**
+  * @brief  Run the expired timers, then program the next deadline
+  * @retval None
+  */
+static void USB_Tick_Expire(void)
+{
+  USB_Tick_CallbackTypeDef callback;
+  uint32_t primask;
+  uint32_t now = HAL_GetTick();
+  uint8_t i;
+
+  for (i = 0U; i < USB_TICK_TIMERS; i++)
+  {
+    callback = USB_Tick_Timers[i].callback;
+    if ((callback != NULL) && ((int32_t)(now - USB_Tick_Timers[i].deadline) >= 0))
+    {
+      USB_Tick_Timers[i].callback = NULL;
+      callback(i);
+    }
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  USB_Tick_Program();
+  __set_PRIMASK(primask);
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_Tick_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up the timer as the HAL timebase, in place of SysTick
+  * @note   Called by HAL_Init and by HAL_RCC_ClockConfig on every clock
+  *         change: the tick count goes on from where it was.
+  * @param  TickPriority: priority of the timer interrupt
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+  uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+  uint32_t clock = SystemCoreClock;
+  uint32_t primask;
+  uint32_t now;
+  uint8_t shift = 0U;
+
+  /* timers on APB1 run at twice PCLK1 when it is divided, HCLK / 2 ^ n */
+  if ((ppre & 0x4U) != 0U)
+  {
+    clock >>= (ppre & 0x3U);
+  }
+  while ((clock / (1000U << shift)) > USB_TICK_PSC_MAX)
+  {
+    shift++;
+  }
+  if ((clock / (1000U << shift)) == 0U)
+  {
+    return HAL_ERROR;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  SysTick->CTRL = 0U;
+
+  if ((RCC->APB1ENR & USB_TICK_TIM_EN) == 0U)
+  {
+    RCC->APB1ENR |= USB_TICK_TIM_EN;
+    (void)RCC->APB1ENR;
+    now = 0U;
+  }
+  else
+  {
+    now = HAL_GetTick();
+  }
+
+  USB_TICK_TIM->CR1 = TIM_CR1_URS;
+  USB_TICK_TIM->DIER = 0U;
+  USB_TICK_TIM->PSC = (clock / (1000U << shift)) - 1U;
+  USB_TICK_TIM->ARR = 0xFFFFFFFFU;
+  /* load the prescaler now, without an update interrupt */
+  USB_TICK_TIM->EGR = TIM_EGR_UG;
+  USB_TICK_TIM->CNT = 0U;
+  USB_TICK_TIM->SR = 0U;
+
+  USB_Tick_Base = now;
+  USB_Tick_Shift = shift;
+  USB_Tick_Span = 0xFFFFFFFFU >> shift;
+  USB_Tick_Span++;
+
+  USB_TICK_TIM->DIER = TIM_DIER_UIE;
+  USB_TICK_TIM->CR1 = TIM_CR1_URS | TIM_CR1_CEN;
+  USB_Tick_Program();
+
+  __set_PRIMASK(primask);
+
+  if (TickPriority < (1UL << __NVIC_PRIO_BITS))
+  {
+    NVIC_SetPriority(USB_TICK_IRQn, TickPriority);
+    uwTickPrio = TickPriority;
+  }
+  NVIC_EnableIRQ(USB_TICK_IRQn);
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Milliseconds since HAL_Init, from the counter
+  * @retval tick
+  */
+uint32_t HAL_GetTick(void)
+{
+  uint32_t primask;
+  uint32_t base;
+  uint32_t cnt;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  base = USB_Tick_Base;
+  cnt = USB_TICK_TIM->CNT;
+  if ((USB_TICK_TIM->SR & TIM_SR_UIF) != 0U)
+  {
+    /* wrapped, and the interrupt has not run yet */
+    cnt = USB_TICK_TIM->CNT;
+    base += USB_Tick_Span;
+  }
+  __set_PRIMASK(primask);
+
+  return base + (cnt >> USB_Tick_Shift);
+}
+
+/**
+  * @brief  Wait at least Delay ms, asleep in thread mode
+  * @param  Delay: ms, HAL_MAX_DELAY for ever
+  * @retval None
+  */
+void HAL_Delay(uint32_t Delay)
+{
+  uint32_t start = HAL_GetTick();
+  uint32_t wait = Delay;
+  uint32_t primask = __get_PRIMASK();
+  uint8_t sleep = (__get_IPSR() == 0U) ? 1U : 0U;
+
+  if (wait < HAL_MAX_DELAY)
+  {
+    /* the first tick may be almost over */
+    wait += 1U;
+  }
+  if ((sleep != 0U) && (wait != HAL_MAX_DELAY))
+  {
+    USB_TICK_TIM->CCR2 = USB_Tick_Raw(start + wait);
+    USB_TICK_TIM->SR = ~TIM_SR_CC2IF;
+    USB_TICK_TIM->DIER |= TIM_DIER_CC2IE;
+  }
+
+  for (;;)
+  {
+    __disable_irq();
+    if ((HAL_GetTick() - start) >= wait)
+    {
+      __set_PRIMASK(primask);
+      break;
+    }
+    if (sleep != 0U)
+    {
+      /* returns on a pending interrupt even masked, the compare included */
+      __WFI();
+    }
+    __set_PRIMASK(primask);
+  }
+
+  USB_TICK_TIM->DIER &= ~TIM_DIER_CC2IE;
+}
+
+/**
+  * @brief  Keep the timer from interrupting, e.g. around a sleep of the
+  *         application; the tick count goes on
+  * @retval None
+  */
+void HAL_SuspendTick(void)
+{
+  NVIC_DisableIRQ(USB_TICK_IRQn);
+}
+
+/**
+  * @brief  Let the timer interrupt again
+  * @retval None
+  */
+void HAL_ResumeTick(void)
+{
+  NVIC_EnableIRQ(USB_TICK_IRQn);
+}
+
+/**
+  * @brief  Start or restart a one-shot timer
+  * @param  id: timer, below USB_TICK_TIMERS
+  * @param  delay: ms from now, below 2^31
+  * @param  callback: run from the timer interrupt when it expires
+  * @retval None
+  */
+void USB_Tick_Start(uint8_t id, uint32_t delay, USB_Tick_CallbackTypeDef callback)
+{
+  uint32_t primask;
+
+  if (id >= USB_TICK_TIMERS)
+  {
+    return;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  USB_Tick_Timers[id].deadline = HAL_GetTick() + delay;
+  USB_Tick_Timers[id].callback = callback;
+  USB_Tick_Program();
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Stop a timer, its callback is not run
+  * @param  id: timer
+  * @retval None
+  */
+void USB_Tick_Stop(uint8_t id)
+{
+  uint32_t primask;
+
+  if (id >= USB_TICK_TIMERS)
+  {
+    return;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  USB_Tick_Timers[id].callback = NULL;
+  USB_Tick_Program();
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Timer interrupt: counter wrap, timer deadline, end of HAL_Delay
+  * @retval None
+  */
+void USB_Tick_IRQHandler(void)
+{
+  uint32_t sr;
+
+  USB_Tick_Wakeups++;
+
+  __disable_irq();
+  sr = USB_TICK_TIM->SR & USB_TICK_TIM->DIER;
+  USB_TICK_TIM->SR = ~sr;
+  if ((sr & TIM_SR_UIF) != 0U)
+  {
+    /* with the flag, in one go for HAL_GetTick */
+    USB_Tick_Base += USB_Tick_Span;
+  }
+  __enable_irq();
+
+  if ((sr & TIM_SR_CC1IF) != 0U)
+  {
+    USB_Tick_Expire();
+  }
+  /* CC2 only had to wake HAL_Delay up */
+}
+
+/**
+  * @brief  Interrupts the timer has taken, to check how often an idle
+  *         device wakes up
+  * @retval count
+  */
+uint32_t USB_Tick_GetWakeups(void)
+{
+  return USB_Tick_Wakeups;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_TICK_ENABLED */
@@ -0,0 +1,261 @@
+/**
+  ******************************************************************************
+  * @file    usb_timesync.c
+  * @brief   Device time on the host frame clock, see usb_timesync.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_timesync.h"
+
+#if (USB_TIMESYNC_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_TimeSync
+  * @{
+  */
+
+/** @defgroup USB_TimeSync_Private_Defines
+  * @{
+  */
+/* Loop gains, as shifts of the phase error: critically damped */
+#define USB_TIMESYNC_KP_SHIFT                       3U
+#define USB_TIMESYNC_KI_SHIFT                       8U
+
+/* A gap of more SOFs than this is a resume, not lost SOFs */
+#define USB_TIMESYNC_MAX_GAP                        16U
+
+/* Frame length accepted from the acquisition, against the nominal: the
+   crystal tolerance of both ends with room to spare */
+#define USB_TIMESYNC_ACQ_TOLERANCE_SHIFT            7U   /* 1/128, 0.8 % */
+/**
+  * @}
+  */
+
+/** @defgroup USB_TimeSync_Exported_Variables
+  * @{
+  */
+USB_TimeSyncTypeDef USB_TimeSync;
+/**
+  * @}
+  */
+
+/** @defgroup USB_TimeSync_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Start measuring the frame length from this SOF
+  * @param  ts: service state
+  * @param  cycles: CYCCNT at the SOF
+  * @retval None
+  */
+static void USB_TimeSync_Acquire(USB_TimeSyncTypeDef *ts, uint32_t cycles)
+{
+  ts->state = USB_TIMESYNC_ACQ;
+  ts->acq = 0U;
+  ts->acq_cycles = cycles;
+  ts->cycles = cycles;
+  ts->frac = 0U;
+  ts->late = 0U;
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_TimeSync_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Start the DWT cycle counter and reset the loop
+  * @note   Call after the system clock is set: the nominal frame length
+  *         comes from SystemCoreClock.
+  * @retval None
+  */
+void USB_TimeSync_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  USB_TimeSync.frame = 0U;
+  USB_TimeSync.bus_frame = 0U;
+  USB_TimeSync.nominal = (SystemCoreClock / 1000U) << USB_TIMESYNC_PERIOD_SHIFT;
+  USB_TimeSync.period = USB_TimeSync.nominal;
+  USB_TimeSync.sofs = 0U;
+  USB_TimeSync.skipped = 0U;
+  USB_TimeSync.relocks = 0U;
+  USB_TimeSync_Reset();
+}
+
+/**
+  * @brief  Drop the lock, from bus reset and suspend: the next SOF starts
+  *         over. The frame length measured so far is kept for the stamps.
+  * @retval None
+  */
+void USB_TimeSync_Reset(void)
+{
+  if (USB_TimeSync.state == USB_TIMESYNC_LOCKED)
+  {
+    USB_TimeSync.relocks++;
+  }
+  USB_TimeSync.state = USB_TIMESYNC_IDLE;
+}
+
+/**
+  * @brief  Run the loop on one SOF, from the PCD interrupt
+  * @param  bus_frame: frame number of the SOF
+  * @param  cycles: CYCCNT on entry to the interrupt
+  * @retval None
+  */
+void USB_TimeSync_SOF(uint16_t bus_frame, uint32_t cycles)
+{
+  USB_TimeSyncTypeDef *ts = &USB_TimeSync;
+  uint32_t df;
+  uint32_t pred;
+  uint32_t limit;
+  uint64_t adv;
+  int32_t err;
+
+  bus_frame &= 0x7FFU;
+  df = (uint32_t)(bus_frame - ts->bus_frame) & 0x7FFU;
+  ts->bus_frame = bus_frame;
+  ts->frame += df;
+  ts->sofs++;
+
+  if ((ts->state == USB_TIMESYNC_IDLE) || (df == 0U) || (df > USB_TIMESYNC_MAX_GAP))
+  {
+    if (ts->state == USB_TIMESYNC_LOCKED)
+    {
+      ts->relocks++;
+    }
+    USB_TimeSync_Acquire(ts, cycles);
+    return;
+  }
+
+  if (ts->state == USB_TIMESYNC_ACQ)
+  {
+    uint32_t period;
+
+    ts->cycles = cycles;
+    ts->acq += df;
+    if (ts->acq < USB_TIMESYNC_ACQ_FRAMES)
+    {
+      return;
+    }
+
+    period = (uint32_t)(((uint64_t)(cycles - ts->acq_cycles) << USB_TIMESYNC_PERIOD_SHIFT) / ts->acq);
+    if ((period > ts->nominal + (ts->nominal >> USB_TIMESYNC_ACQ_TOLERANCE_SHIFT)) ||
+        (period < ts->nominal - (ts->nominal >> USB_TIMESYNC_ACQ_TOLERANCE_SHIFT)))
+    {
+      /* an interrupt held off during the window: measure again */
+      USB_TimeSync_Acquire(ts, cycles);
+      return;
+    }
+    ts->period = period;
+    ts->state = USB_TIMESYNC_LOCKED;
+    return;
+  }
+
+  /* locked: where the loop puts this SOF, and how far off it came in */
+  adv = (uint64_t)ts->period * df + ts->frac;
+  pred = ts->cycles + (uint32_t)(adv >> USB_TIMESYNC_PERIOD_SHIFT);
+  ts->frac = (uint16_t)(adv & ((1U << USB_TIMESYNC_PERIOD_SHIFT) - 1U));
+  err = (int32_t)(cycles - pred);
+
+  limit = (uint32_t)(((uint64_t)ts->nominal * USB_TIMESYNC_MAX_ERR_US) >> USB_TIMESYNC_PERIOD_SHIFT) / 1000U;
+  if ((err > (int32_t)limit) || (err < -(int32_t)limit))
+  {
+    /* late interrupt: coast on the prediction */
+    ts->cycles = pred;
+    ts->skipped++;
+    if (++ts->late >= USB_TIMESYNC_MAX_LATE)
+    {
+      ts->relocks++;
+      USB_TimeSync_Acquire(ts, cycles);
+    }
+    return;
+  }
+
+  ts->late = 0U;
+  /* rounded: a truncated correction would bias the frame length */
+  ts->cycles = pred + (uint32_t)((err + (1 << (USB_TIMESYNC_KP_SHIFT - 1U))) >> USB_TIMESYNC_KP_SHIFT);
+  ts->period = (uint32_t)((int32_t)ts->period +
+                          ((err * (int32_t)(1U << USB_TIMESYNC_PERIOD_SHIFT)) >> USB_TIMESYNC_KI_SHIFT));
+}
+
+/**
+  * @brief  Stamp of a moment
+  * @note   Any context. Moments before the last SOF work too, so a cycle
+  *         count taken when a sample was acquired can be stamped later.
+  * @param  cycles: CYCCNT at the moment
+  * @retval stamp, see usb_timesync.h
+  */
+uint32_t USB_TimeSync_Stamp(uint32_t cycles)
+{
+  uint32_t primask;
+  uint32_t frame;
+  uint32_t anchor;
+  uint32_t period;
+  uint32_t valid;
+  int64_t usec;
+  int32_t frames;
+  int32_t rem;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  frame = USB_TimeSync.frame;
+  anchor = USB_TimeSync.cycles;
+  period = USB_TimeSync.period;
+  valid = (USB_TimeSync.state == USB_TIMESYNC_LOCKED) ? USB_TIMESYNC_STAMP_VALID : 0U;
+  __set_PRIMASK(primask);
+
+  if (period == 0U)
+  {
+    return 0U;
+  }
+
+  usec = ((int64_t)(int32_t)(cycles - anchor) * (1000 << USB_TIMESYNC_PERIOD_SHIFT)) / (int64_t)period;
+  frames = (int32_t)(usec / 1000);
+  rem = (int32_t)(usec % 1000);
+  if (rem < 0)
+  {
+    rem += 1000;
+    frames--;
+  }
+
+  return valid | (((frame + (uint32_t)frames) & 0x1FFFFFU) << 10) | (uint32_t)rem;
+}
+
+/**
+  * @brief  Drift of the core clock against the host frame clock
+  * @retval parts per billion, positive when the core clock runs fast
+  */
+int32_t USB_TimeSync_GetDrift(void)
+{
+  uint32_t period = USB_TimeSync.period;
+  uint32_t nominal = USB_TimeSync.nominal;
+
+  if (nominal == 0U)
+  {
+    return 0;
+  }
+  return (int32_t)((((int64_t)period - (int64_t)nominal) * 1000000000) / (int64_t)nominal);
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_TIMESYNC_ENABLED */
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    usb_trace.c
+  * @brief   Binary trace of the USB device events over ITM/SWO, see
+  *          usb_trace.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usb_trace.h"
+
+#if (USB_TRACE_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_Trace
+  * @{
+  */
+
+/** @defgroup USB_Trace_Private_Defines
+  * @{
+  */
+#define USB_TRACE_ITM_UNLOCK                        0xC5ACCE55U
+
+/* TPIU pin protocol: asynchronous SWO, NRZ encoding */
+#define USB_TRACE_TPI_NRZ                           2U
+/**
+  * @}
+  */
+
+/** @defgroup USB_Trace_Exported_Variables
+  * @{
+  */
+volatile uint32_t USB_Trace_Drops;
+/**
+  * @}
+  */
+
+/** @defgroup USB_Trace_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Enable the trace port and its timestamps
+  * @note   Bits the debugger already set in the ITM are kept. The TPIU is
+  *         only touched when swo_prescaler is not 0, for a probe that
+  *         leaves the SWO pin setup to the target.
+  * @param  swo_prescaler: SWO bit rate divider, the bit rate is the trace
+  *         clock divided by it. 0 keeps the debugger settings.
+  * @retval None
+  */
+void USB_Trace_Init(uint32_t swo_prescaler)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+
+  if (swo_prescaler != 0U)
+  {
+#if defined(DBGMCU_CR_TRACE_IOEN)
+    DBGMCU->CR |= DBGMCU_CR_TRACE_IOEN;
+#endif
+    TPI->SPPR = USB_TRACE_TPI_NRZ;
+    TPI->ACPR = swo_prescaler - 1U;
+    /* no formatter: the capture is the bare ITM packet stream */
+    TPI->FFCR &= ~TPI_FFCR_EnFCont_Msk;
+  }
+
+  ITM->LAR = USB_TRACE_ITM_UNLOCK;
+  ITM->TCR |= ITM_TCR_ITMENA_Msk | ITM_TCR_TSENA_Msk | ITM_TCR_SYNCENA_Msk |
+              (1UL << ITM_TCR_TraceBusID_Pos);
+  ITM->TER |= 1UL << USB_TRACE_PORT;
+
+  USB_Trace_Drops = 0U;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_TRACE_ENABLED */
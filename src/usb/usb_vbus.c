@@ -0,0 +1,235 @@
+/**
+  ******************************************************************************
+  * @file    usb_vbus.c
+  * @brief   VBUS sensing on a GPIO, see usb_vbus.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_conf.h"
+#include "usbd_core.h"
+#include "usb_vbus.h"
+
+#if (USB_VBUS_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USB_VBUS
+  * @{
+  */
+
+/** @defgroup USB_VBUS_Private_Defines
+  * @{
+  */
+/* Ports are 0x400 apart on the F3 and the F4 */
+#define USB_VBUS_PORT_INDEX(port)                   (((uint32_t)(port) - (uint32_t)GPIOA) / 0x400U)
+/**
+  * @}
+  */
+
+/** @defgroup USB_VBUS_Private_Variables
+  * @{
+  */
+static USBD_HandleTypeDef *USB_VBUS_Dev;
+static const USB_VBUS_ConfigTypeDef *USB_VBUS_Cfg;
+static USB_VBUS_StatsTypeDef USB_VBUS_Stats;
+static __IO uint8_t  USB_VBUS_Connected;   /* pull-up on */
+#if (USB_VBUS_DEBOUNCE_MS > 0)
+static __IO uint8_t  USB_VBUS_Pending;     /* VBUS came back, pull-up not on yet */
+static __IO uint32_t USB_VBUS_Since;       /* tick of the rising edge */
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USB_VBUS_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Level of the VBUS pin
+  * @retval 1 if VBUS is there
+  */
+static uint8_t USB_VBUS_Level(void)
+{
+  return ((USB_VBUS_Cfg->Port->IDR & (1UL << USB_VBUS_Cfg->Pin)) != 0U) ? 1U : 0U;
+}
+
+/**
+  * @brief  Pull-up off and the core told, so the class drops its queues
+  * @retval None
+  */
+static void USB_VBUS_Detach(void)
+{
+  USB_VBUS_Connected = 0U;
+  HAL_PCD_DevDisconnect((PCD_HandleTypeDef *)USB_VBUS_Dev->pData);
+  USBD_LL_DevDisconnected(USB_VBUS_Dev);
+  USB_VBUS_Stats.detaches++;
+
+  if (USB_VBUS_Cfg->Detach != NULL)
+  {
+    USB_VBUS_Cfg->Detach();
+  }
+}
+
+/**
+  * @brief  Pull-up on: the host takes it from there
+  * @retval None
+  */
+static void USB_VBUS_Attach(void)
+{
+  USB_VBUS_Connected = 1U;
+  HAL_PCD_DevConnect((PCD_HandleTypeDef *)USB_VBUS_Dev->pData);
+  USB_VBUS_Stats.attaches++;
+
+  if (USB_VBUS_Cfg->Attach != NULL)
+  {
+    USB_VBUS_Cfg->Attach();
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup USB_VBUS_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Route the pin to its EXTI line on both edges and apply the
+  *         current level
+  * @param  pdev: device instance, started
+  * @param  cfg: pin and hooks, must stay valid
+  * @retval None
+  */
+void USB_VBUS_Init(USBD_HandleTypeDef *pdev, const USB_VBUS_ConfigTypeDef *cfg)
+{
+  uint32_t line = 1UL << cfg->Pin;
+  uint32_t shift = 4U * (cfg->Pin & 0x3U);
+
+  USB_VBUS_Dev = pdev;
+  USB_VBUS_Cfg = cfg;
+  USB_VBUS_Stats.detaches = 0U;
+  USB_VBUS_Stats.attaches = 0U;
+  USB_VBUS_Stats.bounces = 0U;
+  /* USBD_Start connected the pull-up */
+  USB_VBUS_Connected = 1U;
+
+  RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+  (void)RCC->APB2ENR;
+  SYSCFG->EXTICR[cfg->Pin >> 2] = (SYSCFG->EXTICR[cfg->Pin >> 2] & ~(0xFUL << shift)) |
+                                  (USB_VBUS_PORT_INDEX(cfg->Port) << shift);
+  EXTI->RTSR |= line;
+  EXTI->FTSR |= line;
+  EXTI->PR = line;
+  EXTI->IMR |= line;
+
+  if (USB_VBUS_Level() == 0U)
+  {
+    /* not plugged in: no pull-up, no class */
+    USB_VBUS_Connected = 0U;
+    HAL_PCD_DevDisconnect((PCD_HandleTypeDef *)pdev->pData);
+  }
+
+  NVIC_EnableIRQ(cfg->IRQn);
+}
+
+/**
+  * @brief  EXTI interrupt of the VBUS pin
+  * @retval None
+  */
+void USB_VBUS_IRQHandler(void)
+{
+  uint32_t line = 1UL << USB_VBUS_Cfg->Pin;
+
+  if ((EXTI->PR & line) == 0U)
+  {
+    return;
+  }
+  EXTI->PR = line;
+
+  /* the level after the clear, whatever edges came in between */
+  if (USB_VBUS_Level() == 0U)
+  {
+#if (USB_VBUS_DEBOUNCE_MS > 0)
+    if (USB_VBUS_Pending != 0U)
+    {
+      USB_VBUS_Pending = 0U;
+      USB_VBUS_Stats.bounces++;
+    }
+#endif
+    if (USB_VBUS_Connected != 0U)
+    {
+      USB_VBUS_Detach();
+    }
+  }
+  else if (USB_VBUS_Connected == 0U)
+  {
+#if (USB_VBUS_DEBOUNCE_MS > 0)
+    USB_VBUS_Since = HAL_GetTick();
+    USB_VBUS_Pending = 1U;
+#else
+    USB_VBUS_Attach();
+#endif
+  }
+}
+
+/**
+  * @brief  Switch the pull-up on once VBUS has been stable for the
+  *         debounce time. Call from the main loop.
+  * @retval None
+  */
+void USB_VBUS_Process(void)
+{
+#if (USB_VBUS_DEBOUNCE_MS > 0)
+  uint32_t primask;
+
+  if ((USB_VBUS_Pending == 0U) || ((HAL_GetTick() - USB_VBUS_Since) < USB_VBUS_DEBOUNCE_MS))
+  {
+    return;
+  }
+
+  /* against a falling edge while deciding */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if ((USB_VBUS_Pending != 0U) && (USB_VBUS_Level() != 0U))
+  {
+    USB_VBUS_Pending = 0U;
+    USB_VBUS_Attach();
+  }
+  __set_PRIMASK(primask);
+#endif
+}
+
+/**
+  * @brief  Whether VBUS is there now
+  * @retval 1 if present
+  */
+uint8_t USB_VBUS_IsPresent(void)
+{
+  return USB_VBUS_Level();
+}
+
+/**
+  * @brief  Detach and attach counts
+  * @retval statistics
+  */
+const USB_VBUS_StatsTypeDef *USB_VBUS_GetStats(void)
+{
+  return &USB_VBUS_Stats;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USB_VBUS_ENABLED */
@@ -0,0 +1,700 @@
+/**
+  ******************************************************************************
+  * @file    usbd_audio.c
+  * @brief   USB Audio Class 1.0 asynchronous input stream, see usbd_audio.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio.h"
+#include "usbd_ctlreq.h"
+
+#if (USBD_AUDIO_ENABLED == 1)
+
+#if (USBD_AUDIO_PMA_ALLOC == 1)
+#include "usbd_cdc_pma.h"
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_audio
+  * @{
+  */
+
+/** @defgroup usbd_audio_Private_Defines
+  * @{
+  */
+/* Self powered, like the CDC configuration */
+#define USBD_AUDIO_CFG_ATTRIBUTES                   0xC0
+
+/* Terminal IDs of the control interface */
+#define USBD_AUDIO_INPUT_TERMINAL_ID                0x01
+#define USBD_AUDIO_OUTPUT_TERMINAL_ID               0x02
+#define USBD_AUDIO_AC_TOTAL_SIZ                     (9 + 12 + 9)
+
+#define USBD_AUDIO_CS_INTERFACE                     0x24
+#define USBD_AUDIO_CS_ENDPOINT                      0x25
+
+/* FIFO level the servo holds, and how far it may stray before a packet
+   gains or loses a sample */
+#define USBD_AUDIO_FIFO_TARGET                      (USBD_AUDIO_FIFO_FRAMES / 2U)
+#define USBD_AUDIO_FIFO_SLACK                       (USBD_AUDIO_NOMINAL_FRAMES)
+
+/* Rate at the nominal sample rate, samples per frame in Q10.14 */
+#define USBD_AUDIO_RATE_NOMINAL                     ((uint32_t)(((uint64_t)USBD_AUDIO_FREQ << 14) / 1000U))
+
+#if (USBD_AUDIO_PMA_ALLOC == 1)
+/* Packet memory of the endpoint, both buffers of it: after the CDC buffers
+   when they share a composite, right after EP0 otherwise */
+#ifndef USBD_AUDIO_PMA_ADDR
+#if (USBD_COMPOSITE_ENABLED == 1)
+#define USBD_AUDIO_PMA_ADDR                         (USBD_CDC_PMA_END)
+#else
+#define USBD_AUDIO_PMA_ADDR                         (USBD_CDC_PMA_BASE)
+#endif
+#endif
+
+#define USBD_AUDIO_PMA_BUF_SIZE                     ((USBD_AUDIO_MAX_PACKET + 1U) & ~1U)
+#define USBD_AUDIO_PMA_END                          (USBD_AUDIO_PMA_ADDR + 2U * USBD_AUDIO_PMA_BUF_SIZE)
+
+#if (USBD_AUDIO_PMA_END > USBD_PMA_SIZE)
+#error "Audio endpoint buffers do not fit in packet memory"
+#endif
+#if ((USBD_AUDIO_IN_EP & 0x0F) >= USBD_PMA_NUM_EP)
+#error "Audio endpoint beyond the buffer descriptor table, raise USBD_PMA_NUM_EP"
+#endif
+#endif /* USBD_AUDIO_PMA_ALLOC */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t  USBD_AUDIO_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_AUDIO_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_AUDIO_SOF (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_AUDIO_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  *USBD_AUDIO_GetFSCfgDesc (uint16_t *length);
+#if (USBD_FS_ONLY == 0)
+static uint8_t  *USBD_AUDIO_GetHSCfgDesc (uint16_t *length);
+static uint8_t  *USBD_AUDIO_GetOtherSpeedCfgDesc (uint16_t *length);
+static uint8_t  *USBD_AUDIO_GetDeviceQualifierDesc (uint16_t *length);
+#endif /* USBD_FS_ONLY */
+static USBD_AUDIO_HandleTypeDef *USBD_AUDIO_Get (USBD_HandleTypeDef *pdev);
+static void     USBD_AUDIO_Stream (USBD_HandleTypeDef *pdev, uint8_t alt);
+static void     USBD_AUDIO_SendPacket (USBD_HandleTypeDef *pdev,
+                                       USBD_AUDIO_HandleTypeDef *haudio);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Private_Variables
+  * @{
+  */
+USBD_ClassTypeDef  USBD_AUDIO =
+{
+  USBD_AUDIO_Init,
+  USBD_AUDIO_DeInit,
+  USBD_AUDIO_Setup,
+  NULL,                 /* EP0_TxSent */
+  NULL,                 /* EP0_RxReady */
+  USBD_AUDIO_DataIn,
+  NULL,                 /* DataOut */
+  USBD_AUDIO_SOF,
+  USBD_AUDIO_IsoINIncomplete,
+  NULL,
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_AUDIO_GetFSCfgDesc,
+  NULL,
+  NULL,
+#else
+  USBD_AUDIO_GetHSCfgDesc,
+  USBD_AUDIO_GetFSCfgDesc,
+  USBD_AUDIO_GetOtherSpeedCfgDesc,
+  USBD_AUDIO_GetDeviceQualifierDesc,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  NULL,                 /* LPM */
+#endif
+};
+
+/* Whole configuration. bInterval counts frames at full speed and
+   2^(n-1) microframes at high speed: 1 ms either way. */
+#define USBD_AUDIO_CFG_DESC(type, interval)                                   \
+  0x09,                               /* bLength */                          \
+  (type),                             /* bDescriptorType */                  \
+  LOBYTE(USBD_AUDIO_CFG_DESC_SIZ),    /* wTotalLength */                     \
+  HIBYTE(USBD_AUDIO_CFG_DESC_SIZ),                                           \
+  0x02,                               /* bNumInterfaces */                   \
+  0x01,                               /* bConfigurationValue */              \
+  0x00,                               /* iConfiguration */                   \
+  USBD_AUDIO_CFG_ATTRIBUTES,          /* bmAttributes */                     \
+  0x32,                               /* MaxPower 100 mA */                  \
+  /* IAD */                                                                  \
+  0x08, 0x0B, USBD_AUDIO_AC_ITF_NUM, 0x02, 0x01, 0x01, 0x00, 0x00,           \
+  /* Audio control interface */                                              \
+  0x09,                               /* bLength */                          \
+  USB_DESC_TYPE_INTERFACE,            /* bDescriptorType */                  \
+  USBD_AUDIO_AC_ITF_NUM,              /* bInterfaceNumber */                 \
+  0x00,                               /* bAlternateSetting */                \
+  0x00,                               /* bNumEndpoints */                    \
+  0x01,                               /* bInterfaceClass: audio */           \
+  0x01,                               /* bInterfaceSubClass: control */      \
+  0x00,                               /* bInterfaceProtocol */               \
+  0x00,                               /* iInterface */                       \
+  /* Class specific header, UAC 1.00 */                                      \
+  0x09, USBD_AUDIO_CS_INTERFACE, 0x01, 0x00, 0x01,                           \
+  LOBYTE(USBD_AUDIO_AC_TOTAL_SIZ), HIBYTE(USBD_AUDIO_AC_TOTAL_SIZ),          \
+  0x01,                               /* bInCollection */                    \
+  USBD_AUDIO_AS_ITF_NUM,              /* baInterfaceNr */                    \
+  /* Input terminal: undefined input, the sensor */                          \
+  0x0C, USBD_AUDIO_CS_INTERFACE, 0x02, USBD_AUDIO_INPUT_TERMINAL_ID,         \
+  0x00, 0x02,                         /* wTerminalType */                    \
+  0x00,                               /* bAssocTerminal */                   \
+  USBD_AUDIO_CHANNELS,                /* bNrChannels */                      \
+  0x00, 0x00,                         /* wChannelConfig */                   \
+  0x00,                               /* iChannelNames */                    \
+  0x00,                               /* iTerminal */                        \
+  /* Output terminal: USB streaming */                                       \
+  0x09, USBD_AUDIO_CS_INTERFACE, 0x03, USBD_AUDIO_OUTPUT_TERMINAL_ID,        \
+  0x01, 0x01,                         /* wTerminalType */                    \
+  0x00,                               /* bAssocTerminal */                   \
+  USBD_AUDIO_INPUT_TERMINAL_ID,       /* bSourceID */                        \
+  0x00,                               /* iTerminal */                        \
+  /* Streaming interface, alternate 0: no bandwidth */                       \
+  0x09, USB_DESC_TYPE_INTERFACE, USBD_AUDIO_AS_ITF_NUM,                      \
+  0x00, 0x00, 0x01, 0x02, 0x00, 0x00,                                        \
+  /* Streaming interface, alternate 1: streaming */                          \
+  0x09, USB_DESC_TYPE_INTERFACE, USBD_AUDIO_AS_ITF_NUM,                      \
+  0x01, 0x01, 0x01, 0x02, 0x00, 0x00,                                        \
+  /* General: fed by the output terminal, PCM */                             \
+  0x07, USBD_AUDIO_CS_INTERFACE, 0x01, USBD_AUDIO_OUTPUT_TERMINAL_ID,        \
+  0x01,                               /* bDelay */                           \
+  0x01, 0x00,                         /* wFormatTag */                       \
+  /* Type I format, 16 bit, one sample rate */                               \
+  0x0B, USBD_AUDIO_CS_INTERFACE, 0x02, 0x01,                                 \
+  USBD_AUDIO_CHANNELS,                /* bNrChannels */                      \
+  0x02,                               /* bSubFrameSize */                    \
+  0x10,                               /* bBitResolution */                   \
+  0x01,                               /* bSamFreqType */                     \
+  (uint8_t)(USBD_AUDIO_FREQ),                                                \
+  (uint8_t)(USBD_AUDIO_FREQ >> 8),                                           \
+  (uint8_t)(USBD_AUDIO_FREQ >> 16),                                          \
+  /* Endpoint IN, isochronous asynchronous */                                \
+  0x09,                               /* bLength */                          \
+  USB_DESC_TYPE_ENDPOINT,             /* bDescriptorType */                  \
+  USBD_AUDIO_IN_EP,                   /* bEndpointAddress */                 \
+  0x05,                               /* bmAttributes */                     \
+  LOBYTE(USBD_AUDIO_MAX_PACKET),      /* wMaxPacketSize */                   \
+  HIBYTE(USBD_AUDIO_MAX_PACKET),                                             \
+  (interval),                         /* bInterval */                        \
+  0x00,                               /* bRefresh */                         \
+  0x00,                               /* bSynchAddress */                    \
+  /* Class specific endpoint: no sample rate or pitch control */             \
+  0x07, USBD_AUDIO_CS_ENDPOINT, 0x01, 0x00, 0x00, 0x00, 0x00
+
+__ALIGN_BEGIN static const uint8_t USBD_AUDIO_CfgFSDesc[] __ALIGN_END =
+{
+  USBD_AUDIO_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, 0x01)
+};
+
+/* The build fails if wTotalLength does not match the descriptor */
+typedef char USBD_AUDIO_CfgFSDescSizeCheck[(sizeof(USBD_AUDIO_CfgFSDesc) == USBD_AUDIO_CFG_DESC_SIZ) ? 1 : -1];
+
+#if (USBD_FS_ONLY == 0)
+__ALIGN_BEGIN static const uint8_t USBD_AUDIO_CfgHSDesc[] __ALIGN_END =
+{
+  USBD_AUDIO_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, 0x04)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_AUDIO_OtherSpeedFSDesc[] __ALIGN_END =
+{
+  USBD_AUDIO_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, 0x01)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_AUDIO_OtherSpeedHSDesc[] __ALIGN_END =
+{
+  USBD_AUDIO_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, 0x04)
+};
+
+__ALIGN_BEGIN static uint8_t USBD_AUDIO_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0xEF,                 /* IAD */
+  0x02,
+  0x01,
+  0x40,
+  0x01,
+  0x00,
+};
+
+static USBD_HandleTypeDef *USBD_AUDIO_Dev;
+#endif /* USBD_FS_ONLY */
+
+static USBD_AUDIO_HandleTypeDef USBD_AUDIO_Handle;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_AUDIO_Get
+  *         State of the class, standalone or as a function of a composite
+  * @param  pdev: device instance
+  * @retval class data, NULL while not configured
+  */
+static USBD_AUDIO_HandleTypeDef *USBD_AUDIO_Get (USBD_HandleTypeDef *pdev)
+{
+#if (USBD_COMPOSITE_ENABLED == 1)
+  if (pdev->pClass != &USBD_AUDIO)
+  {
+    return (USBD_AUDIO_HandleTypeDef *)USBD_Composite_GetClassData(pdev, &USBD_AUDIO);
+  }
+#endif /* USBD_COMPOSITE_ENABLED */
+  return (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+}
+
+/**
+  * @brief  USBD_AUDIO_SendPacket
+  *         Queue the packet of the next frame: the samples the source made
+  *         in one frame, and one more or less while the FIFO is off its
+  *         midpoint
+  * @param  pdev: device instance
+  * @param  haudio: class data
+  * @retval None
+  */
+static void  USBD_AUDIO_SendPacket (USBD_HandleTypeDef *pdev,
+                                    USBD_AUDIO_HandleTypeDef *haudio)
+{
+  uint32_t level = haudio->Wr - haudio->Rd;
+  uint32_t rd = haudio->Rd;
+  uint32_t n, i;
+  int16_t *dst = haudio->Packet;
+
+  /* the samples behind Wr are written before it */
+  __DMB();
+
+  haudio->Acc += haudio->Rate;
+  n = haudio->Acc >> 14;
+  haudio->Acc &= (1U << 14) - 1U;
+
+  if (level > USBD_AUDIO_FIFO_TARGET + USBD_AUDIO_FIFO_SLACK)
+  {
+    n++;
+  }
+  else if ((level + USBD_AUDIO_FIFO_SLACK < USBD_AUDIO_FIFO_TARGET) && (n > 0))
+  {
+    n--;
+  }
+  n = MIN(n, USBD_AUDIO_MAX_FRAMES);
+  n = MIN(n, level);
+
+  for (i = 0; i < n; i++, rd++)
+  {
+    const int16_t *src = &haudio->Fifo[(rd & (USBD_AUDIO_FIFO_FRAMES - 1U)) * USBD_AUDIO_CHANNELS];
+    uint32_t ch;
+
+    for (ch = 0; ch < USBD_AUDIO_CHANNELS; ch++)
+    {
+      *dst++ = src[ch];
+    }
+  }
+  haudio->Rd = rd;
+
+  USBD_LL_Transmit(pdev, USBD_AUDIO_IN_EP, (uint8_t *)haudio->Packet,
+                   (uint16_t)(n * USBD_AUDIO_FRAME_BYTES));
+}
+
+/**
+  * @brief  USBD_AUDIO_Stream
+  *         Open or close the stream on SET_INTERFACE of the streaming
+  *         interface
+  * @param  pdev: device instance
+  * @param  alt: alternate setting, 1 streams
+  * @retval None
+  */
+static void  USBD_AUDIO_Stream (USBD_HandleTypeDef *pdev, uint8_t alt)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+  uint32_t level;
+
+  if (alt == haudio->AltSetting)
+  {
+    return;
+  }
+  haudio->AltSetting = alt;
+
+  if (alt == 0)
+  {
+    USBD_LL_CloseEP(pdev, USBD_AUDIO_IN_EP);
+    ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData)->Streaming(0);
+    return;
+  }
+
+  /* start at the midpoint: older samples are dropped, a short FIFO fills
+     while the first packets run short */
+  level = haudio->Wr - haudio->Rd;
+  if (level > USBD_AUDIO_FIFO_TARGET)
+  {
+    haudio->Rd += level - USBD_AUDIO_FIFO_TARGET;
+  }
+  haudio->Acc = 0;
+
+  USBD_LL_OpenEP(pdev, USBD_AUDIO_IN_EP, USBD_EP_TYPE_ISOC, USBD_AUDIO_MAX_PACKET);
+  ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData)->Streaming(1);
+  USBD_AUDIO_SendPacket(pdev, haudio);
+}
+
+/**
+  * @brief  USBD_AUDIO_Init
+  *         Reset the stream, the endpoint opens with alternate setting 1
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = &USBD_AUDIO_Handle;
+
+  if (pdev->pUserData == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+#if (USBD_AUDIO_PMA_ALLOC == 1)
+  if (!USBD_IS_HIGH_SPEED(pdev))
+  {
+    USBD_LL_PMAConfig(pdev, USBD_AUDIO_IN_EP, USBD_EP_DBL_BUF,
+                      USBD_AUDIO_PMA_ADDR |
+                      ((USBD_AUDIO_PMA_ADDR + USBD_AUDIO_PMA_BUF_SIZE) << 16));
+  }
+#endif /* USBD_AUDIO_PMA_ALLOC */
+
+  haudio->Wr = 0;
+  haudio->Rd = 0;
+  haudio->RateStart = 0;
+  haudio->RateFrames = 0;
+  haudio->Rate = USBD_AUDIO_RATE_NOMINAL;
+  haudio->Acc = 0;
+  haudio->Missed = 0;
+  haudio->Dropped = 0;
+  haudio->AltSetting = 0;
+  pdev->pClassData = haudio;
+#if (USBD_FS_ONLY == 0)
+  USBD_AUDIO_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+
+  ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData)->Init();
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_DeInit
+  *         Close the stream
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+
+  USBD_LL_CloseEP(pdev, USBD_AUDIO_IN_EP);
+
+  if (haudio != NULL)
+  {
+    if (haudio->AltSetting != 0)
+    {
+      ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData)->Streaming(0);
+    }
+    ((USBD_AUDIO_ItfTypeDef *)pdev->pUserData)->DeInit();
+    pdev->pClassData = NULL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_Setup
+  *         Alternate settings of the streaming interface; there are no
+  *         controls, so class requests are stalled
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+  static uint8_t ifalt;
+
+  if (haudio == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE:
+      ifalt = (LOBYTE(req->wIndex) == USBD_AUDIO_AS_ITF_NUM) ? haudio->AltSetting : 0;
+      USBD_CtlSendData(pdev, &ifalt, 1);
+      break;
+
+    case USB_REQ_SET_INTERFACE:
+      if ((LOBYTE(req->wIndex) == USBD_AUDIO_AS_ITF_NUM) && (req->wValue <= 1))
+      {
+        USBD_AUDIO_Stream(pdev, (uint8_t)req->wValue);
+      }
+      else if ((LOBYTE(req->wIndex) != USBD_AUDIO_AC_ITF_NUM) || (req->wValue != 0))
+      {
+        return USBD_FAIL;
+      }
+      break;
+    }
+    break;
+
+  default:
+    return USBD_FAIL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_DataIn
+  *         Packet of one frame gone, queue the next
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+
+  if ((haudio == NULL) || (haudio->AltSetting == 0))
+  {
+    return USBD_FAIL;
+  }
+  USBD_AUDIO_SendPacket(pdev, haudio);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_SOF
+  *         Measure the rate of the source against the frame clock
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_SOF (USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+  uint32_t wr, rate;
+
+  if (haudio == NULL)
+  {
+    return USBD_OK;
+  }
+
+  if (++haudio->RateFrames < USBD_AUDIO_RATE_FRAMES)
+  {
+    return USBD_OK;
+  }
+
+  /* samples over the window, per frame in Q10.14, low pass filtered:
+     writes of the source come in bursts much shorter than the window */
+  wr = haudio->Wr;
+  rate = (uint32_t)(((uint64_t)(wr - haudio->RateStart) << 14) / USBD_AUDIO_RATE_FRAMES);
+  haudio->Rate = (uint32_t)((int32_t)haudio->Rate + (((int32_t)rate - (int32_t)haudio->Rate) >> 2));
+  haudio->RateStart = wr;
+  haudio->RateFrames = 0;
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_IsoINIncomplete
+  *         The host polled no packet last frame: it stays queued
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_AUDIO_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = (USBD_AUDIO_HandleTypeDef *)pdev->pClassData;
+
+  if (haudio != NULL)
+  {
+    haudio->Missed++;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_AUDIO_GetFSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_AUDIO_CfgFSDesc);
+  return (uint8_t *)USBD_AUDIO_CfgFSDesc;
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_AUDIO_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_AUDIO_GetHSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_AUDIO_CfgHSDesc);
+  return (uint8_t *)USBD_AUDIO_CfgHSDesc;
+}
+
+/**
+  * @brief  USBD_AUDIO_GetOtherSpeedCfgDesc
+  *         Return the configuration of the speed the device is not at
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_AUDIO_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+  if ((USBD_AUDIO_Dev != NULL) && USBD_IS_HIGH_SPEED(USBD_AUDIO_Dev))
+  {
+    *length = sizeof (USBD_AUDIO_OtherSpeedFSDesc);
+    return (uint8_t *)USBD_AUDIO_OtherSpeedFSDesc;
+  }
+  *length = sizeof (USBD_AUDIO_OtherSpeedHSDesc);
+  return (uint8_t *)USBD_AUDIO_OtherSpeedHSDesc;
+}
+
+/**
+  * @brief  USBD_AUDIO_GetDeviceQualifierDesc
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_AUDIO_GetDeviceQualifierDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_AUDIO_DeviceQualifierDesc);
+  return USBD_AUDIO_DeviceQualifierDesc;
+}
+#endif /* USBD_FS_ONLY */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_audio_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_AUDIO_RegisterInterface
+  *         Set the application callbacks, standalone use
+  * @param  pdev: device instance
+  * @param  fops: callbacks
+  * @retval status
+  */
+uint8_t  USBD_AUDIO_RegisterInterface (USBD_HandleTypeDef *pdev,
+                                       USBD_AUDIO_ItfTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return USBD_FAIL;
+  }
+  pdev->pUserData = fops;
+#if (USBD_FS_ONLY == 0)
+  USBD_AUDIO_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_AUDIO_Write
+  *         Queue sample frames, interleaved by channel
+  * @note   Single producer, any priority. Samples are queued while
+  *         configured, streaming or not, so the FIFO is full when the host
+  *         opens the stream; those that do not fit are counted in Dropped.
+  * @param  pdev: device instance
+  * @param  samples: frames * USBD_AUDIO_CHANNELS samples
+  * @param  frames: sample frames
+  * @retval sample frames queued
+  */
+uint32_t  USBD_AUDIO_Write (USBD_HandleTypeDef *pdev,
+                            const int16_t *samples,
+                            uint32_t frames)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = USBD_AUDIO_Get(pdev);
+  uint32_t wr, room, i, ch;
+
+  if (haudio == NULL)
+  {
+    return 0;
+  }
+
+  wr = haudio->Wr;
+  room = USBD_AUDIO_FIFO_FRAMES - (wr - haudio->Rd);
+  if (frames > room)
+  {
+    haudio->Dropped += frames - room;
+    frames = room;
+  }
+
+  for (i = 0; i < frames; i++)
+  {
+    int16_t *dst = &haudio->Fifo[((wr + i) & (USBD_AUDIO_FIFO_FRAMES - 1U)) * USBD_AUDIO_CHANNELS];
+
+    for (ch = 0; ch < USBD_AUDIO_CHANNELS; ch++)
+    {
+      *dst++ = *samples++;
+    }
+  }
+
+  /* publish the samples before the index */
+  __DMB();
+  haudio->Wr = wr + frames;
+  return frames;
+}
+
+/**
+  * @brief  USBD_AUDIO_GetRate
+  *         Rate of the source measured against the host frame clock
+  * @param  pdev: device instance
+  * @retval sample frames per USB frame in Q10.14, 0 while not configured
+  */
+uint32_t  USBD_AUDIO_GetRate (USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_HandleTypeDef *haudio = USBD_AUDIO_Get(pdev);
+
+  return (haudio != NULL) ? haudio->Rate : 0;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_AUDIO_ENABLED */
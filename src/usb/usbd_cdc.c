@@ -60,6 +60,12 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc.h"
+#include "usbd_cdc_pma.h"
+#include "usb_prof.h"
+#include "usb_stats.h"
+#include "usb_trace.h"
+#include "usb_ccm.h"
+#include "usb_enumbench.h"
 #include "usbd_desc.h"
 #include "usbd_ctlreq.h"
 
@@ -103,7 +109,9 @@
   * @{
   */
 
+#if (USBD_CDC_GENERATED_DESC == 0)
 #include <cdc_descriptor.h>
+#endif
 
 
 static uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev, 
@@ -125,14 +133,257 @@ static uint8_t  USBD_CDC_EP0_RxReady (USBD_HandleTypeDef *pdev);
 
 static uint8_t  *USBD_CDC_GetFSCfgDesc (uint16_t *length);
 
+#if (USBD_FS_ONLY == 0)
 static uint8_t  *USBD_CDC_GetHSCfgDesc (uint16_t *length);
 
 static uint8_t  *USBD_CDC_GetOtherSpeedCfgDesc (uint16_t *length);
 
 uint8_t  *USBD_CDC_GetDeviceQualifierDescriptor (uint16_t *length);
+#endif /* USBD_FS_ONLY */
 
-void *ctxPointers[NUM_CDC_INSTANCES];
+#if (USBD_CDC_PMA_ALLOC == 1)
+static void  USBD_CDC_ConfigPMA (USBD_HandleTypeDef *pdev);
+#endif /* USBD_CDC_PMA_ALLOC */
 
+static uint32_t  USBD_CDC_InPacketSize (USBD_HandleTypeDef *pdev);
+
+static uint8_t  USBD_CDC_Claim (__IO uint32_t *state);
+
+static uint8_t  USBD_CDC_TxClaim (USBD_CDC_HandleTypeDef *hcdc, int instance);
+
+static uint8_t  USBD_CDC_RxClaim (USBD_CDC_HandleTypeDef *hcdc, int instance);
+
+static void  USBD_CDC_TxStart (USBD_HandleTypeDef *pdev, int instance);
+
+static void  USBD_CDC_NotifyKick (USBD_HandleTypeDef *pdev, int instance);
+
+#if (USBD_CDC_URGENT == 1)
+#if ((USBD_CDC_URGENT_DEPTH & (USBD_CDC_URGENT_DEPTH - 1)) != 0)
+#error "USBD_CDC_URGENT_DEPTH must be a power of two"
+#endif
+
+static uint8_t  USBD_CDC_UrgentStart (USBD_HandleTypeDef *pdev, int instance);
+#endif /* USBD_CDC_URGENT */
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+static void  USBD_CDC_WakeCheck (USBD_HandleTypeDef *pdev, int instance,
+                                 uint32_t queued);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+#if ((USBD_CDC_TX_RING_SIZE & (USBD_CDC_TX_RING_SIZE - 1)) != 0)
+#error "USBD_CDC_TX_RING_SIZE must be a power of two"
+#endif
+
+static uint8_t  USBD_CDC_TxRingKick (USBD_HandleTypeDef *pdev, int instance,
+                                     uint8_t flush);
+static void  USBD_CDC_TxRingPublish (USBD_HandleTypeDef *pdev, int instance,
+                                     uint32_t head, uint32_t length);
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if ((USBD_CDC_TX_RING_SIZE > 0) && (USBD_CDC_TX_FLUSH_FRAMES > 0)) || \
+    (USBD_CDC_TX_SCHED == 1)
+#define USBD_CDC_SOF_ENABLED            1
+static uint8_t  USBD_CDC_SOF (USBD_HandleTypeDef *pdev);
+#else
+#define USBD_CDC_SOF_ENABLED            0
+#endif
+
+#if (USBD_CDC_TX_SCHED == 1)
+static uint8_t  USBD_CDC_TxPending (USBD_CDC_HandleTypeDef *hcdc, int instance);
+
+static uint8_t  USBD_CDC_TxSchedAdmit (USBD_CDC_HandleTypeDef *hcdc, int instance);
+
+static void  USBD_CDC_TxSchedResume (USBD_HandleTypeDef *pdev);
+
+/* bytes started on the IN endpoint of an instance, against its budget */
+#define USBD_CDC_TX_CHARGE(hcdc, instance, n)   ((hcdc)->TxSpent[(instance)] += (n))
+#else
+#define USBD_CDC_TX_CHARGE(hcdc, instance, n)
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+#if ((USBD_CDC_TX_QUEUE_SIZE & (USBD_CDC_TX_QUEUE_SIZE - 1)) != 0)
+#error "USBD_CDC_TX_QUEUE_SIZE must be a power of two"
+#endif
+
+static uint8_t  USBD_CDC_TxQueueStart (USBD_HandleTypeDef *pdev, int instance);
+
+static uint8_t  USBD_CDC_TxQueueDone (USBD_CDC_HandleTypeDef *hcdc, int instance,
+                                      uint8_t status);
+
+static void  USBD_CDC_TxQueueKick (USBD_HandleTypeDef *pdev, int instance);
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USB_PROF_ENABLED == 1)
+static uint8_t  USBD_CDC_ProfSetup (USBD_HandleTypeDef *pdev, 
+                                    USBD_SetupReqTypedef *req);
+
+static uint8_t  USBD_CDC_ProfDataIn (USBD_HandleTypeDef *pdev, 
+                                     uint8_t epnum);
+
+static uint8_t  USBD_CDC_ProfDataOut (USBD_HandleTypeDef *pdev, 
+                                      uint8_t epnum);
+
+#define USBD_CDC_SETUP_CB               USBD_CDC_ProfSetup
+#define USBD_CDC_DATA_IN_CB             USBD_CDC_ProfDataIn
+#define USBD_CDC_DATA_OUT_CB            USBD_CDC_ProfDataOut
+#else
+#define USBD_CDC_SETUP_CB               USBD_CDC_Setup
+#define USBD_CDC_DATA_IN_CB             USBD_CDC_DataIn
+#define USBD_CDC_DATA_OUT_CB            USBD_CDC_DataOut
+#endif /* USB_PROF_ENABLED */
+
+#if (USBD_CDC_FAST_DISPATCH == 1)
+static uint8_t  USBD_CDC_FastDataIn (void *pdev, uint8_t epnum);
+
+static uint8_t  USBD_CDC_FastDataOut (void *pdev, uint8_t epnum);
+#endif /* USBD_CDC_FAST_DISPATCH */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+#if ((USBD_CDC_RX_RING_SIZE & (USBD_CDC_RX_RING_SIZE - 1)) != 0)
+#error "USBD_CDC_RX_RING_SIZE must be a power of two"
+#endif
+
+static uint8_t  USBD_CDC_RxRingArm (USBD_HandleTypeDef *pdev, int instance);
+
+static void  USBD_CDC_RxRingPut (USBD_HandleTypeDef *pdev, int instance);
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_OS == 1)
+static void  USBD_CDC_OsSignal (USBD_HandleTypeDef *pdev, int instance,
+                                uint32_t events);
+
+static uint8_t  USBD_CDC_OsWait (USBD_HandleTypeDef *pdev, int instance,
+                                 uint32_t events, uint32_t *timeout);
+#define USBD_CDC_OS_SIGNAL(pdev, instance, events)  USBD_CDC_OsSignal((pdev), (instance), (events))
+#else
+#define USBD_CDC_OS_SIGNAL(pdev, instance, events)
+#endif /* USBD_CDC_OS */
+
+#if (USBD_CDC_LAT_HIST == 1)
+#if ((USBD_CDC_LAT_MARKS & (USBD_CDC_LAT_MARKS - 1)) != 0)
+#error "USBD_CDC_LAT_MARKS must be a power of two"
+#endif
+
+static void  USBD_CDC_LatRecord (uint32_t *hist, uint32_t stamp);
+
+#if (USBD_CDC_TX_RING_SIZE > 0) || (USBD_CDC_RX_RING_SIZE > 0)
+static void  USBD_CDC_LatPush (USBD_CDC_LatMarkTypeDef *mark, __IO uint32_t *head,
+                               uint32_t tail, uint32_t end);
+
+static void  USBD_CDC_LatPop (USBD_CDC_LatMarkTypeDef *mark, uint32_t head,
+                              __IO uint32_t *tail, uint32_t done, uint32_t *hist);
+#endif
+
+/* start and end of a transfer outside the rings */
+#define USBD_CDC_LAT_TX_START(hcdc, i)          do { (hcdc)->TxStamp[(i)] = DWT->CYCCNT; \
+                                                     (hcdc)->TxStamped[(i)] = 1; } while (0)
+#define USBD_CDC_LAT_RX_START(hcdc, i)          do { (hcdc)->RxStamp[(i)] = DWT->CYCCNT; \
+                                                     (hcdc)->RxStamped[(i)] = 1; } while (0)
+#define USBD_CDC_LAT_TX_DONE(hcdc, i)           do { if ((hcdc)->TxStamped[(i)]) { (hcdc)->TxStamped[(i)] = 0; \
+                                                     USBD_CDC_LatRecord((hcdc)->LatHist[(i)].tx, (hcdc)->TxStamp[(i)]); } } while (0)
+#define USBD_CDC_LAT_RX_DONE(hcdc, i)           do { if ((hcdc)->RxStamped[(i)]) { (hcdc)->RxStamped[(i)] = 0; \
+                                                     USBD_CDC_LatRecord((hcdc)->LatHist[(i)].rx, (hcdc)->RxStamp[(i)]); } } while (0)
+#else
+#define USBD_CDC_LAT_TX_START(hcdc, i)
+#define USBD_CDC_LAT_RX_START(hcdc, i)
+#define USBD_CDC_LAT_TX_DONE(hcdc, i)
+#define USBD_CDC_LAT_RX_DONE(hcdc, i)
+#endif /* USBD_CDC_LAT_HIST */
+
+/* Slot of a device in the per device tables */
+#if (USBD_CDC_MAX_DEVICES > 1)
+#define USBD_CDC_DEV_INDEX(pdev)                ((pdev)->id)
+#else
+#define USBD_CDC_DEV_INDEX(pdev)                0U
+#endif
+
+/* Without USBD_CTL_DEFERRED no return of Control holds a request: an
+   application returning USBD_BUSY (1) is still answered */
+#if (USBD_CTL_DEFERRED == 1)
+#define USBD_CDC_CTRL_DEFER(pdev)               USBD_CtlDefer(pdev)
+#define USBD_CDC_CTRL_IS_DEFERRED(ret)          ((ret) == USBD_CDC_CTRL_DEFERRED)
+#else
+#define USBD_CDC_CTRL_DEFER(pdev)
+#define USBD_CDC_CTRL_IS_DEFERRED(ret)          ((void)(ret), 0)
+#endif /* USBD_CTL_DEFERRED */
+
+#if (USBD_CDC_OS == 1)
+/* OS layer of each instance of each device, NULL for the callback
+   interface. Outside the handle: it is registered before the host
+   configures the device. */
+static const USBD_CDC_OsTypeDef *USBD_CDC_Os[USBD_CDC_MAX_DEVICES][NUM_CDC_INSTANCES];
+#define USBD_CDC_OS_LAYER(pdev, instance)       USBD_CDC_Os[USBD_CDC_DEV_INDEX(pdev)][(instance)]
+#endif /* USBD_CDC_OS */
+
+/* Endpoints of each instance */
+static const uint8_t USBD_CDC_InEp[NUM_CDC_INSTANCES] =
+{
+  CDC_IN_EP,
+#if (NUM_CDC_INSTANCES > 1)
+  CDC2_IN_EP,
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+  CDC3_IN_EP,
+#endif
+};
+
+static const uint8_t USBD_CDC_OutEp[NUM_CDC_INSTANCES] =
+{
+  CDC_OUT_EP,
+#if (NUM_CDC_INSTANCES > 1)
+  CDC2_OUT_EP,
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+  CDC3_OUT_EP,
+#endif
+};
+
+static const uint8_t USBD_CDC_CmdEp[NUM_CDC_INSTANCES] =
+{
+  CDC_CMD_EP,
+#if (NUM_CDC_INSTANCES > 1)
+  CDC2_CMD_EP,
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+  CDC3_CMD_EP,
+#endif
+};
+
+/* Communication interface of each instance, for the notifications */
+static const uint8_t USBD_CDC_CtrlItf[NUM_CDC_INSTANCES] =
+{
+#if (USBD_CDC_GENERATED_DESC == 1)
+  USBD_CDC_CIF_NUM(0),
+#if (NUM_CDC_INSTANCES > 1)
+  USBD_CDC_CIF_NUM(1),
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+  USBD_CDC_CIF_NUM(2),
+#endif
+#else
+  0,
+  USB_CDC_CIF_NUM1,
+#endif /* USBD_CDC_GENERATED_DESC */
+};
+
+/* Endpoint number to instance map, both directions share an entry */
+static const uint8_t USBD_CDC_EpInstance[16] =
+{
+  [CDC_IN_EP & 0x0F] = 0,
+  [CDC_CMD_EP & 0x0F] = 0,
+#if (NUM_CDC_INSTANCES > 1)
+  [CDC2_IN_EP & 0x0F] = 1,
+  [CDC2_CMD_EP & 0x0F] = 1,
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+  [CDC3_IN_EP & 0x0F] = 2,
+  [CDC3_CMD_EP & 0x0F] = 2,
+#endif
+};
+
+#if (USBD_FS_ONLY == 0)
 /* USB Standard Device Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_CDC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
 {
@@ -140,13 +391,125 @@ __ALIGN_BEGIN static uint8_t USBD_CDC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
   USB_DESC_TYPE_DEVICE_QUALIFIER,
   0x00,
   0x02,
-  0x00,
-  0x00,
-  0x00,
-  0x40,
+  0xEF,                 /* miscellaneous device class: IAD */
+  0x02,
+  0x01,
+  USB_MAX_EP0_SIZE,
   0x01,
   0x00,
 };
+#endif /* USBD_FS_ONLY */
+
+#if (USBD_CDC_GENERATED_DESC == 1)
+/* One IAD wrapped ACM function: communication interface 2*i with its
+   notification endpoint, data interface 2*i+1 with the bulk pair */
+#define USBD_CDC_FUNC_DESC(i, in_ep, out_ep, cmd_ep, mps, interval)           \
+  /* Interface Association Descriptor */                                     \
+  0x08, 0x0B, USBD_CDC_CIF_NUM(i), 0x02, 0x02, 0x02, 0x01, 0x00,             \
+  /* Communication Interface Descriptor */                                   \
+  0x09, USB_DESC_TYPE_INTERFACE, USBD_CDC_CIF_NUM(i), 0x00, 0x01,            \
+  0x02, 0x02, 0x01, 0x00,                                                    \
+  /* Header Functional Descriptor */                                         \
+  0x05, 0x24, 0x00, 0x10, 0x01,                                              \
+  /* Call Management Functional Descriptor */                                \
+  0x05, 0x24, 0x01, 0x00, USBD_CDC_DIF_NUM(i),                               \
+  /* ACM Functional Descriptor */                                            \
+  0x04, 0x24, 0x02, 0x02,                                                    \
+  /* Union Functional Descriptor */                                          \
+  0x05, 0x24, 0x06, USBD_CDC_CIF_NUM(i), USBD_CDC_DIF_NUM(i),                \
+  /* Notification Endpoint Descriptor */                                     \
+  0x07, USB_DESC_TYPE_ENDPOINT, (cmd_ep), 0x03,                              \
+  LOBYTE(CDC_CMD_PACKET_SIZE), HIBYTE(CDC_CMD_PACKET_SIZE), (interval),      \
+  /* Data Interface Descriptor */                                            \
+  0x09, USB_DESC_TYPE_INTERFACE, USBD_CDC_DIF_NUM(i), 0x00, 0x02,            \
+  0x0A, 0x00, 0x00, 0x00,                                                    \
+  /* Data OUT Endpoint Descriptor */                                         \
+  0x07, USB_DESC_TYPE_ENDPOINT, (out_ep), 0x02, LOBYTE(mps), HIBYTE(mps),     \
+  0x00,                                                                      \
+  /* Data IN Endpoint Descriptor */                                          \
+  0x07, USB_DESC_TYPE_ENDPOINT, (in_ep), 0x02, LOBYTE(mps), HIBYTE(mps),      \
+  0x00
+
+/* The functions of all instances */
+#if (NUM_CDC_INSTANCES == 1)
+#define USBD_CDC_FUNCS_DESC(mps, interval)                                    \
+  USBD_CDC_FUNC_DESC(0, CDC_IN_EP, CDC_OUT_EP, CDC_CMD_EP, mps, interval)
+#elif (NUM_CDC_INSTANCES == 2)
+#define USBD_CDC_FUNCS_DESC(mps, interval)                                    \
+  USBD_CDC_FUNC_DESC(0, CDC_IN_EP, CDC_OUT_EP, CDC_CMD_EP, mps, interval),    \
+  USBD_CDC_FUNC_DESC(1, CDC2_IN_EP, CDC2_OUT_EP, CDC2_CMD_EP, mps, interval)
+#else
+#define USBD_CDC_FUNCS_DESC(mps, interval)                                    \
+  USBD_CDC_FUNC_DESC(0, CDC_IN_EP, CDC_OUT_EP, CDC_CMD_EP, mps, interval),    \
+  USBD_CDC_FUNC_DESC(1, CDC2_IN_EP, CDC2_OUT_EP, CDC2_CMD_EP, mps, interval), \
+  USBD_CDC_FUNC_DESC(2, CDC3_IN_EP, CDC3_OUT_EP, CDC3_CMD_EP, mps, interval)
+#endif
+
+/* Self powered, plus remote wakeup when used */
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+#define USBD_CDC_CFG_ATTRIBUTES             0xE0
+#else
+#define USBD_CDC_CFG_ATTRIBUTES             0xC0
+#endif
+
+/* Whole configuration: type is the configuration or, for the speed the
+   device is not running at, the other speed configuration descriptor
+   type. The notification interval is 16 ms at both speeds, 1 ms for the
+   urgent channel: frames at full speed, 2^(interval-1) microframes at
+   high speed. */
+#define USBD_CDC_CFG_DESC(type, mps, interval)                                \
+  0x09,                               /* bLength */                          \
+  (type),                             /* bDescriptorType */                  \
+  LOBYTE(USBD_CDC_CFG_DESC_SIZ),      /* wTotalLength */                     \
+  HIBYTE(USBD_CDC_CFG_DESC_SIZ),                                             \
+  2 * NUM_CDC_INSTANCES,              /* bNumInterfaces */                   \
+  0x01,                               /* bConfigurationValue */              \
+  0x00,                               /* iConfiguration */                   \
+  USBD_CDC_CFG_ATTRIBUTES,            /* bmAttributes */                     \
+  0x32,                               /* MaxPower 100 mA */                  \
+  USBD_CDC_FUNCS_DESC(mps, interval)
+
+#if (USBD_CDC_URGENT == 1)
+#define USBD_CDC_FS_INTERVAL                0x01
+#define USBD_CDC_HS_INTERVAL                0x04
+#else
+#define USBD_CDC_FS_INTERVAL                0x10
+#define USBD_CDC_HS_INTERVAL                0x08
+#endif
+
+/* USB CDC device Configuration Descriptor */
+__ALIGN_BEGIN static const uint8_t USBD_CDC_CfgFSDesc[] __ALIGN_END =
+{
+  USBD_CDC_CFG_DESC(USB_DESC_TYPE_CONFIGURATION,
+                    CDC_DATA_FS_MAX_PACKET_SIZE, USBD_CDC_FS_INTERVAL)
+};
+
+/* The build fails if wTotalLength does not match what was generated */
+typedef char USBD_CDC_CfgFSDescSizeCheck[(sizeof(USBD_CDC_CfgFSDesc) == USBD_CDC_CFG_DESC_SIZ) ? 1 : -1];
+
+#if (USBD_FS_ONLY == 0)
+__ALIGN_BEGIN static const uint8_t USBD_CDC_CfgHSDesc[] __ALIGN_END =
+{
+  USBD_CDC_CFG_DESC(USB_DESC_TYPE_CONFIGURATION,
+                    CDC_DATA_HS_MAX_PACKET_SIZE, USBD_CDC_HS_INTERVAL)
+};
+
+/* Other speed configurations, returned as is: the descriptors are const */
+__ALIGN_BEGIN static const uint8_t USBD_CDC_OtherSpeedFSDesc[] __ALIGN_END =
+{
+  USBD_CDC_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION,
+                    CDC_DATA_FS_MAX_PACKET_SIZE, USBD_CDC_FS_INTERVAL)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_CDC_OtherSpeedHSDesc[] __ALIGN_END =
+{
+  USBD_CDC_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION,
+                    CDC_DATA_HS_MAX_PACKET_SIZE, USBD_CDC_HS_INTERVAL)
+};
+
+typedef char USBD_CDC_CfgHSDescSizeCheck[(sizeof(USBD_CDC_CfgHSDesc) == USBD_CDC_CFG_DESC_SIZ) ? 1 : -1];
+#endif /* USBD_FS_ONLY */
+#endif /* USBD_CDC_GENERATED_DESC */
 
 /**
   * @}
@@ -157,23 +520,53 @@ __ALIGN_BEGIN static uint8_t USBD_CDC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
   */ 
 
 
+#if (USBD_CDC_STATIC_HANDLE == 1)
+static USBD_CDC_HandleTypeDef USBD_CDC_Handle[USBD_CDC_MAX_DEVICES] USB_CCM_DATA;
+#elif (USB_CCM_RINGS == 1)
+#error "USB_CCM_RINGS needs USBD_CDC_STATIC_HANDLE"
+#endif /* USBD_CDC_STATIC_HANDLE */
+
+#if (USBD_FS_ONLY == 0)
+/* High speed capable device the interface is registered with, for the
+   running speed when the core asks for the other speed configuration: a
+   full speed only device never does */
+static USBD_HandleTypeDef *USBD_CDC_Dev;
+#endif /* USBD_FS_ONLY */
+
 /* CDC interface class callbacks structure */
 USBD_ClassTypeDef  USBD_CDC = 
 {
   USBD_CDC_Init,
   USBD_CDC_DeInit,
-  USBD_CDC_Setup,
+  USBD_CDC_SETUP_CB,
   NULL,                 /* EP0_TxSent, */
   USBD_CDC_EP0_RxReady,
-  USBD_CDC_DataIn,
-  USBD_CDC_DataOut,
+  USBD_CDC_DATA_IN_CB,
+  USBD_CDC_DATA_OUT_CB,
+#if (USBD_CDC_SOF_ENABLED == 1)
+  USBD_CDC_SOF,
+#else
   NULL,
+#endif
   NULL,
   NULL,     
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_CDC_GetFSCfgDesc,
+  NULL,
+  NULL,
+#else
   USBD_CDC_GetHSCfgDesc,  
   USBD_CDC_GetFSCfgDesc,    
   USBD_CDC_GetOtherSpeedCfgDesc, 
   USBD_CDC_GetDeviceQualifierDescriptor,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  NULL,                 /* LPM: nothing to stop in L1 */
+#endif
 };
 
 /**
@@ -184,6 +577,78 @@ USBD_ClassTypeDef  USBD_CDC =
   * @{
   */ 
 
+#if (USBD_CDC_PMA_ALLOC == 1)
+/**
+  * @brief  USBD_CDC_ConfigPMA
+  *         Assign packet memory to the CDC endpoints, see usbd_cdc_pma.h
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void  USBD_CDC_ConfigPMA (USBD_HandleTypeDef *pdev)
+{
+  static const uint16_t out_addr[NUM_CDC_INSTANCES] =
+  {
+    USBD_CDC_PMA_OUT_ADDR(0),
+#if (NUM_CDC_INSTANCES > 1)
+    USBD_CDC_PMA_OUT_ADDR(1),
+#endif
+#if (NUM_CDC_INSTANCES > 2)
+    USBD_CDC_PMA_OUT_ADDR(2),
+#endif
+  };
+  uint32_t addr;
+  int i;
+
+  for (i = 0; i < NUM_CDC_INSTANCES; i++)
+  {
+    /* OUT, IN and notification buffers follow each other */
+    addr = out_addr[i];
+
+    if (USBD_CDC_DBL_BUF_OUT_MASK & (1 << i))
+    {
+      USBD_LL_PMAConfig(pdev, USBD_CDC_OutEp[i], USBD_EP_DBL_BUF,
+                        addr | ((addr + CDC_DATA_FS_MAX_PACKET_SIZE) << 16));
+      addr += 2 * CDC_DATA_FS_MAX_PACKET_SIZE;
+    }
+    else
+    {
+      USBD_LL_PMAConfig(pdev, USBD_CDC_OutEp[i], USBD_EP_SNG_BUF, addr);
+      addr += CDC_DATA_FS_MAX_PACKET_SIZE;
+    }
+
+    if (USBD_CDC_DBL_BUF_IN_MASK & (1 << i))
+    {
+      USBD_LL_PMAConfig(pdev, USBD_CDC_InEp[i], USBD_EP_DBL_BUF,
+                        addr | ((addr + CDC_DATA_FS_MAX_PACKET_SIZE) << 16));
+      addr += 2 * CDC_DATA_FS_MAX_PACKET_SIZE;
+    }
+    else
+    {
+      USBD_LL_PMAConfig(pdev, USBD_CDC_InEp[i], USBD_EP_SNG_BUF, addr);
+      addr += CDC_DATA_FS_MAX_PACKET_SIZE;
+    }
+
+    USBD_LL_PMAConfig(pdev, USBD_CDC_CmdEp[i], USBD_EP_SNG_BUF, addr);
+  }
+}
+#endif /* USBD_CDC_PMA_ALLOC */
+
+/**
+  * @brief  USBD_CDC_InPacketSize
+  *         Max packet size of the data IN endpoints at the current speed
+  * @param  pdev: device instance
+  * @retval packet size
+  */
+static uint32_t  USBD_CDC_InPacketSize (USBD_HandleTypeDef *pdev)
+{
+  if(USBD_IS_HIGH_SPEED(pdev)) 
+  {
+    return CDC_DATA_HS_IN_PACKET_SIZE;
+  }
+
+  return CDC_DATA_FS_IN_PACKET_SIZE;
+}
+
 /**
   * @brief  USBD_CDC_Init
   *         Initialize the CDC interface
@@ -197,70 +662,51 @@ static uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev,
   uint8_t ret = 0;
   USBD_CDC_HandleTypeDef   *hcdc;
   
-  if(pdev->dev_speed == USBD_SPEED_HIGH  ) 
+  uint16_t mps = CDC_DATA_FS_MAX_PACKET_SIZE;
+  
+  if(USBD_IS_HIGH_SPEED(pdev)) 
   {  
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev,
-                   CDC_IN_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_IN_PACKET_SIZE);
-    
-    /* Open EP OUT */
-    USBD_LL_OpenEP(pdev,
-                   CDC_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_OUT_PACKET_SIZE);
-    
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev,
-                   CDC2_IN_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_IN_PACKET_SIZE);
-    
-    /* Open EP OUT */
-    USBD_LL_OpenEP(pdev,
-                   CDC2_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_HS_OUT_PACKET_SIZE);
+    mps = CDC_DATA_HS_MAX_PACKET_SIZE;
   }
+#if (USBD_CDC_PMA_ALLOC == 1)
   else
   {
+    USBD_CDC_ConfigPMA(pdev);
+  }
+#endif /* USBD_CDC_PMA_ALLOC */
+
+  for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
     /* Open EP IN */
     USBD_LL_OpenEP(pdev,
-                   CDC_IN_EP,
+                   USBD_CDC_InEp[i],
                    USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_IN_PACKET_SIZE);
+                   mps);
     
     /* Open EP OUT */
     USBD_LL_OpenEP(pdev,
-                   CDC_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_OUT_PACKET_SIZE);
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev,
-                   CDC2_IN_EP,
+                   USBD_CDC_OutEp[i],
                    USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_IN_PACKET_SIZE);
-    
-    /* Open EP OUT */
+                   mps);
+
+    /* Open Command IN EP */
     USBD_LL_OpenEP(pdev,
-                   CDC2_OUT_EP,
-                   USBD_EP_TYPE_BULK,
-                   CDC_DATA_FS_OUT_PACKET_SIZE);
-  }
-  /* Open Command IN EP */
-  USBD_LL_OpenEP(pdev,
-                 CDC_CMD_EP,
-                 USBD_EP_TYPE_INTR,
-                 CDC_CMD_PACKET_SIZE);
-  /* Open Command IN EP */
-  USBD_LL_OpenEP(pdev,
-                 CDC2_CMD_EP,
-                 USBD_EP_TYPE_INTR,
-                 CDC_CMD_PACKET_SIZE);
+                   USBD_CDC_CmdEp[i],
+                   USBD_EP_TYPE_INTR,
+                   CDC_CMD_PACKET_SIZE);
+
+#if (USBD_CDC_FAST_DISPATCH == 1)
+    USBD_LL_SetEPCallback(pdev, USBD_CDC_InEp[i], USBD_CDC_FastDataIn);
+    USBD_LL_SetEPCallback(pdev, USBD_CDC_OutEp[i], USBD_CDC_FastDataOut);
+#endif /* USBD_CDC_FAST_DISPATCH */
+  }
   
     
+#if (USBD_CDC_STATIC_HANDLE == 1)
+  pdev->pClassData = (USBD_CDC_DEV_INDEX(pdev) < USBD_CDC_MAX_DEVICES) ?
+                     &USBD_CDC_Handle[USBD_CDC_DEV_INDEX(pdev)] : NULL;
+#else
   pdev->pClassData = USBD_malloc(sizeof (USBD_CDC_HandleTypeDef));
+#endif /* USBD_CDC_STATIC_HANDLE */
   
   if(pdev->pClassData == NULL)
   {
@@ -270,42 +716,97 @@ static uint8_t  USBD_CDC_Init (USBD_HandleTypeDef *pdev,
   {
     hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
     
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+    hcdc->WakeLatch = 0;
+    hcdc->TxWake = 0;
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+#if (USBD_CDC_TX_SCHED == 1)
+    hcdc->TxDeferred = 0;
+#endif /* USBD_CDC_TX_SCHED */
+#if (USBD_CDC_LAT_HIST == 1)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif /* USBD_CDC_LAT_HIST */
+
     /* Init  physical Interface components */
     for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
 	    /* Init Xfer states */
 	    hcdc->TxState[i] = 0;
 	    hcdc->RxState[i] = 0;
-
-	    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Init(i, ctxPointers + i);
+	    hcdc->TxZlp[i] = USBD_CDC_TX_ZLP_DEFAULT;
+	    hcdc->TxMore[i] = 0;
+	    hcdc->NotifyState[i] = 0;
+	    hcdc->SerialState[i] = 0;
+#if (USBD_CDC_URGENT == 1)
+	    for (int d = 0; d < USBD_CDC_URGENT_DEPTH; d++) {
+	      hcdc->Urgent[i][d].seq = 0;
+	    }
+	    hcdc->UrgentHead[i] = 0;
+	    hcdc->UrgentTail[i] = 0;
+	    hcdc->UrgentSent[i] = 0;
+#endif /* USBD_CDC_URGENT */
+#if (USBD_CDC_TX_RING_SIZE > 0)
+	    hcdc->TxHead[i] = 0;
+	    hcdc->TxTail[i] = 0;
+	    hcdc->TxFromRing[i] = 0;
+#if (USBD_CDC_TX_FLUSH_FRAMES > 0)
+	    hcdc->TxAge[i] = 0;
+#endif /* USBD_CDC_TX_FLUSH_FRAMES */
+#endif /* USBD_CDC_TX_RING_SIZE */
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+	    for (int d = 0; d < USBD_CDC_TX_QUEUE_SIZE; d++) {
+	      hcdc->TxQueue[i][d].seq = 0;
+	    }
+	    hcdc->TxQHead[i] = 0;
+	    hcdc->TxQTail[i] = 0;
+	    hcdc->TxFromQueue[i] = 0;
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+#if (USBD_CDC_LINE_CACHE == 1)
+	    hcdc->LineCoding[i].bitrate = USBD_CDC_LINE_CODING_DEFAULT_BAUD;
+	    hcdc->LineCoding[i].format = 0;
+	    hcdc->LineCoding[i].paritytype = 0;
+	    hcdc->LineCoding[i].datatype = 8;
+	    hcdc->LineState[i] = 0;
+#endif /* USBD_CDC_LINE_CACHE */
+#if (USBD_CDC_TX_SCHED == 1)
+	    hcdc->TxPrio[i] = 0;
+	    hcdc->TxHold[i] = 0;
+	    hcdc->TxBudget[i] = 0;
+	    hcdc->TxSpent[i] = 0;
+#endif /* USBD_CDC_TX_SCHED */
+#if (USBD_CDC_RX_RING_SIZE > 0)
+	    hcdc->RxHead[i] = 0;
+	    hcdc->RxTail[i] = 0;
+	    hcdc->RxStalled[i] = 0;
+	    hcdc->RxHighWater[i] = 0;
+#endif /* USBD_CDC_RX_RING_SIZE */
+#if (USBD_CDC_OS == 1)
+	    hcdc->RxAvail[i] = 0;
+	    hcdc->RxOffset[i] = 0;
+#endif /* USBD_CDC_OS */
+#if (USBD_CDC_LAT_HIST == 1)
+	    memset(&hcdc->LatHist[i], 0, sizeof(hcdc->LatHist[i]));
+	    hcdc->TxStamped[i] = 0;
+	    hcdc->RxStamped[i] = 0;
+#if (USBD_CDC_TX_RING_SIZE > 0)
+	    hcdc->TxMarkHead[i] = 0;
+	    hcdc->TxMarkTail[i] = 0;
+#endif /* USBD_CDC_TX_RING_SIZE */
+#if (USBD_CDC_RX_RING_SIZE > 0)
+	    hcdc->RxMarkHead[i] = 0;
+	    hcdc->RxMarkTail[i] = 0;
+#endif /* USBD_CDC_RX_RING_SIZE */
+#endif /* USBD_CDC_LAT_HIST */
+
+	    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Init(i, hcdc->Ctx + i);
 
     }
        
-    if(pdev->dev_speed == USBD_SPEED_HIGH  ) 
-    {      
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-			     CDC_OUT_EP,
-			     hcdc->RxBuffer[0],
-			     CDC_DATA_HS_OUT_PACKET_SIZE);
-      USBD_LL_PrepareReceive(pdev,
-			     CDC2_OUT_EP,
-			     hcdc->RxBuffer[1],
-			     CDC_DATA_HS_OUT_PACKET_SIZE);
-    }
-    else
-    {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-			     CDC_OUT_EP,
-			     hcdc->RxBuffer[0],
-			     CDC_DATA_FS_OUT_PACKET_SIZE);
-      USBD_LL_PrepareReceive(pdev,
-			     CDC2_OUT_EP,
-			     hcdc->RxBuffer[1],
-			     CDC_DATA_FS_OUT_PACKET_SIZE);
+    /* Prepare Out endpoints to receive next packet */
+    for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+	    USBD_CDC_ReceivePacket(pdev, i);
     }
-    
-    
+    USB_ENUMBENCH_MARK(USB_ENUMBENCH_INIT);
   }
   return ret;
 }
@@ -321,26 +822,32 @@ static uint8_t  USBD_CDC_DeInit (USBD_HandleTypeDef *pdev,
                                  uint8_t cfgidx)
 {
   uint8_t ret = 0;
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
-  USBD_LL_CloseEP(pdev,
-              CDC_IN_EP);
-  USBD_LL_CloseEP(pdev,
-              CDC_OUT_EP);
-  USBD_LL_CloseEP(pdev,
-              CDC_CMD_EP);
-  USBD_LL_CloseEP(pdev,
-              CDC2_IN_EP);
-  USBD_LL_CloseEP(pdev,
-              CDC2_OUT_EP);
-  USBD_LL_CloseEP(pdev,
-              CDC2_CMD_EP);
+  for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+    USBD_LL_CloseEP(pdev,
+                USBD_CDC_InEp[i]);
+    USBD_LL_CloseEP(pdev,
+                USBD_CDC_OutEp[i]);
+    USBD_LL_CloseEP(pdev,
+                USBD_CDC_CmdEp[i]);
+  }
   
   /* DeInit  physical Interface components */
-  if(pdev->pClassData != NULL)
+  if(hcdc != NULL)
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->DeInit(ctxPointers[0]);
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->DeInit(ctxPointers[1]);
+    for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+      /* Give the producers their buffers back, in flight one included */
+      while (USBD_CDC_TxQueueDone(hcdc, i, USBD_FAIL))
+      {
+      }
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->DeInit(hcdc->Ctx[i]);
+    }
+#if (USBD_CDC_STATIC_HANDLE == 0)
     USBD_free(pdev->pClassData);
+#endif /* USBD_CDC_STATIC_HANDLE */
     pdev->pClassData = NULL;
   }
   
@@ -359,12 +866,29 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
 {
   int instance = 0;
 
-  if ((req->wIndex == USB_CDC_CIF_NUM1) ||
-		  (req->wIndex == USB_CDC_DIF_NUM1)) {
-	  instance = 1;
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT) {
+	  instance = USBD_CDC_EpInstance[req->wIndex & 0x0F];
+  } else {
+#if (USBD_CDC_GENERATED_DESC == 1)
+	  /* Communication and data interface of an instance are adjacent */
+	  if ((req->wIndex & 0xFF) < 2 * NUM_CDC_INSTANCES) {
+		  instance = (req->wIndex & 0xFF) >> 1;
+	  }
+#else
+	  if ((req->wIndex == USB_CDC_CIF_NUM1) ||
+			  (req->wIndex == USB_CDC_DIF_NUM1)) {
+		  instance = 1;
+	  }
+#endif /* USBD_CDC_GENERATED_DESC */
   }
 
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if (hcdc == NULL)
+  {
+    /* vendor request before SET_CONFIGURATION */
+    return USBD_FAIL;
+  }
   hcdc->ctrlInst = instance;
 
   static uint8_t ifalt = 0;
@@ -372,15 +896,65 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
   switch (req->bmRequest & USB_REQ_TYPE_MASK)
   {
   case USB_REQ_TYPE_CLASS :
+#if (USBD_CDC_LINE_CACHE == 1)
+    if ((req->bRequest == CDC_GET_LINE_CODING) && req->wLength)
+    {
+      uint8_t *p = (uint8_t *)hcdc->data;
+      uint32_t bitrate = hcdc->LineCoding[instance].bitrate;
+
+      p[0] = (uint8_t)bitrate;
+      p[1] = (uint8_t)(bitrate >> 8);
+      p[2] = (uint8_t)(bitrate >> 16);
+      p[3] = (uint8_t)(bitrate >> 24);
+      p[4] = hcdc->LineCoding[instance].format;
+      p[5] = hcdc->LineCoding[instance].paritytype;
+      p[6] = hcdc->LineCoding[instance].datatype;
+      USBD_CtlSendData (pdev, p, MIN(req->wLength, CDC_LINE_CODING_SIZE));
+      break;
+    }
+
+    if ((req->bRequest == CDC_SET_CONTROL_LINE_STATE) && !req->wLength)
+    {
+      if (req->wValue == hcdc->LineState[instance])
+      {
+        break;
+      }
+#if (USBD_CDC_DTR_ABORT == 1)
+      if ((hcdc->LineState[instance] & CDC_LINE_STATE_DTR) &&
+          !(req->wValue & CDC_LINE_STATE_DTR))
+      {
+        /* Port closed: nobody will read what is in flight */
+        USBD_CDC_TxAbort(pdev, instance);
+      }
+#endif /* USBD_CDC_DTR_ABORT */
+      hcdc->LineState[instance] = req->wValue;
+      USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_LINE);
+    }
+#endif /* USBD_CDC_LINE_CACHE */
     if (req->wLength)
     {
       if (req->bmRequest & 0x80)
       {
-        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(ctxPointers[instance],
-			req->bRequest, (uint8_t *)hcdc->data, req->wLength);
-          USBD_CtlSendData (pdev, 
-                            (uint8_t *)hcdc->data,
-                            req->wLength);
+        /* A short answer ends the data stage early, which is allowed */
+        uint16_t len = MIN(req->wLength, sizeof(hcdc->data));
+
+        if (USBD_CDC_CTRL_IS_DEFERRED(((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->Ctx[instance],
+                                                                                        req->bRequest,
+                                                                                        (uint8_t *)hcdc->data,
+                                                                                        len)))
+        {
+          USBD_CDC_CTRL_DEFER(pdev);
+          break;
+        }
+        USBD_CtlSendData (pdev, 
+                          (uint8_t *)hcdc->data,
+                          len);
+      }
+      else if (req->wLength > sizeof(hcdc->data))
+      {
+        /* More data than the buffer takes: refuse the request */
+        USBD_CtlError(pdev, req);
+        return USBD_FAIL;
       }
       else
       {
@@ -395,10 +969,13 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
     }
     else
     {
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(ctxPointers[instance],
-	                                                req->bRequest,
-                                                        (uint8_t*)req,
-                                                        0);
+      if (USBD_CDC_CTRL_IS_DEFERRED(((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->Ctx[instance],
+                                                                                      req->bRequest,
+                                                                                      (uint8_t*)req,
+                                                                                      0)))
+      {
+        USBD_CDC_CTRL_DEFER(pdev);
+      }
     }
     break;
 
@@ -414,6 +991,54 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
     case USB_REQ_SET_INTERFACE :
       break;
     }
+    break;
+
+#if (USB_STATS_ENABLED == 1) || (USBD_CDC_LAT_HIST == 1)
+  case USB_REQ_TYPE_VENDOR:
+    switch (req->bRequest)
+    {
+#if (USB_STATS_ENABLED == 1)
+    /* Link statistics, see usb_stats.h */
+    case USB_STATS_REQ_GET:
+      USBD_CtlSendData (pdev,
+                        (uint8_t *)USB_Stats_Snapshot(),
+                        MIN(req->wLength, sizeof(USB_StatsTypeDef)));
+      break;
+
+    case USB_STATS_REQ_RESET:
+      USB_Stats_Reset();
+      break;
+#endif /* USB_STATS_ENABLED */
+
+#if (USBD_CDC_LAT_HIST == 1)
+    /* Latency histograms of the instance in wValue */
+    case USBD_CDC_LAT_REQ_GET:
+      if (req->wValue >= NUM_CDC_INSTANCES)
+      {
+        return USBD_FAIL;
+      }
+      USBD_CtlSendData (pdev,
+                        (uint8_t *)&hcdc->LatHist[req->wValue],
+                        MIN(req->wLength, sizeof(USBD_CDC_LatHistTypeDef)));
+      break;
+
+    case USBD_CDC_LAT_REQ_RESET:
+      if (USBD_CDC_ResetLatency(pdev, req->wValue) != USBD_OK)
+      {
+        return USBD_FAIL;
+      }
+      break;
+#endif /* USBD_CDC_LAT_HIST */
+
+    default:
+      return USBD_FAIL;
+    }
+    break;
+#else
+  case USB_REQ_TYPE_VENDOR:
+    /* not ours: stalled, or left to the next function of a composite */
+    return USBD_FAIL;
+#endif /* USB_STATS_ENABLED || USBD_CDC_LAT_HIST */
  
   default: 
     break;
@@ -428,20 +1053,121 @@ static uint8_t  USBD_CDC_Setup (USBD_HandleTypeDef *pdev,
   * @param  epnum: endpoint number
   * @retval status
   */
-static uint8_t  USBD_CDC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+static USB_CCM_FUNC uint8_t  USBD_CDC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  int instance = 0;
-  if (epnum & CDC2_EP_MASK) {
-	  instance = 1;
-  }
+  int instance = USBD_CDC_EpInstance[epnum & 0x0F];
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
   if(pdev->pClassData != NULL)
   {
+    if (epnum == (USBD_CDC_CmdEp[instance] & 0x0F))
+    {
+      /* Notification sent: follow up with whatever changed meanwhile */
+#if (USBD_CDC_URGENT == 1)
+      if (hcdc->UrgentSent[instance])
+      {
+        hcdc->UrgentSent[instance] = 0;
+        hcdc->UrgentTail[instance]++;
+      }
+#endif /* USBD_CDC_URGENT */
+      hcdc->NotifyState[instance] = 0;
+      USBD_CDC_NotifyKick(pdev, instance);
+      return USBD_OK;
+    }
+
+    if (hcdc->TxState[instance] == 0)
+    {
+      /* Completion of a transfer USBD_CDC_TxAbort dropped meanwhile */
+      return USBD_OK;
+    }
+
+#if (USBD_CDC_TX_SCHED == 1)
+    hcdc->TxHold[instance] = 0;
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+    if (hcdc->TxFromRing[instance])
+    {
+      /* Drop the chunk just sent and keep the endpoint busy with the next
+         one, if any */
+      hcdc->TxFromRing[instance] = 0;
+      hcdc->TxTail[instance] += hcdc->TxLength[instance];
+#if (USBD_CDC_LAT_HIST == 1)
+      USBD_CDC_LatPop(hcdc->TxMark[instance], hcdc->TxMarkHead[instance],
+                      &hcdc->TxMarkTail[instance], hcdc->TxTail[instance],
+                      hcdc->LatHist[instance].tx);
+#endif /* USBD_CDC_LAT_HIST */
+
+      if (USBD_CDC_TxRingKick(pdev, instance, 0))
+      {
+        USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_TX);
+        USB_PROF_BEGIN(prof_app);
+        ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TxComplete(hcdc->Ctx[instance]);
+        USB_PROF_END(USB_PROF_APP_TX_COMPLETE, epnum, prof_app);
+        return USBD_OK;
+      }
+    }
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+    if (hcdc->TxFromQueue[instance])
+    {
+      /* The buffer is the producer's again. Chain the next descriptor
+         unless the one just sent still owes a ZLP */
+      hcdc->TxFromQueue[instance] = 0;
+      USBD_CDC_TxQueueDone(hcdc, instance, USBD_OK);
+
+      if (!(hcdc->TxZlp[instance] && (hcdc->TxLength[instance] != 0) &&
+            ((hcdc->TxLength[instance] % USBD_CDC_InPacketSize(pdev)) == 0)) &&
+          USBD_CDC_TxQueueStart(pdev, instance))
+      {
+        return USBD_OK;
+      }
+    }
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+    /* Terminate a transfer that ended on a full packet, or the host will
+       wait for more data before completing it. Not when the next transfer
+       carries on with the same write: the host sees a single one */
+    if (hcdc->TxZlp[instance] && !hcdc->TxMore[instance] && (hcdc->TxLength[instance] != 0) &&
+        ((hcdc->TxLength[instance] % USBD_CDC_InPacketSize(pdev)) == 0))
+    {
+      hcdc->TxLength[instance] = 0;
+      USBD_LL_Transmit(pdev, epnum | 0x80, NULL, 0);
+      return USBD_OK;
+    }
       
+    hcdc->TxMore[instance] = 0;
     hcdc->TxState[instance] = 0;
+    USBD_CDC_LAT_TX_DONE(hcdc, instance);
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+    /* A write may have landed after the ring was found empty above and seen
+       the endpoint still busy: pick it up here */
+    if ((hcdc->TxHead[instance] != hcdc->TxTail[instance]) &&
+        USBD_CDC_TxClaim(hcdc, instance))
+    {
+      if (!USBD_CDC_TxRingKick(pdev, instance, 0))
+      {
+        hcdc->TxState[instance] = 0;
+      }
+    }
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+    /* Same for a descriptor queued while the endpoint was busy */
+    USBD_CDC_TxQueueKick(pdev, instance);
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_TX_SCHED == 1)
+    /* Instances this one held back need not wait for the next frame */
+    USBD_CDC_TxSchedResume(pdev);
+#endif /* USBD_CDC_TX_SCHED */
 
-      ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TxComplete(ctxPointers[instance]);
+    USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_TX);
+    USB_PROF_BEGIN(prof_app);
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TxComplete(hcdc->Ctx[instance]);
+    USB_PROF_END(USB_PROF_APP_TX_COMPLETE, epnum, prof_app);
 
     return USBD_OK;
   }
@@ -458,23 +1184,51 @@ static uint8_t  USBD_CDC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
   * @param  epnum: endpoint number
   * @retval status
   */
-static uint8_t  USBD_CDC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+static USB_CCM_FUNC uint8_t  USBD_CDC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  int instance = 0;
-  if (epnum & CDC2_EP_MASK) {
-	  instance = 1;
-  }
+  int instance = USBD_CDC_EpInstance[epnum & 0x0F];
 
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   
   /* Get the received data length */
   hcdc->RxLength[instance] = USBD_LL_GetRxDataSize (pdev, epnum);
+  USB_ENUMBENCH_MARK(USB_ENUMBENCH_OUT);
   
   /* USB data will be immediately processed, this allow next USB traffic being 
   NAKed till the end of the application Xfer */
   if(pdev->pClassData != NULL)
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(ctxPointers[instance], hcdc->RxBuffer[instance], &hcdc->RxLength[instance]);
+    /* Release the endpoint: whoever re-arms it claims it again */
+    hcdc->RxState[instance] = 0;
+#if (USBD_CDC_RX_RING_SIZE == 0)
+    USBD_CDC_LAT_RX_START(hcdc, instance);
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+    USBD_CDC_RxRingPut(pdev, instance);
+    return USBD_OK;
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_OS == 1)
+    if (USBD_CDC_OS_LAYER(pdev, instance) != NULL)
+    {
+      /* Keep the packet for USBD_CDC_BlockingRead, which re-arms the
+         endpoint once it has all been read */
+      if (hcdc->RxLength[instance] == 0)
+      {
+        USBD_CDC_ReceivePacket(pdev, instance);
+        return USBD_OK;
+      }
+      hcdc->RxOffset[instance] = 0;
+      hcdc->RxAvail[instance] = hcdc->RxLength[instance];
+      USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_RX);
+      return USBD_OK;
+    }
+#endif /* USBD_CDC_OS */
+
+    USB_PROF_BEGIN(prof_app);
+    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(hcdc->Ctx[instance], hcdc->RxXfer[instance], &hcdc->RxLength[instance]);
+    USB_PROF_END(USB_PROF_APP_RECEIVE, epnum, prof_app);
 
     return USBD_OK;
   }
@@ -498,58 +1252,191 @@ static uint8_t  USBD_CDC_EP0_RxReady (USBD_HandleTypeDef *pdev)
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
   int instance = hcdc->ctrlInst;
   
+#if (USBD_CDC_LINE_CACHE == 1)
+  if ((hcdc->CmdOpCode == CDC_SET_LINE_CODING) &&
+      (hcdc->CmdLength >= CDC_LINE_CODING_SIZE))
+  {
+    const uint8_t *p = (const uint8_t *)hcdc->data;
+    USBD_CDC_LineCodingTypeDef *lc = &hcdc->LineCoding[instance];
+    uint32_t bitrate = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+    if ((bitrate == lc->bitrate) && (p[4] == lc->format) &&
+        (p[5] == lc->paritytype) && (p[6] == lc->datatype))
+    {
+      /* the same again: nothing for the application */
+      hcdc->CmdOpCode = 0xFF;
+      return USBD_OK;
+    }
+    lc->bitrate = bitrate;
+    lc->format = p[4];
+    lc->paritytype = p[5];
+    lc->datatype = p[6];
+    USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_LINE);
+  }
+#endif /* USBD_CDC_LINE_CACHE */
+
   if((pdev->pUserData != NULL) && (hcdc->CmdOpCode != 0xFF))
   {
-    ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(ctxPointers[instance],
-	    					hcdc->CmdOpCode,
-                                                      (uint8_t *)hcdc->data,
-                                                      hcdc->CmdLength);
+    if (USBD_CDC_CTRL_IS_DEFERRED(((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Control(hcdc->Ctx[instance],
+                                                                                    hcdc->CmdOpCode,
+                                                                                    (uint8_t *)hcdc->data,
+                                                                                    hcdc->CmdLength)))
+    {
+      /* status stage held until the application completes the request */
+      USBD_CDC_CTRL_DEFER(pdev);
+    }
       hcdc->CmdOpCode = 0xFF; 
       
   }
   return USBD_OK;
 }
 
+#if (USB_PROF_ENABLED == 1)
 /**
-  * @brief  USBD_CDC_GetFSCfgDesc 
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_CDC_ProfSetup
+  *         USBD_CDC_Setup timed by the profiler
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
   */
-static uint8_t  *USBD_CDC_GetFSCfgDesc (uint16_t *length)
+static uint8_t  USBD_CDC_ProfSetup (USBD_HandleTypeDef *pdev, 
+                                    USBD_SetupReqTypedef *req)
 {
-  *length = sizeof (IADCDCTwoDescriptor);
-  return (uint8_t *) IADCDCTwoDescriptor;
+  uint8_t ret;
+  USB_PROF_BEGIN(prof_start);
+
+  ret = USBD_CDC_Setup(pdev, req);
+  USB_PROF_END(USB_PROF_CDC_SETUP, 0, prof_start);
+
+  return ret;
 }
 
 /**
-  * @brief  USBD_CDC_GetHSCfgDesc 
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_CDC_ProfDataIn
+  *         USBD_CDC_DataIn timed by the profiler
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
   */
-static uint8_t  *USBD_CDC_GetHSCfgDesc (uint16_t *length)
+static uint8_t  USBD_CDC_ProfDataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  *length = 0;
-  return NULL;
+  uint8_t ret;
+  USB_PROF_BEGIN(prof_start);
 
-  //*length = sizeof (USBD_CDC_CfgHSDesc);
-  //return USBD_CDC_CfgHSDesc;
+  ret = USBD_CDC_DataIn(pdev, epnum);
+  USB_PROF_END(USB_PROF_CDC_DATA_IN, epnum, prof_start);
+
+  return ret;
 }
 
 /**
-  * @brief  USBD_CDC_GetCfgDesc 
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
-  */
-static uint8_t  *USBD_CDC_GetOtherSpeedCfgDesc (uint16_t *length)
+  * @brief  USBD_CDC_ProfDataOut
+  *         USBD_CDC_DataOut timed by the profiler
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_CDC_ProfDataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t ret;
+  USB_PROF_BEGIN(prof_start);
+
+  ret = USBD_CDC_DataOut(pdev, epnum);
+  USB_PROF_END(USB_PROF_CDC_DATA_OUT, epnum, prof_start);
+
+  return ret;
+}
+#endif /* USB_PROF_ENABLED */
+
+#if (USBD_CDC_FAST_DISPATCH == 1)
+/**
+  * @brief  USBD_CDC_FastDataIn
+  *         Completion handler of the bulk IN endpoints, called by the PCD
+  *         interrupt without going through the core
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_CDC_FastDataIn (void *pdev, uint8_t epnum)
+{
+  return USBD_CDC_DATA_IN_CB((USBD_HandleTypeDef *)pdev, epnum);
+}
+
+/**
+  * @brief  USBD_CDC_FastDataOut
+  *         Completion handler of the bulk OUT endpoints, called by the PCD
+  *         interrupt without going through the core
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_CDC_FastDataOut (void *pdev, uint8_t epnum)
+{
+  return USBD_CDC_DATA_OUT_CB((USBD_HandleTypeDef *)pdev, epnum);
+}
+#endif /* USBD_CDC_FAST_DISPATCH */
+
+/**
+  * @brief  USBD_CDC_GetFSCfgDesc 
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_CDC_GetFSCfgDesc (uint16_t *length)
 {
+#if (USBD_CDC_GENERATED_DESC == 1)
+  *length = sizeof (USBD_CDC_CfgFSDesc);
+  return (uint8_t *) USBD_CDC_CfgFSDesc;
+#else
   *length = sizeof (IADCDCTwoDescriptor);
   return (uint8_t *) IADCDCTwoDescriptor;
+#endif /* USBD_CDC_GENERATED_DESC */
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_CDC_GetHSCfgDesc 
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_CDC_GetHSCfgDesc (uint16_t *length)
+{
+#if (USBD_CDC_GENERATED_DESC == 1)
+  *length = sizeof (USBD_CDC_CfgHSDesc);
+  return (uint8_t *) USBD_CDC_CfgHSDesc;
+#else
+  /* IADCDCTwoDescriptor only describes full speed */
+  *length = 0;
+  return NULL;
+#endif /* USBD_CDC_GENERATED_DESC */
+}
+
+/**
+  * @brief  USBD_CDC_GetCfgDesc 
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_CDC_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+#if (USBD_CDC_GENERATED_DESC == 1)
+  if ((USBD_CDC_Dev != NULL) && USBD_IS_HIGH_SPEED(USBD_CDC_Dev))
+  {
+    *length = sizeof (USBD_CDC_OtherSpeedFSDesc);
+    return (uint8_t *) USBD_CDC_OtherSpeedFSDesc;
+  }
+
+  *length = sizeof (USBD_CDC_OtherSpeedHSDesc);
+  return (uint8_t *) USBD_CDC_OtherSpeedHSDesc;
+#else
+  /* no high speed configuration to describe */
+  *length = 0;
+  return NULL;
+#endif /* USBD_CDC_GENERATED_DESC */
 }
 
 /**
@@ -563,6 +1450,7 @@ uint8_t  *USBD_CDC_GetDeviceQualifierDescriptor (uint16_t *length)
   *length = sizeof (USBD_CDC_DeviceQualifierDesc);
   return USBD_CDC_DeviceQualifierDesc;
 }
+#endif /* USBD_FS_ONLY */
 
 /**
 * @brief  USBD_CDC_RegisterInterface
@@ -578,6 +1466,12 @@ uint8_t  USBD_CDC_RegisterInterface  (USBD_HandleTypeDef   *pdev,
   if(fops != NULL)
   {
     pdev->pUserData= fops;
+#if (USBD_FS_ONLY == 0)
+    if ((USBD_CDC_Dev == NULL) || USBD_IS_HS_CAPABLE(pdev))
+    {
+      USBD_CDC_Dev = pdev;
+    }
+#endif /* USBD_FS_ONLY */
     ret = USBD_OK;    
   }
   
@@ -622,90 +1516,2123 @@ uint8_t  USBD_CDC_SetRxBuffer  (USBD_HandleTypeDef   *pdev,
 }
 
 /**
-  * @brief  USBD_CDC_DataOut
-  *         Data received on non-control Out endpoint
+  * @brief  USBD_CDC_TransmitPacket
+  *         Send the buffer set with USBD_CDC_SetTxBuffer if the IN endpoint
+  *         is idle. The endpoint is claimed atomically, but the buffer is
+  *         set apart: with several producers use USBD_CDC_TransmitBuffer.
   * @param  pdev: device instance
-  * @param  epnum: endpoint number
-  * @retval status
+  * @param  instance: CDC instance
+  * @retval status, USBD_BUSY while a transfer is in flight
   */
-uint8_t  USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, int instance)
+USB_CCM_FUNC uint8_t  USBD_CDC_TransmitPacket(USBD_HandleTypeDef *pdev, int instance)
 {      
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
- 
-  int ep = CDC_IN_EP;
 
-  if (instance) {
-	  ep = CDC2_IN_EP;
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return USBD_FAIL;
   }
 
-  if(pdev->pClassData != NULL)
+  if (!USBD_CDC_TxClaim(hcdc, instance))
   {
-    if(hcdc->TxState[instance] == 0)
-    {
-      /* Tx Transfer in progress */
-      hcdc->TxState[instance] = 1;
-      
-      /* Transmit next packet */
-      USBD_LL_Transmit(pdev,
-                       ep,
-                       hcdc->TxBuffer[instance],
-                       hcdc->TxLength[instance]);
+    USB_STATS_TX_BUSY(USBD_CDC_InEp[instance]);
+    USB_TRACE_BUSY(USBD_CDC_InEp[instance]);
+    return USBD_BUSY;
+  }
 
-      return USBD_OK;
-    }
-    else
-    {
-      return USBD_BUSY;
-    }
+  /* stamped once the endpoint is ours, not while a transfer is in flight */
+  USBD_CDC_LAT_TX_START(hcdc, instance);
+  USBD_CDC_TxStart(pdev, instance);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_TransmitBuffer
+  *         Claim the IN endpoint and send a buffer in one step. Any number
+  *         of tasks and interrupts may call it on the same instance: one
+  *         wins the endpoint, the others get USBD_BUSY and leave the
+  *         transfer in flight untouched. No interrupts are masked.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: data, untouched until TxComplete
+  * @param  length: number of bytes to send
+  * @retval status, USBD_BUSY while a transfer is in flight
+  */
+USB_CCM_FUNC uint8_t  USBD_CDC_TransmitBuffer(USBD_HandleTypeDef *pdev, int instance,
+                                              const uint8_t *pbuff, uint16_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return USBD_FAIL;
   }
-  else
+
+  if (!USBD_CDC_TxClaim(hcdc, instance))
+  {
+    USB_STATS_TX_BUSY(USBD_CDC_InEp[instance]);
+    USB_TRACE_BUSY(USBD_CDC_InEp[instance]);
+    return USBD_BUSY;
+  }
+
+  /* the endpoint is ours: nobody else writes these until the completion */
+  hcdc->TxBuffer[instance] = pbuff;
+  hcdc->TxLength[instance] = length;
+  USBD_CDC_LAT_TX_START(hcdc, instance);
+
+  USBD_CDC_TxStart(pdev, instance);
+  return USBD_OK;
+}
+
+#if (USBD_CDC_TX_VEC == 1)
+/**
+  * @brief  USBD_CDC_TransmitVec
+  *         Claim the IN endpoint and send consecutive segments as one
+  *         transfer, like USBD_CDC_TransmitBuffer. The packets are filled
+  *         from the segments in turn, so a frame kept as header, payload
+  *         and CRC in separate buffers needs no assembly copy.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  iov: segments, the array and the data untouched until TxComplete
+  * @param  iovcnt: number of segments
+  * @retval status, USBD_BUSY while a transfer is in flight
+  */
+uint8_t  USBD_CDC_TransmitVec(USBD_HandleTypeDef *pdev, int instance,
+                              const USBD_IovTypeDef *iov, uint32_t iovcnt)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t length = 0;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES) ||
+      ((iov == NULL) && (iovcnt != 0)))
   {
     return USBD_FAIL;
   }
+
+  for (uint32_t i = 0; i < iovcnt; i++)
+  {
+    length += iov[i].len;
+  }
+
+  if (!USBD_CDC_TxClaim(hcdc, instance))
+  {
+    USB_STATS_TX_BUSY(USBD_CDC_InEp[instance]);
+    USB_TRACE_BUSY(USBD_CDC_InEp[instance]);
+    return USBD_BUSY;
+  }
+
+  /* TxLength only drives the ZLP decision on completion */
+  hcdc->TxBuffer[instance] = NULL;
+  hcdc->TxLength[instance] = length;
+  USBD_CDC_LAT_TX_START(hcdc, instance);
+
+  USBD_CDC_TX_CHARGE(hcdc, instance, length);
+  USBD_LL_TransmitVec(pdev, USBD_CDC_InEp[instance], iov, iovcnt);
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  USBD_CDC_WakeCheck(pdev, instance, length);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+  return USBD_OK;
+}
+#endif /* USBD_CDC_TX_VEC */
+
+#if (USBD_CDC_ZERO_COPY_TX == 1)
+/**
+  * @brief  USBD_CDC_TxReservePMA
+  *         Claim the IN endpoint and reserve its free packet buffer, to be
+  *         filled in place with USBD_PMA_PutByte/PutHalf/Write and sent
+  *         with USBD_CDC_TxCommitPMA. The endpoint stays claimed until
+  *         then, so other producers get USBD_BUSY.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  w: writer to set up
+  * @retval room in the packet, 0 while a transfer is in flight
+  */
+uint16_t USBD_CDC_TxReservePMA(USBD_HandleTypeDef *pdev, int instance,
+                               USBD_PMAWriterTypeDef *w)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if (hcdc == NULL)
+  {
+    return 0;
+  }
+
+  if (!USBD_CDC_TxClaim(hcdc, instance))
+  {
+    USB_STATS_TX_BUSY(USBD_CDC_InEp[instance]);
+    USB_TRACE_BUSY(USBD_CDC_InEp[instance]);
+    return 0;
+  }
+
+  if (USBD_LL_TxReserve(pdev, USBD_CDC_InEp[instance], w) != USBD_OK)
+  {
+    hcdc->TxState[instance] = 0;
+    return 0;
+  }
+  USBD_CDC_LAT_TX_START(hcdc, instance);
+
+  return w->size;
 }
 
+/**
+  * @brief  USBD_CDC_TxCommitPMA
+  *         Send the packet of USBD_CDC_TxReservePMA. An empty packet
+  *         releases the endpoint without sending anything.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  w: writer of the reservation
+  * @retval status, USBD_FAIL if more than the packet was written: the
+  *         reservation then still holds
+  */
+uint8_t  USBD_CDC_TxCommitPMA(USBD_HandleTypeDef *pdev, int instance,
+                              USBD_PMAWriterTypeDef *w)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint16_t length = w->count;
+
+  if (hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (length == 0)
+  {
+#if (USBD_CDC_LAT_HIST == 1)
+    hcdc->TxStamped[instance] = 0;
+#endif /* USBD_CDC_LAT_HIST */
+    hcdc->TxState[instance] = 0;
+    return USBD_OK;
+  }
+
+  /* TxLength only drives the ZLP decision on completion */
+  hcdc->TxBuffer[instance] = NULL;
+  hcdc->TxLength[instance] = length;
+
+  if (USBD_LL_TxCommit(pdev, USBD_CDC_InEp[instance], w) != USBD_OK)
+  {
+    return USBD_FAIL;
+  }
+  USBD_CDC_TX_CHARGE(hcdc, instance, length);
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  USBD_CDC_WakeCheck(pdev, instance, length);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+  return USBD_OK;
+}
+#endif /* USBD_CDC_ZERO_COPY_TX */
 
 /**
-  * @brief  USBD_CDC_ReceivePacket
-  *         prepare OUT Endpoint for reception
+  * @brief  USBD_CDC_TxAbort
+  *         Drop the transmission of an instance: flush the IN endpoint,
+  *         empty the transmit ring and give the queued transfers back with
+  *         USBD_FAIL. TxComplete follows, so a buffer passed to
+  *         USBD_CDC_TransmitBuffer is free again, and the next transfer
+  *         starts right away. Safe from any context.
   * @param  pdev: device instance
+  * @param  instance: CDC instance
   * @retval status
   */
-uint8_t  USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, int instance)
-{      
+uint8_t  USBD_CDC_TxAbort(USBD_HandleTypeDef *pdev, int instance)
+{
   USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
-  int ep = CDC_OUT_EP;
+  uint32_t primask;
 
-  if (instance) {
-	  ep = CDC2_OUT_EP;
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return USBD_FAIL;
   }
-  
-  /* Suspend or Resume USB Out process */
-  if(pdev->pClassData != NULL)
+
+  /* Keep the IN completion and the SOF out until the state is consistent */
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  /* The flushed transfer is not called back, not even from a completion
+     already pending or queued: DataIn of the next one is its own */
+  USBD_LL_FlushEP(pdev, USBD_CDC_InEp[instance]);
+  hcdc->TxLength[instance] = 0;
+  hcdc->TxMore[instance] = 0;
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+  /* Only the writer moves the head; a write racing this survives */
+  hcdc->TxFromRing[instance] = 0;
+  hcdc->TxTail[instance] = hcdc->TxHead[instance];
+#if (USBD_CDC_TX_FLUSH_FRAMES > 0)
+  hcdc->TxAge[instance] = 0;
+#endif /* USBD_CDC_TX_FLUSH_FRAMES */
+#if (USBD_CDC_LAT_HIST == 1)
+  hcdc->TxMarkTail[instance] = hcdc->TxMarkHead[instance];
+#endif /* USBD_CDC_LAT_HIST */
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_LAT_HIST == 1)
+  hcdc->TxStamped[instance] = 0;
+#endif /* USBD_CDC_LAT_HIST */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+  hcdc->TxFromQueue[instance] = 0;
+  while (USBD_CDC_TxQueueDone(hcdc, instance, USBD_FAIL))
   {
-    if(pdev->dev_speed == USBD_SPEED_HIGH  ) 
-    {      
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-                             ep,
-                             hcdc->RxBuffer[instance],
-                             CDC_DATA_HS_OUT_PACKET_SIZE);
+  }
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+#if (USBD_CDC_TX_SCHED == 1)
+  hcdc->TxHold[instance] = 0;
+  hcdc->TxDeferred &= ~(1U << instance);
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  hcdc->TxWake &= ~(1U << instance);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+  hcdc->TxState[instance] = 0;
+  __set_PRIMASK(primask);
+
+  USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_TX);
+  ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->TxComplete(hcdc->Ctx[instance]);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_TxStart
+  *         Start the IN transfer of TxBuffer. The caller owns the endpoint.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval None
+  */
+static USB_CCM_FUNC void  USBD_CDC_TxStart (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  USBD_CDC_TX_CHARGE(hcdc, instance, hcdc->TxLength[instance]);
+  USBD_LL_Transmit(pdev,
+                   USBD_CDC_InEp[instance],
+                   hcdc->TxBuffer[instance],
+                   hcdc->TxLength[instance]);
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  USBD_CDC_WakeCheck(pdev, instance, hcdc->TxLength[instance]);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+}
+
+
+/**
+  * @brief  USBD_CDC_Claim
+  *         Take ownership of an endpoint if it is idle
+  * @param  state: busy flag of the endpoint
+  * @retval 1 if the caller now owns the endpoint, 0 if it was busy
+  */
+static uint8_t  USBD_CDC_Claim (__IO uint32_t *state)
+{
+  do
+  {
+    if (__LDREXW((uint32_t *)state) != 0)
+    {
+      __CLREX();
+      return 0;
     }
-    else
+  } while (__STREXW(1, (uint32_t *)state) != 0);
+
+  return 1;
+}
+
+/**
+  * @brief  USBD_CDC_TxClaim
+  *         Take ownership of the IN endpoint if it is idle. The IN
+  *         completion gives it back.
+  * @param  hcdc: CDC handle
+  * @param  instance: CDC instance
+  * @retval 1 if the caller now owns the endpoint, 0 if it was busy
+  */
+static uint8_t  USBD_CDC_TxClaim (USBD_CDC_HandleTypeDef *hcdc, int instance)
+{
+  return USBD_CDC_Claim(&hcdc->TxState[instance]);
+}
+
+/**
+  * @brief  USBD_CDC_RxClaim
+  *         Take ownership of the OUT endpoint to arm it, if it is not armed
+  *         already. The OUT completion gives it back.
+  * @param  hcdc: CDC handle
+  * @param  instance: CDC instance
+  * @retval 1 if the caller may arm the endpoint, 0 if it is armed
+  */
+static uint8_t  USBD_CDC_RxClaim (USBD_CDC_HandleTypeDef *hcdc, int instance)
+{
+  return USBD_CDC_Claim(&hcdc->RxState[instance]);
+}
+
+/**
+  * @brief  USBD_CDC_NotifyKick
+  *         Send the SERIAL_STATE notification of an instance if it changed
+  *         and the interrupt endpoint is idle. Updates made while a
+  *         notification is in flight are merged into the next one, so at
+  *         most one goes out per polling interval of the endpoint. Waiting
+  *         urgent messages go first.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval None
+  */
+static void  USBD_CDC_NotifyKick (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint8_t *notify = hcdc->Notify[instance];
+  uint32_t state;
+
+  for (;;)
+  {
+    if (!USBD_CDC_Claim(&hcdc->NotifyState[instance]))
     {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-                             ep,
-                             hcdc->RxBuffer[instance],
-                             CDC_DATA_FS_OUT_PACKET_SIZE);
+      /* the completion of the notification in flight calls back */
+      return;
+    }
+
+#if (USBD_CDC_URGENT == 1)
+    if (USBD_CDC_UrgentStart(pdev, instance))
+    {
+      return;
+    }
+#endif /* USBD_CDC_URGENT */
+
+    /* Take the state, keeping the levels and dropping the events */
+    do
+    {
+      state = __LDREXW((uint32_t *)&hcdc->SerialState[instance]);
+    } while (__STREXW(state & CDC_SERIAL_STATE_LEVELS,
+                      (uint32_t *)&hcdc->SerialState[instance]) != 0);
+
+    if (state & 0x10000)
+    {
+      break;
+    }
+
+    /* Nothing to send. Look again after letting go of the endpoint, in
+       case an update came in while it was held */
+    hcdc->NotifyState[instance] = 0;
+    if (!(hcdc->SerialState[instance] & 0x10000)
+#if (USBD_CDC_URGENT == 1)
+        && (hcdc->Urgent[instance][hcdc->UrgentTail[instance] & (USBD_CDC_URGENT_DEPTH - 1U)].seq !=
+            hcdc->UrgentTail[instance] + 1U)
+#endif /* USBD_CDC_URGENT */
+       )
+    {
+      return;
     }
-    return USBD_OK;
   }
-  else
+
+  notify[0] = 0xA1;
+  notify[1] = CDC_NOTIFY_SERIAL_STATE;
+  notify[2] = 0;
+  notify[3] = 0;
+  notify[4] = USBD_CDC_CtrlItf[instance];
+  notify[5] = 0;
+  notify[6] = 2;
+  notify[7] = 0;
+  notify[8] = LOBYTE(state);
+  notify[9] = HIBYTE(state);
+
+  USBD_LL_Transmit(pdev, USBD_CDC_CmdEp[instance], notify, CDC_NOTIFY_SERIAL_STATE_SIZE);
+}
+
+#if (USBD_CDC_URGENT == 1)
+/**
+  * @brief  USBD_CDC_UrgentStart
+  *         Send the oldest urgent message. The caller must own the
+  *         notification endpoint (NotifyState set).
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval 1 if it was started, 0 if none is waiting or the oldest one is
+  *         still being written
+  */
+static uint8_t  USBD_CDC_UrgentStart (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t t = hcdc->UrgentTail[instance];
+  USBD_CDC_UrgentTypeDef *msg = &hcdc->Urgent[instance][t & (USBD_CDC_URGENT_DEPTH - 1U)];
+
+  if (msg->seq != (t + 1U))
   {
-    return USBD_FAIL;
+    return 0;
   }
+  __DMB();
+
+  /* The slot stays claimed until the completion */
+  hcdc->UrgentSent[instance] = 1;
+  USBD_LL_Transmit(pdev, USBD_CDC_CmdEp[instance], msg->data, msg->length);
+  return 1;
+}
+#endif /* USBD_CDC_URGENT */
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+/**
+  * @brief  USBD_CDC_WakeCheck
+  *         Ask the host to resume the bus for data queued while it is
+  *         suspended or in L1. Latched: one request per suspend, re-armed
+  *         once the bus is seen running again.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance with the data
+  * @param  queued: bytes the instance has waiting
+  * @retval None
+  */
+static void  USBD_CDC_WakeCheck (USBD_HandleTypeDef *pdev, int instance,
+                                 uint32_t queued)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if ((pdev->dev_state != USBD_STATE_SUSPENDED) && !USBD_IS_L1(pdev))
+  {
+    hcdc->WakeLatch = 0;
+    return;
+  }
+
+#if (USBD_CDC_TX_RING_SIZE > 0) && (USBD_CDC_TX_FLUSH_FRAMES > 0)
+  /* a partial packet held on the ring must not wait out the flush timer */
+  hcdc->TxWake |= 1U << instance;
+#else
+  (void)instance;
+#endif
+
+  if ((queued >= USBD_CDC_WAKEUP_MIN_BYTES) && USBD_CDC_Claim(&hcdc->WakeLatch))
+  {
+    USBD_RemoteWakeup(pdev);
+  }
+}
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+/**
+  * @brief  USBD_CDC_SetSerialState
+  *         Report the UART state of an instance to the host with a
+  *         SERIAL_STATE notification. DCD and DSR are taken as levels;
+  *         break, ring, framing, parity and overrun are events that are
+  *         accumulated until sent.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  state: CDC_SERIAL_STATE_xxx bits
+  * @retval status
+  */
+uint8_t  USBD_CDC_SetSerialState(USBD_HandleTypeDef *pdev, int instance,
+                                 uint16_t state)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t old;
+  uint32_t update;
+
+  if (hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  do
+  {
+    old = __LDREXW((uint32_t *)&hcdc->SerialState[instance]);
+    update = (state & CDC_SERIAL_STATE_LEVELS) |
+             ((old | state) & 0xFFFF & ~CDC_SERIAL_STATE_LEVELS);
+    if ((update == (old & 0xFFFF)) && !(state & ~CDC_SERIAL_STATE_LEVELS))
+    {
+      /* same levels, no new event */
+      __CLREX();
+      return USBD_OK;
+    }
+  } while (__STREXW(update | 0x10000, (uint32_t *)&hcdc->SerialState[instance]) != 0);
+
+  USBD_CDC_NotifyKick(pdev, instance);
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  USBD_CDC_WakeCheck(pdev, instance, USBD_CDC_WAKEUP_MIN_BYTES);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+  return USBD_OK;
+}
+
+#if (USBD_CDC_URGENT == 1)
+/**
+  * @brief  USBD_CDC_SendUrgent
+  *         Queue a short message for the notification endpoint of an
+  *         instance. It goes out as a single packet on the next poll of the
+  *         host once the notification in flight, if any, and the urgent
+  *         messages queued before it are sent: one frame each, whatever the
+  *         bulk endpoints hold. Any number of tasks and interrupts may send
+  *         on the same instance, slots are claimed with LDREX/STREX.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  msg: payload, copied
+  * @param  length: bytes of payload, up to USBD_CDC_URGENT_MAX_SIZE
+  * @retval USBD_OK if queued, USBD_BUSY if USBD_CDC_URGENT_DEPTH messages
+  *         are waiting, USBD_FAIL if too long or the device is not
+  *         configured
+  */
+uint8_t  USBD_CDC_SendUrgent(USBD_HandleTypeDef *pdev, int instance,
+                             const uint8_t *msg, uint16_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  USBD_CDC_UrgentTypeDef *slot;
+  uint32_t t;
+  uint16_t i;
+
+  if ((hcdc == NULL) || (length > USBD_CDC_URGENT_MAX_SIZE))
+  {
+    return USBD_FAIL;
+  }
+
+  do
+  {
+    t = __LDREXW((uint32_t *)&hcdc->UrgentHead[instance]);
+    if ((t - hcdc->UrgentTail[instance]) >= USBD_CDC_URGENT_DEPTH)
+    {
+      __CLREX();
+      return USBD_BUSY;
+    }
+  } while (__STREXW(t + 1U, (uint32_t *)&hcdc->UrgentHead[instance]) != 0U);
+
+  slot = &hcdc->Urgent[instance][t & (USBD_CDC_URGENT_DEPTH - 1U)];
+  slot->data[0] = USBD_CDC_URGENT_REQ_TYPE;
+  slot->data[1] = USBD_CDC_NOTIFY_URGENT;
+  slot->data[2] = LOBYTE(t);
+  slot->data[3] = HIBYTE(t);
+  slot->data[4] = USBD_CDC_CtrlItf[instance];
+  slot->data[5] = 0;
+  slot->data[6] = LOBYTE(length);
+  slot->data[7] = HIBYTE(length);
+  for (i = 0; i < length; i++)
+  {
+    slot->data[USBD_CDC_URGENT_HDR_SIZE + i] = msg[i];
+  }
+  slot->length = USBD_CDC_URGENT_HDR_SIZE + length;
+
+  /* the message must be visible before its sequence number */
+  __DMB();
+  slot->seq = t + 1U;
+
+  USBD_CDC_NotifyKick(pdev, instance);
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  USBD_CDC_WakeCheck(pdev, instance, USBD_CDC_WAKEUP_MIN_BYTES);
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+  return USBD_OK;
+}
+#endif /* USBD_CDC_URGENT */
+
+/**
+  * @brief  USBD_CDC_SetTxZlp
+  *         Select whether transfers that are a multiple of the max packet
+  *         size get terminated with a zero length packet
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  enable: 1 to send ZLPs, 0 for none
+  * @retval status
+  */
+uint8_t  USBD_CDC_SetTxZlp  (USBD_HandleTypeDef   *pdev,
+                             int instance,
+                             uint8_t enable)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if(hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hcdc->TxZlp[instance] = enable ? 1 : 0;
+
+  return USBD_OK;
+}
+
+#if (USBD_CDC_LINE_CACHE == 1)
+/**
+  * @brief  USBD_CDC_GetLineCoding
+  *         Line coding of an instance, as last set by the host or
+  *         USBD_CDC_SetLineCoding
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  coding: filled in
+  * @retval status
+  */
+uint8_t  USBD_CDC_GetLineCoding(USBD_HandleTypeDef *pdev, int instance,
+                                USBD_CDC_LineCodingTypeDef *coding)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if(hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  *coding = hcdc->LineCoding[instance];
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_SetLineCoding
+  *         Set the line coding an instance reports to GET_LINE_CODING, for
+  *         a port that starts at another than the default. The Control
+  *         callback is not called. Reset by USBD_CDC_Init: call it from the
+  *         Init callback of the interface.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  coding: line coding
+  * @retval status
+  */
+uint8_t  USBD_CDC_SetLineCoding(USBD_HandleTypeDef *pdev, int instance,
+                                const USBD_CDC_LineCodingTypeDef *coding)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if(hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hcdc->LineCoding[instance] = *coding;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_GetLineState
+  *         DTR and RTS of an instance, as last set by the host
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval CDC_LINE_STATE_xxx bits, 0 while not configured
+  */
+uint16_t USBD_CDC_GetLineState(USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if(hcdc == NULL)
+  {
+    return 0;
+  }
+
+  return hcdc->LineState[instance];
+}
+#endif /* USBD_CDC_LINE_CACHE */
+
+#if (USBD_CDC_TX_SCHED == 1)
+/**
+  * @brief  USBD_CDC_SetTxSched
+  *         Set the share of the bus an instance gets for what it sends
+  *         from its transmit ring and queue. An instance is held back
+  *         while one with a higher priority has data to send, until that
+  *         one has spent its budget for the frame. The budget counts the
+  *         bytes of the transfers started in a (micro)frame; a transfer
+  *         that overruns it is charged to the frames that follow. All
+  *         instances start at priority 0 with no budget, that is with no
+  *         scheduling; set them again after each USBD_CDC_Init, from the
+  *         Init callback of the interface for example.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  priority: 0 is the highest
+  * @param  budget: bytes per frame, 0 for no limit
+  * @retval status
+  */
+uint8_t  USBD_CDC_SetTxSched(USBD_HandleTypeDef *pdev, int instance,
+                             uint8_t priority, uint16_t budget)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if(hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hcdc->TxPrio[instance] = priority;
+  hcdc->TxBudget[instance] = budget;
+
+  return USBD_OK;
+}
+#endif /* USBD_CDC_TX_SCHED */
+
+/**
+  * @brief  USBD_CDC_ReceivePacket
+  *         prepare OUT Endpoint for reception
+  * @note   Safe from any context: the endpoint is claimed atomically, so
+  *         it is armed once however many callers race.
+  * @param  pdev: device instance
+  * @retval status, USBD_BUSY if the endpoint is armed already
+  */
+uint8_t  USBD_CDC_ReceivePacket(USBD_HandleTypeDef *pdev, int instance)
+{      
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  int ep = USBD_CDC_OutEp[instance];
+  
+  /* Suspend or Resume USB Out process */
+  if(pdev->pClassData != NULL)
+  {
+#if (USBD_CDC_RX_RING_SIZE > 0)
+    (void)ep;
+    return USBD_CDC_RxRingArm(pdev, instance);
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+    if (!USBD_CDC_RxClaim(hcdc, instance))
+    {
+      return USBD_BUSY;
+    }
+    USBD_CDC_LAT_RX_DONE(hcdc, instance);
+
+    if(USBD_IS_HIGH_SPEED(pdev)) 
+    {      
+      hcdc->RxXfer[instance] = hcdc->RxBuffer[instance];
+
+      /* Prepare Out endpoint to receive next packet */
+      USBD_LL_PrepareReceive(pdev,
+                             ep,
+                             hcdc->RxXfer[instance],
+                             CDC_DATA_HS_OUT_PACKET_SIZE);
+    }
+    else
+    {
+#if (USBD_CDC_ZERO_COPY_RX == 1)
+      hcdc->RxXfer[instance] = NULL;
+#else
+      hcdc->RxXfer[instance] = hcdc->RxBuffer[instance];
+#endif /* USBD_CDC_ZERO_COPY_RX */
+
+      /* Prepare Out endpoint to receive next packet */
+      USBD_LL_PrepareReceive(pdev,
+                             ep,
+                             hcdc->RxXfer[instance],
+                             CDC_DATA_FS_OUT_PACKET_SIZE);
+    }
+    return USBD_OK;
+  }
+  else
+  {
+    return USBD_FAIL;
+  }
+}
+
+/**
+  * @brief  USBD_CDC_ReceiveBuffer
+  *         prepare OUT Endpoint for a multi packet reception straight into
+  *         pbuff. The Receive callback runs once, on a short packet or when
+  *         pbuff is full.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: reception buffer
+  * @param  length: size of pbuff
+  * @retval status
+  */
+uint8_t  USBD_CDC_ReceiveBuffer(USBD_HandleTypeDef *pdev, int instance,
+                                uint8_t *pbuff, uint16_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  int ep = USBD_CDC_OutEp[instance];
+
+  if((hcdc == NULL) || (pbuff == NULL))
+  {
+    return USBD_FAIL;
+  }
+
+  if (!USBD_CDC_RxClaim(hcdc, instance))
+  {
+    return USBD_BUSY;
+  }
+  USBD_CDC_LAT_RX_DONE(hcdc, instance);
+
+  hcdc->RxXfer[instance] = pbuff;
+
+  USBD_LL_PrepareReceive(pdev, ep, pbuff, length);
+
+  return USBD_OK;
+}
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+/**
+  * @brief  USBD_CDC_TxRingPublish
+  *         Move the head of the transmit ring past data just written and
+  *         start the IN endpoint if it is idle
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  head: head the data was written at
+  * @param  length: bytes written
+  * @retval None
+  */
+static void  USBD_CDC_TxRingPublish (USBD_HandleTypeDef *pdev, int instance,
+                                     uint32_t head, uint32_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+#if (USBD_CDC_LAT_HIST == 1)
+  if (length != 0)
+  {
+    USBD_CDC_LatPush(hcdc->TxMark[instance], &hcdc->TxMarkHead[instance],
+                     hcdc->TxMarkTail[instance], head + length);
+  }
+#endif /* USBD_CDC_LAT_HIST */
+
+  /* Publish the data before the new head */
+  __DMB();
+  hcdc->TxHead[instance] = head + length;
+
+  if ((length != 0) && USBD_CDC_TxClaim(hcdc, instance))
+  {
+    if (!USBD_CDC_TxRingKick(pdev, instance, 0))
+    {
+      hcdc->TxState[instance] = 0;
+    }
+  }
+
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  if (length != 0)
+  {
+    USBD_CDC_WakeCheck(pdev, instance, hcdc->TxHead[instance] - hcdc->TxTail[instance]);
+  }
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+}
+
+/**
+  * @brief  USBD_CDC_TxRingKick
+  *         Start sending the oldest contiguous chunk of the transmit ring.
+  *         The caller must own the IN endpoint (TxState set).
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  flush: send less than a full packet even if the flush timer
+  *         has not expired yet
+  * @retval 1 if a transfer was started, 0 if nothing was sent
+  */
+static uint8_t  USBD_CDC_TxRingKick (USBD_HandleTypeDef *pdev, int instance,
+                                     uint8_t flush)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t tail = hcdc->TxTail[instance];
+  uint32_t offset = tail & (USBD_CDC_TX_RING_SIZE - 1);
+  uint32_t length = hcdc->TxHead[instance] - tail;
+  uint32_t packet = USBD_CDC_InPacketSize(pdev);
+  int ep = USBD_CDC_InEp[instance];
+
+  if (length == 0)
+  {
+    return 0;
+  }
+
+#if (USBD_CDC_TX_SCHED == 1)
+  if (!USBD_CDC_TxSchedAdmit(hcdc, instance))
+  {
+    return 0;
+  }
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_FLUSH_FRAMES > 0)
+  if (!flush && (length < packet))
+  {
+    /* Let USBD_CDC_SOF send it once it has aged */
+    return 0;
+  }
+  hcdc->TxAge[instance] = 0;
+#else
+  (void)flush;
+#endif /* USBD_CDC_TX_FLUSH_FRAMES */
+
+  length = MIN(length, USBD_CDC_TX_RING_SIZE - offset);
+  length = MIN(length, packet);
+
+  hcdc->TxLength[instance] = length;
+  hcdc->TxFromRing[instance] = 1;
+
+  USBD_CDC_TX_CHARGE(hcdc, instance, length);
+  USBD_LL_Transmit(pdev, ep, &hcdc->TxRing[instance][offset], length);
+
+  return 1;
+}
+
+/**
+  * @brief  USBD_CDC_Write
+  *         Queue data on the transmit ring of an instance and start the IN
+  *         endpoint if it is idle. Single producer: call it from one thread
+  *         context per instance; no critical section is taken.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: data to send
+  * @param  length: number of bytes to send
+  * @retval number of bytes queued, less than length if the ring is full
+  */
+uint32_t USBD_CDC_Write(USBD_HandleTypeDef *pdev, int instance,
+                        const uint8_t *pbuff, uint32_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t head;
+  uint32_t offset;
+  uint32_t chunk;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return 0;
+  }
+
+  head = hcdc->TxHead[instance];
+  length = MIN(length, USBD_CDC_TX_RING_SIZE - (head - hcdc->TxTail[instance]));
+  offset = head & (USBD_CDC_TX_RING_SIZE - 1);
+  chunk = MIN(length, USBD_CDC_TX_RING_SIZE - offset);
+
+  memcpy(&hcdc->TxRing[instance][offset], pbuff, chunk);
+  memcpy(&hcdc->TxRing[instance][0], pbuff + chunk, length - chunk);
+
+  USBD_CDC_TxRingPublish(pdev, instance, head, length);
+
+  return length;
+}
+
+/**
+  * @brief  USBD_CDC_TxReserve
+  *         Get the free space at the head of the transmit ring, for the
+  *         producer to write into in place before USBD_CDC_TxCommit.
+  *         Single producer, like USBD_CDC_Write.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: set to the first free byte
+  * @retval number of contiguous bytes writable at pbuff
+  */
+uint32_t USBD_CDC_TxReserve(USBD_HandleTypeDef *pdev, int instance,
+                            uint8_t **pbuff)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t head;
+  uint32_t offset;
+
+  if (hcdc == NULL)
+  {
+    return 0;
+  }
+
+  head = hcdc->TxHead[instance];
+  offset = head & (USBD_CDC_TX_RING_SIZE - 1);
+  *pbuff = &hcdc->TxRing[instance][offset];
+
+  return MIN(USBD_CDC_TX_RING_SIZE - (head - hcdc->TxTail[instance]),
+             USBD_CDC_TX_RING_SIZE - offset);
+}
+
+/**
+  * @brief  USBD_CDC_TxCommit
+  *         Queue data written in place at the head of the transmit ring and
+  *         start the IN endpoint if it is idle
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  length: bytes written, at most what USBD_CDC_TxReserve returned
+  * @retval status
+  */
+uint8_t  USBD_CDC_TxCommit(USBD_HandleTypeDef *pdev, int instance,
+                           uint32_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t head;
+
+  if (hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  head = hcdc->TxHead[instance];
+  length = MIN(length, USBD_CDC_TX_RING_SIZE - (head - hcdc->TxTail[instance]));
+
+  USBD_CDC_TxRingPublish(pdev, instance, head, length);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_GetTxFree
+  *         Free space of the transmit ring, in one or two pieces
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval number of bytes USBD_CDC_Write would take now
+  */
+uint32_t USBD_CDC_GetTxFree(USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  return (hcdc == NULL) ? 0 :
+         USBD_CDC_TX_RING_SIZE - (hcdc->TxHead[instance] - hcdc->TxTail[instance]);
+}
+
+#if (USB_TIMESYNC_ENABLED == 1)
+/**
+  * @brief  USBD_CDC_WriteStamped
+  *         Queue a record behind its host time stamp, 4 bytes little
+  *         endian from USB_TimeSync_Stamp. All or nothing: a record cut
+  *         short would throw the host parser out of step. Single producer,
+  *         like USBD_CDC_Write.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  cycles: CYCCNT when the record was taken, DWT->CYCCNT for now
+  * @param  pbuff: record
+  * @param  length: record length
+  * @retval number of bytes queued with the stamp, 0 if the ring is full
+  */
+uint32_t USBD_CDC_WriteStamped(USBD_HandleTypeDef *pdev, int instance,
+                               uint32_t cycles, const uint8_t *pbuff,
+                               uint32_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t stamp;
+  uint8_t hdr[4];
+
+  if ((hcdc == NULL) ||
+      (USBD_CDC_TX_RING_SIZE - (hcdc->TxHead[instance] - hcdc->TxTail[instance]) < length + sizeof(hdr)))
+  {
+    return 0;
+  }
+
+  stamp = USB_TimeSync_Stamp(cycles);
+  hdr[0] = (uint8_t)stamp;
+  hdr[1] = (uint8_t)(stamp >> 8);
+  hdr[2] = (uint8_t)(stamp >> 16);
+  hdr[3] = (uint8_t)(stamp >> 24);
+
+  /* the room was checked and only this context adds to the ring */
+  return USBD_CDC_Write(pdev, instance, hdr, sizeof(hdr)) +
+         USBD_CDC_Write(pdev, instance, pbuff, length);
+}
+#endif /* USB_TIMESYNC_ENABLED */
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+#if (USBD_CDC_SOF_ENABLED == 1)
+/**
+  * @brief  USBD_CDC_SOF
+  *         Flush partial packets held on the transmit rings for
+  *         USBD_CDC_TX_FLUSH_FRAMES frames, and open a new frame of the
+  *         transmit scheduler
+  * @param  pdev: device instance
+  * @retval status
+  */
+static USB_CCM_FUNC uint8_t  USBD_CDC_SOF (USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  USB_PROF_BEGIN(prof_start);
+
+  if (hcdc == NULL)
+  {
+    return USBD_OK;
+  }
+
+#if (USBD_CDC_TX_SCHED == 1)
+  for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+    /* an overdraft carries over, so a transfer larger than the budget
+       still averages out to it */
+    hcdc->TxSpent[i] = (hcdc->TxSpent[i] > hcdc->TxBudget[i]) ?
+                       hcdc->TxSpent[i] - hcdc->TxBudget[i] : 0;
+
+    if ((hcdc->TxState[i] == 0) && !USBD_CDC_TxPending(hcdc, i))
+    {
+      hcdc->TxHold[i] = 0;
+    }
+    else if (hcdc->TxHold[i] < USBD_CDC_TX_SCHED_HOLD_FRAMES)
+    {
+      hcdc->TxHold[i]++;
+    }
+  }
+
+  USBD_CDC_TxSchedResume(pdev);
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_RING_SIZE > 0) && (USBD_CDC_TX_FLUSH_FRAMES > 0)
+#if (USBD_CDC_REMOTE_WAKEUP == 1)
+  /* data that woke the host goes out on the first frame after resume */
+  for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+    if ((hcdc->TxWake & (1U << i)) != 0U)
+    {
+      hcdc->TxAge[i] = USBD_CDC_TX_FLUSH_FRAMES;
+    }
+  }
+  hcdc->TxWake = 0;
+#endif /* USBD_CDC_REMOTE_WAKEUP */
+
+  for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+    if (hcdc->TxHead[i] == hcdc->TxTail[i])
+    {
+      hcdc->TxAge[i] = 0;
+    }
+    else if ((hcdc->TxState[i] == 0) &&
+             (++hcdc->TxAge[i] >= USBD_CDC_TX_FLUSH_FRAMES) &&
+             USBD_CDC_TxClaim(hcdc, i))
+    {
+      if (!USBD_CDC_TxRingKick(pdev, i, 1))
+      {
+        hcdc->TxState[i] = 0;
+      }
+    }
+  }
+#endif /* USBD_CDC_TX_RING_SIZE && USBD_CDC_TX_FLUSH_FRAMES */
+
+  USB_PROF_END(USB_PROF_CDC_SOF, 0, prof_start);
+
+  return USBD_OK;
+}
+#endif /* USBD_CDC_SOF_ENABLED */
+
+#if (USBD_CDC_TX_SCHED == 1)
+/**
+  * @brief  USBD_CDC_TxPending
+  *         Tell whether an instance has data on its transmit ring or queue
+  * @param  hcdc: CDC handle
+  * @param  instance: CDC instance
+  * @retval 1 if it has, 0 if not
+  */
+static USB_CCM_FUNC uint8_t  USBD_CDC_TxPending (USBD_CDC_HandleTypeDef *hcdc, int instance)
+{
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+  uint32_t t = hcdc->TxQTail[instance];
+
+  if (hcdc->TxQueue[instance][t & (USBD_CDC_TX_QUEUE_SIZE - 1U)].seq == (t + 1U))
+  {
+    return 1;
+  }
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+#if (USBD_CDC_TX_RING_SIZE > 0)
+  if (hcdc->TxHead[instance] != hcdc->TxTail[instance])
+  {
+    return 1;
+  }
+#endif /* USBD_CDC_TX_RING_SIZE */
+  (void)hcdc;
+  (void)instance;
+  return 0;
+}
+
+/**
+  * @brief  USBD_CDC_TxSchedAdmit
+  *         Decide whether an instance may start a transfer in this frame.
+  *         It may not once it has spent its budget, nor while an instance
+  *         of higher priority is sending or has data waiting and budget
+  *         left, unless that one has gone USBD_CDC_TX_SCHED_HOLD_FRAMES
+  *         frames without a completion. A refused instance is marked for
+  *         USBD_CDC_TxSchedResume.
+  * @param  hcdc: CDC handle
+  * @param  instance: CDC instance
+  * @retval 1 if it may, 0 if it has to wait
+  */
+static USB_CCM_FUNC uint8_t  USBD_CDC_TxSchedAdmit (USBD_CDC_HandleTypeDef *hcdc, int instance)
+{
+  uint8_t admit = 1;
+  uint32_t deferred;
+
+  if ((hcdc->TxBudget[instance] != 0) &&
+      (hcdc->TxSpent[instance] >= hcdc->TxBudget[instance]))
+  {
+    admit = 0;
+  }
+
+  for (int i = 0; admit && (i < NUM_CDC_INSTANCES); i++) {
+    if ((hcdc->TxPrio[i] < hcdc->TxPrio[instance]) &&
+        (hcdc->TxHold[i] < USBD_CDC_TX_SCHED_HOLD_FRAMES) &&
+        ((hcdc->TxBudget[i] == 0) || (hcdc->TxSpent[i] < hcdc->TxBudget[i])) &&
+        ((hcdc->TxState[i] != 0) || USBD_CDC_TxPending(hcdc, i)))
+    {
+      admit = 0;
+    }
+  }
+
+  if (!admit)
+  {
+    do
+    {
+      deferred = __LDREXW((uint32_t *)&hcdc->TxDeferred);
+    } while (__STREXW(deferred | (1U << instance), (uint32_t *)&hcdc->TxDeferred) != 0);
+  }
+
+  return admit;
+}
+
+/**
+  * @brief  USBD_CDC_TxSchedResume
+  *         Restart the instances the scheduler held back, highest
+  *         priority first. Those still not admitted are marked again.
+  * @param  pdev: device instance
+  * @retval None
+  */
+static USB_CCM_FUNC void  USBD_CDC_TxSchedResume (USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t deferred;
+  int next;
+
+  do
+  {
+    deferred = __LDREXW((uint32_t *)&hcdc->TxDeferred);
+  } while (__STREXW(0, (uint32_t *)&hcdc->TxDeferred) != 0);
+
+  while (deferred != 0U)
+  {
+    next = -1;
+    for (int i = 0; i < NUM_CDC_INSTANCES; i++) {
+      if ((deferred & (1U << i)) &&
+          ((next < 0) || (hcdc->TxPrio[i] < hcdc->TxPrio[next])))
+      {
+        next = i;
+      }
+    }
+    deferred &= ~(1U << next);
+
+#if (USBD_CDC_TX_RING_SIZE > 0)
+    if ((hcdc->TxHead[next] != hcdc->TxTail[next]) &&
+        USBD_CDC_TxClaim(hcdc, next))
+    {
+      if (!USBD_CDC_TxRingKick(pdev, next, 0))
+      {
+        hcdc->TxState[next] = 0;
+      }
+    }
+#endif /* USBD_CDC_TX_RING_SIZE */
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+    USBD_CDC_TxQueueKick(pdev, next);
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+  }
+}
+#endif /* USBD_CDC_TX_SCHED */
+
+#if (USBD_CDC_TX_QUEUE_SIZE > 0)
+/**
+  * @brief  USBD_CDC_TxEnqueue
+  *         Queue a buffer for sending in place and start the IN endpoint if
+  *         it is idle. Any number of tasks and interrupts may queue on the
+  *         same instance: descriptors are claimed with LDREX/STREX, no
+  *         critical section is taken. Transfers go out in claim order,
+  *         back to back from the IN completion.
+  * @note   The buffer must stay untouched until done is called, from the
+  *         USB interrupt, with the token. done may queue again.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: data to send
+  * @param  length: number of bytes to send, 0 for a ZLP
+  * @param  done: completion callback, may be NULL
+  * @param  token: passed to done
+  * @retval USBD_OK if queued, USBD_BUSY if the queue is full, USBD_FAIL if
+  *         the device is not configured
+  */
+uint8_t  USBD_CDC_TxEnqueue(USBD_HandleTypeDef *pdev, int instance,
+                            const uint8_t *pbuff, uint16_t length,
+                            USBD_CDC_TxDoneTypeDef done, void *token)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  USBD_CDC_TxDescTypeDef *desc;
+  uint32_t t;
+
+  if (hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  do
+  {
+    t = __LDREXW((uint32_t *)&hcdc->TxQHead[instance]);
+    if ((t - hcdc->TxQTail[instance]) >= USBD_CDC_TX_QUEUE_SIZE)
+    {
+      __CLREX();
+      USB_STATS_TX_BUSY(USBD_CDC_InEp[instance]);
+      return USBD_BUSY;
+    }
+  } while (__STREXW(t + 1U, (uint32_t *)&hcdc->TxQHead[instance]) != 0U);
+
+  desc = &hcdc->TxQueue[instance][t & (USBD_CDC_TX_QUEUE_SIZE - 1U)];
+  desc->pbuff = pbuff;
+  desc->length = length;
+  desc->done = done;
+  desc->token = token;
+
+  /* the descriptor must be visible before its sequence number */
+  __DMB();
+  desc->seq = t + 1U;
+
+  USBD_CDC_TxQueueKick(pdev, instance);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_TxQueueStart
+  *         Send the oldest queued descriptor. The caller must own the IN
+  *         endpoint (TxState set).
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval 1 if a transfer was started, 0 if the queue is empty or its
+  *         oldest descriptor is still being filled in
+  */
+static USB_CCM_FUNC uint8_t  USBD_CDC_TxQueueStart (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t t = hcdc->TxQTail[instance];
+  USBD_CDC_TxDescTypeDef *desc = &hcdc->TxQueue[instance][t & (USBD_CDC_TX_QUEUE_SIZE - 1U)];
+
+  if (desc->seq != (t + 1U))
+  {
+    return 0;
+  }
+  __DMB();
+
+#if (USBD_CDC_TX_SCHED == 1)
+  if (!USBD_CDC_TxSchedAdmit(hcdc, instance))
+  {
+    return 0;
+  }
+#endif /* USBD_CDC_TX_SCHED */
+
+  /* The descriptor stays claimed until its completion, see
+     USBD_CDC_TxQueueDone */
+  hcdc->TxBuffer[instance] = desc->pbuff;
+  hcdc->TxLength[instance] = desc->length;
+  hcdc->TxFromQueue[instance] = 1;
+
+  USBD_CDC_TxStart(pdev, instance);
+  return 1;
+}
+
+/**
+  * @brief  USBD_CDC_TxQueueDone
+  *         Release the oldest queued descriptor and call its completion
+  * @param  hcdc: CDC handle
+  * @param  instance: CDC instance
+  * @param  status: passed to the completion
+  * @retval 1 if a descriptor was released, 0 if there was none
+  */
+static USB_CCM_FUNC uint8_t  USBD_CDC_TxQueueDone (USBD_CDC_HandleTypeDef *hcdc, int instance,
+                                                   uint8_t status)
+{
+  uint32_t t = hcdc->TxQTail[instance];
+  USBD_CDC_TxDescTypeDef *desc = &hcdc->TxQueue[instance][t & (USBD_CDC_TX_QUEUE_SIZE - 1U)];
+  USBD_CDC_TxDoneTypeDef done;
+  void *token;
+
+  if (desc->seq != (t + 1U))
+  {
+    return 0;
+  }
+  __DMB();
+
+  done = desc->done;
+  token = desc->token;
+
+  /* release the descriptor before the callback, which may queue more */
+  hcdc->TxQTail[instance] = t + 1U;
+
+  if (done != NULL)
+  {
+    done(token, status);
+  }
+  return 1;
+}
+
+/**
+  * @brief  USBD_CDC_TxQueueKick
+  *         Start the queue if it has a descriptor ready and the IN endpoint
+  *         is idle. Whoever owns the endpoint when a descriptor is
+  *         published picks it up on completion, so nothing gets stuck.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval None
+  */
+static USB_CCM_FUNC void  USBD_CDC_TxQueueKick (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t t;
+
+  for (;;)
+  {
+    t = hcdc->TxQTail[instance];
+    if ((hcdc->TxQueue[instance][t & (USBD_CDC_TX_QUEUE_SIZE - 1U)].seq != (t + 1U)) ||
+        !USBD_CDC_TxClaim(hcdc, instance))
+    {
+      return;
+    }
+
+    if (USBD_CDC_TxQueueStart(pdev, instance))
+    {
+      return;
+    }
+
+    /* Another owner sent it between the check and the claim: let go and
+       look again, a producer may have failed to claim meanwhile */
+    hcdc->TxState[instance] = 0;
+
+#if (USBD_CDC_TX_SCHED == 1)
+    if (hcdc->TxDeferred & (1U << instance))
+    {
+      /* held back by the scheduler, USBD_CDC_TxSchedResume retries */
+      return;
+    }
+#endif /* USBD_CDC_TX_SCHED */
+  }
+}
+#endif /* USBD_CDC_TX_QUEUE_SIZE */
+
+/**
+  * @brief  USBD_CDC_ReadRxData
+  *         Copy out part of the last received packet in zero-copy mode
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  offset: first byte of the packet to copy
+  * @param  pbuff: destination buffer
+  * @param  length: maximum number of bytes to copy
+  * @retval number of bytes copied
+  */
+uint16_t USBD_CDC_ReadRxData(USBD_HandleTypeDef *pdev, int instance,
+                             uint16_t offset, uint8_t *pbuff, uint16_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  int ep = USBD_CDC_OutEp[instance];
+
+  if ((hcdc == NULL) || (offset >= hcdc->RxLength[instance]))
+  {
+    return 0;
+  }
+
+  length = MIN(length, hcdc->RxLength[instance] - offset);
+
+  if (USBD_LL_ReadRxData(pdev, ep, offset, pbuff, length) != USBD_OK)
+  {
+    return 0;
+  }
+
+  return length;
+}
+
+#if (USBD_CDC_ZERO_COPY_RX == 1)
+/**
+  * @brief  USBD_CDC_ReadRxSamples
+  *         Convert little endian 16-bit samples of the last received packet
+  *         straight into a q15 block in zero-copy mode, in one pass over
+  *         packet memory
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  offset: first byte of the packet to convert, must be even
+  * @param  pbuff: destination block
+  * @param  count: maximum number of samples to convert
+  * @param  gain: q15 gain, 32768 is unity
+  * @retval number of samples converted
+  */
+uint16_t USBD_CDC_ReadRxSamples(USBD_HandleTypeDef *pdev, int instance,
+                                uint16_t offset, int16_t *pbuff,
+                                uint16_t count, int32_t gain)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  int ep = USBD_CDC_OutEp[instance];
+
+  if ((hcdc == NULL) || (offset >= hcdc->RxLength[instance]))
+  {
+    return 0;
+  }
+
+  count = MIN(count, (hcdc->RxLength[instance] - offset) / 2);
+
+  if (USBD_LL_ReadRxSamples(pdev, ep, offset, pbuff, count, gain) != USBD_OK)
+  {
+    return 0;
+  }
+
+  return count;
+}
+
+/**
+  * @brief  USBD_CDC_ReadRxSamplesF32
+  *         Same as USBD_CDC_ReadRxSamples, into a float block
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  offset: first byte of the packet to convert, must be even
+  * @param  pbuff: destination block
+  * @param  count: maximum number of samples to convert
+  * @param  scale: factor applied to every sample
+  * @retval number of samples converted
+  */
+uint16_t USBD_CDC_ReadRxSamplesF32(USBD_HandleTypeDef *pdev, int instance,
+                                   uint16_t offset, float *pbuff,
+                                   uint16_t count, float scale)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  int ep = USBD_CDC_OutEp[instance];
+
+  if ((hcdc == NULL) || (offset >= hcdc->RxLength[instance]))
+  {
+    return 0;
+  }
+
+  count = MIN(count, (hcdc->RxLength[instance] - offset) / 2);
+
+  if (USBD_LL_ReadRxSamplesF32(pdev, ep, offset, pbuff, count, scale) != USBD_OK)
+  {
+    return 0;
+  }
+
+  return count;
+}
+#endif /* USBD_CDC_ZERO_COPY_RX */
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+/**
+  * @brief  USBD_CDC_RxRingArm
+  *         Arm the OUT endpoint at the head of the receive ring if a whole
+  *         packet still fits, or leave it NAKing until the consumer
+  *         releases data
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval USBD_OK if armed, USBD_BUSY if the ring is full
+  */
+static uint8_t  USBD_CDC_RxRingArm (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t head = hcdc->RxHead[instance];
+  uint32_t packet = USBD_IS_HIGH_SPEED(pdev) ?
+                    CDC_DATA_HS_OUT_PACKET_SIZE : CDC_DATA_FS_OUT_PACKET_SIZE;
+
+  packet = MIN(packet, USBD_CDC_RX_RING_SLACK);
+
+  /* Armed already: by the completion, or by a reader freeing space */
+  if (!USBD_CDC_RxClaim(hcdc, instance))
+  {
+    return USBD_BUSY;
+  }
+
+  if ((USBD_CDC_RX_RING_SIZE - (head - hcdc->RxTail[instance])) < packet)
+  {
+    hcdc->RxStalled[instance] = 1;
+    hcdc->RxState[instance] = 0;
+    return USBD_BUSY;
+  }
+
+  /* A packet starting near the end runs into the slack, see
+     USBD_CDC_RxRingPut */
+  hcdc->RxXfer[instance] = &hcdc->RxRing[instance][head & (USBD_CDC_RX_RING_SIZE - 1)];
+
+  USBD_LL_PrepareReceive(pdev,
+                         USBD_CDC_OutEp[instance],
+                         hcdc->RxXfer[instance],
+                         packet);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_RxRingPut
+  *         Commit the packet just received at the head of the receive ring,
+  *         re-arm and notify the application
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval None
+  */
+static void  USBD_CDC_RxRingPut (USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t head = hcdc->RxHead[instance];
+  uint32_t offset = head & (USBD_CDC_RX_RING_SIZE - 1);
+  uint32_t length = hcdc->RxLength[instance];
+  uint32_t fill;
+
+  if ((offset + length) > USBD_CDC_RX_RING_SIZE)
+  {
+    /* Fold what landed in the slack back to the start of the ring, which
+       the arming check left free */
+    memcpy(&hcdc->RxRing[instance][0],
+           &hcdc->RxRing[instance][USBD_CDC_RX_RING_SIZE],
+           offset + length - USBD_CDC_RX_RING_SIZE);
+  }
+
+#if (USBD_CDC_LAT_HIST == 1)
+  if (length != 0)
+  {
+    USBD_CDC_LatPush(hcdc->RxMark[instance], &hcdc->RxMarkHead[instance],
+                     hcdc->RxMarkTail[instance], head + length);
+  }
+#endif /* USBD_CDC_LAT_HIST */
+
+  /* Publish the data before the new head */
+  __DMB();
+  hcdc->RxHead[instance] = head + length;
+
+  fill = head + length - hcdc->RxTail[instance];
+  if (fill > hcdc->RxHighWater[instance])
+  {
+    hcdc->RxHighWater[instance] = fill;
+  }
+
+  USBD_CDC_RxRingArm(pdev, instance);
+
+  if (length == 0)
+  {
+    return;
+  }
+
+#if (USBD_CDC_OS == 1)
+  if (USBD_CDC_OS_LAYER(pdev, instance) != NULL)
+  {
+    USBD_CDC_OS_SIGNAL(pdev, instance, USBD_CDC_OS_EVT_RX);
+    return;
+  }
+#endif /* USBD_CDC_OS */
+
+  USB_PROF_BEGIN(prof_app);
+  ((USBD_CDC_ItfTypeDef *)pdev->pUserData)->Receive(hcdc->Ctx[instance], NULL, &length);
+  USB_PROF_END(USB_PROF_APP_RECEIVE, USBD_CDC_OutEp[instance], prof_app);
+}
+
+/**
+  * @brief  USBD_CDC_RxPeek
+  *         Look at the oldest received data without taking it off the ring
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: set to the first unread byte
+  * @retval number of contiguous bytes readable at pbuff
+  */
+uint32_t USBD_CDC_RxPeek(USBD_HandleTypeDef *pdev, int instance,
+                         const uint8_t **pbuff)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t tail;
+  uint32_t offset;
+
+  if (hcdc == NULL)
+  {
+    return 0;
+  }
+
+  tail = hcdc->RxTail[instance];
+  offset = tail & (USBD_CDC_RX_RING_SIZE - 1);
+  *pbuff = &hcdc->RxRing[instance][offset];
+
+  return MIN(hcdc->RxHead[instance] - tail, USBD_CDC_RX_RING_SIZE - offset);
+}
+
+/**
+  * @brief  USBD_CDC_RxRelease
+  *         Drop data the consumer is done with, and resume reception if the
+  *         ring had filled up. Single consumer per instance.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  length: number of bytes to drop
+  * @retval status
+  */
+uint8_t  USBD_CDC_RxRelease(USBD_HandleTypeDef *pdev, int instance,
+                            uint32_t length)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t tail;
+
+  if (hcdc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  tail = hcdc->RxTail[instance];
+  length = MIN(length, hcdc->RxHead[instance] - tail);
+
+  /* Done reading before the space is handed back */
+  __DMB();
+  hcdc->RxTail[instance] = tail + length;
+#if (USBD_CDC_LAT_HIST == 1)
+  USBD_CDC_LatPop(hcdc->RxMark[instance], hcdc->RxMarkHead[instance],
+                  &hcdc->RxMarkTail[instance], tail + length,
+                  hcdc->LatHist[instance].rx);
+#endif /* USBD_CDC_LAT_HIST */
+
+  /* The endpoint is not armed while stalled, so the completion cannot
+     race this */
+  if (hcdc->RxStalled[instance])
+  {
+    hcdc->RxStalled[instance] = 0;
+    USBD_CDC_RxRingArm(pdev, instance);
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_Read
+  *         Copy received data out of the ring and release it
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  pbuff: destination buffer
+  * @param  length: size of pbuff
+  * @retval number of bytes copied
+  */
+uint32_t USBD_CDC_Read(USBD_HandleTypeDef *pdev, int instance,
+                       uint8_t *pbuff, uint32_t length)
+{
+  const uint8_t *src;
+  uint32_t done = 0;
+  uint32_t chunk;
+
+  /* At most two contiguous pieces */
+  while (done < length)
+  {
+    chunk = MIN(USBD_CDC_RxPeek(pdev, instance, &src), length - done);
+    if (chunk == 0)
+    {
+      break;
+    }
+    memcpy(pbuff + done, src, chunk);
+    USBD_CDC_RxRelease(pdev, instance, chunk);
+    done += chunk;
+  }
+
+  return done;
+}
+
+/**
+  * @brief  USBD_CDC_GetRxCount
+  *         Received data on the ring, in one or two pieces
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval number of unread bytes
+  */
+uint32_t USBD_CDC_GetRxCount(USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  return (hcdc == NULL) ? 0 : hcdc->RxHead[instance] - hcdc->RxTail[instance];
+}
+
+/**
+  * @brief  USBD_CDC_GetRxHighWater
+  *         Most bytes the receive ring has held since the class started
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval high-water mark in bytes
+  */
+uint32_t USBD_CDC_GetRxHighWater(USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  return (hcdc == NULL) ? 0 : hcdc->RxHighWater[instance];
+}
+#endif /* USBD_CDC_RX_RING_SIZE */
+
+#if (USBD_CDC_OS == 1)
+/**
+  * @brief  USBD_CDC_OsSignal
+  *         Wake the task waiting on an instance, if it has an OS layer
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  events: USBD_CDC_OS_EVT_xxx
+  * @retval None
+  */
+static void  USBD_CDC_OsSignal (USBD_HandleTypeDef *pdev, int instance,
+                                uint32_t events)
+{
+  const USBD_CDC_OsTypeDef *os = USBD_CDC_OS_LAYER(pdev, instance);
+
+  if (os != NULL)
+  {
+    os->Signal(instance, events);
+  }
+}
+
+/**
+  * @brief  USBD_CDC_OsWait
+  *         Sleep until one of the events is signalled, and take the time
+  *         spent off the timeout
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  events: USBD_CDC_OS_EVT_xxx
+  * @param  timeout: ticks left, updated
+  * @retval 1 when woken up, 0 on timeout
+  */
+static uint8_t  USBD_CDC_OsWait (USBD_HandleTypeDef *pdev, int instance,
+                                 uint32_t events, uint32_t *timeout)
+{
+  const USBD_CDC_OsTypeDef *os = USBD_CDC_OS_LAYER(pdev, instance);
+  uint32_t start = 0;
+  uint32_t elapsed;
+
+  if (os->GetTick != NULL)
+  {
+    start = os->GetTick();
+  }
+
+  if (os->Wait(instance, events, *timeout) == 0)
+  {
+    return 0;
+  }
+
+  if ((os->GetTick != NULL) && (*timeout != USBD_CDC_OS_WAIT_FOREVER))
+  {
+    elapsed = os->GetTick() - start;
+    *timeout = (elapsed < *timeout) ? (*timeout - elapsed) : 0;
+  }
+
+  return 1;
+}
+
+/**
+  * @brief  USBD_CDC_RegisterOs
+  *         Attach an OS layer to an instance, or detach it with NULL. From
+  *         then on received packets go to USBD_CDC_BlockingRead rather than
+  *         the Receive callback.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  os: OS layer
+  * @retval status
+  */
+uint8_t  USBD_CDC_RegisterOs (USBD_HandleTypeDef *pdev, int instance,
+                              const USBD_CDC_OsTypeDef *os)
+{
+  if ((instance < 0) || (instance >= NUM_CDC_INSTANCES) ||
+      (USBD_CDC_DEV_INDEX(pdev) >= USBD_CDC_MAX_DEVICES) ||
+      ((os != NULL) && ((os->Signal == NULL) || (os->Wait == NULL))))
+  {
+    return USBD_FAIL;
+  }
+
+  USBD_CDC_OS_LAYER(pdev, instance) = os;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_BlockingRead
+  *         Wait for received data and copy out up to length bytes. One
+  *         reader task per instance.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance, with an OS layer
+  * @param  pbuff: destination buffer
+  * @param  length: size of pbuff
+  * @param  timeout: ticks to wait, USBD_CDC_OS_WAIT_FOREVER for no limit
+  * @retval number of bytes copied, 0 on timeout
+  */
+uint32_t USBD_CDC_BlockingRead (USBD_HandleTypeDef *pdev, int instance,
+                                uint8_t *pbuff, uint32_t length,
+                                uint32_t timeout)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES) ||
+      (USBD_CDC_DEV_INDEX(pdev) >= USBD_CDC_MAX_DEVICES) ||
+      (USBD_CDC_OS_LAYER(pdev, instance) == NULL) || (length == 0))
+  {
+    return 0;
+  }
+
+#if (USBD_CDC_RX_RING_SIZE > 0)
+  while (hcdc->RxHead[instance] == hcdc->RxTail[instance])
+  {
+    if (!USBD_CDC_OsWait(pdev, instance, USBD_CDC_OS_EVT_RX, &timeout))
+    {
+      return 0;
+    }
+  }
+
+  return USBD_CDC_Read(pdev, instance, pbuff, length);
+#else
+  while (hcdc->RxAvail[instance] == 0)
+  {
+    if (!USBD_CDC_OsWait(pdev, instance, USBD_CDC_OS_EVT_RX, &timeout))
+    {
+      return 0;
+    }
+  }
+
+  /* The endpoint stays NAKed while data is left, nothing else touches the
+     packet until it is re-armed below */
+  uint32_t offset = hcdc->RxOffset[instance];
+  length = MIN(length, hcdc->RxAvail[instance]);
+
+  if (hcdc->RxXfer[instance] == NULL)
+  {
+    length = USBD_CDC_ReadRxData(pdev, instance, offset, pbuff, length);
+  }
+  else
+  {
+    memcpy(pbuff, hcdc->RxXfer[instance] + offset, length);
+  }
+
+  hcdc->RxOffset[instance] = offset + length;
+  hcdc->RxAvail[instance] -= length;
+
+  if (hcdc->RxAvail[instance] == 0)
+  {
+    USBD_CDC_ReceivePacket(pdev, instance);
+  }
+
+  return length;
+#endif /* USBD_CDC_RX_RING_SIZE */
+}
+
+/**
+  * @brief  USBD_CDC_BlockingWrite
+  *         Send length bytes, sleeping while the IN endpoint is busy. One
+  *         writer task per instance. With the transmit ring the data is
+  *         copied and may still be in flight on return; without it the
+  *         call returns once pbuff has been sent.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance, with an OS layer
+  * @param  pbuff: data to send
+  * @param  length: number of bytes to send
+  * @param  timeout: ticks to wait, USBD_CDC_OS_WAIT_FOREVER for no limit
+  * @retval USBD_OK when all was sent or queued, USBD_BUSY on timeout.
+  *         Without the ring, a timeout while pbuff is being sent returns
+  *         USBD_FAIL: pbuff must then stay valid until the instance
+  *         signals USBD_CDC_OS_EVT_TX.
+  */
+uint8_t  USBD_CDC_BlockingWrite (USBD_HandleTypeDef *pdev, int instance,
+                                 const uint8_t *pbuff, uint32_t length,
+                                 uint32_t timeout)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+  uint32_t chunk;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES) ||
+      (USBD_CDC_DEV_INDEX(pdev) >= USBD_CDC_MAX_DEVICES) ||
+      (USBD_CDC_OS_LAYER(pdev, instance) == NULL))
+  {
+    return USBD_FAIL;
+  }
+
+  while (length != 0)
+  {
+#if (USBD_CDC_TX_RING_SIZE > 0)
+    chunk = USBD_CDC_Write(pdev, instance, pbuff, length);
+    if (chunk == 0)
+    {
+      if (!USBD_CDC_OsWait(pdev, instance, USBD_CDC_OS_EVT_TX, &timeout))
+      {
+        return USBD_BUSY;
+      }
+      continue;
+    }
+#else
+    while (hcdc->TxState[instance] != 0)
+    {
+      if (!USBD_CDC_OsWait(pdev, instance, USBD_CDC_OS_EVT_TX, &timeout))
+      {
+        return USBD_BUSY;
+      }
+    }
+
+    /* Whole packets per chunk, so only the last one can end short; the
+       others go without a ZLP, the host gets the write as one transfer */
+    chunk = MIN(length, 0x4000U);
+    USBD_CDC_SetTxBuffer(pdev, instance, pbuff, chunk);
+    hcdc->TxMore[instance] = (chunk < length) ? 1 : 0;
+    if (USBD_CDC_TransmitPacket(pdev, instance) != USBD_OK)
+    {
+      hcdc->TxMore[instance] = 0;
+      continue;
+    }
+
+    while (hcdc->TxState[instance] != 0)
+    {
+      if (!USBD_CDC_OsWait(pdev, instance, USBD_CDC_OS_EVT_TX, &timeout))
+      {
+        return USBD_FAIL;
+      }
+    }
+#endif /* USBD_CDC_TX_RING_SIZE */
+
+    pbuff += chunk;
+    length -= chunk;
+  }
+
+  return USBD_OK;
+}
+#endif /* USBD_CDC_OS */
+
+#if (USBD_CDC_LAT_HIST == 1)
+/**
+  * @brief  USBD_CDC_LatRecord
+  *         Count a latency in its power of two bucket
+  * @param  hist: histogram
+  * @param  stamp: DWT->CYCCNT at the start
+  * @retval None
+  */
+static USB_CCM_FUNC void  USBD_CDC_LatRecord (uint32_t *hist, uint32_t stamp)
+{
+  uint32_t cycles = DWT->CYCCNT - stamp;
+  uint32_t bucket = (cycles == 0) ? 0 : 32 - __CLZ(cycles);
+
+  hist[MIN(bucket, USBD_CDC_LAT_BUCKETS - 1)]++;
+}
+
+#if (USBD_CDC_TX_RING_SIZE > 0) || (USBD_CDC_RX_RING_SIZE > 0)
+/**
+  * @brief  USBD_CDC_LatPush
+  *         Time data just put on a ring. Producer side of the marks, run
+  *         before the ring head moves past the data.
+  * @param  mark: marks of the ring
+  * @param  head: head of the marks
+  * @param  tail: tail of the marks
+  * @param  end: ring index past the data
+  * @retval None
+  */
+static void  USBD_CDC_LatPush (USBD_CDC_LatMarkTypeDef *mark, __IO uint32_t *head,
+                               uint32_t tail, uint32_t end)
+{
+  USBD_CDC_LatMarkTypeDef *m;
+
+  if ((*head - tail) >= USBD_CDC_LAT_MARKS)
+  {
+    /* too many in flight: this one goes untimed */
+    return;
+  }
+
+  m = &mark[*head & (USBD_CDC_LAT_MARKS - 1)];
+  m->end = end;
+  m->stamp = DWT->CYCCNT;
+
+  /* Publish the mark before the new head */
+  __DMB();
+  *head += 1;
+}
+
+/**
+  * @brief  USBD_CDC_LatPop
+  *         Count the marks of the data a ring tail just moved past.
+  *         Consumer side of the marks.
+  * @param  mark: marks of the ring
+  * @param  head: head of the marks
+  * @param  tail: tail of the marks
+  * @param  done: new tail of the ring
+  * @param  hist: histogram
+  * @retval None
+  */
+static USB_CCM_FUNC void  USBD_CDC_LatPop (USBD_CDC_LatMarkTypeDef *mark, uint32_t head,
+                                           __IO uint32_t *tail, uint32_t done, uint32_t *hist)
+{
+  uint32_t t = *tail;
+
+  while ((t != head) &&
+         ((int32_t)(done - mark[t & (USBD_CDC_LAT_MARKS - 1)].end) >= 0))
+  {
+    USBD_CDC_LatRecord(hist, mark[t & (USBD_CDC_LAT_MARKS - 1)].stamp);
+    t++;
+  }
+  *tail = t;
+}
+#endif /* USBD_CDC_TX_RING_SIZE || USBD_CDC_RX_RING_SIZE */
+
+/**
+  * @brief  USBD_CDC_GetLatency
+  *         Latency histograms of an instance. They keep counting while read.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval histograms, NULL before SET_CONFIGURATION
+  */
+const USBD_CDC_LatHistTypeDef *USBD_CDC_GetLatency(USBD_HandleTypeDef *pdev,
+                                                   int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return NULL;
+  }
+  return &hcdc->LatHist[instance];
+}
+
+/**
+  * @brief  USBD_CDC_ResetLatency
+  *         Clear the latency histograms of an instance. A count landing
+  *         from the USB interrupt while they are cleared may survive.
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @retval status
+  */
+uint8_t  USBD_CDC_ResetLatency(USBD_HandleTypeDef *pdev, int instance)
+{
+  USBD_CDC_HandleTypeDef   *hcdc = (USBD_CDC_HandleTypeDef*) pdev->pClassData;
+
+  if ((hcdc == NULL) || (instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return USBD_FAIL;
+  }
+  memset(&hcdc->LatHist[instance], 0, sizeof(hcdc->LatHist[instance]));
+  return USBD_OK;
 }
+#endif /* USBD_CDC_LAT_HIST */
 /**
   * @}
   */ 
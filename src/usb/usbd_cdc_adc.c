@@ -0,0 +1,343 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_adc.c
+  * @brief   Multi-channel ADC streaming on top of the CDC class, see
+  *          usbd_cdc_adc.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_adc.h"
+
+#if (USBD_CDC_ADC_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_adc
+  * @{
+  */
+
+/** @defgroup usbd_cdc_adc_Private_Defines
+  * @{
+  */
+/* Flags of a channel in the DMA ISR / IFCR registers */
+#define USBD_CDC_ADC_DMA_FLAGS(ch, f)               ((uint32_t)(f) << (4U * ((ch) - 1U)))
+
+/* Highest channel number of the F3 ADCs */
+#define USBD_CDC_ADC_MAX_CHANNEL_NUM                18U
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_adc_Private_FunctionPrototypes
+  * @{
+  */
+static void USBD_CDC_Adc_Block(USBD_CDC_AdcTypeDef *adc, uint32_t half);
+static void USBD_CDC_Adc_Done0(void *token, uint8_t status);
+static void USBD_CDC_Adc_Done1(void *token, uint8_t status);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_adc_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up an engine: calibrate and enable the ADC, program its
+  *         sequence and trigger. From thread context, with the clocks on.
+  * @param  adc: engine state, must stay valid while the device runs
+  * @param  pdev: device instance
+  * @param  instance: CDC instance the samples go to
+  * @param  cfg: ADC, DMA channel and timer of the engine
+  * @retval USBD_OK, USBD_FAIL for an invalid instance or configuration
+  */
+uint8_t USBD_CDC_Adc_Init(USBD_CDC_AdcTypeDef *adc, USBD_HandleTypeDef *pdev,
+                          int instance, const USBD_CDC_AdcConfigTypeDef *cfg)
+{
+  ADC_TypeDef *regs = cfg->Instance;
+  __IO uint32_t *sqr;
+  uint32_t smpr1 = 0U;
+  uint32_t smpr2 = 0U;
+  uint32_t sq[4] = { 0U, 0U, 0U, 0U };
+  uint32_t ch;
+  uint32_t i;
+  uint32_t j;
+
+  if ((instance < 0) || (instance >= NUM_CDC_INSTANCES) ||
+      (cfg->NumChannels == 0U) || (cfg->NumChannels > USBD_CDC_ADC_MAX_CHANNELS) ||
+      (cfg->DmaChNum < 1U) || (cfg->DmaChNum > 7U))
+  {
+    return USBD_FAIL;
+  }
+
+  memset(adc, 0, sizeof(*adc));
+  adc->cfg = cfg;
+  adc->pdev = pdev;
+  adc->instance = instance;
+  adc->half_len = (uint16_t)((USBD_CDC_ADC_BUF_SAMPLES / 2U / cfg->NumChannels) * cfg->NumChannels);
+  if (adc->half_len == 0U)
+  {
+    return USBD_FAIL;
+  }
+
+  /* Sequence: SQ1 to SQ4 from bit 6 of SQR1, then five per register */
+  sq[0] = cfg->NumChannels - 1U;
+  for (i = 0U; i < cfg->NumChannels; i++)
+  {
+    ch = cfg->Channels[i];
+    if ((ch == 0U) || (ch > USBD_CDC_ADC_MAX_CHANNEL_NUM))
+    {
+      return USBD_FAIL;
+    }
+    if (i < 4U)
+    {
+      sq[0] |= ch << (6U * (i + 1U));
+    }
+    else
+    {
+      j = i - 4U;
+      sq[1U + j / 5U] |= ch << (6U * (j % 5U));
+    }
+
+    if (ch < 10U)
+    {
+      smpr1 |= (uint32_t)(cfg->SampleTime & 7U) << (3U * ch);
+    }
+    else
+    {
+      smpr2 |= (uint32_t)(cfg->SampleTime & 7U) << (3U * (ch - 10U));
+    }
+  }
+
+  /* Voltage regulator through the intermediate state, 10 us to settle */
+  regs->CR &= ~ADC_CR_ADVREGEN;
+  regs->CR |= ADC_CR_ADVREGEN_0;
+  HAL_Delay(1U);
+
+  /* Single ended calibration, with the ADC disabled */
+  regs->CR &= ~ADC_CR_ADCALDIF;
+  regs->CR |= ADC_CR_ADCAL;
+  while ((regs->CR & ADC_CR_ADCAL) != 0U)
+  {
+  }
+
+  regs->CR |= ADC_CR_ADEN;
+  while ((regs->ISR & ADC_ISR_ADRDY) == 0U)
+  {
+  }
+  regs->ISR = ADC_ISR_ADRDY;
+
+  /* 12 bits right aligned, circular DMA, one scan per rising TRGO */
+  regs->CFGR = ADC_CFGR_DMAEN | ADC_CFGR_DMACFG |
+               ((uint32_t)cfg->ExtSel << ADC_CFGR_EXTSEL_Pos) | ADC_CFGR_EXTEN_0;
+  regs->SMPR1 = smpr1;
+  regs->SMPR2 = smpr2;
+  sqr = &regs->SQR1;
+  for (i = 0U; i < 4U; i++)
+  {
+    sqr[i] = sq[i];
+  }
+
+  cfg->DmaCh->CCR = 0U;
+  cfg->DmaCh->CPAR = (uint32_t)&regs->DR;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Start streaming: program the DMA and the timer, arm the ADC
+  * @param  adc: engine state
+  * @param  rate_hz: frames per second, rounded to what the timer divides
+  *         to, in adc->rate_hz
+  * @retval USBD_OK, USBD_BUSY while running or while halves of the last
+  *         run are still queued, USBD_FAIL for a rate out of reach
+  */
+uint8_t USBD_CDC_Adc_Start(USBD_CDC_AdcTypeDef *adc, uint32_t rate_hz)
+{
+  const USBD_CDC_AdcConfigTypeDef *cfg = adc->cfg;
+  TIM_TypeDef *tim = cfg->Tim;
+  uint32_t ticks;
+  uint32_t psc;
+  uint32_t arr;
+
+  if ((adc->running != 0U) || (adc->busy[0] != 0U) || (adc->busy[1] != 0U))
+  {
+    return USBD_BUSY;
+  }
+  if ((rate_hz == 0U) || ((ticks = cfg->TimClockHz / rate_hz) < 2U))
+  {
+    return USBD_FAIL;
+  }
+
+  psc = (ticks - 1U) / 65536U;
+  arr = ticks / (psc + 1U) - 1U;
+  adc->rate_hz = cfg->TimClockHz / ((psc + 1U) * (arr + 1U));
+
+  /* DMA first, so that the first conversion finds it ready */
+  cfg->DmaCh->CCR = 0U;
+  cfg->Dma->IFCR = USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_IFCR_CGIF1);
+  cfg->DmaCh->CMAR = (uint32_t)adc->buf;
+  cfg->DmaCh->CNDTR = 2U * adc->half_len;
+  cfg->DmaCh->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 |
+                    DMA_CCR_PL_1 | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_EN;
+
+  /* Timer stopped and preloaded before its TRGO is the update event, so
+     that UG does not trigger a scan */
+  tim->CR1 = 0U;
+  tim->CR2 &= ~TIM_CR2_MMS;
+  tim->PSC = psc;
+  tim->ARR = arr;
+  tim->CNT = 0U;
+  tim->EGR = TIM_EGR_UG;
+  tim->CR2 |= TIM_CR2_MMS_1;
+
+  adc->running = 1U;
+  cfg->Instance->ISR = ADC_ISR_OVR | ADC_ISR_EOC | ADC_ISR_EOS;
+  cfg->Instance->CR |= ADC_CR_ADSTART;
+  tim->CR1 = TIM_CR1_CEN;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Stop streaming. The part of the buffer not yet queued is lost;
+  *         halves already queued still go out.
+  * @param  adc: engine state
+  * @retval None
+  */
+void USBD_CDC_Adc_Stop(USBD_CDC_AdcTypeDef *adc)
+{
+  const USBD_CDC_AdcConfigTypeDef *cfg = adc->cfg;
+
+  adc->running = 0U;
+  cfg->Tim->CR1 &= ~TIM_CR1_CEN;
+  if ((cfg->Instance->CR & ADC_CR_ADSTART) != 0U)
+  {
+    cfg->Instance->CR |= ADC_CR_ADSTP;
+    while ((cfg->Instance->CR & ADC_CR_ADSTP) != 0U)
+    {
+    }
+  }
+  cfg->DmaCh->CCR = 0U;
+}
+
+/**
+  * @brief  DMA interrupt of an engine: half and full transfer
+  * @param  adc: engine state
+  * @retval None
+  */
+void USBD_CDC_Adc_DmaIRQHandler(USBD_CDC_AdcTypeDef *adc)
+{
+  const USBD_CDC_AdcConfigTypeDef *cfg = adc->cfg;
+  uint32_t isr = cfg->Dma->ISR;
+
+  if ((isr & USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_ISR_TEIF1)) != 0U)
+  {
+    cfg->Dma->IFCR = USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_IFCR_CGIF1);
+    adc->stats.dma_errors++;
+    USBD_CDC_Adc_Stop(adc);
+    return;
+  }
+
+  /* Both may be pending after a long latency: the first half is older */
+  if ((isr & USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_ISR_HTIF1)) != 0U)
+  {
+    cfg->Dma->IFCR = USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_IFCR_CHTIF1);
+    USBD_CDC_Adc_Block(adc, 0U);
+  }
+  if ((isr & USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_ISR_TCIF1)) != 0U)
+  {
+    cfg->Dma->IFCR = USBD_CDC_ADC_DMA_FLAGS(cfg->DmaChNum, DMA_IFCR_CTCIF1);
+    USBD_CDC_Adc_Block(adc, 1U);
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_adc_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  A half of the buffer is written: queue it as it is
+  * @param  adc: engine state
+  * @param  half: 0 or 1
+  * @retval None
+  */
+static void USBD_CDC_Adc_Block(USBD_CDC_AdcTypeDef *adc, uint32_t half)
+{
+  if (adc->running == 0U)
+  {
+    return;
+  }
+  if (adc->busy[half] != 0U)
+  {
+    adc->stats.overruns++;
+    return;
+  }
+
+  adc->busy[half] = 1U;
+  if (USBD_CDC_TxEnqueue(adc->pdev, adc->instance,
+                         (const uint8_t *)&adc->buf[half * adc->half_len],
+                         (uint16_t)(adc->half_len * 2U),
+                         (half == 0U) ? USBD_CDC_Adc_Done0 : USBD_CDC_Adc_Done1,
+                         adc) != USBD_OK)
+  {
+    adc->busy[half] = 0U;
+    adc->stats.dropped++;
+    return;
+  }
+  adc->stats.blocks++;
+}
+
+/**
+  * @brief  First half sent, or dropped on deconfiguration
+  * @param  token: engine state
+  * @param  status: USBD_OK if sent
+  * @retval None
+  */
+static void USBD_CDC_Adc_Done0(void *token, uint8_t status)
+{
+  USBD_CDC_AdcTypeDef *adc = token;
+
+  if (status == USBD_OK)
+  {
+    adc->stats.bytes += adc->half_len * 2U;
+  }
+  adc->busy[0] = 0U;
+}
+
+/**
+  * @brief  Second half sent, or dropped on deconfiguration
+  * @param  token: engine state
+  * @param  status: USBD_OK if sent
+  * @retval None
+  */
+static void USBD_CDC_Adc_Done1(void *token, uint8_t status)
+{
+  USBD_CDC_AdcTypeDef *adc = token;
+
+  if (status == USBD_OK)
+  {
+    adc->stats.bytes += adc->half_len * 2U;
+  }
+  adc->busy[1] = 0U;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_ADC_ENABLED */
@@ -0,0 +1,723 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_bench.c
+  * @brief   Throughput and latency test modes of the CDC class, see
+  *          usbd_cdc_bench.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_bench.h"
+#include "usb_stats.h"
+
+#if (USBD_CDC_BENCH_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_bench
+  * @{
+  */
+
+/** @defgroup usbd_cdc_bench_Private_Defines
+  * @{
+  */
+/* Byte n of a soak stream */
+#define USBD_CDC_BENCH_SOAK_BYTE(n)                 ((uint8_t)((n) + ((n) >> 8) + ((n) >> 16)))
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  /* first, so both halves are word aligned for the OTG_HS DMA; sized for
+     the largest packet the class arms the OUT endpoint with */
+  uint8_t  rx_buf[2][CDC_DATA_HS_MAX_PACKET_SIZE];
+  uint8_t  soak_tx[USBD_CDC_BENCH_SOURCE_SIZE];
+  int      instance;
+  USBD_CDC_BenchStatsTypeDef stats;
+  uint8_t  line_coding[7];
+  uint8_t  tx_busy;             /* IN transfer in flight */
+  uint8_t  rx_idx;              /* rx_buf half the OUT endpoint is armed with */
+  uint8_t  rx_held;             /* the other half is full and waits for IN */
+  uint16_t rx_held_len;
+  uint16_t tx_len;
+#if (USB_PMABENCH_ENABLED == 1)
+  uint32_t pma_line;            /* next line of the report */
+  char     pma_text[USB_PMABENCH_LINE_SIZE];
+#endif
+#if (USB_ENUMBENCH_ENABLED == 1)
+  uint32_t enum_line;           /* next line of the report */
+  char     enum_text[USB_ENUMBENCH_LINE_SIZE];
+#endif
+  uint32_t soak_rng;            /* xorshift state of the transfer sizes */
+  uint32_t soak_rx_pos;         /* stream offsets from the soak start */
+  uint32_t soak_tx_pos;
+  uint32_t soak_line;           /* next line of the report */
+  char     soak_text[USBD_CDC_BENCH_SOAK_LINE_SIZE];
+} USBD_CDC_BenchTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Private_FunctionPrototypes
+  * @{
+  */
+static int8_t USBD_CDC_Bench_ItfInit(int instance, void **ctx);
+static int8_t USBD_CDC_Bench_ItfDeInit(void *ctx);
+static int8_t USBD_CDC_Bench_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t USBD_CDC_Bench_Receive(void *ctx, uint8_t *pbuf, uint32_t *len);
+static int8_t USBD_CDC_Bench_TxComplete(void *ctx);
+static void   USBD_CDC_Bench_Send(USBD_CDC_BenchTypeDef *b, const uint8_t *pbuf, uint16_t length);
+static void   USBD_CDC_Bench_Rearm(USBD_CDC_BenchTypeDef *b);
+#if (USB_PMABENCH_ENABLED == 1)
+static void   USBD_CDC_Bench_SendPMALine(USBD_CDC_BenchTypeDef *b);
+#endif
+#if (USB_ENUMBENCH_ENABLED == 1)
+static void   USBD_CDC_Bench_SendEnumLine(USBD_CDC_BenchTypeDef *b);
+#endif
+static void   USBD_CDC_Bench_SoakSend(USBD_CDC_BenchTypeDef *b);
+static void   USBD_CDC_Bench_SoakCheck(USBD_CDC_BenchTypeDef *b, const uint8_t *pbuf, uint32_t len);
+static void   USBD_CDC_Bench_SendSoakLine(USBD_CDC_BenchTypeDef *b);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Private_Variables
+  * @{
+  */
+static USBD_HandleTypeDef *USBD_CDC_Bench_Dev;
+static USBD_CDC_BenchTypeDef USBD_CDC_Bench[NUM_CDC_INSTANCES];
+
+/* Kept apart from the contexts, which every interface init clears */
+static USBD_CDC_BenchSoakTypeDef USBD_CDC_Bench_Soak[NUM_CDC_INSTANCES];
+
+/* Source pattern: any 256 aligned window of it continues n & 0xFF */
+static uint8_t USBD_CDC_Bench_Pattern[USBD_CDC_BENCH_SOURCE_SIZE + 256];
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Exported_Variables
+  * @{
+  */
+USBD_CDC_ItfTypeDef USBD_CDC_Bench_fops =
+{
+  USBD_CDC_Bench_ItfInit,
+  USBD_CDC_Bench_ItfDeInit,
+  USBD_CDC_Bench_Control,
+  USBD_CDC_Bench_Receive,
+  USBD_CDC_Bench_TxComplete,
+};
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Prepare the test modes, to be called before USBD_CDC_RegisterInterface
+  *         with USBD_CDC_Bench_fops
+  * @param  pdev: device instance
+  * @retval None
+  */
+void USBD_CDC_Bench_Init(USBD_HandleTypeDef *pdev)
+{
+  uint32_t i;
+
+  USBD_CDC_Bench_Dev = pdev;
+
+  for (i = 0U; i < sizeof(USBD_CDC_Bench_Pattern); i++)
+  {
+    USBD_CDC_Bench_Pattern[i] = (uint8_t)i;
+  }
+}
+
+/**
+  * @brief  Counters of one instance
+  * @param  instance: CDC instance
+  * @retval pointer to the counters
+  */
+const USBD_CDC_BenchStatsTypeDef *USBD_CDC_Bench_GetStats(int instance)
+{
+  return &USBD_CDC_Bench[instance].stats;
+}
+
+/**
+  * @brief  Soak counters of one instance, since they were last reported
+  * @param  instance: CDC instance
+  * @retval pointer to the counters
+  */
+const USBD_CDC_BenchSoakTypeDef *USBD_CDC_Bench_GetSoak(int instance)
+{
+  return &USBD_CDC_Bench_Soak[instance];
+}
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_bench_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Interface init: every instance starts with the test stopped
+  * @param  instance: CDC instance
+  * @param  ctx: context handed back to the other callbacks
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Bench_ItfInit(int instance, void **ctx)
+{
+  USBD_CDC_BenchTypeDef *b = &USBD_CDC_Bench[instance];
+
+  memset(b, 0, sizeof(*b));
+  b->instance = instance;
+  USBD_CDC_Bench_Soak[instance].inits++;
+
+  *ctx = b;
+  USBD_CDC_SetRxBuffer(USBD_CDC_Bench_Dev, instance, b->rx_buf[0]);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Interface deinit
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Bench_ItfDeInit(void *ctx)
+{
+  USBD_CDC_BenchTypeDef *b = ctx;
+
+  b->stats.mode = USBD_CDC_BENCH_OFF;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Class requests: the line coding selects the test mode
+  * @param  ctx: instance context
+  * @param  cmd: request code
+  * @param  pbuf: request data
+  * @param  length: request data length
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Bench_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  USBD_CDC_BenchTypeDef *b = ctx;
+  uint32_t baud;
+  uint32_t mode;
+
+  switch (cmd)
+  {
+  case CDC_SET_LINE_CODING:
+    memcpy(b->line_coding, pbuf, MIN(length, sizeof(b->line_coding)));
+    baud = pbuf[0] | (pbuf[1] << 8) | (pbuf[2] << 16) | ((uint32_t)pbuf[3] << 24);
+
+    switch (baud)
+    {
+    case USBD_CDC_BENCH_BAUD_LOOPBACK:
+      mode = USBD_CDC_BENCH_LOOPBACK;
+      break;
+
+    case USBD_CDC_BENCH_BAUD_SINK:
+      mode = USBD_CDC_BENCH_SINK;
+      break;
+
+    case USBD_CDC_BENCH_BAUD_SOURCE:
+      mode = USBD_CDC_BENCH_SOURCE;
+      break;
+
+    case USBD_CDC_BENCH_BAUD_PINGPONG:
+      mode = USBD_CDC_BENCH_PINGPONG;
+      break;
+
+#if (USB_PMABENCH_ENABLED == 1)
+    case USBD_CDC_BENCH_BAUD_PMA:
+      mode = USBD_CDC_BENCH_PMA;
+      break;
+#endif
+
+#if (USB_ENUMBENCH_ENABLED == 1)
+    case USBD_CDC_BENCH_BAUD_ENUM:
+      mode = USBD_CDC_BENCH_ENUM;
+      break;
+#endif
+
+    case USBD_CDC_BENCH_BAUD_SOAK:
+      mode = USBD_CDC_BENCH_SOAK;
+      break;
+
+    case USBD_CDC_BENCH_BAUD_SOAK_REPORT:
+      mode = USBD_CDC_BENCH_SOAK_REPORT;
+      break;
+
+    default:
+      mode = USBD_CDC_BENCH_OFF;
+      break;
+    }
+
+    if ((mode == USBD_CDC_BENCH_SOAK) && (b->stats.mode == USBD_CDC_BENCH_SOAK))
+    {
+      /* format change only: the soak goes on */
+      USBD_CDC_Bench_Soak[b->instance].lines++;
+      break;
+    }
+    b->stats.mode = mode;
+
+    b->stats.rx_bytes = 0U;
+    b->stats.tx_bytes = 0U;
+    b->stats.rx_held = 0U;
+    USBD_CDC_SetTxZlp(USBD_CDC_Bench_Dev, b->instance,
+                      ((mode == USBD_CDC_BENCH_PINGPONG) || (mode == USBD_CDC_BENCH_SOAK)) ? 1U : 0U);
+
+    if ((b->stats.mode == USBD_CDC_BENCH_SOURCE) && (b->tx_busy == 0U))
+    {
+      USBD_CDC_Bench_Send(b, USBD_CDC_Bench_Pattern, USBD_CDC_BENCH_SOURCE_SIZE);
+    }
+#if (USB_PMABENCH_ENABLED == 1)
+    if (b->stats.mode == USBD_CDC_BENCH_PMA)
+    {
+      /* holds off the status stage for the length of the run */
+      USB_PMABench_Run(((PCD_HandleTypeDef *)USBD_CDC_Bench_Dev->pData)->Instance);
+      b->pma_line = 0U;
+      if (b->tx_busy == 0U)
+      {
+        USBD_CDC_Bench_SendPMALine(b);
+      }
+    }
+#endif
+#if (USB_ENUMBENCH_ENABLED == 1)
+    if (b->stats.mode == USBD_CDC_BENCH_ENUM)
+    {
+      b->enum_line = 0U;
+      if (b->tx_busy == 0U)
+      {
+        USBD_CDC_Bench_SendEnumLine(b);
+      }
+    }
+#endif
+    if (mode == USBD_CDC_BENCH_SOAK)
+    {
+      b->soak_rng = 0x9E3779B9U ^ (uint32_t)b->instance;
+      b->soak_rx_pos = 0U;
+      b->soak_tx_pos = 0U;
+      if (b->tx_busy == 0U)
+      {
+        USBD_CDC_Bench_SoakSend(b);
+      }
+    }
+    if (mode == USBD_CDC_BENCH_SOAK_REPORT)
+    {
+      b->soak_line = 0U;
+      if (b->tx_busy == 0U)
+      {
+        USBD_CDC_Bench_SendSoakLine(b);
+      }
+    }
+    break;
+
+  case CDC_GET_LINE_CODING:
+    memcpy(pbuf, b->line_coding, MIN(length, sizeof(b->line_coding)));
+    break;
+
+  default:
+    break;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  One packet received
+  * @param  ctx: instance context
+  * @param  pbuf: packet, NULL when it was left in packet memory
+  * @param  len: packet length
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Bench_Receive(void *ctx, uint8_t *pbuf, uint32_t *len)
+{
+  USBD_CDC_BenchTypeDef *b = ctx;
+  uint8_t *filled = b->rx_buf[b->rx_idx];
+
+  if (pbuf == NULL)
+  {
+    USBD_CDC_ReadRxData(USBD_CDC_Bench_Dev, b->instance, 0U, filled, (uint16_t)*len);
+  }
+  b->stats.rx_bytes += *len;
+
+  if (b->stats.mode == USBD_CDC_BENCH_SOAK)
+  {
+    USBD_CDC_Bench_SoakCheck(b, filled, *len);
+    USBD_CDC_ReceivePacket(USBD_CDC_Bench_Dev, b->instance);
+    if (b->tx_busy == 0U)
+    {
+      /* a refused IN transfer is tried again */
+      USBD_CDC_Bench_SoakSend(b);
+    }
+    return USBD_OK;
+  }
+
+  if ((b->stats.mode != USBD_CDC_BENCH_LOOPBACK) &&
+      (b->stats.mode != USBD_CDC_BENCH_PINGPONG))
+  {
+    USBD_CDC_ReceivePacket(USBD_CDC_Bench_Dev, b->instance);
+    return USBD_OK;
+  }
+
+  if (*len == 0U)
+  {
+    USBD_CDC_ReceivePacket(USBD_CDC_Bench_Dev, b->instance);
+  }
+  else if (b->tx_busy == 0U)
+  {
+    /* Echo from this half and receive into the other one meanwhile */
+    USBD_CDC_Bench_Send(b, filled, (uint16_t)*len);
+    USBD_CDC_Bench_Rearm(b);
+  }
+  else
+  {
+    /* Leave the OUT endpoint NAKing until the echo before goes out */
+    b->rx_held = 1U;
+    b->rx_held_len = (uint16_t)*len;
+    b->stats.rx_held++;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  IN transfer complete
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Bench_TxComplete(void *ctx)
+{
+  USBD_CDC_BenchTypeDef *b = ctx;
+
+  if (b->tx_busy == 0U)
+  {
+    /* Completion of a transfer the application made, not ours */
+    return USBD_OK;
+  }
+
+  b->tx_busy = 0U;
+  b->stats.tx_bytes += b->tx_len;
+
+  if (b->rx_held != 0U)
+  {
+    b->rx_held = 0U;
+    USBD_CDC_Bench_Send(b, b->rx_buf[b->rx_idx], b->rx_held_len);
+    USBD_CDC_Bench_Rearm(b);
+  }
+  else if (b->stats.mode == USBD_CDC_BENCH_SOURCE)
+  {
+    USBD_CDC_Bench_Send(b, &USBD_CDC_Bench_Pattern[b->stats.tx_bytes & 0xFFU],
+                        USBD_CDC_BENCH_SOURCE_SIZE);
+  }
+  else if (b->stats.mode == USBD_CDC_BENCH_SOAK)
+  {
+    USBD_CDC_BenchSoakTypeDef *s = &USBD_CDC_Bench_Soak[b->instance];
+
+    s->tx_bytes += b->tx_len;
+    s->tx_xfers++;
+    if (b->tx_len == 0U)
+    {
+      s->tx_zlps++;
+    }
+    USBD_CDC_Bench_SoakSend(b);
+  }
+  else if (b->stats.mode == USBD_CDC_BENCH_SOAK_REPORT)
+  {
+    USBD_CDC_Bench_SendSoakLine(b);
+  }
+#if (USB_PMABENCH_ENABLED == 1)
+  else if (b->stats.mode == USBD_CDC_BENCH_PMA)
+  {
+    USBD_CDC_Bench_SendPMALine(b);
+  }
+#endif
+#if (USB_ENUMBENCH_ENABLED == 1)
+  else if (b->stats.mode == USBD_CDC_BENCH_ENUM)
+  {
+    USBD_CDC_Bench_SendEnumLine(b);
+  }
+#endif
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Start an IN transfer
+  * @param  b: instance context
+  * @param  pbuf: data, must stay untouched until the transfer completes
+  * @param  length: data length
+  * @retval None
+  */
+static void USBD_CDC_Bench_Send(USBD_CDC_BenchTypeDef *b, const uint8_t *pbuf, uint16_t length)
+{
+  b->tx_busy = 1U;
+  b->tx_len = length;
+
+  if (USBD_CDC_TransmitBuffer(USBD_CDC_Bench_Dev, b->instance, pbuf, length) != USBD_OK)
+  {
+    b->tx_busy = 0U;
+  }
+}
+
+/**
+  * @brief  Arm the OUT endpoint with the half not being echoed
+  * @param  b: instance context
+  * @retval None
+  */
+static void USBD_CDC_Bench_Rearm(USBD_CDC_BenchTypeDef *b)
+{
+  b->rx_idx ^= 1U;
+  USBD_CDC_SetRxBuffer(USBD_CDC_Bench_Dev, b->instance, b->rx_buf[b->rx_idx]);
+  USBD_CDC_ReceivePacket(USBD_CDC_Bench_Dev, b->instance);
+}
+
+#if (USB_PMABENCH_ENABLED == 1)
+/**
+  * @brief  Send the next line of the packet memory copy report, if any
+  * @param  b: instance context
+  * @retval None
+  */
+static void USBD_CDC_Bench_SendPMALine(USBD_CDC_BenchTypeDef *b)
+{
+  uint32_t len = USB_PMABench_Line(b->pma_line, b->pma_text);
+
+  if (len != 0U)
+  {
+    b->pma_line++;
+    USBD_CDC_Bench_Send(b, (const uint8_t *)b->pma_text, (uint16_t)len);
+  }
+}
+#endif /* USB_PMABENCH_ENABLED */
+
+#if (USB_ENUMBENCH_ENABLED == 1)
+/**
+  * @brief  Send the next line of the enumeration report, if any
+  * @param  b: instance context
+  * @retval None
+  */
+static void USBD_CDC_Bench_SendEnumLine(USBD_CDC_BenchTypeDef *b)
+{
+  uint32_t len = USB_EnumBench_Line(b->enum_line, b->enum_text);
+
+  if (len != 0U)
+  {
+    b->enum_line++;
+    USBD_CDC_Bench_Send(b, (const uint8_t *)b->enum_text, (uint16_t)len);
+  }
+}
+#endif /* USB_ENUMBENCH_ENABLED */
+
+/**
+  * @brief  Size of the next soak IN transfer: the packet size edges, whole
+  *         packets, and anything up to USBD_CDC_BENCH_SOURCE_SIZE
+  * @param  b: instance context
+  * @retval bytes
+  */
+static uint16_t USBD_CDC_Bench_SoakSize(USBD_CDC_BenchTypeDef *b)
+{
+  uint32_t r = b->soak_rng;
+  uint32_t size;
+
+  r ^= r << 13;
+  r ^= r >> 17;
+  r ^= r << 5;
+  b->soak_rng = r;
+
+  switch (r & 7U)
+  {
+  case 0U:
+    size = 0U;
+    break;
+
+  case 1U:
+    size = 63U;
+    break;
+
+  case 2U:
+    size = 64U;
+    break;
+
+  case 3U:
+    size = 65U;
+    break;
+
+  case 4U:
+    size = 64U * (1U + ((r >> 3) % (USBD_CDC_BENCH_SOURCE_SIZE / 64U)));
+    break;
+
+  default:
+    size = 1U + ((r >> 3) % USBD_CDC_BENCH_SOURCE_SIZE);
+    break;
+  }
+  return (uint16_t)MIN(size, USBD_CDC_BENCH_SOURCE_SIZE);
+}
+
+/**
+  * @brief  Start the next soak IN transfer
+  * @param  b: instance context
+  * @retval None
+  */
+static void USBD_CDC_Bench_SoakSend(USBD_CDC_BenchTypeDef *b)
+{
+  uint16_t len = USBD_CDC_Bench_SoakSize(b);
+  uint32_t n = b->soak_tx_pos;
+  uint16_t i;
+
+  for (i = 0U; i < len; i++, n++)
+  {
+    b->soak_tx[i] = USBD_CDC_BENCH_SOAK_BYTE(n);
+  }
+
+  USBD_CDC_Bench_Send(b, b->soak_tx, len);
+  if (b->tx_busy == 0U)
+  {
+    USBD_CDC_Bench_Soak[b->instance].tx_busy++;
+    return;
+  }
+  b->soak_tx_pos += len;
+}
+
+/**
+  * @brief  Check a received soak packet against the pattern
+  * @param  b: instance context
+  * @param  pbuf: packet
+  * @param  len: packet length
+  * @retval None
+  */
+static void USBD_CDC_Bench_SoakCheck(USBD_CDC_BenchTypeDef *b, const uint8_t *pbuf, uint32_t len)
+{
+  USBD_CDC_BenchSoakTypeDef *s = &USBD_CDC_Bench_Soak[b->instance];
+  uint32_t n = b->soak_rx_pos;
+  uint32_t i;
+
+  for (i = 0U; i < len; i++, n++)
+  {
+    if (pbuf[i] != USBD_CDC_BENCH_SOAK_BYTE(n))
+    {
+      s->rx_errors++;
+      break;
+    }
+  }
+  b->soak_rx_pos += len;
+  s->rx_bytes += len;
+}
+
+/**
+  * @brief  Append " name value"
+  * @param  p: where to write
+  * @param  name: NUL terminated field name
+  * @param  value: field value
+  * @retval end of the text
+  */
+static char *USBD_CDC_Bench_PutField(char *p, const char *name, uint32_t value)
+{
+  char tmp[10];
+  uint32_t n = 0U;
+
+  *p++ = ' ';
+  while (*name != '\0')
+  {
+    *p++ = *name++;
+  }
+  *p++ = ' ';
+
+  do
+  {
+    tmp[n++] = (char)('0' + (value % 10U));
+    value /= 10U;
+  } while (value != 0U);
+  while (n != 0U)
+  {
+    *p++ = tmp[--n];
+  }
+  return p;
+}
+
+/**
+  * @brief  Send the next line of the soak report, if any. The soak
+  *         counters are cleared once taken; the device wide ones of
+  *         usb_stats.h, with USB_STATS_ENABLED, are not.
+  * @param  b: instance context
+  * @retval None
+  */
+static void USBD_CDC_Bench_SendSoakLine(USBD_CDC_BenchTypeDef *b)
+{
+  USBD_CDC_BenchSoakTypeDef *s = &USBD_CDC_Bench_Soak[b->instance];
+  char *p = b->soak_text;
+
+  switch (b->soak_line)
+  {
+  case 0U:
+    memcpy(p, "soak", 4U);
+    p += 4;
+    p = USBD_CDC_Bench_PutField(p, "rx_bytes", s->rx_bytes);
+    p = USBD_CDC_Bench_PutField(p, "rx_errors", s->rx_errors);
+    p = USBD_CDC_Bench_PutField(p, "tx_bytes", s->tx_bytes);
+    p = USBD_CDC_Bench_PutField(p, "tx_xfers", s->tx_xfers);
+    p = USBD_CDC_Bench_PutField(p, "tx_zlps", s->tx_zlps);
+    p = USBD_CDC_Bench_PutField(p, "tx_busy", s->tx_busy);
+    p = USBD_CDC_Bench_PutField(p, "lines", s->lines);
+    p = USBD_CDC_Bench_PutField(p, "inits", s->inits);
+    memset(s, 0, sizeof(*s));
+    break;
+
+#if (USB_STATS_ENABLED == 1)
+  case 1U:
+  {
+    const USB_StatsTypeDef *st = USB_Stats_Snapshot();
+
+    memcpy(p, "stats", 5U);
+    p += 5;
+    p = USBD_CDC_Bench_PutField(p, "resets", st->resets);
+    p = USBD_CDC_Bench_PutField(p, "suspends", st->suspends);
+    p = USBD_CDC_Bench_PutField(p, "errors", st->errors);
+    p = USBD_CDC_Bench_PutField(p, "overruns", st->pma_overruns);
+    break;
+  }
+#endif
+
+  case 2U:
+    memcpy(p, "end", 3U);
+    p += 3;
+    break;
+
+  default:
+    return;
+  }
+
+  *p++ = '\n';
+  b->soak_line++;
+#if (USB_STATS_ENABLED == 0)
+  if (b->soak_line == 1U)
+  {
+    b->soak_line = 2U;
+  }
+#endif
+  USBD_CDC_Bench_Send(b, (const uint8_t *)b->soak_text, (uint16_t)(p - b->soak_text));
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_BENCH_ENABLED */
@@ -0,0 +1,453 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_cobs.c
+  * @brief   COBS framing over the CDC rings, see usbd_cdc_cobs.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_cobs.h"
+
+#if (USBD_CDC_COBS_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_cobs
+  * @{
+  */
+
+/** @defgroup usbd_cdc_cobs_Private_Defines
+  * @{
+  */
+/* Longest run of non zero bytes behind one code byte */
+#define USBD_CDC_COBS_RUN_MAX                       254U
+
+/* Non zero if one of the bytes of w is zero */
+#define USBD_CDC_COBS_HAS_ZERO(w)                   (((w) - 0x01010101U) & ~(w) & 0x80808080U)
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_cobs_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  USBD_CDC_CobsTypeDef *c;
+  uint8_t  *p;                  /* next free byte of the ring */
+  uint32_t  room;               /* contiguous bytes free at p */
+  uint32_t  used;               /* bytes written, not committed yet */
+} USBD_CDC_CobsWriterTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_cobs_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Find the first zero byte, a word at a time once aligned
+  * @param  p: bytes to scan
+  * @param  n: number of bytes
+  * @retval index of the zero, n if there is none
+  */
+static uint32_t USBD_CDC_Cobs_FindZero(const uint8_t *p, uint32_t n)
+{
+  uint32_t i = 0U;
+
+  while ((i < n) && ((((uint32_t)(p + i)) & 0x3U) != 0U))
+  {
+    if (p[i] == 0U)
+    {
+      return i;
+    }
+    i++;
+  }
+
+  while ((i + 4U) <= n)
+  {
+    uint32_t w = *(const uint32_t *)(const void *)(p + i);
+
+    if (USBD_CDC_COBS_HAS_ZERO(w) != 0U)
+    {
+      break;
+    }
+    i += 4U;
+  }
+
+  while (i < n)
+  {
+    if (p[i] == 0U)
+    {
+      return i;
+    }
+    i++;
+  }
+
+  return n;
+}
+
+/**
+  * @brief  Append to the transmit ring, committing each contiguous piece as
+  *         it fills up
+  * @param  w: writer, room checked beforehand
+  * @param  src: bytes to append
+  * @param  n: number of bytes
+  * @retval None
+  */
+static void USBD_CDC_Cobs_Put(USBD_CDC_CobsWriterTypeDef *w,
+                              const uint8_t *src, uint32_t n)
+{
+  uint32_t chunk;
+
+  while (n > 0U)
+  {
+    if (w->room == 0U)
+    {
+      /* wrapped: hand over the piece written so far */
+      USBD_CDC_TxCommit(w->c->pdev, w->c->instance, w->used);
+      w->room = USBD_CDC_TxReserve(w->c->pdev, w->c->instance, &w->p);
+      w->used = 0U;
+    }
+
+    chunk = MIN(n, w->room);
+    memcpy(w->p, src, chunk);
+    w->p += chunk;
+    w->room -= chunk;
+    w->used += chunk;
+    src += chunk;
+    n -= chunk;
+  }
+}
+
+/**
+  * @brief  COBS encode onto the transmit ring
+  * @param  w: writer, room checked beforehand
+  * @param  src: data
+  * @param  length: number of bytes
+  * @param  open: 1 to leave out the last run, for more data to follow it
+  * @retval bytes of src encoded; the last run starts there when open
+  */
+static uint32_t USBD_CDC_Cobs_PutRuns(USBD_CDC_CobsWriterTypeDef *w,
+                                      const uint8_t *src, uint32_t length,
+                                      uint8_t open)
+{
+  uint32_t pos = 0U;
+  uint32_t run;
+  uint8_t code;
+
+  for (;;)
+  {
+    run = USBD_CDC_Cobs_FindZero(src + pos, MIN(length - pos, USBD_CDC_COBS_RUN_MAX));
+    if ((open != 0U) && ((pos + run) == length) && (run < USBD_CDC_COBS_RUN_MAX))
+    {
+      return pos;
+    }
+
+    code = (uint8_t)(run + 1U);
+    USBD_CDC_Cobs_Put(w, &code, 1U);
+    USBD_CDC_Cobs_Put(w, src + pos, run);
+    pos += run;
+
+    if (pos == length)
+    {
+      return pos;
+    }
+    if (run < USBD_CDC_COBS_RUN_MAX)
+    {
+      /* the zero the run stopped at, implied by the code */
+      pos++;
+    }
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_cobs_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Bind a framer to a CDC instance
+  * @param  c: framer
+  * @param  pdev: device instance
+  * @param  instance: CDC instance, with its receive and transmit rings
+  * @retval None
+  */
+void USBD_CDC_Cobs_Init(USBD_CDC_CobsTypeDef *c, USBD_HandleTypeDef *pdev,
+                        int instance)
+{
+  memset(c, 0, sizeof(*c));
+  c->pdev = pdev;
+  c->instance = instance;
+}
+
+/**
+  * @brief  Get the next complete frame, decoded
+  * @note   Releases the frame returned by the previous call: the pointer
+  *         it gave is invalid once this is called again.
+  * @param  c: framer
+  * @param  frame: set to the decoded message
+  * @retval message length, 0 if no complete frame has been received
+  */
+uint32_t USBD_CDC_Cobs_GetFrame(USBD_CDC_CobsTypeDef *c, const uint8_t **frame)
+{
+  const uint8_t *p;
+  uint8_t *buf;
+  uint32_t n;
+  uint32_t z;
+  int32_t len;
+
+  if (c->held != 0U)
+  {
+    USBD_CDC_RxRelease(c->pdev, c->instance, c->held);
+    c->held = 0U;
+    c->asm_len = 0U;
+  }
+
+  for (;;)
+  {
+    n = USBD_CDC_RxPeek(c->pdev, c->instance, &p);
+    if (n == 0U)
+    {
+      return 0U;
+    }
+
+    z = c->scanned + USBD_CDC_Cobs_FindZero(p + c->scanned, n - c->scanned);
+
+    if (z == n)
+    {
+      /* no delimiter in this piece */
+      if (c->discard != 0U)
+      {
+        USBD_CDC_RxRelease(c->pdev, c->instance, n);
+        continue;
+      }
+      if ((c->asm_len + n) > USBD_CDC_COBS_MAX_FRAME)
+      {
+        c->dropped++;
+        c->discard = 1U;
+        c->asm_len = 0U;
+        c->scanned = 0U;
+        USBD_CDC_RxRelease(c->pdev, c->instance, n);
+        continue;
+      }
+      if (n < USBD_CDC_GetRxCount(c->pdev, c->instance))
+      {
+        /* the frame goes on at the start of the ring */
+        memcpy(&c->asm_buf[c->asm_len], p, n);
+        c->asm_len += n;
+        c->scanned = 0U;
+        USBD_CDC_RxRelease(c->pdev, c->instance, n);
+        continue;
+      }
+      c->scanned = n;
+      return 0U;
+    }
+
+    c->scanned = 0U;
+
+    if (c->discard != 0U)
+    {
+      c->discard = 0U;
+      USBD_CDC_RxRelease(c->pdev, c->instance, z + 1U);
+      continue;
+    }
+    if ((c->asm_len + z) > USBD_CDC_COBS_MAX_FRAME)
+    {
+      c->dropped++;
+      c->asm_len = 0U;
+      USBD_CDC_RxRelease(c->pdev, c->instance, z + 1U);
+      continue;
+    }
+
+    if (c->asm_len == 0U)
+    {
+      /* the reader owns the ring up to the head: decode in place */
+      buf = (uint8_t *)p;
+      len = USBD_CDC_Cobs_Decode(buf, z);
+    }
+    else
+    {
+      memcpy(&c->asm_buf[c->asm_len], p, z);
+      buf = c->asm_buf;
+      len = USBD_CDC_Cobs_Decode(buf, c->asm_len + z);
+    }
+
+#if (USBD_CDC_COBS_CRC == 1)
+    if (len >= (int32_t)USBD_CDC_COBS_CRC_SIZE)
+    {
+      const uint8_t *t;
+
+      len -= (int32_t)USBD_CDC_COBS_CRC_SIZE;
+      t = buf + len;
+      if (USB_CRC_Compute(buf, (uint32_t)len) !=
+          ((uint32_t)t[0] | ((uint32_t)t[1] << 8) | ((uint32_t)t[2] << 16) | ((uint32_t)t[3] << 24)))
+      {
+        c->crc_errors++;
+        len = -1;
+      }
+    }
+    else if (len > 0)
+    {
+      len = -1;
+    }
+#endif /* USBD_CDC_COBS_CRC */
+
+    if (len <= 0)
+    {
+      /* bad frame, or nothing in it */
+      if (len < 0)
+      {
+        c->dropped++;
+      }
+      c->asm_len = 0U;
+      USBD_CDC_RxRelease(c->pdev, c->instance, z + 1U);
+      continue;
+    }
+
+    c->held = z + 1U;
+    c->frames++;
+    *frame = buf;
+
+    return (uint32_t)len;
+  }
+}
+
+/**
+  * @brief  Encode a message with its delimiter onto the transmit ring
+  * @param  c: framer
+  * @param  msg: message
+  * @param  length: message length
+  * @retval USBD_OK, USBD_BUSY if the ring has not room for all of it
+  */
+uint8_t USBD_CDC_Cobs_Send(USBD_CDC_CobsTypeDef *c, const uint8_t *msg,
+                           uint32_t length)
+{
+  USBD_CDC_CobsWriterTypeDef w;
+  uint8_t code;
+#if (USBD_CDC_COBS_CRC == 1)
+  uint8_t last[USBD_CDC_COBS_RUN_MAX + USBD_CDC_COBS_CRC_SIZE];
+  uint32_t pos;
+  uint32_t crc;
+#endif /* USBD_CDC_COBS_CRC */
+
+  if (USBD_CDC_GetTxFree(c->pdev, c->instance) < USBD_CDC_COBS_ENC_SIZE(length))
+  {
+    return USBD_BUSY;
+  }
+
+  w.c = c;
+  w.room = USBD_CDC_TxReserve(c->pdev, c->instance, &w.p);
+  w.used = 0U;
+
+#if (USBD_CDC_COBS_CRC == 1)
+  /* the unit reads the message while it is encoded; the last run goes on
+     into the CRC, so it waits for it */
+  USB_CRC_Begin(msg, length);
+  pos = USBD_CDC_Cobs_PutRuns(&w, msg, length, 1U);
+  memcpy(last, msg + pos, length - pos);
+  crc = USB_CRC_End();
+  last[length - pos] = (uint8_t)crc;
+  last[length - pos + 1U] = (uint8_t)(crc >> 8);
+  last[length - pos + 2U] = (uint8_t)(crc >> 16);
+  last[length - pos + 3U] = (uint8_t)(crc >> 24);
+  USBD_CDC_Cobs_PutRuns(&w, last, length - pos + USBD_CDC_COBS_CRC_SIZE, 0U);
+#else
+  USBD_CDC_Cobs_PutRuns(&w, msg, length, 0U);
+#endif /* USBD_CDC_COBS_CRC */
+
+  code = 0U;
+  USBD_CDC_Cobs_Put(&w, &code, 1U);
+  USBD_CDC_TxCommit(c->pdev, c->instance, w.used);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  COBS encode a message into a buffer, with the delimiter
+  * @param  dst: USBD_CDC_COBS_ENC_SIZE(length) bytes
+  * @param  src: message
+  * @param  length: message length
+  * @retval encoded length, delimiter included
+  */
+uint32_t USBD_CDC_Cobs_Encode(uint8_t *dst, const uint8_t *src, uint32_t length)
+{
+  uint32_t pos = 0U;
+  uint32_t out = 0U;
+  uint32_t run;
+
+  for (;;)
+  {
+    run = USBD_CDC_Cobs_FindZero(src + pos, MIN(length - pos, USBD_CDC_COBS_RUN_MAX));
+    dst[out++] = (uint8_t)(run + 1U);
+    memcpy(&dst[out], src + pos, run);
+    out += run;
+    pos += run;
+
+    if (pos == length)
+    {
+      break;
+    }
+    if (run < USBD_CDC_COBS_RUN_MAX)
+    {
+      pos++;
+    }
+  }
+
+  dst[out++] = 0U;
+
+  return out;
+}
+
+/**
+  * @brief  COBS decode a frame in place
+  * @param  buf: frame without its delimiter, overwritten by the message
+  * @param  length: frame length
+  * @retval message length, -1 if the frame is not valid COBS
+  */
+int32_t USBD_CDC_Cobs_Decode(uint8_t *buf, uint32_t length)
+{
+  uint32_t in = 0U;
+  uint32_t out = 0U;
+  uint32_t code;
+
+  while (in < length)
+  {
+    code = buf[in++];
+    if ((code == 0U) || ((in + code - 1U) > length))
+    {
+      return -1;
+    }
+
+    /* the message trails the frame by one byte per code, never passes it */
+    memmove(&buf[out], &buf[in], code - 1U);
+    out += code - 1U;
+    in += code - 1U;
+
+    if ((code != 0xFFU) && (in < length))
+    {
+      buf[out++] = 0U;
+    }
+  }
+
+  return (int32_t)out;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_COBS_ENABLED */
@@ -0,0 +1,435 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_dsp.c
+  * @brief   Spectrum stage over a CDC instance, see usbd_cdc_dsp.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_dsp.h"
+#include "usb_fft.h"
+
+#if (USBD_CDC_DSP_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_dsp
+  * @{
+  */
+
+/** @defgroup usbd_cdc_dsp_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  /* first, so the blocks are word aligned for the OTG_HS DMA. A transfer
+     that ended on a short packet is re-armed less than a packet before the
+     end of the block, the packet of slack takes what the host sends past
+     it. */
+  q15_t    in_buf[2][(USBD_CDC_DSP_BLOCK_BYTES + CDC_DATA_HS_MAX_PACKET_SIZE) / 2];
+  float32_t out_buf[2][USBD_CDC_DSP_BINS];
+  float32_t work[USBD_CDC_DSP_BLOCK_SAMPLES];
+  float32_t dec[USBD_CDC_DSP_FFT_LEN];
+  float32_t fft[USBD_CDC_DSP_FFT_LEN];
+  float32_t fir_state[USBD_CDC_DSP_MAX_TAPS + USBD_CDC_DSP_BLOCK_SAMPLES - 1];
+  arm_fir_decimate_instance_f32 fir;
+  arm_rfft_fast_instance_f32 rfft;
+  USBD_CDC_DspStatsTypeDef stats;
+  uint8_t  line_coding[7];
+  uint8_t  ready;               /* USBD_CDC_Dsp_Init accepted the filter */
+  __IO uint8_t active;          /* instance configured */
+  __IO uint8_t in_full[2];      /* block waits for USBD_CDC_Dsp_Process */
+  uint8_t  in_idx;              /* block the OUT endpoint fills */
+  uint8_t  proc_idx;            /* oldest full block */
+  __IO uint8_t rx_held;         /* both blocks full, OUT endpoint not armed */
+  __IO uint8_t tx_busy;         /* IN transfer of a result in flight */
+  uint16_t in_fill;             /* bytes received in in_buf[in_idx] */
+  __IO uint32_t out_head;       /* results produced */
+  __IO uint32_t out_tail;       /* results sent */
+} USBD_CDC_DspTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Private_FunctionPrototypes
+  * @{
+  */
+static int8_t USBD_CDC_Dsp_ItfInit(int instance, void **ctx);
+static int8_t USBD_CDC_Dsp_ItfDeInit(void *ctx);
+static int8_t USBD_CDC_Dsp_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t USBD_CDC_Dsp_Receive(void *ctx, uint8_t *pbuf, uint32_t *len);
+static int8_t USBD_CDC_Dsp_TxComplete(void *ctx);
+static void   USBD_CDC_Dsp_Arm(USBD_CDC_DspTypeDef *d);
+static void   USBD_CDC_Dsp_NextBlock(USBD_CDC_DspTypeDef *d);
+static void   USBD_CDC_Dsp_Kick(USBD_CDC_DspTypeDef *d);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Private_Variables
+  * @{
+  */
+static USBD_HandleTypeDef *USBD_CDC_Dsp_Dev;
+static USBD_CDC_DspTypeDef USBD_CDC_Dsp;
+
+/* Context of the other instances, their data lands in sink_buf and is dropped */
+static int USBD_CDC_Dsp_Sink[NUM_CDC_INSTANCES];
+static uint32_t USBD_CDC_Dsp_SinkBuf[CDC_DATA_HS_MAX_PACKET_SIZE / 4];
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Exported_Variables
+  * @{
+  */
+USBD_CDC_ItfTypeDef USBD_CDC_Dsp_fops =
+{
+  USBD_CDC_Dsp_ItfInit,
+  USBD_CDC_Dsp_ItfDeInit,
+  USBD_CDC_Dsp_Control,
+  USBD_CDC_Dsp_Receive,
+  USBD_CDC_Dsp_TxComplete,
+};
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Set up the filter and the transform, to be called before
+  *         USBD_CDC_RegisterInterface with USBD_CDC_Dsp_fops
+  * @param  pdev: device instance
+  * @param  coeffs: FIR coefficients, in time reversed order as CMSIS wants
+  *         them. Must stay valid while the stage runs.
+  * @param  num_taps: number of coefficients, up to USBD_CDC_DSP_MAX_TAPS
+  * @retval USBD_OK, USBD_FAIL on a bad filter length
+  */
+uint8_t USBD_CDC_Dsp_Init(USBD_HandleTypeDef *pdev, const float32_t *coeffs,
+                          uint16_t num_taps)
+{
+  USBD_CDC_DspTypeDef *d = &USBD_CDC_Dsp;
+
+  USBD_CDC_Dsp_Dev = pdev;
+  d->ready = 0U;
+
+  if ((coeffs == NULL) || (num_taps == 0U) || (num_taps > USBD_CDC_DSP_MAX_TAPS))
+  {
+    return USBD_FAIL;
+  }
+
+  if (arm_fir_decimate_init_f32(&d->fir, num_taps, USBD_CDC_DSP_DECIMATION,
+                                (float32_t *)coeffs, d->fir_state,
+                                USBD_CDC_DSP_BLOCK_SAMPLES) != ARM_MATH_SUCCESS)
+  {
+    return USBD_FAIL;
+  }
+
+#if (USB_FFT_ENABLED == 1)
+  /* only the tables of USBD_CDC_DSP_FFT_LEN are linked */
+  if (USB_FFT_RfftInit_f32(&d->rfft, USBD_CDC_DSP_FFT_LEN) != ARM_MATH_SUCCESS)
+#else
+  if (arm_rfft_fast_init_f32(&d->rfft, USBD_CDC_DSP_FFT_LEN) != ARM_MATH_SUCCESS)
+#endif
+  {
+    return USBD_FAIL;
+  }
+
+  d->ready = 1U;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Transform the oldest received block, from the main loop
+  * @note   The block buffer is handed back to the OUT endpoint as soon as
+  *         its samples are converted, the filter and the transform then
+  *         run while the next block comes in.
+  * @retval 1 if a block was transformed, 0 if there was none or both result
+  *         buffers are still waiting for the IN endpoint
+  */
+uint32_t USBD_CDC_Dsp_Process(void)
+{
+  USBD_CDC_DspTypeDef *d = &USBD_CDC_Dsp;
+  float32_t *out;
+
+  if (d->active == 0U)
+  {
+    return 0U;
+  }
+
+  /* Retry a result the IN endpoint was too busy for */
+  USBD_CDC_Dsp_Kick(d);
+
+  if ((d->in_full[d->proc_idx] == 0U) || ((d->out_head - d->out_tail) >= 2U))
+  {
+    return 0U;
+  }
+
+  arm_q15_to_float(d->in_buf[d->proc_idx], d->work, USBD_CDC_DSP_BLOCK_SAMPLES);
+
+  /* Done reading before the block is handed back. The OUT endpoint is not
+     armed while held, so the completion cannot race the restart. */
+  __DMB();
+  d->in_full[d->proc_idx] = 0U;
+  d->proc_idx ^= 1U;
+  if (d->rx_held != 0U)
+  {
+    d->rx_held = 0U;
+    USBD_CDC_Dsp_NextBlock(d);
+  }
+
+  out = d->out_buf[d->out_head & 1U];
+  arm_fir_decimate_f32(&d->fir, d->work, d->dec, USBD_CDC_DSP_BLOCK_SAMPLES);
+  arm_rfft_fast_f32(&d->rfft, d->dec, d->fft, 0U);
+  arm_cmplx_mag_f32(d->fft, out, USBD_CDC_DSP_BINS);
+
+  /* fft[1] is the real Nyquist term packed next to DC, not an imaginary part */
+  out[0] = fabsf(d->fft[0]);
+  d->stats.blocks++;
+
+  /* Result written before the IN side can see it */
+  __DMB();
+  d->out_head++;
+  USBD_CDC_Dsp_Kick(d);
+
+  return 1U;
+}
+
+/**
+  * @brief  Counters of the stage
+  * @retval pointer to the counters
+  */
+const USBD_CDC_DspStatsTypeDef *USBD_CDC_Dsp_GetStats(void)
+{
+  return &USBD_CDC_Dsp.stats;
+}
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_dsp_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Interface init: the stream restarts from an empty filter
+  * @param  instance: CDC instance
+  * @param  ctx: context handed back to the other callbacks
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Dsp_ItfInit(int instance, void **ctx)
+{
+  USBD_CDC_DspTypeDef *d = &USBD_CDC_Dsp;
+
+  if ((instance != USBD_CDC_DSP_INSTANCE) || (d->ready == 0U))
+  {
+    USBD_CDC_Dsp_Sink[instance] = instance;
+    *ctx = &USBD_CDC_Dsp_Sink[instance];
+    USBD_CDC_SetRxBuffer(USBD_CDC_Dsp_Dev, instance, (uint8_t *)USBD_CDC_Dsp_SinkBuf);
+    return USBD_OK;
+  }
+
+  memset(d->fir_state, 0, sizeof(d->fir_state));
+  memset(&d->stats, 0, sizeof(d->stats));
+  d->in_full[0] = 0U;
+  d->in_full[1] = 0U;
+  d->in_idx = 0U;
+  d->proc_idx = 0U;
+  d->rx_held = 0U;
+  d->tx_busy = 0U;
+  d->in_fill = 0U;
+  d->out_head = 0U;
+  d->out_tail = 0U;
+  d->active = 1U;
+
+  *ctx = d;
+
+  /* The class arms the first packet, the rest of the block follows */
+  USBD_CDC_SetRxBuffer(USBD_CDC_Dsp_Dev, instance, (uint8_t *)d->in_buf[0]);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Interface deinit
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Dsp_ItfDeInit(void *ctx)
+{
+  if (ctx == &USBD_CDC_Dsp)
+  {
+    USBD_CDC_Dsp.active = 0U;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Class requests: the line coding is only kept for the host
+  * @param  ctx: instance context
+  * @param  cmd: request code
+  * @param  pbuf: request data
+  * @param  length: request data length
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Dsp_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  uint8_t *line_coding = USBD_CDC_Dsp.line_coding;
+
+  UNUSED(ctx);
+
+  switch (cmd)
+  {
+  case CDC_SET_LINE_CODING:
+    memcpy(line_coding, pbuf, MIN(length, sizeof(USBD_CDC_Dsp.line_coding)));
+    break;
+
+  case CDC_GET_LINE_CODING:
+    memcpy(pbuf, line_coding, MIN(length, sizeof(USBD_CDC_Dsp.line_coding)));
+    break;
+
+  default:
+    break;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  A transfer into the current block ended, on a short packet or
+  *         with the block full
+  * @param  ctx: instance context
+  * @param  pbuf: where the transfer started
+  * @param  len: bytes received
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Dsp_Receive(void *ctx, uint8_t *pbuf, uint32_t *len)
+{
+  USBD_CDC_DspTypeDef *d = ctx;
+
+  UNUSED(pbuf);
+
+  if (ctx != &USBD_CDC_Dsp)
+  {
+    USBD_CDC_ReceivePacket(USBD_CDC_Dsp_Dev, *(int *)ctx);
+    return USBD_OK;
+  }
+
+  d->in_fill += (uint16_t)*len;
+
+  if (d->in_fill < USBD_CDC_DSP_BLOCK_BYTES)
+  {
+    USBD_CDC_Dsp_Arm(d);
+    return USBD_OK;
+  }
+
+  d->in_full[d->in_idx] = 1U;
+
+  if (d->in_full[d->in_idx ^ 1U] != 0U)
+  {
+    /* Leave the OUT endpoint NAKing until USBD_CDC_Dsp_Process frees a block */
+    d->rx_held = 1U;
+    d->stats.rx_held++;
+  }
+  else
+  {
+    USBD_CDC_Dsp_NextBlock(d);
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  IN transfer complete
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Dsp_TxComplete(void *ctx)
+{
+  USBD_CDC_DspTypeDef *d = ctx;
+
+  if ((ctx != &USBD_CDC_Dsp) || (d->tx_busy == 0U))
+  {
+    /* Completion of a transfer the application made, not ours */
+    return USBD_OK;
+  }
+
+  d->out_tail++;
+  d->tx_busy = 0U;
+  USBD_CDC_Dsp_Kick(d);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Arm the OUT endpoint for the rest of the current block
+  * @param  d: stage context
+  * @retval None
+  */
+static void USBD_CDC_Dsp_Arm(USBD_CDC_DspTypeDef *d)
+{
+  USBD_CDC_ReceiveBuffer(USBD_CDC_Dsp_Dev, USBD_CDC_DSP_INSTANCE,
+                         (uint8_t *)d->in_buf[d->in_idx] + d->in_fill,
+                         USBD_CDC_DSP_BLOCK_BYTES - d->in_fill);
+}
+
+/**
+  * @brief  Move on to the other block, which must be free, starting it with
+  *         what the last packet spilled past the full one
+  * @param  d: stage context
+  * @retval None
+  */
+static void USBD_CDC_Dsp_NextBlock(USBD_CDC_DspTypeDef *d)
+{
+  const uint8_t *spill = (const uint8_t *)d->in_buf[d->in_idx] + USBD_CDC_DSP_BLOCK_BYTES;
+
+  d->in_fill -= USBD_CDC_DSP_BLOCK_BYTES;
+  d->in_idx ^= 1U;
+  memcpy(d->in_buf[d->in_idx], spill, d->in_fill);
+
+  USBD_CDC_Dsp_Arm(d);
+}
+
+/**
+  * @brief  Send the oldest result if the IN endpoint is free
+  * @note   Called from USBD_CDC_Dsp_Process and from the IN completion: the
+  *         completion only runs while tx_busy is set, so it cannot race the
+  *         check below.
+  * @param  d: stage context
+  * @retval None
+  */
+static void USBD_CDC_Dsp_Kick(USBD_CDC_DspTypeDef *d)
+{
+  if ((d->tx_busy != 0U) || (d->out_head == d->out_tail))
+  {
+    return;
+  }
+
+  d->tx_busy = 1U;
+  if (USBD_CDC_TransmitBuffer(USBD_CDC_Dsp_Dev, USBD_CDC_DSP_INSTANCE,
+                              (const uint8_t *)d->out_buf[d->out_tail & 1U],
+                              sizeof(d->out_buf[0])) != USBD_OK)
+  {
+    d->tx_busy = 0U;
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_DSP_ENABLED */
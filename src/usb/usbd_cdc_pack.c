@@ -0,0 +1,189 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_pack.c
+  * @brief   Delta packing of CDC telemetry, see usbd_cdc_pack.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_pack.h"
+
+#if (USBD_CDC_PACK_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pack
+  * @{
+  */
+
+/** @defgroup usbd_cdc_pack_Private_Defines
+  * @{
+  */
+/* Packed bytes gathered before they go to the ring, one packet */
+#define USBD_CDC_PACK_STAGE                         CDC_DATA_FS_MAX_PACKET_SIZE
+
+/* Longest varint of a sample */
+#define USBD_CDC_PACK_WORST(width)                  (((width) == 2U) ? 3U : 5U)
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_pack_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Bind a packer to a CDC instance
+  * @param  p: packer
+  * @param  pdev: device instance
+  * @param  instance: CDC instance, with its transmit ring
+  * @param  width: bytes per sample, 2 or 4
+  * @param  numChannels: samples per frame, 1 to USBD_CDC_PACK_MAX_CHANNELS
+  * @retval USBD_OK, USBD_FAIL on a bad format
+  */
+uint8_t USBD_CDC_Pack_Init(USBD_CDC_PackTypeDef *p, USBD_HandleTypeDef *pdev,
+                           int instance, uint8_t width, uint8_t numChannels)
+{
+  if (((width != 2U) && (width != 4U)) ||
+      (numChannels == 0U) || (numChannels > USBD_CDC_PACK_MAX_CHANNELS))
+  {
+    return USBD_FAIL;
+  }
+
+  memset(p, 0, sizeof(*p));
+  p->pdev = pdev;
+  p->instance = instance;
+  p->width = width;
+  p->numChannels = numChannels;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Start the stream over: predictors back to zero, first channel
+  *         next, any incomplete sample dropped
+  * @param  p: packer
+  * @retval None
+  */
+void USBD_CDC_Pack_Reset(USBD_CDC_PackTypeDef *p)
+{
+  memset(p->prev, 0, sizeof(p->prev));
+  p->channel = 0U;
+  p->partial = 0U;
+}
+
+/**
+  * @brief  Pack raw samples onto the transmit ring
+  * @param  p: packer
+  * @param  pbuff: little endian samples, frames of numChannels
+  * @param  length: number of bytes, need not be whole samples
+  * @retval number of bytes taken, less than length if the ring is full
+  */
+uint32_t USBD_CDC_Pack_Write(USBD_CDC_PackTypeDef *p, const uint8_t *pbuff,
+                             uint32_t length)
+{
+  uint8_t stage[USBD_CDC_PACK_STAGE];
+  uint32_t staged = 0U;
+  uint32_t width = p->width;
+  uint32_t budget;
+  uint32_t taken = 0U;
+  uint32_t n;
+  uint32_t v;
+  uint32_t z;
+  const uint8_t *s;
+
+  /* samples the ring takes whatever their values */
+  budget = USBD_CDC_GetTxFree(p->pdev, p->instance) / USBD_CDC_PACK_WORST(width);
+
+  while (taken < length)
+  {
+    if ((p->partial == 0U) && ((length - taken) >= width))
+    {
+      if (budget == 0U)
+      {
+        break;
+      }
+      s = pbuff + taken;
+      taken += width;
+    }
+    else
+    {
+      n = MIN(width - p->partial, length - taken);
+      if (((p->partial + n) == width) && (budget == 0U))
+      {
+        break;
+      }
+      memcpy(&p->part[p->partial], pbuff + taken, n);
+      p->partial += (uint8_t)n;
+      taken += n;
+      if (p->partial < width)
+      {
+        break;
+      }
+      p->partial = 0U;
+      s = p->part;
+    }
+    budget--;
+
+    if (width == 2U)
+    {
+      int16_t d;
+
+      v = (uint32_t)s[0] | ((uint32_t)s[1] << 8);
+      d = (int16_t)(uint16_t)(v - p->prev[p->channel]);
+      z = (uint16_t)(((uint32_t)(uint16_t)d << 1) ^ (uint32_t)(uint16_t)(d >> 15));
+    }
+    else
+    {
+      int32_t d;
+
+      v = (uint32_t)s[0] | ((uint32_t)s[1] << 8) |
+          ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+      d = (int32_t)(v - p->prev[p->channel]);
+      z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    }
+
+    p->prev[p->channel] = v;
+    if (++p->channel == p->numChannels)
+    {
+      p->channel = 0U;
+    }
+
+    while (z >= 0x80U)
+    {
+      stage[staged++] = (uint8_t)(z | 0x80U);
+      z >>= 7;
+    }
+    stage[staged++] = (uint8_t)z;
+
+    if (staged > (USBD_CDC_PACK_STAGE - USBD_CDC_PACK_WORST(width)))
+    {
+      p->bytes_out += USBD_CDC_Write(p->pdev, p->instance, stage, staged);
+      staged = 0U;
+    }
+  }
+
+  if (staged != 0U)
+  {
+    p->bytes_out += USBD_CDC_Write(p->pdev, p->instance, stage, staged);
+  }
+  p->bytes_in += taken;
+
+  return taken;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_PACK_ENABLED */
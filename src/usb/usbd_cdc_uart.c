@@ -0,0 +1,574 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_uart.c
+  * @brief   USB to UART bridge on top of the CDC class, see usbd_cdc_uart.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_cdc_uart.h"
+
+#if (USBD_CDC_UART_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_uart
+  * @{
+  */
+
+/** @defgroup usbd_cdc_uart_Private_Defines
+  * @{
+  */
+#define USBD_CDC_UART_TX_MASK                       (USBD_CDC_UART_TX_SLOTS - 1U)
+
+/* Flags of a channel in the DMA ISR / IFCR registers */
+#define USBD_CDC_UART_DMA_FLAGS(ch, f)              ((uint32_t)(f) << (4U * ((ch) - 1U)))
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  int instance;
+  USBD_CDC_UartTypeDef *bridge;     /* NULL if the instance is not bridged */
+} USBD_CDC_UartPortTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Private_FunctionPrototypes
+  * @{
+  */
+static int8_t USBD_CDC_Uart_ItfInit(int instance, void **ctx);
+static int8_t USBD_CDC_Uart_ItfDeInit(void *ctx);
+static int8_t USBD_CDC_Uart_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t USBD_CDC_Uart_Receive(void *ctx, uint8_t *pbuf, uint32_t *len);
+static int8_t USBD_CDC_Uart_TxComplete(void *ctx);
+static void   USBD_CDC_Uart_Start(USBD_CDC_UartTypeDef *b);
+static void   USBD_CDC_Uart_Apply(USBD_CDC_UartTypeDef *b);
+static void   USBD_CDC_Uart_RxKick(USBD_CDC_UartTypeDef *b);
+static void   USBD_CDC_Uart_TxKick(USBD_CDC_UartTypeDef *b);
+static void   USBD_CDC_Uart_TxDone(USBD_CDC_UartTypeDef *b);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Private_Variables
+  * @{
+  */
+static USBD_HandleTypeDef *USBD_CDC_Uart_Dev;
+static USBD_CDC_UartPortTypeDef USBD_CDC_Uart_Port[NUM_CDC_INSTANCES];
+
+/* 115200 8N1 until the host says otherwise */
+static const uint8_t USBD_CDC_Uart_DefaultCoding[7] = { 0x00, 0xC2, 0x01, 0x00, 0, 0, 8 };
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Exported_Variables
+  * @{
+  */
+USBD_CDC_ItfTypeDef USBD_CDC_Uart_fops =
+{
+  USBD_CDC_Uart_ItfInit,
+  USBD_CDC_Uart_ItfDeInit,
+  USBD_CDC_Uart_Control,
+  USBD_CDC_Uart_Receive,
+  USBD_CDC_Uart_TxComplete,
+};
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Bridge a CDC instance to a USART, to be called before
+  *         USBD_CDC_RegisterInterface with USBD_CDC_Uart_fops
+  * @param  pdev: device instance
+  * @param  instance: CDC instance
+  * @param  bridge: bridge state, must stay valid while the device runs
+  * @param  cfg: USART and DMA channels of the bridge
+  * @retval USBD_OK, USBD_FAIL for an invalid instance
+  */
+uint8_t USBD_CDC_Uart_Register(USBD_HandleTypeDef *pdev, int instance,
+                               USBD_CDC_UartTypeDef *bridge,
+                               const USBD_CDC_UartConfigTypeDef *cfg)
+{
+  if ((instance < 0) || (instance >= NUM_CDC_INSTANCES))
+  {
+    return USBD_FAIL;
+  }
+
+  memset(bridge, 0, sizeof(*bridge));
+  bridge->cfg = cfg;
+  bridge->instance = instance;
+  memcpy(bridge->line_coding, USBD_CDC_Uart_DefaultCoding, sizeof(bridge->line_coding));
+
+  USBD_CDC_Uart_Dev = pdev;
+  USBD_CDC_Uart_Port[instance].bridge = bridge;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USART interrupt of a bridge: idle line, line errors and the end
+  *         of transmission a line coding change waits for
+  * @param  bridge: bridge state
+  * @retval None
+  */
+void USBD_CDC_Uart_IRQHandler(USBD_CDC_UartTypeDef *bridge)
+{
+  USART_TypeDef *uart = bridge->cfg->Instance;
+  uint32_t isr = uart->ISR;
+
+  if ((isr & USART_ISR_ORE) != 0U)
+  {
+    bridge->stats.overruns++;
+  }
+  if ((isr & (USART_ISR_FE | USART_ISR_NE | USART_ISR_PE)) != 0U)
+  {
+    bridge->stats.line_errors++;
+  }
+  uart->ICR = isr & (USART_ICR_IDLECF | USART_ICR_ORECF | USART_ICR_FECF |
+                     USART_ICR_NCF | USART_ICR_PECF);
+
+  if (bridge->running == 0U)
+  {
+    return;
+  }
+
+  if ((isr & USART_ISR_IDLE) != 0U)
+  {
+    USBD_CDC_Uart_RxKick(bridge);
+  }
+
+  if (((uart->CR1 & USART_CR1_TCIE) != 0U) && ((isr & USART_ISR_TC) != 0U))
+  {
+    /* Everything queued before the line coding change is on the wire */
+    uart->CR1 &= ~USART_CR1_TCIE;
+    USBD_CDC_Uart_Apply(bridge);
+    USBD_CDC_Uart_TxKick(bridge);
+  }
+}
+
+/**
+  * @brief  DMA interrupt of a bridge, for either of its channels
+  * @param  bridge: bridge state
+  * @retval None
+  */
+void USBD_CDC_Uart_DmaIRQHandler(USBD_CDC_UartTypeDef *bridge)
+{
+  const USBD_CDC_UartConfigTypeDef *cfg = bridge->cfg;
+  uint32_t isr = cfg->Dma->ISR;
+  uint32_t rx = USBD_CDC_UART_DMA_FLAGS(cfg->RxDmaCh, DMA_ISR_HTIF1 | DMA_ISR_TCIF1);
+  uint32_t tx = USBD_CDC_UART_DMA_FLAGS(cfg->TxDmaCh, DMA_ISR_TCIF1);
+
+  if ((isr & rx) != 0U)
+  {
+    cfg->Dma->IFCR = isr & rx;
+    if (bridge->running != 0U)
+    {
+      USBD_CDC_Uart_RxKick(bridge);
+    }
+  }
+
+  if ((isr & tx) != 0U)
+  {
+    cfg->Dma->IFCR = tx;
+    if (bridge->running != 0U)
+    {
+      USBD_CDC_Uart_TxDone(bridge);
+    }
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup usbd_cdc_uart_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Interface init: start the bridge of the instance, if any
+  * @param  instance: CDC instance
+  * @param  ctx: context handed back to the other callbacks
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Uart_ItfInit(int instance, void **ctx)
+{
+  USBD_CDC_UartPortTypeDef *port = &USBD_CDC_Uart_Port[instance];
+
+  port->instance = instance;
+  *ctx = port;
+
+  if (port->bridge != NULL)
+  {
+    USBD_CDC_SetTxZlp(USBD_CDC_Uart_Dev, instance, 1U);
+    USBD_CDC_Uart_Start(port->bridge);
+    USBD_CDC_SetRxBuffer(USBD_CDC_Uart_Dev, instance, port->bridge->tx_slot[0]);
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Interface deinit: stop the USART and its DMA channels
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Uart_ItfDeInit(void *ctx)
+{
+  USBD_CDC_UartPortTypeDef *port = ctx;
+  USBD_CDC_UartTypeDef *b = port->bridge;
+
+  if (b != NULL)
+  {
+    b->running = 0U;
+    b->cfg->Instance->CR1 = 0U;
+    b->cfg->RxDma->CCR = 0U;
+    b->cfg->TxDma->CCR = 0U;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Class requests: line coding
+  * @param  ctx: instance context
+  * @param  cmd: request code
+  * @param  pbuf: request data
+  * @param  length: request data length
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Uart_Control(void *ctx, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  USBD_CDC_UartPortTypeDef *port = ctx;
+  USBD_CDC_UartTypeDef *b = port->bridge;
+
+  switch (cmd)
+  {
+  case CDC_SET_LINE_CODING:
+    if ((b != NULL) && (length >= sizeof(b->line_coding)))
+    {
+      memcpy(b->line_coding, pbuf, sizeof(b->line_coding));
+
+      /* Applied from the USART interrupt once the transmitter is done with
+         what is queued; the DMA completion enables it if still busy */
+      b->coding_pending = 1U;
+      if (b->tx_dma_slots == 0U)
+      {
+        b->cfg->Instance->CR1 |= USART_CR1_TCIE;
+      }
+    }
+    break;
+
+  case CDC_GET_LINE_CODING:
+    memcpy(pbuf, (b != NULL) ? b->line_coding : USBD_CDC_Uart_DefaultCoding,
+           MIN(length, sizeof(USBD_CDC_Uart_DefaultCoding)));
+    break;
+
+  default:
+    break;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  OUT packet received in the current slot: queue the slot for the
+  *         transmit DMA and move the endpoint on to the next one
+  * @param  ctx: instance context
+  * @param  pbuf: packet, NULL when it was left in packet memory
+  * @param  len: packet length
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Uart_Receive(void *ctx, uint8_t *pbuf, uint32_t *len)
+{
+  USBD_CDC_UartPortTypeDef *port = ctx;
+  USBD_CDC_UartTypeDef *b = port->bridge;
+  uint32_t slot;
+
+  if ((b == NULL) || (*len == 0U))
+  {
+    USBD_CDC_ReceivePacket(USBD_CDC_Uart_Dev, port->instance);
+    return USBD_OK;
+  }
+
+  slot = b->tx_head & USBD_CDC_UART_TX_MASK;
+  if (pbuf == NULL)
+  {
+    USBD_CDC_ReadRxData(USBD_CDC_Uart_Dev, port->instance, 0U, b->tx_slot[slot], *len);
+  }
+  b->tx_slot_len[slot] = *len;
+  b->tx_head++;
+
+  if ((b->tx_head - b->tx_tail) < USBD_CDC_UART_TX_SLOTS)
+  {
+    USBD_CDC_SetRxBuffer(USBD_CDC_Uart_Dev, port->instance,
+                         b->tx_slot[b->tx_head & USBD_CDC_UART_TX_MASK]);
+    USBD_CDC_ReceivePacket(USBD_CDC_Uart_Dev, port->instance);
+  }
+  else
+  {
+    b->out_stalled = 1U;
+    b->stats.out_stalls++;
+  }
+
+  USBD_CDC_Uart_TxKick(b);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  IN transfer complete: release the part of rx_buf it took
+  * @param  ctx: instance context
+  * @retval USBD_OK
+  */
+static int8_t USBD_CDC_Uart_TxComplete(void *ctx)
+{
+  USBD_CDC_UartPortTypeDef *port = ctx;
+  USBD_CDC_UartTypeDef *b = port->bridge;
+
+  if ((b == NULL) || (b->in_len == 0U))
+  {
+    return USBD_OK;
+  }
+
+  b->stats.rx_bytes += b->in_len;
+  b->rx_tail += b->in_len;
+  if (b->rx_tail >= USBD_CDC_UART_RX_SIZE)
+  {
+    b->rx_tail -= USBD_CDC_UART_RX_SIZE;
+  }
+  b->in_len = 0U;
+
+  USBD_CDC_Uart_RxKick(b);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Program the DMA channels and the USART and start reception
+  * @param  b: bridge state
+  * @retval None
+  */
+static void USBD_CDC_Uart_Start(USBD_CDC_UartTypeDef *b)
+{
+  const USBD_CDC_UartConfigTypeDef *cfg = b->cfg;
+
+  b->rx_tail = 0U;
+  b->in_len = 0U;
+  b->tx_head = 0U;
+  b->tx_tail = 0U;
+  b->tx_dma_slots = 0U;
+  b->tx_dma_len = 0U;
+  b->out_stalled = 0U;
+  b->coding_pending = 0U;
+
+  cfg->Instance->CR1 = 0U;
+  cfg->RxDma->CCR = 0U;
+  cfg->TxDma->CCR = 0U;
+  cfg->Dma->IFCR = USBD_CDC_UART_DMA_FLAGS(cfg->RxDmaCh, DMA_IFCR_CGIF1) |
+                   USBD_CDC_UART_DMA_FLAGS(cfg->TxDmaCh, DMA_IFCR_CGIF1);
+
+  /* Receive: circular into rx_buf, interrupts at each half */
+  cfg->RxDma->CPAR = (uint32_t)&cfg->Instance->RDR;
+  cfg->RxDma->CMAR = (uint32_t)b->rx_buf;
+  cfg->RxDma->CNDTR = USBD_CDC_UART_RX_SIZE;
+  cfg->RxDma->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+
+  /* Transmit: one slot, or a run of adjacent full slots, at a time */
+  cfg->TxDma->CPAR = (uint32_t)&cfg->Instance->TDR;
+  cfg->TxDma->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE;
+
+  cfg->Instance->CR3 = USART_CR3_DMAR | USART_CR3_DMAT | USART_CR3_EIE;
+  cfg->Instance->CR1 = USART_CR1_IDLEIE | USART_CR1_TE | USART_CR1_RE;
+  USBD_CDC_Uart_Apply(b);
+
+  b->running = 1U;
+}
+
+/**
+  * @brief  Program the USART with the current line coding
+  * @param  b: bridge state
+  * @retval None
+  */
+static void USBD_CDC_Uart_Apply(USBD_CDC_UartTypeDef *b)
+{
+  USART_TypeDef *uart = b->cfg->Instance;
+  const uint8_t *lc = b->line_coding;
+  uint32_t baud = lc[0] | (lc[1] << 8) | (lc[2] << 16) | ((uint32_t)lc[3] << 24);
+  uint32_t cr1 = uart->CR1 & ~(USART_CR1_UE | USART_CR1_M | USART_CR1_PCE |
+                               USART_CR1_PS | USART_CR1_OVER8);
+  uint32_t cr2 = uart->CR2 & ~USART_CR2_STOP;
+  uint32_t div;
+
+  b->coding_pending = 0U;
+  if (baud == 0U)
+  {
+    return;
+  }
+
+  /* bParityType: 0 none, 1 odd, 2 even; the parity bit counts in M */
+  if ((lc[5] == 1U) || (lc[5] == 2U))
+  {
+    cr1 |= USART_CR1_PCE | ((lc[5] == 1U) ? USART_CR1_PS : 0U);
+    if (lc[6] >= 8U)
+    {
+      cr1 |= USART_CR1_M;
+    }
+  }
+
+  /* bCharFormat: 0 one, 1 one and a half, 2 two stop bits */
+  if (lc[4] == 1U)
+  {
+    cr2 |= USART_CR2_STOP_0 | USART_CR2_STOP_1;
+  }
+  else if (lc[4] == 2U)
+  {
+    cr2 |= USART_CR2_STOP_1;
+  }
+
+  if (b->cfg->ClockHz / baud >= 16U)
+  {
+    div = (b->cfg->ClockHz + baud / 2U) / baud;
+  }
+  else
+  {
+    /* Oversampling by 8 for the highest rates: BRR[2:0] = USARTDIV[3:0] >> 1 */
+    cr1 |= USART_CR1_OVER8;
+    div = (2U * b->cfg->ClockHz + baud / 2U) / baud;
+    div = (div & ~0xFU) | ((div & 0xFU) >> 1);
+  }
+
+  uart->CR1 = cr1;
+  uart->BRR = div;
+  uart->CR2 = cr2;
+  uart->CR1 = cr1 | USART_CR1_UE;
+}
+
+/**
+  * @brief  Hand what the receive DMA wrote to the IN endpoint, if it is idle
+  * @param  b: bridge state
+  * @retval None
+  */
+static void USBD_CDC_Uart_RxKick(USBD_CDC_UartTypeDef *b)
+{
+  uint32_t head;
+  uint32_t len;
+
+  if (b->in_len != 0U)
+  {
+    return;
+  }
+
+  head = USBD_CDC_UART_RX_SIZE - b->cfg->RxDma->CNDTR;
+  if (head >= USBD_CDC_UART_RX_SIZE)
+  {
+    head = 0U;
+  }
+  if (head == b->rx_tail)
+  {
+    return;
+  }
+
+  /* Up to the DMA position, or to the end of the buffer if it wrapped */
+  len = (head > b->rx_tail) ? (head - b->rx_tail) : (USBD_CDC_UART_RX_SIZE - b->rx_tail);
+
+  b->in_len = len;
+  if (USBD_CDC_TransmitBuffer(USBD_CDC_Uart_Dev, b->instance, &b->rx_buf[b->rx_tail], len) != USBD_OK)
+  {
+    b->in_len = 0U;
+  }
+}
+
+/**
+  * @brief  Start the transmit DMA on the filled slots, if it is idle. Slots
+  *         are adjacent in memory, so full slots up to the first short one
+  *         go out as one transfer, as long as the run does not wrap.
+  * @param  b: bridge state
+  * @retval None
+  */
+static void USBD_CDC_Uart_TxKick(USBD_CDC_UartTypeDef *b)
+{
+  DMA_Channel_TypeDef *dma = b->cfg->TxDma;
+  uint32_t first;
+  uint32_t i;
+  uint32_t len;
+  uint32_t bytes = 0U;
+
+  if ((b->tx_dma_slots != 0U) || (b->coding_pending != 0U) || (b->tx_head == b->tx_tail))
+  {
+    return;
+  }
+
+  first = b->tx_tail & USBD_CDC_UART_TX_MASK;
+  i = b->tx_tail;
+  do
+  {
+    len = b->tx_slot_len[i & USBD_CDC_UART_TX_MASK];
+    bytes += len;
+    i++;
+  } while ((i != b->tx_head) && (len == CDC_DATA_FS_MAX_PACKET_SIZE) &&
+           ((i & USBD_CDC_UART_TX_MASK) != 0U));
+
+  b->tx_dma_slots = i - b->tx_tail;
+  b->tx_dma_len = bytes;
+  dma->CCR &= ~DMA_CCR_EN;
+  dma->CMAR = (uint32_t)b->tx_slot[first];
+  dma->CNDTR = bytes;
+  dma->CCR |= DMA_CCR_EN;
+}
+
+/**
+  * @brief  Transmit DMA complete: free its slots, let the host send more
+  * @param  b: bridge state
+  * @retval None
+  */
+static void USBD_CDC_Uart_TxDone(USBD_CDC_UartTypeDef *b)
+{
+  b->stats.tx_bytes += b->tx_dma_len;
+  b->tx_tail += b->tx_dma_slots;
+  b->tx_dma_slots = 0U;
+  b->tx_dma_len = 0U;
+
+  if (b->out_stalled != 0U)
+  {
+    b->out_stalled = 0U;
+    USBD_CDC_SetRxBuffer(USBD_CDC_Uart_Dev, b->instance,
+                         b->tx_slot[b->tx_head & USBD_CDC_UART_TX_MASK]);
+    USBD_CDC_ReceivePacket(USBD_CDC_Uart_Dev, b->instance);
+  }
+
+  if (b->coding_pending != 0U)
+  {
+    b->cfg->Instance->CR1 |= USART_CR1_TCIE;
+  }
+  else
+  {
+    USBD_CDC_Uart_TxKick(b);
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_CDC_UART_ENABLED */
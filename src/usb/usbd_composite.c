@@ -0,0 +1,839 @@
+/**
+  ******************************************************************************
+  * @file    usbd_composite.c
+  * @brief   Several class drivers behind one USBD core, see usbd_composite.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_conf.h"
+#include "usbd_core.h"
+#include "usbd_composite.h"
+
+#if (USBD_COMPOSITE_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_Composite
+  * @{
+  */
+
+/** @defgroup USBD_Composite_Private_Defines
+  * @{
+  */
+/* Which configuration descriptor of the functions to join */
+#define USBD_COMPOSITE_DESC_FS                      0U
+#define USBD_COMPOSITE_DESC_HS                      1U
+#define USBD_COMPOSITE_DESC_OTHER_SPEED             2U
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t  USBD_Composite_ClassInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_Composite_ClassDeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_Composite_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_Composite_EP0_TxSent (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_Composite_EP0_RxReady (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_Composite_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_Composite_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_Composite_SOF (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_Composite_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_Composite_IsoOUTIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  *USBD_Composite_GetFSCfgDesc (uint16_t *length);
+#if (USBD_FS_ONLY == 0)
+static uint8_t  *USBD_Composite_GetHSCfgDesc (uint16_t *length);
+static uint8_t  *USBD_Composite_GetOtherSpeedCfgDesc (uint16_t *length);
+static uint8_t  *USBD_Composite_GetDeviceQualifierDesc (uint16_t *length);
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+static uint8_t  *USBD_Composite_GetUsrStrDesc (USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length);
+#endif
+#if (USBD_LPM_ENABLED == 1)
+static uint8_t  USBD_Composite_LPM (USBD_HandleTypeDef *pdev, uint8_t state);
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Private_Variables
+  * @{
+  */
+USBD_ClassTypeDef  USBD_COMPOSITE =
+{
+  USBD_Composite_ClassInit,
+  USBD_Composite_ClassDeInit,
+  USBD_Composite_Setup,
+  USBD_Composite_EP0_TxSent,
+  USBD_Composite_EP0_RxReady,
+  USBD_Composite_DataIn,
+  USBD_Composite_DataOut,
+  USBD_Composite_SOF,
+  USBD_Composite_IsoINIncomplete,
+  USBD_Composite_IsoOUTIncomplete,
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_Composite_GetFSCfgDesc,
+  NULL,
+  NULL,
+#else
+  USBD_Composite_GetHSCfgDesc,
+  USBD_Composite_GetFSCfgDesc,
+  USBD_Composite_GetOtherSpeedCfgDesc,
+  USBD_Composite_GetDeviceQualifierDesc,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  USBD_Composite_GetUsrStrDesc,
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  USBD_Composite_LPM,
+#endif
+};
+
+static USBD_Composite_HandleTypeDef *USBD_Composite_Handle;
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Point pClassData and pUserData of the device at a function
+  * @note   What the active function left there is saved first, so a
+  *         switch back restores it. Nests: an interrupt switching in the
+  *         middle of another function's callback switches back before it
+  *         returns.
+  * @param  pdev: device instance
+  * @param  idx: function to activate
+  * @retval function active before
+  */
+static uint8_t USBD_Composite_Switch(USBD_HandleTypeDef *pdev, uint8_t idx)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint32_t primask;
+  uint8_t prev;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  prev = hcomp->active;
+  if (idx != prev)
+  {
+    hcomp->func[prev].pClassData = pdev->pClassData;
+    hcomp->func[prev].pUserData = pdev->pUserData;
+    pdev->pClassData = hcomp->func[idx].pClassData;
+    pdev->pUserData = hcomp->func[idx].pUserData;
+    hcomp->active = idx;
+  }
+  __set_PRIMASK(primask);
+
+  return prev;
+}
+
+/**
+  * @brief  Function owning an endpoint
+  * @param  hcomp: composite handle
+  * @param  ep_addr: endpoint address, direction bit included
+  * @retval function index, USBD_COMPOSITE_NONE if none
+  */
+static uint8_t USBD_Composite_EpOwner(USBD_Composite_HandleTypeDef *hcomp, uint8_t ep_addr)
+{
+  if ((ep_addr & 0x80U) != 0U)
+  {
+    return hcomp->in_owner[ep_addr & 0x0FU];
+  }
+  return hcomp->out_owner[ep_addr & 0x0FU];
+}
+
+/**
+  * @brief  Check, then take, the interfaces and endpoints a configuration
+  *         descriptor declares
+  * @note   A function may name its own interface again, for alternate
+  *         settings.
+  * @param  hcomp: composite handle
+  * @param  idx: function the descriptor belongs to
+  * @param  desc: configuration descriptor
+  * @param  len: its length
+  * @param  apply: 0 to check only, 1 to fill the routing tables
+  * @retval 1 if nothing belongs to another function, 0 otherwise
+  */
+static uint8_t USBD_Composite_Claim(USBD_Composite_HandleTypeDef *hcomp, uint8_t idx,
+                                    const uint8_t *desc, uint16_t len, uint8_t apply)
+{
+  uint16_t pos = USB_LEN_CFG_DESC;
+  uint8_t *slot;
+
+  while ((pos + 2U) <= len)
+  {
+    if ((desc[pos] < 2U) || ((pos + desc[pos]) > len))
+    {
+      return 0U;
+    }
+
+    slot = NULL;
+    if ((desc[pos + 1U] == USB_DESC_TYPE_INTERFACE) && (desc[pos] >= USB_LEN_IF_DESC))
+    {
+      if (desc[pos + 2U] >= USBD_MAX_NUM_INTERFACES)
+      {
+        return 0U;
+      }
+      slot = &hcomp->itf_owner[desc[pos + 2U]];
+    }
+    else if ((desc[pos + 1U] == USB_DESC_TYPE_ENDPOINT) && (desc[pos] >= USB_LEN_EP_DESC))
+    {
+      slot = ((desc[pos + 2U] & 0x80U) != 0U) ? &hcomp->in_owner[desc[pos + 2U] & 0x0FU] :
+                                                &hcomp->out_owner[desc[pos + 2U] & 0x0FU];
+    }
+
+    if (slot != NULL)
+    {
+      if ((*slot != USBD_COMPOSITE_NONE) && (*slot != idx))
+      {
+        return 0U;
+      }
+      if (apply)
+      {
+        *slot = idx;
+      }
+    }
+    pos += desc[pos];
+  }
+  return 1U;
+}
+
+/**
+  * @brief  Configuration descriptor of a function
+  * @param  pclass: class of the function
+  * @param  which: USBD_COMPOSITE_DESC_xxx, the full speed one stands in
+  *         for a function without the one asked for
+  * @param  length: descriptor length
+  * @retval descriptor, NULL if the function has none
+  */
+static uint8_t *USBD_Composite_FuncDesc(const USBD_ClassTypeDef *pclass, uint8_t which,
+                                        uint16_t *length)
+{
+  uint8_t *(*get)(uint16_t *length) = pclass->GetFSConfigDescriptor;
+
+  if ((which == USBD_COMPOSITE_DESC_HS) && (pclass->GetHSConfigDescriptor != NULL))
+  {
+    get = pclass->GetHSConfigDescriptor;
+  }
+  else if ((which == USBD_COMPOSITE_DESC_OTHER_SPEED) &&
+           (pclass->GetOtherSpeedConfigDescriptor != NULL))
+  {
+    get = pclass->GetOtherSpeedConfigDescriptor;
+  }
+
+  *length = 0U;
+  if (get == NULL)
+  {
+    return NULL;
+  }
+  return get(length);
+}
+
+/**
+  * @brief  Join the configuration descriptors of the functions
+  * @param  hcomp: composite handle
+  * @param  which: USBD_COMPOSITE_DESC_xxx
+  * @param  length: length of the result
+  * @retval hcomp->cfg_desc, NULL if it does not fit
+  */
+static uint8_t *USBD_Composite_Build(USBD_Composite_HandleTypeDef *hcomp, uint8_t which,
+                                     uint16_t *length)
+{
+  uint8_t *desc;
+  uint16_t len;
+  uint16_t total = USB_LEN_CFG_DESC;
+  uint8_t itfs = 0U;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    desc = USBD_Composite_FuncDesc(hcomp->func[i].pClass, which, &len);
+    if ((desc == NULL) || (len < USB_LEN_CFG_DESC))
+    {
+      continue;
+    }
+    if ((total + len - USB_LEN_CFG_DESC) > USBD_COMPOSITE_CFG_DESC_SIZE)
+    {
+      *length = 0U;
+      return NULL;
+    }
+    if (total == USB_LEN_CFG_DESC)
+    {
+      /* header of the first function: type (7 for other speed),
+         configuration value, attributes and power */
+      memcpy(hcomp->cfg_desc, desc, USB_LEN_CFG_DESC);
+    }
+    memcpy(&hcomp->cfg_desc[total], &desc[USB_LEN_CFG_DESC], len - USB_LEN_CFG_DESC);
+    total += len - USB_LEN_CFG_DESC;
+    itfs += desc[4];
+  }
+
+  hcomp->cfg_desc[2] = LOBYTE(total);
+  hcomp->cfg_desc[3] = HIBYTE(total);
+  hcomp->cfg_desc[4] = itfs;
+  *length = total;
+  return hcomp->cfg_desc;
+}
+
+/**
+  * @brief  Run Setup of one function
+  * @param  pdev: device instance
+  * @param  idx: function
+  * @param  req: request
+  * @retval status of the function
+  */
+static uint8_t USBD_Composite_FuncSetup(USBD_HandleTypeDef *pdev, uint8_t idx,
+                                        USBD_SetupReqTypedef *req)
+{
+  USBD_ClassTypeDef *pclass = USBD_Composite_Handle->func[idx].pClass;
+  uint8_t prev;
+  uint8_t ret = USBD_FAIL;
+
+  if (pclass->Setup != NULL)
+  {
+    prev = USBD_Composite_Switch(pdev, idx);
+    ret = pclass->Setup(pdev, req);
+    USBD_Composite_Switch(pdev, prev);
+  }
+  return ret;
+}
+
+/**
+  * @brief  Run an endpoint callback of the function owning the endpoint
+  * @param  pdev: device instance
+  * @param  idx: function, USBD_COMPOSITE_NONE for none
+  * @param  cb: callback of that function
+  * @param  epnum: endpoint number
+  * @retval status of the function, USBD_FAIL without one
+  */
+static uint8_t USBD_Composite_FuncEp(USBD_HandleTypeDef *pdev, uint8_t idx,
+                                     uint8_t (*cb)(USBD_HandleTypeDef *pdev, uint8_t epnum),
+                                     uint8_t epnum)
+{
+  uint8_t prev;
+  uint8_t ret;
+
+  if (cb == NULL)
+  {
+    return USBD_FAIL;
+  }
+  prev = USBD_Composite_Switch(pdev, idx);
+  ret = cb(pdev, epnum);
+  USBD_Composite_Switch(pdev, prev);
+  return ret;
+}
+
+/**
+  * @brief  USBD_Composite_ClassInit
+  *         Initialize every function
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status: USBD_FAIL if one of them failed
+  */
+static uint8_t  USBD_Composite_ClassInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t ret = USBD_OK;
+  uint8_t prev;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    prev = USBD_Composite_Switch(pdev, i);
+    if (hcomp->func[i].pClass->Init(pdev, cfgidx) != USBD_OK)
+    {
+      ret = USBD_FAIL;
+    }
+    USBD_Composite_Switch(pdev, prev);
+  }
+  return ret;
+}
+
+/**
+  * @brief  USBD_Composite_ClassDeInit
+  *         DeInitialize every function
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_Composite_ClassDeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t prev;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    prev = USBD_Composite_Switch(pdev, i);
+    hcomp->func[i].pClass->DeInit(pdev, cfgidx);
+    USBD_Composite_Switch(pdev, prev);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_Composite_Setup
+  *         Route a request to the function of its interface or endpoint.
+  *         Standard requests to the device (remote wakeup feature) reach
+  *         every function, class and vendor ones the first that accepts.
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_Composite_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t idx;
+  uint8_t i;
+
+  switch (req->bmRequest & USB_REQ_RECIPIENT_MASK)
+  {
+  case USB_REQ_RECIPIENT_INTERFACE:
+    idx = (LOBYTE(req->wIndex) < USBD_MAX_NUM_INTERFACES) ?
+          hcomp->itf_owner[LOBYTE(req->wIndex)] : USBD_COMPOSITE_NONE;
+    break;
+
+  case USB_REQ_RECIPIENT_ENDPOINT:
+    idx = USBD_Composite_EpOwner(hcomp, LOBYTE(req->wIndex));
+    break;
+
+  default:
+    if ((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_STANDARD)
+    {
+      for (i = 0U; i < hcomp->num; i++)
+      {
+        USBD_Composite_FuncSetup(pdev, i, req);
+      }
+      return USBD_OK;
+    }
+    for (i = 0U; i < hcomp->num; i++)
+    {
+      if (USBD_Composite_FuncSetup(pdev, i, req) == USBD_OK)
+      {
+        hcomp->ctl_owner = i;
+        return USBD_OK;
+      }
+    }
+    return USBD_FAIL;
+  }
+
+  if (idx == USBD_COMPOSITE_NONE)
+  {
+    return USBD_FAIL;
+  }
+  hcomp->ctl_owner = idx;
+  return USBD_Composite_FuncSetup(pdev, idx, req);
+}
+
+/**
+  * @brief  USBD_Composite_EP0_TxSent
+  *         Data stage sent, for the function that took the SETUP
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_Composite_EP0_TxSent (USBD_HandleTypeDef *pdev)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  USBD_ClassTypeDef *pclass;
+  uint8_t prev;
+
+  if (hcomp->ctl_owner == USBD_COMPOSITE_NONE)
+  {
+    return USBD_OK;
+  }
+  pclass = hcomp->func[hcomp->ctl_owner].pClass;
+  if (pclass->EP0_TxSent != NULL)
+  {
+    prev = USBD_Composite_Switch(pdev, hcomp->ctl_owner);
+    pclass->EP0_TxSent(pdev);
+    USBD_Composite_Switch(pdev, prev);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_Composite_EP0_RxReady
+  *         Data stage received, for the function that took the SETUP
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_Composite_EP0_RxReady (USBD_HandleTypeDef *pdev)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  USBD_ClassTypeDef *pclass;
+  uint8_t prev;
+
+  if (hcomp->ctl_owner == USBD_COMPOSITE_NONE)
+  {
+    return USBD_OK;
+  }
+  pclass = hcomp->func[hcomp->ctl_owner].pClass;
+  if (pclass->EP0_RxReady != NULL)
+  {
+    prev = USBD_Composite_Switch(pdev, hcomp->ctl_owner);
+    pclass->EP0_RxReady(pdev);
+    USBD_Composite_Switch(pdev, prev);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_Composite_DataIn
+  *         Data sent on non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_Composite_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t idx = USBD_Composite_Handle->in_owner[epnum & 0x0FU];
+
+  if (idx == USBD_COMPOSITE_NONE)
+  {
+    return USBD_FAIL;
+  }
+  return USBD_Composite_FuncEp(pdev, idx, USBD_Composite_Handle->func[idx].pClass->DataIn, epnum);
+}
+
+/**
+  * @brief  USBD_Composite_DataOut
+  *         Data received on non-control Out endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_Composite_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t idx = USBD_Composite_Handle->out_owner[epnum & 0x0FU];
+
+  if (idx == USBD_COMPOSITE_NONE)
+  {
+    return USBD_FAIL;
+  }
+  return USBD_Composite_FuncEp(pdev, idx, USBD_Composite_Handle->func[idx].pClass->DataOut, epnum);
+}
+
+/**
+  * @brief  USBD_Composite_SOF
+  *         Start of frame, for every function
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_Composite_SOF (USBD_HandleTypeDef *pdev)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t prev;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    if (hcomp->func[i].pClass->SOF != NULL)
+    {
+      prev = USBD_Composite_Switch(pdev, i);
+      hcomp->func[i].pClass->SOF(pdev);
+      USBD_Composite_Switch(pdev, prev);
+    }
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_Composite_IsoINIncomplete
+  *         Incomplete isochronous IN transfer
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_Composite_IsoINIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t idx = USBD_Composite_Handle->in_owner[epnum & 0x0FU];
+
+  if (idx == USBD_COMPOSITE_NONE)
+  {
+    return USBD_FAIL;
+  }
+  return USBD_Composite_FuncEp(pdev, idx, USBD_Composite_Handle->func[idx].pClass->IsoINIncomplete,
+                               epnum);
+}
+
+/**
+  * @brief  USBD_Composite_IsoOUTIncomplete
+  *         Incomplete isochronous OUT transfer
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_Composite_IsoOUTIncomplete (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  uint8_t idx = USBD_Composite_Handle->out_owner[epnum & 0x0FU];
+
+  if (idx == USBD_COMPOSITE_NONE)
+  {
+    return USBD_FAIL;
+  }
+  return USBD_Composite_FuncEp(pdev, idx, USBD_Composite_Handle->func[idx].pClass->IsoOUTIncomplete,
+                               epnum);
+}
+
+/**
+  * @brief  USBD_Composite_GetFSCfgDesc
+  *         Return the joined full speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_Composite_GetFSCfgDesc (uint16_t *length)
+{
+  return USBD_Composite_Build(USBD_Composite_Handle, USBD_COMPOSITE_DESC_FS, length);
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_Composite_GetHSCfgDesc
+  *         Return the joined high speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_Composite_GetHSCfgDesc (uint16_t *length)
+{
+  return USBD_Composite_Build(USBD_Composite_Handle, USBD_COMPOSITE_DESC_HS, length);
+}
+
+/**
+  * @brief  USBD_Composite_GetOtherSpeedCfgDesc
+  *         Return the joined other speed configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_Composite_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+  return USBD_Composite_Build(USBD_Composite_Handle, USBD_COMPOSITE_DESC_OTHER_SPEED, length);
+}
+
+/**
+  * @brief  USBD_Composite_GetDeviceQualifierDesc
+  *         Return the device qualifier of the first function that has one
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_Composite_GetDeviceQualifierDesc (uint16_t *length)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    if (hcomp->func[i].pClass->GetDeviceQualifierDescriptor != NULL)
+    {
+      return hcomp->func[i].pClass->GetDeviceQualifierDescriptor(length);
+    }
+  }
+  *length = 0U;
+  return NULL;
+}
+#endif /* USBD_FS_ONLY */
+
+#if (USBD_SUPPORT_USER_STRING == 1)
+/**
+  * @brief  USBD_Composite_GetUsrStrDesc
+  *         Return the first user string a function has for the index
+  * @param  pdev: device instance
+  * @param  index : string index
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_Composite_GetUsrStrDesc (USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t *desc = NULL;
+  uint8_t prev;
+  uint8_t i;
+
+  for (i = 0U; (i < hcomp->num) && (desc == NULL); i++)
+  {
+    if (hcomp->func[i].pClass->GetUsrStrDescriptor != NULL)
+    {
+      prev = USBD_Composite_Switch(pdev, i);
+      desc = hcomp->func[i].pClass->GetUsrStrDescriptor(pdev, index, length);
+      USBD_Composite_Switch(pdev, prev);
+    }
+  }
+  return desc;
+}
+#endif /* USBD_SUPPORT_USER_STRING */
+
+#if (USBD_LPM_ENABLED == 1)
+/**
+  * @brief  USBD_Composite_LPM
+  *         L1 entry or exit, for every function
+  * @param  pdev: device instance
+  * @param  state: USBD_LPM_L1 or USBD_LPM_L0
+  * @retval status
+  */
+static uint8_t  USBD_Composite_LPM (USBD_HandleTypeDef *pdev, uint8_t state)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t prev;
+  uint8_t i;
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    if (hcomp->func[i].pClass->LPM != NULL)
+    {
+      prev = USBD_Composite_Switch(pdev, i);
+      hcomp->func[i].pClass->LPM(pdev, state);
+      USBD_Composite_Switch(pdev, prev);
+    }
+  }
+  return USBD_OK;
+}
+#endif /* USBD_LPM_ENABLED */
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Composite_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Empty the composite and register it as the class of the device
+  * @note   Call after USBD_Init, before adding functions.
+  * @param  pdev: device instance
+  * @param  hcomp: composite state, kept by the caller
+  * @retval status
+  */
+USBD_StatusTypeDef USBD_Composite_Init(USBD_HandleTypeDef *pdev,
+                                       USBD_Composite_HandleTypeDef *hcomp)
+{
+  if ((pdev == NULL) || (hcomp == NULL))
+  {
+    return USBD_FAIL;
+  }
+
+  hcomp->pdev = pdev;
+  hcomp->num = 0U;
+  hcomp->active = 0U;
+  hcomp->ctl_owner = USBD_COMPOSITE_NONE;
+  memset(hcomp->itf_owner, USBD_COMPOSITE_NONE, sizeof(hcomp->itf_owner));
+  memset(hcomp->in_owner, USBD_COMPOSITE_NONE, sizeof(hcomp->in_owner));
+  memset(hcomp->out_owner, USBD_COMPOSITE_NONE, sizeof(hcomp->out_owner));
+  USBD_Composite_Handle = hcomp;
+
+  return USBD_RegisterClass(pdev, &USBD_COMPOSITE);
+}
+
+/**
+  * @brief  Add a class driver to the composite
+  * @note   The interfaces and endpoints of its full speed configuration
+  *         descriptor become its own. Call before USBD_Start.
+  * @param  pdev: device instance
+  * @param  pclass: class driver
+  * @param  pUserData: its user data (interface callbacks). For the first
+  *         function, NULL leaves pdev->pUserData to its RegisterInterface.
+  * @retval USBD_FAIL if full, if something is taken already, or if the
+  *         joined descriptor would not fit USBD_COMPOSITE_CFG_DESC_SIZE
+  */
+USBD_StatusTypeDef USBD_Composite_Add(USBD_HandleTypeDef *pdev,
+                                      USBD_ClassTypeDef *pclass,
+                                      void *pUserData)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  uint8_t *desc;
+  uint16_t len;
+  uint16_t total;
+  uint8_t idx;
+
+  if ((hcomp == NULL) || (hcomp->pdev != pdev) || (pclass == NULL) ||
+      (hcomp->num >= USBD_COMPOSITE_MAX_CLASSES))
+  {
+    return USBD_FAIL;
+  }
+
+  idx = hcomp->num;
+  desc = USBD_Composite_FuncDesc(pclass, USBD_COMPOSITE_DESC_FS, &len);
+  if ((desc == NULL) || !USBD_Composite_Claim(hcomp, idx, desc, len, 0U))
+  {
+    return USBD_FAIL;
+  }
+
+  hcomp->func[idx].pClass = pclass;
+  hcomp->func[idx].pClassData = NULL;
+  hcomp->func[idx].pUserData = pUserData;
+  hcomp->num++;
+
+  if ((USBD_Composite_Build(hcomp, USBD_COMPOSITE_DESC_FS, &total) == NULL)
+#if (USBD_FS_ONLY == 0)
+      || (USBD_Composite_Build(hcomp, USBD_COMPOSITE_DESC_HS, &total) == NULL)
+      || (USBD_Composite_Build(hcomp, USBD_COMPOSITE_DESC_OTHER_SPEED, &total) == NULL)
+#endif /* USBD_FS_ONLY */
+     )
+  {
+    hcomp->num--;
+    return USBD_FAIL;
+  }
+
+  USBD_Composite_Claim(hcomp, idx, desc, len, 1U);
+
+  if ((idx == 0U) && (pUserData != NULL))
+  {
+    /* the first function is the active one outside of the callbacks */
+    pdev->pUserData = pUserData;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  State of a function, what its class keeps in pClassData
+  * @param  pdev: device instance
+  * @param  pclass: class of the function
+  * @retval class data, NULL if the class was not added or is not
+  *         initialized
+  */
+void *USBD_Composite_GetClassData(USBD_HandleTypeDef *pdev,
+                                  const USBD_ClassTypeDef *pclass)
+{
+  USBD_Composite_HandleTypeDef *hcomp = USBD_Composite_Handle;
+  void *data = NULL;
+  uint32_t primask;
+  uint8_t i;
+
+  if ((hcomp == NULL) || (hcomp->pdev != pdev))
+  {
+    return NULL;
+  }
+
+  for (i = 0U; i < hcomp->num; i++)
+  {
+    if (hcomp->func[i].pClass == pclass)
+    {
+      primask = __get_PRIMASK();
+      __disable_irq();
+      data = (i == hcomp->active) ? pdev->pClassData : hcomp->func[i].pClassData;
+      __set_PRIMASK(primask);
+      break;
+    }
+  }
+  return data;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_COMPOSITE_ENABLED */
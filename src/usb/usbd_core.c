@@ -116,6 +116,13 @@ USBD_StatusTypeDef USBD_Init(USBD_HandleTypeDef *pdev, USBD_DescriptorsTypeDef *
   
   /* Set Device initial State */
   pdev->dev_state  = USBD_STATE_DEFAULT;
+#if (USBD_LPM_ENABLED == 1)
+  pdev->dev_lpm_state = USBD_LPM_L0;
+#endif
+#if (USBD_VENDOR_FAST_PATH == 1)
+  pdev->pVendor = NULL;
+  pdev->vendor_req = 0;
+#endif
   pdev->id = id;
   /* Initialize low level driver */
   USBD_LL_Init(pdev);
@@ -172,6 +179,24 @@ USBD_StatusTypeDef  USBD_RegisterClass(USBD_HandleTypeDef *pdev, USBD_ClassTypeD
   return status;
 }
 
+#if (USBD_VENDOR_FAST_PATH == 1)
+/**
+  * @brief  USBD_RegisterVendorHandler 
+  *         Take vendor requests ahead of the standard request chain. The
+  *         handler sees every vendor request once the device has an
+  *         address, whatever the recipient, and passes on those it does
+  *         not know with USBD_BUSY.
+  * @param  pDevice : Device Handle
+  * @param  pvendor: handler, NULL to remove it
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_RegisterVendorHandler(USBD_HandleTypeDef *pdev, const USBD_VendorReqTypeDef *pvendor)
+{
+  pdev->pVendor = pvendor;
+  return USBD_OK;
+}
+#endif /* USBD_VENDOR_FAST_PATH */
+
 /**
   * @brief  USBD_Start 
   *         Start the USB Device Core.
@@ -204,6 +229,22 @@ USBD_StatusTypeDef  USBD_Stop   (USBD_HandleTypeDef *pdev)
   return USBD_OK;  
 }
 
+#if (USBD_POLLED == 1)
+/**
+  * @brief  USBD_Poll 
+  *         Service the device from the application loop, with the USB
+  *         interrupts off. The class callbacks run from here.
+  * @param  pdev: Device Handle
+  * @param  budget: core cycles the call may take
+  * @retval USBD_OK when all pending work was done, USBD_BUSY when some was
+  *         left for the next call
+  */
+USBD_StatusTypeDef  USBD_Poll   (USBD_HandleTypeDef *pdev, uint32_t budget)
+{
+  return USBD_LL_Poll(pdev, budget);
+}
+#endif
+
 /**
 * @brief  USBD_RunTestMode 
 *         Launch test mode process
@@ -215,6 +256,33 @@ USBD_StatusTypeDef  USBD_RunTestMode (USBD_HandleTypeDef  *pdev)
   return USBD_OK;
 }
 
+/**
+* @brief  USBD_RemoteWakeup 
+*         Ask the host to resume a suspended bus, if it enabled remote
+*         wakeup while the device was configured
+* @param  pdev: device instance
+* @retval status: USBD_FAIL if remote wakeup is not allowed now
+*/
+USBD_StatusTypeDef  USBD_RemoteWakeup (USBD_HandleTypeDef  *pdev)
+{
+#if (USBD_LPM_ENABLED == 1)
+  /* out of L1 the host allowed it in the LPM token, checked by the PCD */
+  if (USBD_IS_L1(pdev) && (pdev->dev_state == USBD_STATE_CONFIGURED))
+  {
+    return USBD_LL_RemoteWakeup(pdev);
+  }
+#endif /* USBD_LPM_ENABLED */
+
+  if ((pdev->dev_state != USBD_STATE_SUSPENDED) ||
+      (pdev->dev_old_state != USBD_STATE_CONFIGURED) ||
+      (pdev->dev_remote_wakeup == 0U))
+  {
+    return USBD_FAIL;
+  }
+  
+  return USBD_LL_RemoteWakeup(pdev);
+}
+
 
 /**
 * @brief  USBD_SetClassConfig 
@@ -267,7 +335,37 @@ USBD_StatusTypeDef USBD_LL_SetupStage(USBD_HandleTypeDef *pdev, uint8_t *psetup)
   
   pdev->ep0_state = USBD_EP0_SETUP;
   pdev->ep0_data_len = pdev->request.wLength;
+#if (USBD_CTL_DEFERRED == 1)
+  pdev->ep0_setup_seq++;
+#endif
   
+#if (USBD_VENDOR_FAST_PATH == 1)
+  pdev->vendor_req = 0;
+  if (((pdev->request.bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_VENDOR) &&
+      (pdev->pVendor != NULL) &&
+      ((pdev->dev_state == USBD_STATE_ADDRESSED) ||
+       (pdev->dev_state == USBD_STATE_CONFIGURED)))
+  {
+    switch (pdev->pVendor->Setup(pdev, &pdev->request))
+    {
+    case USBD_OK:
+      pdev->vendor_req = 1;
+      if ((pdev->request.wLength == 0U) && !USBD_CTL_IS_DEFERRED(pdev))
+      {
+        USBD_CtlSendStatus(pdev);
+      }
+      return USBD_OK;
+
+    case USBD_BUSY:
+      break;
+
+    default:
+      USBD_CtlError(pdev, &pdev->request);
+      return USBD_OK;
+    }
+  }
+#endif /* USBD_VENDOR_FAST_PATH */
+
   switch (pdev->request.bmRequest & 0x1F) 
   {
   case USB_REQ_RECIPIENT_DEVICE:   
@@ -306,21 +404,27 @@ USBD_StatusTypeDef USBD_LL_DataOutStage(USBD_HandleTypeDef *pdev , uint8_t epnum
     
     if ( pdev->ep0_state == USBD_EP0_DATA_OUT)
     {
-      if(pep->rem_length > pep->maxpacket)
+      /* The low level driver re-arms between the packets of the data
+         stage, this is called once it is all in or ended short */
+      pep->rem_length = 0;
+
+#if (USBD_VENDOR_FAST_PATH == 1)
+      if (pdev->vendor_req)
       {
-        pep->rem_length -=  pep->maxpacket;
-       
-        USBD_CtlContinueRx (pdev, 
-                            pdata,
-                            MIN(pep->rem_length ,pep->maxpacket));
+        if ((pdev->pVendor != NULL) && (pdev->pVendor->EP0_RxReady != NULL))
+        {
+          pdev->pVendor->EP0_RxReady(pdev);
+        }
       }
       else
+#endif /* USBD_VENDOR_FAST_PATH */
+      if((pdev->pClass->EP0_RxReady != NULL)&&
+         (pdev->dev_state == USBD_STATE_CONFIGURED))
+      {
+        pdev->pClass->EP0_RxReady(pdev); 
+      }
+      if (!USBD_CTL_IS_DEFERRED(pdev))
       {
-        if((pdev->pClass->EP0_RxReady != NULL)&&
-           (pdev->dev_state == USBD_STATE_CONFIGURED))
-        {
-          pdev->pClass->EP0_RxReady(pdev); 
-        }
         USBD_CtlSendStatus(pdev);
       }
     }
@@ -350,45 +454,33 @@ USBD_StatusTypeDef USBD_LL_DataInStage(USBD_HandleTypeDef *pdev ,uint8_t epnum,
     
     if ( pdev->ep0_state == USBD_EP0_DATA_IN)
     {
-      if(pep->rem_length > pep->maxpacket)
+      /* The low level driver loads each packet of the data stage as soon
+         as the previous one is taken, this is called once it is all sent */
+      pep->rem_length = 0;
+
+      /* last packet is MPS multiple, so send ZLP packet */
+      if((pep->total_length % pep->maxpacket == 0) &&
+         (pep->total_length >= pep->maxpacket) &&
+           (pep->total_length < pdev->ep0_data_len ))
       {
-        pep->rem_length -=  pep->maxpacket;
         
-        USBD_CtlContinueSendData (pdev, 
-                                  pdata, 
-                                  pep->rem_length);
+        USBD_CtlContinueSendData(pdev , NULL, 0);
+        pdev->ep0_data_len = 0;
         
         /* Prepare endpoint for premature end of transfer */
         USBD_LL_PrepareReceive (pdev,
                                 0,
                                 NULL,
-                                0);  
+                                0);
       }
       else
-      { /* last packet is MPS multiple, so send ZLP packet */
-        if((pep->total_length % pep->maxpacket == 0) &&
-           (pep->total_length >= pep->maxpacket) &&
-             (pep->total_length < pdev->ep0_data_len ))
-        {
-          
-          USBD_CtlContinueSendData(pdev , NULL, 0);
-          pdev->ep0_data_len = 0;
-          
-        /* Prepare endpoint for premature end of transfer */
-        USBD_LL_PrepareReceive (pdev,
-                                0,
-                                NULL,
-                                0);
-        }
-        else
+      {
+        if((pdev->pClass->EP0_TxSent != NULL)&&
+           (pdev->dev_state == USBD_STATE_CONFIGURED))
         {
-          if((pdev->pClass->EP0_TxSent != NULL)&&
-             (pdev->dev_state == USBD_STATE_CONFIGURED))
-          {
-            pdev->pClass->EP0_TxSent(pdev); 
-          }          
-          USBD_CtlReceiveStatus(pdev);
-        }
+          pdev->pClass->EP0_TxSent(pdev); 
+        }          
+        USBD_CtlReceiveStatus(pdev);
       }
     }
     if (pdev->dev_test_mode == 1)
@@ -431,6 +523,14 @@ USBD_StatusTypeDef USBD_LL_Reset(USBD_HandleTypeDef  *pdev)
   pdev->ep_in[0].maxpacket = USB_MAX_EP0_SIZE;
   /* Upon Reset call user call back */
   pdev->dev_state = USBD_STATE_DEFAULT;
+#if (USBD_CTL_DEFERRED == 1)
+  /* a deferred answer must not go out in the new enumeration */
+  pdev->ep0_state = USBD_EP0_IDLE;
+  pdev->ep0_setup_seq++;
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  pdev->dev_lpm_state = USBD_LPM_L0;
+#endif
   
   if (pdev->pClassData) 
     pdev->pClass->DeInit(pdev, pdev->dev_config);  
@@ -463,7 +563,11 @@ USBD_StatusTypeDef USBD_LL_SetSpeed(USBD_HandleTypeDef  *pdev, USBD_SpeedTypeDef
 
 USBD_StatusTypeDef USBD_LL_Suspend(USBD_HandleTypeDef  *pdev)
 {
-  pdev->dev_old_state =  pdev->dev_state;
+  /* a repeated suspend interrupt must not lose the state to resume to */
+  if (pdev->dev_state != USBD_STATE_SUSPENDED)
+  {
+    pdev->dev_old_state =  pdev->dev_state;
+  }
   pdev->dev_state  = USBD_STATE_SUSPENDED;
   return USBD_OK;
 }
@@ -481,6 +585,29 @@ USBD_StatusTypeDef USBD_LL_Resume(USBD_HandleTypeDef  *pdev)
   return USBD_OK;
 }
 
+#if (USBD_LPM_ENABLED == 1)
+/**
+* @brief  USBD_LPM 
+*         Handle an L1 entry or exit of the link
+* @param  pdev: device instance
+* @param  state: USBD_LPM_L1 or USBD_LPM_L0
+* @retval status
+*/
+
+USBD_StatusTypeDef USBD_LL_LPM(USBD_HandleTypeDef  *pdev, uint8_t state)
+{
+  pdev->dev_lpm_state = state;
+  if(pdev->dev_state == USBD_STATE_CONFIGURED)
+  {
+    if(pdev->pClass->LPM != NULL)
+    {
+      pdev->pClass->LPM(pdev, state);
+    }
+  }
+  return USBD_OK;
+}
+#endif /* USBD_LPM_ENABLED */
+
 /**
 * @brief  USBD_SOF 
 *         Handle SOF event
@@ -502,23 +629,41 @@ USBD_StatusTypeDef USBD_LL_SOF(USBD_HandleTypeDef  *pdev)
 
 /**
 * @brief  USBD_IsoINIncomplete 
-*         Handle iso in incomplete event
+*         Handle iso in incomplete event: no packet went out on the
+*         endpoint during the last frame
 * @param  pdev: device instance
+* @param  epnum: endpoint number
 * @retval status
 */
 USBD_StatusTypeDef USBD_LL_IsoINIncomplete(USBD_HandleTypeDef  *pdev, uint8_t epnum)
 {
+  if(pdev->dev_state == USBD_STATE_CONFIGURED)
+  {
+    if(pdev->pClass->IsoINIncomplete != NULL)
+    {
+      pdev->pClass->IsoINIncomplete(pdev, epnum);
+    }
+  }
   return USBD_OK;
 }
 
 /**
 * @brief  USBD_IsoOUTIncomplete 
-*         Handle iso out incomplete event
+*         Handle iso out incomplete event: no packet came in on the
+*         endpoint during the last frame
 * @param  pdev: device instance
+* @param  epnum: endpoint number
 * @retval status
 */
 USBD_StatusTypeDef USBD_LL_IsoOUTIncomplete(USBD_HandleTypeDef  *pdev, uint8_t epnum)
 {
+  if(pdev->dev_state == USBD_STATE_CONFIGURED)
+  {
+    if(pdev->pClass->IsoOUTIncomplete != NULL)
+    {
+      pdev->pClass->IsoOUTIncomplete(pdev, epnum);
+    }
+  }
   return USBD_OK;
 }
 
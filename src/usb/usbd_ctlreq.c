@@ -28,6 +28,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_ctlreq.h"
 #include "usbd_ioreq.h"
+#include "usb_enumbench.h"
 
 
 /** @addtogroup STM32_USBD_STATE_DEVICE_LIBRARY
@@ -68,6 +69,30 @@
 /** @defgroup USBD_REQ_Private_Variables
   * @{
   */ 
+#if (USBD_BOS_ENABLED == 1)
+/* BOS descriptor returned when USBD_DescriptorsTypeDef leaves
+   GetBOSDescriptor NULL: L1 with BESL if LPM is on, no baseline or deep
+   BESL given */
+__ALIGN_BEGIN static uint8_t USBD_BOSDesc[USB_SIZ_BOS_DESC] __ALIGN_END =
+{
+  USB_LEN_BOS_DESC,
+  USB_DESC_TYPE_BOS,
+  LOBYTE(USB_SIZ_BOS_DESC),
+  HIBYTE(USB_SIZ_BOS_DESC),
+  0x01,                               /* bNumDeviceCaps */
+  USB_LEN_USB2_EXT_DESC,
+  USB_DEVICE_CAPABITY_TYPE,
+  USB_DEV_CAP_TYPE_USB2_EXT,
+#if (USBD_LPM_ENABLED == 1)
+  USB_USB2_EXT_LPM | USB_USB2_EXT_BESL,
+#else
+  0x00,
+#endif
+  0x00,
+  0x00,
+  0x00
+};
+#endif /* USBD_BOS_ENABLED */
 /**
   * @}
   */ 
@@ -97,8 +122,39 @@ static void USBD_SetFeature(USBD_HandleTypeDef *pdev ,
 static void USBD_ClrFeature(USBD_HandleTypeDef *pdev , 
                             USBD_SetupReqTypedef *req);
 
+static void USBD_EPSetFeature(USBD_HandleTypeDef *pdev , 
+                              USBD_SetupReqTypedef *req);
+
+static void USBD_EPClrFeature(USBD_HandleTypeDef *pdev , 
+                              USBD_SetupReqTypedef *req);
+
+static void USBD_EPGetStatus(USBD_HandleTypeDef *pdev , 
+                             USBD_SetupReqTypedef *req);
+
 static uint8_t USBD_GetLen(uint8_t *buf);
 
+/* Standard requests by bRequest, to the device and to an endpoint. NULL
+   is not supported; interface requests all belong to the class */
+typedef struct
+{
+  void (*Dev)(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+  void (*EP) (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+} USBD_StdReqTypeDef;
+
+static const USBD_StdReqTypeDef USBD_StdReq[USB_REQ_SET_CONFIGURATION + 1] =
+{
+  { USBD_GetStatus,     USBD_EPGetStatus  },   /* USB_REQ_GET_STATUS */
+  { USBD_ClrFeature,    USBD_EPClrFeature },   /* USB_REQ_CLEAR_FEATURE */
+  { NULL,               NULL              },
+  { USBD_SetFeature,    USBD_EPSetFeature },   /* USB_REQ_SET_FEATURE */
+  { NULL,               NULL              },
+  { USBD_SetAddress,    NULL              },   /* USB_REQ_SET_ADDRESS */
+  { USBD_GetDescriptor, NULL              },   /* USB_REQ_GET_DESCRIPTOR */
+  { NULL,               NULL              },   /* USB_REQ_SET_DESCRIPTOR */
+  { USBD_GetConfig,     NULL              },   /* USB_REQ_GET_CONFIGURATION */
+  { USBD_SetConfig,     NULL              },   /* USB_REQ_SET_CONFIGURATION */
+};
+
 /**
   * @}
   */ 
@@ -120,41 +176,32 @@ USBD_StatusTypeDef  USBD_StdDevReq (USBD_HandleTypeDef *pdev , USBD_SetupReqType
 {
   USBD_StatusTypeDef ret = USBD_OK;  
   
-  switch (req->bRequest) 
+  /* Vendor requests to the device belong to the class. They are taken
+     from the address on: Windows asks for the MS OS 2.0 descriptor set
+     before it configures the device, so a class must check pClassData */
+  if ((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_VENDOR)
+  {
+    if (((pdev->dev_state != USBD_STATE_ADDRESSED) &&
+         (pdev->dev_state != USBD_STATE_CONFIGURED)) ||
+        (pdev->pClass->Setup (pdev, req) != USBD_OK))
+    {
+      USBD_CtlError(pdev , req);
+    }
+    else if ((req->wLength == 0U) && !USBD_CTL_IS_DEFERRED(pdev))
+    {
+      USBD_CtlSendStatus(pdev);
+    }
+    return ret;
+  }
+  
+  if ((req->bRequest < (sizeof(USBD_StdReq) / sizeof(USBD_StdReq[0]))) &&
+      (USBD_StdReq[req->bRequest].Dev != NULL))
+  {
+    USBD_StdReq[req->bRequest].Dev(pdev, req);
+  }
+  else
   {
-  case USB_REQ_GET_DESCRIPTOR: 
-    
-    USBD_GetDescriptor (pdev, req) ;
-    break;
-    
-  case USB_REQ_SET_ADDRESS:                      
-    USBD_SetAddress(pdev, req);
-    break;
-    
-  case USB_REQ_SET_CONFIGURATION:                    
-    USBD_SetConfig (pdev , req);
-    break;
-    
-  case USB_REQ_GET_CONFIGURATION:                 
-    USBD_GetConfig (pdev , req);
-    break;
-    
-  case USB_REQ_GET_STATUS:                                  
-    USBD_GetStatus (pdev , req);
-    break;
-    
-    
-  case USB_REQ_SET_FEATURE:   
-    USBD_SetFeature (pdev , req);    
-    break;
-    
-  case USB_REQ_CLEAR_FEATURE:                                   
-    USBD_ClrFeature (pdev , req);
-    break;
-    
-  default:  
     USBD_CtlError(pdev , req);
-    break;
   }
   
   return ret;
@@ -179,7 +226,7 @@ USBD_StatusTypeDef  USBD_StdItfReq (USBD_HandleTypeDef *pdev , USBD_SetupReqType
     {
       pdev->pClass->Setup (pdev, req); 
       
-      if((req->wLength == 0)&& (ret == USBD_OK))
+      if((req->wLength == 0)&& (ret == USBD_OK) && !USBD_CTL_IS_DEFERRED(pdev))
       {
          USBD_CtlSendStatus(pdev);
       }
@@ -207,11 +254,6 @@ USBD_StatusTypeDef  USBD_StdItfReq (USBD_HandleTypeDef *pdev , USBD_SetupReqType
 USBD_StatusTypeDef  USBD_StdEPReq (USBD_HandleTypeDef *pdev , USBD_SetupReqTypedef  *req)
 {
   
-  uint8_t   ep_addr;
-  USBD_StatusTypeDef ret = USBD_OK; 
-  USBD_EndpointTypeDef   *pep;
-  ep_addr  = LOBYTE(req->wIndex);   
-  
   /* Check if it is a class request */
   if ((req->bmRequest & 0x60) == 0x20)
   {
@@ -220,107 +262,140 @@ USBD_StatusTypeDef  USBD_StdEPReq (USBD_HandleTypeDef *pdev , USBD_SetupReqTyped
     return USBD_OK;
   }
   
-  switch (req->bRequest) 
+  /* Others than those of the table are left unanswered */
+  if ((req->bRequest < (sizeof(USBD_StdReq) / sizeof(USBD_StdReq[0]))) &&
+      (USBD_StdReq[req->bRequest].EP != NULL))
   {
+    USBD_StdReq[req->bRequest].EP(pdev, req);
+  }
+  return USBD_OK;
+}
+
+/**
+* @brief  USBD_EPSetFeature
+*         Handle Set Feature requests to an endpoint
+* @param  pdev: device instance
+* @param  req: usb request
+* @retval None
+*/
+static void USBD_EPSetFeature(USBD_HandleTypeDef *pdev , 
+                              USBD_SetupReqTypedef *req)
+{
+  uint8_t   ep_addr = LOBYTE(req->wIndex);
+  
+  switch (pdev->dev_state) 
+  {
+  case USBD_STATE_ADDRESSED:          
+    if ((ep_addr != 0x00) && (ep_addr != 0x80)) 
+    {
+      USBD_LL_StallEP(pdev , ep_addr);
+    }
+    break;	
     
-  case USB_REQ_SET_FEATURE :
-    
-    switch (pdev->dev_state) 
+  case USBD_STATE_CONFIGURED:   
+    if (req->wValue == USB_FEATURE_EP_HALT)
     {
-    case USBD_STATE_ADDRESSED:          
       if ((ep_addr != 0x00) && (ep_addr != 0x80)) 
-      {
+      { 
         USBD_LL_StallEP(pdev , ep_addr);
+        
       }
-      break;	
-      
-    case USBD_STATE_CONFIGURED:   
-      if (req->wValue == USB_FEATURE_EP_HALT)
-      {
-        if ((ep_addr != 0x00) && (ep_addr != 0x80)) 
-        { 
-          USBD_LL_StallEP(pdev , ep_addr);
-          
-        }
-      }
-      pdev->pClass->Setup (pdev, req);   
-      USBD_CtlSendStatus(pdev);
-      
-      break;
-      
-    default:                         
-      USBD_CtlError(pdev , req);
-      break;    
     }
+    pdev->pClass->Setup (pdev, req);   
+    USBD_CtlSendStatus(pdev);
+    
     break;
     
-  case USB_REQ_CLEAR_FEATURE :
+  default:                         
+    USBD_CtlError(pdev , req);
+    break;    
+  }
+}
+
+/**
+* @brief  USBD_EPClrFeature
+*         Handle Clear Feature requests to an endpoint
+* @param  pdev: device instance
+* @param  req: usb request
+* @retval None
+*/
+static void USBD_EPClrFeature(USBD_HandleTypeDef *pdev , 
+                              USBD_SetupReqTypedef *req)
+{
+  uint8_t   ep_addr = LOBYTE(req->wIndex);
+  
+  switch (pdev->dev_state) 
+  {
+  case USBD_STATE_ADDRESSED:          
+    if ((ep_addr != 0x00) && (ep_addr != 0x80)) 
+    {
+      USBD_LL_StallEP(pdev , ep_addr);
+    }
+    break;	
     
-    switch (pdev->dev_state) 
+  case USBD_STATE_CONFIGURED:   
+    if (req->wValue == USB_FEATURE_EP_HALT)
     {
-    case USBD_STATE_ADDRESSED:          
-      if ((ep_addr != 0x00) && (ep_addr != 0x80)) 
-      {
-        USBD_LL_StallEP(pdev , ep_addr);
-      }
-      break;	
-      
-    case USBD_STATE_CONFIGURED:   
-      if (req->wValue == USB_FEATURE_EP_HALT)
-      {
-        if ((ep_addr & 0x7F) != 0x00) 
-        {        
-          USBD_LL_ClearStallEP(pdev , ep_addr);
-          pdev->pClass->Setup (pdev, req);
-        }
-        USBD_CtlSendStatus(pdev);
+      if ((ep_addr & 0x7F) != 0x00) 
+      {        
+        USBD_LL_ClearStallEP(pdev , ep_addr);
+        pdev->pClass->Setup (pdev, req);
       }
-      break;
-      
-    default:                         
-      USBD_CtlError(pdev , req);
-      break;    
+      USBD_CtlSendStatus(pdev);
     }
     break;
     
-  case USB_REQ_GET_STATUS:                  
-    switch (pdev->dev_state) 
+  default:                         
+    USBD_CtlError(pdev , req);
+    break;    
+  }
+}
+
+/**
+* @brief  USBD_EPGetStatus
+*         Handle Get Status requests to an endpoint
+* @param  pdev: device instance
+* @param  req: usb request
+* @retval None
+*/
+static void USBD_EPGetStatus(USBD_HandleTypeDef *pdev , 
+                             USBD_SetupReqTypedef *req)
+{
+  uint8_t   ep_addr = LOBYTE(req->wIndex);
+  USBD_EndpointTypeDef   *pep;
+  
+  switch (pdev->dev_state) 
+  {
+  case USBD_STATE_ADDRESSED:          
+    if ((ep_addr & 0x7F) != 0x00) 
     {
-    case USBD_STATE_ADDRESSED:          
-      if ((ep_addr & 0x7F) != 0x00) 
-      {
-        USBD_LL_StallEP(pdev , ep_addr);
-      }
-      break;	
-      
-    case USBD_STATE_CONFIGURED:
-      pep = ((ep_addr & 0x80) == 0x80) ? &pdev->ep_in[ep_addr & 0x7F]:\
-                                         &pdev->ep_out[ep_addr & 0x7F];
-      if(USBD_LL_IsStallEP(pdev, ep_addr))
-      {
-        pep->status = 0x0001;     
-      }
-      else
-      {
-        pep->status = 0x0000;  
-      }
-      
-      USBD_CtlSendData (pdev,
-                        (uint8_t *)&pep->status,
-                        2);
-      break;
-      
-    default:                         
-      USBD_CtlError(pdev , req);
-      break;
+      USBD_LL_StallEP(pdev , ep_addr);
+    }
+    break;	
+    
+  case USBD_STATE_CONFIGURED:
+    pep = ((ep_addr & 0x80) == 0x80) ? &pdev->ep_in[ep_addr & 0x7F]:\
+                                       &pdev->ep_out[ep_addr & 0x7F];
+    if(USBD_LL_IsStallEP(pdev, ep_addr))
+    {
+      pep->status = 0x0001;     
     }
+    else
+    {
+      pep->status = 0x0000;  
+    }
+    
+    USBD_CtlSendData (pdev,
+                      (uint8_t *)&pep->status,
+                      2);
     break;
     
-  default:
+  default:                         
+    USBD_CtlError(pdev , req);
     break;
   }
-  return ret;
 }
+
 /**
 * @brief  USBD_GetDescriptor
 *         Handle Get Descriptor requests
@@ -334,12 +409,21 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev ,
   uint16_t len;
   uint8_t *pbuf;
   
+  USB_ENUMBENCH_DESCRIPTOR((uint8_t)(req->wValue >> 8));
     
   switch (req->wValue >> 8)
   { 
-#if (USBD_LPM_ENABLED == 1)
+#if (USBD_BOS_ENABLED == 1)
   case USB_DESC_TYPE_BOS:
-    pbuf = pdev->pDesc->GetBOSDescriptor(pdev->dev_speed, &len);
+    if (pdev->pDesc->GetBOSDescriptor != NULL)
+    {
+      pbuf = pdev->pDesc->GetBOSDescriptor(pdev->dev_speed, &len);
+    }
+    else
+    {
+      pbuf = USBD_BOSDesc;
+      len = USB_SIZ_BOS_DESC;
+    }
     break;
 #endif    
   case USB_DESC_TYPE_DEVICE:
@@ -347,7 +431,7 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev ,
     break;
     
   case USB_DESC_TYPE_CONFIGURATION:     
-    if(pdev->dev_speed == USBD_SPEED_HIGH )   
+    if(USBD_IS_HIGH_SPEED(pdev))   
     {
       pbuf   = (uint8_t *)pdev->pClass->GetHSConfigDescriptor(&len);
       //pbuf[1] = USB_DESC_TYPE_CONFIGURATION;
@@ -396,9 +480,10 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev ,
 #endif   
     }
     break;
-  case USB_DESC_TYPE_DEVICE_QUALIFIER:                   
-
-    if(pdev->dev_speed == USBD_SPEED_HIGH  )   
+  case USB_DESC_TYPE_DEVICE_QUALIFIER:
+    /* a full speed only device has no other speed to describe */
+    if(USBD_IS_HS_CAPABLE(pdev) &&
+       (pdev->pClass->GetDeviceQualifierDescriptor != NULL))
     {
       pbuf   = (uint8_t *)pdev->pClass->GetDeviceQualifierDescriptor(&len);
       break;
@@ -410,10 +495,11 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev ,
     } 
 
   case USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION:
-    if(pdev->dev_speed == USBD_SPEED_HIGH  )   
+    /* the class returns it with bDescriptorType already set to 7 */
+    if(USBD_IS_HS_CAPABLE(pdev) &&
+       (pdev->pClass->GetOtherSpeedConfigDescriptor != NULL))
     {
       pbuf   = (uint8_t *)pdev->pClass->GetOtherSpeedConfigDescriptor(&len);
-      pbuf[1] = USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION;
       break; 
     }
     else
@@ -427,6 +513,13 @@ static void USBD_GetDescriptor(USBD_HandleTypeDef *pdev ,
     return;
   }
   
+  if(pbuf == NULL)
+  {
+    /* the class has no descriptor for this speed */
+    USBD_CtlError(pdev , req);
+    return;
+  }
+  
   if((len != 0)&& (req->wLength != 0))
   {
     
@@ -467,6 +560,7 @@ static void USBD_SetAddress(USBD_HandleTypeDef *pdev ,
       
       if (dev_addr != 0) 
       {
+        USB_ENUMBENCH_MARK(USB_ENUMBENCH_ADDRESS);
         pdev->dev_state  = USBD_STATE_ADDRESSED;
       } 
       else 
@@ -507,6 +601,7 @@ static void USBD_SetConfig(USBD_HandleTypeDef *pdev ,
     case USBD_STATE_ADDRESSED:
       if (cfgidx) 
       {                                			   							   							   				
+        USB_ENUMBENCH_MARK(USB_ENUMBENCH_SETCONFIG);
         pdev->dev_config = cfgidx;
         pdev->dev_state = USBD_STATE_CONFIGURED;
         if(USBD_SetClassConfig(pdev , cfgidx) == USBD_FAIL)
@@ -697,12 +792,28 @@ static void USBD_ClrFeature(USBD_HandleTypeDef *pdev ,
 
 void USBD_ParseSetupRequest(USBD_SetupReqTypedef *req, uint8_t *pdata)
 {
-  req->bmRequest     = *(uint8_t *)  (pdata);
-  req->bRequest      = *(uint8_t *)  (pdata +  1);
-  req->wValue        = SWAPBYTE      (pdata +  2);
-  req->wIndex        = SWAPBYTE      (pdata +  4);
-  req->wLength       = SWAPBYTE      (pdata +  6);
+  const uint16_t *p16;
+  uint16_t h;
 
+  if (((uint32_t)(uintptr_t)pdata & 1U) != 0U)
+  {
+    req->bmRequest     = *(uint8_t *)  (pdata);
+    req->bRequest      = *(uint8_t *)  (pdata +  1);
+    req->wValue        = SWAPBYTE      (pdata +  2);
+    req->wIndex        = SWAPBYTE      (pdata +  4);
+    req->wLength       = SWAPBYTE      (pdata +  6);
+    return;
+  }
+
+  /* Setup buffers of the PCDs are word aligned: the little endian fields
+     come straight out of halfword loads */
+  p16 = (const uint16_t *)(void *)pdata;
+  h = p16[0];
+  req->bmRequest     = LOBYTE(h);
+  req->bRequest      = HIBYTE(h);
+  req->wValue        = p16[1];
+  req->wIndex        = p16[2];
+  req->wLength       = p16[3];
 }
 
 /**
@@ -747,6 +858,40 @@ void USBD_GetString(uint8_t *desc, uint8_t *unicode, uint16_t *len)
   } 
 }
 
+/**
+  * @brief  USBD_GetSerialString
+  *         Build the serial number string descriptor from the device unique
+  *         ID, meant to be called once at init so that the descriptor
+  *         callback only returns the buffer: the hex digits of
+  *         uid[0] + uid[2] followed by the upper 16 bits of uid[1]
+  * @param  desc : descriptor buffer of USBD_SIZ_SERIAL_DESC bytes
+  * @param  uid : the three words of the device unique ID
+  * @retval None
+  */
+void USBD_GetSerialString(uint8_t *desc, const uint32_t *uid)
+{
+  uint32_t value = uid[0] + uid[2];
+  uint8_t idx;
+  uint8_t digit;
+
+  desc[0] = USBD_SIZ_SERIAL_DESC;
+  desc[1] = USB_DESC_TYPE_STRING;
+
+  for (idx = 0U; idx < USBD_SERIAL_STRING_DIGITS; idx++)
+  {
+    if (idx == 8U)
+    {
+      value = uid[1];
+    }
+
+    digit = (uint8_t)(value >> 28);
+    value <<= 4;
+
+    desc[2U + 2U * idx] = (uint8_t)"0123456789ABCDEF"[digit];
+    desc[3U + 2U * idx] = 0U;
+  }
+}
+
 /**
   * @brief  USBD_GetLen
   *         return the string length
@@ -0,0 +1,805 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dfu.c
+  * @brief   DFU 1.1 class with double buffered download, see usbd_dfu.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_dfu.h"
+#include "usbd_ctlreq.h"
+
+#if (USBD_DFU_ENABLED == 1)
+
+#if ((USBD_DFU_XFER_SIZE % 4U) != 0) || (USBD_DFU_XFER_SIZE > 0xFFFFU)
+#error "USBD_DFU_XFER_SIZE must be a multiple of 4 below 64 KiB"
+#endif
+#if ((USBD_DFU_APP_ADDR % USBD_DFU_PAGE_SIZE) != 0) || \
+    ((USBD_DFU_APP_SIZE % USBD_DFU_PAGE_SIZE) != 0)
+#error "USBD_DFU_APP_ADDR and USBD_DFU_APP_SIZE must be whole pages"
+#endif
+#if (USBD_DFU_ERASE_AHEAD < 1U)
+#error "USBD_DFU_ERASE_AHEAD must be 1 or more"
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_dfu
+  * @{
+  */
+
+/** @defgroup usbd_dfu_Private_Defines
+  * @{
+  */
+/* Self powered, like the CDC configuration */
+#define USBD_DFU_CFG_ATTRIBUTES                     0xC0
+
+/* bmAttributes of the functional descriptor: bitCanDnload, bitCanUpload,
+   bitManifestationTolerant */
+#define USBD_DFU_FUNC_ATTRIBUTES                    0x07
+
+#define USBD_DFU_APP_END                            (USBD_DFU_APP_ADDR + USBD_DFU_APP_SIZE)
+
+/* Largest bwPollTimeout, 24 bits */
+#define USBD_DFU_POLL_MAX                           0xFFFFFFU
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t  USBD_DFU_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_DFU_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_DFU_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_DFU_EP0_RxReady (USBD_HandleTypeDef *pdev);
+static uint8_t  *USBD_DFU_GetCfgDesc (uint16_t *length);
+#if (USBD_FS_ONLY == 0)
+static uint8_t  *USBD_DFU_GetOtherSpeedCfgDesc (uint16_t *length);
+static uint8_t  *USBD_DFU_GetDeviceQualifierDesc (uint16_t *length);
+#endif /* USBD_FS_ONLY */
+static USBD_DFU_HandleTypeDef *USBD_DFU_Get (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_DFU_Fail (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req,
+                               uint8_t status);
+static uint32_t USBD_DFU_PollTimeout (USBD_DFU_HandleTypeDef *hdfu, uint32_t blocks);
+static void     USBD_DFU_GetStatus (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_DFU_Dnload (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_DFU_Upload (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_DFU_Program (USBD_DFU_HandleTypeDef *hdfu, USBD_DFU_BlockTypeDef *blk);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Private_Variables
+  * @{
+  */
+USBD_ClassTypeDef  USBD_DFU =
+{
+  USBD_DFU_Init,
+  USBD_DFU_DeInit,
+  USBD_DFU_Setup,
+  NULL,                 /* EP0_TxSent */
+  USBD_DFU_EP0_RxReady,
+  NULL,                 /* DataIn */
+  NULL,                 /* DataOut */
+  NULL,                 /* SOF */
+  NULL,
+  NULL,
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_DFU_GetCfgDesc,
+  NULL,
+  NULL,
+#else
+  USBD_DFU_GetCfgDesc,  /* no endpoints: the same at both speeds */
+  USBD_DFU_GetCfgDesc,
+  USBD_DFU_GetOtherSpeedCfgDesc,
+  USBD_DFU_GetDeviceQualifierDesc,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  NULL,                 /* LPM */
+#endif
+};
+
+/* Whole configuration: one interface and its functional descriptor */
+#define USBD_DFU_CFG_DESC(type)                                               \
+  0x09,                               /* bLength */                          \
+  (type),                             /* bDescriptorType */                  \
+  LOBYTE(USBD_DFU_CFG_DESC_SIZ),      /* wTotalLength */                     \
+  HIBYTE(USBD_DFU_CFG_DESC_SIZ),                                             \
+  0x01,                               /* bNumInterfaces */                   \
+  0x01,                               /* bConfigurationValue */              \
+  0x00,                               /* iConfiguration */                   \
+  USBD_DFU_CFG_ATTRIBUTES,            /* bmAttributes */                     \
+  0x32,                               /* MaxPower 100 mA */                  \
+  /* Interface */                                                            \
+  0x09,                               /* bLength */                          \
+  USB_DESC_TYPE_INTERFACE,            /* bDescriptorType */                  \
+  USBD_DFU_ITF_NUM,                   /* bInterfaceNumber */                 \
+  0x00,                               /* bAlternateSetting */                \
+  0x00,                               /* bNumEndpoints */                    \
+  0xFE,                               /* bInterfaceClass: application */     \
+  0x01,                               /* bInterfaceSubClass: DFU */          \
+  0x02,                               /* bInterfaceProtocol: DFU mode */     \
+  0x00,                               /* iInterface */                       \
+  /* DFU functional */                                                       \
+  USBD_DFU_FUNC_DESC_SIZ,             /* bLength */                          \
+  USBD_DFU_DESC_TYPE_FUNCTIONAL,      /* bDescriptorType */                  \
+  USBD_DFU_FUNC_ATTRIBUTES,           /* bmAttributes */                     \
+  LOBYTE(USBD_DFU_DETACH_TIMEOUT),    /* wDetachTimeOut */                   \
+  HIBYTE(USBD_DFU_DETACH_TIMEOUT),                                           \
+  LOBYTE(USBD_DFU_XFER_SIZE),         /* wTransferSize */                    \
+  HIBYTE(USBD_DFU_XFER_SIZE),                                                \
+  0x10,                               /* bcdDFUVersion 1.1 */                \
+  0x01
+
+__ALIGN_BEGIN static const uint8_t USBD_DFU_CfgDesc[] __ALIGN_END =
+{
+  USBD_DFU_CFG_DESC(USB_DESC_TYPE_CONFIGURATION)
+};
+
+/* The build fails if wTotalLength does not match the descriptor */
+typedef char USBD_DFU_CfgDescSizeCheck[(sizeof(USBD_DFU_CfgDesc) == USBD_DFU_CFG_DESC_SIZ) ? 1 : -1];
+
+#if (USBD_FS_ONLY == 0)
+__ALIGN_BEGIN static const uint8_t USBD_DFU_OtherSpeedDesc[] __ALIGN_END =
+{
+  USBD_DFU_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION)
+};
+
+__ALIGN_BEGIN static uint8_t USBD_DFU_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0x00,                 /* class given by the interface */
+  0x00,
+  0x00,
+  0x40,
+  0x01,
+  0x00,
+};
+#endif /* USBD_FS_ONLY */
+
+static USBD_DFU_HandleTypeDef USBD_DFU_Handle;
+
+/* Media of the last Init, for USBD_DFU_Process */
+static USBD_DFU_MediaTypeDef *USBD_DFU_Media;
+
+/* Blocks before this one belong to an aborted download: the thread drops
+   them instead of programming them */
+static __IO uint32_t USBD_DFU_Base;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_DFU_Get
+  *         State of the class, standalone or as a function of a composite
+  * @param  pdev: device instance
+  * @retval class data, NULL while not configured
+  */
+static USBD_DFU_HandleTypeDef *USBD_DFU_Get (USBD_HandleTypeDef *pdev)
+{
+#if (USBD_COMPOSITE_ENABLED == 1)
+  if (pdev->pClass != &USBD_DFU)
+  {
+    return (USBD_DFU_HandleTypeDef *)USBD_Composite_GetClassData(pdev, &USBD_DFU);
+  }
+#endif /* USBD_COMPOSITE_ENABLED */
+  return (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+}
+
+/**
+  * @brief  USBD_DFU_Fail
+  *         Refuse a request and enter dfuERROR
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @param  status: bStatus the next GETSTATUS reports
+  * @retval USBD_FAIL
+  */
+static uint8_t  USBD_DFU_Fail (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req,
+                               uint8_t status)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+
+  hdfu->State = USBD_DFU_STATE_ERROR;
+  hdfu->Status = status;
+  USBD_CtlError(pdev, req);
+  return USBD_FAIL;
+}
+
+/**
+  * @brief  USBD_DFU_PollTimeout
+  *         Time until the thread is through a number of blocks, less what
+  *         the block in progress has taken so far
+  * @param  hdfu: class data
+  * @param  blocks: blocks still to program, the one in progress included
+  * @retval bwPollTimeout in ms, at least 1
+  */
+static uint32_t USBD_DFU_PollTimeout (USBD_DFU_HandleTypeDef *hdfu, uint32_t blocks)
+{
+  uint32_t t = (hdfu->BlockTime * blocks + 15U) >> 4;
+  uint32_t elapsed;
+
+  if (hdfu->Busy && (USBD_DFU_Media->GetTick != NULL))
+  {
+    elapsed = USBD_DFU_Media->GetTick() - hdfu->BusyStart;
+    t = (t > elapsed) ? (t - elapsed) : 0U;
+  }
+  if (t == 0U)
+  {
+    t = 1U;
+  }
+  return MIN(t, USBD_DFU_POLL_MAX);
+}
+
+/**
+  * @brief  USBD_DFU_GetStatus
+  *         Answer GETSTATUS: dfuDNLOAD-IDLE while a buffer is free,
+  *         dfuDNBUSY with both taken, dfuMANIFEST until the thread is
+  *         through the last block and the Manifest callback
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval None
+  */
+static void  USBD_DFU_GetStatus (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+  uint32_t pending = hdfu->Filled - hdfu->Done;
+  uint32_t poll = 0U;
+  uint8_t state = hdfu->State;
+
+  switch (state)
+  {
+  case USBD_DFU_STATE_DNLOAD_SYNC:
+  case USBD_DFU_STATE_DNBUSY:
+    if (hdfu->Error != USBD_DFU_STATUS_OK)
+    {
+      hdfu->Status = hdfu->Error;
+      state = USBD_DFU_STATE_ERROR;
+    }
+    else if (pending >= 2U)
+    {
+      /* the host sends the next block once the oldest is programmed */
+      state = USBD_DFU_STATE_DNBUSY;
+      poll = USBD_DFU_PollTimeout(hdfu, 1U);
+    }
+    else
+    {
+      state = USBD_DFU_STATE_DNLOAD_IDLE;
+    }
+    hdfu->State = state;
+    break;
+
+  case USBD_DFU_STATE_MANIFEST_SYNC:
+    if (hdfu->Error != USBD_DFU_STATUS_OK)
+    {
+      hdfu->Status = hdfu->Error;
+      state = USBD_DFU_STATE_ERROR;
+      hdfu->State = state;
+    }
+    else if (hdfu->Manifested)
+    {
+      state = USBD_DFU_STATE_IDLE;
+      hdfu->State = state;
+    }
+    else
+    {
+      /* stays in MANIFEST-SYNC, where the host comes back after poll */
+      state = USBD_DFU_STATE_MANIFEST;
+      poll = USBD_DFU_PollTimeout(hdfu, pending);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  hdfu->StatusBuf[0] = hdfu->Status;
+  hdfu->StatusBuf[1] = (uint8_t)poll;
+  hdfu->StatusBuf[2] = (uint8_t)(poll >> 8);
+  hdfu->StatusBuf[3] = (uint8_t)(poll >> 16);
+  hdfu->StatusBuf[4] = state;
+  hdfu->StatusBuf[5] = 0x00;          /* iString */
+  USBD_CtlSendData(pdev, hdfu->StatusBuf, MIN(req->wLength, USBD_DFU_STATUS_SIZ));
+}
+
+/**
+  * @brief  USBD_DFU_Dnload
+  *         Receive a block into the free buffer, or end the download on a
+  *         zero length one
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_DFU_Dnload (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+  USBD_DFU_BlockTypeDef *blk;
+
+  if (req->wLength == 0U)
+  {
+    if (hdfu->State != USBD_DFU_STATE_DNLOAD_IDLE)
+    {
+      return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_NOTDONE);
+    }
+    hdfu->State = USBD_DFU_STATE_MANIFEST_SYNC;
+    return USBD_OK;
+  }
+
+  if (hdfu->State == USBD_DFU_STATE_IDLE)
+  {
+    /* new download: whatever the last one left queued is dropped, and
+       the thread starts erasing again from the first page */
+    USBD_DFU_Base = hdfu->Filled;
+    hdfu->NextAddr = USBD_DFU_APP_ADDR;
+    hdfu->NextBlock = req->wValue;
+    hdfu->Manifested = 0U;
+    hdfu->AbortReq = 1U;
+  }
+  else if ((hdfu->State != USBD_DFU_STATE_DNLOAD_IDLE) ||
+           (req->wValue != hdfu->NextBlock))
+  {
+    return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_STALLEDPKT);
+  }
+
+  if ((req->wLength > USBD_DFU_XFER_SIZE) ||
+      (req->wLength > USBD_DFU_APP_END - hdfu->NextAddr))
+  {
+    return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_ADDRESS);
+  }
+  if (hdfu->Filled - hdfu->Done >= 2U)
+  {
+    /* only after an abort with both buffers queued: the one the thread
+       is on cannot be overwritten */
+    return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_NOTDONE);
+  }
+
+  blk = &hdfu->Block[hdfu->Filled & 1U];
+  blk->Addr = hdfu->NextAddr;
+  blk->Len = req->wLength;
+  hdfu->State = USBD_DFU_STATE_DNLOAD_SYNC;
+  USBD_CtlPrepareRx(pdev, (uint8_t *)blk->Data, req->wLength);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_Upload
+  *         Send a block of the image area back, short at its end
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_DFU_Upload (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+  USBD_DFU_BlockTypeDef *blk = &hdfu->Block[hdfu->Filled & 1U];
+  uint32_t offset;
+  uint32_t len;
+
+  if (((hdfu->State != USBD_DFU_STATE_IDLE) &&
+       (hdfu->State != USBD_DFU_STATE_UPLOAD_IDLE)) ||
+      (hdfu->Filled != hdfu->Done) || (req->wLength == 0U))
+  {
+    return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_STALLEDPKT);
+  }
+
+  if (hdfu->State == USBD_DFU_STATE_IDLE)
+  {
+    hdfu->NextBlock = req->wValue;
+  }
+  offset = (uint32_t)(uint16_t)(req->wValue - hdfu->NextBlock) * USBD_DFU_XFER_SIZE;
+  len = MIN(req->wLength, USBD_DFU_XFER_SIZE);
+  len = (offset < USBD_DFU_APP_SIZE) ? MIN(len, USBD_DFU_APP_SIZE - offset) : 0U;
+
+  if ((len != 0U) &&
+      (USBD_DFU_Media->Read(USBD_DFU_APP_ADDR + offset, (uint8_t *)blk->Data, len) != USBD_OK))
+  {
+    return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_UNKNOWN);
+  }
+
+  /* a short block ends the upload */
+  hdfu->State = (len < req->wLength) ? USBD_DFU_STATE_IDLE : USBD_DFU_STATE_UPLOAD_IDLE;
+  USBD_CtlSendData(pdev, (uint8_t *)blk->Data, (uint16_t)len);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_Program
+  *         Erase what the block needs that is not erased yet, then write
+  *         it, and fold its time into the estimate
+  * @param  hdfu: class data
+  * @param  blk: block to program
+  * @retval USBD_DFU_STATUS_OK or the DFU status of the failure
+  */
+static uint8_t  USBD_DFU_Program (USBD_DFU_HandleTypeDef *hdfu, USBD_DFU_BlockTypeDef *blk)
+{
+  USBD_DFU_MediaTypeDef *media = USBD_DFU_Media;
+  uint32_t end = blk->Addr + blk->Len;
+  uint32_t t0 = 0U;
+  uint8_t ret = USBD_DFU_STATUS_OK;
+
+  if (media->GetTick != NULL)
+  {
+    t0 = media->GetTick();
+  }
+  hdfu->BusyStart = t0;
+  hdfu->Busy = 1U;
+
+  while ((ret == USBD_DFU_STATUS_OK) && (hdfu->ErasedEnd < end))
+  {
+    if (media->Erase(hdfu->ErasedEnd) != USBD_OK)
+    {
+      ret = USBD_DFU_STATUS_ERR_ERASE;
+    }
+    hdfu->ErasedEnd += USBD_DFU_PAGE_SIZE;
+  }
+  if (ret == USBD_DFU_STATUS_OK)
+  {
+    /* an odd length only comes with the last block: pad it with the
+       erased value so that halfword programming can take it */
+    if (blk->Len & 1U)
+    {
+      ((uint8_t *)blk->Data)[blk->Len] = 0xFF;
+    }
+    if (media->Write((const uint8_t *)blk->Data, blk->Addr, (blk->Len + 1U) & ~1U) != USBD_OK)
+    {
+      ret = USBD_DFU_STATUS_ERR_PROG;
+    }
+  }
+
+  if ((ret == USBD_DFU_STATUS_OK) && (media->GetTick != NULL))
+  {
+    /* BlockTime is x16: a quarter of the way to the new figure */
+    int32_t diff = (int32_t)((media->GetTick() - t0) << 4) - (int32_t)hdfu->BlockTime;
+
+    hdfu->BlockTime = (uint32_t)((int32_t)hdfu->BlockTime + diff / 4);
+    if (hdfu->BlockTime < 16U)
+    {
+      hdfu->BlockTime = 16U;
+    }
+  }
+  hdfu->Busy = 0U;
+  return ret;
+}
+
+/**
+  * @brief  USBD_DFU_Init
+  *         Start in dfuIDLE
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_DFU_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_DFU_HandleTypeDef *hdfu = &USBD_DFU_Handle;
+  USBD_DFU_MediaTypeDef *media = (USBD_DFU_MediaTypeDef *)pdev->pUserData;
+
+  if (media == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hdfu->Filled = 0U;
+  hdfu->Done = 0U;
+  hdfu->State = USBD_DFU_STATE_IDLE;
+  hdfu->Status = USBD_DFU_STATUS_OK;
+  hdfu->Error = USBD_DFU_STATUS_OK;
+  hdfu->AbortReq = 0U;
+  hdfu->Manifested = 0U;
+  hdfu->Busy = 0U;
+  hdfu->NextBlock = 0U;
+  hdfu->NextAddr = USBD_DFU_APP_ADDR;
+  hdfu->ErasedEnd = USBD_DFU_APP_ADDR;
+  /* the erase share of a block, with the write, until measured */
+  hdfu->BlockTime = ((uint32_t)media->EraseTime * 16U * USBD_DFU_XFER_SIZE) / USBD_DFU_PAGE_SIZE +
+                    (uint32_t)media->WriteTime * 16U;
+  if (hdfu->BlockTime < 16U)
+  {
+    hdfu->BlockTime = 16U;
+  }
+  USBD_DFU_Base = 0U;
+  USBD_DFU_Media = media;
+  pdev->pClassData = hdfu;
+
+  media->Init();
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_DeInit
+  *         Leave the media; a download under way is lost
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_DFU_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  if (pdev->pClassData != NULL)
+  {
+    ((USBD_DFU_MediaTypeDef *)pdev->pUserData)->DeInit();
+    pdev->pClassData = NULL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_Setup
+  *         Handle the DFU requests
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_DFU_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+  static uint8_t ifalt = 0;
+
+  if (hdfu == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_CLASS:
+    if (LOBYTE(req->wIndex) != USBD_DFU_ITF_NUM)
+    {
+      return USBD_FAIL;
+    }
+    switch (req->bRequest)
+    {
+    case USBD_DFU_REQ_DNLOAD:
+      return USBD_DFU_Dnload(pdev, req);
+
+    case USBD_DFU_REQ_UPLOAD:
+      return USBD_DFU_Upload(pdev, req);
+
+    case USBD_DFU_REQ_GETSTATUS:
+      USBD_DFU_GetStatus(pdev, req);
+      break;
+
+    case USBD_DFU_REQ_CLRSTATUS:
+      if (hdfu->State != USBD_DFU_STATE_ERROR)
+      {
+        return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_STALLEDPKT);
+      }
+      /* fall through: the thread drops what is left */
+    case USBD_DFU_REQ_ABORT:
+      USBD_DFU_Base = hdfu->Filled;
+      hdfu->AbortReq = 1U;
+      hdfu->Status = USBD_DFU_STATUS_OK;
+      hdfu->State = USBD_DFU_STATE_IDLE;
+      break;
+
+    case USBD_DFU_REQ_GETSTATE:
+      USBD_CtlSendData(pdev, (uint8_t *)&hdfu->State, 1);
+      break;
+
+    default:
+      /* DETACH included: there is no run-time mode to detach from */
+      return USBD_DFU_Fail(pdev, req, USBD_DFU_STATUS_ERR_STALLEDPKT);
+    }
+    break;
+
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE:
+      USBD_CtlSendData(pdev, &ifalt, 1);
+      break;
+
+    case USB_REQ_SET_INTERFACE:
+      break;
+    }
+    break;
+
+  default:
+    return USBD_FAIL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_EP0_RxReady
+  *         DNLOAD block received: hand it to the thread
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_DFU_EP0_RxReady (USBD_HandleTypeDef *pdev)
+{
+  USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData;
+
+  if ((hdfu == NULL) || (hdfu->State != USBD_DFU_STATE_DNLOAD_SYNC))
+  {
+    return USBD_OK;
+  }
+
+  hdfu->NextAddr += hdfu->Block[hdfu->Filled & 1U].Len;
+  hdfu->NextBlock++;
+  /* the block is whole before the thread may see it */
+  __DMB();
+  hdfu->Filled++;
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_GetCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DFU_GetCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_DFU_CfgDesc);
+  return (uint8_t *)USBD_DFU_CfgDesc;
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_DFU_GetOtherSpeedCfgDesc
+  *         Return the configuration of the speed the device is not at
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DFU_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_DFU_OtherSpeedDesc);
+  return (uint8_t *)USBD_DFU_OtherSpeedDesc;
+}
+
+/**
+  * @brief  USBD_DFU_GetDeviceQualifierDesc
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DFU_GetDeviceQualifierDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_DFU_DeviceQualifierDesc);
+  return USBD_DFU_DeviceQualifierDesc;
+}
+#endif /* USBD_FS_ONLY */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_dfu_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_DFU_RegisterMedia
+  *         Set the media callbacks, standalone use
+  * @param  pdev: device instance
+  * @param  fops: callbacks
+  * @retval status
+  */
+uint8_t  USBD_DFU_RegisterMedia (USBD_HandleTypeDef *pdev,
+                                 USBD_DFU_MediaTypeDef *fops)
+{
+  if ((fops == NULL) || (fops->Erase == NULL) || (fops->Write == NULL) ||
+      (fops->Read == NULL))
+  {
+    return USBD_FAIL;
+  }
+  pdev->pUserData = fops;
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DFU_Process
+  *         Program the next block received, or erase ahead of the next
+  *         one to come, or manifest a complete download
+  * @note   Thread context only, one step per call: a page erase or a block.
+  *         The USB interrupt keeps receiving into the other buffer
+  *         meanwhile.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void  USBD_DFU_Process (USBD_HandleTypeDef *pdev)
+{
+  USBD_DFU_HandleTypeDef *hdfu = USBD_DFU_Get(pdev);
+  USBD_DFU_MediaTypeDef *media = USBD_DFU_Media;
+  uint32_t filled;
+  uint32_t ahead;
+  uint8_t state;
+  uint8_t ret;
+
+  if ((hdfu == NULL) || (media == NULL))
+  {
+    return;
+  }
+
+  /* a new download sets AbortReq at its SETUP, long before its first
+     block counts in Filled: read in this order, no block of it is
+     programmed over pages of the last one */
+  filled = hdfu->Filled;
+  __DMB();
+  if (hdfu->AbortReq)
+  {
+    /* aborted, or a new download: written pages need erasing again */
+    hdfu->AbortReq = 0U;
+    hdfu->ErasedEnd = USBD_DFU_APP_ADDR;
+    hdfu->Error = USBD_DFU_STATUS_OK;
+  }
+  if ((int32_t)(USBD_DFU_Base - hdfu->Done) > 0)
+  {
+    hdfu->Done = USBD_DFU_Base;
+  }
+  if (hdfu->Error != USBD_DFU_STATUS_OK)
+  {
+    return;
+  }
+
+  if (filled != hdfu->Done)
+  {
+    ret = USBD_DFU_Program(hdfu, &hdfu->Block[hdfu->Done & 1U]);
+    if (ret != USBD_DFU_STATUS_OK)
+    {
+      hdfu->Error = ret;
+      return;
+    }
+    __DMB();
+    hdfu->Done++;
+    return;
+  }
+
+  state = hdfu->State;
+  if (state == USBD_DFU_STATE_MANIFEST_SYNC)
+  {
+    if (!hdfu->Manifested)
+    {
+      if ((media->Manifest != NULL) &&
+          (media->Manifest(hdfu->NextAddr - USBD_DFU_APP_ADDR) != USBD_OK))
+      {
+        hdfu->Error = USBD_DFU_STATUS_ERR_FIRMWARE;
+        return;
+      }
+      hdfu->ErasedEnd = USBD_DFU_APP_ADDR;
+      hdfu->Manifested = 1U;
+    }
+    return;
+  }
+
+  if ((state == USBD_DFU_STATE_DNLOAD_SYNC) || (state == USBD_DFU_STATE_DNBUSY) ||
+      (state == USBD_DFU_STATE_DNLOAD_IDLE))
+  {
+    /* nothing queued: erase where the next block goes, while it is on
+       its way */
+    ahead = hdfu->NextAddr + USBD_DFU_XFER_SIZE + (USBD_DFU_ERASE_AHEAD - 1U) * USBD_DFU_PAGE_SIZE;
+    if ((hdfu->ErasedEnd < ahead) && (hdfu->ErasedEnd < USBD_DFU_APP_END))
+    {
+      if (media->Erase(hdfu->ErasedEnd) != USBD_OK)
+      {
+        hdfu->Error = USBD_DFU_STATUS_ERR_ERASE;
+        return;
+      }
+      hdfu->ErasedEnd += USBD_DFU_PAGE_SIZE;
+    }
+  }
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_DFU_ENABLED */
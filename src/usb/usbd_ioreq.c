@@ -103,6 +103,12 @@ USBD_StatusTypeDef  USBD_CtlSendData (USBD_HandleTypeDef  *pdev,
  /* Start the transfer */
   USBD_LL_Transmit (pdev, 0x00, pbuf, len);  
   
+  if (len > pdev->ep_in[0].maxpacket)
+  {
+    /* Prepare endpoint for premature end of transfer */
+    USBD_LL_PrepareReceive (pdev, 0, NULL, 0);
+  }
+  
   return USBD_OK;
 }
 
@@ -206,6 +212,121 @@ USBD_StatusTypeDef  USBD_CtlReceiveStatus (USBD_HandleTypeDef  *pdev)
   return USBD_OK;
 }
 
+#if (USBD_CTL_DEFERRED == 1)
+/**
+* @brief  USBD_CtlDefer
+*         Leave the control request being handled unanswered: called from
+*         the Setup or EP0_RxReady of a class, the core then sends no
+*         status stage and EP0 NAKs the host until one of the
+*         USBD_CtlDeferredXxx below completes the request.
+* @param  pdev: device instance
+* @retval None
+*/
+void  USBD_CtlDefer (USBD_HandleTypeDef  *pdev)
+{
+  pdev->ep0_state = USBD_EP0_DEFERRED;
+}
+
+/**
+* @brief  USBD_CtlRequestId
+*         Identify the control request being handled, for the completion
+*         of a deferred one. Call it from the Setup or EP0_RxReady that
+*         defers the request, or from the callback of the class it ends
+*         up in, such as the Control callback of CDC.
+* @param  pdev: device instance
+* @retval id of the request
+*/
+uint32_t  USBD_CtlRequestId (USBD_HandleTypeDef  *pdev)
+{
+  return pdev->ep0_setup_seq;
+}
+
+/**
+* @brief  USBD_CtlDeferredSendData
+*         Answer a deferred device to host request, from any context
+* @param  pdev: device instance
+* @param  id: USBD_CtlRequestId of the request
+* @param  buff: pointer to data buffer, untouched until the status stage
+* @param  len: length of data to be sent
+* @retval status, USBD_FAIL if a new SETUP or a reset has replaced the
+*         request
+*/
+USBD_StatusTypeDef  USBD_CtlDeferredSendData (USBD_HandleTypeDef  *pdev, 
+                                       uint32_t id,
+                                       uint8_t *pbuf,
+                                       uint16_t len)
+{
+  USBD_StatusTypeDef ret = USBD_FAIL;
+  uint32_t primask;
+
+  /* the USB interrupt must not take a new SETUP between the check and
+     the start of the answer */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if ((pdev->ep0_state == USBD_EP0_DEFERRED) && (pdev->ep0_setup_seq == id))
+  {
+    ret = USBD_CtlSendData(pdev, pbuf, MIN(len, pdev->ep0_data_len));
+  }
+  __set_PRIMASK(primask);
+
+  return ret;
+}
+
+/**
+* @brief  USBD_CtlDeferredSendStatus
+*         Complete a deferred request with no data, or whose OUT data has
+*         been received, from any context
+* @param  pdev: device instance
+* @param  id: USBD_CtlRequestId of the request
+* @retval status, USBD_FAIL if a new SETUP or a reset has replaced the
+*         request
+*/
+USBD_StatusTypeDef  USBD_CtlDeferredSendStatus (USBD_HandleTypeDef  *pdev,
+                                         uint32_t id)
+{
+  USBD_StatusTypeDef ret = USBD_FAIL;
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if ((pdev->ep0_state == USBD_EP0_DEFERRED) && (pdev->ep0_setup_seq == id))
+  {
+    ret = USBD_CtlSendStatus(pdev);
+  }
+  __set_PRIMASK(primask);
+
+  return ret;
+}
+
+/**
+* @brief  USBD_CtlDeferredError
+*         Refuse a deferred request with a STALL, from any context
+* @param  pdev: device instance
+* @param  id: USBD_CtlRequestId of the request
+* @retval status, USBD_FAIL if a new SETUP or a reset has replaced the
+*         request
+*/
+USBD_StatusTypeDef  USBD_CtlDeferredError (USBD_HandleTypeDef  *pdev,
+                                    uint32_t id)
+{
+  USBD_StatusTypeDef ret = USBD_FAIL;
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if ((pdev->ep0_state == USBD_EP0_DEFERRED) && (pdev->ep0_setup_seq == id))
+  {
+    pdev->ep0_state = USBD_EP0_STALL;
+    USBD_LL_StallEP(pdev, 0x80);
+    USBD_LL_StallEP(pdev, 0);
+    ret = USBD_OK;
+  }
+  __set_PRIMASK(primask);
+
+  return ret;
+}
+#endif /* USBD_CTL_DEFERRED */
+
 
 /**
 * @brief  USBD_GetRxCount
@@ -0,0 +1,1212 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc.c
+  * @brief   Mass storage class with pipelined data phases, see usbd_msc.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc.h"
+#include "usbd_ctlreq.h"
+
+#if (USBD_MSC_ENABLED == 1)
+
+#if (USBD_MSC_PMA_ALLOC == 1)
+#include "usbd_cdc_pma.h"
+#endif
+
+#if ((USBD_MSC_BUF_SIZE % USBD_MSC_FS_MAX_PACKET_SIZE) != 0) || (USBD_MSC_BUF_SIZE > 0xFFFFU)
+#error "USBD_MSC_BUF_SIZE must be a multiple of the max packet size below 64 KiB"
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_msc
+  * @{
+  */
+
+/** @defgroup usbd_msc_Private_Defines
+  * @{
+  */
+/* Self powered, like the CDC configuration */
+#define USBD_MSC_CFG_ATTRIBUTES                     0xC0
+
+#if (USBD_MSC_PMA_ALLOC == 1)
+/* Packet memory of the two endpoints: after the CDC buffers when they
+   share a composite, right after EP0 otherwise */
+#ifndef USBD_MSC_PMA_ADDR
+#if (USBD_COMPOSITE_ENABLED == 1)
+#define USBD_MSC_PMA_ADDR                           (USBD_CDC_PMA_END)
+#else
+#define USBD_MSC_PMA_ADDR                           (USBD_CDC_PMA_BASE)
+#endif
+#endif
+
+#define USBD_MSC_PMA_OUT_SIZE                       (USBD_MSC_FS_MAX_PACKET_SIZE << USBD_MSC_DBL_BUF_OUT)
+#define USBD_MSC_PMA_IN_SIZE                        (USBD_MSC_FS_MAX_PACKET_SIZE << USBD_MSC_DBL_BUF_IN)
+#define USBD_MSC_PMA_END                            (USBD_MSC_PMA_ADDR + USBD_MSC_PMA_OUT_SIZE + \
+                                                     USBD_MSC_PMA_IN_SIZE)
+
+#if (USBD_MSC_PMA_END > USBD_PMA_SIZE)
+#error "MSC endpoint buffers do not fit in packet memory"
+#endif
+#if (((USBD_MSC_IN_EP & 0x0F) >= USBD_PMA_NUM_EP) || \
+     ((USBD_MSC_OUT_EP & 0x0F) >= USBD_PMA_NUM_EP))
+#error "MSC endpoints beyond the buffer descriptor table, raise USBD_PMA_NUM_EP"
+#endif
+#endif /* USBD_MSC_PMA_ALLOC */
+
+/* Transport state */
+#define USBD_MSC_BOT_IDLE                           0U  /* CBW armed */
+#define USBD_MSC_BOT_DATA_OUT                       1U
+#define USBD_MSC_BOT_DATA_IN                        2U
+#define USBD_MSC_BOT_LAST_DATA_IN                   3U  /* one transfer, then the CSW */
+#define USBD_MSC_BOT_STALLED                        4U  /* CSW after the host clears IN */
+
+#define USBD_MSC_BOT_STATUS_NORMAL                  0U
+#define USBD_MSC_BOT_STATUS_RECOVERY                1U  /* after a reset */
+#define USBD_MSC_BOT_STATUS_ERROR                   2U  /* bad CBW: stalled until reset */
+
+/* SCSI commands */
+#define USBD_MSC_SCSI_TEST_UNIT_READY               0x00
+#define USBD_MSC_SCSI_REQUEST_SENSE                 0x03
+#define USBD_MSC_SCSI_INQUIRY                       0x12
+#define USBD_MSC_SCSI_MODE_SENSE6                   0x1A
+#define USBD_MSC_SCSI_START_STOP_UNIT               0x1B
+#define USBD_MSC_SCSI_PREVENT_ALLOW                 0x1E
+#define USBD_MSC_SCSI_READ_FORMAT_CAPACITIES        0x23
+#define USBD_MSC_SCSI_READ_CAPACITY10               0x25
+#define USBD_MSC_SCSI_READ10                        0x28
+#define USBD_MSC_SCSI_WRITE10                       0x2A
+#define USBD_MSC_SCSI_VERIFY10                      0x2F
+#define USBD_MSC_SCSI_SYNCHRONIZE_CACHE10           0x35
+#define USBD_MSC_SCSI_MODE_SENSE10                  0x5A
+
+/* Sense keys and additional sense codes */
+#define USBD_MSC_SENSE_NO_SENSE                     0x00
+#define USBD_MSC_SENSE_NOT_READY                    0x02
+#define USBD_MSC_SENSE_MEDIUM_ERROR                 0x03
+#define USBD_MSC_SENSE_ILLEGAL_REQUEST              0x05
+#define USBD_MSC_SENSE_DATA_PROTECT                 0x07
+
+#define USBD_MSC_ASC_WRITE_FAULT                    0x03
+#define USBD_MSC_ASC_UNRECOVERED_READ_ERROR         0x11
+#define USBD_MSC_ASC_INVALID_CDB                    0x20
+#define USBD_MSC_ASC_ADDRESS_OUT_OF_RANGE           0x21
+#define USBD_MSC_ASC_INVALID_FIELD_IN_CDB           0x24
+#define USBD_MSC_ASC_WRITE_PROTECTED                0x27
+#define USBD_MSC_ASC_MEDIUM_NOT_PRESENT             0x3A
+
+#define USBD_MSC_GET_BE32(p)                        (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+                                                     ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define USBD_MSC_GET_BE16(p)                        (((uint32_t)(p)[0] << 8) | (uint32_t)(p)[1])
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t  USBD_MSC_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_MSC_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_MSC_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_MSC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_MSC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  *USBD_MSC_GetFSCfgDesc (uint16_t *length);
+#if (USBD_FS_ONLY == 0)
+static uint8_t  *USBD_MSC_GetHSCfgDesc (uint16_t *length);
+static uint8_t  *USBD_MSC_GetOtherSpeedCfgDesc (uint16_t *length);
+static uint8_t  *USBD_MSC_GetDeviceQualifierDesc (uint16_t *length);
+#endif /* USBD_FS_ONLY */
+static USBD_MSC_HandleTypeDef *USBD_MSC_Get (USBD_HandleTypeDef *pdev);
+static void     USBD_MSC_ArmCbw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc);
+static void     USBD_MSC_SendCsw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                  uint8_t status);
+static void     USBD_MSC_Abort (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                uint8_t status);
+static void     USBD_MSC_Sense (USBD_MSC_HandleTypeDef *hmsc, uint8_t key, uint8_t asc);
+static void     USBD_MSC_SendData (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                   const uint8_t *pbuf, uint32_t len);
+static void     USBD_MSC_Kick (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc);
+static int8_t   USBD_MSC_ReadWrite (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                    uint8_t dir_in);
+static int8_t   USBD_MSC_Scsi (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc);
+static void     USBD_MSC_DecodeCbw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Private_Variables
+  * @{
+  */
+USBD_ClassTypeDef  USBD_MSC =
+{
+  USBD_MSC_Init,
+  USBD_MSC_DeInit,
+  USBD_MSC_Setup,
+  NULL,                 /* EP0_TxSent */
+  NULL,                 /* EP0_RxReady */
+  USBD_MSC_DataIn,
+  USBD_MSC_DataOut,
+  NULL,                 /* SOF */
+  NULL,
+  NULL,
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_MSC_GetFSCfgDesc,
+  NULL,
+  NULL,
+#else
+  USBD_MSC_GetHSCfgDesc,
+  USBD_MSC_GetFSCfgDesc,
+  USBD_MSC_GetOtherSpeedCfgDesc,
+  USBD_MSC_GetDeviceQualifierDesc,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  NULL,                 /* LPM */
+#endif
+};
+
+/* Whole configuration: one interface, bulk IN and OUT */
+#define USBD_MSC_CFG_DESC(type, mps)                                          \
+  0x09,                               /* bLength */                          \
+  (type),                             /* bDescriptorType */                  \
+  LOBYTE(USBD_MSC_CFG_DESC_SIZ),      /* wTotalLength */                     \
+  HIBYTE(USBD_MSC_CFG_DESC_SIZ),                                             \
+  0x01,                               /* bNumInterfaces */                   \
+  0x01,                               /* bConfigurationValue */              \
+  0x00,                               /* iConfiguration */                   \
+  USBD_MSC_CFG_ATTRIBUTES,            /* bmAttributes */                     \
+  0x32,                               /* MaxPower 100 mA */                  \
+  /* Interface */                                                            \
+  0x09,                               /* bLength */                          \
+  USB_DESC_TYPE_INTERFACE,            /* bDescriptorType */                  \
+  USBD_MSC_ITF_NUM,                   /* bInterfaceNumber */                 \
+  0x00,                               /* bAlternateSetting */                \
+  0x02,                               /* bNumEndpoints */                    \
+  0x08,                               /* bInterfaceClass: mass storage */    \
+  0x06,                               /* bInterfaceSubClass: SCSI */         \
+  0x50,                               /* bInterfaceProtocol: Bulk-Only */    \
+  0x00,                               /* iInterface */                       \
+  /* Endpoint IN */                                                          \
+  0x07,                               /* bLength */                          \
+  USB_DESC_TYPE_ENDPOINT,             /* bDescriptorType */                  \
+  USBD_MSC_IN_EP,                     /* bEndpointAddress */                 \
+  0x02,                               /* bmAttributes: bulk */               \
+  LOBYTE(mps),                        /* wMaxPacketSize */                   \
+  HIBYTE(mps),                                                               \
+  0x00,                               /* bInterval */                        \
+  /* Endpoint OUT */                                                         \
+  0x07,                               /* bLength */                          \
+  USB_DESC_TYPE_ENDPOINT,             /* bDescriptorType */                  \
+  USBD_MSC_OUT_EP,                    /* bEndpointAddress */                 \
+  0x02,                               /* bmAttributes: bulk */               \
+  LOBYTE(mps),                        /* wMaxPacketSize */                   \
+  HIBYTE(mps),                                                               \
+  0x00                                /* bInterval */
+
+__ALIGN_BEGIN static const uint8_t USBD_MSC_CfgFSDesc[] __ALIGN_END =
+{
+  USBD_MSC_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, USBD_MSC_FS_MAX_PACKET_SIZE)
+};
+
+/* The build fails if wTotalLength does not match the descriptor */
+typedef char USBD_MSC_CfgFSDescSizeCheck[(sizeof(USBD_MSC_CfgFSDesc) == USBD_MSC_CFG_DESC_SIZ) ? 1 : -1];
+
+#if (USBD_FS_ONLY == 0)
+__ALIGN_BEGIN static const uint8_t USBD_MSC_CfgHSDesc[] __ALIGN_END =
+{
+  USBD_MSC_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, USBD_MSC_HS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_MSC_OtherSpeedFSDesc[] __ALIGN_END =
+{
+  USBD_MSC_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, USBD_MSC_FS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_MSC_OtherSpeedHSDesc[] __ALIGN_END =
+{
+  USBD_MSC_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, USBD_MSC_HS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static uint8_t USBD_MSC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0x00,                 /* class given by the interface */
+  0x00,
+  0x00,
+  0x40,
+  0x01,
+  0x00,
+};
+
+static USBD_HandleTypeDef *USBD_MSC_Dev;
+#endif /* USBD_FS_ONLY */
+
+static USBD_MSC_HandleTypeDef USBD_MSC_Handle;
+
+/* Storage of the last Init, for USBD_MSC_StorageDone */
+static USBD_MSC_StorageTypeDef *USBD_MSC_Storage;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Private_Functions
+  * @{
+  */
+
+#if (USBD_MSC_PMA_ALLOC == 1)
+/**
+  * @brief  USBD_MSC_ConfigPMA
+  *         Assign packet memory to the MSC endpoints
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void  USBD_MSC_ConfigPMA (USBD_HandleTypeDef *pdev)
+{
+  uint32_t addr = USBD_MSC_PMA_ADDR;
+
+#if (USBD_MSC_DBL_BUF_OUT == 1)
+  USBD_LL_PMAConfig(pdev, USBD_MSC_OUT_EP, USBD_EP_DBL_BUF,
+                    addr | ((addr + USBD_MSC_FS_MAX_PACKET_SIZE) << 16));
+#else
+  USBD_LL_PMAConfig(pdev, USBD_MSC_OUT_EP, USBD_EP_SNG_BUF, addr);
+#endif
+  addr += USBD_MSC_PMA_OUT_SIZE;
+
+#if (USBD_MSC_DBL_BUF_IN == 1)
+  USBD_LL_PMAConfig(pdev, USBD_MSC_IN_EP, USBD_EP_DBL_BUF,
+                    addr | ((addr + USBD_MSC_FS_MAX_PACKET_SIZE) << 16));
+#else
+  USBD_LL_PMAConfig(pdev, USBD_MSC_IN_EP, USBD_EP_SNG_BUF, addr);
+#endif
+}
+#endif /* USBD_MSC_PMA_ALLOC */
+
+/**
+  * @brief  USBD_MSC_Get
+  *         State of the class, standalone or as a function of a composite
+  * @param  pdev: device instance
+  * @retval class data, NULL while not configured
+  */
+static USBD_MSC_HandleTypeDef *USBD_MSC_Get (USBD_HandleTypeDef *pdev)
+{
+#if (USBD_COMPOSITE_ENABLED == 1)
+  if (pdev->pClass != &USBD_MSC)
+  {
+    return (USBD_MSC_HandleTypeDef *)USBD_Composite_GetClassData(pdev, &USBD_MSC);
+  }
+#endif /* USBD_COMPOSITE_ENABLED */
+  return (USBD_MSC_HandleTypeDef *)pdev->pClassData;
+}
+
+/**
+  * @brief  USBD_MSC_ArmCbw
+  *         Wait for the next command
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @retval None
+  */
+static void  USBD_MSC_ArmCbw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc)
+{
+  hmsc->BotState = USBD_MSC_BOT_IDLE;
+  USBD_LL_PrepareReceive(pdev, USBD_MSC_OUT_EP, (uint8_t *)hmsc->CbwBuf, USBD_MSC_CBW_LENGTH);
+}
+
+/**
+  * @brief  USBD_MSC_SendCsw
+  *         End the command with its status, and wait for the next one
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @param  status: USBD_MSC_CSW_PASSED, FAILED or PHASE_ERROR
+  * @retval None
+  */
+static void  USBD_MSC_SendCsw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                               uint8_t status)
+{
+  uint8_t *csw = (uint8_t *)hmsc->CswBuf;
+  uint32_t residue = hmsc->Cbw.DataLength - MIN(hmsc->Xferred, hmsc->Cbw.DataLength);
+  uint32_t i;
+
+  for (i = 0U; i < 4U; i++)
+  {
+    csw[i] = (uint8_t)(USBD_MSC_CSW_SIGNATURE >> (8U * i));
+    csw[4U + i] = (uint8_t)(hmsc->Cbw.Tag >> (8U * i));
+    csw[8U + i] = (uint8_t)(residue >> (8U * i));
+  }
+  csw[12] = status;
+
+  USBD_LL_Transmit(pdev, USBD_MSC_IN_EP, csw, USBD_MSC_CSW_LENGTH);
+  USBD_MSC_ArmCbw(pdev, hmsc);
+}
+
+/**
+  * @brief  USBD_MSC_Abort
+  *         Stall the data phase the host still expects: the CSW goes out
+  *         once the host has cleared IN
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @param  status: of that CSW, USBD_MSC_CSW_PASSED with a residue when
+  *         the device had less data than announced
+  * @retval None
+  */
+static void  USBD_MSC_Abort (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                             uint8_t status)
+{
+  hmsc->CswStatus = status;
+  if (((hmsc->Cbw.Flags & 0x80U) == 0U) && (hmsc->Cbw.DataLength != 0U) &&
+      (hmsc->BotStatus == USBD_MSC_BOT_STATUS_NORMAL))
+  {
+    USBD_LL_StallEP(pdev, USBD_MSC_OUT_EP);
+  }
+  USBD_LL_StallEP(pdev, USBD_MSC_IN_EP);
+  hmsc->BotState = USBD_MSC_BOT_STALLED;
+}
+
+/**
+  * @brief  USBD_MSC_Sense
+  *         Set what the next REQUEST SENSE reports
+  * @param  hmsc: class data
+  * @param  key: sense key
+  * @param  asc: additional sense code
+  * @retval None
+  */
+static void  USBD_MSC_Sense (USBD_MSC_HandleTypeDef *hmsc, uint8_t key, uint8_t asc)
+{
+  hmsc->SenseKey = key;
+  hmsc->SenseAsc = asc;
+}
+
+/**
+  * @brief  USBD_MSC_SendData
+  *         Data phase of one transfer for the short answers, CSW after it
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @param  pbuf: answer, valid until sent
+  * @param  len: its length, cut to what the host asked for
+  * @retval None
+  */
+static void  USBD_MSC_SendData (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                const uint8_t *pbuf, uint32_t len)
+{
+  len = MIN(len, hmsc->Cbw.DataLength);
+  if (len == 0U)
+  {
+    return;
+  }
+  hmsc->Xferred = len;
+  hmsc->BotState = USBD_MSC_BOT_LAST_DATA_IN;
+  USBD_LL_Transmit(pdev, USBD_MSC_IN_EP, (uint8_t *)pbuf, (uint16_t)len);
+}
+
+/**
+  * @brief  USBD_MSC_Kick
+  *         Move the data phase of a READ(10) or WRITE(10) on: start the
+  *         consumer on a chunk the producer is done with, start the
+  *         producer on a free buffer, end the command when all is through
+  * @note   Completions that come while it runs, from the storage calling
+  *         USBD_MSC_StorageDone before returning, make it loop instead of
+  *         recursing.
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @retval None
+  */
+static void  USBD_MSC_Kick (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc)
+{
+  USBD_MSC_StorageTypeDef *storage = USBD_MSC_Storage;
+  uint8_t dir_in;
+  uint8_t lun;
+  uint8_t *buf;
+  uint32_t blk;
+  uint32_t num;
+  uint32_t n;
+
+  if (hmsc->InKick)
+  {
+    hmsc->KickAgain = 1U;
+    return;
+  }
+  hmsc->InKick = 1U;
+
+  do
+  {
+    hmsc->KickAgain = 0U;
+    if ((hmsc->BotState != USBD_MSC_BOT_DATA_IN) && (hmsc->BotState != USBD_MSC_BOT_DATA_OUT))
+    {
+      break;
+    }
+    /* the Read or Write of a command reset since may still move data in
+       or out of either buffer: neither is reused before it is done, the
+       USBD_MSC_StorageDone that ends it kicks again */
+    if (hmsc->Discard)
+    {
+      break;
+    }
+    dir_in = (hmsc->BotState == USBD_MSC_BOT_DATA_IN);
+    lun = hmsc->Cbw.Lun;
+
+    /* consumer: USB IN on a read, the storage on a write */
+    if (!hmsc->Failed && !hmsc->ConsBusy && (hmsc->ConsIssued != hmsc->ProdDone) &&
+        (dir_in || !hmsc->MediaBusy))
+    {
+      n = hmsc->ConsIssued++;
+      buf = (uint8_t *)hmsc->Buf[n & 1U];
+      blk = n * hmsc->ChunkBlocks;
+      num = MIN(hmsc->ChunkBlocks, hmsc->BlkLen - blk);
+      hmsc->ConsBusy = 1U;
+      if (dir_in)
+      {
+        USBD_LL_Transmit(pdev, USBD_MSC_IN_EP, buf, (uint16_t)(num * hmsc->BlockSize[lun]));
+      }
+      else
+      {
+        hmsc->MediaBusy = 1U;
+        if (storage->Write(lun, buf, hmsc->BlkAddr + blk, (uint16_t)num) != 0)
+        {
+          hmsc->MediaBusy = 0U;
+          hmsc->ConsBusy = 0U;
+          hmsc->Failed = 1U;
+          USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_MEDIUM_ERROR, USBD_MSC_ASC_WRITE_FAULT);
+        }
+      }
+    }
+
+    /* producer: the storage on a read, USB OUT on a write, at most two
+       chunks ahead */
+    if (!hmsc->Failed && !hmsc->ProdBusy && (hmsc->ProdIssued < hmsc->NumChunks) &&
+        (hmsc->ProdIssued - hmsc->ConsDone < 2U) && (!dir_in || !hmsc->MediaBusy))
+    {
+      n = hmsc->ProdIssued++;
+      buf = (uint8_t *)hmsc->Buf[n & 1U];
+      blk = n * hmsc->ChunkBlocks;
+      num = MIN(hmsc->ChunkBlocks, hmsc->BlkLen - blk);
+      hmsc->ProdBusy = 1U;
+      if (dir_in)
+      {
+        hmsc->MediaBusy = 1U;
+        if (storage->Read(lun, buf, hmsc->BlkAddr + blk, (uint16_t)num) != 0)
+        {
+          hmsc->MediaBusy = 0U;
+          hmsc->ProdBusy = 0U;
+          hmsc->Failed = 1U;
+          USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_MEDIUM_ERROR, USBD_MSC_ASC_UNRECOVERED_READ_ERROR);
+        }
+      }
+      else
+      {
+        USBD_LL_PrepareReceive(pdev, USBD_MSC_OUT_EP, buf, (uint16_t)(num * hmsc->BlockSize[lun]));
+      }
+    }
+
+    if (!hmsc->ProdBusy && !hmsc->ConsBusy)
+    {
+      if (hmsc->Failed)
+      {
+        USBD_MSC_Abort(pdev, hmsc, USBD_MSC_CSW_FAILED);
+      }
+      else if (hmsc->ConsDone == hmsc->NumChunks)
+      {
+        if (hmsc->Xferred < hmsc->Cbw.DataLength)
+        {
+          /* the host announced more: end its side with a stall */
+          USBD_MSC_Abort(pdev, hmsc, USBD_MSC_CSW_PASSED);
+        }
+        else
+        {
+          USBD_MSC_SendCsw(pdev, hmsc, USBD_MSC_CSW_PASSED);
+        }
+      }
+    }
+  } while (hmsc->KickAgain);
+
+  hmsc->InKick = 0U;
+}
+
+/**
+  * @brief  USBD_MSC_ReadWrite
+  *         Check READ(10) or WRITE(10) and start its data phase
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @param  dir_in: 1 for READ(10)
+  * @retval 0, or -1 with the sense set, or -1 with CswStatus set when the
+  *         host announced a data phase that does not fit the command
+  */
+static int8_t  USBD_MSC_ReadWrite (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc,
+                                   uint8_t dir_in)
+{
+  USBD_MSC_StorageTypeDef *storage = USBD_MSC_Storage;
+  uint8_t lun = hmsc->Cbw.Lun;
+  uint32_t blk_num;
+  uint16_t blk_size;
+
+  if (storage->IsReady(lun) != 0)
+  {
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_NOT_READY, USBD_MSC_ASC_MEDIUM_NOT_PRESENT);
+    return -1;
+  }
+  if (!dir_in && (storage->IsWriteProtected(lun) != 0))
+  {
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_DATA_PROTECT, USBD_MSC_ASC_WRITE_PROTECTED);
+    return -1;
+  }
+  if ((storage->GetCapacity(lun, &blk_num, &blk_size) != 0) || (blk_size == 0U) ||
+      ((USBD_MSC_BUF_SIZE % blk_size) != 0U))
+  {
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_NOT_READY, USBD_MSC_ASC_MEDIUM_NOT_PRESENT);
+    return -1;
+  }
+  hmsc->BlockNum[lun] = blk_num;
+  hmsc->BlockSize[lun] = blk_size;
+
+  hmsc->BlkAddr = USBD_MSC_GET_BE32(&hmsc->Cbw.CB[2]);
+  hmsc->BlkLen = USBD_MSC_GET_BE16(&hmsc->Cbw.CB[7]);
+
+  if ((hmsc->BlkAddr >= blk_num) || (hmsc->BlkLen > blk_num - hmsc->BlkAddr))
+  {
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_ILLEGAL_REQUEST, USBD_MSC_ASC_ADDRESS_OUT_OF_RANGE);
+    return -1;
+  }
+  /* what the host announced against what the command moves, the cases
+     of Bulk-Only 6.7: more than the device has ends in a residue, less
+     or the other direction in a phase error */
+  if (hmsc->BlkLen == 0U)
+  {
+    if (hmsc->Cbw.DataLength == 0U)
+    {
+      return 0;
+    }
+    hmsc->CswStatus = USBD_MSC_CSW_PASSED;
+    return -1;
+  }
+  if ((hmsc->Cbw.DataLength < hmsc->BlkLen * blk_size) ||
+      (((hmsc->Cbw.Flags & 0x80U) != 0U) != (dir_in != 0U)))
+  {
+    hmsc->CswStatus = USBD_MSC_CSW_PHASE_ERROR;
+    return -1;
+  }
+
+  hmsc->ChunkBlocks = USBD_MSC_BUF_SIZE / blk_size;
+  hmsc->NumChunks = (hmsc->BlkLen + hmsc->ChunkBlocks - 1U) / hmsc->ChunkBlocks;
+  hmsc->ProdIssued = 0U;
+  hmsc->ProdDone = 0U;
+  hmsc->ConsIssued = 0U;
+  hmsc->ConsDone = 0U;
+  hmsc->ProdBusy = 0U;
+  hmsc->ConsBusy = 0U;
+  hmsc->Failed = 0U;
+  hmsc->BotState = dir_in ? USBD_MSC_BOT_DATA_IN : USBD_MSC_BOT_DATA_OUT;
+  USBD_MSC_Kick(pdev, hmsc);
+  return 0;
+}
+
+/**
+  * @brief  USBD_MSC_Scsi
+  *         Run the command of the CBW. Short answers go out at once; READ
+  *         and WRITE start their data phase
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @retval 0, or -1 with the sense set
+  */
+static int8_t  USBD_MSC_Scsi (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc)
+{
+  USBD_MSC_StorageTypeDef *storage = USBD_MSC_Storage;
+  /* the CBW is decoded: its buffer holds the answer until the CSW */
+  uint8_t *ans = (uint8_t *)hmsc->CbwBuf;
+  uint8_t lun = hmsc->Cbw.Lun;
+  uint8_t *cb = hmsc->Cbw.CB;
+  uint32_t blk_num;
+  uint16_t blk_size;
+  uint32_t i;
+
+  switch (cb[0])
+  {
+  case USBD_MSC_SCSI_TEST_UNIT_READY:
+    if (storage->IsReady(lun) != 0)
+    {
+      USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_NOT_READY, USBD_MSC_ASC_MEDIUM_NOT_PRESENT);
+      return -1;
+    }
+    return 0;
+
+  case USBD_MSC_SCSI_REQUEST_SENSE:
+    for (i = 0U; i < 18U; i++)
+    {
+      ans[i] = 0U;
+    }
+    ans[0] = 0x70;                    /* current error, fixed format */
+    ans[2] = hmsc->SenseKey;
+    ans[7] = 10U;                     /* additional sense length */
+    ans[12] = hmsc->SenseAsc;
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_NO_SENSE, 0U);
+    USBD_MSC_SendData(pdev, hmsc, ans, MIN(cb[4], 18U));
+    return 0;
+
+  case USBD_MSC_SCSI_INQUIRY:
+    if (cb[1] & 0x01U)
+    {
+      /* EVPD: the supported pages page, and no other */
+      if (cb[2] != 0x00U)
+      {
+        USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_ILLEGAL_REQUEST, USBD_MSC_ASC_INVALID_FIELD_IN_CDB);
+        return -1;
+      }
+      ans[0] = 0x00;
+      ans[1] = 0x00;
+      ans[2] = 0x00;
+      ans[3] = 0x01;
+      ans[4] = 0x00;
+      USBD_MSC_SendData(pdev, hmsc, ans, MIN(USBD_MSC_GET_BE16(&cb[3]), 5U));
+      return 0;
+    }
+    USBD_MSC_SendData(pdev, hmsc, &storage->pInquiry[lun * USBD_MSC_INQUIRY_LENGTH],
+                      MIN(USBD_MSC_GET_BE16(&cb[3]), USBD_MSC_INQUIRY_LENGTH));
+    return 0;
+
+  case USBD_MSC_SCSI_MODE_SENSE6:
+  case USBD_MSC_SCSI_MODE_SENSE10:
+    /* header only, no pages: enough for every host, WP on request */
+    for (i = 0U; i < 8U; i++)
+    {
+      ans[i] = 0U;
+    }
+    if (cb[0] == USBD_MSC_SCSI_MODE_SENSE6)
+    {
+      ans[0] = 0x03;                  /* mode data length */
+      ans[2] = (storage->IsWriteProtected(lun) != 0) ? 0x80 : 0x00;
+      USBD_MSC_SendData(pdev, hmsc, ans, MIN(cb[4], 4U));
+    }
+    else
+    {
+      ans[1] = 0x06;
+      ans[3] = (storage->IsWriteProtected(lun) != 0) ? 0x80 : 0x00;
+      USBD_MSC_SendData(pdev, hmsc, ans, MIN(USBD_MSC_GET_BE16(&cb[7]), 8U));
+    }
+    return 0;
+
+  case USBD_MSC_SCSI_READ_FORMAT_CAPACITIES:
+  case USBD_MSC_SCSI_READ_CAPACITY10:
+    if ((storage->GetCapacity(lun, &blk_num, &blk_size) != 0) || (blk_num == 0U))
+    {
+      USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_NOT_READY, USBD_MSC_ASC_MEDIUM_NOT_PRESENT);
+      return -1;
+    }
+    hmsc->BlockNum[lun] = blk_num;
+    hmsc->BlockSize[lun] = blk_size;
+    if (cb[0] == USBD_MSC_SCSI_READ_CAPACITY10)
+    {
+      /* last block, not the count */
+      blk_num -= 1U;
+      ans[0] = (uint8_t)(blk_num >> 24);
+      ans[1] = (uint8_t)(blk_num >> 16);
+      ans[2] = (uint8_t)(blk_num >> 8);
+      ans[3] = (uint8_t)blk_num;
+      ans[4] = 0x00;
+      ans[5] = 0x00;
+      ans[6] = (uint8_t)(blk_size >> 8);
+      ans[7] = (uint8_t)blk_size;
+      USBD_MSC_SendData(pdev, hmsc, ans, 8U);
+    }
+    else
+    {
+      ans[0] = 0x00;
+      ans[1] = 0x00;
+      ans[2] = 0x00;
+      ans[3] = 0x08;                  /* capacity list length */
+      ans[4] = (uint8_t)(blk_num >> 24);
+      ans[5] = (uint8_t)(blk_num >> 16);
+      ans[6] = (uint8_t)(blk_num >> 8);
+      ans[7] = (uint8_t)blk_num;
+      ans[8] = 0x02;                  /* formatted media */
+      ans[9] = 0x00;
+      ans[10] = (uint8_t)(blk_size >> 8);
+      ans[11] = (uint8_t)blk_size;
+      USBD_MSC_SendData(pdev, hmsc, ans, MIN(USBD_MSC_GET_BE16(&cb[7]), 12U));
+    }
+    return 0;
+
+  case USBD_MSC_SCSI_READ10:
+    return USBD_MSC_ReadWrite(pdev, hmsc, 1U);
+
+  case USBD_MSC_SCSI_WRITE10:
+    return USBD_MSC_ReadWrite(pdev, hmsc, 0U);
+
+  case USBD_MSC_SCSI_START_STOP_UNIT:
+  case USBD_MSC_SCSI_PREVENT_ALLOW:
+  case USBD_MSC_SCSI_SYNCHRONIZE_CACHE10:
+    return 0;
+
+  case USBD_MSC_SCSI_VERIFY10:
+    /* BYTCHK would bring a data phase: not supported */
+    if (cb[1] & 0x02U)
+    {
+      USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_ILLEGAL_REQUEST, USBD_MSC_ASC_INVALID_FIELD_IN_CDB);
+      return -1;
+    }
+    return 0;
+
+  default:
+    USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_ILLEGAL_REQUEST, USBD_MSC_ASC_INVALID_CDB);
+    return -1;
+  }
+}
+
+/**
+  * @brief  USBD_MSC_DecodeCbw
+  *         Check the CBW just received and run its command
+  * @param  pdev: device instance
+  * @param  hmsc: class data
+  * @retval None
+  */
+static void  USBD_MSC_DecodeCbw (USBD_HandleTypeDef *pdev, USBD_MSC_HandleTypeDef *hmsc)
+{
+  const uint8_t *p = (const uint8_t *)hmsc->CbwBuf;
+  uint32_t len = USBD_LL_GetRxDataSize(pdev, USBD_MSC_OUT_EP);
+  uint32_t i;
+
+  hmsc->Cbw.Signature = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  hmsc->Cbw.Tag = p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+  hmsc->Cbw.DataLength = p[8] | ((uint32_t)p[9] << 8) | ((uint32_t)p[10] << 16) | ((uint32_t)p[11] << 24);
+  hmsc->Cbw.Flags = p[12];
+  hmsc->Cbw.Lun = p[13];
+  hmsc->Cbw.CBLength = p[14];
+  for (i = 0U; i < 16U; i++)
+  {
+    hmsc->Cbw.CB[i] = p[15U + i];
+  }
+  hmsc->Xferred = 0U;
+
+  if ((len != USBD_MSC_CBW_LENGTH) || (hmsc->Cbw.Signature != USBD_MSC_CBW_SIGNATURE) ||
+      (hmsc->Cbw.Lun > hmsc->MaxLun) || (hmsc->Cbw.CBLength < 1U) || (hmsc->Cbw.CBLength > 16U))
+  {
+    /* not a valid CBW: both endpoints stay stalled until a reset */
+    hmsc->BotStatus = USBD_MSC_BOT_STATUS_ERROR;
+    hmsc->BotState = USBD_MSC_BOT_STALLED;
+    USBD_LL_StallEP(pdev, USBD_MSC_IN_EP);
+    USBD_LL_StallEP(pdev, USBD_MSC_OUT_EP);
+    return;
+  }
+  hmsc->BotStatus = USBD_MSC_BOT_STATUS_NORMAL;
+  hmsc->CswStatus = USBD_MSC_CSW_FAILED;
+
+  if (USBD_MSC_Scsi(pdev, hmsc) != 0)
+  {
+    if (hmsc->Cbw.DataLength == 0U)
+    {
+      USBD_MSC_SendCsw(pdev, hmsc, hmsc->CswStatus);
+    }
+    else
+    {
+      USBD_MSC_Abort(pdev, hmsc, hmsc->CswStatus);
+    }
+  }
+  else if (hmsc->BotState == USBD_MSC_BOT_IDLE)
+  {
+    /* no data phase */
+    USBD_MSC_SendCsw(pdev, hmsc, USBD_MSC_CSW_PASSED);
+  }
+}
+
+/**
+  * @brief  USBD_MSC_Init
+  *         Open the endpoints, initialize the storage, wait for a CBW
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_MSC_HandleTypeDef *hmsc = &USBD_MSC_Handle;
+  USBD_MSC_StorageTypeDef *storage = (USBD_MSC_StorageTypeDef *)pdev->pUserData;
+  uint16_t mps = USBD_MSC_FS_MAX_PACKET_SIZE;
+  uint8_t lun;
+  int8_t max_lun;
+
+  if (storage == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (USBD_IS_HIGH_SPEED(pdev))
+  {
+    mps = USBD_MSC_HS_MAX_PACKET_SIZE;
+  }
+#if (USBD_MSC_PMA_ALLOC == 1)
+  else
+  {
+    USBD_MSC_ConfigPMA(pdev);
+  }
+#endif /* USBD_MSC_PMA_ALLOC */
+
+  USBD_LL_OpenEP(pdev, USBD_MSC_IN_EP, USBD_EP_TYPE_BULK, mps);
+  USBD_LL_OpenEP(pdev, USBD_MSC_OUT_EP, USBD_EP_TYPE_BULK, mps);
+
+  max_lun = storage->GetMaxLun();
+  hmsc->MaxLun = (max_lun < 0) ? 0U : (uint8_t)MIN((uint32_t)max_lun, USBD_MSC_MAX_LUN - 1U);
+  hmsc->BotStatus = USBD_MSC_BOT_STATUS_NORMAL;
+  hmsc->SenseKey = USBD_MSC_SENSE_NO_SENSE;
+  hmsc->SenseAsc = 0U;
+  hmsc->MediaBusy = 0U;
+  hmsc->Discard = 0U;
+  hmsc->InKick = 0U;
+  hmsc->Cbw.DataLength = 0U;
+  hmsc->Cbw.Tag = 0U;
+  for (lun = 0U; lun <= hmsc->MaxLun; lun++)
+  {
+    hmsc->BlockNum[lun] = 0U;
+    hmsc->BlockSize[lun] = 0U;
+    storage->Init(lun);
+  }
+  USBD_MSC_Storage = storage;
+  pdev->pClassData = hmsc;
+#if (USBD_FS_ONLY == 0)
+  USBD_MSC_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+
+  USBD_MSC_ArmCbw(pdev, hmsc);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_DeInit
+  *         Close the endpoints
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_MSC_HandleTypeDef *hmsc = (USBD_MSC_HandleTypeDef *)pdev->pClassData;
+
+  USBD_LL_CloseEP(pdev, USBD_MSC_IN_EP);
+  USBD_LL_CloseEP(pdev, USBD_MSC_OUT_EP);
+
+  if (hmsc != NULL)
+  {
+    /* a storage transfer under way still ends in USBD_MSC_StorageDone */
+    hmsc->Discard = hmsc->MediaBusy;
+    hmsc->BotState = USBD_MSC_BOT_IDLE;
+    pdev->pClassData = NULL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_Setup
+  *         Bulk-Only requests, and the end of a stall on a data endpoint
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_MSC_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_MSC_HandleTypeDef *hmsc = (USBD_MSC_HandleTypeDef *)pdev->pClassData;
+  static uint8_t ifalt = 0;
+
+  if (hmsc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_CLASS:
+    switch (req->bRequest)
+    {
+    case USBD_MSC_REQ_GET_MAX_LUN:
+      if ((req->wValue != 0U) || (req->wLength != 1U) || ((req->bmRequest & 0x80U) == 0U))
+      {
+        USBD_CtlError(pdev, req);
+        return USBD_FAIL;
+      }
+      USBD_CtlSendData(pdev, &hmsc->MaxLun, 1);
+      break;
+
+    case USBD_MSC_REQ_RESET:
+      if ((req->wValue != 0U) || (req->wLength != 0U) || ((req->bmRequest & 0x80U) != 0U))
+      {
+        USBD_CtlError(pdev, req);
+        return USBD_FAIL;
+      }
+      /* drop the command under way, the stalls are the host's to clear */
+      hmsc->Discard = hmsc->MediaBusy;
+      hmsc->BotStatus = USBD_MSC_BOT_STATUS_RECOVERY;
+      USBD_LL_FlushEP(pdev, USBD_MSC_IN_EP);
+      USBD_MSC_ArmCbw(pdev, hmsc);
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      return USBD_FAIL;
+    }
+    break;
+
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE:
+      USBD_CtlSendData(pdev, &ifalt, 1);
+      break;
+
+    case USB_REQ_SET_INTERFACE:
+      break;
+
+    case USB_REQ_CLEAR_FEATURE:
+      /* the core cleared the stall of the endpoint already */
+      if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) != USB_REQ_RECIPIENT_ENDPOINT)
+      {
+        break;
+      }
+      if (hmsc->BotStatus == USBD_MSC_BOT_STATUS_ERROR)
+      {
+        USBD_LL_StallEP(pdev, LOBYTE(req->wIndex));
+      }
+      else if ((LOBYTE(req->wIndex) == USBD_MSC_IN_EP) &&
+               (hmsc->BotState == USBD_MSC_BOT_STALLED) &&
+               (hmsc->BotStatus != USBD_MSC_BOT_STATUS_RECOVERY))
+      {
+        USBD_MSC_SendCsw(pdev, hmsc, hmsc->CswStatus);
+      }
+      break;
+    }
+    break;
+
+  default:
+    return USBD_FAIL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_DataIn
+  *         Chunk of a read, short answer or CSW sent
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_MSC_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MSC_HandleTypeDef *hmsc = (USBD_MSC_HandleTypeDef *)pdev->pClassData;
+  uint32_t blk;
+
+  if (hmsc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  switch (hmsc->BotState)
+  {
+  case USBD_MSC_BOT_DATA_IN:
+    blk = hmsc->ConsDone * hmsc->ChunkBlocks;
+    hmsc->Xferred += MIN(hmsc->ChunkBlocks, hmsc->BlkLen - blk) * hmsc->BlockSize[hmsc->Cbw.Lun];
+    hmsc->ConsBusy = 0U;
+    hmsc->ConsDone++;
+    USBD_MSC_Kick(pdev, hmsc);
+    break;
+
+  case USBD_MSC_BOT_LAST_DATA_IN:
+    USBD_MSC_SendCsw(pdev, hmsc, USBD_MSC_CSW_PASSED);
+    break;
+
+  default:
+    /* CSW gone */
+    break;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_DataOut
+  *         CBW, or chunk of a write, received
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_MSC_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MSC_HandleTypeDef *hmsc = (USBD_MSC_HandleTypeDef *)pdev->pClassData;
+
+  if (hmsc == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  switch (hmsc->BotState)
+  {
+  case USBD_MSC_BOT_IDLE:
+    USBD_MSC_DecodeCbw(pdev, hmsc);
+    break;
+
+  case USBD_MSC_BOT_DATA_OUT:
+    hmsc->Xferred += USBD_LL_GetRxDataSize(pdev, epnum);
+    hmsc->ProdBusy = 0U;
+    hmsc->ProdDone++;
+    USBD_MSC_Kick(pdev, hmsc);
+    break;
+
+  default:
+    break;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_MSC_GetFSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_MSC_CfgFSDesc);
+  return (uint8_t *)USBD_MSC_CfgFSDesc;
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_MSC_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_MSC_GetHSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_MSC_CfgHSDesc);
+  return (uint8_t *)USBD_MSC_CfgHSDesc;
+}
+
+/**
+  * @brief  USBD_MSC_GetOtherSpeedCfgDesc
+  *         Return the configuration of the speed the device is not at
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_MSC_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+  if ((USBD_MSC_Dev != NULL) && USBD_IS_HIGH_SPEED(USBD_MSC_Dev))
+  {
+    *length = sizeof (USBD_MSC_OtherSpeedFSDesc);
+    return (uint8_t *)USBD_MSC_OtherSpeedFSDesc;
+  }
+  *length = sizeof (USBD_MSC_OtherSpeedHSDesc);
+  return (uint8_t *)USBD_MSC_OtherSpeedHSDesc;
+}
+
+/**
+  * @brief  USBD_MSC_GetDeviceQualifierDesc
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_MSC_GetDeviceQualifierDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_MSC_DeviceQualifierDesc);
+  return USBD_MSC_DeviceQualifierDesc;
+}
+#endif /* USBD_FS_ONLY */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_msc_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_MSC_RegisterStorage
+  *         Set the storage callbacks, standalone use
+  * @param  pdev: device instance
+  * @param  fops: callbacks
+  * @retval status
+  */
+uint8_t  USBD_MSC_RegisterStorage (USBD_HandleTypeDef *pdev,
+                                   USBD_MSC_StorageTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return USBD_FAIL;
+  }
+  pdev->pUserData = fops;
+#if (USBD_FS_ONLY == 0)
+  USBD_MSC_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_StorageDone
+  *         The Read or Write the storage took is complete
+  * @note   From within Read or Write, from the USB interrupt, or from an
+  *         interrupt of the same priority.
+  * @param  pdev: device instance
+  * @param  status: 0 on success, the command fails otherwise
+  * @retval None
+  */
+void  USBD_MSC_StorageDone (USBD_HandleTypeDef *pdev, int8_t status)
+{
+  USBD_MSC_HandleTypeDef *hmsc = USBD_MSC_Get(pdev);
+
+  if ((hmsc == NULL) || !hmsc->MediaBusy)
+  {
+    return;
+  }
+  hmsc->MediaBusy = 0U;
+
+  if (hmsc->Discard)
+  {
+    /* of a command reset since: the buffer is free again, which the
+       command now under way may be waiting for */
+    hmsc->Discard = 0U;
+    USBD_MSC_Kick(pdev, hmsc);
+    return;
+  }
+
+  if (hmsc->BotState == USBD_MSC_BOT_DATA_IN)
+  {
+    hmsc->ProdBusy = 0U;
+    hmsc->ProdDone++;
+  }
+  else if (hmsc->BotState == USBD_MSC_BOT_DATA_OUT)
+  {
+    hmsc->ConsBusy = 0U;
+    hmsc->ConsDone++;
+  }
+  else
+  {
+    return;
+  }
+
+  if (status != 0)
+  {
+    hmsc->Failed = 1U;
+    if (hmsc->BotState == USBD_MSC_BOT_DATA_IN)
+    {
+      USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_MEDIUM_ERROR, USBD_MSC_ASC_UNRECOVERED_READ_ERROR);
+    }
+    else
+    {
+      USBD_MSC_Sense(hmsc, USBD_MSC_SENSE_MEDIUM_ERROR, USBD_MSC_ASC_WRITE_FAULT);
+    }
+  }
+  USBD_MSC_Kick(pdev, hmsc);
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_MSC_ENABLED */
@@ -0,0 +1,1233 @@
+/**
+  ******************************************************************************
+  * @file    usbd_sim.c
+  * @brief   Simulated low level driver, see usbd_sim.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "usbd_sim.h"
+
+#if (USBD_SIM_ENABLED == 1)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_Sim
+  * @{
+  */
+
+/** @defgroup USBD_Sim_Private_Defines
+  * @{
+  */
+/* Room for the configuration descriptor read by USBD_Sim_Enumerate and the
+   IN data of a script step */
+#ifndef USBD_SIM_SCRATCH_SIZE
+#define USBD_SIM_SCRATCH_SIZE                       1024U
+#endif
+
+#define USBD_SIM_EP0_MPS                            USB_MAX_EP0_SIZE
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Exported_Variables
+  * @{
+  */
+USBD_SimTypeDef USBD_Sim;
+
+#if defined(USBD_SIM_CMSIS)
+USBD_SimDWT_TypeDef        USBD_SimDWT;
+USBD_SimCoreDebug_TypeDef  USBD_SimCoreDebug;
+uint32_t                   USBD_SimPrimask;
+uint32_t                   SystemCoreClock = USBD_SIM_CORE_CLOCK;
+#endif /* USBD_SIM_CMSIS */
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Private_Variables
+  * @{
+  */
+static uint8_t USBD_Sim_Scratch[USBD_SIM_SCRATCH_SIZE];
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Endpoint of an address
+  * @param  ep_addr: endpoint address
+  * @retval endpoint, NULL beyond USBD_SIM_NUM_EP
+  */
+static USBD_SimEpTypeDef *USBD_Sim_Ep(uint8_t ep_addr)
+{
+  uint8_t num = ep_addr & 0x7FU;
+
+  if (num >= USBD_SIM_NUM_EP)
+  {
+    return NULL;
+  }
+  return ((ep_addr & 0x80U) != 0U) ? &USBD_Sim.in[num] : &USBD_Sim.out[num];
+}
+
+/**
+  * @brief  Count a fault if a buffer leaves packet memory or overlaps a
+  *         buffer of another open endpoint
+  * @param  self: endpoint the buffer belongs to
+  * @param  addr: start of the buffer
+  * @param  size: length of the buffer
+  * @retval None
+  */
+static void USBD_Sim_CheckBuffer(const USBD_SimEpTypeDef *self, uint16_t addr, uint16_t size)
+{
+  uint32_t i;
+  uint32_t b;
+
+  if (((uint32_t)addr + size) > USBD_SIM_PMA_SIZE)
+  {
+    USBD_Sim.pma_faults++;
+    return;
+  }
+
+  for (i = 0U; i < 2U * USBD_SIM_NUM_EP; i++)
+  {
+    const USBD_SimEpTypeDef *ep = (i < USBD_SIM_NUM_EP) ? &USBD_Sim.in[i] : &USBD_Sim.out[i - USBD_SIM_NUM_EP];
+
+    if ((ep == self) || !ep->open)
+    {
+      continue;
+    }
+    for (b = 0U; b < 2U; b++)
+    {
+      uint16_t other = (b == 0U) ? ep->pma_addr : ep->pma_addr1;
+
+      if ((other != USBD_SIM_PMA_NONE) &&
+          (addr < other + ep->mps) && (other < addr + size))
+      {
+        USBD_Sim.pma_faults++;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Load the next packet of an IN transfer into packet memory
+  * @param  ep: IN endpoint
+  * @retval None
+  */
+static void USBD_Sim_Stage(USBD_SimEpTypeDef *ep)
+{
+  uint32_t n = MIN(ep->mps, ep->xfer_len - ep->xfer_count);
+
+  if ((n != 0U) && (ep->iov != NULL))
+  {
+    /* gather the packet from the segments it spans */
+    uint32_t skip = ep->xfer_count;
+    uint32_t done = 0U;
+    uint32_t i;
+
+    for (i = 0U; (i < ep->iovcnt) && (done < n); i++)
+    {
+      uint32_t len = ep->iov[i].len;
+
+      if (skip >= len)
+      {
+        skip -= len;
+        continue;
+      }
+      len = MIN(len - skip, n - done);
+      memcpy(&USBD_Sim.pma[ep->pma_addr + done], ep->iov[i].buf + skip, len);
+      done += len;
+      skip = 0U;
+    }
+    USBD_Sim.pma_copied += n;
+  }
+  else if ((n != 0U) && (ep->buf != NULL))
+  {
+    memcpy(&USBD_Sim.pma[ep->pma_addr], ep->buf + ep->xfer_count, n);
+    USBD_Sim.pma_copied += n;
+  }
+  ep->staged = (uint16_t)n;
+}
+
+/**
+  * @brief  End the transfer of an endpoint and run its completion, which
+  *         may start the next one
+  * @param  ep: endpoint
+  * @param  ep_addr: endpoint address
+  * @retval None
+  */
+static void USBD_Sim_Complete(USBD_SimEpTypeDef *ep, uint8_t ep_addr)
+{
+  uint8_t epnum = ep_addr & 0x7FU;
+
+  ep->armed = 0U;
+  if (ep->cb != NULL)
+  {
+    ep->cb(USBD_Sim.pdev, epnum);
+  }
+  else if ((ep_addr & 0x80U) != 0U)
+  {
+    USBD_LL_DataInStage(USBD_Sim.pdev, epnum, ep->buf);
+  }
+  else
+  {
+    USBD_LL_DataOutStage(USBD_Sim.pdev, epnum, ep->buf);
+  }
+}
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_LL_Functions
+  * @brief  usbd_core.h low level driver
+  * @{
+  */
+
+/**
+  * @brief  Attach the simulation to a device
+  * @param  pdev: device instance
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
+{
+  uint32_t i;
+
+  memset(&USBD_Sim, 0, sizeof(USBD_Sim));
+  for (i = 0U; i < USBD_SIM_NUM_EP; i++)
+  {
+    USBD_Sim.in[i].pma_addr = USBD_SIM_PMA_NONE;
+    USBD_Sim.in[i].pma_addr1 = USBD_SIM_PMA_NONE;
+    USBD_Sim.out[i].pma_addr = USBD_SIM_PMA_NONE;
+    USBD_Sim.out[i].pma_addr1 = USBD_SIM_PMA_NONE;
+  }
+  USBD_Sim.pma_next = USBD_SIM_PMA_SIZE;
+  USBD_Sim.pdev = pdev;
+  pdev->pData = &USBD_Sim;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Detach the simulation
+  * @param  pdev: device instance
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_DeInit (USBD_HandleTypeDef *pdev)
+{
+  USBD_Sim.connected = 0U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Connect to the simulated bus
+  * @param  pdev: device instance
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_Start (USBD_HandleTypeDef *pdev)
+{
+  USBD_Sim.connected = 1U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Disconnect from the simulated bus
+  * @param  pdev: device instance
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_Stop (USBD_HandleTypeDef *pdev)
+{
+  USBD_Sim.connected = 0U;
+  return USBD_OK;
+}
+
+#if (USBD_POLLED == 1)
+/**
+  * @brief  Nothing is ever pending: the steps of a run call into the core
+  *         as they happen
+  * @param  pdev: device instance
+  * @param  budget: core cycles
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_Poll (USBD_HandleTypeDef *pdev, uint32_t budget)
+{
+  return USBD_OK;
+}
+#endif
+
+/**
+  * @brief  Open an endpoint, with a buffer from the top of packet memory
+  *         if it was given none
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  ep_type: USBD_EP_TYPE_xxx
+  * @param  ep_mps: max packet size
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_OpenEP (USBD_HandleTypeDef *pdev,
+                                    uint8_t  ep_addr,
+                                    uint8_t  ep_type,
+                                    uint16_t ep_mps)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (ep->pma_addr == USBD_SIM_PMA_NONE)
+  {
+    uint16_t size = (uint16_t)((ep_mps + 1U) & ~1U);
+
+    if (size > USBD_Sim.pma_next)
+    {
+      USBD_Sim.pma_faults++;
+      return USBD_FAIL;
+    }
+    USBD_Sim.pma_next -= size;
+    ep->pma_addr = USBD_Sim.pma_next;
+  }
+
+  ep->open = 1U;
+  ep->type = ep_type;
+  ep->mps = ep_mps;
+  ep->stall = 0U;
+  ep->armed = 0U;
+  ep->staged = 0U;
+  /* as HAL_PCD_EP_Open */
+  ep->cb = NULL;
+
+  USBD_Sim_CheckBuffer(ep, ep->pma_addr, ep_mps);
+  if (ep->pma_addr1 != USBD_SIM_PMA_NONE)
+  {
+    USBD_Sim_CheckBuffer(ep, ep->pma_addr1, ep_mps);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  Close an endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_CloseEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  ep->open = 0U;
+  ep->armed = 0U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Drop the transfer of an endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_FlushEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  ep->armed = 0U;
+  ep->staged = 0U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Stall an endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_StallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  ep->stall = 1U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Clear the stall of an endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_ClearStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  ep->stall = 0U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Stall state of an endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval 1 if stalled
+  */
+uint8_t  USBD_LL_IsStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  return (ep != NULL) ? ep->stall : 0U;
+}
+
+/**
+  * @brief  Take the address the host gave
+  * @param  pdev: device instance
+  * @param  dev_addr: device address
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_SetUSBAddress (USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+  USBD_Sim.address = dev_addr;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Start an IN transfer, its first packet loaded at once
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pbuf: data
+  * @param  size: length, 0 for a ZLP
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_Transmit (USBD_HandleTypeDef *pdev,
+                                      uint8_t  ep_addr,
+                                      const uint8_t  *pbuf,
+                                      uint16_t  size)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_FAIL;
+  }
+  ep->buf = (uint8_t *)pbuf;
+  ep->iov = NULL;
+  ep->xfer_len = size;
+  ep->xfer_count = 0U;
+  ep->armed = 1U;
+  USBD_Sim_Stage(ep);
+  return USBD_OK;
+}
+
+/**
+  * @brief  Start an IN transfer of consecutive segments
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  iov: segments
+  * @param  iovcnt: number of segments
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_TransmitVec (USBD_HandleTypeDef *pdev,
+                                         uint8_t  ep_addr,
+                                         const USBD_IovTypeDef *iov,
+                                         uint32_t  iovcnt)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+  uint32_t size = 0U;
+  uint32_t i;
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_FAIL;
+  }
+  for (i = 0U; i < iovcnt; i++)
+  {
+    size += iov[i].len;
+  }
+  ep->buf = NULL;
+  ep->iov = iov;
+  ep->iovcnt = iovcnt;
+  ep->xfer_len = size;
+  ep->xfer_count = 0U;
+  ep->armed = 1U;
+  USBD_Sim_Stage(ep);
+  return USBD_OK;
+}
+
+/**
+  * @brief  Arm an OUT endpoint
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pbuf: buffer, NULL to leave one packet in packet memory
+  * @param  size: length of the buffer
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_PrepareReceive (USBD_HandleTypeDef *pdev,
+                                            uint8_t  ep_addr,
+                                            uint8_t  *pbuf,
+                                            uint16_t  size)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_FAIL;
+  }
+  ep->buf = pbuf;
+  ep->xfer_len = size;
+  ep->xfer_count = 0U;
+  ep->zero_copy = (pbuf == NULL) ? 1U : 0U;
+  ep->armed = 1U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Bytes of the last OUT transfer
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @retval byte count
+  */
+uint32_t  USBD_LL_GetRxDataSize (USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+
+  return (ep != NULL) ? ep->xfer_count : 0U;
+}
+
+/**
+  * @brief  Give an endpoint its packet memory
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  ep_kind: USBD_EP_SNG_BUF or USBD_EP_DBL_BUF
+  * @param  pmaadress: buffer, both in the two halves for USBD_EP_DBL_BUF
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_PMAConfig (USBD_HandleTypeDef *pdev,
+                                       uint8_t  ep_addr,
+                                       uint16_t ep_kind,
+                                       uint32_t pmaadress)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  if (ep_kind == USBD_EP_DBL_BUF)
+  {
+    ep->pma_addr = (uint16_t)(pmaadress & 0xFFFFU);
+    ep->pma_addr1 = (uint16_t)(pmaadress >> 16);
+  }
+  else
+  {
+    ep->pma_addr = (uint16_t)pmaadress;
+    ep->pma_addr1 = USBD_SIM_PMA_NONE;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  Copy part of a zero-copy OUT packet
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  offset: first byte
+  * @param  pbuf: destination
+  * @param  size: bytes to copy
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_ReadRxData (USBD_HandleTypeDef *pdev,
+                                        uint8_t  ep_addr,
+                                        uint16_t offset,
+                                        uint8_t  *pbuf,
+                                        uint16_t size)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+
+  if ((ep == NULL) || (((uint32_t)offset + size) > ep->xfer_count))
+  {
+    return USBD_FAIL;
+  }
+  memcpy(pbuf, &USBD_Sim.pma[ep->pma_addr + offset], size);
+  USBD_Sim.pma_copied += size;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Reserve the packet buffer of an idle IN endpoint. The simulated
+  *         packet memory has contiguous halfwords.
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  w: writer to set up
+  * @retval status, USBD_BUSY while a transfer is under way
+  */
+USBD_StatusTypeDef  USBD_LL_TxReserve (USBD_HandleTypeDef *pdev,
+                                       uint8_t  ep_addr,
+                                       USBD_PMAWriterTypeDef *w)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+
+  if ((ep == NULL) || !ep->open || (ep->pma_addr == USBD_SIM_PMA_NONE) ||
+      ((ep->pma_addr & 1U) != 0U))
+  {
+    return USBD_FAIL;
+  }
+  if (ep->armed)
+  {
+    return USBD_BUSY;
+  }
+  w->ptr = (volatile uint16_t *)(void *)&USBD_Sim.pma[ep->pma_addr];
+  w->stride = 1U;
+  w->count = 0U;
+  w->size = ep->mps;
+  w->pending = 0U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Send the packet of a reservation
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  w: writer of the reservation
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_TxCommit (USBD_HandleTypeDef *pdev,
+                                      uint8_t  ep_addr,
+                                      USBD_PMAWriterTypeDef *w)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+
+  if ((ep == NULL) || !ep->open || (w->count > w->size))
+  {
+    return USBD_FAIL;
+  }
+  if (w->pending != 0U)
+  {
+    *w->ptr = (uint16_t)(w->pending & 0xFFU);
+    w->pending = 0U;
+  }
+  /* the data is in packet memory already: stage without a copy */
+  ep->buf = NULL;
+  ep->iov = NULL;
+  ep->xfer_len = w->count;
+  ep->xfer_count = 0U;
+  ep->armed = 1U;
+  USBD_Sim_Stage(ep);
+  return USBD_OK;
+}
+
+/**
+  * @brief  Convert 16-bit samples of a zero-copy OUT packet to q15 with a
+  *         gain, rounded and saturated like the PCD
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  offset: first byte, even
+  * @param  pbuf: destination
+  * @param  count: samples
+  * @param  gain: q15 gain, 32768 is unity
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_ReadRxSamples (USBD_HandleTypeDef *pdev,
+                                           uint8_t  ep_addr,
+                                           uint16_t offset,
+                                           int16_t  *pbuf,
+                                           uint16_t count,
+                                           int32_t  gain)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+  const uint8_t *src;
+  uint32_t i;
+
+  if ((ep == NULL) || ((offset & 1U) != 0U) ||
+      (((uint32_t)offset + 2U * (uint32_t)count) > ep->xfer_count))
+  {
+    return USBD_FAIL;
+  }
+
+  src = &USBD_Sim.pma[ep->pma_addr + offset];
+  for (i = 0U; i < count; i++, src += 2)
+  {
+    int64_t v = ((int64_t)(int16_t)(src[0] | (src[1] << 8)) * gain + 16384) >> 15;
+
+    pbuf[i] = (int16_t)((v > 32767) ? 32767 : ((v < -32768) ? -32768 : v));
+  }
+  USBD_Sim.pma_copied += 2U * (uint32_t)count;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Convert 16-bit samples of a zero-copy OUT packet to float
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  offset: first byte, even
+  * @param  pbuf: destination
+  * @param  count: samples
+  * @param  scale: factor applied to every sample
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_ReadRxSamplesF32 (USBD_HandleTypeDef *pdev,
+                                              uint8_t  ep_addr,
+                                              uint16_t offset,
+                                              float    *pbuf,
+                                              uint16_t count,
+                                              float    scale)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+  const uint8_t *src;
+  uint32_t i;
+
+  if ((ep == NULL) || ((offset & 1U) != 0U) ||
+      (((uint32_t)offset + 2U * (uint32_t)count) > ep->xfer_count))
+  {
+    return USBD_FAIL;
+  }
+
+  src = &USBD_Sim.pma[ep->pma_addr + offset];
+  for (i = 0U; i < count; i++, src += 2)
+  {
+    pbuf[i] = (float)(int16_t)(src[0] | (src[1] << 8)) * scale;
+  }
+  USBD_Sim.pma_copied += 2U * (uint32_t)count;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Route the completions of an endpoint to a handler, until the
+  *         endpoint is opened again
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  callback: handler, NULL for the core
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_SetEPCallback (USBD_HandleTypeDef *pdev,
+                                           uint8_t  ep_addr,
+                                           uint8_t  (*callback)(void *pdev, uint8_t epnum))
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr);
+
+  if (ep == NULL)
+  {
+    return USBD_FAIL;
+  }
+  ep->cb = callback;
+  return USBD_OK;
+}
+
+/**
+  * @brief  Note a remote wakeup request
+  * @param  pdev: device instance
+  * @retval status
+  */
+USBD_StatusTypeDef  USBD_LL_RemoteWakeup (USBD_HandleTypeDef *pdev)
+{
+  USBD_Sim.remote_wakeup = 1U;
+  return USBD_OK;
+}
+
+/**
+  * @brief  No time passes in the simulation
+  * @param  Delay: ms
+  * @retval None
+  */
+void  USBD_LL_Delay (uint32_t Delay)
+{
+}
+/**
+  * @}
+  */
+
+/** @defgroup USBD_Sim_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  Bus reset: endpoints closed, address 0, then the core reset
+  * @retval None
+  */
+void  USBD_Sim_Reset (void)
+{
+  uint32_t i;
+
+  for (i = 0U; i < USBD_SIM_NUM_EP; i++)
+  {
+    USBD_Sim.in[i].open = 0U;
+    USBD_Sim.in[i].armed = 0U;
+    USBD_Sim.out[i].open = 0U;
+    USBD_Sim.out[i].armed = 0U;
+  }
+  USBD_Sim.address = 0U;
+  USBD_Sim.remote_wakeup = 0U;
+
+  USBD_LL_SetSpeed(USBD_Sim.pdev, USBD_SPEED_FULL);
+  USBD_LL_Reset(USBD_Sim.pdev);
+}
+
+/**
+  * @brief  Bus suspend
+  * @retval None
+  */
+void  USBD_Sim_Suspend (void)
+{
+  USBD_LL_Suspend(USBD_Sim.pdev);
+}
+
+/**
+  * @brief  Bus resume
+  * @retval None
+  */
+void  USBD_Sim_Resume (void)
+{
+  USBD_Sim.remote_wakeup = 0U;
+  USBD_LL_Resume(USBD_Sim.pdev);
+}
+
+/**
+  * @brief  Run frames: isochronous endpoints armed but not polled during
+  *         the frame are reported incomplete, then the SOF of the next one
+  * @param  frames: number of frames
+  * @retval None
+  */
+void  USBD_Sim_SOF (uint32_t frames)
+{
+  uint32_t i;
+
+  while (frames-- != 0U)
+  {
+    for (i = 1U; i < USBD_SIM_NUM_EP; i++)
+    {
+      USBD_SimEpTypeDef *in = &USBD_Sim.in[i];
+      USBD_SimEpTypeDef *out = &USBD_Sim.out[i];
+
+      if (in->open && (in->type == USBD_EP_TYPE_ISOC) && in->armed && !in->polled)
+      {
+        USBD_LL_IsoINIncomplete(USBD_Sim.pdev, (uint8_t)i);
+      }
+      if (out->open && (out->type == USBD_EP_TYPE_ISOC) && out->armed && !out->polled)
+      {
+        USBD_LL_IsoOUTIncomplete(USBD_Sim.pdev, (uint8_t)i);
+      }
+      in->polled = 0U;
+      out->polled = 0U;
+    }
+
+    USBD_Sim.frame = (USBD_Sim.frame + 1U) & 0x7FFU;
+#if defined(USBD_SIM_CMSIS)
+    USBD_SimDWT.CYCCNT += SystemCoreClock / 1000U;
+#endif /* USBD_SIM_CMSIS */
+    USBD_LL_SOF(USBD_Sim.pdev);
+  }
+}
+
+/**
+  * @brief  SETUP transaction: always taken, it clears the EP0 stall and
+  *         ends the control transfer under way
+  * @param  setup: 8 bytes
+  * @retval None
+  */
+void  USBD_Sim_Setup (const uint8_t *setup)
+{
+  USBD_SimEpTypeDef *out = &USBD_Sim.out[0];
+  USBD_SimEpTypeDef *in = &USBD_Sim.in[0];
+
+  out->stall = 0U;
+  out->armed = 0U;
+  in->stall = 0U;
+  in->armed = 0U;
+
+  memcpy(&USBD_Sim.pma[out->pma_addr], setup, 8U);
+  USBD_Sim.pma_copied += 8U;
+  out->packets++;
+  out->bytes += 8U;
+  USBD_LL_SetupStage(USBD_Sim.pdev, &USBD_Sim.pma[out->pma_addr]);
+}
+
+/**
+  * @brief  OUT transaction: one packet from the host
+  * @param  ep_addr: endpoint address
+  * @param  data: payload
+  * @param  len: up to the max packet size
+  * @retval bytes taken, USBD_SIM_NAK, USBD_SIM_STALL or USBD_SIM_ERROR
+  */
+int32_t  USBD_Sim_Out (uint8_t ep_addr, const uint8_t *data, uint16_t len)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+  uint32_t n;
+
+  if ((ep == NULL) || !ep->open || (len > ep->mps))
+  {
+    return USBD_SIM_ERROR;
+  }
+  if (ep->stall)
+  {
+    return USBD_SIM_STALL;
+  }
+  if (!ep->armed)
+  {
+    ep->naks++;
+    return USBD_SIM_NAK;
+  }
+
+  if (len != 0U)
+  {
+    memcpy(&USBD_Sim.pma[ep->pma_addr], data, len);
+    USBD_Sim.pma_copied += len;
+  }
+  ep->packets++;
+  ep->bytes += len;
+  ep->polled = 1U;
+
+  if (ep->zero_copy)
+  {
+    ep->xfer_count = len;
+  }
+  else
+  {
+    /* a packet past the end of the buffer is cut, as the PCD does */
+    n = MIN(len, ep->xfer_len - ep->xfer_count);
+    if (n != 0U)
+    {
+      memcpy(ep->buf + ep->xfer_count, &USBD_Sim.pma[ep->pma_addr], n);
+      USBD_Sim.pma_copied += n;
+    }
+    ep->xfer_count += n;
+  }
+
+  if (ep->zero_copy || (len < ep->mps) || (ep->xfer_count >= ep->xfer_len))
+  {
+    USBD_Sim_Complete(ep, ep_addr & 0x7FU);
+  }
+  return (int32_t)len;
+}
+
+/**
+  * @brief  IN transaction: one packet to the host
+  * @param  ep_addr: endpoint address
+  * @param  data: where the payload goes, NULL to drop it
+  * @param  size: room at data, the rest of the packet is dropped
+  * @retval packet length, USBD_SIM_NAK, USBD_SIM_STALL or USBD_SIM_ERROR
+  */
+int32_t  USBD_Sim_In (uint8_t ep_addr, uint8_t *data, uint16_t size)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+  uint16_t n;
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_SIM_ERROR;
+  }
+  if (ep->stall)
+  {
+    return USBD_SIM_STALL;
+  }
+  if (!ep->armed)
+  {
+    ep->naks++;
+    return USBD_SIM_NAK;
+  }
+
+  n = ep->staged;
+  if ((data != NULL) && (n != 0U))
+  {
+    memcpy(data, &USBD_Sim.pma[ep->pma_addr], MIN(n, size));
+  }
+  USBD_Sim.pma_copied += n;
+  ep->packets++;
+  ep->bytes += n;
+  ep->polled = 1U;
+  ep->xfer_count += n;
+
+  if (ep->xfer_count >= ep->xfer_len)
+  {
+    ep->staged = 0U;
+    USBD_Sim_Complete(ep, ep_addr | 0x80U);
+  }
+  else
+  {
+    USBD_Sim_Stage(ep);
+  }
+  return (int32_t)n;
+}
+
+/**
+  * @brief  Whole control transfer: SETUP, data stage, status stage
+  * @param  setup: 8 bytes
+  * @param  data: the OUT data stage, or room for wLength bytes of the IN
+  *         one
+  * @retval data stage bytes, USBD_SIM_NAK or USBD_SIM_STALL
+  */
+int32_t  USBD_Sim_Control (const uint8_t *setup, uint8_t *data)
+{
+  uint16_t wLength = (uint16_t)(setup[6] | (setup[7] << 8));
+  uint16_t done = 0U;
+  int32_t r;
+
+  USBD_Sim_Setup(setup);
+
+  if (wLength == 0U)
+  {
+    r = USBD_Sim_In(0x80U, NULL, 0U);
+    return (r < 0) ? r : 0;
+  }
+
+  if ((setup[0] & 0x80U) != 0U)
+  {
+    do
+    {
+      r = USBD_Sim_In(0x80U, data + done, wLength - done);
+      if (r < 0)
+      {
+        return r;
+      }
+      done += (uint16_t)MIN((uint32_t)r, (uint32_t)(wLength - done));
+    } while ((r == USBD_SIM_EP0_MPS) && (done < wLength));
+
+    r = USBD_Sim_Out(0x00U, NULL, 0U);
+    return (r < 0) ? r : (int32_t)done;
+  }
+
+  while (done < wLength)
+  {
+    uint16_t n = MIN(USBD_SIM_EP0_MPS, wLength - done);
+
+    r = USBD_Sim_Out(0x00U, data + done, n);
+    if (r < 0)
+    {
+      return r;
+    }
+    done += n;
+  }
+  r = USBD_Sim_In(0x80U, NULL, 0U);
+  return (r < 0) ? r : (int32_t)done;
+}
+
+/**
+  * @brief  Bulk or interrupt OUT transfer, as packets until one is NAKed
+  * @note   No ZLP is added after a transfer that fills its last packet.
+  * @param  ep_addr: endpoint address
+  * @param  data: payload
+  * @param  len: bytes
+  * @retval bytes taken, or the result of the first packet if it failed
+  */
+int32_t  USBD_Sim_Write (uint8_t ep_addr, const uint8_t *data, uint32_t len)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr & 0x7FU);
+  uint32_t done = 0U;
+  int32_t r;
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_SIM_ERROR;
+  }
+
+  do
+  {
+    uint16_t n = (uint16_t)MIN((uint32_t)ep->mps, len - done);
+
+    r = USBD_Sim_Out(ep_addr, data + done, n);
+    if (r < 0)
+    {
+      return (done == 0U) ? r : (int32_t)done;
+    }
+    done += n;
+  } while (done < len);
+
+  return (int32_t)done;
+}
+
+/**
+  * @brief  Bulk or interrupt IN transfer, as packets until a short one, a
+  *         NAK or size bytes
+  * @param  ep_addr: endpoint address
+  * @param  data: where the payload goes
+  * @param  size: room at data
+  * @retval bytes read, or the result of the first packet if it failed
+  */
+int32_t  USBD_Sim_Read (uint8_t ep_addr, uint8_t *data, uint32_t size)
+{
+  USBD_SimEpTypeDef *ep = USBD_Sim_Ep(ep_addr | 0x80U);
+  uint32_t done = 0U;
+  int32_t r;
+
+  if ((ep == NULL) || !ep->open)
+  {
+    return USBD_SIM_ERROR;
+  }
+
+  while (done < size)
+  {
+    r = USBD_Sim_In(ep_addr, data + done, (uint16_t)MIN(size - done, 0xFFFFU));
+    if (r < 0)
+    {
+      return (done == 0U) ? r : (int32_t)done;
+    }
+    done += MIN((uint32_t)r, size - done);
+    if (r < ep->mps)
+    {
+      break;
+    }
+  }
+  return (int32_t)done;
+}
+
+/**
+  * @brief  What a host does on attach: reset, device descriptor, reset,
+  *         address 1, descriptors again, configuration 1
+  * @retval length of the configuration descriptor, USBD_SIM_STALL,
+  *         USBD_SIM_NAK or USBD_SIM_ERROR
+  */
+int32_t  USBD_Sim_Enumerate (void)
+{
+  static const uint8_t get_dev64[8]  = { 0x80, USB_REQ_GET_DESCRIPTOR, 0x00, USB_DESC_TYPE_DEVICE, 0x00, 0x00, 0x40, 0x00 };
+  static const uint8_t set_addr[8]   = { 0x00, USB_REQ_SET_ADDRESS, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  static const uint8_t get_dev[8]    = { 0x80, USB_REQ_GET_DESCRIPTOR, 0x00, USB_DESC_TYPE_DEVICE, 0x00, 0x00, USB_LEN_DEV_DESC, 0x00 };
+  static const uint8_t get_cfg9[8]   = { 0x80, USB_REQ_GET_DESCRIPTOR, 0x00, USB_DESC_TYPE_CONFIGURATION, 0x00, 0x00, USB_LEN_CFG_DESC, 0x00 };
+  static const uint8_t set_cfg[8]    = { 0x00, USB_REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  uint8_t get_cfg[8] = { 0x80, USB_REQ_GET_DESCRIPTOR, 0x00, USB_DESC_TYPE_CONFIGURATION, 0x00, 0x00, 0x00, 0x00 };
+  uint16_t total;
+  int32_t r;
+
+  USBD_Sim_Reset();
+  r = USBD_Sim_Control(get_dev64, USBD_Sim_Scratch);
+  if (r < 0)
+  {
+    return r;
+  }
+
+  USBD_Sim_Reset();
+  if (((r = USBD_Sim_Control(set_addr, NULL)) < 0) ||
+      ((r = USBD_Sim_Control(get_dev, USBD_Sim_Scratch)) < 0) ||
+      ((r = USBD_Sim_Control(get_cfg9, USBD_Sim_Scratch)) < 0))
+  {
+    return r;
+  }
+  if ((r < USB_LEN_CFG_DESC) || (USBD_Sim.address != 1U))
+  {
+    return USBD_SIM_ERROR;
+  }
+
+  total = (uint16_t)(USBD_Sim_Scratch[2] | (USBD_Sim_Scratch[3] << 8));
+  if (total > USBD_SIM_SCRATCH_SIZE)
+  {
+    return USBD_SIM_ERROR;
+  }
+  get_cfg[6] = LOBYTE(total);
+  get_cfg[7] = HIBYTE(total);
+  if (((r = USBD_Sim_Control(get_cfg, USBD_Sim_Scratch)) < 0) ||
+      ((r = USBD_Sim_Control(set_cfg, NULL)) < 0))
+  {
+    return r;
+  }
+
+  return (USBD_Sim.pdev->dev_state == USBD_STATE_CONFIGURED) ? (int32_t)total : USBD_SIM_ERROR;
+}
+
+/**
+  * @brief  Replay a script
+  * @param  steps: steps, see USBD_SIM_OP_xxx
+  * @param  count: number of steps
+  * @retval count if every step gave its expected result, else the index
+  *         of the first that did not, also left in USBD_Sim.failed_step
+  */
+uint32_t  USBD_Sim_Run (const USBD_SimStepTypeDef *steps, uint32_t count)
+{
+  uint32_t i;
+  int32_t r;
+
+  for (i = 0U; i < count; i++)
+  {
+    const USBD_SimStepTypeDef *s = &steps[i];
+
+    switch (s->op)
+    {
+    case USBD_SIM_OP_RESET:
+      USBD_Sim_Reset();
+      r = 0;
+      break;
+
+    case USBD_SIM_OP_SOF:
+      USBD_Sim_SOF(s->len);
+      r = 0;
+      break;
+
+    case USBD_SIM_OP_SUSPEND:
+      USBD_Sim_Suspend();
+      r = 0;
+      break;
+
+    case USBD_SIM_OP_RESUME:
+      USBD_Sim_Resume();
+      r = 0;
+      break;
+
+    case USBD_SIM_OP_ENUMERATE:
+      r = USBD_Sim_Enumerate();
+      break;
+
+    case USBD_SIM_OP_CONTROL:
+      if ((s->data[0] & 0x80U) != 0U)
+      {
+        r = ((uint32_t)(s->data[6] | (s->data[7] << 8)) > USBD_SIM_SCRATCH_SIZE) ?
+            USBD_SIM_ERROR : USBD_Sim_Control(s->data, USBD_Sim_Scratch);
+      }
+      else
+      {
+        r = USBD_Sim_Control(s->data, (uint8_t *)(uintptr_t)(s->data + 8));
+      }
+      break;
+
+    case USBD_SIM_OP_OUT:
+      r = USBD_Sim_Write(s->ep, s->data, s->len);
+      break;
+
+    case USBD_SIM_OP_IN:
+      r = USBD_Sim_Read(s->ep, USBD_Sim_Scratch, MIN(s->len, USBD_SIM_SCRATCH_SIZE));
+      if ((r > 0) && (s->data != NULL) && (memcmp(USBD_Sim_Scratch, s->data, (size_t)r) != 0))
+      {
+        r = USBD_SIM_ERROR;
+      }
+      break;
+
+    default:
+      r = USBD_SIM_ERROR;
+      break;
+    }
+
+    if (r != s->expect)
+    {
+      USBD_Sim.failed_step = i;
+      return i;
+    }
+  }
+  return count;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_SIM_ENABLED */
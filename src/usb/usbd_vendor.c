@@ -0,0 +1,756 @@
+/**
+  ******************************************************************************
+  * @file    usbd_vendor.c
+  * @brief   Vendor specific bulk class with MS OS 2.0 descriptors, see
+  *          usbd_vendor.h
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_vendor.h"
+#include "usbd_ctlreq.h"
+#include "usb_stats.h"
+#include "usb_trace.h"
+
+#if (USBD_VENDOR_ENABLED == 1)
+
+#if (USBD_VENDOR_PMA_ALLOC == 1)
+#include "usbd_cdc_pma.h"
+#endif
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_vendor
+  * @{
+  */
+
+/** @defgroup usbd_vendor_Private_Defines
+  * @{
+  */
+/* Self powered, like the CDC configuration */
+#define USBD_VENDOR_CFG_ATTRIBUTES                  0xC0
+
+#if (USBD_VENDOR_PMA_ALLOC == 1)
+/* Packet memory of the two endpoints: after the CDC buffers when they
+   share a composite, right after EP0 otherwise */
+#ifndef USBD_VENDOR_PMA_ADDR
+#if (USBD_COMPOSITE_ENABLED == 1)
+#define USBD_VENDOR_PMA_ADDR                        (USBD_CDC_PMA_END)
+#else
+#define USBD_VENDOR_PMA_ADDR                        (USBD_CDC_PMA_BASE)
+#endif
+#endif
+
+#define USBD_VENDOR_PMA_OUT_SIZE                    (USBD_VENDOR_FS_MAX_PACKET_SIZE << USBD_VENDOR_DBL_BUF_OUT)
+#define USBD_VENDOR_PMA_IN_SIZE                     (USBD_VENDOR_FS_MAX_PACKET_SIZE << USBD_VENDOR_DBL_BUF_IN)
+#define USBD_VENDOR_PMA_END                         (USBD_VENDOR_PMA_ADDR + USBD_VENDOR_PMA_OUT_SIZE + \
+                                                     USBD_VENDOR_PMA_IN_SIZE)
+
+#if (USBD_VENDOR_PMA_END > USBD_PMA_SIZE)
+#error "Vendor endpoint buffers do not fit in packet memory"
+#endif
+#if (((USBD_VENDOR_IN_EP & 0x0F) >= USBD_PMA_NUM_EP) || \
+     ((USBD_VENDOR_OUT_EP & 0x0F) >= USBD_PMA_NUM_EP))
+#error "Vendor endpoints beyond the buffer descriptor table, raise USBD_PMA_NUM_EP"
+#endif
+#endif /* USBD_VENDOR_PMA_ALLOC */
+
+/* MS OS 2.0 descriptor types */
+#define USBD_VENDOR_MS_SET_HEADER                   0x00
+#define USBD_VENDOR_MS_SUBSET_CONFIGURATION         0x01
+#define USBD_VENDOR_MS_SUBSET_FUNCTION              0x02
+#define USBD_VENDOR_MS_COMPATIBLE_ID                0x03
+#define USBD_VENDOR_MS_REG_PROPERTY                 0x04
+
+#define USBD_VENDOR_MS_REG_MULTI_SZ                 0x07
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Private_FunctionPrototypes
+  * @{
+  */
+static uint8_t  USBD_VENDOR_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_VENDOR_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t  USBD_VENDOR_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t  USBD_VENDOR_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_VENDOR_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  *USBD_VENDOR_GetFSCfgDesc (uint16_t *length);
+#if (USBD_FS_ONLY == 0)
+static uint8_t  *USBD_VENDOR_GetHSCfgDesc (uint16_t *length);
+static uint8_t  *USBD_VENDOR_GetOtherSpeedCfgDesc (uint16_t *length);
+static uint8_t  *USBD_VENDOR_GetDeviceQualifierDesc (uint16_t *length);
+#endif /* USBD_FS_ONLY */
+static USBD_VENDOR_HandleTypeDef *USBD_VENDOR_Get (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_VENDOR_Claim (__IO uint32_t *state);
+static uint16_t USBD_VENDOR_MsSet (uint8_t *buf);
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Private_Variables
+  * @{
+  */
+USBD_ClassTypeDef  USBD_VENDOR =
+{
+  USBD_VENDOR_Init,
+  USBD_VENDOR_DeInit,
+  USBD_VENDOR_Setup,
+  NULL,                 /* EP0_TxSent */
+  NULL,                 /* EP0_RxReady */
+  USBD_VENDOR_DataIn,
+  USBD_VENDOR_DataOut,
+  NULL,                 /* SOF */
+  NULL,
+  NULL,
+#if (USBD_FS_ONLY == 1)
+  NULL,
+  USBD_VENDOR_GetFSCfgDesc,
+  NULL,
+  NULL,
+#else
+  USBD_VENDOR_GetHSCfgDesc,
+  USBD_VENDOR_GetFSCfgDesc,
+  USBD_VENDOR_GetOtherSpeedCfgDesc,
+  USBD_VENDOR_GetDeviceQualifierDesc,
+#endif /* USBD_FS_ONLY */
+#if (USBD_SUPPORT_USER_STRING == 1)
+  NULL,                 /* MS OS 2.0 needs no string descriptor */
+#endif
+#if (USBD_LPM_ENABLED == 1)
+  NULL,                 /* LPM */
+#endif
+};
+
+/* Whole configuration: one interface, bulk IN and OUT */
+#define USBD_VENDOR_CFG_DESC(type, mps)                                       \
+  0x09,                               /* bLength */                          \
+  (type),                             /* bDescriptorType */                  \
+  LOBYTE(USBD_VENDOR_CFG_DESC_SIZ),   /* wTotalLength */                     \
+  HIBYTE(USBD_VENDOR_CFG_DESC_SIZ),                                          \
+  0x01,                               /* bNumInterfaces */                   \
+  0x01,                               /* bConfigurationValue */              \
+  0x00,                               /* iConfiguration */                   \
+  USBD_VENDOR_CFG_ATTRIBUTES,         /* bmAttributes */                     \
+  0x32,                               /* MaxPower 100 mA */                  \
+  /* Interface */                                                            \
+  0x09,                               /* bLength */                          \
+  USB_DESC_TYPE_INTERFACE,            /* bDescriptorType */                  \
+  USBD_VENDOR_ITF_NUM,                /* bInterfaceNumber */                 \
+  0x00,                               /* bAlternateSetting */                \
+  0x02,                               /* bNumEndpoints */                    \
+  0xFF,                               /* bInterfaceClass: vendor specific */ \
+  0x00,                               /* bInterfaceSubClass */               \
+  0x00,                               /* bInterfaceProtocol */               \
+  0x00,                               /* iInterface */                       \
+  /* Endpoint OUT */                                                         \
+  0x07,                               /* bLength */                          \
+  USB_DESC_TYPE_ENDPOINT,             /* bDescriptorType */                  \
+  USBD_VENDOR_OUT_EP,                 /* bEndpointAddress */                 \
+  0x02,                               /* bmAttributes: bulk */               \
+  LOBYTE(mps),                        /* wMaxPacketSize */                   \
+  HIBYTE(mps),                                                               \
+  0x00,                               /* bInterval */                        \
+  /* Endpoint IN */                                                          \
+  0x07,                               /* bLength */                          \
+  USB_DESC_TYPE_ENDPOINT,             /* bDescriptorType */                  \
+  USBD_VENDOR_IN_EP,                  /* bEndpointAddress */                 \
+  0x02,                               /* bmAttributes: bulk */               \
+  LOBYTE(mps),                        /* wMaxPacketSize */                   \
+  HIBYTE(mps),                                                               \
+  0x00                                /* bInterval */
+
+__ALIGN_BEGIN static const uint8_t USBD_VENDOR_CfgFSDesc[] __ALIGN_END =
+{
+  USBD_VENDOR_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, USBD_VENDOR_FS_MAX_PACKET_SIZE)
+};
+
+/* The build fails if wTotalLength does not match the descriptor */
+typedef char USBD_VENDOR_CfgFSDescSizeCheck[(sizeof(USBD_VENDOR_CfgFSDesc) == USBD_VENDOR_CFG_DESC_SIZ) ? 1 : -1];
+
+#if (USBD_FS_ONLY == 0)
+__ALIGN_BEGIN static const uint8_t USBD_VENDOR_CfgHSDesc[] __ALIGN_END =
+{
+  USBD_VENDOR_CFG_DESC(USB_DESC_TYPE_CONFIGURATION, USBD_VENDOR_HS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_VENDOR_OtherSpeedFSDesc[] __ALIGN_END =
+{
+  USBD_VENDOR_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, USBD_VENDOR_FS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static const uint8_t USBD_VENDOR_OtherSpeedHSDesc[] __ALIGN_END =
+{
+  USBD_VENDOR_CFG_DESC(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION, USBD_VENDOR_HS_MAX_PACKET_SIZE)
+};
+
+__ALIGN_BEGIN static uint8_t USBD_VENDOR_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0x00,                 /* class given by the interface */
+  0x00,
+  0x00,
+  0x40,
+  0x01,
+  0x00,
+};
+
+static USBD_HandleTypeDef *USBD_VENDOR_Dev;
+#endif /* USBD_FS_ONLY */
+
+/* BOS: USB 2.0 extension and the MS OS 2.0 platform capability, which
+   tells Windows where to fetch the descriptor set */
+__ALIGN_BEGIN static uint8_t USBD_VENDOR_BOSDesc[USBD_VENDOR_BOS_DESC_SIZ] __ALIGN_END =
+{
+  USB_LEN_BOS_DESC,
+  USB_DESC_TYPE_BOS,
+  LOBYTE(USBD_VENDOR_BOS_DESC_SIZ),
+  HIBYTE(USBD_VENDOR_BOS_DESC_SIZ),
+  0x02,                               /* bNumDeviceCaps */
+
+  USB_LEN_USB2_EXT_DESC,
+  USB_DEVICE_CAPABITY_TYPE,
+  USB_DEV_CAP_TYPE_USB2_EXT,
+#if (USBD_LPM_ENABLED == 1)
+  USB_USB2_EXT_LPM | USB_USB2_EXT_BESL,
+#else
+  0x00,
+#endif
+  0x00,
+  0x00,
+  0x00,
+
+  USBD_VENDOR_MS_LEN_PLATFORM_DESC,
+  USB_DEVICE_CAPABITY_TYPE,
+  USB_DEV_CAP_TYPE_PLATFORM,
+  0x00,
+  /* PlatformCapabilityUUID D8DD60DF-4589-4CC7-9CD2-659D9E648A9F */
+  0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C,
+  0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F,
+  (uint8_t)(USBD_VENDOR_MS_WINDOWS_VERSION),
+  (uint8_t)(USBD_VENDOR_MS_WINDOWS_VERSION >> 8),
+  (uint8_t)(USBD_VENDOR_MS_WINDOWS_VERSION >> 16),
+  (uint8_t)(USBD_VENDOR_MS_WINDOWS_VERSION >> 24),
+  LOBYTE(USBD_VENDOR_MS_SET_SIZ),     /* wMSOSDescriptorSetTotalLength */
+  HIBYTE(USBD_VENDOR_MS_SET_SIZ),
+  USBD_VENDOR_MS_CODE,                /* bMS_VendorCode */
+  0x00                                /* bAltEnumCode */
+};
+
+/* Descriptor set, written out on request: the strings in it are UTF-16 */
+__ALIGN_BEGIN static uint8_t USBD_VENDOR_MsSetDesc[USBD_VENDOR_MS_SET_SIZ] __ALIGN_END;
+
+typedef char USBD_VENDOR_GuidSizeCheck[(sizeof(USBD_VENDOR_GUID) == 39) ? 1 : -1];
+
+static USBD_VENDOR_HandleTypeDef USBD_VENDOR_Handle;
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Private_Functions
+  * @{
+  */
+
+#if (USBD_VENDOR_PMA_ALLOC == 1)
+/**
+  * @brief  USBD_VENDOR_ConfigPMA
+  *         Assign packet memory to the vendor endpoints
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void  USBD_VENDOR_ConfigPMA (USBD_HandleTypeDef *pdev)
+{
+  uint32_t addr = USBD_VENDOR_PMA_ADDR;
+
+#if (USBD_VENDOR_DBL_BUF_OUT == 1)
+  USBD_LL_PMAConfig(pdev, USBD_VENDOR_OUT_EP, USBD_EP_DBL_BUF,
+                    addr | ((addr + USBD_VENDOR_FS_MAX_PACKET_SIZE) << 16));
+#else
+  USBD_LL_PMAConfig(pdev, USBD_VENDOR_OUT_EP, USBD_EP_SNG_BUF, addr);
+#endif
+  addr += USBD_VENDOR_PMA_OUT_SIZE;
+
+#if (USBD_VENDOR_DBL_BUF_IN == 1)
+  USBD_LL_PMAConfig(pdev, USBD_VENDOR_IN_EP, USBD_EP_DBL_BUF,
+                    addr | ((addr + USBD_VENDOR_FS_MAX_PACKET_SIZE) << 16));
+#else
+  USBD_LL_PMAConfig(pdev, USBD_VENDOR_IN_EP, USBD_EP_SNG_BUF, addr);
+#endif
+}
+#endif /* USBD_VENDOR_PMA_ALLOC */
+
+/**
+  * @brief  USBD_VENDOR_Get
+  *         State of the class, standalone or as a function of a composite
+  * @param  pdev: device instance
+  * @retval class data, NULL while not configured
+  */
+static USBD_VENDOR_HandleTypeDef *USBD_VENDOR_Get (USBD_HandleTypeDef *pdev)
+{
+#if (USBD_COMPOSITE_ENABLED == 1)
+  if (pdev->pClass != &USBD_VENDOR)
+  {
+    return (USBD_VENDOR_HandleTypeDef *)USBD_Composite_GetClassData(pdev, &USBD_VENDOR);
+  }
+#endif /* USBD_COMPOSITE_ENABLED */
+  return (USBD_VENDOR_HandleTypeDef *)pdev->pClassData;
+}
+
+/**
+  * @brief  USBD_VENDOR_Claim
+  *         Take ownership of an endpoint if it is idle
+  * @param  state: busy flag of the endpoint
+  * @retval 1 if the caller now owns the endpoint, 0 if it was busy
+  */
+static uint8_t  USBD_VENDOR_Claim (__IO uint32_t *state)
+{
+  do
+  {
+    if (__LDREXW((uint32_t *)state) != 0)
+    {
+      __CLREX();
+      return 0;
+    }
+  } while (__STREXW(1, (uint32_t *)state) != 0);
+
+  return 1;
+}
+
+/**
+  * @brief  USBD_VENDOR_MsSet
+  *         Write out the MS OS 2.0 descriptor set
+  * @param  buf: USBD_VENDOR_MS_SET_SIZ bytes
+  * @retval length written
+  */
+static uint16_t  USBD_VENDOR_MsSet (uint8_t *buf)
+{
+  static const char name[] = "DeviceInterfaceGUIDs";
+  static const char guid[] = USBD_VENDOR_GUID;
+  uint8_t *p = buf;
+  uint32_t i;
+
+#define USBD_VENDOR_PUT16(v)  do { *p++ = LOBYTE((v)); *p++ = HIBYTE((v)); } while (0)
+
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_LEN_SET_HEADER);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SET_HEADER);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_WINDOWS_VERSION & 0xFFFFU);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_WINDOWS_VERSION >> 16);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SET_SIZ);
+
+#if (USBD_VENDOR_FUNCTION_SUBSET == 1)
+  /* bConfigurationValue of a subset is the configuration index */
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_LEN_SUBSET_HEADER);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SUBSET_CONFIGURATION);
+  *p++ = 0x00;
+  *p++ = 0x00;
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SET_SIZ - USBD_VENDOR_MS_LEN_SET_HEADER);
+
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_LEN_SUBSET_HEADER);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SUBSET_FUNCTION);
+  *p++ = USBD_VENDOR_ITF_NUM;
+  *p++ = 0x00;
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_SET_SIZ - USBD_VENDOR_MS_LEN_SET_HEADER -
+                    USBD_VENDOR_MS_LEN_SUBSET_HEADER);
+#endif /* USBD_VENDOR_FUNCTION_SUBSET */
+
+  /* CompatibleID "WINUSB", no SubCompatibleID */
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_LEN_COMPAT_ID);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_COMPATIBLE_ID);
+  for (i = 0; i < 16; i++)
+  {
+    *p++ = (i < 6) ? (uint8_t)"WINUSB"[i] : 0x00;
+  }
+
+  /* DeviceInterfaceGUIDs, REG_MULTI_SZ: the GUID and two terminators */
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_LEN_PROPERTY);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_REG_PROPERTY);
+  USBD_VENDOR_PUT16(USBD_VENDOR_MS_REG_MULTI_SZ);
+  USBD_VENDOR_PUT16(2 * sizeof(name));
+  for (i = 0; i < sizeof(name); i++)
+  {
+    USBD_VENDOR_PUT16(name[i]);
+  }
+  USBD_VENDOR_PUT16(2 * (sizeof(guid) + 1));
+  for (i = 0; i < sizeof(guid); i++)
+  {
+    USBD_VENDOR_PUT16(guid[i]);
+  }
+  USBD_VENDOR_PUT16(0);
+
+#undef USBD_VENDOR_PUT16
+
+  return (uint16_t)(p - buf);
+}
+
+/**
+  * @brief  USBD_VENDOR_Init
+  *         Open the endpoints and arm OUT if the application gave a buffer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_VENDOR_Init (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_VENDOR_HandleTypeDef *hven = &USBD_VENDOR_Handle;
+  uint16_t mps = USBD_VENDOR_FS_MAX_PACKET_SIZE;
+
+  if (pdev->pUserData == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (USBD_IS_HIGH_SPEED(pdev))
+  {
+    mps = USBD_VENDOR_HS_MAX_PACKET_SIZE;
+  }
+#if (USBD_VENDOR_PMA_ALLOC == 1)
+  else
+  {
+    USBD_VENDOR_ConfigPMA(pdev);
+  }
+#endif /* USBD_VENDOR_PMA_ALLOC */
+
+  USBD_LL_OpenEP(pdev, USBD_VENDOR_IN_EP, USBD_EP_TYPE_BULK, mps);
+  USBD_LL_OpenEP(pdev, USBD_VENDOR_OUT_EP, USBD_EP_TYPE_BULK, mps);
+
+  hven->RxBuffer = NULL;
+  hven->RxSize = 0;
+  hven->TxBuffer = NULL;
+  hven->TxLength = 0;
+  hven->TxState = 0;
+  hven->RxState = 0;
+  hven->TxZlp = 0;
+  pdev->pClassData = hven;
+#if (USBD_FS_ONLY == 0)
+  USBD_VENDOR_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+
+  ((USBD_VENDOR_ItfTypeDef *)pdev->pUserData)->Init();
+
+  if (hven->RxBuffer != NULL)
+  {
+    USBD_VENDOR_ReceivePacket(pdev);
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_DeInit
+  *         Close the endpoints
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_VENDOR_DeInit (USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  USBD_LL_CloseEP(pdev, USBD_VENDOR_IN_EP);
+  USBD_LL_CloseEP(pdev, USBD_VENDOR_OUT_EP);
+
+  if (pdev->pClassData != NULL)
+  {
+    ((USBD_VENDOR_ItfTypeDef *)pdev->pUserData)->DeInit();
+    pdev->pClassData = NULL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_Setup
+  *         Answer the MS OS 2.0 descriptor set request, configured or not
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval status
+  */
+static uint8_t  USBD_VENDOR_Setup (USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  static uint8_t ifalt = 0;
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_VENDOR:
+    if ((req->bRequest == USBD_VENDOR_MS_CODE) &&
+        (req->wIndex == USBD_VENDOR_MS_OS_20_INDEX) &&
+        ((req->bmRequest & 0x80) != 0))
+    {
+      uint16_t len = USBD_VENDOR_MsSet(USBD_VENDOR_MsSetDesc);
+
+      USBD_CtlSendData(pdev, USBD_VENDOR_MsSetDesc, MIN(req->wLength, len));
+      return USBD_OK;
+    }
+    /* not ours: stalled, or left to the next function of a composite */
+    return USBD_FAIL;
+
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_INTERFACE:
+      USBD_CtlSendData(pdev, &ifalt, 1);
+      break;
+
+    case USB_REQ_SET_INTERFACE:
+      break;
+    }
+    break;
+
+  default:
+    return USBD_FAIL;
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_DataIn
+  *         IN transfer sent, ended with a ZLP if it filled its last packet
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_VENDOR_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_VENDOR_HandleTypeDef *hven = (USBD_VENDOR_HandleTypeDef *)pdev->pClassData;
+  const uint8_t *buf;
+  uint32_t len;
+
+  if (hven == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  if (hven->TxZlp)
+  {
+    hven->TxZlp = 0;
+    USBD_LL_Transmit(pdev, USBD_VENDOR_IN_EP, NULL, 0);
+    return USBD_OK;
+  }
+
+  buf = hven->TxBuffer;
+  len = hven->TxLength;
+  hven->TxState = 0;
+  ((USBD_VENDOR_ItfTypeDef *)pdev->pUserData)->TxComplete(buf, len);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_DataOut
+  *         OUT transfer received, handed over until rearmed
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t  USBD_VENDOR_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_VENDOR_HandleTypeDef *hven = (USBD_VENDOR_HandleTypeDef *)pdev->pClassData;
+  uint32_t len;
+
+  if (hven == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  len = USBD_LL_GetRxDataSize(pdev, epnum);
+  hven->RxState = 0;
+  ((USBD_VENDOR_ItfTypeDef *)pdev->pUserData)->Receive(hven->RxBuffer, len);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_VENDOR_GetFSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_VENDOR_CfgFSDesc);
+  return (uint8_t *)USBD_VENDOR_CfgFSDesc;
+}
+
+#if (USBD_FS_ONLY == 0)
+/**
+  * @brief  USBD_VENDOR_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_VENDOR_GetHSCfgDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_VENDOR_CfgHSDesc);
+  return (uint8_t *)USBD_VENDOR_CfgHSDesc;
+}
+
+/**
+  * @brief  USBD_VENDOR_GetOtherSpeedCfgDesc
+  *         Return the configuration of the speed the device is not at
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_VENDOR_GetOtherSpeedCfgDesc (uint16_t *length)
+{
+  if ((USBD_VENDOR_Dev != NULL) && USBD_IS_HIGH_SPEED(USBD_VENDOR_Dev))
+  {
+    *length = sizeof (USBD_VENDOR_OtherSpeedFSDesc);
+    return (uint8_t *)USBD_VENDOR_OtherSpeedFSDesc;
+  }
+  *length = sizeof (USBD_VENDOR_OtherSpeedHSDesc);
+  return (uint8_t *)USBD_VENDOR_OtherSpeedHSDesc;
+}
+
+/**
+  * @brief  USBD_VENDOR_GetDeviceQualifierDesc
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_VENDOR_GetDeviceQualifierDesc (uint16_t *length)
+{
+  *length = sizeof (USBD_VENDOR_DeviceQualifierDesc);
+  return USBD_VENDOR_DeviceQualifierDesc;
+}
+#endif /* USBD_FS_ONLY */
+/**
+  * @}
+  */
+
+/** @defgroup usbd_vendor_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_VENDOR_RegisterInterface
+  *         Set the application callbacks, standalone use
+  * @param  pdev: device instance
+  * @param  fops: callbacks
+  * @retval status
+  */
+uint8_t  USBD_VENDOR_RegisterInterface (USBD_HandleTypeDef *pdev,
+                                        USBD_VENDOR_ItfTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return USBD_FAIL;
+  }
+  pdev->pUserData = fops;
+#if (USBD_FS_ONLY == 0)
+  USBD_VENDOR_Dev = pdev;
+#endif /* USBD_FS_ONLY */
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_SetRxBuffer
+  *         Set the buffer OUT transfers land in
+  * @note   From the Init callback on. size must be a multiple of the max
+  *         packet size: the host may send a full packet at any time.
+  * @param  pdev: device instance
+  * @param  pbuff: buffer
+  * @param  size: length of the buffer
+  * @retval status
+  */
+uint8_t  USBD_VENDOR_SetRxBuffer (USBD_HandleTypeDef *pdev,
+                                  uint8_t *pbuff,
+                                  uint16_t size)
+{
+  USBD_VENDOR_HandleTypeDef *hven = USBD_VENDOR_Get(pdev);
+
+  if (hven == NULL)
+  {
+    return USBD_FAIL;
+  }
+  hven->RxBuffer = pbuff;
+  hven->RxSize = size;
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_ReceivePacket
+  *         Arm the OUT endpoint for the next transfer
+  * @param  pdev: device instance
+  * @retval status, USBD_BUSY if it is armed already
+  */
+uint8_t  USBD_VENDOR_ReceivePacket (USBD_HandleTypeDef *pdev)
+{
+  USBD_VENDOR_HandleTypeDef *hven = USBD_VENDOR_Get(pdev);
+
+  if ((hven == NULL) || (hven->RxBuffer == NULL))
+  {
+    return USBD_FAIL;
+  }
+  if (!USBD_VENDOR_Claim(&hven->RxState))
+  {
+    return USBD_BUSY;
+  }
+  USBD_LL_PrepareReceive(pdev, USBD_VENDOR_OUT_EP, hven->RxBuffer, hven->RxSize);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_Transmit
+  *         Start an IN transfer of a whole buffer, which must stay valid
+  *         until TxComplete
+  * @param  pdev: device instance
+  * @param  pbuff: data
+  * @param  length: bytes to send, 0 for a lone ZLP
+  * @retval status, USBD_BUSY while the previous transfer is under way
+  */
+uint8_t  USBD_VENDOR_Transmit (USBD_HandleTypeDef *pdev,
+                               const uint8_t *pbuff,
+                               uint16_t length)
+{
+  USBD_VENDOR_HandleTypeDef *hven = USBD_VENDOR_Get(pdev);
+  uint16_t mps = USBD_VENDOR_FS_MAX_PACKET_SIZE;
+
+  if (hven == NULL)
+  {
+    return USBD_FAIL;
+  }
+  if (!USBD_VENDOR_Claim(&hven->TxState))
+  {
+    USB_STATS_TX_BUSY(USBD_VENDOR_IN_EP);
+    USB_TRACE_BUSY(USBD_VENDOR_IN_EP);
+    return USBD_BUSY;
+  }
+
+  if (USBD_IS_HIGH_SPEED(pdev))
+  {
+    mps = USBD_VENDOR_HS_MAX_PACKET_SIZE;
+  }
+
+  hven->TxBuffer = pbuff;
+  hven->TxLength = length;
+  /* the host only sees the end of a transfer on a short packet */
+  hven->TxZlp = (length != 0) && ((length % mps) == 0);
+  USBD_LL_Transmit(pdev, USBD_VENDOR_IN_EP, pbuff, length);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_VENDOR_GetBOSDesc
+  *         BOS descriptor with the MS OS 2.0 platform capability, for
+  *         GetBOSDescriptor of the device descriptors
+  * @param  speed : current device speed
+  * @param  length : pointer to data length variable
+  * @retval pointer to descriptor buffer
+  */
+uint8_t  *USBD_VENDOR_GetBOSDesc (USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  *length = sizeof (USBD_VENDOR_BOSDesc);
+  return USBD_VENDOR_BOSDesc;
+}
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_VENDOR_ENABLED */
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""What a build put in CCM SRAM, see inc/usb/usb_ccm.h.
+
+Lists the functions and data the ELF file places in the CCM of the
+STM32F303, largest first, with the total against the size of the part.
+Fails when it does not fit, so it can run as a post-link step.
+
+    ccm_report.py firmware.elf
+    ccm_report.py --size 16K --nm arm-none-eabi-nm firmware.elf
+"""
+
+import argparse
+import subprocess
+import sys
+
+CCM_BASE = 0x10000000
+
+
+def parse_size(text):
+    text = text.strip().upper()
+    if text.endswith("K"):
+        return int(text[:-1]) * 1024
+    return int(text, 0)
+
+
+def ccm_symbols(nm, elf, size):
+    """[(bytes, kind, name)] of the symbols inside CCM"""
+    out = subprocess.run([nm, "-S", "--size-sort", elf], check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 4:
+            continue
+        addr, length, kind, name = int(fields[0], 16), int(fields[1], 16), fields[2], fields[3]
+        if CCM_BASE <= addr < CCM_BASE + size:
+            symbols.append((length, "code" if kind in "tTwW" else "data", name))
+    symbols.sort(reverse=True)
+    return symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="linked firmware")
+    parser.add_argument("--size", default="8K",
+                        help="CCM of the part: 8K for the F303xC, 16K for the F303xE")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm of the toolchain")
+    args = parser.parse_args()
+
+    size = parse_size(args.size)
+    symbols = ccm_symbols(args.nm, args.elf, size)
+
+    totals = {"code": 0, "data": 0}
+    for length, kind, name in symbols:
+        totals[kind] += length
+        print("%6d  %-4s  %s" % (length, kind, name))
+
+    used = totals["code"] + totals["data"]
+    print("CCM: %d bytes of code, %d bytes of data, %d of %d bytes used (%.0f %%)" %
+          (totals["code"], totals["data"], used, size, 100.0 * used / size))
+
+    if not symbols:
+        print("nothing in CCM: is USB_CCM_ENABLED set and the linker script updated?")
+    return 1 if used > size else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
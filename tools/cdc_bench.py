@@ -0,0 +1,715 @@
+#!/usr/bin/env python3
+"""Host side of the CDC benchmark, see inc/usb/usbd_cdc_bench.h.
+
+The firmware must be built with USBD_CDC_BENCH_ENABLED=1 and register
+USBD_CDC_Bench_fops. The test mode of each port is chosen through the
+baud rate, so nothing but pyserial is needed on the host.
+
+    cdc_bench.py /dev/ttyACM0 /dev/ttyACM1
+    cdc_bench.py --duration 10 --sizes 1,64,512 --json run.json PORT...
+    cdc_bench.py --baseline run.json --tolerance 5 PORT...
+    cdc_bench.py --pma --json pma.json PORT
+    cdc_bench.py --enum --baseline enum.json PORT
+    cdc_bench.py --soak --hours 12 --line-every 60 --reset-every 1800 \
+        --suspend-every 900 --json soak.json PORT...
+
+Throughput runs on all ports at once: first the IN direction (source),
+then OUT (sink), then both through loopback. Latency is measured one port
+at a time in ping-pong mode. With --baseline the run fails when a figure
+is worse than the baseline by more than --tolerance percent. A tty gets
+one read at a time; cdc_host_bench.cpp runs the throughput tests through
+libusb with several transfers queued per endpoint.
+
+With --pma only the packet memory copy benchmark runs, on the first
+port: cycles per byte of PCD_WritePMA and PCD_ReadPMA by size and user
+buffer alignment (USB_PMABENCH_ENABLED=1 on an F3 part).
+
+With --enum only the enumeration timings are read, on the first port:
+microseconds from the pull-up to each step of the enumeration and to the
+first bulk OUT packet, which the tool sends (USB_ENUMBENCH_ENABLED=1).
+Run it right after plugging the device in; each new pull-up starts over.
+A fast boot firmware (USB_FASTBOOT_ENABLED=1) counts its first pull-up from
+the reset instead, with the HSE and PLL start up as steps; compare it only
+with a baseline of the same kind.
+
+With --soak both directions run at once on all ports for --hours (or
+--duration seconds), with transfers of random sizes; the device checks
+what it receives and the tool what it reads. Throughput is logged every
+--interval seconds. The line coding is changed every --line-every
+seconds, which must not disturb the streams, and the device is bus reset
+(--reset-every) or runtime suspended (--suspend-every) with the ports
+closed, which needs write access to /dev/bus/usb and the sysfs power
+files. An interval without progress is a stall: the soak is started over
+on that port, as after a corrupted stream. The 10th percentile of the
+undisturbed interval rates is what goes into the results and is compared
+with a baseline. The run fails on corruption on either side, on more than
+--max-stalls stalls, or on a regression.
+"""
+
+import argparse
+import fcntl
+import json
+import os
+import random
+import sys
+import threading
+import time
+
+import serial
+
+BAUD_LOOPBACK = 10001
+BAUD_SINK = 10002
+BAUD_SOURCE = 10003
+BAUD_PINGPONG = 10004
+BAUD_PMA = 10005
+BAUD_ENUM = 10006
+BAUD_SOAK = 10007
+BAUD_SOAK_REPORT = 10008
+BAUD_OFF = 115200
+
+CHUNK = 16384
+
+USBDEVFS_RESET = 0x5514
+
+# Soak byte n is (n + (n >> 8) + (n >> 16)) & 0xFF: each 256 byte block is
+# a rotation of range(256)
+SOAK_TABLE = bytes(range(256)) * 2
+SOAK_SIZES = (1, 63, 64, 65, 128, 512, 1024, 4096)
+
+
+def open_port(name):
+    port = serial.Serial(name, BAUD_OFF, timeout=1.0, write_timeout=2.0)
+    port.reset_input_buffer()
+    return port
+
+
+def set_mode(port, baud):
+    port.baudrate = baud
+    # Whatever the previous mode left in flight
+    time.sleep(0.05)
+    port.reset_input_buffer()
+
+
+def run_source(port, duration, result, check):
+    set_mode(port, BAUD_SOURCE)
+    total = 0
+    expect = 0
+    errors = 0
+    start = time.perf_counter()
+    while time.perf_counter() - start < duration:
+        data = port.read(CHUNK)
+        if check and data:
+            if expect == 0 and total == 0:
+                expect = data[0]
+            for b in data:
+                if b != expect:
+                    errors += 1
+                    expect = b
+                expect = (expect + 1) & 0xFF
+        total += len(data)
+    elapsed = time.perf_counter() - start
+    set_mode(port, BAUD_OFF)
+    result["in_MBps"] = total / elapsed / 1e6
+    result["in_errors"] = errors
+
+
+def run_sink(port, duration, result):
+    set_mode(port, BAUD_SINK)
+    block = bytes(range(256)) * (CHUNK // 256)
+    total = 0
+    start = time.perf_counter()
+    while time.perf_counter() - start < duration:
+        total += port.write(block)
+    port.flush()
+    elapsed = time.perf_counter() - start
+    set_mode(port, BAUD_OFF)
+    result["out_MBps"] = total / elapsed / 1e6
+
+
+def run_loopback(port, duration, result):
+    set_mode(port, BAUD_LOOPBACK)
+    block = bytes(range(256)) * (CHUNK // 256)
+    sent = 0
+    received = bytearray()
+    done = threading.Event()
+
+    def reader():
+        while not done.is_set() or len(received) < sent:
+            data = port.read(CHUNK)
+            if not data and done.is_set():
+                break
+            received.extend(data)
+
+    thread = threading.Thread(target=reader)
+    thread.start()
+    start = time.perf_counter()
+    while time.perf_counter() - start < duration:
+        sent += port.write(block)
+    port.flush()
+    done.set()
+    thread.join()
+    elapsed = time.perf_counter() - start
+    set_mode(port, BAUD_OFF)
+
+    expected = (block * (sent // len(block) + 1))[:sent]
+    result["loopback_MBps"] = len(received) / elapsed / 1e6
+    result["loopback_lost"] = sent - len(received)
+    result["loopback_ok"] = bytes(received[:sent]) == expected
+
+
+def run_latency(port, size, count):
+    set_mode(port, BAUD_PINGPONG)
+    payload = bytes((i * 7) & 0xFF for i in range(size))
+    samples = []
+    for _ in range(count):
+        start = time.perf_counter()
+        port.write(payload)
+        echo = bytearray()
+        while len(echo) < size:
+            data = port.read(size - len(echo))
+            if not data:
+                raise RuntimeError("%s: no echo for %d bytes" % (port.name, size))
+            echo.extend(data)
+        samples.append((time.perf_counter() - start) * 1e6)
+        if bytes(echo) != payload:
+            raise RuntimeError("%s: corrupted echo for %d bytes" % (port.name, size))
+    set_mode(port, BAUD_OFF)
+
+    samples.sort()
+
+    def pct(p):
+        return samples[min(len(samples) - 1, int(len(samples) * p / 100.0))]
+
+    return {"p50_us": pct(50), "p90_us": pct(90), "p99_us": pct(99),
+            "max_us": samples[-1]}
+
+
+def run_pma(port):
+    """{"layout": "2x16", "clock": hz, "write": {"64": [cpb0..3]}, "read": ...}"""
+    port.reset_input_buffer()
+    port.baudrate = BAUD_PMA
+    result = {"write": {}, "read": {}}
+    while True:
+        line = port.readline().decode("ascii", "replace").split()
+        if not line:
+            raise RuntimeError("%s: no packet memory report" % port.name)
+        if line[0] == "end":
+            break
+        if line[0] == "pma":
+            result["layout"] = line[1]
+            result["clock"] = int(line[3])
+        elif line[0] != "size":
+            result["write"][line[0]] = [float(v) for v in line[1:5]]
+            result["read"][line[0]] = [float(v) for v in line[5:9]]
+    set_mode(port, BAUD_OFF)
+    return result
+
+
+def run_enum(port):
+    """{"clock": hz, "from": "pull-up" or "reset",
+    "steps": {"reset": {"count": n, "first_us": t, "last_us": t}}}"""
+    # the first bulk byte, dropped by the device outside of a test mode
+    port.write(b"\0")
+    port.flush()
+    time.sleep(0.05)
+    port.reset_input_buffer()
+    port.baudrate = BAUD_ENUM
+    result = {"steps": {}, "order": []}
+    while True:
+        line = port.readline().decode("ascii", "replace").split()
+        if not line:
+            raise RuntimeError("%s: no enumeration report" % port.name)
+        if line[0] == "end":
+            break
+        if line[0] == "enum":
+            result["clock"] = int(line[2])
+            result["from"] = line[3] if len(line) > 3 else "pull-up"
+        elif line[0] != "step":
+            result["order"].append(line[0])
+            result["steps"][line[0]] = {"count": int(line[1]),
+                                        "first_us": int(line[2]),
+                                        "last_us": int(line[3])}
+    set_mode(port, BAUD_OFF)
+    return result
+
+
+def soak_bytes(pos, length):
+    out = bytearray()
+    while length > 0:
+        block, offset = divmod(pos, 256)
+        start = (block + (block >> 8) + offset) & 0xFF
+        n = min(256 - offset, length)
+        out += SOAK_TABLE[start:start + n]
+        pos += n
+        length -= n
+    return bytes(out)
+
+
+def run_soak_report(port):
+    """{"soak": {"rx_bytes": n, ...}, "stats": {"resets": n, ...}}, clearing
+    the soak counters of the device"""
+    set_mode(port, BAUD_OFF)
+    port.baudrate = BAUD_SOAK_REPORT
+    result = {}
+    while True:
+        line = port.readline().decode("ascii", "replace").split()
+        if not line:
+            raise RuntimeError("%s: no soak report" % port.name)
+        if line[0] == "end":
+            break
+        result[line[0]] = {k: int(v) for k, v in zip(line[1::2], line[2::2])}
+    set_mode(port, BAUD_OFF)
+    return result
+
+
+class SoakStream:
+    """Both directions of the soak on one port"""
+
+    def __init__(self, port, seed):
+        self.port = port
+        self.name = port.name
+        self.rng = random.Random(seed)
+        self.in_bytes = 0
+        self.out_bytes = 0
+        self.errors = 0
+        self.threads = []
+
+    def start(self):
+        set_mode(self.port, BAUD_SOAK)
+        self.rx_pos = self.tx_pos = 0
+        self.last_rx = self.last_tx = 0
+        self.bad = False
+        self.stalled = False
+        self.done = threading.Event()
+        self.threads = [threading.Thread(target=self.reader),
+                        threading.Thread(target=self.writer)]
+        for t in self.threads:
+            t.start()
+
+    def stop(self):
+        self.done.set()
+        for t in self.threads:
+            t.join()
+        self.port.reset_output_buffer()
+        set_mode(self.port, BAUD_OFF)
+
+    def progress(self):
+        """bytes in and out since the last call"""
+        rx, tx = self.rx_pos, self.tx_pos
+        din, dout = rx - self.last_rx, tx - self.last_tx
+        self.last_rx, self.last_tx = rx, tx
+        self.in_bytes += din
+        self.out_bytes += dout
+        return din, dout
+
+    def reader(self):
+        while not self.done.is_set() and not self.bad:
+            data = self.port.read(CHUNK)
+            if not data:
+                continue
+            if data != soak_bytes(self.rx_pos, len(data)):
+                self.errors += 1
+                self.bad = True
+            self.rx_pos += len(data)
+
+    def writer(self):
+        while not self.done.is_set() and not self.bad:
+            if self.rng.random() < 0.5:
+                size = self.rng.choice(SOAK_SIZES)
+            else:
+                size = self.rng.randint(1, CHUNK)
+            try:
+                self.tx_pos += self.port.write(soak_bytes(self.tx_pos, size))
+            except serial.SerialTimeoutException:
+                # how much went out is not known: the soak must start over
+                self.stalled = True
+                return
+
+
+def usb_device_path(name):
+    """sysfs directory of the USB device of a port, or None"""
+    from serial.tools import list_ports
+
+    real = os.path.realpath(name)
+    for info in list_ports.comports():
+        if info.device in (name, real):
+            return getattr(info, "usb_device_path", None)
+    return None
+
+
+def read_sysfs(path):
+    with open(path) as f:
+        return f.read().strip()
+
+
+def write_sysfs(path, value):
+    with open(path, "w") as f:
+        f.write(value)
+
+
+def reset_device(sysfs):
+    bus = int(read_sysfs(os.path.join(sysfs, "busnum")))
+    dev = int(read_sysfs(os.path.join(sysfs, "devnum")))
+    with open("/dev/bus/usb/%03d/%03d" % (bus, dev), "wb") as f:
+        fcntl.ioctl(f, USBDEVFS_RESET, 0)
+    return True
+
+
+def suspend_device(sysfs, timeout=5.0):
+    """Let the kernel runtime suspend the device, then resume it"""
+    power = os.path.join(sysfs, "power")
+    write_sysfs(os.path.join(power, "autosuspend_delay_ms"), "0")
+    write_sysfs(os.path.join(power, "control"), "auto")
+    try:
+        start = time.monotonic()
+        while time.monotonic() - start < timeout:
+            if read_sysfs(os.path.join(power, "runtime_status")) == "suspended":
+                return True
+            time.sleep(0.05)
+        return False
+    finally:
+        write_sysfs(os.path.join(power, "control"), "on")
+
+
+def reopen_port(name, timeout=10.0):
+    start = time.monotonic()
+    while True:
+        try:
+            return open_port(name)
+        except serial.SerialException:
+            if time.monotonic() - start >= timeout:
+                raise
+            time.sleep(0.1)
+
+
+def disturb(streams, action, sysfs):
+    """Run action on the device with all ports stopped and closed"""
+    for s in streams:
+        s.stop()
+        s.port.close()
+    # the tty may go away and come back when the driver rebinds
+    time.sleep(0.2)
+    try:
+        ok = action(sysfs)
+    finally:
+        time.sleep(0.5)
+        for s in streams:
+            s.port = reopen_port(s.name)
+            s.start()
+    return ok
+
+
+def concurrently(ports, target, duration, results, *args):
+    threads = [threading.Thread(target=target, args=(p, duration, results[p.name]) + args)
+               for p in ports]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+
+def flatten(results, prefix=""):
+    """{"port": {"latency": {"64": {"p50_us": x}}}} -> {"port latency 64 p50_us": x}"""
+    flat = {}
+    for key, value in results.items():
+        name = (prefix + " " + key).strip()
+        if isinstance(value, dict):
+            flat.update(flatten(value, name))
+        elif isinstance(value, list):
+            # cycles per byte by alignment
+            for align, v in enumerate(value):
+                flat["%s a%d cpb" % (name, align)] = v
+        elif isinstance(value, (int, float)) and not isinstance(value, bool):
+            flat[name] = value
+    return flat
+
+
+def compare(results, baseline, tolerance):
+    """Figures worse than the baseline by more than tolerance percent"""
+    cur = flatten(results)
+    worse = []
+    for name, ref in flatten(baseline).items():
+        if name not in cur:
+            continue
+        if name.endswith("MBps") and cur[name] < ref * (1 - tolerance / 100.0):
+            worse.append("%s %.3f < %.3f" % (name, cur[name], ref))
+        elif name.endswith("_us") and cur[name] > ref * (1 + tolerance / 100.0):
+            worse.append("%s %.0f > %.0f" % (name, cur[name], ref))
+        elif name.endswith("cpb") and cur[name] > ref * (1 + tolerance / 100.0):
+            worse.append("%s %.2f > %.2f" % (name, cur[name], ref))
+    return worse
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("ports", nargs="+", help="CDC ports of the device")
+    parser.add_argument("--duration", type=float, default=5.0,
+                        help="seconds per throughput test")
+    parser.add_argument("--sizes", default="1,8,63,64,65,128,512,1024",
+                        help="packet sizes of the latency test")
+    parser.add_argument("--count", type=int, default=500,
+                        help="round trips per latency size")
+    parser.add_argument("--no-check", action="store_true",
+                        help="skip the source pattern check (faster on slow hosts)")
+    parser.add_argument("--json", help="write the results to this file")
+    parser.add_argument("--baseline", help="compare with the results in this file")
+    parser.add_argument("--tolerance", type=float, default=5.0,
+                        help="percent a figure may be worse than the baseline")
+    parser.add_argument("--pma", action="store_true",
+                        help="run the packet memory copy benchmark instead")
+    parser.add_argument("--enum", action="store_true",
+                        help="read the enumeration timings instead")
+    parser.add_argument("--soak", action="store_true",
+                        help="run the long soak test instead")
+    parser.add_argument("--hours", type=float,
+                        help="soak length, instead of --duration seconds")
+    parser.add_argument("--interval", type=float, default=10.0,
+                        help="seconds per soak throughput sample")
+    parser.add_argument("--line-every", type=float, default=0.0,
+                        help="seconds between soak line coding changes, 0 for none")
+    parser.add_argument("--reset-every", type=float, default=0.0,
+                        help="seconds between soak bus resets, 0 for none")
+    parser.add_argument("--suspend-every", type=float, default=0.0,
+                        help="seconds between soak suspends, 0 for none")
+    parser.add_argument("--max-stalls", type=int, default=0,
+                        help="soak stalls allowed before the run fails")
+    args = parser.parse_args()
+
+    ports = [open_port(name) for name in args.ports]
+    results = {p.name: {} for p in ports}
+
+    if args.pma:
+        return pma_main(args, ports[0], results)
+    if args.enum:
+        return enum_main(args, ports[0], results)
+    if args.soak:
+        return soak_main(args, ports, results)
+
+    concurrently(ports, run_source, args.duration, results, not args.no_check)
+    concurrently(ports, run_sink, args.duration, results)
+    concurrently(ports, run_loopback, args.duration, results)
+
+    for p in ports:
+        lat = results[p.name].setdefault("latency", {})
+        for size in (int(s) for s in args.sizes.split(",")):
+            lat[str(size)] = run_latency(p, size, args.count)
+
+    for name, res in results.items():
+        print("%s: IN %.3f MB/s (%d pattern errors), OUT %.3f MB/s, "
+              "loopback %.3f MB/s (%d lost, %s)" %
+              (name, res["in_MBps"], res["in_errors"], res["out_MBps"],
+               res["loopback_MBps"], res["loopback_lost"],
+               "ok" if res["loopback_ok"] else "CORRUPTED"))
+        for size, lat in res["latency"].items():
+            print("  %5s bytes: p50 %7.0f us  p90 %7.0f us  p99 %7.0f us  max %7.0f us" %
+                  (size, lat["p50_us"], lat["p90_us"], lat["p99_us"], lat["max_us"]))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    failed = any(r["in_errors"] or not r["loopback_ok"] for r in results.values())
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            worse = compare(results, json.load(f), args.tolerance)
+        for w in worse:
+            print("regression: " + w)
+        failed = failed or bool(worse)
+
+    for p in ports:
+        p.close()
+
+    return 1 if failed else 0
+
+
+def pma_main(args, port, results):
+    pma = results[port.name]["pma"] = run_pma(port)
+    print("%s: packet memory %s at %d Hz, cycles per byte by user buffer alignment" %
+          (port.name, pma["layout"], pma["clock"]))
+    print("  size   write 0     1     2     3    read 0     1     2     3")
+    for size in sorted(pma["write"], key=int):
+        print("  %4s  " % size +
+              " ".join("%5.2f" % v for v in pma["write"][size]) + "   " +
+              " ".join("%5.2f" % v for v in pma["read"][size]))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    failed = False
+    if args.baseline:
+        with open(args.baseline) as f:
+            worse = compare(results, json.load(f), args.tolerance)
+        for w in worse:
+            print("regression: " + w)
+        failed = bool(worse)
+
+    port.close()
+    return 1 if failed else 0
+
+
+def enum_main(args, port, results):
+    enum = run_enum(port)
+    order = enum.pop("order")
+    results[port.name]["enum"] = enum
+    print("%s: enumeration at %d Hz, microseconds from the %s" %
+          (port.name, enum["clock"], enum["from"]))
+    print("  step        count     first      last")
+    for name in order:
+        step = enum["steps"][name]
+        if step["count"] == 0:
+            print("  %-10s  %5d         -         -" % (name, 0))
+        else:
+            print("  %-10s  %5d  %8d  %8d" %
+                  (name, step["count"], step["first_us"], step["last_us"]))
+    # the OUT count goes on with the traffic, keep it out of the baseline
+    enum["steps"].get("out", {}).pop("count", None)
+    enum["steps"].get("out", {}).pop("last_us", None)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    failed = any(s.get("count", 1) == 0 for n, s in enum["steps"].items()
+                 if n in ("reset", "device", "address", "config", "setconfig", "init"))
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        ref = baseline.get(port.name, {}).get("enum", {}).get("from", "pull-up")
+        if ref != enum["from"]:
+            print("baseline counts from the %s, not comparable" % ref)
+            failed = True
+        else:
+            worse = compare(results, baseline, args.tolerance)
+            for w in worse:
+                print("regression: " + w)
+            failed = failed or bool(worse)
+
+    port.close()
+    return 1 if failed else 0
+
+
+
+def soak_main(args, ports, results):
+    duration = args.hours * 3600.0 if args.hours else args.duration
+    sysfs = usb_device_path(ports[0].name)
+    reset_every, suspend_every = args.reset_every, args.suspend_every
+    if (reset_every or suspend_every) and sysfs is None:
+        print("%s: no USB device found, no resets or suspends" % ports[0].name)
+        reset_every = suspend_every = 0.0
+
+    for p in ports:
+        run_soak_report(p)
+    streams = [SoakStream(p, i) for i, p in enumerate(ports)]
+    rates = {s.name: {"in": [], "out": []} for s in streams}
+    counts = {"stalls": 0, "resyncs": 0, "lines": 0, "resets": 0, "suspends": 0}
+
+    for s in streams:
+        s.start()
+    start = last = time.monotonic()
+    next_line = start + args.line_every if args.line_every else float("inf")
+    next_reset = start + reset_every if reset_every else float("inf")
+    next_suspend = start + suspend_every if suspend_every else float("inf")
+    disturbed = False
+
+    try:
+        while last - start < duration:
+            time.sleep(max(0.0, min(args.interval, start + duration - last)))
+            now = time.monotonic()
+            elapsed = now - last
+            log = "%9.0f s" % (now - start)
+            restart = []
+            for s in streams:
+                din, dout = s.progress()
+                log += "  %s in %7.3f out %7.3f MB/s" % (s.name, din / elapsed / 1e6,
+                                                         dout / elapsed / 1e6)
+                if din == 0 or dout == 0 or s.stalled:
+                    log += " STALL"
+                    counts["stalls"] += 1
+                    restart.append(s)
+                elif s.bad:
+                    log += " CORRUPTED"
+                    restart.append(s)
+                elif not disturbed:
+                    rates[s.name]["in"].append(din / elapsed / 1e6)
+                    rates[s.name]["out"].append(dout / elapsed / 1e6)
+            print(log)
+            sys.stdout.flush()
+
+            disturbed = False
+            for s in restart:
+                s.stop()
+                s.start()
+                counts["resyncs"] += 1
+                disturbed = True
+            if now >= next_line:
+                for s in streams:
+                    s.port.stopbits = (serial.STOPBITS_TWO
+                                       if s.port.stopbits == serial.STOPBITS_ONE
+                                       else serial.STOPBITS_ONE)
+                counts["lines"] += 1
+                next_line += args.line_every
+            try:
+                if now >= next_reset:
+                    disturb(streams, reset_device, sysfs)
+                    counts["resets"] += 1
+                    disturbed = True
+                    next_reset += reset_every
+                if now >= next_suspend:
+                    if disturb(streams, suspend_device, sysfs):
+                        counts["suspends"] += 1
+                    else:
+                        print("device did not suspend")
+                    disturbed = True
+                    next_suspend += suspend_every
+            except OSError as e:
+                print("no more resets or suspends: %s" % e)
+                next_reset = next_suspend = float("inf")
+            # a restarted stream counts from 0 again
+            for s in streams:
+                s.progress()
+            last = time.monotonic()
+    finally:
+        for s in streams:
+            s.stop()
+
+    failed = counts["stalls"] > args.max_stalls
+    hours = (last - start) / 3600.0
+    for s in streams:
+        device = run_soak_report(s.port)
+        ins, outs = sorted(rates[s.name]["in"]), sorted(rates[s.name]["out"])
+        soak = {"in_MBps": ins[len(ins) // 10] if ins else 0.0,
+                "out_MBps": outs[len(outs) // 10] if outs else 0.0,
+                "hours": hours, "in_bytes": s.in_bytes, "out_bytes": s.out_bytes,
+                "in_errors": s.errors, "device": device}
+        soak.update(counts)
+        results[s.name]["soak"] = soak
+        dev = device.get("soak", {})
+        print("%s: %.2f h, p10 IN %.3f MB/s OUT %.3f MB/s, %d host / %d device "
+              "pattern errors, %d stalls, %d resyncs, %d line changes, "
+              "%d resets, %d suspends, %d interface inits" %
+              (s.name, hours, soak["in_MBps"], soak["out_MBps"], s.errors,
+               dev.get("rx_errors", 0), counts["stalls"], counts["resyncs"],
+               counts["lines"], counts["resets"], counts["suspends"],
+               dev.get("inits", 0)))
+        failed = failed or s.errors != 0 or dev.get("rx_errors", 0) != 0
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            worse = compare(results, json.load(f), args.tolerance)
+        for w in worse:
+            print("regression: " + w)
+        failed = failed or bool(worse)
+
+    for s in streams:
+        s.port.close()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,951 @@
+/**
+  ******************************************************************************
+  * @file    cdc_host.hpp
+  * @brief   Host side of the CDC ports and the vendor bulk interface, over
+  *          libusb. Header only, C++20.
+  *
+  *          A tty takes one read at a time from user space, and cdc_acm
+  *          keeps few transfers queued: the bus idles between them and a
+  *          full speed device never gets its 19 packets per frame. Here
+  *          each endpoint of a started port keeps PipeConfig::depth bulk
+  *          transfers of PipeConfig::size bytes queued, so the host
+  *          controller always has one scheduled while the application is
+  *          still busy with the ones before. The device side holds no more
+  *          than its two packet buffers per endpoint; the depth covers the
+  *          host instead: 8 transfers of 4 KiB keep a full speed endpoint
+  *          busy for some 25 ms of callback latency.
+  *
+  *          The transfers of an endpoint complete in order and are handed
+  *          to read() in the order they were queued, whatever the order
+  *          their callbacks were seen in, so the stream comes out as sent.
+  *          Short transfers, zero length ones included, do not end it.
+  *
+  *          Port numbering follows the device: cdc(i) is CDC instance i of
+  *          usbd_cdc.h, from 0 to NUM_CDC_INSTANCES - 1, found from the
+  *          data interfaces of the configuration descriptor in interface
+  *          order, each with the communication interface before it. It
+  *          stays so under USBD_COMPOSITE, where other functions may come
+  *          in between. vendor() is the class 0xFF interface of
+  *          usbd_vendor.h, if any.
+  *
+  *            usbd::host::Device dev;
+  *            if (dev.open(0x0483, 0x5740) == 0) {
+  *              usbd::host::Port *port = dev.cdc(0);
+  *              port->start();
+  *              port->set_line_coding(115200);
+  *              port->write(request, 1000);
+  *              int n = port->read(reply, 1000);
+  *            }
+  *
+  *          A port detaches the kernel driver of its interfaces when
+  *          started and gives them back when stopped, so the ports not
+  *          started stay ttys. One thread drives a Device: the transfer
+  *          callbacks run from its read, write, flush and poll calls. Calls
+  *          return a libusb error, negative, or 0 or a byte count. A Device
+  *          must not move once opened.
+  *
+  *            c++ -std=c++20 -O2 prog.cpp $(pkg-config --cflags --libs libusb-1.0)
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CDC_HOST_HPP
+#define __CDC_HOST_HPP
+
+#if (__cplusplus < 202002L)
+#error "cdc_host.hpp needs C++20 (std::span)"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <libusb.h>
+
+namespace usbd::host {
+
+/* Bound of NUM_CDC_INSTANCES in usbd_cdc.h */
+constexpr int kMaxCdcInstances = 3;
+
+constexpr uint8_t kNoInterface = 0xFF;
+
+/* CDC class requests, to the communication interface */
+constexpr uint8_t kSetLineCoding = 0x20;
+constexpr uint8_t kSetControlLineState = 0x22;
+
+struct PipeConfig
+{
+  std::size_t depth = 8;              /* transfers queued per endpoint */
+  std::size_t size = 4096;            /* bytes per transfer, rounded up to whole packets */
+  bool        zlp = false;            /* end OUT transfers of whole packets with a ZLP */
+};
+
+struct PortStats
+{
+  uint64_t in_bytes = 0;
+  uint64_t in_xfers = 0;              /* IN transfers completed */
+  uint64_t in_zlps = 0;               /* of which zero length */
+  uint64_t out_bytes = 0;
+  uint64_t out_xfers = 0;
+};
+
+class Device;
+
+/**
+  * @brief  Bulk transfers of one endpoint, queued round robin
+  */
+class Pipe
+{
+public:
+  Pipe(const Pipe &) = delete;
+  Pipe &operator=(const Pipe &) = delete;
+
+  ~Pipe()
+  {
+    release();
+  }
+
+  /* first error seen, 0 if none */
+  int error() const
+  {
+    return error_;
+  }
+
+  std::size_t in_flight() const
+  {
+    return in_flight_;
+  }
+
+protected:
+  struct Slot
+  {
+    Pipe                *pipe = nullptr;
+    libusb_transfer     *xfer = nullptr;
+    std::vector<uint8_t> buf;
+    std::size_t          length = 0;  /* IN: bytes received, OUT: bytes filled in */
+    std::size_t          offset = 0;  /* IN: bytes read out */
+    bool                 busy = false;
+    bool                 ready = false;
+  };
+
+  Pipe() = default;
+
+  int setup(libusb_device_handle *handle, uint8_t ep, uint16_t mps, const PipeConfig &cfg)
+  {
+    std::size_t depth = std::max<std::size_t>(cfg.depth, 1U);
+
+    if (in_flight_ != 0U)
+    {
+      return LIBUSB_ERROR_BUSY;
+    }
+    release();
+    handle_ = handle;
+    ep_ = ep;
+    size_ = std::max<std::size_t>((cfg.size + mps - 1U) / mps, 1U) * mps;
+    flags_ = (cfg.zlp && ((ep & LIBUSB_ENDPOINT_IN) == 0)) ? LIBUSB_TRANSFER_ADD_ZERO_PACKET : 0;
+    error_ = 0;
+    next_ = 0;
+    stats_ = {};
+    slots_ = std::vector<Slot>(depth);
+    for (Slot &s : slots_)
+    {
+      s.pipe = this;
+      s.buf.resize(size_);
+      s.xfer = libusb_alloc_transfer(0);
+      if (s.xfer == nullptr)
+      {
+        release();
+        return LIBUSB_ERROR_NO_MEM;
+      }
+    }
+    return LIBUSB_SUCCESS;
+  }
+
+  int submit(Slot &s, std::size_t length)
+  {
+    int ret;
+
+    libusb_fill_bulk_transfer(s.xfer, handle_, ep_, s.buf.data(), static_cast<int>(length),
+                              &Pipe::complete, &s, 0);
+    s.xfer->flags = flags_;
+    ret = libusb_submit_transfer(s.xfer);
+    if (ret < 0)
+    {
+      if (error_ == 0)
+      {
+        error_ = ret;
+      }
+      return ret;
+    }
+    s.busy = true;
+    s.ready = false;
+    in_flight_++;
+    return LIBUSB_SUCCESS;
+  }
+
+  /* cancel whatever is queued, the callbacks still have to run */
+  void cancel()
+  {
+    for (Slot &s : slots_)
+    {
+      if (s.busy)
+      {
+        libusb_cancel_transfer(s.xfer);
+      }
+    }
+  }
+
+  /* free the transfers, unless some are still with libusb */
+  void release()
+  {
+    if (in_flight_ != 0U)
+    {
+      return;
+    }
+    for (Slot &s : slots_)
+    {
+      if (s.xfer != nullptr)
+      {
+        libusb_free_transfer(s.xfer);
+      }
+    }
+    slots_.clear();
+  }
+
+  static int status_error(int status)
+  {
+    switch (status)
+    {
+    case LIBUSB_TRANSFER_TIMED_OUT:
+      return LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_STALL:
+      return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+      return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:
+      return LIBUSB_ERROR_OVERFLOW;
+    default:
+      return LIBUSB_ERROR_IO;
+    }
+  }
+
+  static void LIBUSB_CALL complete(libusb_transfer *xfer)
+  {
+    Slot *s = static_cast<Slot *>(xfer->user_data);
+    Pipe *p = s->pipe;
+    std::size_t n = static_cast<std::size_t>(xfer->actual_length);
+
+    s->busy = false;
+    p->in_flight_--;
+
+    if (xfer->status == LIBUSB_TRANSFER_COMPLETED)
+    {
+      p->stats_.bytes += n;
+      p->stats_.xfers++;
+      if (n == 0U)
+      {
+        p->stats_.zlps++;
+      }
+      if ((p->ep_ & LIBUSB_ENDPOINT_IN) != 0)
+      {
+        s->length = n;
+        s->offset = 0;
+        s->ready = true;
+        return;
+      }
+    }
+    else if ((xfer->status != LIBUSB_TRANSFER_CANCELLED) && (p->error_ == 0))
+    {
+      p->error_ = status_error(xfer->status);
+    }
+    s->length = 0;
+  }
+
+  struct Counters
+  {
+    uint64_t bytes = 0;
+    uint64_t xfers = 0;
+    uint64_t zlps = 0;
+  };
+
+  std::vector<Slot>     slots_;
+  std::size_t           next_ = 0;    /* IN: oldest slot to read, OUT: slot being filled */
+  std::size_t           size_ = 0;
+  std::size_t           in_flight_ = 0;
+  libusb_device_handle *handle_ = nullptr;
+  uint8_t               ep_ = 0;
+  uint8_t               flags_ = 0;
+  int                   error_ = 0;
+  Counters              stats_;
+};
+
+/**
+  * @brief  Bulk IN endpoint, all transfers queued while running
+  */
+class InPipe : public Pipe
+{
+public:
+  InPipe() = default;
+
+  int start(libusb_device_handle *handle, uint8_t ep, uint16_t mps, const PipeConfig &cfg)
+  {
+    int ret = setup(handle, ep, mps, cfg);
+
+    running_ = (ret == LIBUSB_SUCCESS);
+    for (std::size_t i = 0; running_ && (i < slots_.size()); i++)
+    {
+      ret = submit(slots_[i], size_);
+      running_ = (ret == LIBUSB_SUCCESS);
+    }
+    return ret;
+  }
+
+  void stop()
+  {
+    running_ = false;
+    cancel();
+  }
+
+  /* received bytes, in stream order, without waiting. Each transfer read
+     out is queued again. */
+  std::size_t read(std::span<uint8_t> dst)
+  {
+    std::size_t n = 0;
+
+    while (!slots_.empty())
+    {
+      Slot &s = slots_[next_];
+      std::size_t k;
+
+      if (!s.ready)
+      {
+        break;
+      }
+      k = std::min(s.length - s.offset, dst.size() - n);
+      std::memcpy(dst.data() + n, s.buf.data() + s.offset, k);
+      s.offset += k;
+      n += k;
+      if (s.offset != s.length)
+      {
+        break;
+      }
+      s.ready = false;
+      next_ = (next_ + 1U) % slots_.size();
+      if (running_ && (submit(s, size_) != LIBUSB_SUCCESS))
+      {
+        running_ = false;
+      }
+    }
+    return n;
+  }
+
+  const Counters &counters() const
+  {
+    return stats_;
+  }
+
+private:
+  bool running_ = false;
+};
+
+/**
+  * @brief  Bulk OUT endpoint, transfers queued as they fill up
+  */
+class OutPipe : public Pipe
+{
+public:
+  OutPipe() = default;
+
+  int start(libusb_device_handle *handle, uint8_t ep, uint16_t mps, const PipeConfig &cfg)
+  {
+    return setup(handle, ep, mps, cfg);
+  }
+
+  void stop()
+  {
+    cancel();
+    for (Slot &s : slots_)
+    {
+      s.length = 0;
+    }
+  }
+
+  /* copy what fits into the free transfers without waiting, queueing
+     each one that fills up */
+  std::size_t write(std::span<const uint8_t> src)
+  {
+    std::size_t n = 0;
+
+    while (!slots_.empty() && (n < src.size()) && (error_ == 0))
+    {
+      Slot &s = slots_[next_];
+      std::size_t k;
+
+      if (s.busy)
+      {
+        break;
+      }
+      k = std::min(size_ - s.length, src.size() - n);
+      std::memcpy(s.buf.data() + s.length, src.data() + n, k);
+      s.length += k;
+      n += k;
+      if (s.length == size_)
+      {
+        if (submit(s, s.length) != LIBUSB_SUCCESS)
+        {
+          break;
+        }
+        next_ = (next_ + 1U) % slots_.size();
+      }
+    }
+    return n;
+  }
+
+  /* queue the part filled transfer; false if it has to wait for a free one */
+  bool flush()
+  {
+    if (slots_.empty())
+    {
+      return true;
+    }
+    Slot &s = slots_[next_];
+
+    if (s.busy)
+    {
+      return false;
+    }
+    if ((s.length != 0U) && (submit(s, s.length) == LIBUSB_SUCCESS))
+    {
+      next_ = (next_ + 1U) % slots_.size();
+    }
+    return true;
+  }
+
+  const Counters &counters() const
+  {
+    return stats_;
+  }
+};
+
+/**
+  * @brief  A CDC port or the vendor interface: a bulk IN and OUT pair
+  */
+class Port
+{
+public:
+  Port() = default;
+  Port(const Port &) = delete;
+  Port &operator=(const Port &) = delete;
+
+  /* claim the interfaces and queue the IN transfers */
+  int start(const PipeConfig &cfg = PipeConfig());
+
+  /* cancel the transfers and give the interfaces back */
+  void stop();
+
+  /* received bytes in stream order, waiting up to timeout_ms for the
+     first: 0 on a timeout */
+  int read(std::span<uint8_t> dst, int timeout_ms);
+
+  /* queue src for sending, waiting up to timeout_ms for free transfers:
+     the bytes taken, fewer than asked on a timeout */
+  int write(std::span<const uint8_t> src, int timeout_ms);
+
+  /* queue what write() left part filled and wait until all is sent */
+  int flush(int timeout_ms);
+
+  /* CDC ports only: LIBUSB_ERROR_NOT_SUPPORTED on the vendor interface */
+  int set_line_coding(uint32_t baud, uint8_t stop_bits = 0, uint8_t parity = 0,
+                      uint8_t data_bits = 8);
+  int set_control_line_state(bool dtr, bool rts);
+
+  bool is_cdc() const
+  {
+    return comm_if_ != kNoInterface;
+  }
+
+  bool started() const
+  {
+    return started_;
+  }
+
+  uint16_t max_packet() const
+  {
+    return mps_;
+  }
+
+  PortStats stats() const
+  {
+    PortStats s;
+
+    s.in_bytes = in_.counters().bytes;
+    s.in_xfers = in_.counters().xfers;
+    s.in_zlps = in_.counters().zlps;
+    s.out_bytes = out_.counters().bytes;
+    s.out_xfers = out_.counters().xfers;
+    return s;
+  }
+
+private:
+  friend class Device;
+
+  int class_request(uint8_t request, uint16_t value, uint8_t *data, uint16_t length);
+
+  Device  *dev_ = nullptr;
+  uint8_t  comm_if_ = kNoInterface;
+  uint8_t  data_if_ = kNoInterface;
+  uint8_t  in_ep_ = 0;
+  uint8_t  out_ep_ = 0;
+  uint16_t mps_ = 0;
+  bool     started_ = false;
+  InPipe   in_;
+  OutPipe  out_;
+};
+
+/**
+  * @brief  One device, opened by vendor and product ID
+  */
+class Device
+{
+public:
+  Device() = default;
+  Device(const Device &) = delete;
+  Device &operator=(const Device &) = delete;
+
+  ~Device()
+  {
+    close();
+  }
+
+  /* open the first matching device, with that serial number if given */
+  int open(uint16_t vid, uint16_t pid, const char *serial = nullptr)
+  {
+    libusb_device **list;
+    long count;
+    int ret;
+
+    close();
+    ret = libusb_init(&ctx_);
+    if (ret < 0)
+    {
+      ctx_ = nullptr;
+      return ret;
+    }
+
+    count = libusb_get_device_list(ctx_, &list);
+    if (count < 0)
+    {
+      close();
+      return static_cast<int>(count);
+    }
+    ret = LIBUSB_ERROR_NO_DEVICE;
+    for (long i = 0; (i < count) && (handle_ == nullptr); i++)
+    {
+      libusb_device_descriptor desc;
+      libusb_device_handle *h;
+      int r;
+
+      if ((libusb_get_device_descriptor(list[i], &desc) < 0) ||
+          (desc.idVendor != vid) || (desc.idProduct != pid))
+      {
+        continue;
+      }
+      r = libusb_open(list[i], &h);
+      if (r < 0)
+      {
+        ret = r;
+        continue;
+      }
+      if (serial != nullptr)
+      {
+        unsigned char text[128];
+
+        r = libusb_get_string_descriptor_ascii(h, desc.iSerialNumber, text, sizeof(text));
+        if ((r < 0) || (std::strcmp(reinterpret_cast<char *>(text), serial) != 0))
+        {
+          libusb_close(h);
+          continue;
+        }
+      }
+      handle_ = h;
+    }
+    libusb_free_device_list(list, 1);
+
+    ret = (handle_ != nullptr) ? scan() : ret;
+    if (ret < 0)
+    {
+      close();
+    }
+    return ret;
+  }
+
+  void close()
+  {
+    for (Port &p : cdc_)
+    {
+      p.stop();
+    }
+    vendor_.stop();
+    if (handle_ != nullptr)
+    {
+      libusb_close(handle_);
+      handle_ = nullptr;
+    }
+    if (ctx_ != nullptr)
+    {
+      libusb_exit(ctx_);
+      ctx_ = nullptr;
+    }
+    cdc_count_ = 0;
+    has_vendor_ = false;
+  }
+
+  /* CDC ports found */
+  int instances() const
+  {
+    return cdc_count_;
+  }
+
+  /* CDC instance, nullptr if the device has none of that number */
+  Port *cdc(int instance)
+  {
+    return ((instance >= 0) && (instance < cdc_count_)) ? &cdc_[instance] : nullptr;
+  }
+
+  Port *vendor()
+  {
+    return has_vendor_ ? &vendor_ : nullptr;
+  }
+
+  /* run the transfer callbacks due, waiting up to timeout_ms for one */
+  int poll(int timeout_ms)
+  {
+    timeval tv;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    return libusb_handle_events_timeout_completed(ctx_, &tv, nullptr);
+  }
+
+  libusb_device_handle *handle() const
+  {
+    return handle_;
+  }
+
+private:
+  /* find the ports in the active configuration */
+  int scan()
+  {
+    libusb_config_descriptor *cfg;
+    uint8_t comm = kNoInterface;
+    int ret = libusb_get_active_config_descriptor(libusb_get_device(handle_), &cfg);
+
+    if (ret < 0)
+    {
+      return ret;
+    }
+    for (int i = 0; i < cfg->bNumInterfaces; i++)
+    {
+      const libusb_interface_descriptor &itf = cfg->interface[i].altsetting[0];
+      Port *port = nullptr;
+      uint8_t in = 0;
+      uint8_t out = 0;
+      uint16_t mps = 0;
+
+      for (int e = 0; e < itf.bNumEndpoints; e++)
+      {
+        const libusb_endpoint_descriptor &ep = itf.endpoint[e];
+
+        if ((ep.bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) != LIBUSB_TRANSFER_TYPE_BULK)
+        {
+          continue;
+        }
+        if ((ep.bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN)
+        {
+          in = ep.bEndpointAddress;
+        }
+        else
+        {
+          out = ep.bEndpointAddress;
+        }
+        mps = ep.wMaxPacketSize & 0x7FFU;
+      }
+
+      if ((itf.bInterfaceClass == 0x02) && (itf.bInterfaceSubClass == 0x02))
+      {
+        comm = itf.bInterfaceNumber;
+        continue;
+      }
+      if ((in == 0U) || (out == 0U))
+      {
+        continue;
+      }
+      if ((itf.bInterfaceClass == 0x0A) && (cdc_count_ < kMaxCdcInstances))
+      {
+        port = &cdc_[cdc_count_++];
+        port->comm_if_ = comm;
+      }
+      else if ((itf.bInterfaceClass == 0xFF) && !has_vendor_)
+      {
+        port = &vendor_;
+        port->comm_if_ = kNoInterface;
+        has_vendor_ = true;
+      }
+      comm = kNoInterface;
+      if (port != nullptr)
+      {
+        port->dev_ = this;
+        port->data_if_ = itf.bInterfaceNumber;
+        port->in_ep_ = in;
+        port->out_ep_ = out;
+        port->mps_ = mps;
+      }
+    }
+    libusb_free_config_descriptor(cfg);
+
+    /* not there on every platform, the claim then says whether it matters */
+    libusb_set_auto_detach_kernel_driver(handle_, 1);
+    return ((cdc_count_ != 0) || has_vendor_) ? LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+  }
+
+  libusb_context       *ctx_ = nullptr;
+  libusb_device_handle *handle_ = nullptr;
+  Port                  cdc_[kMaxCdcInstances];
+  int                   cdc_count_ = 0;
+  Port                  vendor_;
+  bool                  has_vendor_ = false;
+};
+
+/* Port ----------------------------------------------------------------------*/
+
+namespace detail {
+
+using Clock = std::chrono::steady_clock;
+
+/* milliseconds left until end, 0 once passed */
+inline int remaining_ms(Clock::time_point end)
+{
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(end - Clock::now()).count();
+
+  return (left > 0) ? static_cast<int>(left) : 0;
+}
+
+} /* namespace detail */
+
+inline int Port::start(const PipeConfig &cfg)
+{
+  libusb_device_handle *h;
+  int ret;
+
+  if (dev_ == nullptr)
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+  if (started_)
+  {
+    return LIBUSB_SUCCESS;
+  }
+  h = dev_->handle();
+
+  if (is_cdc())
+  {
+    ret = libusb_claim_interface(h, comm_if_);
+    if (ret < 0)
+    {
+      return ret;
+    }
+  }
+  ret = libusb_claim_interface(h, data_if_);
+  if (ret < 0)
+  {
+    if (is_cdc())
+    {
+      libusb_release_interface(h, comm_if_);
+    }
+    return ret;
+  }
+  started_ = true;
+
+  ret = out_.start(h, out_ep_, mps_, cfg);
+  if (ret == LIBUSB_SUCCESS)
+  {
+    ret = in_.start(h, in_ep_, mps_, cfg);
+  }
+  if (ret < 0)
+  {
+    stop();
+  }
+  return ret;
+}
+
+inline void Port::stop()
+{
+  libusb_device_handle *h;
+  auto end = detail::Clock::now() + std::chrono::milliseconds(1000);
+
+  if (!started_)
+  {
+    return;
+  }
+  h = dev_->handle();
+
+  in_.stop();
+  out_.stop();
+  while (((in_.in_flight() != 0U) || (out_.in_flight() != 0U)) &&
+         (detail::remaining_ms(end) != 0))
+  {
+    dev_->poll(10);
+  }
+
+  libusb_release_interface(h, data_if_);
+  if (is_cdc())
+  {
+    libusb_release_interface(h, comm_if_);
+  }
+  started_ = false;
+}
+
+inline int Port::read(std::span<uint8_t> dst, int timeout_ms)
+{
+  auto end = detail::Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+  if (!started_)
+  {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  for (;;)
+  {
+    std::size_t n = in_.read(dst);
+    int left;
+    int ret;
+
+    if ((n != 0U) || dst.empty())
+    {
+      return static_cast<int>(n);
+    }
+    if (in_.error() != 0)
+    {
+      return in_.error();
+    }
+    left = detail::remaining_ms(end);
+    if (left == 0)
+    {
+      return 0;
+    }
+    ret = dev_->poll(left);
+    if ((ret < 0) && (ret != LIBUSB_ERROR_INTERRUPTED))
+    {
+      return ret;
+    }
+  }
+}
+
+inline int Port::write(std::span<const uint8_t> src, int timeout_ms)
+{
+  auto end = detail::Clock::now() + std::chrono::milliseconds(timeout_ms);
+  std::size_t n = 0;
+
+  if (!started_)
+  {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  for (;;)
+  {
+    int left;
+    int ret;
+
+    n += out_.write(src.subspan(n));
+    if (n == src.size())
+    {
+      return static_cast<int>(n);
+    }
+    if (out_.error() != 0)
+    {
+      return (n != 0U) ? static_cast<int>(n) : out_.error();
+    }
+    left = detail::remaining_ms(end);
+    if (left == 0)
+    {
+      return static_cast<int>(n);
+    }
+    ret = dev_->poll(left);
+    if ((ret < 0) && (ret != LIBUSB_ERROR_INTERRUPTED))
+    {
+      return (n != 0U) ? static_cast<int>(n) : ret;
+    }
+  }
+}
+
+inline int Port::flush(int timeout_ms)
+{
+  auto end = detail::Clock::now() + std::chrono::milliseconds(timeout_ms);
+  bool queued = false;
+
+  if (!started_)
+  {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  for (;;)
+  {
+    int left;
+
+    queued = queued || out_.flush();
+    if (out_.error() != 0)
+    {
+      return out_.error();
+    }
+    if (queued && (out_.in_flight() == 0U))
+    {
+      return LIBUSB_SUCCESS;
+    }
+    left = detail::remaining_ms(end);
+    if (left == 0)
+    {
+      return LIBUSB_ERROR_TIMEOUT;
+    }
+    dev_->poll(left);
+  }
+}
+
+inline int Port::class_request(uint8_t request, uint16_t value, uint8_t *data, uint16_t length)
+{
+  int ret;
+
+  if (!is_cdc())
+  {
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+  }
+  if (dev_ == nullptr)
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+  ret = libusb_control_transfer(dev_->handle(), 0x21, request, value, comm_if_,
+                                data, length, 1000);
+  return (ret < 0) ? ret : LIBUSB_SUCCESS;
+}
+
+inline int Port::set_line_coding(uint32_t baud, uint8_t stop_bits, uint8_t parity,
+                                 uint8_t data_bits)
+{
+  uint8_t coding[7] = {
+    static_cast<uint8_t>(baud), static_cast<uint8_t>(baud >> 8),
+    static_cast<uint8_t>(baud >> 16), static_cast<uint8_t>(baud >> 24),
+    stop_bits, parity, data_bits
+  };
+
+  return class_request(kSetLineCoding, 0, coding, sizeof(coding));
+}
+
+inline int Port::set_control_line_state(bool dtr, bool rts)
+{
+  return class_request(kSetControlLineState,
+                       static_cast<uint16_t>((dtr ? 1U : 0U) | (rts ? 2U : 0U)), nullptr, 0);
+}
+
+} /* namespace usbd::host */
+
+#endif  /* __CDC_HOST_HPP */
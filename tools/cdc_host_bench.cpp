@@ -0,0 +1,368 @@
+/**
+  ******************************************************************************
+  * @file    cdc_host_bench.cpp
+  * @brief   Throughput half of tools/cdc_bench.py over cdc_host.hpp, with the
+  *          bulk transfers queued by libusb instead of read from a tty, see
+  *          inc/usb/usbd_cdc_bench.h for the firmware side.
+  *
+  *            c++ -std=c++20 -O2 -o cdc_host_bench cdc_host_bench.cpp \
+  *                $(pkg-config --cflags --libs libusb-1.0)
+  *            cdc_host_bench
+  *            cdc_host_bench --instance 1 --seconds 10 --depth 16 --size 16384
+  *            cdc_host_bench --vid 0483 --pid 5740 --serial 3276 --all
+  *
+  *          As cdc_bench.py: the IN direction (source), then OUT (sink),
+  *          then both through loopback, the mode chosen by the baud rate.
+  *          With --all every CDC port of the device runs each test at
+  *          once, from one thread, which is what fills a full speed bus.
+  *          The ports are taken from cdc_acm for the run. Exits 1 on a
+  *          pattern error or a corrupted loopback.
+  ******************************************************************************
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cdc_host.hpp"
+
+namespace {
+
+constexpr uint32_t kBaudLoopback = 10001;
+constexpr uint32_t kBaudSink = 10002;
+constexpr uint32_t kBaudSource = 10003;
+constexpr uint32_t kBaudOff = 115200;
+
+constexpr std::size_t kChunk = 16384;
+
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+  double   in_mbps = 0.0;
+  uint64_t in_errors = 0;
+  double   out_mbps = 0.0;
+  double   loopback_mbps = 0.0;
+  uint64_t loopback_lost = 0;
+  bool     loopback_ok = true;
+};
+
+struct Bench
+{
+  usbd::host::Port *port;
+  int               instance;
+  Result            result;
+  uint64_t          sent = 0;
+  uint64_t          received = 0;
+  uint8_t           expect = 0;
+};
+
+/* Bytes n & 0xFF, twice over so that any offset has a whole chunk */
+uint8_t pattern[2 * kChunk];
+
+double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/* Switch the mode and drop whatever the mode before left in flight */
+void set_mode(usbd::host::Device &dev, std::vector<Bench> &benches, uint32_t baud)
+{
+  static uint8_t sink[kChunk];
+  auto end = Clock::now() + std::chrono::milliseconds(50);
+
+  for (Bench &b : benches)
+  {
+    b.port->set_line_coding(baud);
+  }
+  while (Clock::now() < end)
+  {
+    for (Bench &b : benches)
+    {
+      b.port->read(sink, 0);
+    }
+    dev.poll(1);
+  }
+}
+
+void run_source(usbd::host::Device &dev, std::vector<Bench> &benches, double duration)
+{
+  static uint8_t data[kChunk];
+  Clock::time_point start;
+
+  set_mode(dev, benches, kBaudSource);
+  for (Bench &b : benches)
+  {
+    b.received = 0;
+  }
+  start = Clock::now();
+  while (seconds_since(start) < duration)
+  {
+    for (Bench &b : benches)
+    {
+      int n = b.port->read(data, 0);
+
+      for (int i = 0; i < n; i++)
+      {
+        if ((b.received == 0U) && (i == 0))
+        {
+          b.expect = data[0];
+        }
+        if (data[i] != b.expect)
+        {
+          b.result.in_errors++;
+          b.expect = data[i];
+        }
+        b.expect++;
+      }
+      if (n > 0)
+      {
+        b.received += static_cast<uint64_t>(n);
+      }
+    }
+    dev.poll(1);
+  }
+  for (Bench &b : benches)
+  {
+    b.result.in_mbps = b.received / seconds_since(start) / 1e6;
+  }
+  set_mode(dev, benches, kBaudOff);
+}
+
+void run_sink(usbd::host::Device &dev, std::vector<Bench> &benches, double duration)
+{
+  Clock::time_point start;
+
+  set_mode(dev, benches, kBaudSink);
+  for (Bench &b : benches)
+  {
+    b.sent = 0;
+  }
+  start = Clock::now();
+  while (seconds_since(start) < duration)
+  {
+    for (Bench &b : benches)
+    {
+      int n = b.port->write(std::span<const uint8_t>(&pattern[b.sent & 0xFFU], kChunk), 0);
+
+      if (n > 0)
+      {
+        b.sent += static_cast<uint64_t>(n);
+      }
+    }
+    dev.poll(1);
+  }
+  for (Bench &b : benches)
+  {
+    b.port->flush(2000);
+    b.result.out_mbps = b.sent / seconds_since(start) / 1e6;
+  }
+  set_mode(dev, benches, kBaudOff);
+}
+
+void run_loopback(usbd::host::Device &dev, std::vector<Bench> &benches, double duration)
+{
+  static uint8_t data[kChunk];
+  Clock::time_point start;
+  Clock::time_point idle;
+  double elapsed;
+  bool pending = true;
+
+  set_mode(dev, benches, kBaudLoopback);
+  for (Bench &b : benches)
+  {
+    b.sent = 0;
+    b.received = 0;
+  }
+
+  auto receive = [&](Bench &b) {
+    int n = b.port->read(data, 0);
+
+    for (int i = 0; i < n; i++)
+    {
+      if (data[i] != static_cast<uint8_t>(b.received + i))
+      {
+        b.result.loopback_ok = false;
+      }
+    }
+    if (n > 0)
+    {
+      b.received += static_cast<uint64_t>(n);
+      return true;
+    }
+    return false;
+  };
+
+  start = Clock::now();
+  while (seconds_since(start) < duration)
+  {
+    for (Bench &b : benches)
+    {
+      int n = b.port->write(std::span<const uint8_t>(&pattern[b.sent & 0xFFU], kChunk), 0);
+
+      if (n > 0)
+      {
+        b.sent += static_cast<uint64_t>(n);
+      }
+      receive(b);
+    }
+    dev.poll(1);
+  }
+  for (Bench &b : benches)
+  {
+    b.port->flush(2000);
+  }
+
+  /* the echoes still on their way */
+  idle = Clock::now();
+  while (pending && (seconds_since(idle) < 0.2))
+  {
+    pending = false;
+    for (Bench &b : benches)
+    {
+      if (receive(b))
+      {
+        idle = Clock::now();
+      }
+      pending = pending || (b.received < b.sent);
+    }
+    dev.poll(1);
+  }
+  elapsed = seconds_since(start);
+
+  for (Bench &b : benches)
+  {
+    b.result.loopback_mbps = b.received / elapsed / 1e6;
+    b.result.loopback_lost = (b.sent > b.received) ? (b.sent - b.received) : 0U;
+    b.result.loopback_ok = b.result.loopback_ok && (b.received == b.sent);
+  }
+  set_mode(dev, benches, kBaudOff);
+}
+
+void usage(const char *name)
+{
+  std::fprintf(stderr,
+               "usage: %s [--vid HEX] [--pid HEX] [--serial S] [--instance N | --all]\n"
+               "       [--seconds S] [--depth N] [--size BYTES]\n", name);
+  std::exit(2);
+}
+
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+  uint16_t vid = 0x0483;
+  uint16_t pid = 0x5740;
+  const char *serial = nullptr;
+  int instance = 0;
+  bool all = false;
+  double duration = 5.0;
+  usbd::host::PipeConfig cfg;
+  usbd::host::Device dev;
+  std::vector<Bench> benches;
+  bool failed = false;
+  int ret;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+    if (arg == "--all")
+    {
+      all = true;
+      continue;
+    }
+    if (value == nullptr)
+    {
+      usage(argv[0]);
+    }
+    i++;
+    if (arg == "--vid")
+    {
+      vid = static_cast<uint16_t>(std::strtoul(value, nullptr, 16));
+    }
+    else if (arg == "--pid")
+    {
+      pid = static_cast<uint16_t>(std::strtoul(value, nullptr, 16));
+    }
+    else if (arg == "--serial")
+    {
+      serial = value;
+    }
+    else if (arg == "--instance")
+    {
+      instance = std::atoi(value);
+    }
+    else if (arg == "--seconds")
+    {
+      duration = std::atof(value);
+    }
+    else if (arg == "--depth")
+    {
+      cfg.depth = std::strtoul(value, nullptr, 0);
+    }
+    else if (arg == "--size")
+    {
+      cfg.size = std::strtoul(value, nullptr, 0);
+    }
+    else
+    {
+      usage(argv[0]);
+    }
+  }
+
+  for (std::size_t i = 0; i < sizeof(pattern); i++)
+  {
+    pattern[i] = static_cast<uint8_t>(i);
+  }
+
+  ret = dev.open(vid, pid, serial);
+  if (ret < 0)
+  {
+    std::fprintf(stderr, "%04x:%04x: %s\n", vid, pid, libusb_error_name(ret));
+    return 1;
+  }
+  for (int i = 0; i < dev.instances(); i++)
+  {
+    if (all || (i == instance))
+    {
+      benches.push_back(Bench{dev.cdc(i), i, Result()});
+    }
+  }
+  if (benches.empty())
+  {
+    std::fprintf(stderr, "no CDC instance %d, the device has %d\n", instance, dev.instances());
+    return 1;
+  }
+  for (Bench &b : benches)
+  {
+    ret = b.port->start(cfg);
+    if (ret < 0)
+    {
+      std::fprintf(stderr, "cdc%d: %s\n", b.instance, libusb_error_name(ret));
+      return 1;
+    }
+  }
+
+  run_source(dev, benches, duration);
+  run_sink(dev, benches, duration);
+  run_loopback(dev, benches, duration);
+
+  for (Bench &b : benches)
+  {
+    const Result &r = b.result;
+
+    std::printf("cdc%d: IN %.3f MB/s (%llu pattern errors), OUT %.3f MB/s, "
+                "loopback %.3f MB/s (%llu lost, %s)\n",
+                b.instance, r.in_mbps, static_cast<unsigned long long>(r.in_errors),
+                r.out_mbps, r.loopback_mbps, static_cast<unsigned long long>(r.loopback_lost),
+                r.loopback_ok ? "ok" : "CORRUPTED");
+    failed = failed || (r.in_errors != 0U) || !r.loopback_ok;
+    b.port->stop();
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Decoder of packed CDC telemetry, see inc/usb/usbd_cdc_pack.h.
+
+Reads the stream a USBD_CDC_Pack_Write packer sends, from a port or from
+a capture file, and prints one line of numChannels signed samples per
+frame, or writes the raw little endian samples back out.
+
+    cdc_pack.py --width 2 --channels 3 /dev/ttyACM0
+    cdc_pack.py --width 4 --channels 1 --raw out.bin capture.bin
+
+The stream must be read from its first byte, that is from the reset of
+the packer; the DTR toggle that opening the port does is the usual place
+for the firmware to reset it. With --stats the compression ratio goes to
+stderr at the end.
+"""
+
+import argparse
+import os
+import sys
+
+
+class Unpacker:
+    def __init__(self, width, channels):
+        self.bits = 8 * width
+        self.mask = (1 << self.bits) - 1
+        self.width = width
+        self.channels = channels
+        self.prev = [0] * channels
+        self.channel = 0
+        self.z = 0
+        self.shift = 0
+        self.frame = []
+        self.bytes_in = 0
+        self.samples = 0
+
+    def feed(self, data):
+        """Decode bytes, return the frames they complete."""
+        frames = []
+        self.bytes_in += len(data)
+        for b in data:
+            self.z |= (b & 0x7F) << self.shift
+            if b & 0x80:
+                self.shift += 7
+                if self.shift >= self.bits + 7:
+                    raise ValueError("varint longer than a sample")
+                continue
+            z = self.z
+            self.z = 0
+            self.shift = 0
+            d = (z >> 1) ^ -(z & 1)
+            v = (self.prev[self.channel] + d) & self.mask
+            self.prev[self.channel] = v
+            self.frame.append(v)
+            self.samples += 1
+            self.channel += 1
+            if self.channel == self.channels:
+                frames.append(self.frame)
+                self.frame = []
+                self.channel = 0
+        return frames
+
+    def signed(self, v):
+        return v - (1 << self.bits) if v >> (self.bits - 1) else v
+
+
+def open_source(name):
+    if os.path.isfile(name):
+        return open(name, "rb"), False
+    import serial
+    port = serial.Serial(name, 115200, timeout=0.5)
+    port.reset_input_buffer()
+    return port, True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="CDC port of the device, or a capture file")
+    parser.add_argument("--width", type=int, choices=(2, 4), default=2,
+                        help="bytes per sample, as given USBD_CDC_Pack_Init")
+    parser.add_argument("--channels", type=int, default=1,
+                        help="samples per frame, as given USBD_CDC_Pack_Init")
+    parser.add_argument("--unsigned", action="store_true",
+                        help="print the samples as unsigned")
+    parser.add_argument("--raw", help="write the raw samples to this file instead")
+    parser.add_argument("--stats", action="store_true",
+                        help="print the compression ratio at the end")
+    args = parser.parse_args()
+
+    if not 1 <= args.channels <= 16:
+        parser.error("--channels must be 1 to 16")
+
+    src, live = open_source(args.source)
+    out = open(args.raw, "wb") if args.raw else None
+    unpacker = Unpacker(args.width, args.channels)
+
+    try:
+        while True:
+            data = src.read(4096)
+            if not data:
+                if live:
+                    continue
+                break
+            for frame in unpacker.feed(data):
+                if out:
+                    out.write(b"".join(v.to_bytes(args.width, "little") for v in frame))
+                elif args.unsigned:
+                    print(",".join(str(v) for v in frame))
+                else:
+                    print(",".join(str(unpacker.signed(v)) for v in frame))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        src.close()
+        if out:
+            out.close()
+
+    if args.stats and unpacker.bytes_in:
+        raw = unpacker.samples * args.width
+        print("%d packed bytes, %d raw, ratio %.2f"
+              % (unpacker.bytes_in, raw, raw / unpacker.bytes_in), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Save the packet capture of the device as a pcap file, see inc/usb/usb_cap.h.
+
+The firmware must be built with USB_CAP_ENABLED=1 and call USB_Cap_PumpCdc
+on a CDC instance from its main loop. When the capture ring stops, on a
+trigger or by USB_Cap_Stop, the device writes the ring as a usbmon pcap
+file on that port; this tool reads it and saves it for Wireshark.
+
+    usb_cap.py /dev/ttyACM1 drop.pcap
+    usb_cap.py --timeout 600 --list /dev/ttyACM1 drop.pcap
+    usb_cap.py --list drop.pcap
+
+The port is read until the stream has been idle for --idle seconds after
+its first byte; --timeout bounds the wait for the trigger. With --list the
+records are also printed one per line, and a single existing .pcap
+argument is listed without a port.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+PCAP_MAGIC = 0xA1B2C3D4
+LINKTYPE_USB_LINUX_MMAPPED = 220
+
+XFER_TYPES = {0: "ISO", 1: "INTR", 2: "CTRL", 3: "BULK"}
+
+
+def read_port(name, timeout, idle):
+    import serial
+
+    port = serial.Serial(name, 115200, timeout=0.1)
+    data = bytearray()
+    start = time.monotonic()
+    last = None
+    while True:
+        chunk = port.read(4096)
+        now = time.monotonic()
+        if chunk:
+            data.extend(chunk)
+            last = now
+        elif last is not None and now - last >= idle:
+            break
+        elif last is None and now - start >= timeout:
+            raise RuntimeError("%s: no capture within %.0f s" % (name, timeout))
+    port.close()
+    return bytes(data)
+
+
+def records(data):
+    """(seconds, usbmon fields, captured bytes) of each record"""
+    if len(data) < 24:
+        raise ValueError("not a pcap file")
+    magic, _, _, _, _, _, linktype = struct.unpack_from("<IHHiIII", data, 0)
+    if magic != PCAP_MAGIC or linktype != LINKTYPE_USB_LINUX_MMAPPED:
+        raise ValueError("not a usbmon pcap file")
+    pos = 24
+    while pos + 16 <= len(data):
+        sec, usec, incl, _ = struct.unpack_from("<IIII", data, pos)
+        pos += 16
+        if pos + incl > len(data) or incl < 64:
+            raise ValueError("truncated record at offset %d" % (pos - 16))
+        mon = struct.unpack_from("<QBBBBHbbqiiII8s", data, pos)
+        yield sec + usec / 1e6, mon, data[pos + 64:pos + incl]
+        pos += incl
+
+
+def list_records(data):
+    for t, mon, payload in records(data):
+        _, kind, xfer, ep, _, _, flag_setup, _, _, _, status, length, _, setup = mon
+        line = "%12.6f  %c %-4s %02x" % (t, kind, XFER_TYPES.get(xfer, "?"), ep)
+        if flag_setup == 0:
+            line += "  setup " + setup.hex()
+        elif status == -32:
+            line += "  STALL"
+        else:
+            line += "  %4d bytes" % length
+            if payload:
+                line += "  " + payload.hex()
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="CDC port the device pumps the capture on")
+    parser.add_argument("output", nargs="?", help="pcap file to write")
+    parser.add_argument("--timeout", type=float, default=60.0,
+                        help="seconds to wait for the capture to start")
+    parser.add_argument("--idle", type=float, default=1.0,
+                        help="seconds of silence that end the capture")
+    parser.add_argument("--list", action="store_true",
+                        help="print the records")
+    args = parser.parse_args()
+
+    if args.output is None:
+        if not os.path.isfile(args.port):
+            parser.error("an output file is needed with a port")
+        with open(args.port, "rb") as f:
+            list_records(f.read())
+        return 0
+
+    data = read_port(args.port, args.timeout, args.idle)
+    with open(args.output, "wb") as f:
+        f.write(data)
+    count = sum(1 for _ in records(data))
+    print("%s: %d records, %d bytes" % (args.output, count, len(data)))
+    if args.list:
+        list_records(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Timeline of a USB event trace, see inc/usb/usb_trace.h.
+
+The firmware must be built with USB_TRACE_ENABLED=1 and call
+USB_Trace_Init. The input is the raw ITM byte stream captured from SWO,
+without the TPIU formatter (for example OpenOCD "itm port 8 on" with a
+"tpiu config ... uart off" capture file, or the output of a probe in
+UART/NRZ mode).
+
+    usb_trace.py swo.bin
+    usb_trace.py --clock 72e6 --port 8 swo.bin
+    openocd ... | usb_trace.py -
+
+Each line gives the time of the record, in trace clock cycles or in
+microseconds with --clock, the time since the previous record, the event,
+the endpoint and its argument. Time comes from the ITM local timestamps,
+which are deltas: a record takes the time of the timestamp that follows
+it, so records between two timestamps share one time.
+"""
+
+import argparse
+import sys
+
+EVENTS = {
+    0x01: "DROP",
+    0x02: "SETUP",
+    0x03: "OUT",
+    0x04: "IN",
+    0x05: "BUSY",
+    0x06: "RESET",
+    0x07: "SUSPEND",
+    0x08: "RESUME",
+    0x09: "L1",
+}
+
+REQUESTS = {
+    0x00: "GET_STATUS",
+    0x01: "CLEAR_FEATURE",
+    0x03: "SET_FEATURE",
+    0x05: "SET_ADDRESS",
+    0x06: "GET_DESCRIPTOR",
+    0x07: "SET_DESCRIPTOR",
+    0x08: "GET_CONFIGURATION",
+    0x09: "SET_CONFIGURATION",
+    0x0A: "GET_INTERFACE",
+    0x0B: "SET_INTERFACE",
+    0x0C: "SYNCH_FRAME",
+}
+
+
+class Itm:
+    """Packet level decoder of the ITM stream.
+
+    Yields ("sw", port, value), ("ts", delta) and ("overflow",).
+    Hardware source, extension and global timestamp packets are skipped.
+    """
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise EOFError
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def continuation(self, b):
+        # Payload of 7 bits per byte while bit 7 is set
+        value = 0
+        shift = 0
+        while b & 0x80:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            shift += 7
+        return value
+
+    def packets(self):
+        try:
+            while True:
+                b = self.byte()
+                if b == 0x00:
+                    # Synchronization: zeros, then 0x80
+                    while b == 0x00:
+                        b = self.byte()
+                    continue
+                if b == 0x70:
+                    yield ("overflow",)
+                elif b & 0x03:
+                    size = {1: 1, 2: 2, 3: 4}[b & 0x03]
+                    payload = bytes(self.byte() for _ in range(size))
+                    if not b & 0x04:
+                        yield ("sw", b >> 3, int.from_bytes(payload, "little"))
+                elif (b & 0xCF) == 0xC0:
+                    yield ("ts", self.continuation(b | 0x80))
+                elif (b & 0x8F) == 0x00:
+                    yield ("ts", (b >> 4) & 0x07)
+                elif b in (0x94, 0xB4):
+                    self.continuation(0x80)
+                else:
+                    # Extension packet
+                    self.continuation(b)
+        except EOFError:
+            return
+
+
+def describe(word):
+    evt = word >> 24
+    ep = (word >> 16) & 0xFF
+    arg = word & 0xFFFF
+    name = EVENTS.get(evt, "0x%02x" % evt)
+
+    if evt == 0x02:
+        req = arg >> 8
+        kind = (ep >> 5) & 0x03
+        if kind == 0:
+            req_name = REQUESTS.get(req, "0x%02x" % req)
+        else:
+            req_name = ("class", "vendor", "reserved")[kind - 1] + " 0x%02x" % req
+        return name, "", "%s bmRequestType=0x%02x wValue.lo=0x%02x" % (req_name, ep, arg & 0xFF)
+    if evt == 0x01:
+        return name, "", "%d records lost" % arg
+    if evt in (0x03, 0x04):
+        return name, "0x%02x" % ep, "%d" % arg
+    if evt == 0x05:
+        return name, "0x%02x" % ep, ""
+    return name, "", ""
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="raw ITM capture, - for stdin")
+    parser.add_argument("--port", type=int, default=8,
+                        help="ITM stimulus port of the records (USB_TRACE_PORT)")
+    parser.add_argument("--clock", type=float, default=0.0,
+                        help="timestamp clock in Hz, to print microseconds")
+    args = parser.parse_args()
+
+    if args.capture == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+
+    def fmt(cycles):
+        if args.clock:
+            return "%12.3f" % (cycles * 1e6 / args.clock)
+        return "%12d" % cycles
+
+    now = 0
+    last = 0
+    pending = []
+    counts = {}
+    overflows = 0
+    lost = 0
+
+    def flush():
+        nonlocal last
+        for word in pending:
+            name, ep, detail = describe(word)
+            counts[name] = counts.get(name, 0) + 1
+            print("%s %s  %-8s %-5s %s" % (fmt(now), fmt(now - last), name, ep, detail))
+            last = now
+        pending.clear()
+
+    for pkt in Itm(data).packets():
+        if pkt[0] == "sw":
+            if pkt[1] == args.port:
+                if pkt[2] >> 24 == 0x01:
+                    lost += pkt[2] & 0xFFFF
+                pending.append(pkt[2])
+        elif pkt[0] == "ts":
+            now += pkt[1]
+            flush()
+        else:
+            overflows += 1
+    flush()
+
+    print()
+    for name in sorted(counts):
+        print("%-8s %d" % (name, counts[name]))
+    if lost or overflows:
+        print("records lost: %d, ITM overflows: %d" % (lost, overflows))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,22 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_hpp_check.cpp
+  * @brief   Compile check of inc/usb/usbd_cdc.hpp, which no firmware source
+  *          of this tree includes. Instantiates every member of the layer
+  *          that the configuration builds in; nothing here is linked.
+  *          Run it with the include paths and defines of the firmware, in
+  *          the default configuration and with the optional parts on:
+  *
+  *            c++ -std=c++20 -fsyntax-only -DSTM32F303xC \
+  *                -I../inc/usb -I../inc -I../inc/cmsis -I../inc/stm32f3xx \
+  *                -I<dir of usbd_conf.h> usbd_cdc_hpp_check.cpp
+  *            c++ ... -DUSBD_CDC_RX_RING_SIZE=256 -DUSBD_CDC_TX_QUEUE_SIZE=4 \
+  *                -DUSBD_CDC_TX_RING_SIZE=512 -DUSBD_CDC_URGENT=1 \
+  *                usbd_cdc_hpp_check.cpp
+  ******************************************************************************
+  */
+
+#include "usbd_cdc.hpp"
+
+template class usbd::cdc::TxPool<64, 8>;
+template class usbd::cdc::Port<0>;